@@ -0,0 +1,304 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+"""Replays a task headless over a PCD sequence and reports its throughput.
+
+The task is rewritten before it is run by discode:
+  * viewer components (type matching --strip) are removed together with
+    the data streams and events connecting them,
+  * PCL:PCDReader and PCL:PCDSequence sources read the given sequence once,
+    as fast as they are stepped,
+  * every PCL component gets profile=1, so its handlers log latency
+    statistics when the task finishes (see Types/HandlerProfiler.hpp),
+  * executors keep their assignment (or get a single one, or one per
+    component) and their period is replaced by --period.
+
+The task is stopped at the end of the sequence or after --time seconds,
+then statistics of all handlers are parsed from the log and printed with
+end-to-end frames/s of the pipeline - calls/s of its slowest last stage.
+
+Example:
+  scripts/replay_task.py tasks/Segmentation.xml ~/pcd/stol --executors each
+"""
+
+from __future__ import print_function
+
+import argparse
+import os
+import re
+import signal
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import xml.etree.ElementTree as ET
+
+SOURCES = ('PCL:PCDReader', 'PCL:PCDSequence')
+
+# Line logged by HandlerProfiler::summary().
+SUMMARY = re.compile(r'(?P<handler>[^\s]+?\.[^:]+): (?P<calls>\d+) calls, mean (?P<mean>[\d.e+-]+) ms, '
+                     r'p50 (?P<p50>[\d.e+-]+) ms, p99 (?P<p99>[\d.e+-]+) ms, max (?P<max>[\d.e+-]+) ms'
+                     r'(?:, (?P<rate>[\d.e+-]+) calls/s)?'
+                     r'(?:, points (?P<points_in>[\d.e+-]+) -> (?P<points_out>[\d.e+-]+) per call)?'
+                     r', pool misses (?P<misses>[\d.e+-]+) \((?P<kb>[\d.e+-]+) kB\) per call')
+
+END_OF_SEQUENCE = 'End of sequence'
+
+
+def stream_component(name):
+    """Component of the stream name Component.stream."""
+    return name.split('.', 1)[0]
+
+
+def set_param(component, name, value):
+    for param in component.findall('param'):
+        if param.get('name') == name:
+            param.text = value
+            return
+    param = ET.SubElement(component, 'param', name=name)
+    param.text = value
+
+
+def strip_components(task, pattern):
+    """Removes components of types matching the pattern and everything connected to them."""
+    removed = set()
+    for executor in task.iter('Executor'):
+        for component in list(executor.findall('Component')):
+            if re.search(pattern, component.get('type', '')):
+                removed.add(component.get('name'))
+                executor.remove(component)
+
+    streams = task.find('DataStreams')
+    if streams is not None:
+        for source in list(streams.findall('Source')):
+            if stream_component(source.get('name')) in removed:
+                streams.remove(source)
+                continue
+            for sink in list(source.findall('sink')):
+                if stream_component(sink.text.strip()) in removed:
+                    source.remove(sink)
+            if not source.findall('sink'):
+                streams.remove(source)
+
+    events = task.find('Events')
+    if events is not None:
+        for event in list(events):
+            if stream_component(event.get('source', '')) in removed or \
+                    stream_component(event.get('destination', '')) in removed:
+                events.remove(event)
+    return removed
+
+
+def used_outputs(task, name):
+    """Names of output streams of the component connected to any sink."""
+    streams = task.find('DataStreams')
+    if streams is None:
+        return set()
+    return set(source.get('name').split('.', 1)[1] for source in streams.findall('Source')
+               if stream_component(source.get('name')) == name)
+
+
+def replace_sources(task, directory, pattern):
+    """Makes every PCD source read the sequence once. Returns names of sources."""
+    sources = []
+    for component in task.iter('Component'):
+        if component.get('type') not in SOURCES:
+            continue
+        name = component.get('name')
+        outputs = used_outputs(task, name)
+        for param in list(component.findall('param')):
+            component.remove(param)
+        component.set('type', 'PCL:PCDSequence')
+        set_param(component, 'sequence.directory', directory)
+        set_param(component, 'sequence.pattern', pattern)
+        set_param(component, 'mode.loop', '0')
+        set_param(component, 'mode.auto_next_cloud', '1')
+        set_param(component, 'mode.auto_publish_cloud', '1')
+        for kind in ('xyz', 'xyzrgb', 'xyzsift'):
+            set_param(component, 'cloud.' + kind, '1' if 'out_cloud_' + kind in outputs else '0')
+        sources.append(name)
+    return sources
+
+
+def assign_executors(task, mode, period):
+    """Keeps, merges (single) or splits (each) executors, and sets their period."""
+    subtasks = task.find('Subtasks')
+    if mode != 'keep':
+        components = [c for executor in task.iter('Executor') for c in executor.findall('Component')]
+        for subtask in list(subtasks):
+            subtasks.remove(subtask)
+        subtask = ET.SubElement(subtasks, 'Subtask', name='Replay')
+        if mode == 'single':
+            executor = ET.SubElement(subtask, 'Executor', name='Exec')
+            executor.extend(components)
+        else:
+            for component in components:
+                component.set('priority', '1')
+                executor = ET.SubElement(subtask, 'Executor', name='Exec' + component.get('name'))
+                executor.append(component)
+    for executor in task.iter('Executor'):
+        executor.set('period', str(period))
+
+
+def last_components(task):
+    """Components whose outputs are not connected to other components."""
+    names = [c.get('name') for c in task.iter('Component')]
+    streams = task.find('DataStreams')
+    producers = set()
+    if streams is not None:
+        producers = set(stream_component(s.get('name')) for s in streams.findall('Source'))
+    return [n for n in names if n not in producers]
+
+
+def run(command, limit, stop_at_end):
+    """Runs discode, stops it (as with Ctrl-C) at the end of sequence or time limit. Returns log lines."""
+    process = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    lines = []
+    ended = threading.Event()
+
+    def read():
+        for line in iter(process.stdout.readline, ''):
+            lines.append(line.rstrip('\n'))
+            if stop_at_end and END_OF_SEQUENCE in line:
+                ended.set()
+        ended.set()
+
+    reader = threading.Thread(target=read)
+    reader.daemon = True
+    reader.start()
+
+    start = time.time()
+    ended.wait(limit)
+    elapsed = time.time() - start
+    if process.poll() is None:
+        process.send_signal(signal.SIGINT)
+        try:
+            for _ in range(100):
+                if process.poll() is not None:
+                    break
+                time.sleep(0.1)
+            else:
+                process.kill()
+        except OSError:
+            pass
+    process.wait()
+    reader.join(5)
+    return lines, elapsed
+
+
+def parse(lines, components):
+    """Last summary of every handler of the components, keyed by Component.handler."""
+    stats = {}
+    for line in lines:
+        match = SUMMARY.search(line)
+        if not match:
+            continue
+        handler = match.group('handler')
+        # Log prefix may be glued to the name, find the component it starts with.
+        for name in components:
+            at = handler.rfind(name + '.')
+            if at >= 0 and (at == 0 or not handler[at - 1].isalnum()):
+                handler = handler[at:]
+                break
+        else:
+            continue
+        value = dict((k, float(v)) for k, v in match.groupdict().items() if k != 'handler' and v is not None)
+        stats[handler] = value
+    return stats
+
+
+def report(stats, sources, last, elapsed, csv):
+    columns = ('calls', 'mean', 'p50', 'p99', 'max', 'rate', 'points_in', 'points_out', 'misses', 'kb')
+    if csv:
+        print('handler,' + ','.join(columns))
+        for handler in sorted(stats):
+            print(handler + ',' + ','.join(str(stats[handler].get(c, '')) for c in columns))
+    else:
+        print('%-48s %8s %10s %10s %10s %10s %10s %10s %10s' % ('handler', 'calls', 'mean ms', 'p50 ms', 'p99 ms', 'max ms',
+                                                                 'calls/s', 'misses', 'miss kB'))
+        for handler in sorted(stats):
+            s = stats[handler]
+            print('%-48s %8d %10.3f %10.3f %10.3f %10.3f %10.1f %10.2f %10.1f' % (handler, s['calls'], s['mean'], s['p50'],
+                                                                                 s['p99'], s['max'], s.get('rate', 0),
+                                                                                 s['misses'], s['kb']))
+
+    def component_stats(names):
+        return [s for h, s in stats.items() if stream_component(h) in names and s['calls'] > 0]
+
+    frames = component_stats(sources)
+    ends = component_stats(last)
+    print()
+    print('wall time: %.2f s' % elapsed)
+    if frames:
+        print('frames read: %d (%.1f frames/s)' % (max(s['calls'] for s in frames), max(s.get('rate', 0) for s in frames)))
+    if ends:
+        # A frame is done when the slowest last stage has processed it.
+        print('end-to-end: %.1f frames/s' % min(s.get('rate', 0) for s in ends))
+    # Time spent in handlers per frame, without waiting in streams between executors.
+    busy = [s['mean'] * s['calls'] for s in stats.values()]
+    if frames and busy:
+        print('processing per frame: %.3f ms' % (sum(busy) / max(max(s['calls'] for s in frames), 1)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('task', help='task XML, e.g. tasks/Segmentation.xml')
+    parser.add_argument('directory', help='directory of the PCD sequence read by sources')
+    parser.add_argument('--pattern', default='.*\\.(pcd)', help='regular expression of PCD files (default: %(default)s)')
+    parser.add_argument('--strip', default='Viewer', help='regular expression of types of removed components (default: %(default)s)')
+    parser.add_argument('--executors', choices=('keep', 'single', 'each'), default='keep',
+                        help='keep executors of the task, run all components in one, or every one in its own')
+    parser.add_argument('--period', type=float, default=0, help='period of every executor in seconds (default: %(default)s)')
+    parser.add_argument('--time', type=float, default=60, help='maximal run time in seconds (default: %(default)s)')
+    parser.add_argument('--discode', default='discode', help='discode executable (default: %(default)s)')
+    parser.add_argument('--keep', metavar='FILE', help='save the rewritten task to the file')
+    parser.add_argument('--csv', action='store_true', help='print statistics of handlers as CSV')
+    parser.add_argument('--log', action='store_true', help='print the log of discode')
+    parser.epilog = 'Arguments after -- are passed to discode.'
+    argv = sys.argv[1:]
+    args = argv[argv.index('--') + 1:] if '--' in argv else []
+    options = parser.parse_args(argv[:len(argv) - len(args) - (1 if '--' in argv else 0)])
+
+    tree = ET.parse(options.task)
+    task = tree.getroot()
+    removed = strip_components(task, options.strip)
+    sources = replace_sources(task, os.path.abspath(os.path.expanduser(options.directory)), options.pattern)
+    if not sources:
+        print('No PCD source (%s) in %s' % (', '.join(SOURCES), options.task), file=sys.stderr)
+        return 1
+    last = last_components(task)
+    assign_executors(task, options.executors, options.period)
+
+    components = [c.get('name') for c in task.iter('Component')]
+    for component in task.iter('Component'):
+        if component.get('type', '').startswith('PCL:'):
+            set_param(component, 'profile', '1')
+            set_param(component, 'profile.period', '0')
+
+    if options.keep:
+        path = options.keep
+    else:
+        handle, path = tempfile.mkstemp(suffix='.xml', prefix='replay_')
+        os.close(handle)
+    tree.write(path, encoding='utf-8')
+
+    try:
+        lines, elapsed = run([options.discode, '-T', path] + args, options.time, True)
+    finally:
+        if not options.keep:
+            os.remove(path)
+
+    if options.log:
+        print('\n'.join(lines))
+    if removed:
+        print('removed: ' + ', '.join(sorted(removed)))
+    stats = parse(lines, components)
+    if not stats:
+        print('No statistics of handlers in the log of discode (is INFO level logged?)', file=sys.stderr)
+        return 1
+    report(stats, sources, last, elapsed, options.csv)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
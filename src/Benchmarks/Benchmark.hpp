@@ -0,0 +1,94 @@
+/*!
+ * \file
+ * \brief Minimal harness timing benchmark cases.
+ * \author Micha Laszkowski
+ */
+
+#ifndef BENCHMARK_HPP_
+#define BENCHMARK_HPP_
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace Benchmarks {
+
+/*!
+ * \class Runner
+ * \brief Times cases and prints points/s and bytes/s of every one.
+ *
+ * A case is a functor processing the same input on every call. It is run
+ * once to warm up caches and pools, then every sample repeats it until the
+ * sample lasts at least the minimal time. Median of samples is reported,
+ * so a single disturbed sample does not move the result.
+ */
+class Runner {
+public:
+	Runner() : samples_(5), min_time_(0.1), csv_(false) {}
+
+	void setSamples(int samples) { samples_ = std::max(samples, 1); }
+	void setMinTime(double seconds) { min_time_ = seconds; }
+	void setFilter(const std::string & filter) { filter_ = filter; }
+	void setCsv(bool csv) { csv_ = csv; }
+
+	/// Returns true if cases of the name are selected (name contains the filter).
+	bool selected(const std::string & name) const {
+		return name.find(filter_) != std::string::npos;
+	}
+
+	void header() const {
+		if (csv_)
+			std::cout << "name,points,seconds,points_per_s,bytes_per_s\n";
+		else
+			std::cout << std::left << std::setw(40) << "name" << std::right << std::setw(10) << "points" << std::setw(12) << "ms"
+					<< std::setw(14) << "Mpoints/s" << std::setw(12) << "MB/s" << "\n";
+	}
+
+	/// Times the case, points and bytes are the size of its input.
+	template <typename F>
+	void run(const std::string & name, size_t points, size_t bytes, F f) {
+		if (!selected(name))
+			return;
+		f();
+
+		std::vector<double> seconds;
+		for (int s = 0; s < samples_; ++s) {
+			size_t iterations = 0;
+			const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+			double elapsed = 0;
+			do {
+				f();
+				++iterations;
+				elapsed = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1e-6;
+			} while (elapsed < min_time_);
+			seconds.push_back(elapsed / iterations);
+		}
+		std::nth_element(seconds.begin(), seconds.begin() + seconds.size() / 2, seconds.end());
+		print(name, points, bytes, seconds[seconds.size() / 2]);
+	}
+
+private:
+	void print(const std::string & name, size_t points, size_t bytes, double seconds) const {
+		if (csv_) {
+			std::cout << name << "," << points << "," << seconds << "," << points / seconds << "," << bytes / seconds << "\n";
+			return;
+		}
+		std::cout << std::left << std::setw(40) << name << std::right << std::setw(10) << points << std::fixed << std::setprecision(3)
+				<< std::setw(12) << 1e3 * seconds << std::setw(14) << points / seconds * 1e-6 << std::setw(12) << bytes / seconds * 1e-6
+				<< "\n";
+		std::cout.unsetf(std::ios::floatfield);
+	}
+
+	int samples_;
+	double min_time_;
+	bool csv_;
+	std::string filter_;
+};
+
+} //: namespace Benchmarks
+
+#endif /* BENCHMARK_HPP_ */
@@ -0,0 +1,285 @@
+/*!
+ * \file
+ * \brief Micro-benchmarks of the code behind handlers of filter and conversion components.
+ * \author Micha Laszkowski
+ *
+ * Usage: PCLBenchmarks [--filter text] [--sizes n,n,...] [--samples n] [--min-time s]
+ *                      [--max-search-points n] [--seed n] [--csv] [file.pcd ...]
+ *
+ * Every case runs on synthetic clouds of PlaneGenerator and SphereGenerator
+ * models (and depth maps) of every size, generated with a fixed seed, and
+ * on the given PCD files. Results are reproducible between runs and builds,
+ * so two builds can be compared case by case.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+#include <boost/bind.hpp>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/segmentation/extract_clusters.h>
+
+#include "Types/BoxCrop.hpp"
+#include "Types/HashVoxelGrid.hpp"
+#include "Types/IndexedCloud.hpp"
+#include "Types/StatisticalOutliers.hpp"
+#include "Types/PlaneExtractor.hpp"
+#include "Types/OrganizedClustering.hpp"
+#include "Types/CloudTransform.hpp"
+#include "Types/DepthBackProjection.hpp"
+#include "Types/CorrespondenceEstimationColor.hpp"
+#include "Types/DeviceSearch.hpp"
+
+#include "Benchmark.hpp"
+#include "Clouds.hpp"
+
+namespace Benchmarks {
+
+typedef pcl::PointXYZRGB Point;
+typedef pcl::PointCloud<Point> Cloud;
+
+struct Options {
+	Options() : max_search_points(200000), seed(42) {
+		sizes.push_back(10000);
+		sizes.push_back(100000);
+		sizes.push_back(1000000);
+	}
+
+	std::vector<size_t> sizes;
+
+	/// Cases using kd-tree search run only on clouds up to this size.
+	size_t max_search_points;
+
+	unsigned int seed;
+	std::vector<std::string> files;
+};
+
+// Bodies of cases, the code run by the handlers for one frame.
+
+void boxCrop(const Types::BoxCrop & box, const Cloud & input, Cloud & output) {
+	box.filter(input, output);
+}
+
+void voxelGrid(pcl::VoxelGrid<Point> & grid, Cloud & output) {
+	grid.filter(output);
+}
+
+void hashVoxelGrid(Types::HashVoxelGrid<Point> & grid, const Cloud & input, Cloud & output) {
+	grid.filter(input, output);
+}
+
+void transform(const Cloud & input, Cloud & output, const Eigen::Matrix4f & m) {
+	Types::CloudTransform::transform(input, output, m);
+}
+
+/// StatisticalOutlierRemoval, the index is built for every frame as in the handler.
+void outliers(const Cloud::Ptr & cloud) {
+	Types::IndexedCloud<Point> indexed(cloud);
+	Types::StatisticalOutliers::Result result;
+	Types::StatisticalOutliers::analyze(indexed, 50, 1.0, false, result);
+}
+
+void ransacPlane(Types::PlaneExtractor<Point> & extractor, const Cloud::Ptr & cloud) {
+	std::vector<Types::PlaneExtractor<Point>::Plane> planes;
+	std::vector<int> remaining;
+	extractor.extract(cloud, 1, planes, remaining);
+}
+
+void euclideanClusters(const Cloud::Ptr & cloud) {
+	pcl::search::KdTree<Point>::Ptr tree(new pcl::search::KdTree<Point>);
+	std::vector<pcl::PointIndices> clusters;
+	pcl::EuclideanClusterExtraction<Point> ec;
+	ec.setClusterTolerance(0.02);
+	ec.setMinClusterSize(100);
+	ec.setMaxClusterSize(cloud->size());
+	ec.setSearchMethod(tree);
+	ec.setInputCloud(cloud);
+	ec.extract(clusters);
+}
+
+/// Clustering of the GPU backend of Clustering and ClusterExtraction, with the upload.
+void deviceClusters(const Cloud::Ptr & cloud) {
+	std::vector<pcl::PointIndices> clusters;
+	Types::Cuda::euclideanClusters(*Types::DeviceCloud<Point>::upload(cloud), 0.02, 100, cloud->size(), clusters);
+}
+
+void correspondences(pcl::registration::CorrespondenceEstimationColor<Point, Point> & estimation) {
+	pcl::Correspondences found;
+	estimation.determineCorrespondences(found, 0.05);
+}
+
+template <bool HasColor, typename PointT>
+void backProject(const cv::Mat & depth, const Types::DepthBackProjection::RayTable & rays, const cv::Mat & color, bool compact,
+		pcl::PointCloud<PointT> & cloud) {
+	Types::DepthBackProjection::backProjectDepth<HasColor>(depth, rays, NULL, color, cloud, compact);
+}
+
+void organizedClusters(const Types::OrganizedClustering & clustering, const Cloud & cloud) {
+	std::vector<pcl::PointIndices> clusters;
+	clustering.extract(cloud, clusters);
+}
+
+/// Cases taking an unorganized cloud, as the handlers get it.
+void cloudCases(Runner & runner, const Options & options, const std::string & input, const Cloud::Ptr & cloud) {
+	const size_t n = cloud->size();
+	const size_t bytes = n * sizeof(Point);
+	Cloud output;
+
+	// PassThrough
+	Types::BoxCrop box;
+	box.setLimits(0, -1, 1);
+	box.setLimits(1, -1, 1);
+	box.setLimits(2, 0, 3);
+	runner.run("passthrough.box/" + input, n, bytes, boost::bind(&boxCrop, boost::cref(box), boost::cref(*cloud), boost::ref(output)));
+
+	// VoxelGrid, both modes
+	pcl::VoxelGrid<Point> vg;
+	vg.setInputCloud(cloud);
+	vg.setLeafSize(0.01f, 0.01f, 0.01f);
+	runner.run("voxelgrid.pcl/" + input, n, bytes, boost::bind(&voxelGrid, boost::ref(vg), boost::ref(output)));
+
+	Types::HashVoxelGrid<Point> hash;
+	hash.setLeafSize(0.01f, 0.01f, 0.01f);
+	runner.run("voxelgrid.hash/" + input, n, bytes, boost::bind(&hashVoxelGrid, boost::ref(hash), boost::cref(*cloud), boost::ref(output)));
+
+	// CloudTransformer
+	Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
+	m.topLeftCorner<3, 3>() = Eigen::AngleAxisf(0.3f, Eigen::Vector3f(0, 0, 1)).toRotationMatrix();
+	m(0, 3) = 0.1f;
+	runner.run("transform.cloud/" + input, n, bytes, boost::bind(&transform, boost::cref(*cloud), boost::ref(output), boost::cref(m)));
+
+	if (n > options.max_search_points)
+		return;
+
+	runner.run("sor.analyze/" + input, n, bytes, boost::bind(&outliers, cloud));
+
+	// RANSACPlane
+	Types::PlaneExtractor<Point> extractor;
+	extractor.setDistanceThreshold(0.01);
+	extractor.setMaxIterations(50);
+	runner.run("ransac.plane/" + input, n, bytes, boost::bind(&ransacPlane, boost::ref(extractor), cloud));
+
+	// ClusterExtraction of unorganized clouds
+	runner.run("clusters.euclidean/" + input, n, bytes, boost::bind(&euclideanClusters, cloud));
+	if (Types::Cuda::available())
+		runner.run("clusters.gpu/" + input, n, bytes, boost::bind(&deviceClusters, cloud));
+
+	// CorrespondenceEstimationColor against the slightly moved cloud
+	Cloud::Ptr target(new Cloud);
+	Eigen::Matrix4f shift = Eigen::Matrix4f::Identity();
+	shift(0, 3) = 0.005f;
+	Types::CloudTransform::transform(*cloud, *target, shift);
+	pcl::registration::CorrespondenceEstimationColor<Point, Point> estimation;
+	estimation.setInputSource(cloud);
+	estimation.setInputTarget(target);
+	runner.run("correspondences.color/" + input, n, bytes, boost::bind(&correspondences, boost::ref(estimation)));
+	if (!Types::Cuda::available())
+		return;
+	// The target stays on the device between frames, as in the handlers.
+	pcl::registration::CorrespondenceEstimationColor<Point, Point> device_estimation;
+	device_estimation.setInputSource(cloud);
+	device_estimation.setInputTarget(target);
+	device_estimation.setDeviceSearch(true);
+	runner.run("correspondences.gpu/" + input, n, bytes, boost::bind(&correspondences, boost::ref(device_estimation)));
+}
+
+/// Cases of DepthConverter and of organized clouds it produces.
+void depthCases(Runner & runner, Generator & generator, int width, int height) {
+	std::ostringstream os;
+	os << "depth" << width << "x" << height;
+	const std::string input = os.str();
+	const size_t n = width * height;
+
+	const cv::Mat depth = generator.depth(width, height);
+	const cv::Mat color = generator.color(width, height);
+	const float f = 525.0f * width / 640;
+	Types::DepthBackProjection::RayTable rays;
+	rays.update(Types::DepthBackProjection::Intrinsics(f, f, width / 2.0f - 0.5f, height / 2.0f - 0.5f), width, height);
+
+	pcl::PointCloud<pcl::PointXYZ> xyz;
+	Cloud organized;
+	runner.run("depth.backproject/" + input, n, 2 * n, boost::bind(&backProject<false, pcl::PointXYZ>,
+			boost::cref(depth), boost::cref(rays), cv::Mat(), false, boost::ref(xyz)));
+	runner.run("depth.backproject_compact/" + input, n, 2 * n, boost::bind(&backProject<false, pcl::PointXYZ>,
+			boost::cref(depth), boost::cref(rays), cv::Mat(), true, boost::ref(xyz)));
+	runner.run("depth.backproject_color/" + input, n, 5 * n, boost::bind(&backProject<true, Point>,
+			boost::cref(depth), boost::cref(rays), boost::cref(color), false, boost::ref(organized)));
+
+	// ClusterExtraction of organized clouds
+	backProject<true>(depth, rays, color, false, organized);
+	Types::OrganizedClustering clustering(0.02, 100);
+	runner.run("clusters.organized/" + input, n, n * sizeof(Point), boost::bind(&organizedClusters, boost::cref(clustering), boost::cref(organized)));
+}
+
+int usage(const char * program) {
+	std::cerr << "Usage: " << program << " [--filter text] [--sizes n,n,...] [--samples n] [--min-time s]"
+			" [--max-search-points n] [--seed n] [--csv] [file.pcd ...]\n";
+	return 1;
+}
+
+} //: namespace Benchmarks
+
+int main(int argc, char ** argv) {
+	using namespace Benchmarks;
+
+	Runner runner;
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool value = i + 1 < argc;
+		if (arg == "--filter" && value)
+			runner.setFilter(argv[++i]);
+		else if (arg == "--samples" && value)
+			runner.setSamples(std::atoi(argv[++i]));
+		else if (arg == "--min-time" && value)
+			runner.setMinTime(std::atof(argv[++i]));
+		else if (arg == "--max-search-points" && value)
+			options.max_search_points = std::strtoul(argv[++i], NULL, 10);
+		else if (arg == "--seed" && value)
+			options.seed = std::strtoul(argv[++i], NULL, 10);
+		else if (arg == "--csv")
+			runner.setCsv(true);
+		else if (arg == "--sizes" && value) {
+			options.sizes.clear();
+			std::istringstream is(argv[++i]);
+			std::string size;
+			while (std::getline(is, size, ','))
+				options.sizes.push_back(std::strtoul(size.c_str(), NULL, 10));
+		} else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0)
+			return usage(argv[0]);
+		else
+			options.files.push_back(arg);
+	}
+
+	runner.header();
+
+	Generator generator(options.seed);
+	for (size_t s = 0; s < options.sizes.size(); ++s) {
+		const size_t n = options.sizes[s];
+		std::ostringstream os;
+		os << n;
+		cloudCases(runner, options, "plane" + os.str(), generator.plane(n, n / 20, 0.1f, 0.2f, 1.0f, -2.0f));
+		cloudCases(runner, options, "sphere" + os.str(), generator.sphere(n, n / 20, 1.0f, 0.0f, 0.0f, 3.0f));
+	}
+
+	depthCases(runner, generator, 320, 240);
+	depthCases(runner, generator, 640, 480);
+	depthCases(runner, generator, 1280, 960);
+
+	for (size_t f = 0; f < options.files.size(); ++f) {
+		Cloud::Ptr cloud(new Cloud);
+		if (pcl::io::loadPCDFile(options.files[f], *cloud) < 0) {
+			std::cerr << "Cannot read " << options.files[f] << "\n";
+			continue;
+		}
+		const std::string name = options.files[f].substr(options.files[f].find_last_of('/') + 1);
+		cloudCases(runner, options, name, cloud);
+	}
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*!
+ * \file
+ * \brief Seeded synthetic inputs of benchmarks.
+ * \author Micha Laszkowski
+ */
+
+#ifndef BENCHMARKS_CLOUDS_HPP_
+#define BENCHMARKS_CLOUDS_HPP_
+
+#include <cmath>
+#include <stdint.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+namespace Benchmarks {
+
+/*!
+ * \class Generator
+ * \brief Clouds of PlaneGenerator and SphereGenerator, with a fixed seed.
+ *
+ * Same models as the components - points of the surface with Gaussian
+ * noise, first points moved away as outliers - but scaled to a few meters,
+ * like a scene of a depth camera, and with random colors.
+ */
+class Generator {
+public:
+	explicit Generator(uint32_t seed) :
+		rng_(seed), uniform_(rng_, boost::uniform_real<float>(0, 1)), normal_(rng_, boost::normal_distribution<float>(0, 1)) {
+	}
+
+	/// Plane ax + by + cz + d = 0 over a square of the given size around its point nearest to the origin.
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr plane(size_t n, size_t outliers, float a, float b, float c, float d,
+			float size = 4.0f, float sigma = 0.001f) {
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+		cloud->points.resize(n);
+		const float norm = std::sqrt(a * a + b * b + c * c);
+		a /= norm, b /= norm, c /= norm, d /= norm;
+		for (size_t i = 0; i < n; ++i) {
+			pcl::PointXYZRGB & p = cloud->points[i];
+			// Random point of the cube, projected on the plane.
+			const float x = size * (uniform() - 0.5f), y = size * (uniform() - 0.5f), z = size * (uniform() - 0.5f);
+			const float dist = a * x + b * y + c * z;
+			p.x = x - dist * a - d * a;
+			p.y = y - dist * b - d * b;
+			p.z = z - dist * c - d * c;
+			finish(p, i < outliers, sigma);
+		}
+		cloud->width = n;
+		cloud->height = 1;
+		return cloud;
+	}
+
+	/// Sphere of radius r centered at (x, y, z).
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr sphere(size_t n, size_t outliers, float r, float x, float y, float z, float sigma = 0.001f) {
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+		cloud->points.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			pcl::PointXYZRGB & p = cloud->points[i];
+			float dx, dy, dz, l;
+			do {
+				dx = normal(), dy = normal(), dz = normal();
+				l = std::sqrt(dx * dx + dy * dy + dz * dz);
+			} while (l == 0);
+			p.x = x + r * dx / l;
+			p.y = y + r * dy / l;
+			p.z = z + r * dz / l;
+			finish(p, i < outliers, sigma);
+		}
+		cloud->width = n;
+		cloud->height = 1;
+		return cloud;
+	}
+
+	/// 16-bit depth map (millimeters) of a tilted wall with a ball in front of it, with some holes.
+	cv::Mat depth(int width, int height, float holes = 0.02f) {
+		cv::Mat depth(height, width, CV_16UC1);
+		for (int v = 0; v < height; ++v) {
+			uint16_t * row = depth.ptr<uint16_t>(v);
+			for (int u = 0; u < width; ++u) {
+				const float du = (u - width / 2.0f) / width, dv = (v - height / 2.0f) / height;
+				float mm = 2000 + 500 * du;
+				const float r2 = du * du + dv * dv;
+				if (r2 < 0.04f)
+					mm -= 1000 * std::sqrt(0.04f - r2);
+				row[u] = uniform() < holes ? 0 : (uint16_t) (mm + normal());
+			}
+		}
+		return depth;
+	}
+
+	/// Color image (BGR) of the given size.
+	cv::Mat color(int width, int height) {
+		cv::Mat color(height, width, CV_8UC3);
+		for (int v = 0; v < height; ++v) {
+			uchar * row = color.ptr<uchar>(v);
+			for (int i = 0; i < 3 * width; ++i)
+				row[i] = (uchar) (256 * uniform());
+		}
+		return color;
+	}
+
+	float uniform() {
+		return uniform_();
+	}
+
+	float normal() {
+		return normal_();
+	}
+
+private:
+	/// Noise or outlier offset and color of the point.
+	void finish(pcl::PointXYZRGB & p, bool outlier, float sigma) {
+		const float scale = outlier ? 1.0f : sigma;
+		p.x += scale * normal();
+		p.y += scale * normal();
+		p.z += scale * normal();
+		p.r = (uint8_t) (256 * uniform());
+		p.g = (uint8_t) (256 * uniform());
+		p.b = (uint8_t) (256 * uniform());
+	}
+
+	boost::mt19937 rng_;
+	boost::variate_generator<boost::mt19937 &, boost::uniform_real<float> > uniform_;
+	boost::variate_generator<boost::mt19937 &, boost::normal_distribution<float> > normal_;
+};
+
+} //: namespace Benchmarks
+
+#endif /* BENCHMARKS_CLOUDS_HPP_ */
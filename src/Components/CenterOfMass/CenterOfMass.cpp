@@ -12,11 +12,20 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudStatistics.hpp"
+#include "Types/CloudTransform.hpp"
+#include "Types/CloudBatch.hpp"
+
 namespace Processors {
 namespace CenterOfMass {
 
 CenterOfMass::CenterOfMass(const std::string & name) :
-		Base::Component(name)  {
+		Base::Component(name),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(profile);
+	registerProperty(profile_period);
 
 }
 
@@ -31,22 +40,50 @@ void CenterOfMass::prepareInterface() {
 	registerStream("out_point", &out_point);
 	registerStream("out_cloud_xyz", &out_cloud_xyz);
 	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
+	registerStream("in_posed_cloud_xyz", &in_posed_cloud_xyz);
+	registerStream("in_posed_cloud_xyzrgb", &in_posed_cloud_xyzrgb);
+	registerStream("out_posed_cloud_xyz", &out_posed_cloud_xyz);
+	registerStream("out_posed_cloud_xyzrgb", &out_posed_cloud_xyzrgb);
+	registerStream("in_clouds_xyz", &in_clouds_xyz);
+	registerStream("in_clouds_xyzrgb", &in_clouds_xyzrgb);
+	registerStream("out_points", &out_points);
+	registerStream("out_clouds_xyz", &out_clouds_xyz);
+	registerStream("out_clouds_xyzrgb", &out_clouds_xyzrgb);
+	registerStream("in_soa_xyzsift", &in_soa_xyzsift);
+	registerStream("out_soa_xyzsift", &out_soa_xyzsift);
 	// Register handlers
-	h_compute.setup(boost::bind(&CenterOfMass::compute, this));
+	h_compute.setup(profiler.wrap("compute", boost::bind(&CenterOfMass::compute, this)));
 	registerHandler("compute", &h_compute);
 	addDependency("compute", &in_cloud_xyz);
-	h_compute_xyzrgb.setup(boost::bind(&CenterOfMass::compute_xyzrgb, this));
+	h_compute_xyzrgb.setup(profiler.wrap("compute_xyzrgb", boost::bind(&CenterOfMass::compute_xyzrgb, this)));
 	registerHandler("compute_xyzrgb", &h_compute_xyzrgb);
 	addDependency("compute_xyzrgb", &in_cloud_xyzrgb);
+	h_compute_posed_xyz.setup(profiler.wrap("compute_posed_xyz", boost::bind(&CenterOfMass::compute_posed_xyz, this)));
+	registerHandler("compute_posed_xyz", &h_compute_posed_xyz);
+	addDependency("compute_posed_xyz", &in_posed_cloud_xyz);
+	h_compute_posed_xyzrgb.setup(profiler.wrap("compute_posed_xyzrgb", boost::bind(&CenterOfMass::compute_posed_xyzrgb, this)));
+	registerHandler("compute_posed_xyzrgb", &h_compute_posed_xyzrgb);
+	addDependency("compute_posed_xyzrgb", &in_posed_cloud_xyzrgb);
+	h_compute_clouds_xyz.setup(profiler.wrap("compute_clouds_xyz", boost::bind(&CenterOfMass::compute_clouds_xyz, this)));
+	registerHandler("compute_clouds_xyz", &h_compute_clouds_xyz);
+	addDependency("compute_clouds_xyz", &in_clouds_xyz);
+	h_compute_clouds_xyzrgb.setup(profiler.wrap("compute_clouds_xyzrgb", boost::bind(&CenterOfMass::compute_clouds_xyzrgb, this)));
+	registerHandler("compute_clouds_xyzrgb", &h_compute_clouds_xyzrgb);
+	addDependency("compute_clouds_xyzrgb", &in_clouds_xyzrgb);
+	h_compute_soa_xyzsift.setup(profiler.wrap("compute_soa_xyzsift", boost::bind(&CenterOfMass::compute_soa_xyzsift, this)));
+	registerHandler("compute_soa_xyzsift", &h_compute_soa_xyzsift);
+	addDependency("compute_soa_xyzsift", &in_soa_xyzsift);
 
 }
 
 bool CenterOfMass::onInit() {
+	profiler.setEnabled(profile, profile_period);
 
 	return true;
 }
 
 bool CenterOfMass::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -60,8 +97,9 @@ bool CenterOfMass::onStart() {
 
 void CenterOfMass::compute() {
 	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
-	Eigen::Vector4f centroid;
-	pcl::compute3DCentroid(*cloud, centroid);  	
+	Types::CloudStatistics::Result stats;
+	Types::CloudStatistics::compute(*cloud, stats);
+	const Eigen::Vector4f & centroid = stats.centroid;  	
 	LOG(LTRACE) << "CenterOfMass: " << centroid[0] << " " << centroid[1] << " " << centroid[2] << " " << endl;
     pcl::PointXYZ point;
     point.x=centroid[0];
@@ -73,14 +111,15 @@ void CenterOfMass::compute() {
 	//Define translation between clouds	
 	Eigen::Matrix4f trans = Eigen::Matrix4f::Identity() ;
 	trans(0, 3) = -(point.x) ; trans(1, 3) = -(point.y) ; trans(2, 3) = -(point.z) ;	
-	pcl::transformPointCloud(*cloud, *cloud, trans);
+	Types::CloudTransform::transformInPlace(*cloud, trans);
 	out_cloud_xyz.write(cloud);
 }
 
 void CenterOfMass::compute_xyzrgb() {
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
-	Eigen::Vector4f centroid;
-	pcl::compute3DCentroid(*cloud, centroid);  	
+	Types::CloudStatistics::Result stats;
+	Types::CloudStatistics::compute(*cloud, stats);
+	const Eigen::Vector4f & centroid = stats.centroid;  	
 	LOG(LTRACE) << "CenterOfMass: " << centroid[0] << " " << centroid[1] << " " << centroid[2] << " " << endl;
     pcl::PointXYZ point;
     point.x=centroid[0];
@@ -92,11 +131,114 @@ void CenterOfMass::compute_xyzrgb() {
 	//Define translation between clouds	
 	Eigen::Matrix4f trans = Eigen::Matrix4f::Identity() ;
 	trans(0, 3) = -(point.x) ; trans(1, 3) = -(point.y) ; trans(2, 3) = -(point.z) ;	
-	pcl::transformPointCloud(*cloud, *cloud, trans);
+	Types::CloudTransform::transformInPlace(*cloud, trans);
 	out_cloud_xyzrgb.write(cloud);
 }
 
+void CenterOfMass::compute_soa_xyzsift() {
+	Types::SoACloud<PointXYZSIFT>::Ptr cloud = in_soa_xyzsift.read();
+	Types::CloudStatistics::Result stats;
+	Types::CloudStatistics::compute(*cloud, stats);
+	const Eigen::Vector4f & centroid = stats.centroid;
+	LOG(LTRACE) << "CenterOfMass: " << centroid[0] << " " << centroid[1] << " " << centroid[2] << " " << endl;
+    pcl::PointXYZ point;
+    point.x=centroid[0];
+    point.y=centroid[1];
+    point.z=centroid[2];
+	out_centroid.write(centroid);
+	out_point.write(point);
+
+	//Define translation between clouds, only coordinate arrays are moved
+	Eigen::Matrix4f trans = Eigen::Matrix4f::Identity() ;
+	trans(0, 3) = -(point.x) ; trans(1, 3) = -(point.y) ; trans(2, 3) = -(point.z) ;
+	Types::CloudTransform::transformInPlace(*cloud, trans);
+	out_soa_xyzsift.write(cloud);
+}
+
+void CenterOfMass::compute_posed_xyz() {
+	compute_posed<pcl::PointXYZ>(in_posed_cloud_xyz, out_posed_cloud_xyz);
+}
+
+void CenterOfMass::compute_posed_xyzrgb() {
+	compute_posed<pcl::PointXYZRGB>(in_posed_cloud_xyzrgb, out_posed_cloud_xyzrgb);
+}
+
+template <typename PointT>
+void CenterOfMass::compute_posed(Base::DataStreamIn<typename Types::PosedCloud<PointT>::Ptr> & in,
+		Base::DataStreamOut<typename Types::PosedCloud<PointT>::Ptr> & out) {
+	typename Types::PosedCloud<PointT>::Ptr cloud = in.read();
+	if (!cloud || cloud->empty())
+		return;
 
+	// Centroid of the cloud in its own coordinates, moved by the pose.
+	Eigen::Vector4f centroid;
+	pcl::compute3DCentroid(*cloud->cloud(), centroid);
+	centroid[3] = 1;
+	centroid = cloud->pose() * centroid;
+	LOG(LTRACE) << "CenterOfMass: " << centroid[0] << " " << centroid[1] << " " << centroid[2] << " " << endl;
+    pcl::PointXYZ point;
+    point.x=centroid[0];
+    point.y=centroid[1];
+    point.z=centroid[2];
+	out_centroid.write(centroid);
+	out_point.write(point);
+
+	//Define translation between clouds, applied to the pose only
+	Eigen::Matrix4f trans = Eigen::Matrix4f::Identity() ;
+	trans(0, 3) = -(point.x) ; trans(1, 3) = -(point.y) ; trans(2, 3) = -(point.z) ;
+	out.write(cloud->transformed(trans));
+}
+
+/// Centers of mass of clouds of a batch, clouds are moved to have them at the origin.
+template <typename PointT>
+struct BatchCenter {
+	BatchCenter(const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds_, std::vector<pcl::PointXYZ> & points_) :
+		clouds(clouds_), points(points_) {
+	}
+
+	void operator()(int i, int) {
+		if (!clouds[i])
+			return;
+		Types::CloudStatistics::Result stats;
+		Types::CloudStatistics::compute(*clouds[i], stats, false, false);
+		if (stats.count == 0)
+			return;
+		pcl::PointXYZ & point = points[i];
+		point.x = stats.centroid[0];
+		point.y = stats.centroid[1];
+		point.z = stats.centroid[2];
+
+		Eigen::Matrix4f trans = Eigen::Matrix4f::Identity();
+		trans(0, 3) = -(point.x) ; trans(1, 3) = -(point.y) ; trans(2, 3) = -(point.z) ;
+		Types::CloudTransform::transformInPlace(*clouds[i], trans, false);
+	}
+
+	const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds;
+	std::vector<pcl::PointXYZ> & points;
+};
+
+template <typename PointT>
+void CenterOfMass::compute_batch(Base::DataStreamIn<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & in,
+		Base::DataStreamOut<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & out) {
+	std::vector<typename pcl::PointCloud<PointT>::Ptr> clouds = in.read();
+	std::vector<pcl::PointXYZ> points(clouds.size());
+
+	BatchCenter<PointT> center(clouds, points);
+	Types::CloudBatch::forEach(clouds.size(), center);
+	LOG(LTRACE) << "CenterOfMass: centers of " << clouds.size() << " clouds";
+	profiler.points(Types::CloudBatch::points<PointT>(clouds), points.size());
+
+	out_points.write(points);
+	out.write(clouds);
+}
+
+void CenterOfMass::compute_clouds_xyz() {
+	compute_batch<pcl::PointXYZ>(in_clouds_xyz, out_clouds_xyz);
+}
+
+void CenterOfMass::compute_clouds_xyzrgb() {
+	compute_batch<pcl::PointXYZRGB>(in_clouds_xyzrgb, out_clouds_xyzrgb);
+}
 
 } //: namespace CenterOfMass
 } //: namespace Processors
@@ -13,11 +13,18 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
 
 #include <pcl/common/common.h>
 #include <pcl/common/transforms.h>
+
+#include <Types/PosedCloud.hpp>
+#include <Types/PointXYZSIFT.hpp>
+#include <Types/SoACloud.hpp>
+
 namespace Processors {
 namespace CenterOfMass {
 
@@ -72,14 +79,32 @@ protected:
 	// Input data streams
 	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_cloud_xyz;
 	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
+	Base::DataStreamIn<Types::PosedCloud<pcl::PointXYZ>::Ptr> in_posed_cloud_xyz;
+	Base::DataStreamIn<Types::PosedCloud<pcl::PointXYZRGB>::Ptr> in_posed_cloud_xyzrgb;
+	Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > in_clouds_xyz;
+	Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > in_clouds_xyzrgb;
+	/// XYZSIFT cloud split into coordinate arrays, centered without reading descriptors.
+	Base::DataStreamIn<Types::SoACloud<PointXYZSIFT>::Ptr> in_soa_xyzsift;
 	// Output data streams
 	Base::DataStreamOut<Eigen::Vector4f> out_centroid;
 	Base::DataStreamOut<pcl::PointXYZ> out_point;
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
+	Base::DataStreamOut<Types::PosedCloud<pcl::PointXYZ>::Ptr> out_posed_cloud_xyz;
+	Base::DataStreamOut<Types::PosedCloud<pcl::PointXYZRGB>::Ptr> out_posed_cloud_xyzrgb;
+	/// Centers of mass of clouds of in_clouds_*, in order of clouds.
+	Base::DataStreamOut<std::vector<pcl::PointXYZ> > out_points;
+	Base::DataStreamOut<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > out_clouds_xyz;
+	Base::DataStreamOut<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > out_clouds_xyzrgb;
+	Base::DataStreamOut<Types::SoACloud<PointXYZSIFT>::Ptr> out_soa_xyzsift;
 	// Handlers
 	Base::EventHandler2 h_compute;
 	Base::EventHandler2 h_compute_xyzrgb;
+	Base::EventHandler2 h_compute_posed_xyz;
+	Base::EventHandler2 h_compute_posed_xyzrgb;
+	Base::EventHandler2 h_compute_clouds_xyz;
+	Base::EventHandler2 h_compute_clouds_xyzrgb;
+	Base::EventHandler2 h_compute_soa_xyzsift;
 
 	// Properties
 
@@ -87,6 +112,30 @@ protected:
 	// Handlers
 	void compute();
 	void compute_xyzrgb();
+	void compute_posed_xyz();
+	void compute_posed_xyzrgb();
+	void compute_clouds_xyz();
+	void compute_clouds_xyzrgb();
+	void compute_soa_xyzsift();
+
+	/// Re-centers posed cloud by changing only its pose.
+	template <typename PointT>
+	void compute_posed(Base::DataStreamIn<typename Types::PosedCloud<PointT>::Ptr> & in,
+			Base::DataStreamOut<typename Types::PosedCloud<PointT>::Ptr> & out);
+
+	/// Re-centers all clouds of the vector (e.g. clusters) in parallel.
+	template <typename PointT>
+	void compute_batch(Base::DataStreamIn<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & in,
+			Base::DataStreamOut<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & out);
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
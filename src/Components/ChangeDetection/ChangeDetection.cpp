@@ -0,0 +1,124 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#include <memory>
+#include <string>
+
+#include "ChangeDetection.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace ChangeDetection {
+
+ChangeDetection::ChangeDetection(const std::string & name) :
+		Base::Component(name) ,
+		x("LeafSize.x", 0.02f),
+		y("LeafSize.y", 0.02f),
+		z("LeafSize.z", 0.02f),
+		min_points("min_points", 3),
+		threshold("threshold", 0.01f),
+		min_voxels("min_voxels", 10),
+		refresh("refresh", 0),
+		skipped(0),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(x);
+	registerProperty(y);
+	registerProperty(z);
+	registerProperty(min_points);
+	registerProperty(threshold);
+	registerProperty(min_voxels);
+	registerProperty(refresh);
+	registerProperty(profile);
+	registerProperty(profile_period);
+}
+
+ChangeDetection::~ChangeDetection() {
+}
+
+void ChangeDetection::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_cloud_xyz", &in_cloud_xyz);
+	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
+	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
+	registerStream("out_changed", &out_changed);
+	registerStream("out_indices", &out_indices);
+
+	// Register handlers
+	registerHandler("detect_xyz", profiler.wrap("detect_xyz", boost::bind(&ChangeDetection::detect_xyz, this)));
+	addDependency("detect_xyz", &in_cloud_xyz);
+	registerHandler("detect_xyzrgb", profiler.wrap("detect_xyzrgb", boost::bind(&ChangeDetection::detect_xyzrgb, this)));
+	addDependency("detect_xyzrgb", &in_cloud_xyzrgb);
+}
+
+bool ChangeDetection::onInit() {
+	profiler.setEnabled(profile, profile_period);
+
+	return true;
+}
+
+bool ChangeDetection::onFinish() {
+	profiler.report();
+	return true;
+}
+
+bool ChangeDetection::onStop() {
+	return true;
+}
+
+bool ChangeDetection::onStart() {
+	// Scene may have changed while stopped.
+	detector_xyz.reset();
+	detector_xyzrgb.reset();
+	skipped = 0;
+	return true;
+}
+
+template <typename PointT>
+void ChangeDetection::detect(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::ChangeDetector & detector,
+		Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out) {
+	if (!cloud)
+		return;
+
+	detector.setLeafSize(x, y, z);
+	detector.setMinPoints(min_points);
+	detector.setThreshold(threshold, min_voxels);
+
+	pcl::PointIndices::Ptr indices(new pcl::PointIndices);
+	indices->header = cloud->header;
+	const bool changed = detector.detect(*cloud, indices->indices);
+	CLOG(LDEBUG) << "Cloud of " << cloud->size() << " points: " << detector.newVoxels() << " new, "
+			<< detector.vanishedVoxels() << " vanished of " << detector.occupiedVoxels() << " voxels"
+			<< (changed ? ", scene changed" : "");
+	profiler.points(cloud->size(), indices->indices.size());
+
+	out_changed.write(changed);
+	out_indices.write(indices);
+
+	// Unchanged clouds are not forwarded, so connected components do not run.
+	++skipped;
+	if (changed || (refresh > 0 && skipped >= refresh)) {
+		skipped = 0;
+		out.write(cloud);
+	}
+}
+
+void ChangeDetection::detect_xyz() {
+	CLOG(LTRACE) << "ChangeDetection::detect_xyz";
+	detect<pcl::PointXYZ>(in_cloud_xyz.read(), detector_xyz, out_cloud_xyz);
+}
+
+void ChangeDetection::detect_xyzrgb() {
+	CLOG(LTRACE) << "ChangeDetection::detect_xyzrgb";
+	detect<pcl::PointXYZRGB>(in_cloud_xyzrgb.read(), detector_xyzrgb, out_cloud_xyzrgb);
+}
+
+} //: namespace ChangeDetection
+} //: namespace Processors
@@ -0,0 +1,146 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#ifndef CHANGEDETECTION_HPP_
+#define CHANGEDETECTION_HPP_
+
+#include "Component_Aux.hpp"
+#include "Component.hpp"
+#include "DataStream.hpp"
+#include "Property.hpp"
+#include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+
+#include "Types/ChangeDetector.hpp"
+
+
+namespace Processors {
+namespace ChangeDetection {
+
+/*!
+ * \class ChangeDetection
+ * \brief ChangeDetection processor class.
+ *
+ * Compares every cloud of a static camera with the last changed one (see
+ * Types::ChangeDetector) and publishes whether the scene changed and the
+ * indices of points in new voxels. Clouds are forwarded only when the scene
+ * changed (and every refresh clouds, if set), so components connected after
+ * this one skip static frames.
+ */
+class ChangeDetection: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	ChangeDetection(const std::string & name = "ChangeDetection");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~ChangeDetection();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_cloud_xyz;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
+
+	// Output data streams - clouds forwarded when the scene changed
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
+
+	/// True if the last cloud changed the scene, written for every cloud.
+	Base::DataStreamOut<bool> out_changed;
+
+	/// Indices of points of the last cloud in new voxels, written for every cloud.
+	Base::DataStreamOut<pcl::PointIndices::Ptr> out_indices;
+
+	// Properties
+	Base::Property<float> x;
+	Base::Property<float> y;
+	Base::Property<float> z;
+
+	/// Property: points making a voxel occupied.
+	Base::Property<int> min_points;
+
+	/// Property: fraction of occupied voxels that must change.
+	Base::Property<float> threshold;
+
+	/// Property: least number of voxels that must change.
+	Base::Property<int> min_voxels;
+
+	/// Property: clouds after which an unchanged cloud is forwarded anyway, 0 - never.
+	Base::Property<int> refresh;
+
+	// Handlers
+	void detect_xyz();
+	void detect_xyzrgb();
+
+	/// Compares the cloud with the reference and writes the outputs.
+	template <typename PointT>
+	void detect(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::ChangeDetector & detector,
+			Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out);
+
+	/// Detectors of all point types.
+	Types::ChangeDetector detector_xyz;
+	Types::ChangeDetector detector_xyzrgb;
+
+	/// Clouds not forwarded since the last forwarded one.
+	int skipped;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+};
+
+} //: namespace ChangeDetection
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("ChangeDetection", Processors::ChangeDetection::ChangeDetection)
+
+#endif /* CHANGEDETECTION_HPP_ */
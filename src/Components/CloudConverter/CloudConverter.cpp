@@ -12,13 +12,21 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/CloudConversion.hpp"
+
 
 
 namespace Processors {
 namespace CloudConverter {
 
 CloudConverter::CloudConverter(const std::string & name) :
-		Base::Component(name)  {
+		Base::Component(name),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(profile);
+	registerProperty(profile_period);
 
 }
 
@@ -30,26 +38,38 @@ void CloudConverter::prepareInterface() {
 	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
 	registerStream("in_cloud_xyzsift", &in_cloud_xyzsift);
 	registerStream("in_cloud_xyzshot", &in_cloud_xyzshot);
+	registerStream("in_split_xyzsift", &in_split_xyzsift);
+	registerStream("in_soa_xyzsift", &in_soa_xyzsift);
 	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("out_soa_xyzsift", &out_soa_xyzsift);
+	registerStream("out_cloud_xyzsift", &out_cloud_xyzsift);
 	// Register handlers
-	h_convert_xyzrgb.setup(boost::bind(&CloudConverter::convert_xyzrgb, this));
+	h_convert_xyzrgb.setup(profiler.wrap("convert_xyzrgb", boost::bind(&CloudConverter::convert_xyzrgb, this)));
 	registerHandler("convert_xyzrgb", &h_convert_xyzrgb);
 	addDependency("convert_xyzrgb", &in_cloud_xyzrgb);
-	h_convert_xyzsift.setup(boost::bind(&CloudConverter::convert_xyzsift, this));
+	h_convert_xyzsift.setup(profiler.wrap("convert_xyzsift", boost::bind(&CloudConverter::convert_xyzsift, this)));
 	registerHandler("convert_xyzsift", &h_convert_xyzsift);
 	addDependency("convert_xyzsift", &in_cloud_xyzsift);
-	h_convert_xyzshot.setup(boost::bind(&CloudConverter::convert_xyzshot, this));
+	h_convert_xyzshot.setup(profiler.wrap("convert_xyzshot", boost::bind(&CloudConverter::convert_xyzshot, this)));
 	registerHandler("convert_xyzshot", &h_convert_xyzshot);
 	addDependency("convert_xyzshot", &in_cloud_xyzshot);
+	h_split_xyzsift.setup(profiler.wrap("split_xyzsift", boost::bind(&CloudConverter::split_xyzsift, this)));
+	registerHandler("split_xyzsift", &h_split_xyzsift);
+	addDependency("split_xyzsift", &in_split_xyzsift);
+	h_gather_xyzsift.setup(profiler.wrap("gather_xyzsift", boost::bind(&CloudConverter::gather_xyzsift, this)));
+	registerHandler("gather_xyzsift", &h_gather_xyzsift);
+	addDependency("gather_xyzsift", &in_soa_xyzsift);
 
 }
 
 bool CloudConverter::onInit() {
+	profiler.setEnabled(profile, profile_period);
 
 	return true;
 }
 
 bool CloudConverter::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -63,25 +83,40 @@ bool CloudConverter::onStart() {
 
 void CloudConverter::convert_xyzrgb() {
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_xyzrgb  = in_cloud_xyzrgb.read();
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz  (new pcl::PointCloud<pcl::PointXYZ>());
-    pcl::copyPointCloud(*cloud_xyzrgb, *cloud_xyz);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz = Types::CloudPool<pcl::PointXYZ>::acquire(cloud_xyzrgb->size());
+    Types::CloudConversion::toXYZ(*cloud_xyzrgb, *cloud_xyz);
     out_cloud_xyz.write(cloud_xyz);
 }
 
 void CloudConverter::convert_xyzsift() {
     pcl::PointCloud<PointXYZSIFT>::Ptr cloud_xyzsift  = in_cloud_xyzsift.read();
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz  (new pcl::PointCloud<pcl::PointXYZ>());
-    pcl::copyPointCloud(*cloud_xyzsift, *cloud_xyz);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz = Types::CloudPool<pcl::PointXYZ>::acquire(cloud_xyzsift->size());
+    Types::CloudConversion::toXYZ(*cloud_xyzsift, *cloud_xyz);
     out_cloud_xyz.write(cloud_xyz);
 }
 
 void CloudConverter::convert_xyzshot() {
     pcl::PointCloud<PointXYZSHOT>::Ptr cloud_xyzshot  = in_cloud_xyzshot.read();
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz  (new pcl::PointCloud<pcl::PointXYZ>());
-    pcl::copyPointCloud(*cloud_xyzshot, *cloud_xyz);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz = Types::CloudPool<pcl::PointXYZ>::acquire(cloud_xyzshot->size());
+    Types::CloudConversion::toXYZ(*cloud_xyzshot, *cloud_xyz);
     out_cloud_xyz.write(cloud_xyz);
 }
 
+void CloudConverter::split_xyzsift() {
+    pcl::PointCloud<PointXYZSIFT>::Ptr cloud_xyzsift = in_split_xyzsift.read();
+    Types::SoACloud<PointXYZSIFT>::Ptr soa(new Types::SoACloud<PointXYZSIFT>(cloud_xyzsift));
+    profiler.points(cloud_xyzsift->size(), soa->size());
+    out_soa_xyzsift.write(soa);
+}
+
+void CloudConverter::gather_xyzsift() {
+    Types::SoACloud<PointXYZSIFT>::Ptr soa = in_soa_xyzsift.read();
+    pcl::PointCloud<PointXYZSIFT>::Ptr cloud_xyzsift = Types::CloudPool<PointXYZSIFT>::acquire(soa->size());
+    soa->toCloud(*cloud_xyzsift);
+    profiler.points(soa->size(), cloud_xyzsift->size());
+    out_cloud_xyzsift.write(cloud_xyzsift);
+}
+
 
 
 } //: namespace CloudConverter
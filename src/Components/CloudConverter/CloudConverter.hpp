@@ -13,8 +13,11 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <Types/PointXYZSIFT.hpp>
 #include <Types/PointXYZSHOT.hpp>
+#include <Types/SoACloud.hpp>
 
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
@@ -75,13 +78,23 @@ protected:
 	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT>::Ptr> in_cloud_xyzsift;
 	Base::DataStreamIn<pcl::PointCloud<PointXYZSHOT>::Ptr> in_cloud_xyzshot;
 
+	/// XYZSIFT cloud to be split into coordinate arrays.
+	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT>::Ptr> in_split_xyzsift;
+
+	/// Coordinate arrays to be gathered back into a XYZSIFT cloud.
+	Base::DataStreamIn<Types::SoACloud<PointXYZSIFT>::Ptr> in_soa_xyzsift;
+
 	// Output data streams
     Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<Types::SoACloud<PointXYZSIFT>::Ptr> out_soa_xyzsift;
+	Base::DataStreamOut<pcl::PointCloud<PointXYZSIFT>::Ptr> out_cloud_xyzsift;
 
 	// Handlers
 	Base::EventHandler2 h_convert_xyzrgb;
 	Base::EventHandler2 h_convert_xyzsift;
 	Base::EventHandler2 h_convert_xyzshot;
+	Base::EventHandler2 h_split_xyzsift;
+	Base::EventHandler2 h_gather_xyzsift;
 
 	// Properties
 
@@ -91,6 +104,21 @@ protected:
 	void convert_xyzsift();
 	void convert_xyzshot();
 
+	/// Splits a XYZSIFT cloud into coordinate arrays, descriptors stay in the cloud.
+	void split_xyzsift();
+
+	/// Gathers records of points left in the arrays, with their coordinates.
+	void gather_xyzsift();
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace CloudConverter
@@ -0,0 +1,124 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#include <memory>
+#include <string>
+
+#include "CloudGenerator.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+#include "Types/CloudPool.hpp"
+#include "Types/CaptureTime.hpp"
+
+namespace Processors {
+namespace CloudGenerator {
+
+CloudGenerator::CloudGenerator(const std::string & name) :
+		Base::Component(name),
+		primitives("primitives", std::string("plane 0 0 1 -2 2; sphere 0 0 1.5 0.3")),
+		nr_of_points("nr_of_points", 1000000),
+		outliers("outliers", 0.01f),
+		outliers_extent("outliers.extent", 3),
+		mi("noise.mi", 0),
+		sigma("noise.sigma", 0.002f),
+		seed("seed", 1),
+		static_scene("static", false),
+		rate("rate", 0),
+		color("color", false),
+		frame(0),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(primitives);
+	registerProperty(nr_of_points);
+	registerProperty(outliers);
+	registerProperty(outliers_extent);
+	registerProperty(mi);
+	registerProperty(sigma);
+	registerProperty(seed);
+	registerProperty(static_scene);
+	registerProperty(rate);
+	registerProperty(color);
+	registerProperty(profile);
+	registerProperty(profile_period);
+	nr_of_points.addConstraint("0");
+	nr_of_points.addConstraint("100000000");
+}
+
+CloudGenerator::~CloudGenerator() {
+}
+
+void CloudGenerator::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
+
+	// Register handlers
+	h_Generate.setup(profiler.wrap("Generate", boost::bind(&CloudGenerator::Generate, this)));
+	registerHandler("Generate", &h_Generate);
+}
+
+bool CloudGenerator::onInit() {
+	profiler.setEnabled(profile, profile_period);
+
+	if (!scene.parse(primitives))
+		CLOG(LWARNING) << "Malformed primitives \"" << std::string(primitives) << "\", using " << scene.primitives() << " of them";
+	return true;
+}
+
+bool CloudGenerator::onFinish() {
+	profiler.report();
+	return true;
+}
+
+bool CloudGenerator::onStop() {
+	return true;
+}
+
+bool CloudGenerator::onStart() {
+	// Sequence starts over, so every run of the task gets the same clouds.
+	frame = 0;
+	next_time = boost::posix_time::ptime();
+	return true;
+}
+
+void CloudGenerator::Generate() {
+	CLOG(LTRACE) << "CloudGenerator::Generate";
+
+	if (rate > 0) {
+		const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+		if (!next_time.is_not_a_date_time() && now < next_time)
+			return;
+		// Late clouds are not made up for, at most one per step.
+		const boost::posix_time::time_duration period = boost::posix_time::microseconds((int64_t) (1e6 / rate));
+		next_time = next_time.is_not_a_date_time() || now - next_time > period ? now + period : next_time + period;
+	}
+
+	scene.setNoise(mi, sigma);
+	scene.setOutliers(outliers, outliers_extent);
+	const size_t n = std::max(0, (int) nr_of_points);
+	const uint32_t f = static_scene ? 0 : frame++;
+	const uint64_t captured = Types::CaptureTime::now();
+
+	if (color) {
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = Types::CloudPool<pcl::PointXYZRGB>::acquire(n);
+		scene.generate(n, seed, f, *cloud);
+		Types::CaptureTime::stamp(*cloud, captured);
+		out_cloud_xyzrgb.write(cloud);
+	} else {
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = Types::CloudPool<pcl::PointXYZ>::acquire(n);
+		scene.generate(n, seed, f, *cloud);
+		Types::CaptureTime::stamp(*cloud, captured);
+		out_cloud_xyz.write(cloud);
+	}
+	CLOG(LDEBUG) << "Cloud " << f << " of " << n << " points";
+	profiler.points(0, n);
+}
+
+} //: namespace CloudGenerator
+} //: namespace Processors
@@ -0,0 +1,142 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#ifndef CLOUDGENERATOR_HPP_
+#define CLOUDGENERATOR_HPP_
+
+#include "Component_Aux.hpp"
+#include "Component.hpp"
+#include "DataStream.hpp"
+#include "Property.hpp"
+#include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "Types/SyntheticScene.hpp"
+
+namespace Processors {
+namespace CloudGenerator {
+
+/*!
+ * \class CloudGenerator
+ * \brief CloudGenerator processor class.
+ *
+ * Load generator: clouds of planes and spheres (see Types::SyntheticScene)
+ * with noise and outliers, generated in parallel and reproducible from the
+ * seed. One cloud is emitted per step of the executor, or at the given
+ * rate (steps coming too early are skipped, so the rate is at most the one
+ * of the executor).
+ */
+class CloudGenerator: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	CloudGenerator(const std::string & name = "CloudGenerator");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~CloudGenerator();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Output data streams
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
+
+	// Handlers
+	Base::EventHandler2 h_Generate;
+
+	void Generate();
+
+	/// Property: primitives of the scene, see Types::SyntheticScene.
+	Base::Property<std::string> primitives;
+
+	/// Property: points of every cloud.
+	Base::Property<int> nr_of_points;
+
+	/// Property: fraction of outliers and half of the side of their cube around the origin.
+	Base::Property<float> outliers;
+	Base::Property<float> outliers_extent;
+
+	/// Property: Gaussian noise of points of primitives.
+	Base::Property<float> mi;
+	Base::Property<float> sigma;
+
+	/// Property: seed of the random streams, the same seed gives the same sequence of clouds.
+	Base::Property<int> seed;
+
+	/// Property: emit the same cloud (the first one of the sequence) every time.
+	Base::Property<bool> static_scene;
+
+	/// Property: clouds per second, 0 - one per step of the executor.
+	Base::Property<float> rate;
+
+	/// Property: emit XYZRGB clouds (colored by primitive) instead of XYZ ones.
+	Base::Property<bool> color;
+
+	Types::SyntheticScene scene;
+
+	/// Number of the next cloud of the sequence.
+	uint32_t frame;
+
+	/// Time of the next cloud at the given rate.
+	boost::posix_time::ptime next_time;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+};
+
+} //: namespace CloudGenerator
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("CloudGenerator", Processors::CloudGenerator::CloudGenerator)
+
+#endif /* CLOUDGENERATOR_HPP_ */
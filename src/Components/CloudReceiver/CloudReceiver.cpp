@@ -0,0 +1,168 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#include <memory>
+#include <string>
+
+#include "CloudReceiver.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace CloudReceiver {
+
+CloudReceiver::CloudReceiver(const std::string & name) :
+		Base::Component(name),
+		host("host", std::string("localhost")),
+		port("port", 5555),
+		retry("retry", 1),
+		stats_period("stats.period", 5),
+		running(false),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(host);
+	registerProperty(port);
+	registerProperty(retry);
+	registerProperty(stats_period);
+	registerProperty(profile);
+	registerProperty(profile_period);
+}
+
+CloudReceiver::~CloudReceiver() {
+}
+
+void CloudReceiver::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
+	registerStream("out_cloud_xyzsift", &out_cloud_xyzsift);
+
+	// Register handlers
+	h_Receive.setup(profiler.wrap("Receive", boost::bind(&CloudReceiver::Receive, this)));
+	registerHandler("Receive", &h_Receive);
+}
+
+bool CloudReceiver::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	return true;
+}
+
+bool CloudReceiver::onFinish() {
+	profiler.report();
+	onStop();
+	return true;
+}
+
+bool CloudReceiver::onStop() {
+	if (!thread)
+		return true;
+	running = false;
+	client.interrupt();
+	thread->join();
+	thread.reset();
+	client.close();
+	if (counters.frames > 0)
+		CLOG(LINFO) << "Received " << counters.report(true);
+	return true;
+}
+
+bool CloudReceiver::onStart() {
+	counters.reset();
+	running = true;
+	thread.reset(new boost::thread(boost::bind(&CloudReceiver::run, this)));
+	return true;
+}
+
+void CloudReceiver::Receive() {
+	CLOG(LTRACE) << "CloudReceiver::Receive";
+
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz;
+	if (latest_xyz.take(cloud_xyz)) {
+		out_cloud_xyz.write(cloud_xyz);
+		profiler.points(0, cloud_xyz->size());
+	}
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_xyzrgb;
+	if (latest_xyzrgb.take(cloud_xyzrgb)) {
+		out_cloud_xyzrgb.write(cloud_xyzrgb);
+		profiler.points(0, cloud_xyzrgb->size());
+	}
+	pcl::PointCloud<PointXYZSIFT>::Ptr cloud_xyzsift;
+	if (latest_xyzsift.take(cloud_xyzsift)) {
+		out_cloud_xyzsift.write(cloud_xyzsift);
+		profiler.points(0, cloud_xyzsift->size());
+	}
+}
+
+void CloudReceiver::run() {
+	while (running) {
+		if (!client.connected()) {
+			std::string error;
+			if (!client.connect(host, port, error)) {
+				CLOG(LDEBUG) << "Cannot connect to " << std::string(host) << ":" << port << ": " << error;
+				// Sleeps in short steps, so stopping is not delayed.
+				for (int ms = 0; running && ms < retry * 1000; ms += 100)
+					boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+				continue;
+			}
+			CLOG(LINFO) << "Connected to " << std::string(host) << ":" << port;
+			// The sender starts all streams of a new receiver with key frames.
+			decoder_xyz.reset();
+			decoder_xyzrgb.reset();
+			decoder_xyzsift.reset();
+		}
+
+		if (!client.receive(frame)) {
+			client.close();
+			if (running)
+				CLOG(LWARNING) << "Connection to " << std::string(host) << ":" << port << " lost";
+			continue;
+		}
+
+		Types::CloudCodec::FrameInfo info;
+		bool decoded = false;
+		if (Types::CloudCodec::readHeader(frame.empty() ? NULL : &frame[0], frame.size(), info)) {
+			switch (info.type) {
+			case Types::CloudCodec::Attributes<pcl::PointXYZ>::TYPE:
+				decoded = decode(decoder_xyz, latest_xyz, info);
+				break;
+			case Types::CloudCodec::Attributes<pcl::PointXYZRGB>::TYPE:
+				decoded = decode(decoder_xyzrgb, latest_xyzrgb, info);
+				break;
+			case Types::CloudCodec::Attributes<PointXYZSIFT>::TYPE:
+				decoded = decode(decoder_xyzsift, latest_xyzsift, info);
+				break;
+			}
+		}
+		// Delta frames after a lost or broken frame are skipped until the next key frame.
+		if (!decoded)
+			CLOG(LDEBUG) << "Frame of " << frame.size() << " bytes skipped";
+
+		if (stats_period > 0 && counters.elapsed() >= stats_period) {
+			CLOG(LINFO) << "Received " << counters.report(true);
+			counters.reset();
+		}
+	}
+}
+
+template <typename PointT>
+bool CloudReceiver::decode(Types::CloudCodec::Decoder<PointT> & decoder, Types::LatestValue<typename pcl::PointCloud<PointT>::Ptr> & latest,
+		Types::CloudCodec::FrameInfo & info) {
+	const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	// New cloud every frame, the previous one may still be used by the pipeline.
+	typename pcl::PointCloud<PointT>::Ptr cloud(new pcl::PointCloud<PointT>);
+	if (!decoder.decode(&frame[0], frame.size(), *cloud, info))
+		return false;
+	const double seconds = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1e-6;
+	const double latency = ((int64_t) Types::linkTime() - (int64_t) info.timestamp) * 1e-6;
+	counters.add(cloud->size() * sizeof(PointT), frame.size(), info.key(), seconds, latency);
+	latest.write(cloud);
+	return true;
+}
+
+} //: namespace CloudReceiver
+} //: namespace Processors
@@ -0,0 +1,156 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#ifndef CLOUDRECEIVER_HPP_
+#define CLOUDRECEIVER_HPP_
+
+#include "Component_Aux.hpp"
+#include "Component.hpp"
+#include "DataStream.hpp"
+#include "Property.hpp"
+#include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/atomic.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Types/PointXYZSIFT.hpp>
+
+#include "Types/LatestValue.hpp"
+#include "Types/CloudCodec.hpp"
+#include "Types/CloudLink.hpp"
+
+namespace Processors {
+namespace CloudReceiver {
+
+/*!
+ * \class CloudReceiver
+ * \brief CloudReceiver processor class.
+ *
+ * Receives clouds streamed by a CloudSender of another node. A network
+ * thread connects to the sender (and reconnects when the link breaks),
+ * decodes frames and passes the newest cloud of every type to the
+ * executor, which emits it at its next step; clouds that come faster than
+ * the pipeline takes them are skipped.
+ */
+class CloudReceiver: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	CloudReceiver(const std::string & name = "CloudReceiver");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~CloudReceiver();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Output data streams
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
+	Base::DataStreamOut<pcl::PointCloud<PointXYZSIFT>::Ptr> out_cloud_xyzsift;
+
+	// Handlers
+	Base::EventHandler2 h_Receive;
+
+	/// Emits clouds received since the last step.
+	void Receive();
+
+	/// Network thread.
+	void run();
+
+	/// Decodes the frame into a new cloud and passes it to the executor.
+	template <typename PointT>
+	bool decode(Types::CloudCodec::Decoder<PointT> & decoder, Types::LatestValue<typename pcl::PointCloud<PointT>::Ptr> & latest,
+			Types::CloudCodec::FrameInfo & info);
+
+	/// Property: host of the sender.
+	Base::Property<std::string> host;
+
+	/// Property: port of the sender.
+	Base::Property<int> port;
+
+	/// Property: seconds between attempts to connect.
+	Base::Property<float> retry;
+
+	/// Property: seconds between logged statistics of the link, 0 - only when the task stops.
+	Base::Property<float> stats_period;
+
+	Types::CloudClient client;
+
+	boost::shared_ptr<boost::thread> thread;
+	boost::atomic<bool> running;
+
+	/// Frame being decoded.
+	Types::CloudCodec::Buffer frame;
+
+	// Decoders of streams, used only by the network thread.
+	Types::CloudCodec::Decoder<pcl::PointXYZ> decoder_xyz;
+	Types::CloudCodec::Decoder<pcl::PointXYZRGB> decoder_xyzrgb;
+	Types::CloudCodec::Decoder<PointXYZSIFT> decoder_xyzsift;
+
+	// Newest decoded clouds.
+	Types::LatestValue<pcl::PointCloud<pcl::PointXYZ>::Ptr> latest_xyz;
+	Types::LatestValue<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> latest_xyzrgb;
+	Types::LatestValue<pcl::PointCloud<PointXYZSIFT>::Ptr> latest_xyzsift;
+
+	/// Traffic since the last report, updated by the network thread.
+	Types::LinkCounters counters;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+};
+
+} //: namespace CloudReceiver
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("CloudReceiver", Processors::CloudReceiver::CloudReceiver)
+
+#endif /* CLOUDRECEIVER_HPP_ */
@@ -0,0 +1,163 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#include <memory>
+#include <string>
+
+#include "CloudSender.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+
+namespace Processors {
+namespace CloudSender {
+
+CloudSender::CloudSender(const std::string & name) :
+		Base::Component(name),
+		port("port", 5555),
+		resolution("resolution", 0.001f),
+		key_interval("key_interval", 30),
+		bandwidth("bandwidth", 100),
+		prop_queue_size("queue.size", 1),
+		prop_queue_block("queue.block", false),
+		stats_period("stats.period", 5),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(port);
+	registerProperty(resolution);
+	registerProperty(key_interval);
+	registerProperty(bandwidth);
+	registerProperty(prop_queue_size);
+	registerProperty(prop_queue_block);
+	registerProperty(stats_period);
+	registerProperty(profile);
+	registerProperty(profile_period);
+}
+
+CloudSender::~CloudSender() {
+}
+
+void CloudSender::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_cloud_xyz", &in_cloud_xyz);
+	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
+	registerStream("in_cloud_xyzsift", &in_cloud_xyzsift);
+	registerStream("out_dropped", &out_dropped);
+
+	// Register handlers
+	registerHandler("send_xyz", profiler.wrap("send_xyz", boost::bind(&CloudSender::send_xyz, this)));
+	addDependency("send_xyz", &in_cloud_xyz);
+	registerHandler("send_xyzrgb", profiler.wrap("send_xyzrgb", boost::bind(&CloudSender::send_xyzrgb, this)));
+	addDependency("send_xyzrgb", &in_cloud_xyzrgb);
+	registerHandler("send_xyzsift", profiler.wrap("send_xyzsift", boost::bind(&CloudSender::send_xyzsift, this)));
+	addDependency("send_xyzsift", &in_cloud_xyzsift);
+}
+
+bool CloudSender::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	return true;
+}
+
+bool CloudSender::onFinish() {
+	profiler.report();
+	queue.stop();
+	server.stop();
+	return true;
+}
+
+bool CloudSender::onStop() {
+	// Send everything that is queued.
+	queue.stop();
+	server.stop();
+	if (counters.frames > 0)
+		CLOG(LINFO) << "Sent " << counters.report(false);
+	if (queue.dropped() > 0)
+		CLOG(LWARNING) << "Dropped " << queue.dropped() << " clouds, link was busy";
+	return true;
+}
+
+bool CloudSender::onStart() {
+	std::string error;
+	if (!server.start(port, error)) {
+		CLOG(LERROR) << "Cannot listen on port " << port << ": " << error;
+		return false;
+	}
+	CLOG(LINFO) << "Listening for receivers on port " << port;
+
+	encoder_xyz.setResolution(resolution);
+	encoder_xyzrgb.setResolution(resolution);
+	encoder_xyzsift.setResolution(resolution);
+	encoder_xyz.setKeyInterval(key_interval);
+	encoder_xyzrgb.setKeyInterval(key_interval);
+	encoder_xyzsift.setKeyInterval(key_interval);
+	next_time = boost::posix_time::ptime();
+	counters.reset();
+	queue.start(prop_queue_size);
+	return true;
+}
+
+void CloudSender::send_xyz() {
+	CLOG(LTRACE) << "CloudSender::send_xyz";
+	send<pcl::PointXYZ>(in_cloud_xyz.read(), encoder_xyz, "xyz");
+}
+
+void CloudSender::send_xyzrgb() {
+	CLOG(LTRACE) << "CloudSender::send_xyzrgb";
+	send<pcl::PointXYZRGB>(in_cloud_xyzrgb.read(), encoder_xyzrgb, "xyzrgb");
+}
+
+void CloudSender::send_xyzsift() {
+	CLOG(LTRACE) << "CloudSender::send_xyzsift";
+	send<PointXYZSIFT>(in_cloud_xyzsift.read(), encoder_xyzsift, "xyzsift");
+}
+
+template <typename PointT>
+void CloudSender::send(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::CloudCodec::Encoder<PointT> & encoder, const std::string & type) {
+	profiler.points(cloud->size(), 0);
+	// Sender keeps a reference to the cloud, so it is not reused before it is sent.
+	if (!queue.push(boost::bind(&CloudSender::transmit<PointT>, this, cloud, boost::ref(encoder)), prop_queue_block))
+		CLOG(LDEBUG) << "Link is busy, " << type << " cloud dropped";
+	out_dropped.write(queue.dropped());
+}
+
+template <typename PointT>
+bool CloudSender::transmit(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::CloudCodec::Encoder<PointT> & encoder) {
+	// New receivers cannot decode delta frames, all streams start over with key frames.
+	if (server.joined()) {
+		encoder_xyz.forceKeyFrame();
+		encoder_xyzrgb.forceKeyFrame();
+		encoder_xyzsift.forceKeyFrame();
+	}
+	if (server.clients() == 0)
+		return true;
+
+	const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	const bool key = encoder.encode(*cloud, Types::linkTime(), frame);
+	const boost::posix_time::ptime encoded = boost::posix_time::microsec_clock::universal_time();
+
+	if (bandwidth > 0) {
+		// Frames are spaced by the time they take at the given bandwidth.
+		if (!next_time.is_not_a_date_time() && encoded < next_time)
+			boost::this_thread::sleep(next_time - encoded);
+		const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+		next_time = (next_time.is_not_a_date_time() || now > next_time ? now : next_time)
+				+ boost::posix_time::microseconds((int64_t) (frame.size() / (double) bandwidth));
+	}
+	if (server.send(frame) == 0)
+		return false;
+
+	counters.add(cloud->size() * sizeof(PointT), frame.size(), key, (encoded - start).total_microseconds() * 1e-6);
+	if (stats_period > 0 && counters.elapsed() >= stats_period) {
+		CLOG(LINFO) << "Sent " << counters.report(false) << " to " << server.clients() << " receivers";
+		counters.reset();
+	}
+	return true;
+}
+
+} //: namespace CloudSender
+} //: namespace Processors
@@ -0,0 +1,167 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#ifndef CLOUDSENDER_HPP_
+#define CLOUDSENDER_HPP_
+
+#include "Component_Aux.hpp"
+#include "Component.hpp"
+#include "DataStream.hpp"
+#include "Property.hpp"
+#include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Types/PointXYZSIFT.hpp>
+
+#include "Types/WriteQueue.hpp"
+#include "Types/CloudCodec.hpp"
+#include "Types/CloudLink.hpp"
+
+namespace Processors {
+namespace CloudSender {
+
+/*!
+ * \class CloudSender
+ * \brief CloudSender processor class.
+ *
+ * Streams clouds to CloudReceivers of other nodes over TCP. Clouds are
+ * encoded (see Types::CloudCodec - quantized to the given resolution, delta
+ * coded against the previous cloud of the same type) and sent to all
+ * connected receivers by a sender thread, through a queue of queue.size
+ * clouds; when the link is slower than the clouds come, new clouds are
+ * dropped (or the executor waits if queue.block is set), so the pipeline is
+ * never stalled by the network. Sending is limited to the given bandwidth,
+ * e.g. below the 125 MB/s of a 1 GbE link shared with other traffic.
+ */
+class CloudSender: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	CloudSender(const std::string & name = "CloudSender");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~CloudSender();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyz;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzrgb;
+	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzsift;
+
+	/// Number of clouds dropped because the link was busy.
+	Base::DataStreamOut<int> out_dropped;
+
+	// Handlers
+	void send_xyz();
+	void send_xyzrgb();
+	void send_xyzsift();
+
+	/// Queues the cloud to be sent.
+	template <typename PointT>
+	void send(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::CloudCodec::Encoder<PointT> & encoder, const std::string & type);
+
+	/// Encodes and sends the cloud, executed by the sender thread.
+	template <typename PointT>
+	bool transmit(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::CloudCodec::Encoder<PointT> & encoder);
+
+	/// Property: port the receivers connect to.
+	Base::Property<int> port;
+
+	/// Property: quantization of coordinates in meters, 0 - exact coordinates.
+	Base::Property<float> resolution;
+
+	/// Property: clouds of a type between key frames (coded without the previous cloud).
+	Base::Property<int> key_interval;
+
+	/// Property: limit of the outgoing traffic in MB/s, 0 - no limit.
+	Base::Property<float> bandwidth;
+
+	/// Property: clouds waiting for the sender thread, 0 sends synchronously.
+	Base::Property<int> prop_queue_size;
+
+	/// Property: wait for the sender when queue is full instead of dropping the cloud.
+	Base::Property<bool> prop_queue_block;
+
+	/// Property: seconds between logged statistics of the link, 0 - only when the task stops.
+	Base::Property<float> stats_period;
+
+	/// Listening socket and connected receivers.
+	Types::CloudServer server;
+
+	/// Sender thread and its queue.
+	Types::WriteQueue queue;
+
+	// Encoders of streams, used only by the sender thread.
+	Types::CloudCodec::Encoder<pcl::PointXYZ> encoder_xyz;
+	Types::CloudCodec::Encoder<pcl::PointXYZRGB> encoder_xyzrgb;
+	Types::CloudCodec::Encoder<PointXYZSIFT> encoder_xyzsift;
+
+	/// Encoded frame, reused by the sender thread.
+	Types::CloudCodec::Buffer frame;
+
+	/// Time the bandwidth allows the next frame to be sent at.
+	boost::posix_time::ptime next_time;
+
+	/// Traffic since the last report, updated by the sender thread.
+	Types::LinkCounters counters;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+};
+
+} //: namespace CloudSender
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("CloudSender", Processors::CloudSender::CloudSender)
+
+#endif /* CLOUDSENDER_HPP_ */
@@ -0,0 +1,120 @@
+/*!
+ * \file
+ * \brief
+ * \author Michal Laszkowski
+ */
+
+#include <memory>
+#include <string>
+
+#include "CloudStatistics.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace CloudStatistics {
+
+CloudStatistics::CloudStatistics(const std::string & name) :
+		Base::Component(name),
+		obb("obb", false),
+		parallel("parallel", true),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(obb);
+	registerProperty(parallel);
+	registerProperty(profile);
+	registerProperty(profile_period);
+}
+
+CloudStatistics::~CloudStatistics() {
+}
+
+void CloudStatistics::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_cloud_xyz", &in_cloud_xyz);
+	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
+	registerStream("out_count", &out_count);
+	registerStream("out_centroid", &out_centroid);
+	registerStream("out_point", &out_point);
+	registerStream("out_min_pt", &out_min_pt);
+	registerStream("out_max_pt", &out_max_pt);
+	registerStream("out_covariance", &out_covariance);
+	registerStream("out_obb_pose", &out_obb_pose);
+	registerStream("out_obb_size", &out_obb_size);
+	// Register handlers
+	h_compute_xyz.setup(profiler.wrap("compute_xyz", boost::bind(&CloudStatistics::compute_xyz, this)));
+	registerHandler("compute_xyz", &h_compute_xyz);
+	addDependency("compute_xyz", &in_cloud_xyz);
+	h_compute_xyzrgb.setup(profiler.wrap("compute_xyzrgb", boost::bind(&CloudStatistics::compute_xyzrgb, this)));
+	registerHandler("compute_xyzrgb", &h_compute_xyzrgb);
+	addDependency("compute_xyzrgb", &in_cloud_xyzrgb);
+}
+
+bool CloudStatistics::onInit() {
+	profiler.setEnabled(profile, profile_period);
+
+	return true;
+}
+
+bool CloudStatistics::onFinish() {
+	profiler.report();
+	return true;
+}
+
+bool CloudStatistics::onStop() {
+	return true;
+}
+
+bool CloudStatistics::onStart() {
+	return true;
+}
+
+void CloudStatistics::compute_xyz() {
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
+	Types::CloudStatistics::Result result;
+	Types::CloudStatistics::compute(*cloud, result, obb, parallel);
+	publish(result);
+}
+
+void CloudStatistics::compute_xyzrgb() {
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
+	Types::CloudStatistics::Result result;
+	Types::CloudStatistics::compute(*cloud, result, obb, parallel);
+	publish(result);
+}
+
+void CloudStatistics::publish(const Types::CloudStatistics::Result & result) {
+	out_count.write(result.count);
+	if (result.count == 0) {
+		CLOG(LWARNING) << "CloudStatistics: cloud has no finite points";
+		return;
+	}
+
+	CLOG(LTRACE) << "CloudStatistics: " << result.count << " points, centroid " << result.centroid[0] << " " << result.centroid[1] << " " << result.centroid[2];
+	pcl::PointXYZ point, min_pt, max_pt;
+	point.x = result.centroid[0];
+	point.y = result.centroid[1];
+	point.z = result.centroid[2];
+	min_pt.x = result.min[0];
+	min_pt.y = result.min[1];
+	min_pt.z = result.min[2];
+	max_pt.x = result.max[0];
+	max_pt.y = result.max[1];
+	max_pt.z = result.max[2];
+
+	out_centroid.write(result.centroid);
+	out_point.write(point);
+	out_min_pt.write(min_pt);
+	out_max_pt.write(max_pt);
+	out_covariance.write(result.covariance);
+
+	if (obb) {
+		out_obb_pose.write(Types::HomogMatrix(result.obbPose()));
+		out_obb_size.write(result.obbSize());
+	}
+}
+
+} //: namespace CloudStatistics
+} //: namespace Processors
@@ -0,0 +1,126 @@
+/*!
+ * \file
+ * \brief 
+ * \author Michal Laszkowski
+ */
+
+#ifndef CLOUDSTATISTICS_HPP_
+#define CLOUDSTATISTICS_HPP_
+
+#include "Component_Aux.hpp"
+#include "Component.hpp"
+#include "DataStream.hpp"
+#include "Property.hpp"
+#include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+#include <Types/HomogMatrix.hpp>
+#include <Types/CloudStatistics.hpp>
+
+namespace Processors {
+namespace CloudStatistics {
+
+/*!
+ * \class CloudStatistics
+ * \brief CloudStatistics processor class.
+ *
+ * Computes point count, centroid, axis aligned bounding box and covariance
+ * of the cloud in a single pass, optionally also oriented bounding box.
+ */
+class CloudStatistics: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	CloudStatistics(const std::string & name = "CloudStatistics");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~CloudStatistics();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to 
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_cloud_xyz;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
+
+	// Output data streams
+	Base::DataStreamOut<int> out_count;
+	Base::DataStreamOut<Eigen::Vector4f> out_centroid;
+	Base::DataStreamOut<pcl::PointXYZ> out_point;
+	Base::DataStreamOut<pcl::PointXYZ> out_min_pt;
+	Base::DataStreamOut<pcl::PointXYZ> out_max_pt;
+	Base::DataStreamOut<Eigen::Matrix3f> out_covariance;
+	Base::DataStreamOut<Types::HomogMatrix> out_obb_pose;
+	Base::DataStreamOut<Eigen::Vector3f> out_obb_size;
+
+	// Handlers
+	Base::EventHandler2 h_compute_xyz;
+	Base::EventHandler2 h_compute_xyzrgb;
+
+	/// Property: compute oriented bounding box (costs second pass over the cloud).
+	Base::Property<bool> obb;
+
+	/// Property: split large clouds between threads.
+	Base::Property<bool> parallel;
+
+	// Handlers
+	void compute_xyz();
+	void compute_xyzrgb();
+
+	/// Writes all statistics to the output streams.
+	void publish(const Types::CloudStatistics::Result & result);
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+};
+
+} //: namespace CloudStatistics
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("CloudStatistics", Processors::CloudStatistics::CloudStatistics)
+
+#endif /* CLOUDSTATISTICS_HPP_ */
@@ -12,16 +12,28 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/CloudTransform.hpp"
+
 namespace Processors {
 namespace CloudTransformer {
 
 CloudTransformer::CloudTransformer(const std::string & name) :
 	Base::Component(name),
     pass_through("pass_through", false),
-    inverse("inverse", false)
+    inverse("inverse", false),
+    in_place("in_place", false),
+    lazy("lazy", false),
+    profile("profile", false),
+    profile_period("profile.period", 100),
+    profiler(name)
 {
 	registerProperty(pass_through);
     registerProperty(inverse);
+    registerProperty(in_place);
+    registerProperty(lazy);
+    registerProperty(profile);
+    registerProperty(profile_period);
 }
 
 CloudTransformer::~CloudTransformer() {
@@ -33,6 +45,7 @@ void CloudTransformer::prepareInterface() {
 	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
 	registerStream("in_cloud_xyzsift", &in_cloud_xyzsift);
 	registerStream("in_cloud_xyzshot", &in_cloud_xyzshot);
+	registerStream("in_cloud_xyzsift8", &in_cloud_xyzsift8);
 	registerStream("in_hm", &in_hm);
 
     registerStream("in_clouds_xyz", &in_clouds_xyz);
@@ -40,31 +53,41 @@ void CloudTransformer::prepareInterface() {
     registerStream("in_clouds_xyzsift", &in_clouds_xyzsift);
     registerStream("in_clouds_xyzshot", &in_clouds_xyzshot);
     registerStream("in_hms", &in_hms);
+    registerStream("in_posed_cloud_xyz", &in_posed_cloud_xyz);
+    registerStream("in_posed_cloud_xyzrgb", &in_posed_cloud_xyzrgb);
+    registerStream("in_soa_xyzsift", &in_soa_xyzsift);
 
     registerStream("out_cloud_xyz", &out_cloud_xyz);
     registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
     registerStream("out_cloud_xyzsift", &out_cloud_xyzsift);
     registerStream("out_cloud_xyzshot", &out_cloud_xyzshot);
+    registerStream("out_cloud_xyzsift8", &out_cloud_xyzsift8);
 
     registerStream("out_clouds_xyz", &out_clouds_xyz);
     registerStream("out_clouds_xyzrgb", &out_clouds_xyzrgb);
     registerStream("out_clouds_xyzsift", &out_clouds_xyzsift);
     registerStream("out_clouds_xyzshot", &out_clouds_xyzshot);
 
+    registerStream("out_posed_cloud_xyz", &out_posed_cloud_xyz);
+    registerStream("out_posed_cloud_xyzrgb", &out_posed_cloud_xyzrgb);
+    registerStream("out_soa_xyzsift", &out_soa_xyzsift);
+
 	// Register handlers
-	registerHandler("transform_clouds", boost::bind(&CloudTransformer::transform_clouds, this));
+	registerHandler("transform_clouds", profiler.wrap("transform_clouds", boost::bind(&CloudTransformer::transform_clouds, this)));
 	addDependency("transform_clouds", &in_hm);
 
-    registerHandler("transform_vector_of_clouds", boost::bind(&CloudTransformer::transform_vector_of_clouds, this));
+    registerHandler("transform_vector_of_clouds", profiler.wrap("transform_vector_of_clouds", boost::bind(&CloudTransformer::transform_vector_of_clouds, this)));
     addDependency("transform_vector_of_clouds", &in_hms);
 }
 
 bool CloudTransformer::onInit() {
+	profiler.setEnabled(profile, profile_period);
 
 	return true;
 }
 
 bool CloudTransformer::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -86,52 +109,64 @@ void CloudTransformer::transform_clouds() {
         Types::HomogMatrix hmi(hm.inverse());
         hm = hmi;
     }
+    const Eigen::Matrix4f m = hm;
 
     // Try to transform XYZ.
-    if(!in_cloud_xyz.empty())
-        transform_xyz(hm);
+    if(!in_cloud_xyz.empty()) {
+        if(lazy)
+            out_posed_cloud_xyz.write(Types::PosedCloud<pcl::PointXYZ>::create(in_cloud_xyz.read(), m));
+        else
+            transform_cloud<pcl::PointXYZ>(in_cloud_xyz, out_cloud_xyz, m);
+    }
 
     // Try to transform XYZRGB.
-    if(!in_cloud_xyzrgb.empty())
-        transform_xyzrgb(hm);
+    if(!in_cloud_xyzrgb.empty()) {
+        if(lazy)
+            out_posed_cloud_xyzrgb.write(Types::PosedCloud<pcl::PointXYZRGB>::create(in_cloud_xyzrgb.read(), m));
+        else
+            transform_cloud<pcl::PointXYZRGB>(in_cloud_xyzrgb, out_cloud_xyzrgb, m);
+    }
+
+    // Compose transformation with poses of posed clouds.
+    if(!in_posed_cloud_xyz.empty())
+        transform_posed<pcl::PointXYZ>(in_posed_cloud_xyz, out_posed_cloud_xyz, m);
+
+    if(!in_posed_cloud_xyzrgb.empty())
+        transform_posed<pcl::PointXYZRGB>(in_posed_cloud_xyzrgb, out_posed_cloud_xyzrgb, m);
 
     // Try to transform XYZSIFT.
     if(!in_cloud_xyzsift.empty())
-        transform_xyzsift(hm);
+        transform_cloud<PointXYZSIFT>(in_cloud_xyzsift, out_cloud_xyzsift, m);
 
     // Try to transform XYZSHOT.
     if(!in_cloud_xyzshot.empty())
-    	transform_xyzshot(hm);
+        transform_cloud<PointXYZSHOT>(in_cloud_xyzshot, out_cloud_xyzshot, m);
+
+    // Try to transform XYZSIFT with quantized descriptors.
+    if(!in_cloud_xyzsift8.empty())
+        transform_cloud<PointXYZSIFT8>(in_cloud_xyzsift8, out_cloud_xyzsift8, m);
+
+    // Try to transform XYZSIFT coordinate arrays.
+    if(!in_soa_xyzsift.empty())
+        transform_soa<PointXYZSIFT>(in_soa_xyzsift, out_soa_xyzsift, m);
 
     //Transform all clouds i vector by one transformation
 
     // Try to transform vector XYZ.
-    if(!in_clouds_xyz.empty()){
-        vector<Types::HomogMatrix> hms;
-        hms.push_back(hm);
-        transform_vector_xyz(hms);
-    }
+    if(!in_clouds_xyz.empty())
+        transform_vector<pcl::PointXYZ>(in_clouds_xyz, out_clouds_xyz, &m, 1);
 
     // Try to transform vector XYZRGB.
-    if(!in_clouds_xyzrgb.empty()){
-        vector<Types::HomogMatrix> hms;
-        hms.push_back(hm);
-        transform_vector_xyzrgb(hms);
-    }
+    if(!in_clouds_xyzrgb.empty())
+        transform_vector<pcl::PointXYZRGB>(in_clouds_xyzrgb, out_clouds_xyzrgb, &m, 1);
 
     // Try to transform vector XYZSIFT.
-    if(!in_clouds_xyzsift.empty()){
-        vector<Types::HomogMatrix> hms;
-        hms.push_back(hm);
-        transform_vector_xyzsift(hms);
-    }
+    if(!in_clouds_xyzsift.empty())
+        transform_vector<PointXYZSIFT>(in_clouds_xyzsift, out_clouds_xyzsift, &m, 1);
 
     // Try to transform vector XYZSHOT.
-    if(!in_clouds_xyzshot.empty()){
-        vector<Types::HomogMatrix> hms;
-        hms.push_back(hm);
-        transform_vector_xyzshot(hms);
-    }
+    if(!in_clouds_xyzshot.empty())
+        transform_vector<PointXYZSHOT>(in_clouds_xyzshot, out_clouds_xyzshot, &m, 1);
 }
 
 void CloudTransformer::transform_vector_of_clouds() {
@@ -140,194 +175,106 @@ void CloudTransformer::transform_vector_of_clouds() {
     // Read hmomogenous matrix.
     vector<Types::HomogMatrix> hms = in_hms.read();
 
-    if(inverse){
-        for(int i = 0; i < hms.size(); i++){
+    transforms.resize(hms.size());
+    for(size_t i = 0; i < hms.size(); i++){
+        if(inverse){
             Types::HomogMatrix hmi(hms[i].inverse());
-            hms[i] = hmi;
+            transforms[i] = hmi;
+        } else {
+            transforms[i] = hms[i];
         }
     }
+    const Eigen::Matrix4f * m = transforms.empty() ? NULL : &transforms[0];
 
     // Try to transform XYZ.
     if(!in_clouds_xyz.empty())
-        transform_vector_xyz(hms);
+        transform_vector<pcl::PointXYZ>(in_clouds_xyz, out_clouds_xyz, m, transforms.size());
 
     // Try to transform XYZRGB.
     if(!in_clouds_xyzrgb.empty())
-        transform_vector_xyzrgb(hms);
+        transform_vector<pcl::PointXYZRGB>(in_clouds_xyzrgb, out_clouds_xyzrgb, m, transforms.size());
 
     // Try to transform XYZSIFT.
     if(!in_clouds_xyzsift.empty())
-        transform_vector_xyzsift(hms);
+        transform_vector<PointXYZSIFT>(in_clouds_xyzsift, out_clouds_xyzsift, m, transforms.size());
 
     // Try to transform XYZSHOT.
     if(!in_clouds_xyzshot.empty())
-        transform_vector_xyzshot(hms);
+        transform_vector<PointXYZSHOT>(in_clouds_xyzshot, out_clouds_xyzshot, m, transforms.size());
 }
 
 
-void CloudTransformer::transform_xyz(Types::HomogMatrix hm_) {
-	CLOG(LTRACE) << "transform_xyz()";
+template <typename PointT>
+void CloudTransformer::transform_cloud(Base::DataStreamIn<typename pcl::PointCloud<PointT>::Ptr, Base::DataStreamBuffer::Newest> & in,
+		Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out, const Eigen::Matrix4f & hm_) {
+	CLOG(LTRACE) << "transform_cloud()";
 	// Reads clouds.
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud2(new pcl::PointCloud<pcl::PointXYZ>());
+	typename pcl::PointCloud<PointT>::Ptr cloud = in.read();
 
-	if (!pass_through) {
-		// Transform cloud.
-		pcl::transformPointCloud(*cloud, *cloud2, hm_) ;
-		out_cloud_xyz.write(cloud2);
-	} else {
+	if (pass_through || !cloud) {
 		// Return input cloud.
-		out_cloud_xyz.write(cloud);
-	}
-}
-
-void CloudTransformer::transform_xyzrgb(Types::HomogMatrix hm_) {
-	CLOG(LTRACE) << "transform_xyzrgb()";
-	// Reads clouds.
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud2(new pcl::PointCloud<pcl::PointXYZRGB>());
-
-	if (!pass_through) {
-		// Transform cloud.
-		pcl::transformPointCloud(*cloud, *cloud2, hm_) ;
-		out_cloud_xyzrgb.write(cloud2);
+		out.write(cloud);
+	} else if (in_place) {
+		// Transform cloud, no one else reads the input.
+		Types::CloudTransform::transformInPlace(*cloud, hm_);
+		out.write(cloud);
 	} else {
-		// Return input cloud.
-		out_cloud_xyzrgb.write(cloud);
+		// Transform copy of the cloud.
+		typename pcl::PointCloud<PointT>::Ptr cloud2 = Types::CloudPool<PointT>::acquire(cloud->size());
+		Types::CloudTransform::transform(*cloud, *cloud2, hm_);
+		out.write(cloud2);
 	}
 }
 
-void CloudTransformer::transform_xyzsift(Types::HomogMatrix hm_) {
-	CLOG(LTRACE) << "transform_xyzsift()";
-	// Reads clouds.
-	pcl::PointCloud<PointXYZSIFT>::Ptr cloud = in_cloud_xyzsift.read();
-	pcl::PointCloud<PointXYZSIFT>::Ptr cloud2(new pcl::PointCloud<PointXYZSIFT>());
+template <typename PointT>
+void CloudTransformer::transform_posed(Base::DataStreamIn<typename Types::PosedCloud<PointT>::Ptr, Base::DataStreamBuffer::Newest> & in,
+		Base::DataStreamOut<typename Types::PosedCloud<PointT>::Ptr> & out, const Eigen::Matrix4f & hm_) {
+	CLOG(LTRACE) << "transform_posed()";
+	typename Types::PosedCloud<PointT>::Ptr cloud = in.read();
 
-	if (!pass_through) {
-		// Transform cloud.
-		pcl::transformPointCloud(*cloud, *cloud2, hm_) ;
-		out_cloud_xyzsift.write(cloud2);
-	} else {
-		// Return input cloud.
-		out_cloud_xyzsift.write(cloud);
-	}
+	if (pass_through || !cloud)
+		out.write(cloud);
+	else
+		out.write(cloud->transformed(hm_));
 }
 
-void CloudTransformer::transform_xyzshot(Types::HomogMatrix hm_) {
-	CLOG(LTRACE) << "transform_xyzshot()";
-	// Reads clouds.
-	pcl::PointCloud<PointXYZSHOT>::Ptr cloud = in_cloud_xyzshot.read();
-	pcl::PointCloud<PointXYZSHOT>::Ptr cloud2(new pcl::PointCloud<PointXYZSHOT>());
+template <typename PointT>
+void CloudTransformer::transform_soa(Base::DataStreamIn<typename Types::SoACloud<PointT>::Ptr, Base::DataStreamBuffer::Newest> & in,
+		Base::DataStreamOut<typename Types::SoACloud<PointT>::Ptr> & out, const Eigen::Matrix4f & hm_) {
+	CLOG(LTRACE) << "transform_soa()";
+	typename Types::SoACloud<PointT>::Ptr cloud = in.read();
 
-	if (!pass_through) {
-		// Transform cloud.
-		pcl::transformPointCloud(*cloud, *cloud2, hm_) ;
-		out_cloud_xyzshot.write(cloud2);
-	} else {
-		// Return input cloud.
-		out_cloud_xyzshot.write(cloud);
+	if (pass_through || !cloud) {
+		out.write(cloud);
+		return;
 	}
+	// A copy holds only the coordinate arrays, records are shared with the input.
+	if (!in_place)
+		cloud.reset(new Types::SoACloud<PointT>(*cloud));
+	Types::CloudTransform::transformInPlace(*cloud, hm_);
+	out.write(cloud);
 }
 
-
-void CloudTransformer::transform_vector_xyz(vector<Types::HomogMatrix> hms_) {
-    CLOG(LTRACE) << "transform_vector_xyz()";
+template <typename PointT>
+void CloudTransformer::transform_vector(Base::DataStreamIn<vector<typename pcl::PointCloud<PointT>::Ptr>, Base::DataStreamBuffer::Newest> & in,
+		Base::DataStreamOut<vector<typename pcl::PointCloud<PointT>::Ptr> > & out, const Eigen::Matrix4f * hms_, size_t count_) {
+    CLOG(LTRACE) << "transform_vector()";
     // Reads clouds.
-    vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> clouds = in_clouds_xyz.read();
-    vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> clouds2;
-
-    if (!pass_through) {
-        if(hms_.size() < clouds.size())
-            CLOG(LDEBUG) << "hms_.size() = " << hms_.size() << " clouds.size()= " << clouds.size();
-        while(hms_.size() < clouds.size()){
-            hms_.push_back(hms_[0]);
-        }
-        // Transform cloud.
-        for(int i = 0; i < hms_.size(); i++){
-            pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_tmp(new pcl::PointCloud<pcl::PointXYZ>());
-            pcl::transformPointCloud(*clouds[i], *cloud_tmp, hms_[i]);
-            clouds2.push_back(cloud_tmp);
-        }
-        out_clouds_xyz.write(clouds2);
-    } else {
-        // Return input cloud.
-        out_clouds_xyz.write(clouds);
-    }
-}
+    vector<typename pcl::PointCloud<PointT>::Ptr> clouds = in.read();
 
-void CloudTransformer::transform_vector_xyzrgb(vector<Types::HomogMatrix> hms_) {
-    CLOG(LTRACE) << "transform_vector_xyzrgb()";
-    // Reads clouds.
-    vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> clouds = in_clouds_xyzrgb.read();
-    vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> clouds2;
-
-    if (!pass_through) {
-        if(hms_.size() < clouds.size())
-            CLOG(LDEBUG) << "hms_.size() = " << hms_.size() << " clouds.size()= " << clouds.size();
-        while(hms_.size() < clouds.size()){
-            hms_.push_back(hms_[0]);
-        }
-        // Transform cloud.
-        for(int i = 0; i < hms_.size(); i++){
-            pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_tmp(new pcl::PointCloud<pcl::PointXYZRGB>());
-            pcl::transformPointCloud(*clouds[i], *cloud_tmp, hms_[i]);
-            clouds2.push_back(cloud_tmp);
-        }
-        out_clouds_xyzrgb.write(clouds2);
-    } else {
-        // Return input cloud.
-        out_clouds_xyzrgb.write(clouds);
+    if (pass_through || count_ == 0) {
+        // Return input clouds.
+        out.write(clouds);
+        return;
     }
-}
 
-void CloudTransformer::transform_vector_xyzsift(vector<Types::HomogMatrix> hms_) {
-    CLOG(LTRACE) << "transform_vector_xyzsift()";
-    // Reads clouds.
-    vector<pcl::PointCloud<PointXYZSIFT>::Ptr> clouds = in_clouds_xyzsift.read();
-    vector<pcl::PointCloud<PointXYZSIFT>::Ptr> clouds2;
-
-    if (!pass_through) {
-        if(hms_.size() < clouds.size())
-            CLOG(LDEBUG) << "hms_.size() = " << hms_.size() << " clouds.size()= " << clouds.size();
-        while(hms_.size() < clouds.size()){
-            hms_.push_back(hms_[0]);
-        }
-        // Transform clouds.
-        for(int i = 0; i < hms_.size(); i++){
-            pcl::PointCloud<PointXYZSIFT>::Ptr cloud_tmp(new pcl::PointCloud<PointXYZSIFT>());
-            pcl::transformPointCloud(*clouds[i], *cloud_tmp, hms_[i]);
-            clouds2.push_back(cloud_tmp);
-        }
-        out_clouds_xyzsift.write(clouds2);
-    } else {
-        // Return input cloud.
-        out_clouds_xyzsift.write(clouds);
-    }
-}
+    if(count_ < clouds.size())
+        CLOG(LDEBUG) << "hms_.size() = " << count_ << " clouds.size()= " << clouds.size();
 
-void CloudTransformer::transform_vector_xyzshot(vector<Types::HomogMatrix> hms_) {
-    CLOG(LTRACE) << "transform_vector_xyzshot()";
-    // Reads clouds.
-    vector<pcl::PointCloud<PointXYZSHOT>::Ptr> clouds = in_clouds_xyzshot.read();
-    vector<pcl::PointCloud<PointXYZSHOT>::Ptr> clouds2;
-
-    if (!pass_through) {
-        if(hms_.size() < clouds.size())
-            CLOG(LDEBUG) << "hms_.size() = " << hms_.size() << " clouds.size()= " << clouds.size();
-        while(hms_.size() < clouds.size()){
-            hms_.push_back(hms_[0]);
-        }
-        // Transform clouds.
-        for(int i = 0; i < hms_.size(); i++){
-            pcl::PointCloud<PointXYZSHOT>::Ptr cloud_tmp(new pcl::PointCloud<PointXYZSHOT>());
-            pcl::transformPointCloud(*clouds[i], *cloud_tmp, hms_[i]);
-            clouds2.push_back(cloud_tmp);
-        }
-        out_clouds_xyzshot.write(clouds2);
-    } else {
-        // Return input cloud.
-        out_clouds_xyzshot.write(clouds);
-    }
+    // Transform clouds, all of them in parallel.
+    vector<typename pcl::PointCloud<PointT>::Ptr> clouds2;
+    Types::CloudTransform::transformBatch<PointT>(clouds, hms_, count_, in_place, clouds2);
+    out.write(clouds2);
 }
 
 } //: namespace CloudTransformer
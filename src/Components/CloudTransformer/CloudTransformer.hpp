@@ -13,13 +13,19 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
-#include <pcl/common/transforms.h>
 
 #include <Types/PointXYZSIFT.hpp>
 #include <Types/PointXYZSHOT.hpp>
+#include <Types/PointXYZSIFT8.hpp>
 #include <Types/HomogMatrix.hpp>
+#include <Types/PosedCloud.hpp>
+#include <Types/SoACloud.hpp>
+
+#include <Eigen/Core>
 
 namespace Processors {
 namespace CloudTransformer {
@@ -77,6 +83,7 @@ protected:
 	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzrgb;
 	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzsift;
 	Base::DataStreamIn<pcl::PointCloud<PointXYZSHOT>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzshot;
+	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT8>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzsift8;
 	Base::DataStreamIn<Types::HomogMatrix, Base::DataStreamBuffer::Newest> in_hm;
 
     Base::DataStreamIn<vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>, Base::DataStreamBuffer::Newest> in_clouds_xyz;
@@ -85,32 +92,51 @@ protected:
     Base::DataStreamIn<vector<pcl::PointCloud<PointXYZSHOT>::Ptr>, Base::DataStreamBuffer::Newest> in_clouds_xyzshot;
     Base::DataStreamIn<vector<Types::HomogMatrix>, Base::DataStreamBuffer::Newest> in_hms;
 
+    Base::DataStreamIn<Types::PosedCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Newest> in_posed_cloud_xyz;
+    Base::DataStreamIn<Types::PosedCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Newest> in_posed_cloud_xyzrgb;
+
+    /// XYZSIFT cloud split into coordinate arrays, transformed without reading descriptors.
+    Base::DataStreamIn<Types::SoACloud<PointXYZSIFT>::Ptr, Base::DataStreamBuffer::Newest> in_soa_xyzsift;
+
 	// Output data streams
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
 	Base::DataStreamOut<pcl::PointCloud<PointXYZSIFT>::Ptr> out_cloud_xyzsift;
 	Base::DataStreamOut<pcl::PointCloud<PointXYZSHOT>::Ptr> out_cloud_xyzshot;
+	Base::DataStreamOut<pcl::PointCloud<PointXYZSIFT8>::Ptr> out_cloud_xyzsift8;
 
     Base::DataStreamOut<vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > out_clouds_xyz;
     Base::DataStreamOut<vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > out_clouds_xyzrgb;
     Base::DataStreamOut<vector<pcl::PointCloud<PointXYZSIFT>::Ptr> > out_clouds_xyzsift;
     Base::DataStreamOut<vector<pcl::PointCloud<PointXYZSHOT>::Ptr> > out_clouds_xyzshot;
 
+    /// Clouds with the transformation composed into their pose, points untouched.
+    Base::DataStreamOut<Types::PosedCloud<pcl::PointXYZ>::Ptr> out_posed_cloud_xyz;
+    Base::DataStreamOut<Types::PosedCloud<pcl::PointXYZRGB>::Ptr> out_posed_cloud_xyzrgb;
+
+    Base::DataStreamOut<Types::SoACloud<PointXYZSIFT>::Ptr> out_soa_xyzsift;
+
 	// Handlers
 	void transform_clouds();
     void transform_vector_of_clouds();
 
 
-    // Helper functions, specialized for every cloud type.
-	void transform_xyz(Types::HomogMatrix hm_);
-	void transform_xyzrgb(Types::HomogMatrix hm_);
-	void transform_xyzsift(Types::HomogMatrix hm_);
-	void transform_xyzshot(Types::HomogMatrix hm_);
+    // Helper functions, common for every cloud type.
+    template <typename PointT>
+    void transform_cloud(Base::DataStreamIn<typename pcl::PointCloud<PointT>::Ptr, Base::DataStreamBuffer::Newest> & in,
+    		Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out, const Eigen::Matrix4f & hm_);
+
+    template <typename PointT>
+    void transform_posed(Base::DataStreamIn<typename Types::PosedCloud<PointT>::Ptr, Base::DataStreamBuffer::Newest> & in,
+    		Base::DataStreamOut<typename Types::PosedCloud<PointT>::Ptr> & out, const Eigen::Matrix4f & hm_);
 
-    void transform_vector_xyz(vector<Types::HomogMatrix> hms_);
-    void transform_vector_xyzrgb(vector<Types::HomogMatrix> hms_);
-    void transform_vector_xyzsift(vector<Types::HomogMatrix> hms_);
-    void transform_vector_xyzshot(vector<Types::HomogMatrix> hms_);
+    template <typename PointT>
+    void transform_soa(Base::DataStreamIn<typename Types::SoACloud<PointT>::Ptr, Base::DataStreamBuffer::Newest> & in,
+    		Base::DataStreamOut<typename Types::SoACloud<PointT>::Ptr> & out, const Eigen::Matrix4f & hm_);
+
+    template <typename PointT>
+    void transform_vector(Base::DataStreamIn<vector<typename pcl::PointCloud<PointT>::Ptr>, Base::DataStreamBuffer::Newest> & in,
+    		Base::DataStreamOut<vector<typename pcl::PointCloud<PointT>::Ptr> > & out, const Eigen::Matrix4f * hms_, size_t count_);
 
     /// Property: if true, the component will not transform the input cloud.
     Base::Property<bool> pass_through;
@@ -118,6 +144,25 @@ protected:
     /// Property: inverse transformation(s).
     Base::Property<bool> inverse;
 
+    /// Property: transform input clouds in place instead of copying them. The input buffer keeps its own reference to
+    /// every cloud, so sharing cannot be detected here - input clouds are modified, set it only if no other component reads them.
+    Base::Property<bool> in_place;
+
+    /// Property: publish XYZ and XYZRGB clouds only as posed clouds, without transforming their points.
+    Base::Property<bool> lazy;
+
+    /// Transformations of the vector of clouds, kept between frames.
+    std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > transforms;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace CloudTransformer
@@ -12,11 +12,18 @@
 
 #include <algorithm>
 #include <boost/bind.hpp>
+
+#include "Types/CloudPool.hpp"
 #include <pcl/filters/filter.h>
 
 #include <pcl/common/centroid.h>
 #include <pcl/common/transforms.h>
 
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkPointData.h>
+#include <vtkUnsignedCharArray.h>
+
 namespace Processors {
 namespace CloudViewer {
 
@@ -47,7 +54,14 @@ CloudViewer::CloudViewer(const std::string & name) :
 	prop_display_object_meshes("objects.display_meshes",true),
 	prop_display_object_labels("objects.display_labels", true),
 	prop_display_objects_scene_correspondences("objects.display_scene_correspondences",true),
-	prop_display_object_coordinate_systems("objects.display_coordinate_systems",true)
+	prop_display_object_coordinate_systems("objects.display_coordinate_systems",true),
+	prop_lod("lod.enabled", false),
+	prop_lod_budget("lod.budget", 1000000),
+	prop_lod_pixels("lod.pixels", 2.0),
+	prop_render_thread("render.thread", true),
+	profile("profile", false),
+	profile_period("profile.period", 100),
+	profiler(name)
 {
 	// General properties.
 	registerProperty(prop_title);
@@ -87,6 +101,16 @@ CloudViewer::CloudViewer(const std::string & name) :
 	// Label properties.
 	registerProperty(prop_label_scale);
 
+	// Level of detail properties.
+	registerProperty(prop_lod);
+	registerProperty(prop_lod_budget);
+	registerProperty(prop_lod_pixels);
+
+	// Rendering properties.
+	registerProperty(prop_render_thread);
+	registerProperty(profile);
+	registerProperty(profile_period);
+
 
 	viewer = NULL;
 }
@@ -115,6 +139,42 @@ bool CloudViewer::parseColor(std::string color_, double & r_, double & g_, doubl
 
 
 
+bool CloudViewer::actorChanged(const std::string & name_, const boost::shared_ptr<const void> & data_) {
+	boost::shared_ptr<const void> & displayed = actor_data[name_];
+	if (displayed == data_)
+		return false;
+	displayed = data_;
+	return true;
+}
+
+
+void CloudViewer::actorRemoved(const std::string & name_) {
+	actor_data.erase(name_);
+}
+
+
+const double * CloudViewer::xyzsiftColor() {
+	const std::string color = prop_xyzsift_color;
+	if (color != xyzsift_color_cache) {
+		xyzsift_rgb[0] = 1;
+		xyzsift_rgb[1] = xyzsift_rgb[2] = 0;
+		parseColor(color, xyzsift_rgb[0], xyzsift_rgb[1], xyzsift_rgb[2]);
+		xyzsift_color_cache = color;
+	}
+	return xyzsift_rgb;
+}
+
+
+bool CloudViewer::samePoses(const std::vector<Types::HomogMatrix> & a_, const std::vector<Types::HomogMatrix> & b_) {
+	if (a_.size() != b_.size())
+		return false;
+	for (size_t i = 0; i < a_.size(); ++i)
+		if (a_[i].matrix() != b_[i].matrix())
+			return false;
+	return true;
+}
+
+
 CloudViewer::~CloudViewer() {
 }
 
@@ -128,6 +188,8 @@ void CloudViewer::prepareInterface() {
 	// Register cloud "scene" aliases.
 	//registerStream("in_scene_cloud_xyz", &in_cloud_xyz);
 	registerStream("in_scene_cloud_xyzrgb", &in_cloud_xyzrgb);
+	registerStream("in_posed_cloud_xyzrgb", &in_posed_cloud_xyzrgb);
+	registerStream("in_scene_posed_cloud_xyzrgb", &in_posed_cloud_xyzrgb);
 	registerStream("in_scene_cloud_xyzsift", &in_cloud_xyzsift);
 	//registerStream("in_scene_cloud_xyzrgb_normals", &in_cloud_xyzrgb_normals);
 
@@ -143,15 +205,50 @@ void CloudViewer::prepareInterface() {
 	// Register cloud objects/clusters/models-scene correspondences streams.
 	registerStream("in_objects_scene_correspondences", &in_objects_scene_correspondences);
 
-	registerHandler("on_spin", boost::bind(&CloudViewer::refreshViewerState, this));
+	registerHandler("on_spin", profiler.wrap("on_spin", boost::bind(&CloudViewer::onSpin, this)));
 	addDependency("on_spin", NULL);
 }
 
 
 
 bool CloudViewer::onInit() {
+	profiler.setEnabled(profile, profile_period);
 	CLOG(LTRACE) << "onInit";
 
+	render_failure_reported = false;
+
+	// VTK window must be used only by the thread that created it.
+	if (prop_render_thread)
+		render_thread.start(boost::bind(&CloudViewer::createViewer, this), boost::bind(&CloudViewer::refreshViewerState, this),
+				boost::bind(&CloudViewer::destroyViewer, this));
+	else
+		createViewer();
+
+	return true;
+}
+
+bool CloudViewer::onFinish() {
+	profiler.report();
+	if (!prop_render_thread) {
+		destroyViewer();
+		return true;
+	}
+	render_thread.stop();
+	return !render_thread.failed();
+}
+
+bool CloudViewer::onStop() {
+	return true;
+}
+
+bool CloudViewer::onStart() {
+	return true;
+}
+
+
+void CloudViewer::createViewer() {
+	CLOG(LTRACE) << "createViewer";
+
 	// Initialize camera and set its parameters.
 	viewer = new pcl::visualization::PCLVisualizer(prop_title);
 	viewer->initCameraParameters();
@@ -168,23 +265,62 @@ bool CloudViewer::onInit() {
 	previous_om_labels_size = 0;
 	previous_om_coordinate_systems_size = 0;
 
+	// Nothing displayed yet - caches are empty, so every property is parsed on first use.
+	actor_data.clear();
+	background_color_cache.clear();
+	xyzsift_color_cache.clear();
+	scene_xyzrgb_pose = Eigen::Matrix4f::Identity();
+	bounding_boxes = vtkSmartPointer<vtkPolyData>::New();
+	bounding_boxes_displayed = false;
+	displayed_labels.clear();
+	displayed_label_poses.clear();
+	displayed_coordinate_systems.clear();
+
 	// Initialize
     scene_cloud_xyzrgb = pcl::PointCloud<pcl::PointXYZRGB>::Ptr (new pcl::PointCloud<pcl::PointXYZRGB>());
     scene_cloud_xyzsift = pcl::PointCloud<PointXYZSIFT>::Ptr (new pcl::PointCloud<PointXYZSIFT>());
-
-	return true;
 }
 
-bool CloudViewer::onFinish() {
-	return true;
+void CloudViewer::destroyViewer() {
+	CLOG(LTRACE) << "destroyViewer";
+	if (!viewer)
+		return;
+	viewer->close();
+	delete viewer;
+	viewer = NULL;
+	actor_data.clear();
 }
 
-bool CloudViewer::onStop() {
-	return true;
-}
 
-bool CloudViewer::onStart() {
-	return true;
+void CloudViewer::onSpin() {
+	// Nothing is displayed once the rendering thread failed.
+	if (prop_render_thread && render_thread.failed()) {
+		if (!render_failure_reported)
+			CLOG(LERROR) << "Rendering thread failed, inputs will not be displayed";
+		render_failure_reported = true;
+		return;
+	}//: if
+
+	// Reading streams is cheap, rendering happens on the rendering thread.
+	bool read = false;
+	read |= readInput(in_cloud_xyzrgb, read_inputs.cloud_xyzrgb);
+	read |= readInput(in_posed_cloud_xyzrgb, read_inputs.posed_cloud_xyzrgb);
+	read |= readInput(in_cloud_xyzsift, read_inputs.cloud_xyzsift);
+	read |= readInput(in_object_labels, read_inputs.object_labels);
+	read |= readInput(in_object_clouds_xyzrgb, read_inputs.object_clouds_xyzrgb);
+	read |= readInput(in_object_clouds_xyzsift, read_inputs.object_clouds_xyzsift);
+	read |= readInput(in_object_vertices_xyz, read_inputs.object_vertices_xyz);
+	read |= readInput(in_object_triangles, read_inputs.object_triangles);
+	read |= readInput(in_object_bounding_boxes, read_inputs.object_bounding_boxes);
+	read |= readInput(in_objects_scene_correspondences, read_inputs.objects_scene_correspondences);
+	read |= readInput(in_object_poses, read_inputs.object_poses);
+
+	// One snapshot holds all inputs, so the renderer never gets only a part of data read together.
+	if (read)
+		mail_inputs.write(read_inputs);
+
+	if (!prop_render_thread)
+		refreshViewerState();
 }
 
 
@@ -195,10 +331,14 @@ void CloudViewer::refreshViewerState() {
 	if (!viewer)
 		return;
 
-	// Change background color.
-	double r=0, g=0, b=0;
-	parseColor(prop_background_color, r, g, b);
-	viewer->setBackgroundColor(r, g, b);
+	// Change background color - only if property changed.
+	const std::string background_color = prop_background_color;
+	if (background_color != background_color_cache) {
+		double r=0, g=0, b=0;
+		parseColor(background_color, r, g, b);
+		viewer->setBackgroundColor(r, g, b);
+		background_color_cache = background_color;
+	}
 
 	// Show/hide coordinate system.
 	CLOG(LDEBUG) << "prop_coordinate_system="<<prop_scene_coordinate_system;
@@ -217,8 +357,11 @@ void CloudViewer::refreshViewerState() {
 
 	// Check whether object names changed - if so, reload all objects, if not - leave unchanged... what about object poses?
 
-	bool fresh_scene = false;
-	bool fresh_objects = false;
+	// All inputs come from one snapshot, inputs read again since the displayed ones are refreshed.
+	Inputs inputs;
+	if (!mail_inputs.take(inputs))
+		inputs = displayed_inputs;
+	const Inputs & displayed = displayed_inputs;
 
     // Define translation between clouds.
     Eigen::Matrix4f trans = Eigen::Matrix4f::Identity();
@@ -226,116 +369,144 @@ void CloudViewer::refreshViewerState() {
     trans(1, 3) = prop_scene_translation_y;
     trans(2, 3) = prop_scene_translation_z;
 
-	// Check scene xyzrgb cloud.
-	if (!in_cloud_xyzrgb.empty()){
-        pcl::PointCloud<pcl::PointXYZRGB>::Ptr scene_cloud_xyzrgb_tmp = in_cloud_xyzrgb.read();
-        pcl::transformPointCloud(*scene_cloud_xyzrgb_tmp, *scene_cloud_xyzrgb, trans);
-        refreshSceneCloudXYZRGB(scene_cloud_xyzrgb);
+	// Check scene xyzrgb cloud - points stay untouched, translation is applied by the renderer.
+	if (changed(inputs.cloud_xyzrgb, displayed.cloud_xyzrgb)){
+        scene_cloud_xyzrgb = *inputs.cloud_xyzrgb.value;
+        refreshSceneCloudXYZRGB(scene_cloud_xyzrgb, trans);
+	}//: if
+
+	// Check scene xyzrgb cloud with pending pose.
+	if (changed(inputs.posed_cloud_xyzrgb, displayed.posed_cloud_xyzrgb)){
+        Types::PosedCloud<pcl::PointXYZRGB>::Ptr posed = *inputs.posed_cloud_xyzrgb.value;
+        if (posed && posed->cloud()) {
+            scene_cloud_xyzrgb = posed->cloud();
+            refreshSceneCloudXYZRGB(scene_cloud_xyzrgb, trans * posed->pose());
+        }
 	}//: if
 
 
 	// Check scene xyzsift cloud.
-	if (!in_cloud_xyzsift.empty()){
-        pcl::PointCloud<PointXYZSIFT>::Ptr scene_cloud_xyzsift_tmp = in_cloud_xyzsift.read();
-		//is_fresh_scene_xyzsift = true;
-        pcl::transformPointCloud(*scene_cloud_xyzsift_tmp, *scene_cloud_xyzsift, trans);
+	if (changed(inputs.cloud_xyzsift, displayed.cloud_xyzsift)){
+        pcl::PointCloud<PointXYZSIFT>::Ptr scene_cloud_xyzsift_tmp = *inputs.cloud_xyzsift.value;
+        // Correspondences are drawn between points, so SIFTs need real coordinates.
+        if (trans.isIdentity())
+            scene_cloud_xyzsift = scene_cloud_xyzsift_tmp;
+        else {
+            scene_cloud_xyzsift = Types::CloudPool<PointXYZSIFT>::acquire(scene_cloud_xyzsift_tmp->size());
+            pcl::transformPointCloud(*scene_cloud_xyzsift_tmp, *scene_cloud_xyzsift, trans);
+        }
         refreshSceneCloudXYZSIFT(scene_cloud_xyzsift);
-		fresh_scene = true;
 	}//: if
 
 
 	// Read om XYZRGB clouds from port.
-	if (!in_object_clouds_xyzrgb.empty()){
-			object_clouds_xyzrgb = in_object_clouds_xyzrgb.read();
+	if (changed(inputs.object_clouds_xyzrgb, displayed.object_clouds_xyzrgb)){
+			object_clouds_xyzrgb = *inputs.object_clouds_xyzrgb.value;
 			refreshOMCloudsXYZRGB(object_clouds_xyzrgb);
 
 	}//: if
 
 	// Read om XYZSIFT clouds from port.
-	if (!in_object_clouds_xyzsift.empty()){
-			object_clouds_xyzsift = in_object_clouds_xyzsift.read();
+	if (changed(inputs.object_clouds_xyzsift, displayed.object_clouds_xyzsift)){
+			object_clouds_xyzsift = *inputs.object_clouds_xyzsift.value;
 			refreshOMCloudsXYZSIFT(object_clouds_xyzsift);
-			//is_fresh_om_xyzsift = true;
-			fresh_objects = true;
     }//: if
 
-	// Read om vertices from port.
-	if (!in_object_vertices_xyz.empty()){
-		object_vertices_xyz = in_object_vertices_xyz.read();
+	// Read om vertices from port, boxes and meshes are refreshed when they or their vertices changed.
+	const bool fresh_vertices = changed(inputs.object_vertices_xyz, displayed.object_vertices_xyz);
+	if (fresh_vertices)
+		object_vertices_xyz = *inputs.object_vertices_xyz.value;
 
-		// Read om bounding boxes from port.
-		if (!in_object_bounding_boxes.empty()){
-				refreshOMBoundingBoxes(object_vertices_xyz, in_object_bounding_boxes.read());
-		}//: if
+	// Read om bounding boxes from port.
+	if (inputs.object_bounding_boxes.value && (fresh_vertices || changed(inputs.object_bounding_boxes, displayed.object_bounding_boxes))){
+			refreshOMBoundingBoxes(object_vertices_xyz, *inputs.object_bounding_boxes.value);
+	}//: if
 
-		// Read om meshes from port.
-		if (!in_object_triangles.empty()){
-				refreshOMMeshes(object_vertices_xyz, in_object_triangles.read());
-		}//: if
+	// Read om meshes from port.
+	if (inputs.object_triangles.value && (fresh_vertices || changed(inputs.object_triangles, displayed.object_triangles))){
+			refreshOMMeshes(object_vertices_xyz, *inputs.object_triangles.value);
 	}//: if
 
 
 
-	// Read models-scene correspondences from port.
-    if (!in_objects_scene_correspondences.empty()){
+	// Read models-scene correspondences from port, SIFTs of the same snapshot are the ones they refer to.
+    if (changed(inputs.objects_scene_correspondences, displayed.objects_scene_correspondences)){
+		objects_scene_correspondences = *inputs.objects_scene_correspondences.value;
 
 		if (scene_cloud_xyzsift->empty()) {
 			CLOG(LWARNING) << "Cannot display correspondences as scene_cloud_xyzsift is empty";
 		} else if (object_clouds_xyzsift.empty()) {
 			CLOG(LWARNING) << "Cannot display correspondences as om_clouds_xyzsift is empty";
-		} else if (!fresh_scene) {
-			CLOG(LWARNING) << "Cannot display correspondences as scene_cloud_xyzsift is old";
-		} else if (!fresh_objects) {
-			CLOG(LWARNING) << "Cannot display correspondences as om_clouds_xyzsift is old";
+		} else if (objects_scene_correspondences.empty()) {
+			CLOG(LWARNING) << "Cannot display correspondences as objects_scene_correspondences is empty";
 		} else {
-				objects_scene_correspondences = in_objects_scene_correspondences.read();
-				if (objects_scene_correspondences.empty())
-					CLOG(LWARNING) << "Cannot display correspondences as objects_scene_correspondences is empty";
-				else
-					refreshModelsSceneCorrespondences(objects_scene_correspondences, scene_cloud_xyzsift, object_clouds_xyzsift);
+			refreshModelsSceneCorrespondences(objects_scene_correspondences, scene_cloud_xyzsift, object_clouds_xyzsift);
 		} //: else
 
     }//: if
 
 	// Read object poses.
-	if (!in_object_poses.empty()){
-		object_poses = in_object_poses.read();
+	const bool fresh_poses = changed(inputs.object_poses, displayed.object_poses);
+	if (fresh_poses){
+		object_poses = *inputs.object_poses.value;
 		refreshOMCoordinateSystems(object_poses);
 	}//: if
 
-	// Read object/models names from port.
-	if (!in_object_labels.empty()){
+	// Read object/models names from port, names follow their poses.
+	if (inputs.object_labels.value && (fresh_poses || changed(inputs.object_labels, displayed.object_labels))){
 		if (object_poses.empty()) {
 			CLOG(LWARNING) << "Cannot display object ids as object poses are unknown!";
 		} else {
-			refreshOMNames(in_object_labels.read(), object_poses);
+			refreshOMNames(*inputs.object_labels.value, object_poses);
 		}//: else
 
 	}//: if
 
+	displayed_inputs = inputs;
+
+	// Choose level of detail of the scene for the current camera, points are uploaded only if the level changed.
+	if (prop_lod && prop_display_scene_xyzrgb && !scene_cloud_xyzrgb->empty())
+		refreshSceneCloudXYZRGB(scene_cloud_xyzrgb, scene_xyzrgb_pose);
+
 	// Refresh viewer.
 	viewer->spinOnce(100);
 }
 
 
-void CloudViewer::refreshSceneCloudXYZRGB(pcl::PointCloud<pcl::PointXYZRGB>::Ptr scene_cloud_xyzrgb_){
+void CloudViewer::refreshSceneCloudXYZRGB(pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr scene_cloud_xyzrgb_, const Eigen::Matrix4f & pose_){
 	CLOG(LTRACE) << "refreshSceneCloudXYZRGB";
 
 	if (!prop_display_scene_xyzrgb) {
 		viewer->removePointCloud ("scene_xyzrgb");
+		actorRemoved("scene_xyzrgb");
 	} else {
-		// Filter the NaN points.
-		std::vector<int> indices;
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr tmp_cloud_xyzrgb(new pcl::PointCloud<pcl::PointXYZRGB>);;
-		pcl::removeNaNFromPointCloud(*scene_cloud_xyzrgb_, *tmp_cloud_xyzrgb, indices);
-		tmp_cloud_xyzrgb->is_dense = false;
-
-		// Colour field hanlder.
-		pcl::visualization::PointCloudColorHandlerRGBField<pcl::PointXYZRGB> color_distribution(tmp_cloud_xyzrgb);
+		// Display level of detail of the cloud, hierarchy is built once per cloud.
+		if (prop_lod) {
+			if (scene_lod.source() != scene_cloud_xyzrgb_)
+				scene_lod.build(scene_cloud_xyzrgb_);
+			std::vector<pcl::visualization::Camera> cameras;
+			viewer->getCameras(cameras);
+			if (!cameras.empty())
+				scene_cloud_xyzrgb_ = scene_lod.cloud(scene_lod.select(cameras[0], pose_, std::max(1, (int) prop_lod_budget), prop_lod_pixels));
+		}
+
+		// Upload points only if cloud changed. NaN points of clouds that are not dense are skipped by the handlers.
+		if (actorChanged("scene_xyzrgb", scene_cloud_xyzrgb_)) {
+			// Colour field hanlder.
+			pcl::visualization::PointCloudColorHandlerRGBField<pcl::PointXYZRGB> color_distribution(scene_cloud_xyzrgb_);
 
-		// UPDATE: Display cloud only if required.
-		if (!viewer->updatePointCloud<pcl::PointXYZRGB> (tmp_cloud_xyzrgb, color_distribution, "scene_xyzrgb"))
-			viewer->addPointCloud<pcl::PointXYZRGB> (tmp_cloud_xyzrgb, color_distribution, "scene_xyzrgb");
+			// UPDATE: Display cloud only if required.
+			if (!viewer->updatePointCloud<pcl::PointXYZRGB> (scene_cloud_xyzrgb_, color_distribution, "scene_xyzrgb")) {
+				viewer->addPointCloud<pcl::PointXYZRGB> (scene_cloud_xyzrgb_, color_distribution, "scene_xyzrgb");
+				scene_xyzrgb_pose = Eigen::Matrix4f::Identity();
+			}
+		}
+
+		// Place the cloud with actor transformation instead of moving its points.
+		if (pose_ != scene_xyzrgb_pose) {
+			viewer->updatePointCloudPose("scene_xyzrgb", Eigen::Affine3f(pose_));
+			scene_xyzrgb_pose = pose_;
+		}
 	}//: else
 }
 
@@ -345,27 +516,21 @@ void CloudViewer::refreshSceneCloudXYZSIFT(pcl::PointCloud<PointXYZSIFT>::Ptr sc
 
 	if (!prop_display_scene_xyzsift) {
 		viewer->removePointCloud ("scene_xyzsift");
+		actorRemoved("scene_xyzsift");
 	} else {
-		// Transform to XYZ cloud.
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz(new pcl::PointCloud<pcl::PointXYZ>);
-		pcl::copyPointCloud(*scene_cloud_xyzsift_, *cloud_xyz);
+		if (!actorChanged("scene_xyzsift", scene_cloud_xyzsift_))
+			return;
 
-		// Filter the NaN points.
-		std::vector<int> indices;
-		pcl::removeNaNFromPointCloud(*cloud_xyz, *cloud_xyz, indices);
-		cloud_xyz->is_dense = false;
+		// SIFT colour, handler reads coordinates straight from the SIFT cloud.
+		const double * rgb = xyzsiftColor();
+		pcl::visualization::PointCloudColorHandlerCustom<PointXYZSIFT> color(scene_cloud_xyzsift_, rgb[0] * 255, rgb[1] * 255, rgb[2] * 255);
 
 		// UPDATE: Display cloud only if required.
-		if (!viewer->updatePointCloud<pcl::PointXYZ> (cloud_xyz, "scene_xyzsift"))
-			viewer->addPointCloud<pcl::PointXYZ> (cloud_xyz, "scene_xyzsift");
-
-		// Set SIFT colours.
-		double r=255, g=0, b=0;
-		parseColor(prop_xyzsift_color, r, g, b);
+		if (!viewer->updatePointCloud<PointXYZSIFT> (scene_cloud_xyzsift_, color, "scene_xyzsift"))
+			viewer->addPointCloud<PointXYZSIFT> (scene_cloud_xyzsift_, color, "scene_xyzsift");
 
 		// Update SIFT cloud properties.
 		viewer->setPointCloudRenderingProperties(pcl::visualization::PCL_VISUALIZER_POINT_SIZE, prop_xyzsift_size,"scene_xyzsift");
-		viewer->setPointCloudRenderingProperties(pcl::visualization::PCL_VISUALIZER_COLOR, r, g, b, "scene_xyzsift");
 	}//: else
 }
 
@@ -381,6 +546,7 @@ void CloudViewer::refreshOMCloudsXYZRGB(std::vector<pcl::PointCloud<pcl::PointXY
 			s << i;
 			std::string cname = "xyzrgb_" + s.str();
 			viewer->removePointCloud (cname);
+			actorRemoved(cname);
 		}//: for
 
 		previous_om_xyzrgb_size = 0;
@@ -392,18 +558,16 @@ void CloudViewer::refreshOMCloudsXYZRGB(std::vector<pcl::PointCloud<pcl::PointXY
 			s << i;
 			std::string cname = "xyzrgb_" + s.str();
 
-			// Filter the NaN points.
-			std::vector<int> indices;
-			pcl::PointCloud<pcl::PointXYZRGB>::Ptr tmp_cloud_xyzrgb(new pcl::PointCloud<pcl::PointXYZRGB>);;
-			pcl::removeNaNFromPointCloud(*(om_clouds_xyzrgb_[i]), *tmp_cloud_xyzrgb, indices);
-			tmp_cloud_xyzrgb->is_dense = false;
+			// Skip clouds that are already displayed.
+			if (!actorChanged(cname, om_clouds_xyzrgb_[i]))
+				continue;
 
 			// Colour field hanlder.
-			pcl::visualization::PointCloudColorHandlerRGBField<pcl::PointXYZRGB> color_distribution(tmp_cloud_xyzrgb);
+			pcl::visualization::PointCloudColorHandlerRGBField<pcl::PointXYZRGB> color_distribution(om_clouds_xyzrgb_[i]);
 
 			// UPDATE: Display cloud only if required.
-			if (!viewer->updatePointCloud<pcl::PointXYZRGB> (tmp_cloud_xyzrgb, color_distribution, cname))
-				viewer->addPointCloud<pcl::PointXYZRGB> (tmp_cloud_xyzrgb, color_distribution, cname);
+			if (!viewer->updatePointCloud<pcl::PointXYZRGB> (om_clouds_xyzrgb_[i], color_distribution, cname))
+				viewer->addPointCloud<pcl::PointXYZRGB> (om_clouds_xyzrgb_[i], color_distribution, cname);
 		}//: for
 
 		// Remove unnecessary object clouds.
@@ -414,6 +578,7 @@ void CloudViewer::refreshOMCloudsXYZRGB(std::vector<pcl::PointCloud<pcl::PointXY
 			std::string cname = "xyzrgb_" + s.str();
 			// Remove object/model cloud.
 			viewer->removePointCloud (cname);
+			actorRemoved(cname);
 		}//: for
 
 		previous_om_xyzrgb_size = om_clouds_xyzrgb_.size();
@@ -433,6 +598,7 @@ void CloudViewer::refreshOMCloudsXYZSIFT(std::vector<pcl::PointCloud<PointXYZSIF
 			s << i;
 			std::string cname = "xyzsift_" + s.str();
 			viewer->removePointCloud (cname);
+			actorRemoved(cname);
 		}//: for
 
 		previous_om_xyzsift_size = 0;
@@ -448,27 +614,19 @@ void CloudViewer::refreshOMCloudsXYZSIFT(std::vector<pcl::PointCloud<PointXYZSIF
 			s << i;
 			std::string cname = "xyzsift_" + s.str();
 
-			// Transform to XYZ cloud.
-			pcl::PointCloud<pcl::PointXYZ>::Ptr tmp_cloud_xyz(new pcl::PointCloud<pcl::PointXYZ>);
-			pcl::copyPointCloud(*(om_clouds_xyzsift_[i]), *tmp_cloud_xyz);
+			// Skip clouds that are already displayed.
+			if (!actorChanged(cname, om_clouds_xyzsift_[i]))
+				continue;
 
-			// Filter the NaN points.
-			std::vector<int> indices;
-			pcl::removeNaNFromPointCloud(*tmp_cloud_xyz, *tmp_cloud_xyz, indices);
-			tmp_cloud_xyz->is_dense = false;
+			// Set SIFT colours, coordinates are read straight from the SIFT cloud.
+			pcl::visualization::PointCloudColorHandlerCustom<PointXYZSIFT> color(om_clouds_xyzsift_[i], colours[i][0] * 255, colours[i][1] * 255, colours[i][2] * 255);
 
 			// UPDATE: Display cloud only if required.
-			if (!viewer->updatePointCloud<pcl::PointXYZ> (tmp_cloud_xyz, cname))
-				viewer->addPointCloud<pcl::PointXYZ> (tmp_cloud_xyz, cname);
-
-			// Set SIFT colours.
-			double r= colours[i][0];
-			double g= colours[i][1];
-			double b= colours[i][2];
+			if (!viewer->updatePointCloud<PointXYZSIFT> (om_clouds_xyzsift_[i], color, cname))
+				viewer->addPointCloud<PointXYZSIFT> (om_clouds_xyzsift_[i], color, cname);
 
 			// Update SIFT cloud properties.
 			viewer->setPointCloudRenderingProperties(pcl::visualization::PCL_VISUALIZER_POINT_SIZE, prop_xyzsift_size, cname);
-			viewer->setPointCloudRenderingProperties(pcl::visualization::PCL_VISUALIZER_COLOR, r, g, b, cname);
 
 		}//: for
 
@@ -480,6 +638,7 @@ void CloudViewer::refreshOMCloudsXYZSIFT(std::vector<pcl::PointCloud<PointXYZSIF
 			std::string cname = "xyzsift_" + s.str();
 			// Remove object/model cloud.
 			viewer->removePointCloud (cname);
+			actorRemoved(cname);
 		}//: for
 
 		previous_om_xyzsift_size = om_clouds_xyzsift_.size();
@@ -491,57 +650,67 @@ void CloudViewer::refreshOMCloudsXYZSIFT(std::vector<pcl::PointCloud<PointXYZSIF
 void CloudViewer::refreshOMBoundingBoxes(std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>  om_vertices_xyz_, const std::vector< std::vector<pcl::Vertices> > & om_lines_) {
 	CLOG(LTRACE) << "refreshOMBoundingBoxes";
 
-	// Remove bounding boxes objects - performed always! TODO FIX!
-	for(int i=0; i< previous_om_bb_size; i++) {
-		// Generate given object BB name prefix.
-		std::ostringstream s;
-		s << i;
-		std::string cname = "bounding_line_" + s.str();
-		// Remove lines one by one.
-		viewer->removeShape(cname);
-	}//: for
-
-	if (prop_display_object_bounding_boxes) {
+	if (!prop_display_object_bounding_boxes) {
+		if (bounding_boxes_displayed)
+			viewer->removeShape("bounding_boxes");
+		bounding_boxes_displayed = false;
+		previous_om_bb_size = 0;
+		return;
+	}//: if
 
-		// Generate colour vector for MAX of om clouds (sifts, corners, correspondences,names).
-		resizeColourVector(om_lines_.size());
+	// Generate colour vector for MAX of om clouds (sifts, corners, correspondences,names).
+	resizeColourVector(om_lines_.size());
+
+	// All edges of all boxes go to one polydata, each box has its own copy of vertices carrying its colour.
+	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+	vtkSmartPointer<vtkCellArray> lines = vtkSmartPointer<vtkCellArray>::New();
+	vtkSmartPointer<vtkUnsignedCharArray> colors = vtkSmartPointer<vtkUnsignedCharArray>::New();
+	colors->SetNumberOfComponents(3);
+	colors->SetName("Colors");
+
+	int bb_size = 0;
+	for(size_t i=0; i< om_lines_.size() && i < om_vertices_xyz_.size(); i++) {
+		const pcl::PointCloud<pcl::PointXYZ> & vertices = *om_vertices_xyz_[i];
+		const vtkIdType first = points->GetNumberOfPoints();
+		for(size_t v=0; v< vertices.size(); v++) {
+			points->InsertNextPoint(vertices[v].x, vertices[v].y, vertices[v].z);
+			colors->InsertNextTuple3(colours[i][0] * 255, colours[i][1] * 255, colours[i][2] * 255);
+		}//: for
 
-		int bb_size = 0;
-		for(size_t i=0; i< om_lines_.size(); i++) {
-			// Get colour from list.
-			double r = colours[i][0];
-			double g = colours[i][1];
-			double b = colours[i][2];
+		// Get lines for given om.
+		const std::vector<pcl::Vertices> & om_lines = om_lines_[i];
+		for(size_t j=0; j< om_lines.size(); j++) {
+			// Skip edges with invalid vertices.
+			if (om_lines[j].vertices.size() < 2 || om_lines[j].vertices[0] >= vertices.size() || om_lines[j].vertices[1] >= vertices.size())
+				continue;
+			bb_size++;
+			lines->InsertNextCell(2);
+			lines->InsertCellPoint(first + om_lines[j].vertices[0]);
+			lines->InsertCellPoint(first + om_lines[j].vertices[1]);
+		}//: for
+	}//: for
 
-			// Get lines for given om.
-			std::vector<pcl::Vertices> lines = om_lines_[i];
-			for(size_t j=0; j< lines.size(); j++,bb_size++) {
-				// Generate given object BB name prefix.
-				std::ostringstream s;
-				s << bb_size;
-				std::string cname = "bounding_line_" + s.str();
-				// Get indices of vertices.
-				int v1 = lines[j].vertices[0];
-				int v2 = lines[j].vertices[1];
-
-				// Add lines one by one.
-				viewer->addLine(om_vertices_xyz_[i]->at(v1), om_vertices_xyz_[i]->at(v2), r, g, b, cname);
-			}//: for
+	bounding_boxes->SetPoints(points);
+	bounding_boxes->SetLines(lines);
+	bounding_boxes->GetPointData()->SetScalars(colors);
+	bounding_boxes->Modified();
 
-		}//: for
+	// Actor renders the polydata it was created with, so it is added only once.
+	if (!bounding_boxes_displayed)
+		bounding_boxes_displayed = viewer->addModelFromPolyData(bounding_boxes, "bounding_boxes");
 
-		previous_om_bb_size = bb_size;
-	} else {
-		previous_om_bb_size = 0;
-	}//: else
+	previous_om_bb_size = bb_size;
 }
 
 
 void CloudViewer::refreshOMMeshes(std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>  om_vertices_xyz_, const std::vector< std::vector<pcl::Vertices> > & om_triangles_) {
 	CLOG(LTRACE) << "refreshOMMeshes";
 
-	// Remove meshes objects - performed always! TODO FIX!
-	for(int i=0; i< previous_om_meshes_size; i++) {
+	// Number of meshes that stay displayed.
+	size_t meshes_size = prop_display_object_meshes ? std::min(om_triangles_.size(), om_vertices_xyz_.size()) : 0;
+
+	// Remove meshes that are not needed anymore.
+	for(int i=meshes_size; i< previous_om_meshes_size; i++) {
 		// Generate given object mesh name prefix.
 		std::ostringstream s;
 		s << i;
@@ -550,39 +719,21 @@ void CloudViewer::refreshOMMeshes(std::vector<pcl::PointCloud<pcl::PointXYZ>::Pt
 		viewer->removeShape(cname);
 	}//: for
 
-	if (prop_display_object_meshes) {
-
-		// Generate colour vector for MAX of om clouds (sifts, corners, meshes, correspondences,names).
-		resizeColourVector(om_triangles_.size());
-
-		for(int i=0; i< om_triangles_.size(); i++) {
-			// Generate given object mesh name prefix.
-			std::ostringstream s;
-			s << i;
-			std::string cname = "mesh_" + s.str();
-			// Get colour from list.
-			double r = colours[i][0];
-			double g = colours[i][1];
-			double b = colours[i][2];
-			// And? TODO!
-
-			// Create mesh object.
-			pcl::PolygonMesh::Ptr mesh (new pcl::PolygonMesh);
-			// mesh_ptr_->polygons[triangle_number].vertices[point_number];
-			// Set mesh vertices.
-			pcl::toPCLPointCloud2(*om_vertices_xyz_[i], mesh->cloud);
-			// Set mesh polygon.
-			mesh->polygons = om_triangles_[i];
+	// Generate colour vector for MAX of om clouds (sifts, corners, meshes, correspondences,names).
+	resizeColourVector(meshes_size);
 
+	for(size_t i=0; i< meshes_size; i++) {
+		// Generate given object mesh name prefix.
+		std::ostringstream s;
+		s << i;
+		std::string cname = "mesh_" + s.str();
 
-			// Remove lines one by one.
-			viewer->addPolygonMesh(*mesh, cname);
-		}//: for
+		// Update existing mesh actor in place, add the new ones.
+		if (!viewer->updatePolygonMesh<pcl::PointXYZ>(om_vertices_xyz_[i], om_triangles_[i], cname))
+			viewer->addPolygonMesh<pcl::PointXYZ>(om_vertices_xyz_[i], om_triangles_[i], cname);
+	}//: for
 
-		previous_om_meshes_size = om_triangles_.size();
-	} else {
-		previous_om_meshes_size = 0;
-	}//: else
+	previous_om_meshes_size = meshes_size;
 }
 
 
@@ -639,6 +790,10 @@ void CloudViewer::refreshModelsSceneCorrespondences(std::vector<pcl::Corresponde
 void CloudViewer::refreshOMNames(std::vector<std::string>  om_ids_, std::vector<Types::HomogMatrix> om_poses_) {
 	CLOG(LTRACE) << "refreshOMNames";
 
+	// Texts cannot be moved, but usually labels and poses are the same as displayed.
+	if (prop_display_object_labels && previous_om_labels_size == om_ids_.size() && om_ids_ == displayed_labels && samePoses(om_poses_, displayed_label_poses))
+		return;
+
 	// Remove previous names.
 	for(int i = 0; i < previous_om_labels_size; i++){
 		ostringstream s;
@@ -688,8 +843,12 @@ void CloudViewer::refreshOMNames(std::vector<std::string>  om_ids_, std::vector<
 		}//: for
 
 		previous_om_labels_size = om_ids_.size();
+		displayed_labels = om_ids_;
+		displayed_label_poses = om_poses_;
 	} else {
 		previous_om_labels_size = 0;
+		displayed_labels.clear();
+		displayed_label_poses.clear();
 	}//: else
 
 }
@@ -698,6 +857,10 @@ void CloudViewer::refreshOMNames(std::vector<std::string>  om_ids_, std::vector<
 void CloudViewer::refreshOMCoordinateSystems(std::vector<Types::HomogMatrix> om_poses_) {
 	CLOG(LTRACE) << "refreshOMCoordinateSystems";
 
+	// Nothing to do if the same poses are displayed.
+	if (prop_display_object_coordinate_systems && previous_om_coordinate_systems_size == om_poses_.size() && samePoses(om_poses_, displayed_coordinate_systems))
+		return;
+
 	// Remove previous names.
 	for(int i = 0; i < previous_om_coordinate_systems_size; i++){
 		ostringstream s;
@@ -725,8 +888,10 @@ void CloudViewer::refreshOMCoordinateSystems(std::vector<Types::HomogMatrix> om_
 		}//: for
 
 		previous_om_coordinate_systems_size = om_poses_.size();
+		displayed_coordinate_systems = om_poses_;
 	} else {
 		previous_om_coordinate_systems_size = 0;
+		displayed_coordinate_systems.clear();
 	}//: else
 
 }
@@ -742,7 +907,7 @@ void CloudViewer::resizeColourVector(unsigned int size_) {
 	// If too small.
 	while (colours.size() < size_) {
 		// Add random colour.
-		double* rgb = new double(3);
+		double* rgb = new double[3];
 		for (size_t i = 0; i < 3; ++i) {
 			rgb[i] = (double)(rand()&255)/255.0;
 		}//: for
@@ -776,8 +941,8 @@ void CloudViewer::displayClouds_xyzrgb_normals() {
 		// Read cloud from port.
 		pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloud = in_cloud_xyzrgb_normals.read();
 
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudRgb(new pcl::PointCloud<pcl::PointXYZRGB>());
-		pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>());
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudRgb = Types::CloudPool<pcl::PointXYZRGB>::acquire();
+		pcl::PointCloud<pcl::Normal>::Ptr normals = Types::CloudPool<pcl::Normal>::acquire();
 
 		pcl::copyPointCloud(*cloud, *cloudRgb);
 		pcl::copyPointCloud(*cloud, *normals);
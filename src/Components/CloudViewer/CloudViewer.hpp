@@ -15,11 +15,22 @@
 #include "EventHandler2.hpp"
 #include "Property.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
+#include <map>
+
 #include <pcl/visualization/pcl_visualizer.h>
 #include <pcl/PolygonMesh.h>
 
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
 #include <Types/PointXYZSIFT.hpp>
 #include <Types/HomogMatrix.hpp>
+#include <Types/PosedCloud.hpp>
+#include <Types/CloudLOD.hpp>
+#include <Types/LatestValue.hpp>
+#include <Types/RenderThread.hpp>
 
 
 
@@ -31,7 +42,10 @@ namespace CloudViewer {
  * \brief Class responsible for displaying diverse clouds.
  * \author Maciej Stefańczyk, Michał Laszkowski, Tomasz Kornuta
  *
- * Pointcloud viewer with normals visualization
+ * Pointcloud viewer with normals visualization.
+ * Actors are updated only when their data changes: every actor remembers
+ * the data it displays, properties are parsed only after they change and
+ * all bounding boxes are drawn as a single batched polydata.
  */
 class CloudViewer: public Base::Component {
 public:
@@ -80,6 +94,9 @@ protected:
 	/// Data stream with cloud of XYZRGB points.
 	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Newest, Base::Synchronization::Mutex> in_cloud_xyzrgb;
 
+	/// Data stream with XYZRGB cloud with pending pose - pose is handed to the renderer, points are not transformed.
+	Base::DataStreamIn<Types::PosedCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Newest, Base::Synchronization::Mutex> in_posed_cloud_xyzrgb;
+
 	/// Data stream with cloud of XYZ SIFTs.
 	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT>::Ptr, Base::DataStreamBuffer::Newest, Base::Synchronization::Mutex> in_cloud_xyzsift;
 
@@ -112,11 +129,86 @@ protected:
 	Base::DataStreamIn<std::vector<Types::HomogMatrix>, Base::DataStreamBuffer::Newest, Base::Synchronization::Mutex>  in_object_poses;
 
 
-	/// Main handler - displays/hides clouds, coordinate systems, changes properties etc.
+	/*!
+	 * Newest value read from an input stream, with the number of values read so far.
+	 * The value is shared, so copying snapshots of inputs does not copy the data.
+	 */
+	template <typename T>
+	struct Input {
+		Input() : count(0) {}
+
+		void set(const T & value_) {
+			value.reset(new T(value_));
+			++count;
+		}
+
+		boost::shared_ptr<const T> value;
+		unsigned int count;
+	};
+
+	/*!
+	 * Newest values of all input streams, posted to the rendering thread as one snapshot,
+	 * so data of related streams (e.g. SIFTs and their correspondences) are displayed in the same frame.
+	 */
+	struct Inputs {
+		Input<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> cloud_xyzrgb;
+		Input<Types::PosedCloud<pcl::PointXYZRGB>::Ptr> posed_cloud_xyzrgb;
+		Input<pcl::PointCloud<PointXYZSIFT>::Ptr> cloud_xyzsift;
+		Input<std::vector< std::string> > object_labels;
+		Input<std::vector< pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > object_clouds_xyzrgb;
+		Input<std::vector< pcl::PointCloud<PointXYZSIFT>::Ptr> > object_clouds_xyzsift;
+		Input<std::vector< pcl::PointCloud<pcl::PointXYZ>::Ptr> > object_vertices_xyz;
+		Input<std::vector< std::vector<pcl::Vertices> > > object_triangles;
+		Input<std::vector< std::vector<pcl::Vertices> > > object_bounding_boxes;
+		Input<std::vector<pcl::CorrespondencesPtr> > objects_scene_correspondences;
+		Input<std::vector<Types::HomogMatrix> > object_poses;
+	};
+
+	/// Reads the stream into the input if it holds data. Returns false if the stream was empty.
+	template <typename Stream, typename T>
+	static bool readInput(Stream & in_, Input<T> & input_) {
+		if (in_.empty())
+			return false;
+		input_.set(in_.read());
+		return true;
+	}
+
+	/// Checks whether the input was read again since the displayed one.
+	template <typename T>
+	static bool changed(const Input<T> & input_, const Input<T> & displayed_) {
+		return input_.count != displayed_.count;
+	}
+
+	/// Inputs read so far, used by the handler only.
+	Inputs read_inputs;
+
+	/// Inputs currently displayed, used by the renderer only.
+	Inputs displayed_inputs;
+
+	/// Mailbox passing snapshots of inputs to the rendering thread.
+	Types::LatestValue<Inputs> mail_inputs;
+
+	/// Set when failure of the rendering thread was reported.
+	bool render_failure_reported;
+
+	/// Thread rendering the viewer.
+	Types::RenderThread render_thread;
+
+
+	/// Handler - passes data of input streams to the renderer and returns, renders by itself only if there is no rendering thread.
+	void onSpin();
+
+	/// Creates the viewer.
+	void createViewer();
+
+	/// Destroys the viewer.
+	void destroyViewer();
+
+	/// Main rendering function - displays/hides clouds, coordinate systems, changes properties etc.
 	void refreshViewerState();
 
-	/// Displays or hides XYZRGB scene cloud.
-	void refreshSceneCloudXYZRGB(pcl::PointCloud<pcl::PointXYZRGB>::Ptr scene_cloud_xyzrgb_);
+	/// Displays or hides XYZRGB scene cloud, placed in the scene with the given pose.
+	void refreshSceneCloudXYZRGB(pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr scene_cloud_xyzrgb_, const Eigen::Matrix4f & pose_);
 
 	/// Displays or hides XYZSIFT scene cloud.
 	void refreshSceneCloudXYZSIFT(pcl::PointCloud<PointXYZSIFT>::Ptr scene_cloud_xyzsift_);
@@ -210,6 +302,18 @@ protected:
 	/// Display/hide object coordinate systems.
 	Base::Property<bool> prop_display_object_coordinate_systems;
 
+	/// Property: display level of detail of scene XYZRGB cloud instead of the full cloud.
+	Base::Property<bool> prop_lod;
+
+	/// Property: maximal number of displayed points of scene XYZRGB cloud in level of detail mode.
+	Base::Property<int> prop_lod_budget;
+
+	/// Property: minimal size of displayed octree cell, in pixels.
+	Base::Property<float> prop_lod_pixels;
+
+	/// Property: render on a dedicated thread instead of in the handler (the viewer is created by that thread).
+	Base::Property<bool> prop_render_thread;
+
 
 	/// Property: color of SIFT points. As default it is set to 1 row with 255, 0, 0 (red).
 	Base::Property<std::string> prop_xyzsift_color;
@@ -255,8 +359,8 @@ protected:
 	/// Colours of bounding boxes (r,g,b channels normalized to <0,1>).
 	std::vector<double*> colours;
 
-	/// Temporary variables - scene XYZRGB cloud.
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr scene_cloud_xyzrgb;
+	/// Temporary variables - scene XYZRGB cloud, in its own coordinates.
+    pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr scene_cloud_xyzrgb;
 
 	/// Temporary variables - scene XYZSIFT cloud.
 	pcl::PointCloud<PointXYZSIFT>::Ptr scene_cloud_xyzsift;
@@ -283,6 +387,60 @@ protected:
 	/// Parses colour in format r,g,b. Returns false if failed.
 	bool parseColor(std::string color_, double & r_, double & g_, double & b_);
 
+
+	/// Data displayed by actors, by actor name. Holding it also keeps pooled clouds from being reused.
+	std::map<std::string, boost::shared_ptr<const void> > actor_data;
+
+	/// Returns true if the actor displays other data than given one, and remembers the new data.
+	bool actorChanged(const std::string & name_, const boost::shared_ptr<const void> & data_);
+
+	/// Forgets the data of removed actor.
+	void actorRemoved(const std::string & name_);
+
+	/// Last parsed value of background colour property.
+	std::string background_color_cache;
+
+	/// Last parsed value of SIFT colour property and the colour (r,g,b channels normalized to <0,1>).
+	std::string xyzsift_color_cache;
+	double xyzsift_rgb[3];
+
+	/// Returns SIFT colour, parsing the property only if it changed.
+	const double * xyzsiftColor();
+
+	/// Pose of the displayed scene XYZRGB cloud.
+	Eigen::Matrix4f scene_xyzrgb_pose;
+
+	/// Levels of detail of scene XYZRGB cloud.
+	Types::CloudLOD<pcl::PointXYZRGB> scene_lod;
+
+	/// Edges of all bounding boxes, drawn with colour of every box stored in its vertices.
+	vtkSmartPointer<vtkPolyData> bounding_boxes;
+
+	/// Flag indicating whether bounding boxes actor is added.
+	bool bounding_boxes_displayed;
+
+	/// Displayed labels and their poses.
+	std::vector<std::string> displayed_labels;
+	std::vector<Types::HomogMatrix> displayed_label_poses;
+
+	/// Poses of displayed coordinate systems.
+	std::vector<Types::HomogMatrix> displayed_coordinate_systems;
+
+	/// Returns true if both vectors contain the same poses.
+	static bool samePoses(const std::vector<Types::HomogMatrix> & a_, const std::vector<Types::HomogMatrix> & b_);
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
 };
 
 } //: namespace CloudViewer
@@ -12,6 +12,9 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/DeviceSearch.hpp"
+
 
 namespace Processors {
 namespace ClusterExtraction {
@@ -20,10 +23,31 @@ ClusterExtraction::ClusterExtraction(const std::string & name) :
 		Base::Component(name),
 		clusterTolerance("clusterTolerance", 0.02),
 		minClusterSize("minClusterSize", 100),
-		maxClusterSize("maxClusterSize", 25000)  {
+		maxClusterSize("maxClusterSize", 25000),
+		organized("organized", false),
+		copy_clusters("copy_clusters", true),
+		cache("cache", false),
+		gpu("gpu", false),
+		input_policy("input.policy", std::string("newest")),
+		input_queue("input.queue", 0),
+		input_deadline("input.deadline", 100),
+		input_pcl(name + ".in_pcl"),
+		input_indexed_xyz(name + ".in_indexed_xyz"),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
 			registerProperty(clusterTolerance);
 			registerProperty(minClusterSize);
 			registerProperty(maxClusterSize);
+			registerProperty(organized);
+			registerProperty(copy_clusters);
+			registerProperty(cache);
+			registerProperty(gpu);
+			registerProperty(input_policy);
+			registerProperty(input_queue);
+			registerProperty(input_deadline);
+			registerProperty(profile);
+			registerProperty(profile_period);
 			minClusterSize.addConstraint("0");
 			minClusterSize.addConstraint("25000");
 			maxClusterSize.addConstraint("100");
@@ -36,75 +60,147 @@ ClusterExtraction::~ClusterExtraction() {
 void ClusterExtraction::prepareInterface() {
 	// Register data streams, events and event handlers HERE!
 registerStream("in_pcl", &in_pcl);
+registerStream("in_indexed_xyz", &in_indexed_xyz);
 registerStream("out_indices", &out_indices);
 registerStream("out_clusters", &out_clusters);
+registerStream("out_views", &out_views);
 	// Register handlers
-	h_extract.setup(boost::bind(&ClusterExtraction::extract, this));
+	h_extract.setup(profiler.wrap("extract", boost::bind(&ClusterExtraction::extract, this)));
 	registerHandler("extract", &h_extract);
 	addDependency("extract", &in_pcl);
 
+	h_extract_indexed.setup(profiler.wrap("extract_indexed", boost::bind(&ClusterExtraction::extract_indexed, this)));
+	registerHandler("extract_indexed", &h_extract_indexed);
+	addDependency("extract_indexed", &in_indexed_xyz);
+
 }
 
 bool ClusterExtraction::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	if (gpu && !Types::Cuda::available())
+		CLOG(LWARNING) << "ClusterExtraction: no CUDA device (or built without CUDA), clustering on the CPU";
+
+	if (!input_pcl.configure(input_policy, input_queue, input_deadline))
+		CLOG(LWARNING) << "Unknown input policy " << input_policy << ", using newest";
+	input_indexed_xyz.configure(input_policy, input_queue, input_deadline);
+	input_pcl.setReporting(profile, profile_period);
+	input_indexed_xyz.setReporting(profile, profile_period);
 
 	return true;
 }
 
 bool ClusterExtraction::onFinish() {
+	profiler.report();
+	input_pcl.report();
+	input_indexed_xyz.report();
 	return true;
 }
 
 bool ClusterExtraction::onStop() {
+	// Frames of a bounded queue are not processed after the task starts over.
+	input_pcl.clear();
+	input_indexed_xyz.clear();
 	return true;
 }
 
 bool ClusterExtraction::onStart() {
+	// Scene may have changed while stopped.
+	cluster_cache.reset();
 	return true;
 }
 
 void ClusterExtraction::extract() {
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_pcl.read();
-  // Creating the KdTree object for the search method of the extraction
-  pcl::search::KdTree<pcl::PointXYZ>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZ>);
-  tree->setInputCloud (cloud);
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+	if (!input_pcl.read(in_pcl, cloud))
+		return;
+	extractClusters(*Types::IndexedCloud<pcl::PointXYZ>::create(cloud));
+}
+
+void ClusterExtraction::extract_indexed() {
+	Types::IndexedCloud<pcl::PointXYZ>::Ptr input;
+	if (!input_indexed_xyz.read(in_indexed_xyz, input))
+		return;
+	extractClusters(*input);
+}
+
+void ClusterExtraction::extractClusters(const Types::IndexedCloud<pcl::PointXYZ> & input) {
+	pcl::PointCloud<pcl::PointXYZ>::ConstPtr cloud = input.cloud();
   
-  std::vector<pcl::PointIndices> cluster_indices;
+  boost::shared_ptr<std::vector<pcl::PointIndices> > cluster_indices(new std::vector<pcl::PointIndices>);
+  if (organized && Types::OrganizedClustering::applicable(*cloud)) {
+    // Connected components over pixel neighbours, no search index needed
+    organized_clustering.setClusterTolerance (clusterTolerance);
+    organized_clustering.setMinClusterSize (minClusterSize);
+    organized_clustering.setMaxClusterSize (maxClusterSize);
+    organized_clustering.extract (*cloud, *cluster_indices);
+  } else if (cache) {
+    // Clusters of unchanged regions are carried over, the rest is clustered again
+    std::vector<int> rest;
+    std::vector<pcl::PointIndices> fresh;
+    cluster_cache.setTolerance (clusterTolerance);
+    cluster_cache.carry (*cloud, minClusterSize, maxClusterSize, *cluster_indices, rest);
+    extractSubset (cloud, rest, fresh);
+    cluster_cache.merge (*cloud, *cluster_indices, fresh);
+    CLOG(LDEBUG) << "Carried " << cluster_cache.carriedClusters () << " clusters, clustered " << rest.size () << " points again";
+  } else if (!gpu || !extractDevice (cloud, *cluster_indices)) {
+    pcl::EuclideanClusterExtraction<pcl::PointXYZ> ec;
+    ec.setClusterTolerance (clusterTolerance); // 2cm
+    ec.setMinClusterSize (minClusterSize);
+    ec.setMaxClusterSize (maxClusterSize);
+    ec.setSearchMethod (input.search());
+    ec.setInputCloud (cloud);
+    ec.extract (*cluster_indices);
+  }
+  if (!cache)
+    cluster_cache.reset ();
+  CLOG(LINFO) << "Extracted " << cluster_indices->size () << " clusters";
+  profiler.points(cloud->size(), 0);
+
+  // Views refer to the input cloud, clusters are copied only when requested
+  std::vector<Types::CloudView<pcl::PointXYZ> > views = Types::CloudView<pcl::PointXYZ>::split (cloud, cluster_indices);
+
+  if (copy_clusters) {
+    std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> clusters;
+    clusters.reserve (views.size ());
+    for (size_t i = 0; i < views.size (); ++i)
+      clusters.push_back (views[i].copy ());
+    out_clusters.write(clusters);
+  }
+
+	out_indices.write(*cluster_indices);
+	out_views.write(views);
+}
+
+bool ClusterExtraction::extractDevice(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloud, std::vector<pcl::PointIndices> & clusters) {
+  if (!Types::Cuda::available ())
+    return false;
+  if (!Types::Cuda::euclideanClusters (*Types::DeviceCloud<pcl::PointXYZ>::upload (cloud), clusterTolerance, minClusterSize, maxClusterSize, clusters)) {
+    CLOG(LWARNING) << "Cloud is too large for the grid of the tolerance, clustering on the CPU";
+    return false;
+  }
+  return true;
+}
+
+void ClusterExtraction::extractSubset(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloud, const std::vector<int> & indices,
+		std::vector<pcl::PointIndices> & clusters) {
+  clusters.clear ();
+  if (indices.empty ())
+    return;
+
+  // The tree must be built over the same indices the extraction uses
+  boost::shared_ptr<std::vector<int> > subset (new std::vector<int> (indices));
+  pcl::search::KdTree<pcl::PointXYZ>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZ>);
+  tree->setInputCloud (cloud, subset);
+
   pcl::EuclideanClusterExtraction<pcl::PointXYZ> ec;
-  ec.setClusterTolerance (clusterTolerance); // 2cm
+  ec.setClusterTolerance (clusterTolerance);
   ec.setMinClusterSize (minClusterSize);
   ec.setMaxClusterSize (maxClusterSize);
   ec.setSearchMethod (tree);
   ec.setInputCloud (cloud);
-  ec.extract (cluster_indices);
-
-  std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> clusters;
-  
-  //int j = 0;
-  for (std::vector<pcl::PointIndices>::const_iterator it = cluster_indices.begin (); it != cluster_indices.end (); ++it)
-  {
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_cluster (new pcl::PointCloud<pcl::PointXYZ>);
-    for (std::vector<int>::const_iterator pit = it->indices.begin (); pit != it->indices.end (); pit++)
-      cloud_cluster->points.push_back (cloud->points[*pit]); //*
-    cloud_cluster->width = cloud_cluster->points.size ();
-    cloud_cluster->height = 1;
-    cloud_cluster->is_dense = true;
-
-	clusters.push_back(cloud_cluster);
-    std::cout << "PointCloud representing the Cluster: " << cloud_cluster->points.size () << " data points." << std::endl;
-    //std::stringstream ss;
-    //ss << "cloud_cluster_" << j << ".pcd";
-    //writer.write<pcl::PointXYZ> (ss.str (), *cloud_cluster, false); //*
-    //j++;
-  }	
-	
-	//std::cout<<"j=="<<j<<endl;
-	//std::cout<<clusters.size()<<endl;
-	out_indices.write(cluster_indices);
-	out_clusters.write(clusters);
-	
+  ec.setIndices (subset);
+  ec.extract (clusters);
 }
 
-
-
 } //: namespace ClusterExtraction
 } //: namespace Processors
@@ -13,6 +13,9 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+#include "Types/InputPolicy.hpp"
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl/kdtree/kdtree.h>
@@ -21,6 +24,11 @@
 #include <pcl/segmentation/sac_segmentation.h>
 #include <pcl/segmentation/extract_clusters.h>
 
+#include "Types/IndexedCloud.hpp"
+#include "Types/OrganizedClustering.hpp"
+#include "Types/CloudView.hpp"
+#include "Types/ClusterCache.hpp"
+
 namespace Processors {
 namespace ClusterExtraction {
 
@@ -28,7 +36,11 @@ namespace ClusterExtraction {
  * \class ClusterExtraction
  * \brief ClusterExtraction processor class.
  *
- * ClusterExtraction processor.
+ * ClusterExtraction processor. Inputs are read through Types::InputPolicy -
+ * frames waiting while clustering falls behind can be dropped (input.policy
+ * newest by default, deadline or queue bounded by input.queue). With the gpu
+ * property unorganized clouds are clustered on the GPU
+ * (Types::Cuda::euclideanClusters).
  */
 class ClusterExtraction: public Base::Component {
 public:
@@ -74,23 +86,75 @@ protected:
 
 // Input data streams
 
-		Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_pcl;
+		Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_pcl;
+		Base::DataStreamIn<Types::IndexedCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_indexed_xyz;
 		
 		Base::DataStreamOut<std::vector<pcl::PointIndices> > out_indices;
 		Base::DataStreamOut<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > out_clusters;
+		Base::DataStreamOut<std::vector<Types::CloudView<pcl::PointXYZ> > > out_views;
 
 // Output data streams
 
 	// Handlers
 	Base::EventHandler2 h_extract;
+	Base::EventHandler2 h_extract_indexed;
 	
 	// Handlers
 	void extract();
+	void extract_indexed();
+
+	/// Extracts clusters, using search index of the cloud.
+	void extractClusters(const Types::IndexedCloud<pcl::PointXYZ> & input);
+
+	/// Euclidean clusters of the cloud found on the GPU. Returns false if it was not clustered.
+	bool extractDevice(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloud, std::vector<pcl::PointIndices> & clusters);
+
+	/// Euclidean clusters of the points of the cloud, kd-tree built over these points only.
+	void extractSubset(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloud, const std::vector<int> & indices,
+			std::vector<pcl::PointIndices> & clusters);
 	
 	Base::Property<float> clusterTolerance;
 	Base::Property<int> minClusterSize;
 	Base::Property<int> maxClusterSize;
 
+	/// Cluster organized clouds in image space, unorganized ones always use kd-tree.
+	Base::Property<bool> organized;
+
+	/// Publish copies of clusters on out_clusters, views on out_views are always published.
+	Base::Property<bool> copy_clusters;
+
+	/// Keep clusters of the last cloud and cluster again only changed regions (kd-tree clustering only).
+	Base::Property<bool> cache;
+
+	/// Property: cluster on the GPU (needs build with CUDA) unless clustered in image space or with the cache.
+	Base::Property<bool> gpu;
+
+	Types::OrganizedClustering organized_clustering;
+
+	Types::ClusterCache cluster_cache;
+
+	/// Property: frames taken from inputs - newest (the latest waiting frame), queue or deadline.
+	Base::Property<std::string> input_policy;
+
+	/// Property: frames waiting in a queue, older ones are dropped, 0 - unbounded.
+	Base::Property<int> input_queue;
+
+	/// Property: age since capture (ms) of frames dropped with the deadline policy.
+	Base::Property<float> input_deadline;
+
+	// Policies of inputs.
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZ>::Ptr> input_pcl;
+	Types::InputPolicy<Types::IndexedCloud<pcl::PointXYZ>::Ptr> input_indexed_xyz;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace ClusterExtraction
@@ -12,6 +12,9 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/DeviceSearch.hpp"
+
 
 #include <pcl/filters/extract_indices.h>
 #include <pcl/filters/voxel_grid.h>
@@ -26,9 +29,34 @@
 namespace Processors {
 namespace Clustering {
 
-Clustering::Clustering(const std::string & name) :
-		Base::Component(name)  {
+// Parameters of all clustering methods.
+const float TOLERANCE = 0.04;
+const int MIN_SIZE = 100;
+const int MAX_SIZE = 10000;
 
+Clustering::Clustering(const std::string & name) :
+		Base::Component(name),
+		organized("organized", false),
+		copy_segments("copy_segments", true),
+		gpu("gpu", false),
+		organized_clustering(TOLERANCE, MIN_SIZE, MAX_SIZE),
+		input_policy("input.policy", std::string("newest")),
+		input_queue("input.queue", 0),
+		input_deadline("input.deadline", 100),
+		input_xyzrgb(name + ".in_cloud_xyzrgb"),
+		input_indexed_xyzrgb(name + ".in_indexed_xyzrgb"),
+		input_device_xyzrgb(name + ".in_device_cloud_xyzrgb"),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(organized);
+	registerProperty(copy_segments);
+	registerProperty(gpu);
+	registerProperty(input_policy);
+	registerProperty(input_queue);
+	registerProperty(input_deadline);
+	registerProperty(profile);
+	registerProperty(profile_period);
 }
 
 Clustering::~Clustering() {
@@ -37,25 +65,55 @@ Clustering::~Clustering() {
 void Clustering::prepareInterface() {
 	// Register data streams, events and event handlers HERE!
 	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
+	registerStream("in_indexed_xyzrgb", &in_indexed_xyzrgb);
+	registerStream("in_device_cloud_xyzrgb", &in_device_cloud_xyzrgb);
 	registerStream("out_segments", &out_segments);
 	registerStream("out_colored", &out_colored);
+	registerStream("out_views", &out_views);
 	// Register handlers
-	h_onNewData.setup(boost::bind(&Clustering::onNewData, this));
+	h_onNewData.setup(profiler.wrap("onNewData", boost::bind(&Clustering::onNewData, this)));
 	registerHandler("onNewData", &h_onNewData);
 	addDependency("onNewData", &in_cloud_xyzrgb);
 
+	h_onNewIndexedData.setup(profiler.wrap("onNewIndexedData", boost::bind(&Clustering::onNewIndexedData, this)));
+	registerHandler("onNewIndexedData", &h_onNewIndexedData);
+	addDependency("onNewIndexedData", &in_indexed_xyzrgb);
+
+	h_onNewDeviceData.setup(profiler.wrap("onNewDeviceData", boost::bind(&Clustering::onNewDeviceData, this)));
+	registerHandler("onNewDeviceData", &h_onNewDeviceData);
+	addDependency("onNewDeviceData", &in_device_cloud_xyzrgb);
+
 }
 
 bool Clustering::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	if (gpu && !Types::Cuda::available())
+		CLOG(LWARNING) << "Clustering: no CUDA device (or built without CUDA), clustering on the CPU";
+
+	if (!input_xyzrgb.configure(input_policy, input_queue, input_deadline))
+		CLOG(LWARNING) << "Unknown input policy " << input_policy << ", using newest";
+	input_indexed_xyzrgb.configure(input_policy, input_queue, input_deadline);
+	input_device_xyzrgb.configure(input_policy, input_queue, input_deadline);
+	input_xyzrgb.setReporting(profile, profile_period);
+	input_indexed_xyzrgb.setReporting(profile, profile_period);
+	input_device_xyzrgb.setReporting(profile, profile_period);
 
 	return true;
 }
 
 bool Clustering::onFinish() {
+	profiler.report();
+	input_xyzrgb.report();
+	input_indexed_xyzrgb.report();
+	input_device_xyzrgb.report();
 	return true;
 }
 
 bool Clustering::onStop() {
+	// Frames of a bounded queue are not processed after the task starts over.
+	input_xyzrgb.clear();
+	input_indexed_xyzrgb.clear();
+	input_device_xyzrgb.clear();
 	return true;
 }
 
@@ -64,51 +122,95 @@ bool Clustering::onStart() {
 }
 
 void Clustering::onNewData() {
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
+	if (input_xyzrgb.read(in_cloud_xyzrgb, cloud))
+		cluster(*Types::IndexedCloud<pcl::PointXYZRGB>::create(cloud));
+}
+
+void Clustering::onNewIndexedData() {
+	Types::IndexedCloud<pcl::PointXYZRGB>::Ptr input;
+	if (input_indexed_xyzrgb.read(in_indexed_xyzrgb, input))
+		cluster(*input);
+}
+
+void Clustering::onNewDeviceData() {
+	Types::DeviceCloud<pcl::PointXYZRGB>::Ptr cloud;
+	if (!input_device_xyzrgb.read(in_device_cloud_xyzrgb, cloud))
+		return;
+	boost::shared_ptr<std::vector<pcl::PointIndices> > cluster_indices(new std::vector<pcl::PointIndices>);
+	if (gpu && clusterDevice(*cloud, *cluster_indices))
+		publish(cloud->host(), cluster_indices);
+	else
+		cluster(*Types::IndexedCloud<pcl::PointXYZRGB>::create(cloud->host()));
+}
+
+void Clustering::cluster(const Types::IndexedCloud<pcl::PointXYZRGB> & input) {
+	pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr cloud = input.cloud();
 	CLOG(LINFO) << "PointCloud before filtering has: " << cloud->points.size() << " data points.";
 	// Create the filtering object: downsample the dataset using a leaf size of 1cm
 
-	// Creating the KdTree object for the search method of the extraction
-	pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZRGB>);
-	tree->setInputCloud(cloud);
-
-	std::vector<pcl::PointIndices> cluster_indices;
-	pcl::EuclideanClusterExtraction<pcl::PointXYZRGB> ec;
-	ec.setClusterTolerance(0.04); // 2cm
-	ec.setMinClusterSize(100);
-	ec.setMaxClusterSize(10000);
-	ec.setSearchMethod(tree);
-	ec.setInputCloud(cloud);
-	ec.extract(cluster_indices);
+	boost::shared_ptr<std::vector<pcl::PointIndices> > cluster_indices(new std::vector<pcl::PointIndices>);
+	if (organized && Types::OrganizedClustering::applicable(*cloud)) {
+		// Connected components over pixel neighbours, no search index needed
+		organized_clustering.extract(*cloud, *cluster_indices);
+	} else if (!gpu || !Types::Cuda::available() || !clusterDevice(*Types::DeviceCloud<pcl::PointXYZRGB>::upload(cloud), *cluster_indices)) {
+		pcl::EuclideanClusterExtraction<pcl::PointXYZRGB> ec;
+		ec.setClusterTolerance(TOLERANCE);
+		ec.setMinClusterSize(MIN_SIZE);
+		ec.setMaxClusterSize(MAX_SIZE);
+		ec.setSearchMethod(input.search());
+		ec.setInputCloud(cloud);
+		ec.extract(*cluster_indices);
+	}
+	publish(cloud, cluster_indices);
+}
 
-	int j = 0;
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_colored(new pcl::PointCloud<pcl::PointXYZRGB>);
-	for (std::vector<pcl::PointIndices>::const_iterator it = cluster_indices.begin(); it != cluster_indices.end(); ++it) {
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_cluster(new pcl::PointCloud<pcl::PointXYZRGB>);
+bool Clustering::clusterDevice(const Types::DeviceCloud<pcl::PointXYZRGB> & cloud, std::vector<pcl::PointIndices> & cluster_indices) {
+	if (!Types::Cuda::available())
+		return false;
+	if (!Types::Cuda::euclideanClusters(cloud, TOLERANCE, MIN_SIZE, MAX_SIZE, cluster_indices)) {
+		CLOG(LWARNING) << "Cloud is too large for the grid of the tolerance, clustering on the CPU";
+		return false;
+	}
+	CLOG(LINFO) << "Clustered " << cloud.size() << " points on GPU";
+	return true;
+}
 
+void Clustering::publish(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr & cloud,
+		const boost::shared_ptr<std::vector<pcl::PointIndices> > & cluster_indices) {
+	// Views refer to the input cloud, segments are copied only when requested
+	std::vector<Types::CloudView<pcl::PointXYZRGB> > views = Types::CloudView<pcl::PointXYZRGB>::split(cloud, cluster_indices);
+
+	size_t total = 0;
+	for (size_t i = 0; i < views.size(); ++i)
+		total += views[i].size();
+
+	// Colored cloud is allocated once and filled in place
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_colored = Types::CloudPool<pcl::PointXYZRGB>::acquire(total);
+	cloud_colored->header = cloud->header;
+	cloud_colored->points.resize(total);
+	size_t n = 0;
+	for (size_t i = 0; i < views.size(); ++i) {
 		int r = rand()%128 + 128;
 		int g = rand()%128 + 128;
 		int b = rand()%128 + 128;
-		for (std::vector<int>::const_iterator pit = it->indices.begin(); pit != it->indices.end(); pit++) {
-			pcl::PointXYZRGB pt = cloud->points[*pit];
-			cloud_cluster->points.push_back(pt);
+		for (size_t k = 0; k < views[i].size(); ++k, ++n) {
+			pcl::PointXYZRGB & pt = cloud_colored->points[n];
+			pt = views[i][k];
 			pt.r = r; pt.g = g; pt.b = b;
-			cloud_colored->push_back(pt);
 		}
-		cloud_cluster->width = cloud_cluster->points.size();
-		cloud_colored->width += cloud_cluster->points.size();
-		cloud_cluster->height = 1;
-		cloud_colored->height = 1;
-		cloud_cluster->is_dense = true;
-		cloud_colored->is_dense = true;
 
-		CLOG(LINFO) << "PointCloud representing the Cluster: " << cloud_cluster->points.size() << " data points.";
-		j++;
+		CLOG(LINFO) << "PointCloud representing the Cluster: " << views[i].size() << " data points.";
 
-		out_segments.write(cloud_cluster);
+		if (copy_segments)
+			out_segments.write(views[i].copy());
 	}
-	out_colored.write(cloud_colored);
+	cloud_colored->width = total;
+	cloud_colored->height = 1;
+	cloud_colored->is_dense = true;
 
+	out_views.write(views);
+	out_colored.write(cloud_colored);
 }
 
 
@@ -13,9 +13,17 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+#include "Types/InputPolicy.hpp"
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 
+#include "Types/IndexedCloud.hpp"
+#include "Types/OrganizedClustering.hpp"
+#include "Types/CloudView.hpp"
+#include "Types/DeviceCloud.hpp"
+
 namespace Processors {
 namespace Clustering {
 
@@ -23,7 +31,15 @@ namespace Clustering {
  * \class Clustering
  * \brief Clustering processor class.
  *
- * 
+ * Euclidean clustering of clouds. With the gpu property clusters are found
+ * on the GPU (Types::Cuda::euclideanClusters), from clouds uploaded by the
+ * component or from device clouds of in_device_cloud_xyzrgb (e.g. of
+ * VoxelGrid or PassThrough with gpu), which stay on the device - the host
+ * copy is downloaded only for outputs, once for all CPU consumers.
+ *
+ * Inputs are read through Types::InputPolicy - frames waiting while
+ * clustering falls behind can be dropped (input.policy newest by default,
+ * deadline or queue bounded by input.queue).
  */
 class Clustering: public Base::Component {
 public:
@@ -68,20 +84,70 @@ protected:
 
 
 	// Input data streams
-	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Queue> in_cloud_xyzrgb;
+	Base::DataStreamIn<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Queue> in_indexed_xyzrgb;
+	Base::DataStreamIn<Types::DeviceCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Queue> in_device_cloud_xyzrgb;
 
 	// Output data streams
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_segments;
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_colored;
+	Base::DataStreamOut<std::vector<Types::CloudView<pcl::PointXYZRGB> > > out_views;
 
 	// Handlers
 	Base::EventHandler2 h_onNewData;
+	Base::EventHandler2 h_onNewIndexedData;
+	Base::EventHandler2 h_onNewDeviceData;
 
 	// Properties
 
+	/// Cluster organized clouds in image space, unorganized ones always use kd-tree.
+	Base::Property<bool> organized;
+
+	/// Publish copy of every segment on out_segments, views on out_views are always published.
+	Base::Property<bool> copy_segments;
+
+	/// Property: cluster unorganized clouds on the GPU (needs build with CUDA), falls back to kd-tree.
+	Base::Property<bool> gpu;
+
+	Types::OrganizedClustering organized_clustering;
 	
 	// Handlers
 	void onNewData();
+	void onNewIndexedData();
+	void onNewDeviceData();
+
+	/// Segments the cloud, using its search index.
+	void cluster(const Types::IndexedCloud<pcl::PointXYZRGB> & input);
+
+	/// Segments the device cloud on the GPU. Returns false if it was not clustered.
+	bool clusterDevice(const Types::DeviceCloud<pcl::PointXYZRGB> & cloud, std::vector<pcl::PointIndices> & cluster_indices);
+
+	/// Publishes views, segments and the colored cloud of clusters.
+	void publish(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr & cloud,
+			const boost::shared_ptr<std::vector<pcl::PointIndices> > & cluster_indices);
+
+	/// Property: frames taken from inputs - newest (the latest waiting frame), queue or deadline.
+	Base::Property<std::string> input_policy;
+
+	/// Property: frames waiting in a queue, older ones are dropped, 0 - unbounded.
+	Base::Property<int> input_queue;
+
+	/// Property: age since capture (ms) of frames dropped with the deadline policy.
+	Base::Property<float> input_deadline;
+
+	// Policies of inputs.
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> input_xyzrgb;
+	Types::InputPolicy<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr> input_indexed_xyzrgb;
+	Types::InputPolicy<Types::DeviceCloud<pcl::PointXYZRGB>::Ptr> input_device_xyzrgb;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
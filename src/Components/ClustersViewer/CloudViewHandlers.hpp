@@ -0,0 +1,105 @@
+/*!
+ * \file
+ * \brief Visualizer handlers reading points through cloud views.
+ * \author Micha Laszkowski
+ */
+
+#ifndef CLOUDVIEWHANDLERS_HPP_
+#define CLOUDVIEWHANDLERS_HPP_
+
+#include <string>
+
+#include <pcl/visualization/point_cloud_handlers.h>
+
+#include <vtkPoints.h>
+#include <vtkFloatArray.h>
+#include <vtkUnsignedCharArray.h>
+
+#include "Types/CloudView.hpp"
+
+namespace Processors {
+namespace ClustersViewer {
+
+/*!
+ * \class CloudViewGeometryHandler
+ * \brief Geometry of the points of a view, gathered directly from the parent cloud.
+ */
+template <typename PointT>
+class CloudViewGeometryHandler: public pcl::visualization::PointCloudGeometryHandler<PointT> {
+public:
+	CloudViewGeometryHandler(const Types::CloudView<PointT> & view) :
+		pcl::visualization::PointCloudGeometryHandler<PointT>(view.cloud()), view_(view) {
+		this->capable_ = true;
+	}
+
+	virtual std::string getName() const {
+		return "CloudViewGeometryHandler";
+	}
+
+	virtual std::string getFieldName() const {
+		return "xyz";
+	}
+
+	virtual void getGeometry(vtkSmartPointer<vtkPoints> & points) const {
+		if (!points)
+			points = vtkSmartPointer<vtkPoints>::New();
+		points->SetDataTypeToFloat();
+		points->SetNumberOfPoints(view_.size());
+
+		float * data = static_cast<vtkFloatArray *>(points->GetData())->GetPointer(0);
+		for (size_t i = 0; i < view_.size(); ++i, data += 3) {
+			const PointT & p = view_[i];
+			data[0] = p.x;
+			data[1] = p.y;
+			data[2] = p.z;
+		}
+	}
+
+private:
+	Types::CloudView<PointT> view_;
+};
+
+/*!
+ * \class CloudViewColorHandler
+ * \brief Single color for every point of a view.
+ */
+template <typename PointT>
+class CloudViewColorHandler: public pcl::visualization::PointCloudColorHandler<PointT> {
+public:
+	CloudViewColorHandler(const Types::CloudView<PointT> & view, unsigned char r, unsigned char g, unsigned char b) :
+		pcl::visualization::PointCloudColorHandler<PointT>(view.cloud()), size_(view.size()), r_(r), g_(g), b_(b) {
+		this->capable_ = true;
+	}
+
+	virtual std::string getName() const {
+		return "CloudViewColorHandler";
+	}
+
+	virtual std::string getFieldName() const {
+		return "";
+	}
+
+	virtual bool getColor(vtkSmartPointer<vtkDataArray> & scalars) const {
+		if (!scalars)
+			scalars = vtkSmartPointer<vtkUnsignedCharArray>::New();
+		scalars->SetNumberOfComponents(3);
+		scalars->SetNumberOfTuples(size_);
+
+		unsigned char * colors = static_cast<vtkUnsignedCharArray *>(scalars.GetPointer())->GetPointer(0);
+		for (size_t i = 0; i < size_; ++i, colors += 3) {
+			colors[0] = r_;
+			colors[1] = g_;
+			colors[2] = b_;
+		}
+		return true;
+	}
+
+private:
+	size_t size_;
+	unsigned char r_, g_, b_;
+};
+
+} //: namespace ClustersViewer
+} //: namespace Processors
+
+#endif /* CLOUDVIEWHANDLERS_HPP_ */
@@ -8,6 +8,7 @@
 #include <string>
 
 #include "ClustersViewer.hpp"
+#include "CloudViewHandlers.hpp"
 #include "Common/Logger.hpp"
 
 #include <boost/bind.hpp>
@@ -18,10 +19,23 @@ namespace ClustersViewer {
 ClustersViewer::ClustersViewer(const std::string & name) :
 		Base::Component(name),
 		title("title", std::string("ClustersViewer")),
-		prop_coordinate_system("coordinate_system", true)
+		prop_coordinate_system("coordinate_system", true),
+		prop_lod("lod.enabled", false),
+		prop_lod_budget("lod.budget", 1000000),
+		prop_lod_pixels("lod.pixels", 2.0),
+		prop_render_thread("render.thread", true),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name)
 {
 			registerProperty(title);
 			registerProperty(prop_coordinate_system);
+			registerProperty(prop_lod);
+			registerProperty(prop_lod_budget);
+			registerProperty(prop_lod_pixels);
+			registerProperty(prop_render_thread);
+			registerProperty(profile);
+			registerProperty(profile_period);
 }
 
 ClustersViewer::~ClustersViewer() {
@@ -31,20 +45,52 @@ void ClustersViewer::prepareInterface() {
 	// Register data streams, events and event handlers HERE!
 	registerStream("in_clouds", &in_clouds);
     registerStream("in_projections", &in_projections);
+    registerStream("in_views", &in_views);
 	// Register handlers
-    registerHandler("on_clouds", boost::bind(&ClustersViewer::on_clouds, this));
+    registerHandler("on_clouds", profiler.wrap("on_clouds", boost::bind(&ClustersViewer::on_clouds, this)));
 	addDependency("on_clouds", &in_clouds);
-    registerHandler("on_projections", boost::bind(&ClustersViewer::on_projections, this));
+    registerHandler("on_projections", profiler.wrap("on_projections", boost::bind(&ClustersViewer::on_projections, this)));
     addDependency("on_projections", &in_projections);
+    registerHandler("on_views", profiler.wrap("on_views", boost::bind(&ClustersViewer::on_views, this)));
+    addDependency("on_views", &in_views);
 	
 	// Register spin handler.
-    registerHandler("on_spin", boost::bind(&ClustersViewer::on_spin, this));
+    registerHandler("on_spin", profiler.wrap("on_spin", boost::bind(&ClustersViewer::on_spin, this)));
 	addDependency("on_spin", NULL);
 
 }
 
 bool ClustersViewer::onInit() {
+	profiler.setEnabled(profile, profile_period);
 	LOG(LTRACE) << "ClustersViewer::onInit";
+	viewer = NULL;
+	// VTK window must be used only by the thread that created it.
+	if (prop_render_thread)
+		render_thread.start(boost::bind(&ClustersViewer::createViewer, this), boost::bind(&ClustersViewer::render, this),
+				boost::bind(&ClustersViewer::destroyViewer, this));
+	else
+		createViewer();
+ 	return true;
+}
+
+bool ClustersViewer::onFinish() {
+	profiler.report();
+	if (prop_render_thread)
+		render_thread.stop();
+	else
+		destroyViewer();
+	return true;
+}
+
+bool ClustersViewer::onStop() {
+	return true;
+}
+
+bool ClustersViewer::onStart() {
+	return true;
+}
+
+void ClustersViewer::createViewer() {
 	// Create visualizer.
 	viewer = new pcl::visualization::PCLVisualizer (title);
 	viewer->initCameraParameters ();
@@ -58,25 +104,64 @@ bool ClustersViewer::onInit() {
 	// TODO: Fix for other versions of PCL.
 	}
     count = 0;
+    view_count = 0;
+}
 
- 	return true;
+void ClustersViewer::destroyViewer() {
+	if (!viewer)
+		return;
+	viewer->close();
+	delete viewer;
+	viewer = NULL;
 }
 
-bool ClustersViewer::onFinish() {
-	return true;
+void ClustersViewer::on_clouds() {
+    LOG(LTRACE) << "ClustersViewer::on_clouds";
+	mail_clouds.write(in_clouds.read());
+	if (!prop_render_thread)
+		display();
 }
 
-bool ClustersViewer::onStop() {
-	return true;
+void ClustersViewer::on_projections() {
+    LOG(LTRACE) << "ClustersViewer::on_projections";
+	mail_projections.write(in_projections.read());
+	if (!prop_render_thread)
+		display();
 }
 
-bool ClustersViewer::onStart() {
-	return true;
+void ClustersViewer::on_views() {
+    LOG(LTRACE) << "ClustersViewer::on_views";
+	mail_views.write(in_views.read());
+	if (!prop_render_thread)
+		display();
 }
 
-void ClustersViewer::on_clouds() {
-    LOG(LTRACE) << "ClustersViewer::on_clouds";
-	std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> clouds = in_clouds.read();
+void ClustersViewer::on_spin() {
+	// Rendering thread spins by itself.
+	if (!prop_render_thread)
+		render();
+}
+
+void ClustersViewer::display() {
+	if (mail_clouds.fresh())
+		showClouds(mail_clouds.take());
+	if (mail_projections.fresh())
+		showProjections(mail_projections.take());
+	if (mail_views.fresh())
+		showViews(mail_views.take());
+}
+
+void ClustersViewer::render() {
+	if (!viewer)
+		return;
+	display();
+	if (prop_lod)
+		refreshLOD();
+	viewer->spinOnce (100);
+}
+
+void ClustersViewer::showClouds(const std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> & clouds) {
+    LOG(LTRACE) << "ClustersViewer::showClouds";
 	
 //    unsigned char colors[ 10 ][ 3 ] = {
 //        { 255, 255, 255 },
@@ -115,6 +200,16 @@ void ClustersViewer::on_clouds() {
 		count = 10;
 	
 
+	// Hierarchy is built once per cloud, level is chosen on every spin.
+	if (prop_lod) {
+		lods.resize(10);
+		lod_levels.assign(10, -1);
+		for(int i = 0; i < count; i++)
+			lods[i].build(clouds[i]);
+		refreshLOD();
+		return;
+	}
+
 	for(int i = 0; i < count; i++){
 		char id = '0' + i;
 		viewer->updatePointCloud(clouds[i],std::string("cloud_xyz") + id);	
@@ -123,9 +218,27 @@ void ClustersViewer::on_clouds() {
 	
 }
 
-void ClustersViewer::on_projections() {
-    LOG(LTRACE) << "ClustersViewer::on_projections";
-    std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> projections = in_projections.read();
+void ClustersViewer::refreshLOD() {
+	std::vector<pcl::visualization::Camera> cameras;
+	viewer->getCameras(cameras);
+	if (cameras.empty())
+		return;
+
+	// Budget is split between clouds.
+	const size_t budget = std::max(1, (int) prop_lod_budget) / std::max(1, count);
+	for(int i = 0; i < count && i < lods.size(); i++){
+		const int level = lods[i].select(cameras[0], Eigen::Matrix4f::Identity(), budget, prop_lod_pixels);
+		if (level == lod_levels[i])
+			continue;
+		lod_levels[i] = level;
+		char id = '0' + i;
+		viewer->updatePointCloud<pcl::PointXYZ>(lods[i].cloud(level), std::string("cloud_xyz") + id);
+        LOG(LTRACE) << "updatePointCloud "<< i << " level " << level << " points " << lods[i].count(level) <<endl;
+	}
+}
+
+void ClustersViewer::showProjections(const std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> & projections) {
+    LOG(LTRACE) << "ClustersViewer::showProjections";
     viewer->removeAllShapes();
 
     for(int i = 0; i < projections.size() && i < 10; i++){
@@ -147,11 +260,31 @@ void ClustersViewer::on_projections() {
     }
 }
 
-void ClustersViewer::on_spin() {
-	viewer->spinOnce (100);
+void ClustersViewer::showViews(const std::vector<Types::CloudView<pcl::PointXYZ> > & views) {
+    LOG(LTRACE) << "ClustersViewer::showViews";
+
+    // Geometry handlers read points through the views, clusters are never copied into clouds.
+    for(int i = 0; i < view_count; i++){
+        char id = '0' + i;
+        viewer->removePointCloud(std::string("view_xyz") + id);
+    }
+
+    view_count = views.size();
+    if (view_count>10)
+        view_count = 10;
+
+    for(int i = 0; i < view_count; i++){
+        char id = '0' + i;
+        CloudViewGeometryHandler<pcl::PointXYZ> geometry(views[i]);
+        CloudViewColorHandler<pcl::PointXYZ> color(views[i], colors[i][0], colors[i][1], colors[i][2]);
+        viewer->addPointCloud<pcl::PointXYZ> (views[i].cloud(), color, geometry, std::string("view_xyz") + id);
+        viewer->setPointCloudRenderingProperties (pcl::visualization::PCL_VISUALIZER_POINT_SIZE, 1, std::string("view_xyz") + id);
+        LOG(LTRACE) << "addPointCloud view "<< i <<endl;
+    }
 }
 
 
 
+
 } //: namespace ClustersViewer
 } //: namespace Processors
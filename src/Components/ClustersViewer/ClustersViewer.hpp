@@ -13,8 +13,15 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <pcl/visualization/pcl_visualizer.h>
 
+#include "Types/CloudView.hpp"
+#include "Types/CloudLOD.hpp"
+#include "Types/LatestValue.hpp"
+#include "Types/RenderThread.hpp"
+
 namespace Processors {
 namespace ClustersViewer {
 
@@ -69,15 +76,54 @@ protected:
 	// Input data streams
     Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > in_clouds;
     Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > in_projections;
+    Base::DataStreamIn<std::vector<Types::CloudView<pcl::PointXYZ> > > in_views;
 
 	// Handlers
 	void on_clouds();
     void on_projections();
+    void on_views();
 	void on_spin();
+
+	/// Displays levels of detail of clouds that suit the current camera.
+	void refreshLOD();
+
+	/// Display data of the given kind.
+	void showClouds(const std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> & clouds);
+	void showProjections(const std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> & projections);
+	void showViews(const std::vector<Types::CloudView<pcl::PointXYZ> > & views);
+
+	/// Displays data taken from the mailboxes.
+	void display();
+
+	/// Rendering step - displays new data and spins the viewer.
+	void render();
+
+	void createViewer();
+	void destroyViewer();
+
+	/// Mailboxes passing data of input streams to the rendering thread.
+	Types::LatestValue<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > mail_clouds;
+	Types::LatestValue<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > mail_projections;
+	Types::LatestValue<std::vector<Types::CloudView<pcl::PointXYZ> > > mail_views;
+
+	/// Thread rendering the viewer.
+	Types::RenderThread render_thread;
 	
 	// Property enabling to change the name of displayed window.
 	Base::Property<std::string> title;
 	Base::Property<bool> prop_coordinate_system;
+
+	/// Property: display levels of detail of clouds instead of full clouds.
+	Base::Property<bool> prop_lod;
+
+	/// Property: maximal number of displayed points of all clouds in level of detail mode.
+	Base::Property<int> prop_lod_budget;
+
+	/// Property: minimal size of displayed octree cell, in pixels.
+	Base::Property<float> prop_lod_pixels;
+
+	/// Property: render on a dedicated thread instead of in the handlers (the viewer is created by that thread).
+	Base::Property<bool> prop_render_thread;
 	
 	/// Point cloud viewer.
 	pcl::visualization::PCLVisualizer * viewer;
@@ -85,6 +131,13 @@ protected:
 	
     int count;
 
+    /// Number of displayed cluster views.
+    int view_count;
+
+    /// Levels of detail of clouds and levels currently displayed.
+    std::vector<Types::CloudLOD<pcl::PointXYZ> > lods;
+    std::vector<int> lod_levels;
+
     const unsigned char colors[ 10 ][ 3 ] = {
         { 255, 255, 255 },
         { 255, 0, 0 },
@@ -98,6 +151,15 @@ protected:
         { 128, 128, 128 }
     };
 
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace ClustersViewer
@@ -12,17 +12,40 @@
 
 #include <boost/bind.hpp>
 
-#include <pcl/io/pcd_io.h>
-
-#include <pcl/filters/filter.h>
+#include "Types/CloudPool.hpp"
+#include "Types/CaptureTime.hpp"
 
 namespace Processors {
 namespace DepthConverter {
 
 DepthConverter::DepthConverter(const std::string & name) :
 		Base::Component(name),
-		prop_remove_nan("remove_nan", true)  {
+		prop_remove_nan("remove_nan", true),
+		prop_undistort("undistort", false),
+		prop_pixel_indices("pixel_indices", false),
+		prop_roi("roi", false),
+		roi_x_min("roi.x.min", -10),
+		roi_x_max("roi.x.max", 10),
+		roi_y_min("roi.y.min", -10),
+		roi_y_max("roi.y.max", 10),
+		roi_z_min("roi.z.min", 0),
+		roi_z_max("roi.z.max", 10),
+		roi_received(false),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
 			registerProperty(prop_remove_nan);
+			registerProperty(prop_undistort);
+			registerProperty(prop_pixel_indices);
+			registerProperty(prop_roi);
+			registerProperty(roi_x_min);
+			registerProperty(roi_x_max);
+			registerProperty(roi_y_min);
+			registerProperty(roi_y_max);
+			registerProperty(roi_z_min);
+			registerProperty(roi_z_max);
+			registerProperty(profile);
+			registerProperty(profile_period);
 }
 
 DepthConverter::~DepthConverter() {
@@ -35,25 +58,27 @@ void DepthConverter::prepareInterface() {
 	registerStream("in_color", &in_color);
 	registerStream("in_mask", &in_mask);
 	registerStream("in_camera_info", &in_camera_info);
+	registerStream("in_roi", &in_roi);
 	registerStream("out_cloud_xyz", &out_cloud_xyz);
 	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
+	registerStream("out_pixel_indices", &out_pixel_indices);
 
 	// Register handlers - depth dependent functions (CAMERA INFO required).
-	registerHandler("process_depth", boost::bind(&DepthConverter::process_depth, this));
+	registerHandler("process_depth", profiler.wrap("process_depth", boost::bind(&DepthConverter::process_depth, this)));
 	addDependency("process_depth", &in_depth);
 	addDependency("process_depth", &in_camera_info);
 
-	registerHandler("process_depth_mask", boost::bind(&DepthConverter::process_depth_mask, this));
+	registerHandler("process_depth_mask", profiler.wrap("process_depth_mask", boost::bind(&DepthConverter::process_depth_mask, this)));
 	addDependency("process_depth_mask", &in_depth);
 	addDependency("process_depth_mask", &in_camera_info);	
 	addDependency("process_depth_mask", &in_mask);
 
-	registerHandler("process_depth_color", boost::bind(&DepthConverter::process_depth_color, this));
+	registerHandler("process_depth_color", profiler.wrap("process_depth_color", boost::bind(&DepthConverter::process_depth_color, this)));
 	addDependency("process_depth_color", &in_depth);
 	addDependency("process_depth_color", &in_camera_info);
 	addDependency("process_depth_color", &in_color);
 
-	registerHandler("process_depth_mask_color", boost::bind(&DepthConverter::process_depth_mask_color, this));
+	registerHandler("process_depth_mask_color", profiler.wrap("process_depth_mask_color", boost::bind(&DepthConverter::process_depth_mask_color, this)));
 	addDependency("process_depth_mask_color", &in_depth);
 	addDependency("process_depth_mask_color", &in_camera_info);	
 	addDependency("process_depth_mask_color", &in_mask);
@@ -61,29 +86,31 @@ void DepthConverter::prepareInterface() {
 
 	
 	// Register handlers - XYZ depth dependent functions.
-	registerHandler("process_depth_xyz", boost::bind(&DepthConverter::process_depth_xyz, this));
+	registerHandler("process_depth_xyz", profiler.wrap("process_depth_xyz", boost::bind(&DepthConverter::process_depth_xyz, this)));
 	addDependency("process_depth_xyz", &in_depth_xyz);
 
-	registerHandler("process_depth_xyz_mask", boost::bind(&DepthConverter::process_depth_xyz_mask, this));
+	registerHandler("process_depth_xyz_mask", profiler.wrap("process_depth_xyz_mask", boost::bind(&DepthConverter::process_depth_xyz_mask, this)));
 	addDependency("process_depth_xyz_mask", &in_depth_xyz);
 	addDependency("process_depth_xyz_mask", &in_mask);
 
-	registerHandler("process_depth_xyz_color", boost::bind(&DepthConverter::process_depth_xyz_color, this));
+	registerHandler("process_depth_xyz_color", profiler.wrap("process_depth_xyz_color", boost::bind(&DepthConverter::process_depth_xyz_color, this)));
 	addDependency("process_depth_xyz_color", &in_depth_xyz);
 	addDependency("process_depth_xyz_color", &in_color);
 
-	registerHandler("process_depth_xyz_color_mask", boost::bind(&DepthConverter::process_depth_xyz_color_mask, this));
+	registerHandler("process_depth_xyz_color_mask", profiler.wrap("process_depth_xyz_color_mask", boost::bind(&DepthConverter::process_depth_xyz_color_mask, this)));
 	addDependency("process_depth_xyz_color_mask", &in_depth_xyz);
 	addDependency("process_depth_xyz_color_mask", &in_color);
 	addDependency("process_depth_xyz_color_mask", &in_mask);
 }
 
 bool DepthConverter::onInit() {
+	profiler.setEnabled(profile, profile_period);
 	CLOG(LTRACE) << "DepthConverter::onInit";
 	return true;
 }
 
 bool DepthConverter::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -95,433 +122,165 @@ bool DepthConverter::onStart() {
 	return true;
 }
 
-void DepthConverter::process_depth() {
-	CLOG(LTRACE) << "DepthConverter::process_depth\n";
-	
-	Types::CameraInfo camera_info = in_camera_info.read();
-	cv::Mat depth = in_depth.read();
-
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>(camera_info.width(), camera_info.height()));
-
-	double fx_d = 0.001 / camera_info.fx();
-	double fy_d = 0.001 / camera_info.fy();
-	double cx_d = camera_info.cx();
-	double cy_d = camera_info.cy();
-
-	float bad_point = std::numeric_limits<float>::quiet_NaN();
-
-	pcl::PointCloud<pcl::PointXYZ>::iterator pt_iter = cloud->begin();
-	const uint16_t* depth_row = reinterpret_cast<const uint16_t*>(&depth.data[0]);
-
-	int row_step = depth.step1();
-	for (int v = 0; v < (int) cloud->height; ++v, depth_row += row_step) {
-		for (int u = 0; u < (int) cloud->width; ++u) {
-			pcl::PointXYZ& pt = *pt_iter++;
-			uint16_t depth = depth_row[u];
+const Types::DepthBackProjection::RayTable & DepthConverter::rays(const Types::CameraInfo & camera_info, const cv::Mat & depth) {
+	// Depth map in millimeters.
+	Types::DepthBackProjection::Intrinsics K(camera_info.fx(), camera_info.fy(), camera_info.cx(), camera_info.cy(), 0.001f);
+	if (ray_table.update(K, depth.cols, depth.rows, prop_undistort ? camera_info.distCoeffs() : cv::Mat())) {
+		CLOG(LINFO) << "Ray table rebuilt for " << depth.cols << "x" << depth.rows << (ray_table.separable() ? "" : " (undistorted)");
+	}
+	return ray_table;
+}
 
-			// Missing points denoted by NaNs
-			if (depth == 0) {
-				pt.x = pt.y = pt.z = bad_point;
-				continue;
+const Types::DepthBackProjection::Roi * DepthConverter::roi(const Types::DepthBackProjection::RayTable * rays) {
+	if (!in_roi.empty()) {
+		roi_box = in_roi.read();
+		roi_received = true;
+	}
+	if (!prop_roi && !roi_received)
+		return NULL;
+
+	float min[3], max[3];
+	if (roi_received) {
+		// Negative ranges keep points on both sides, such axes are not limited.
+		for (int a = 0; a < 3; ++a) {
+			bool negative;
+			roi_box.getLimits(a, min[a], max[a], negative);
+			if (negative) {
+				min[a] = -FLT_MAX;
+				max[a] = FLT_MAX;
 			}
-
-			// Fill in XYZ
-			pt.x = (u - cx_d) * depth * fx_d;
-			pt.y = (v - cy_d) * depth * fy_d;
-			pt.z = depth * 0.001;
 		}
+	} else {
+		min[0] = roi_x_min;
+		max[0] = roi_x_max;
+		min[1] = roi_y_min;
+		max[1] = roi_y_max;
+		min[2] = roi_z_min;
+		max[2] = roi_z_max;
 	}
+	roi_projection.setBox(min, max);
+	if (rays) {
+		roi_projection.project(*rays);
+		CLOG(LDEBUG) << "ROI " << roi_projection.u0 << ".." << roi_projection.u1 << " x " << roi_projection.v0 << ".." << roi_projection.v1
+				<< ", depths " << roi_projection.dmin << ".." << roi_projection.dmax;
+	}
+	return &roi_projection;
+}
 
-	if(prop_remove_nan){
-		std::vector<int> indices;
-		cloud->is_dense = false; 
-		pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
+std::vector<int> * DepthConverter::pixelIndices() {
+	if (prop_remove_nan && prop_pixel_indices) {
+		pixel_indices.reset(new std::vector<int>);
+		return pixel_indices.get();
 	}
-	
-	out_cloud_xyz.write(cloud);
-/*	pcl::io::savePCDFileASCII ("test_pcd.pcd", *cloud);
-	CCLOG(LNOTICE) << "Saved " << cloud->points.size () << " data points to test_pcd.pcd.";*/
+	pixel_indices.reset();
+	return NULL;
 }
 
-void DepthConverter::process_depth_mask() {
-	CLOG(LTRACE) << "DepthConverter::process_depth_mask\n";
-	
+template <typename PointT>
+void DepthConverter::publish(typename pcl::PointCloud<PointT>::Ptr cloud, Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out,
+		uint64_t captured) {
+	CLOG(LDEBUG) << "Converted points: " << cloud->size();
+	profiler.points(0, cloud->size());
+	if (pixel_indices)
+		out_pixel_indices.write(pixel_indices);
+	Types::CaptureTime::stamp(*cloud, captured);
+	out.write(cloud);
+}
+
+void DepthConverter::process_depth() {
+	CLOG(LTRACE) << "DepthConverter::process_depth\n";
 	Types::CameraInfo camera_info = in_camera_info.read();
 	cv::Mat depth = in_depth.read();
-	cv::Mat mask = in_mask.read();
-	mask.convertTo(mask, CV_32F);
-	
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>(camera_info.width(), camera_info.height()));
-
-//	cloud.width = camera_info.width();
-//	cloud.height = camera_info.height();
-//	cloud.points.resize(cloud.width * cloud.height);
-
-	double fx_d = 0.001 / camera_info.fx();
-	double fy_d = 0.001 / camera_info.fy();
-	double cx_d = camera_info.cx();
-	double cy_d = camera_info.cy();
-
-	float bad_point = std::numeric_limits<float>::quiet_NaN();
-
-	pcl::PointCloud<pcl::PointXYZ>::iterator pt_iter = cloud->begin();
-	const uint16_t* depth_row = reinterpret_cast<const uint16_t*>(&depth.data[0]);
+	const uint64_t captured = Types::CaptureTime::now();
 
-	int row_step = depth.step1();
-	for (int v = 0; v < (int) cloud->height; ++v, depth_row += row_step) {
-		for (int u = 0; u < (int) cloud->width; ++u) {
-			pcl::PointXYZ& pt = *pt_iter++;
-			uint16_t depth = depth_row[u];
-
-			// Missing points denoted by NaNs
-			if (depth == 0 || mask.at<float>(v, u)==0) {
-				pt.x = pt.y = pt.z = bad_point;
-				continue;
-			}
-
-			// Fill in XYZ
-			pt.x = (u - cx_d) * depth * fx_d;
-			pt.y = (v - cy_d) * depth * fy_d;
-			pt.z = depth * 0.001;
-		}
-	}
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = Types::CloudPool<pcl::PointXYZ>::acquire(depth.total());
+	const Types::DepthBackProjection::RayTable & table = rays(camera_info, depth);
+	Types::DepthBackProjection::backProjectDepth<false>(depth, table, NULL, cv::Mat(), *cloud, prop_remove_nan, pixelIndices(), roi(&table));
+	publish<pcl::PointXYZ>(cloud, out_cloud_xyz, captured);
+}
 
-	if(prop_remove_nan){
-		std::vector<int> indices;
-		cloud->is_dense = false; 
-		pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
-	}
+void DepthConverter::process_depth_mask() {
+	CLOG(LTRACE) << "DepthConverter::process_depth_mask\n";
+	Types::CameraInfo camera_info = in_camera_info.read();
+	cv::Mat depth = in_depth.read();
+	const uint64_t captured = Types::CaptureTime::now();
+	mask_runs.build(in_mask.read());
 
-	out_cloud_xyz.write(cloud);
-	/*pcl::io::savePCDFileASCII ("test_pcd.pcd", *cloud);
-	CCLOG(LNOTICE) << "Saved " << cloud->points.size () << " data points to test_pcd.pcd.";*/
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = Types::CloudPool<pcl::PointXYZ>::acquire(depth.total());
+	const Types::DepthBackProjection::RayTable & table = rays(camera_info, depth);
+	Types::DepthBackProjection::backProjectDepth<false>(depth, table, &mask_runs, cv::Mat(), *cloud, prop_remove_nan, pixelIndices(), roi(&table));
+	publish<pcl::PointXYZ>(cloud, out_cloud_xyz, captured);
 }
 
 void DepthConverter::process_depth_mask_color() {
 	CLOG(LTRACE) << "DepthConverter::process_depth_mask_color\n";
-	
 	Types::CameraInfo camera_info = in_camera_info.read();
 	cv::Mat depth = in_depth.read();
-	cv::Mat mask = in_mask.read();
-	mask.convertTo(mask, CV_32F);
+	const uint64_t captured = Types::CaptureTime::now();
+	mask_runs.build(in_mask.read());
 	cv::Mat color = in_color.read();
-	//color.convertTo(color, CV_8UC3);
-
-	
-	
-	//for(int i=0; i < features.features.size(); i++){
-		////cout<<features.features[i].pt<<endl;
-	//}
-	
-	
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>(camera_info.width(), camera_info.height()));
-
-	double fx_d = 0.001 / camera_info.fx();
-	double fy_d = 0.001 / camera_info.fy();
-	double cx_d = camera_info.cx();
-	double cy_d = camera_info.cy();
-
-	float bad_point = std::numeric_limits<float>::quiet_NaN();
-
-	pcl::PointCloud<pcl::PointXYZRGB>::iterator pt_iter = cloud->begin();
-	const uint16_t* depth_row = reinterpret_cast<const uint16_t*>(&depth.data[0]);
-
-	int row_step = depth.step1();
-	for (int v = 0; v < (int) cloud->height; ++v, depth_row += row_step) {
-		for (int u = 0; u < (int) cloud->width; ++u) {
-			//pcl::PointXYZ& pt = *pt_iter++;
-			pcl::PointXYZRGB& pt = *pt_iter++;
-			uint16_t depth = depth_row[u];
-
-			// Missing points denoted by NaNs
-			if (depth == 0 || mask.at<float>(v, u)==0) {
-				pt.x = pt.y = pt.z = bad_point;
-				continue;
-			}
-
-			// Fill in XYZ
-			pt.x = (u - cx_d) * depth * fx_d;
-			pt.y = (v - cy_d) * depth * fy_d;
-			pt.z = depth * 0.001;
-			
-			// Fill in RGB
-			cv::Vec3b bgr = color.at<cv::Vec3b>(v, u);
-			int b = bgr[0];
-			int g = bgr[1];
-			int r = bgr[2];
-			//cout<< b << " " << g << " " << r << endl;// << " " << bgr[1] << " " << bgr[2]<<endl;			
-			pt.r = r;
-			pt.g = g;
-			pt.b = b;
-		}
-	}
-
-
-	if(prop_remove_nan){
-		std::vector<int> indices;
-		cloud->is_dense = false; 
-		pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
-	}
 
-	out_cloud_xyzrgb.write(cloud);
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = Types::CloudPool<pcl::PointXYZRGB>::acquire(depth.total());
+	const Types::DepthBackProjection::RayTable & table = rays(camera_info, depth);
+	Types::DepthBackProjection::backProjectDepth<true>(depth, table, &mask_runs, color, *cloud, prop_remove_nan, pixelIndices(), roi(&table));
+	publish<pcl::PointXYZRGB>(cloud, out_cloud_xyzrgb, captured);
 }
 
 void DepthConverter::process_depth_color() {
-    CLOG(LTRACE) << "DepthConverter::process_depth_color\n";
+	CLOG(LTRACE) << "DepthConverter::process_depth_color\n";
 	Types::CameraInfo camera_info = in_camera_info.read();
 	cv::Mat depth = in_depth.read();
+	const uint64_t captured = Types::CaptureTime::now();
 	cv::Mat color = in_color.read();
-	CLOG(LDEBUG) << "Width"<< camera_info.width()<<" Height: "<<camera_info.height()<<endl;
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>(camera_info.width(), camera_info.height()));
-
-	double fx_d = 0.001 / camera_info.fx();
-	double fy_d = 0.001 / camera_info.fy();
-	double cx_d = camera_info.cx();
-	double cy_d = camera_info.cy();
-
-	float bad_point = std::numeric_limits<float>::quiet_NaN();
-
-	pcl::PointCloud<pcl::PointXYZRGB>::iterator pt_iter = cloud->begin();
-	const uint16_t* depth_row = reinterpret_cast<const uint16_t*>(&depth.data[0]);
-
-	int row_step = depth.step1();
-	for (int v = 0; v < (int) cloud->height; ++v, depth_row += row_step) {
-		for (int u = 0; u < (int) cloud->width; ++u) {
-			pcl::PointXYZRGB& pt = *pt_iter++;
-			uint16_t depth = depth_row[u];
-
-			// Missing points denoted by NaNs
-			if (depth == 0) {
-				pt.x = pt.y = pt.z = bad_point;
-				continue;
-			}
-
-			// Fill in XYZ
-			pt.x = (u - cx_d) * depth * fx_d;
-			pt.y = (v - cy_d) * depth * fy_d;
-			pt.z = depth * 0.001;
-			
-			// Fill in RGB
-			//pt.rgba = color.at<float>(v, u);
-			cv::Vec3b bgr = color.at<cv::Vec3b>(v, u);
-			int b = bgr[0];
-			int g = bgr[1];
-			int r = bgr[2];		
-			pt.r = r;
-			pt.g = g;
-			pt.b = b;
-		}
-	}
 
-	if(prop_remove_nan){
-		std::vector<int> indices;
-		cloud->is_dense = false; 
-		pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
-	}
-
-	out_cloud_xyzrgb.write(cloud);
-	
-	
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = Types::CloudPool<pcl::PointXYZRGB>::acquire(depth.total());
+	const Types::DepthBackProjection::RayTable & table = rays(camera_info, depth);
+	Types::DepthBackProjection::backProjectDepth<true>(depth, table, NULL, color, *cloud, prop_remove_nan, pixelIndices(), roi(&table));
+	publish<pcl::PointXYZRGB>(cloud, out_cloud_xyzrgb, captured);
 }
 
 void DepthConverter::process_depth_xyz() {
-    CLOG(LTRACE) << "DepthConverter::process_depth_xyz"<<endl;
-    cv::Mat depth_xyz = in_depth_xyz.read();
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>(depth_xyz.cols,depth_xyz.rows));
-
-    const double max_z = 1.0e4;
-    CLOG(LINFO) << "Generating depth point cloud";
-    try {
-        for(int y = 0; y < depth_xyz.rows; y++)
-        {
-            for(int x = 0; x < depth_xyz.cols; x++)
-            {
-                cv::Vec3f point = depth_xyz.at<cv::Vec3f>(y, x);
-                if(fabs(point[2] - max_z) < FLT_EPSILON || fabs(point[2]) > max_z) continue;
-
-                //Insert info into point cloud structure
-                pcl::PointXYZ point1;
-                point1.x = point[0];
-                point1.y = point[1];
-                point1.z = point[2];
-                cloud->push_back(point1);
-            }
-        }
-    } catch (...)
-    {
-        CLOG(LERROR) << "Error occurred in processing input";
-    }
-
-
-//    pcl::PointCloud<pcl::PointXYZ>::iterator pt_iter = cloud->begin();
-//    for (int v = 0; v < (int) cloud->height; ++v) {
-//        for (int u = 0; u < (int) cloud->width; ++u) {
-//            pcl::PointXYZ& pt = *pt_iter++;
-//            // Fill in XYZ
-//            pt.x = depth_xyz[u][v][0];
-//            pt.y = depth_xyz[u][v][1];
-//            pt.z = depth_xyz[u][v][2];
-
-//        }
-//    }
-
-    if(prop_remove_nan){
-        std::vector<int> indices;
-        cloud->is_dense = false;
-        pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
-    }
-    out_cloud_xyz.write(cloud);
+	CLOG(LTRACE) << "DepthConverter::process_depth_xyz\n";
+	cv::Mat depth_xyz = in_depth_xyz.read();
+	const uint64_t captured = Types::CaptureTime::now();
+
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = Types::CloudPool<pcl::PointXYZ>::acquire(depth_xyz.total());
+	Types::DepthBackProjection::backProjectXYZ<false>(depth_xyz, NULL, cv::Mat(), *cloud, prop_remove_nan, pixelIndices(), roi(NULL));
+	publish<pcl::PointXYZ>(cloud, out_cloud_xyz, captured);
 }
 
 void DepthConverter::process_depth_xyz_color() {
-    CLOG(LTRACE) << "DepthConverter::process_depth_xyz_color()"<<endl;
-    cv::Mat depth_xyz = in_depth_xyz.read();
-    cv::Mat color = in_color.read();
-
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>());
-    uint32_t pr, pg, pb;
-    const double max_z = 1.0e4;
-
-    CLOG(LINFO) << "Generating depth point cloud";
-    try {
-        for(int y = 0; y < depth_xyz.rows; y++)
-        {
-            uchar* rgb_ptr = color.ptr<uchar>(y);
-            for(int x = 0; x < depth_xyz.cols; x++)
-            {
-                cv::Vec3f point = depth_xyz.at<cv::Vec3f>(y, x);
-                if(fabs(point[2] - max_z) < FLT_EPSILON || fabs(point[2]) > max_z) continue;
-
-
-                //Get RGB info
-                pb = rgb_ptr[3*x];
-                pg = rgb_ptr[3*x+1];
-                pr = rgb_ptr[3*x+2];
-
-                //Insert info into point cloud structure
-                pcl::PointXYZRGB point1;
-                point1.x = point[0];
-                point1.y = point[1];
-                point1.z = point[2];
-                uint32_t rgb = (static_cast<uint32_t>(pr) << 16 | static_cast<uint32_t>(pg) << 8 | static_cast<uint32_t>(pb));
-                point1.rgb = *reinterpret_cast<float*>(&rgb);
-                cloud->push_back(point1);
-            }
-        }
-
-    } catch (...)
-    {
-        CLOG(LERROR) << "Error occurred in processing input";
-    }
-
-    if(prop_remove_nan){
-        std::vector<int> indices;
-        cloud->is_dense = false;
-        pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
-    }
-
-    out_cloud_xyzrgb.write(cloud);
+	CLOG(LTRACE) << "DepthConverter::process_depth_xyz_color\n";
+	cv::Mat depth_xyz = in_depth_xyz.read();
+	const uint64_t captured = Types::CaptureTime::now();
+	cv::Mat color = in_color.read();
+
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = Types::CloudPool<pcl::PointXYZRGB>::acquire(depth_xyz.total());
+	Types::DepthBackProjection::backProjectXYZ<true>(depth_xyz, NULL, color, *cloud, prop_remove_nan, pixelIndices(), roi(NULL));
+	publish<pcl::PointXYZRGB>(cloud, out_cloud_xyzrgb, captured);
 }
 
 void DepthConverter::process_depth_xyz_mask() {
-    CLOG(LTRACE) << "DepthConverter::process_depth_xyz_mask()"<<endl;
-    cv::Mat depth_xyz = in_depth_xyz.read();
-    cv::Mat mask = in_mask.read();
-    mask.convertTo(mask, CV_32F);
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>);
-
-    const double max_z = 1.0e4;
-    CLOG(LINFO) << "Generating depth point cloud";
-    int cnt = 0;
-    try {
-        for(int y = 0; y < depth_xyz.rows; y++)
-        {
-            for(int x = 0; x < depth_xyz.cols; x++)
-            {
-                if (mask.at<float>(y, x)==0) {
-                    continue;
-                }
-                cv::Vec3f point = depth_xyz.at<cv::Vec3f>(y, x);
-                if(fabs(point[2] - max_z) < FLT_EPSILON || fabs(point[2]) > max_z) continue;
-
-		cnt++;
-                //Insert info into point cloud structure
-                pcl::PointXYZ point1;
-                point1.x = point[0];
-                point1.y = point[1];
-                point1.z = point[2];
-                cloud->push_back(point1);
-            }
-        }
-    } catch (...)
-    {
-        CLOG(LERROR) << "Error occurred in processing input";
-    }
-    
-    CLOG(LINFO) << "Converted points: " << cnt;
-
-
-    if(prop_remove_nan){
-        std::vector<int> indices;
-        cloud->is_dense = false;
-        pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
-    }
-    CLOG(LINFO) << "Converted points: " << cloud->size();
-    out_cloud_xyz.write(cloud);
+	CLOG(LTRACE) << "DepthConverter::process_depth_xyz_mask\n";
+	cv::Mat depth_xyz = in_depth_xyz.read();
+	const uint64_t captured = Types::CaptureTime::now();
+	mask_runs.build(in_mask.read());
+
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = Types::CloudPool<pcl::PointXYZ>::acquire(depth_xyz.total());
+	Types::DepthBackProjection::backProjectXYZ<false>(depth_xyz, &mask_runs, cv::Mat(), *cloud, prop_remove_nan, pixelIndices(), roi(NULL));
+	publish<pcl::PointXYZ>(cloud, out_cloud_xyz, captured);
 }
 
 void DepthConverter::process_depth_xyz_color_mask() {
-    CLOG(LTRACE) << "DepthConverter::process_depth_xyz_color_mask()"<<endl;
-    cv::Mat depth_xyz = in_depth_xyz.read();
-    cv::Mat color = in_color.read();
-    cv::Mat mask = in_mask.read();
-    mask.convertTo(mask, CV_32F);
-
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>());
-    uint32_t pr, pg, pb;
-    const double max_z = 1.0e4;
-
-    CLOG(LINFO) << "Generating depth point cloud";
-    try {
-        for(int y = 0; y < depth_xyz.rows; y++)
-        {
-            uchar* rgb_ptr = color.ptr<uchar>(y);
-            for(int x = 0; x < depth_xyz.cols; x++)
-            {
-                if (mask.at<float>(y, x)==0) {
-                    continue;
-                }
-                cv::Vec3f point = depth_xyz.at<cv::Vec3f>(y, x);
-                if(fabs(point[2] - max_z) < FLT_EPSILON || fabs(point[2]) > max_z) continue;
-
-                //Get RGB info
-                pb = rgb_ptr[3*x];
-                pg = rgb_ptr[3*x+1];
-                pr = rgb_ptr[3*x+2];
-
-                //Insert info into point cloud structure
-                pcl::PointXYZRGB point1;
-                point1.x = point[0];
-                point1.y = point[1];
-                point1.z = point[2];
-                uint32_t rgb = (static_cast<uint32_t>(pr) << 16 | static_cast<uint32_t>(pg) << 8 | static_cast<uint32_t>(pb));
-                point1.rgb = *reinterpret_cast<float*>(&rgb);
-                cloud->push_back(point1);
-            }
-        }
-
-    } catch (...)
-    {
-        CLOG(LERROR) << "Error occurred in processing input";
-    }
-
-    if(prop_remove_nan){
-        std::vector<int> indices;
-        cloud->is_dense = false;
-        pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
-    }
-
-    out_cloud_xyzrgb.write(cloud);
+	CLOG(LTRACE) << "DepthConverter::process_depth_xyz_color_mask\n";
+	cv::Mat depth_xyz = in_depth_xyz.read();
+	const uint64_t captured = Types::CaptureTime::now();
+	cv::Mat color = in_color.read();
+	mask_runs.build(in_mask.read());
+
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = Types::CloudPool<pcl::PointXYZRGB>::acquire(depth_xyz.total());
+	Types::DepthBackProjection::backProjectXYZ<true>(depth_xyz, &mask_runs, color, *cloud, prop_remove_nan, pixelIndices(), roi(NULL));
+	publish<pcl::PointXYZRGB>(cloud, out_cloud_xyzrgb, captured);
 }
 
 
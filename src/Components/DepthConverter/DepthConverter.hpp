@@ -13,12 +13,18 @@
 #include <Property.hpp>
 #include <EventHandler2.hpp>
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <Types/CameraInfo.hpp>
 
 #include <opencv2/core/core.hpp>
 
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
+#include <pcl/pcl_base.h>
+
+#include "Types/DepthBackProjection.hpp"
+#include "Types/BoxCrop.hpp"
 
 
 
@@ -76,18 +82,24 @@ protected:
 	/// Input data stream containing colour image.
 	Base::DataStreamIn<cv::Mat, Base::DataStreamBuffer::Newest> in_color;
 
-	/// Input data stream containing mask.
+	/// Input data stream containing mask (any single-channel image, non-zero pixels are foreground).
 	Base::DataStreamIn<cv::Mat, Base::DataStreamBuffer::Newest> in_mask;
 
 	// Input data port with camera info.
 	Base::DataStreamIn<Types::CameraInfo, Base::DataStreamBuffer::Newest> in_camera_info;
 
+	/// Optional crop box in the camera frame (e.g. PassThrough.out_box), overrides the roi properties once received.
+	Base::DataStreamIn<Types::BoxCrop, Base::DataStreamBuffer::Newest> in_roi;
+
 	/// Output data port with XYZ cloud.
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr > out_cloud_xyz;
 
 	/// Output data port with XYZRGB cloud.
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr > out_cloud_xyzrgb;
 
+	/// Output data port with image indices (v * width + u) of points of the compacted cloud.
+	Base::DataStreamOut<pcl::IndicesPtr> out_pixel_indices;
+
 	// Handler functions.
 	void process_depth_mask();
 	void process_depth();
@@ -100,7 +112,64 @@ protected:
 	void process_depth_xyz_mask();
 	void process_depth_xyz_color_mask();
 
+	/// Returns buffer for pixel indices of the current frame, NULL if not requested.
+	std::vector<int> * pixelIndices();
+
+	/// Writes cloud (and pixel indices, if any) to the given port, stamped with the time the images were read.
+	template <typename PointT>
+	void publish(typename pcl::PointCloud<PointT>::Ptr cloud, Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out,
+			uint64_t captured);
+
+	/// Returns ray table for given camera, rebuilt only when intrinsics or resolution change.
+	const Types::DepthBackProjection::RayTable & rays(const Types::CameraInfo & camera_info, const cv::Mat & depth);
+
+	/// Returns ROI of the current frame projected with the rays (NULL for XYZ images), NULL if disabled.
+	const Types::DepthBackProjection::Roi * roi(const Types::DepthBackProjection::RayTable * rays);
+
 	Base::Property<bool> prop_remove_nan;
+
+	/// Bake undistortion (camera distortion coefficients) into the ray table.
+	Base::Property<bool> prop_undistort;
+
+	/// Publish image indices of points when NaNs are removed.
+	Base::Property<bool> prop_pixel_indices;
+
+	/// Convert only pixels that may hold points of the roi box (set below or received on in_roi).
+	Base::Property<bool> prop_roi;
+
+	/// Limits of the roi box, in meters in the camera frame.
+	Base::Property<float> roi_x_min;
+	Base::Property<float> roi_x_max;
+	Base::Property<float> roi_y_min;
+	Base::Property<float> roi_y_max;
+	Base::Property<float> roi_z_min;
+	Base::Property<float> roi_z_max;
+
+	/// Box received on in_roi.
+	Types::BoxCrop roi_box;
+	bool roi_received;
+
+	/// Box of the current frame and its projection.
+	Types::DepthBackProjection::Roi roi_projection;
+
+	/// Pixel indices of the current frame.
+	pcl::IndicesPtr pixel_indices;
+
+	/// Cached per-pixel rays of the depth camera.
+	Types::DepthBackProjection::RayTable ray_table;
+
+	/// Runs of the current mask.
+	Types::DepthBackProjection::MaskRuns mask_runs;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace DepthConverter
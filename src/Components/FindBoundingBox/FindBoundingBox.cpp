@@ -12,11 +12,19 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudStatistics.hpp"
+#include "Types/CloudBatch.hpp"
+
 namespace Processors {
 namespace FindBoundingBox {
 
 FindBoundingBox::FindBoundingBox(const std::string & name) :
-		Base::Component(name)  {
+		Base::Component(name),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(profile);
+	registerProperty(profile_period);
 
 }
 
@@ -25,25 +33,42 @@ FindBoundingBox::~FindBoundingBox() {
 
 void FindBoundingBox::prepareInterface() {
 	// Register data streams, events and event handlers HERE!
+	registerStream("in_cloud_xyz", &in_cloud_xyz);
 	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
     registerStream("out_min_pt", &out_min_pt);
     registerStream("out_max_pt", &out_max_pt);
+	registerStream("in_clouds_xyz", &in_clouds_xyz);
+	registerStream("in_clouds_xyzrgb", &in_clouds_xyzrgb);
+	registerStream("out_min_pts", &out_min_pts);
+	registerStream("out_max_pts", &out_max_pts);
+	registerStream("in_soa_xyzsift", &in_soa_xyzsift);
 	// Register handlers
-	h_find.setup(boost::bind(&FindBoundingBox::find, this));
+	h_find.setup(profiler.wrap("find", boost::bind(&FindBoundingBox::find, this)));
 	registerHandler("find", &h_find);
 	addDependency("find", &in_cloud_xyz);
-	h_find_xyzrgb.setup(boost::bind(&FindBoundingBox::find_xyzrgb, this));
+	h_find_xyzrgb.setup(profiler.wrap("find_xyzrgb", boost::bind(&FindBoundingBox::find_xyzrgb, this)));
 	registerHandler("find_xyzrgb", &h_find_xyzrgb);
 	addDependency("find_xyzrgb", &in_cloud_xyzrgb);
+	h_find_clouds_xyz.setup(profiler.wrap("find_clouds_xyz", boost::bind(&FindBoundingBox::find_clouds_xyz, this)));
+	registerHandler("find_clouds_xyz", &h_find_clouds_xyz);
+	addDependency("find_clouds_xyz", &in_clouds_xyz);
+	h_find_clouds_xyzrgb.setup(profiler.wrap("find_clouds_xyzrgb", boost::bind(&FindBoundingBox::find_clouds_xyzrgb, this)));
+	registerHandler("find_clouds_xyzrgb", &h_find_clouds_xyzrgb);
+	addDependency("find_clouds_xyzrgb", &in_clouds_xyzrgb);
+	h_find_soa_xyzsift.setup(profiler.wrap("find_soa_xyzsift", boost::bind(&FindBoundingBox::find_soa_xyzsift, this)));
+	registerHandler("find_soa_xyzsift", &h_find_soa_xyzsift);
+	addDependency("find_soa_xyzsift", &in_soa_xyzsift);
 
 }
 
 bool FindBoundingBox::onInit() {
+	profiler.setEnabled(profile, profile_period);
 
 	return true;
 }
 
 bool FindBoundingBox::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -57,43 +82,92 @@ bool FindBoundingBox::onStart() {
 
 void FindBoundingBox::find() {
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
-
-    pcl::PointXYZ minPt, maxPt;
-    pcl::getMinMax3D(*cloud, minPt, maxPt);
-    LOG(LTRACE) << "Max x: " << maxPt.x << "\n";
-    LOG(LTRACE) << "Max y: " << maxPt.y << "\n";
-    LOG(LTRACE) << "Max z: " << maxPt.z << "\n";
-    LOG(LTRACE) << "Min x: " << minPt.x << "\n";
-    LOG(LTRACE) << "Min y: " << minPt.y << "\n";
-    LOG(LTRACE) << "Min z: " << minPt.z << "\n";
-
-    out_min_pt.write(minPt);
-    out_max_pt.write(maxPt);
+    Types::CloudStatistics::Result stats;
+    Types::CloudStatistics::compute(*cloud, stats);
+    publish(stats);
 }
 
 void FindBoundingBox::find_xyzrgb() {
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
+    Types::CloudStatistics::Result stats;
+    Types::CloudStatistics::compute(*cloud, stats);
+    publish(stats);
+}
+
+void FindBoundingBox::find_soa_xyzsift() {
+    Types::SoACloud<PointXYZSIFT>::Ptr cloud = in_soa_xyzsift.read();
+    Types::CloudStatistics::Result stats;
+    Types::CloudStatistics::compute(*cloud, stats);
+    publish(stats);
+}
 
-    pcl::PointXYZRGB minPt_rgb, maxPt_rgb;
+void FindBoundingBox::publish(const Types::CloudStatistics::Result & stats) {
     pcl::PointXYZ minPt, maxPt;
-    pcl::getMinMax3D(*cloud, minPt_rgb, maxPt_rgb);
+    if (stats.count > 0) {
+        minPt.x = stats.min[0];
+        minPt.y = stats.min[1];
+        minPt.z = stats.min[2];
+        maxPt.x = stats.max[0];
+        maxPt.y = stats.max[1];
+        maxPt.z = stats.max[2];
+    }
     LOG(LTRACE) << "Max x: " << maxPt.x << "\n";
     LOG(LTRACE) << "Max y: " << maxPt.y << "\n";
     LOG(LTRACE) << "Max z: " << maxPt.z << "\n";
     LOG(LTRACE) << "Min x: " << minPt.x << "\n";
     LOG(LTRACE) << "Min y: " << minPt.y << "\n";
     LOG(LTRACE) << "Min z: " << minPt.z << "\n";
-	minPt.x = minPt_rgb.x;
-	minPt.y = minPt_rgb.y;
-	minPt.z = minPt_rgb.z;
-	maxPt.x = maxPt_rgb.x;
-	maxPt.y = maxPt_rgb.y;
-	maxPt.z = maxPt_rgb.z;
+
     out_min_pt.write(minPt);
     out_max_pt.write(maxPt);
 }
 
+/// Bounds of clouds of a batch, zero for empty clouds.
+template <typename PointT>
+struct BatchBounds {
+	BatchBounds(const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds_, std::vector<pcl::PointXYZ> & mins_, std::vector<pcl::PointXYZ> & maxs_) :
+		clouds(clouds_), mins(mins_), maxs(maxs_) {
+	}
+
+	void operator()(int i, int) {
+		if (!clouds[i])
+			return;
+		Types::CloudStatistics::Result stats;
+		Types::CloudStatistics::compute(*clouds[i], stats, false, false);
+		if (stats.count == 0)
+			return;
+		mins[i].x = stats.min[0];
+		mins[i].y = stats.min[1];
+		mins[i].z = stats.min[2];
+		maxs[i].x = stats.max[0];
+		maxs[i].y = stats.max[1];
+		maxs[i].z = stats.max[2];
+	}
+
+	const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds;
+	std::vector<pcl::PointXYZ> & mins;
+	std::vector<pcl::PointXYZ> & maxs;
+};
+
+template <typename PointT>
+void FindBoundingBox::find_batch(const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds) {
+    std::vector<pcl::PointXYZ> minPts(clouds.size()), maxPts(clouds.size());
+    BatchBounds<PointT> bounds(clouds, minPts, maxPts);
+    Types::CloudBatch::forEach(clouds.size(), bounds);
+    LOG(LTRACE) << "Bounds of " << clouds.size() << " clouds";
+    profiler.points(Types::CloudBatch::points<PointT>(clouds), 2 * clouds.size());
+
+    out_min_pts.write(minPts);
+    out_max_pts.write(maxPts);
+}
 
+void FindBoundingBox::find_clouds_xyz() {
+    find_batch<pcl::PointXYZ>(in_clouds_xyz.read());
+}
+
+void FindBoundingBox::find_clouds_xyzrgb() {
+    find_batch<pcl::PointXYZRGB>(in_clouds_xyzrgb.read());
+}
 
 } //: namespace FindBoundingBox
 } //: namespace Processors
@@ -13,10 +13,16 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <pcl/io/pcd_io.h>
 #include <pcl/point_types.h>
 #include <pcl/common/common.h>
 
+#include <Types/CloudStatistics.hpp>
+#include <Types/PointXYZSIFT.hpp>
+#include <Types/SoACloud.hpp>
+
 namespace Processors {
 namespace FindBoundingBox {
 
@@ -73,11 +79,21 @@ protected:
 	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr > in_cloud_xyzrgb;
     Base::DataStreamOut<pcl::PointXYZ> out_min_pt;
     Base::DataStreamOut<pcl::PointXYZ> out_max_pt;
+	Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > in_clouds_xyz;
+	Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > in_clouds_xyzrgb;
+	/// Bounds of clouds of in_clouds_*, in order of clouds.
+	Base::DataStreamOut<std::vector<pcl::PointXYZ> > out_min_pts;
+	Base::DataStreamOut<std::vector<pcl::PointXYZ> > out_max_pts;
+	/// XYZSIFT cloud split into coordinate arrays, bounded without reading descriptors.
+	Base::DataStreamIn<Types::SoACloud<PointXYZSIFT>::Ptr> in_soa_xyzsift;
 	// Output data streams
 
 	// Handlers
 	Base::EventHandler2 h_find;
 	Base::EventHandler2 h_find_xyzrgb;
+	Base::EventHandler2 h_find_clouds_xyz;
+	Base::EventHandler2 h_find_clouds_xyzrgb;
+	Base::EventHandler2 h_find_soa_xyzsift;
 
 	// Properties
 
@@ -85,6 +101,25 @@ protected:
 	// Handlers
 	void find();
 	void find_xyzrgb();
+	void find_clouds_xyz();
+	void find_clouds_xyzrgb();
+	void find_soa_xyzsift();
+
+	/// Finds bounds of all clouds of the vector (e.g. clusters) in parallel.
+	template <typename PointT>
+	void find_batch(const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds);
+
+	/// Writes bounds of the cloud.
+	void publish(const Types::CloudStatistics::Result & stats);
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
@@ -12,11 +12,22 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/KeyPointLifting.hpp"
+#include "Types/CaptureTime.hpp"
+
 namespace Processors {
 namespace KeyPointsConverter {
 
 KeyPointsConverter::KeyPointsConverter(const std::string & name) :
-		Base::Component(name)  {
+		Base::Component(name),
+		median_radius("median_radius", 0),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(median_radius);
+	registerProperty(profile);
+	registerProperty(profile_period);
 
 }
 
@@ -28,26 +39,28 @@ void KeyPointsConverter::prepareInterface() {
     registerStream("in_depth", &in_depth);
 	registerStream("in_keypoints", &in_keypoints);
     registerStream("in_camera_info", &in_camera_info);
-    registerStream("in_depth", &in_depth);
     registerStream("in_depth_xyz", &in_depth_xyz);
     registerStream("out_cloud_xyz", &out_cloud_xyz);
+    registerStream("out_keypoint_indices", &out_keypoint_indices);
     // Register handlers
-    registerHandler("process", boost::bind(&KeyPointsConverter::process, this));
+    registerHandler("process", profiler.wrap("process", boost::bind(&KeyPointsConverter::process, this)));
 	addDependency("process", &in_keypoints);
 	addDependency("process", &in_camera_info);
     addDependency("process", &in_depth);
 
-    registerHandler("process_depth_xyz", boost::bind(&KeyPointsConverter::process_depth_xyz, this));
+    registerHandler("process_depth_xyz", profiler.wrap("process_depth_xyz", boost::bind(&KeyPointsConverter::process_depth_xyz, this)));
     addDependency("process_depth_xyz", &in_keypoints);
     addDependency("process_depth_xyz", &in_depth_xyz);
 }
 
 bool KeyPointsConverter::onInit() {
+	profiler.setEnabled(profile, profile_period);
 
 	return true;
 }
 
 bool KeyPointsConverter::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -59,66 +72,43 @@ bool KeyPointsConverter::onStart() {
 	return true;
 }
 
+void KeyPointsConverter::publish(const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud, const pcl::IndicesPtr & indices, size_t keypoints,
+		uint64_t captured) {
+    CLOG(LDEBUG) << "Lifted " << cloud->size() << " of " << keypoints << " keypoints";
+    profiler.points(keypoints, cloud->size());
+    out_keypoint_indices.write(indices);
+    Types::CaptureTime::stamp(*cloud, captured);
+    out_cloud_xyz.write(cloud);
+}
+
 void KeyPointsConverter::process() {
     CLOG(LTRACE) << "KeyPointsConverter::process";
 
     cv::Mat depth = in_depth.read();
+    const uint64_t captured = Types::CaptureTime::now();
     Types::CameraInfo camera_info = in_camera_info.read();
     Types::KeyPoints keypoints = in_keypoints.read();
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>);
-
-    double fx_d = 0.001 / camera_info.fx();
-    double fy_d = 0.001 / camera_info.fy();
-    double cx_d = camera_info.cx();
-    double cy_d = camera_info.cy();
-
-    for(int i = 0; i < keypoints.keypoints.size(); ++i){
-        pcl::PointXYZ point;
-        int u = round(keypoints.keypoints[i].pt.x);
-        int v = round(keypoints.keypoints[i].pt.y);
-
-        float d = depth.at<float>(v, u);
-        if (d == 0) {
-            continue;
-        }
-
-        point.x = (u - cx_d) * d * fx_d;
-        point.y = (v - cy_d) * d * fy_d;
-        point.z = d * 0.001;
-
+    // Depth map in millimeters, rays rebuilt only when intrinsics or resolution change.
+    Types::DepthBackProjection::Intrinsics K(camera_info.fx(), camera_info.fy(), camera_info.cx(), camera_info.cy(), 0.001f);
+    ray_table.update(K, depth.cols, depth.rows);
 
-        cloud->push_back(point);
-    }
-
-    out_cloud_xyz.write(cloud);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = Types::CloudPool<pcl::PointXYZ>::acquire(keypoints.keypoints.size());
+    pcl::IndicesPtr indices(new std::vector<int>);
+    Types::KeyPointLifting::liftDepth(depth, ray_table, keypoints.keypoints, median_radius, *cloud, *indices);
+    publish(cloud, indices, keypoints.keypoints.size(), captured);
 }
 
 void KeyPointsConverter::process_depth_xyz() {
     CLOG(LTRACE) << "KeyPointsConverter::process_depth_xyz";
     cv::Mat depth_xyz = in_depth_xyz.read();
+    const uint64_t captured = Types::CaptureTime::now();
     Types::KeyPoints keypoints = in_keypoints.read();
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>());
-    const double max_z = 1.0e4;
-
-    for(int i=0; i < keypoints.keypoints.size(); ++i){
-
-        pcl::PointXYZ point;
-        int u = round(keypoints.keypoints[i].pt.x);
-        int v = round(keypoints.keypoints[i].pt.y);
-
-        cv::Vec3f p = depth_xyz.at<cv::Vec3f>(v, u);
-        if(fabs(p[2] - max_z) < FLT_EPSILON || fabs(p[2]) > max_z) continue;
-
-        point.x = p[0];
-        point.y = p[1];
-        point.z = p[2];
-
-        cloud->push_back(point);
-    }
-
-    out_cloud_xyz.write(cloud);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = Types::CloudPool<pcl::PointXYZ>::acquire(keypoints.keypoints.size());
+    pcl::IndicesPtr indices(new std::vector<int>);
+    Types::KeyPointLifting::liftXYZ(depth_xyz, keypoints.keypoints, median_radius, *cloud, *indices);
+    publish(cloud, indices, keypoints.keypoints.size(), captured);
 }
 
 
@@ -13,6 +13,8 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <Types/CameraInfo.hpp>
 
 #include <Types/KeyPoints.hpp>
@@ -21,6 +23,9 @@
 
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
+#include <pcl/pcl_base.h>
+
+#include "Types/DepthBackProjection.hpp"
 
 namespace Processors {
 namespace KeyPointsConverter {
@@ -29,7 +34,8 @@ namespace KeyPointsConverter {
  * \class KeyPointsConverter
  * \brief KeyPointsConverter processor class.
  *
- * 
+ * Lifts keypoints to 3D points with the depth map (rays of the cached ray
+ * table of the camera, see Types::KeyPointLifting) or with the XYZ image.
  */
 class KeyPointsConverter: public Base::Component {
 public:
@@ -81,11 +87,32 @@ protected:
 
 	// Output data streams
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
-	
+
+	/// Index of the keypoint of every point of out_cloud_xyz, keypoints without depth have no point.
+	Base::DataStreamOut<pcl::IndicesPtr> out_keypoint_indices;
+
 	// Handlers
 	void process();
     void process_depth_xyz();
 
+	/// Writes cloud and keypoint indices, the cloud stamped with the time the images were read.
+	void publish(const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud, const pcl::IndicesPtr & indices, size_t keypoints, uint64_t captured);
+
+	/// Property: radius of the window of the median of depths around keypoints, 0 - depth of the keypoint pixel only.
+	Base::Property<int> median_radius;
+
+	/// Cached per-pixel rays of the depth camera.
+	Types::DepthBackProjection::RayTable ray_table;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace KeyPointsConverter
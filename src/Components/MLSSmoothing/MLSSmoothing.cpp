@@ -12,9 +12,11 @@
 
 #include <boost/bind.hpp>
 
-//#include <pcl/impl/point_types.hpp>
-#include <pcl/kdtree/kdtree_flann.h>
+#include "Types/CloudPool.hpp"
+#include "Types/ThreadPool.hpp"
+
 #include <pcl/surface/mls.h>
+#include <pcl/surface/mls_omp.h>
 
 
 namespace Processors {
@@ -25,11 +27,48 @@ MLSSmoothing::MLSSmoothing(const std::string & name) :
 		negative("negative", false),
 		StddevMulThresh("StddevMulThresh", 1.0),
 		MeanK("MeanK", 50),
-		pass_through("pass_through", false) {
+		pass_through("pass_through", false),
+		threads("threads", 0),
+		radius("radius", 0.03),
+		polynomial_order("polynomial_order", 2),
+		polynomial_fit("polynomial_fit", true),
+		normals("normals", false),
+		upsampling("upsampling", std::string("NONE")),
+		upsampling_radius("upsampling_radius", 0.01),
+		upsampling_step("upsampling_step", 0.005),
+		point_density("point_density", 10),
+		dilation_voxel_size("dilation_voxel_size", 0.005),
+		dilation_iterations("dilation_iterations", 1),
+		input_policy("input.policy", std::string("newest")),
+		input_queue("input.queue", 0),
+		input_deadline("input.deadline", 100),
+		input_xyzrgb(name + ".in_cloud_xyzrgb"),
+		input_xyz(name + ".in_cloud_xyz"),
+		input_indexed_xyzrgb(name + ".in_indexed_xyzrgb"),
+		input_indexed_xyz(name + ".in_indexed_xyz"),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
 	registerProperty(negative);
 	registerProperty(StddevMulThresh);
 	registerProperty(MeanK);
 	registerProperty(pass_through);
+	registerProperty(threads);
+	registerProperty(radius);
+	registerProperty(polynomial_order);
+	registerProperty(polynomial_fit);
+	registerProperty(normals);
+	registerProperty(upsampling);
+	registerProperty(upsampling_radius);
+	registerProperty(upsampling_step);
+	registerProperty(point_density);
+	registerProperty(dilation_voxel_size);
+	registerProperty(dilation_iterations);
+	registerProperty(input_policy);
+	registerProperty(input_queue);
+	registerProperty(input_deadline);
+	registerProperty(profile);
+	registerProperty(profile_period);
 }
 
 MLSSmoothing::~MLSSmoothing() {
@@ -41,26 +80,59 @@ void MLSSmoothing::prepareInterface() {
 	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
 	registerStream("in_cloud_xyz", &in_cloud_xyz);
 	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("in_indexed_xyzrgb", &in_indexed_xyzrgb);
+	registerStream("out_indexed_xyzrgb", &out_indexed_xyzrgb);
+	registerStream("in_indexed_xyz", &in_indexed_xyz);
+	registerStream("out_indexed_xyz", &out_indexed_xyz);
+	registerStream("out_cloud_xyzrgbnormals", &out_cloud_xyzrgbnormals);
+	registerStream("out_cloud_xyznormals", &out_cloud_xyznormals);
 
 	// Register handlers
-	registerHandler("filter_xyzrgb", boost::bind(&MLSSmoothing::filter_xyzrgb, this));
+	registerHandler("filter_xyzrgb", profiler.wrap("filter_xyzrgb", boost::bind(&MLSSmoothing::filter_xyzrgb, this)));
 	addDependency("filter_xyzrgb", &in_cloud_xyzrgb);
 	
-	registerHandler("filter_xyz", boost::bind(&MLSSmoothing::filter_xyz, this));
+	registerHandler("filter_xyz", profiler.wrap("filter_xyz", boost::bind(&MLSSmoothing::filter_xyz, this)));
 	addDependency("filter_xyz", &in_cloud_xyz);
 
+	registerHandler("filter_indexed_xyzrgb", profiler.wrap("filter_indexed_xyzrgb", boost::bind(&MLSSmoothing::filter_indexed_xyzrgb, this)));
+	addDependency("filter_indexed_xyzrgb", &in_indexed_xyzrgb);
+
+	registerHandler("filter_indexed_xyz", profiler.wrap("filter_indexed_xyz", boost::bind(&MLSSmoothing::filter_indexed_xyz, this)));
+	addDependency("filter_indexed_xyz", &in_indexed_xyz);
+
 }
 
 bool MLSSmoothing::onInit() {
+	profiler.setEnabled(profile, profile_period);
+
+	if (!input_xyzrgb.configure(input_policy, input_queue, input_deadline))
+		CLOG(LWARNING) << "Unknown input policy " << input_policy << ", using newest";
+	input_xyz.configure(input_policy, input_queue, input_deadline);
+	input_indexed_xyzrgb.configure(input_policy, input_queue, input_deadline);
+	input_indexed_xyz.configure(input_policy, input_queue, input_deadline);
+	input_xyzrgb.setReporting(profile, profile_period);
+	input_xyz.setReporting(profile, profile_period);
+	input_indexed_xyzrgb.setReporting(profile, profile_period);
+	input_indexed_xyz.setReporting(profile, profile_period);
 
 	return true;
 }
 
 bool MLSSmoothing::onFinish() {
+	profiler.report();
+	input_xyzrgb.report();
+	input_xyz.report();
+	input_indexed_xyzrgb.report();
+	input_indexed_xyz.report();
 	return true;
 }
 
 bool MLSSmoothing::onStop() {
+	// Frames of a bounded queue are not processed after the task starts over.
+	input_xyzrgb.clear();
+	input_xyz.clear();
+	input_indexed_xyzrgb.clear();
+	input_indexed_xyz.clear();
 	return true;
 }
 
@@ -68,59 +140,106 @@ bool MLSSmoothing::onStart() {
 	return true;
 }
 
+template <typename PointInT, typename PointOutT>
+typename pcl::PointCloud<PointOutT>::Ptr MLSSmoothing::smooth(const Types::IndexedCloud<PointInT> & input) {
+	typedef pcl::MovingLeastSquares<PointInT, PointOutT> MLS;
+
+	// Points are processed by a team of OpenMP threads, as big as the shared pool by default
+	pcl::MovingLeastSquaresOMP<PointInT, PointOutT> mls(threads > 0 ? threads : Types::ThreadPool::instance().threads());
+
+	// Normals are computed only when output point type can hold them
+	mls.setComputeNormals (normals);
+
+	// Set parameters, search index is shared with other consumers of the cloud
+	mls.setInputCloud (input.cloud());
+	mls.setSearchMethod (input.search());
+	mls.setSearchRadius (radius);
+	mls.setPolynomialFit (polynomial_fit);
+	mls.setPolynomialOrder (polynomial_order);
+
+	std::string method = upsampling;
+	if (method == "SAMPLE_LOCAL_PLANE") {
+		mls.setUpsamplingMethod (MLS::SAMPLE_LOCAL_PLANE);
+		mls.setUpsamplingRadius (upsampling_radius);
+		mls.setUpsamplingStepSize (upsampling_step);
+	} else if (method == "RANDOM_UNIFORM_DENSITY") {
+		mls.setUpsamplingMethod (MLS::RANDOM_UNIFORM_DENSITY);
+		mls.setPointDensity (point_density);
+	} else if (method == "VOXEL_GRID_DILATION") {
+		mls.setUpsamplingMethod (MLS::VOXEL_GRID_DILATION);
+		mls.setDilationVoxelSize (dilation_voxel_size);
+		mls.setDilationIterations (dilation_iterations);
+	} else {
+		if (method != "NONE")
+			CLOG(LWARNING) << "Unknown upsampling method " << method << ", using NONE";
+		mls.setUpsamplingMethod (MLS::NONE);
+	}
+
+	// Reconstruct directly into the output cloud
+	typename pcl::PointCloud<PointOutT>::Ptr output = Types::CloudPool<PointOutT>::acquire(input.size());
+	mls.process (*output);
+	return output;
+}
+
+template <typename PointT, typename PointNormalT>
+void MLSSmoothing::process(const typename Types::IndexedCloud<PointT>::Ptr & input,
+		Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> * out_cloud,
+		Base::DataStreamOut<typename Types::IndexedCloud<PointT>::Ptr> & out_indexed,
+		Base::DataStreamOut<typename pcl::PointCloud<PointNormalT>::Ptr> & out_normals) {
+	if (pass_through) {
+		out_indexed.write(input);
+		return;
+	}
+
+	if (normals) {
+		out_normals.write(smooth<PointT, PointNormalT>(*input));
+		return;
+	}
+
+	typename pcl::PointCloud<PointT>::Ptr output = smooth<PointT, PointT>(*input);
+	if (out_cloud)
+		out_cloud->write(output);
+	out_indexed.write(Types::IndexedCloud<PointT>::create(output));
+}
+
 void MLSSmoothing::filter_xyzrgb() {
 	CLOG(LTRACE) << "MLSSmoothing::filter_xyzrgb";
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
-
-	if (!pass_through) {
-		// Create a KD-Tree
-		pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZRGB>);
-
-		// Output has the PointNormal type in order to store the normals calculated by MLS
-		pcl::PointCloud<pcl::PointXYZRGBNormal> mls_points;
-
-		// Init object (second point type is for the normals, even if unused)
-		pcl::MovingLeastSquares<pcl::PointXYZRGB, pcl::PointXYZRGBNormal> mls;
-
-		mls.setComputeNormals (true);
-
-		// Set parameters
-		mls.setInputCloud (cloud);
-		mls.setPolynomialFit (true);
-		mls.setSearchMethod (tree);
-		mls.setSearchRadius (0.03);
-
-		// Reconstruct
-		mls.process (mls_points);
-
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr output (new pcl::PointCloud<pcl::PointXYZRGB>);
-		output->resize(mls_points.size());
-		for (size_t i = 0; i < mls_points.size(); i++) {
-			//mls_points[i].x;
-			(*output)[i].x = mls_points[i].x;
-			(*output)[i].y = mls_points[i].y;
-			(*output)[i].z = mls_points[i].z;
-			(*output)[i].r = mls_points[i].r;
-			(*output)[i].g = mls_points[i].g;
-			(*output)[i].b = mls_points[i].b;
-		}//: for
-		//copyPointCloud(*mls_points, *output);
-		out_cloud_xyzrgb.write(output);
-	} else {
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
+	if (!input_xyzrgb.read(in_cloud_xyzrgb, cloud))
+		return;
+
+	if (pass_through)
 		out_cloud_xyzrgb.write(cloud);
-	}
+	process<pcl::PointXYZRGB, pcl::PointXYZRGBNormal>(Types::IndexedCloud<pcl::PointXYZRGB>::create(cloud),
+			&out_cloud_xyzrgb, out_indexed_xyzrgb, out_cloud_xyzrgbnormals);
 }
 
 void MLSSmoothing::filter_xyz() {
 	CLOG(LTRACE) << "MLSSmoothing::filter_xyz";
-/*	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
-	pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor;
-	sor.setInputCloud (cloud);
-	sor.setMeanK (MeanK);
-	sor.setStddevMulThresh (StddevMulThresh);
-	sor.setNegative (negative);
-	sor.filter (*cloud);
-	out_cloud_xyz.write(cloud);*/
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+	if (!input_xyz.read(in_cloud_xyz, cloud))
+		return;
+
+	if (pass_through)
+		out_cloud_xyz.write(cloud);
+	process<pcl::PointXYZ, pcl::PointNormal>(Types::IndexedCloud<pcl::PointXYZ>::create(cloud),
+			&out_cloud_xyz, out_indexed_xyz, out_cloud_xyznormals);
+}
+
+void MLSSmoothing::filter_indexed_xyzrgb() {
+	CLOG(LTRACE) << "MLSSmoothing::filter_indexed_xyzrgb";
+	Types::IndexedCloud<pcl::PointXYZRGB>::Ptr input;
+	if (!input_indexed_xyzrgb.read(in_indexed_xyzrgb, input))
+		return;
+	process<pcl::PointXYZRGB, pcl::PointXYZRGBNormal>(input, NULL, out_indexed_xyzrgb, out_cloud_xyzrgbnormals);
+}
+
+void MLSSmoothing::filter_indexed_xyz() {
+	CLOG(LTRACE) << "MLSSmoothing::filter_indexed_xyz";
+	Types::IndexedCloud<pcl::PointXYZ>::Ptr input;
+	if (!input_indexed_xyz.read(in_indexed_xyz, input))
+		return;
+	process<pcl::PointXYZ, pcl::PointNormal>(input, NULL, out_indexed_xyz, out_cloud_xyznormals);
 }
 
 
@@ -13,9 +13,14 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+#include "Types/InputPolicy.hpp"
+
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
 
+#include "Types/IndexedCloud.hpp"
+
 namespace Processors {
 namespace MLSSmoothing {
 
@@ -23,7 +28,9 @@ namespace MLSSmoothing {
  * \class MLSSmoothing
  * \brief MLSSmoothing processor class.
  *
- * MLSSmoothing processor.
+ * MLSSmoothing processor. Smoothing is slow, so inputs are read through
+ * Types::InputPolicy - frames waiting while it falls behind can be dropped
+ * (input.policy newest by default, deadline or queue bounded by input.queue).
  */
 class MLSSmoothing: public Base::Component {
 public:
@@ -69,21 +76,84 @@ protected:
 
 	// Input data streams
 
-	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
-	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_cloud_xyz;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Queue> in_cloud_xyzrgb;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_cloud_xyz;
+	Base::DataStreamIn<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Queue> in_indexed_xyzrgb;
+	Base::DataStreamIn<Types::IndexedCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_indexed_xyz;
 
 	// Output data streams
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr> out_indexed_xyzrgb;
+	Base::DataStreamOut<Types::IndexedCloud<pcl::PointXYZ>::Ptr> out_indexed_xyz;
+
+	/// Smoothed clouds with normals, published instead of the above when normals are on.
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr> out_cloud_xyzrgbnormals;
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointNormal>::Ptr> out_cloud_xyznormals;
 
 	Base::Property<bool> negative;
 	Base::Property<float> StddevMulThresh;
 	Base::Property<float> MeanK;
 	Base::Property<bool> pass_through;
+
+	/// Number of threads, 0 - size of the shared pool (DCL_THREADS).
+	Base::Property<int> threads;
+
+	Base::Property<float> radius;
+	Base::Property<int> polynomial_order;
+	Base::Property<bool> polynomial_fit;
+
+	/// Compute normals and publish clouds with normals.
+	Base::Property<bool> normals;
+
+	/// NONE, SAMPLE_LOCAL_PLANE, RANDOM_UNIFORM_DENSITY or VOXEL_GRID_DILATION.
+	Base::Property<std::string> upsampling;
+	Base::Property<float> upsampling_radius;
+	Base::Property<float> upsampling_step;
+	Base::Property<int> point_density;
+	Base::Property<float> dilation_voxel_size;
+	Base::Property<int> dilation_iterations;
 	
 	// Handlers
 	void filter_xyz();
 	void filter_xyzrgb();
+	void filter_indexed_xyz();
+	void filter_indexed_xyzrgb();
+
+	/// Smooths the cloud, using its search index.
+	template <typename PointInT, typename PointOutT>
+	typename pcl::PointCloud<PointOutT>::Ptr smooth(const Types::IndexedCloud<PointInT> & input);
+
+	/// Smooths and publishes the cloud, keeps the indexed input if filter is off.
+	template <typename PointT, typename PointNormalT>
+	void process(const typename Types::IndexedCloud<PointT>::Ptr & input,
+			Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> * out_cloud,
+			Base::DataStreamOut<typename Types::IndexedCloud<PointT>::Ptr> & out_indexed,
+			Base::DataStreamOut<typename pcl::PointCloud<PointNormalT>::Ptr> & out_normals);
+
+	/// Property: frames taken from inputs - newest (the latest waiting frame), queue or deadline.
+	Base::Property<std::string> input_policy;
+
+	/// Property: frames waiting in a queue, older ones are dropped, 0 - unbounded.
+	Base::Property<int> input_queue;
+
+	/// Property: age since capture (ms) of frames dropped with the deadline policy.
+	Base::Property<float> input_deadline;
+
+	// Policies of inputs.
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> input_xyzrgb;
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZ>::Ptr> input_xyz;
+	Types::InputPolicy<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr> input_indexed_xyzrgb;
+	Types::InputPolicy<Types::IndexedCloud<pcl::PointXYZ>::Ptr> input_indexed_xyz;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
@@ -24,7 +24,14 @@ MultiXYZCloudsViewer::MultiXYZCloudsViewer(const std::string & name) :
 		title("title", std::string("Multi-XYZ-Clouds Viewer")),
 		count("count", 1),
 		clouds_colours("clouds_colours", cv::Mat(cv::Mat::zeros(1, 3, CV_8UC1))),
-		prop_coordinate_system("coordinate_system", true)
+		prop_coordinate_system("coordinate_system", true),
+		prop_lod("lod.enabled", false),
+		prop_lod_budget("lod.budget", 1000000),
+		prop_lod_pixels("lod.pixels", 2.0),
+		prop_render_thread("render.thread", true),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name)
 
 {
   LOG(LTRACE) << "MultiXYZCloudsViewer::constructor";
@@ -32,6 +39,12 @@ MultiXYZCloudsViewer::MultiXYZCloudsViewer(const std::string & name) :
   registerProperty(count);
   registerProperty(clouds_colours);
   registerProperty(prop_coordinate_system);
+  registerProperty(prop_lod);
+  registerProperty(prop_lod_budget);
+  registerProperty(prop_lod_pixels);
+  registerProperty(prop_render_thread);
+  registerProperty(profile);
+  registerProperty(profile_period);
 
   // Set white as default.
   ((cv::Mat)clouds_colours).at<float>(0,0) = 255;
@@ -68,10 +81,13 @@ void MultiXYZCloudsViewer::prepareInterface() {
 		// Register i-th stream.
 		registerStream(std::string("in_cloud_xyz") + id,
 				(Base::DataStreamInterface*) (in_clouds[i]));
+		// Mailbox passing i-th cloud to the renderer.
+		mail_clouds.push_back(boost::shared_ptr<Types::LatestValue<pcl::PointCloud<pcl::PointXYZ>::Ptr> >(
+				new Types::LatestValue<pcl::PointCloud<pcl::PointXYZ>::Ptr>));
 
 		// Create new handler for i-th cloud.
 		hand = new Base::EventHandler2;
-		hand->setup(boost::bind(&MultiXYZCloudsViewer::on_cloud_xyzN, this, i));
+		hand->setup(profiler.wrap(std::string("on_cloud_xyz") + id, boost::bind(&MultiXYZCloudsViewer::on_cloud_xyzN, this, i)));
 		handlers.push_back(hand);
 		registerHandler(std::string("on_cloud_xyz") + id, hand);
 		// Add dependency for i-th stream.
@@ -84,13 +100,29 @@ void MultiXYZCloudsViewer::prepareInterface() {
 
 
 	// Register spin handler.
-	h_on_spin.setup(boost::bind(&MultiXYZCloudsViewer::on_spin, this));
+	h_on_spin.setup(profiler.wrap("on_spin", boost::bind(&MultiXYZCloudsViewer::on_spin, this)));
 	registerHandler("on_spin", &h_on_spin);
 	addDependency("on_spin", NULL);
 }
 
 bool MultiXYZCloudsViewer::onInit() {
+	profiler.setEnabled(profile, profile_period);
 	LOG(LTRACE) << "MultiXYZCloudsViewer::onInit";
+	viewer = NULL;
+	lods.resize(count);
+	lod_levels.assign(count, -1);
+
+	// VTK window must be used only by the thread that created it.
+	if (prop_render_thread)
+		render_thread.start(boost::bind(&MultiXYZCloudsViewer::createViewer, this), boost::bind(&MultiXYZCloudsViewer::render, this),
+				boost::bind(&MultiXYZCloudsViewer::destroyViewer, this));
+	else
+		createViewer();
+
+	return true;
+}
+
+void MultiXYZCloudsViewer::createViewer() {
 	// Create visualizer.
 	viewer = new pcl::visualization::PCLVisualizer (title);
 	// Add visible coortinate system.
@@ -116,12 +148,23 @@ bool MultiXYZCloudsViewer::onInit() {
 	}
 
 	viewer->initCameraParameters ();
+}
 
-	return true;
+void MultiXYZCloudsViewer::destroyViewer() {
+	if (!viewer)
+		return;
+	viewer->close();
+	delete viewer;
+	viewer = NULL;
 }
 
 bool MultiXYZCloudsViewer::onFinish() {
+	profiler.report();
 	LOG(LTRACE) << "MultiXYZCloudsViewer::onFinish";
+	if (prop_render_thread)
+		render_thread.stop();
+	else
+		destroyViewer();
 	return true;
 }
 
@@ -137,8 +180,29 @@ bool MultiXYZCloudsViewer::onStart() {
 
 void MultiXYZCloudsViewer::on_cloud_xyzN(int n) {
 	LOG(LTRACE) << "MultiXYZCloudsViewer::on_cloud_xyz"<<n;
-	// Read input cloud from n-th dataport.
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_clouds[n]->read();
+	// Read input cloud from n-th dataport and pass it to the renderer.
+	mail_clouds[n]->write(in_clouds[n]->read());
+	if (!prop_render_thread)
+		displayCloud(n);
+}
+
+void MultiXYZCloudsViewer::displayCloud(int n) {
+	if (!mail_clouds[n]->fresh())
+		return;
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = mail_clouds[n]->take();
+
+	// Hierarchy is built once per cloud, level is chosen on every spin.
+	if (prop_lod) {
+		lods[n].build(cloud);
+		lod_levels[n] = -1;
+		refreshLOD(n);
+		return;
+	}
+
+	showCloud(n, cloud);
+}
+
+void MultiXYZCloudsViewer::showCloud(int n, const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloud) {
 	char id = '0' + n;
 
 	//cout << ((cv::Mat)clouds_colours).at<float>(n, 0) << " " << ((cv::Mat)clouds_colours).at<float>(n, 1) << " " <<  ((cv::Mat)clouds_colours).at<float>(n, 2) <<endl;
@@ -151,7 +215,38 @@ void MultiXYZCloudsViewer::on_cloud_xyzN(int n) {
 	viewer->updatePointCloud<pcl::PointXYZ> (cloud, single_color, std::string("in_cloud_xyz") + id);
 }
 
+void MultiXYZCloudsViewer::refreshLOD(int n) {
+	if (!lods[n].source())
+		return;
+	std::vector<pcl::visualization::Camera> cameras;
+	viewer->getCameras(cameras);
+	if (cameras.empty())
+		return;
+
+	// Budget is split between clouds.
+	const size_t budget = std::max(1, (int) prop_lod_budget) / std::max(1, (int) count);
+	const int level = lods[n].select(cameras[0], Eigen::Matrix4f::Identity(), budget, prop_lod_pixels);
+	if (level == lod_levels[n])
+		return;
+	lod_levels[n] = level;
+	LOG(LTRACE) << "MultiXYZCloudsViewer::refreshLOD cloud " << n << " level " << level << " points " << lods[n].count(level);
+	showCloud(n, lods[n].cloud(level));
+}
+
 void MultiXYZCloudsViewer::on_spin() {
+	// Rendering thread spins by itself.
+	if (!prop_render_thread)
+		render();
+}
+
+void MultiXYZCloudsViewer::render() {
+	if (!viewer)
+		return;
+	for (int i = 0; i < mail_clouds.size(); ++i)
+		displayCloud(i);
+	if (prop_lod)
+		for (int i = 0; i < lods.size(); ++i)
+			refreshLOD(i);
 	viewer->spinOnce (100);
 }
 
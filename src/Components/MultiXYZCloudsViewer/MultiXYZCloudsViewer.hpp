@@ -12,9 +12,14 @@
 #include "DataStream.hpp"
 #include "Property.hpp"
 #include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
 #include <pcl/visualization/pcl_visualizer.h>
 
 #include <Types/MatrixTranslator.hpp>
+#include <Types/CloudLOD.hpp>
+#include <Types/LatestValue.hpp>
+#include <Types/RenderThread.hpp>
 
 namespace Processors {
 namespace MultiXYZCloudsViewer {
@@ -80,6 +85,21 @@ protected:
 	void on_cloud_xyzN(int n);
 	void on_spin();
 
+	/// Displays n-th cloud taken from its mailbox, if there is a new one.
+	void displayCloud(int n);
+
+	/// Rendering step - displays new clouds and spins the viewer.
+	void render();
+
+	void createViewer();
+	void destroyViewer();
+
+	/// Displays n-th cloud in its colour.
+	void showCloud(int n, const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloud);
+
+	/// Displays level of detail of n-th cloud that suits the current camera.
+	void refreshLOD(int n);
+
 	/// Point cloud viewer.
 	pcl::visualization::PCLVisualizer * viewer;
 
@@ -94,6 +114,37 @@ protected:
 	
 	Base::Property<bool> prop_coordinate_system;
 
+	/// Property: display levels of detail of clouds instead of full clouds.
+	Base::Property<bool> prop_lod;
+
+	/// Property: maximal number of displayed points of all clouds in level of detail mode.
+	Base::Property<int> prop_lod_budget;
+
+	/// Property: minimal size of displayed octree cell, in pixels.
+	Base::Property<float> prop_lod_pixels;
+
+	/// Property: render on a dedicated thread instead of in the handlers (the viewer is created by that thread).
+	Base::Property<bool> prop_render_thread;
+
+	/// Mailboxes passing clouds of input streams to the rendering thread.
+	std::vector<boost::shared_ptr<Types::LatestValue<pcl::PointCloud<pcl::PointXYZ>::Ptr> > > mail_clouds;
+
+	/// Thread rendering the viewer.
+	Types::RenderThread render_thread;
+
+	/// Levels of detail of clouds and levels currently displayed.
+	std::vector<Types::CloudLOD<pcl::PointXYZ> > lods;
+	std::vector<int> lod_levels;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace MultiXYZCloudsViewer
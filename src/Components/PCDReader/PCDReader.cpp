@@ -12,6 +12,11 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/MappedPCD.hpp"
+#include "Types/QuantizedSIFT.hpp"
+#include "Types/CaptureTime.hpp"
+
 
 namespace Processors {
 namespace PCDReader {
@@ -22,7 +27,11 @@ PCDReader::PCDReader(const std::string & name) :
 	read_on_init("read_on_init", true),
 	prop_return_xyz("cloud.xyz", false),
 	prop_return_xyzrgb("cloud.xyzrgb", false),
-	prop_return_xyzsift("cloud.xyzsift", false)
+	prop_return_xyzsift("cloud.xyzsift", false),
+	prop_return_xyzsift8("cloud.xyzsift8", false),
+	profile("profile", false),
+	profile_period("profile.period", 100),
+	profiler(name)
 
 {
 	// Register property.
@@ -30,7 +39,10 @@ PCDReader::PCDReader(const std::string & name) :
 	registerProperty(prop_return_xyz);
 	registerProperty(prop_return_xyzrgb);
 	registerProperty(prop_return_xyzsift);
+	registerProperty(prop_return_xyzsift8);
 	registerProperty(read_on_init);
+	registerProperty(profile);
+	registerProperty(profile_period);
 
 	CLOG(LTRACE) << "Hi PCDReader\n";
 
@@ -46,15 +58,17 @@ void PCDReader::prepareInterface() {
 	registerStream("out_cloud_xyz", &out_cloud_xyz);
 	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
 	registerStream("out_cloud_xyzsift", &out_cloud_xyzsift);
+	registerStream("out_cloud_xyzsift8", &out_cloud_xyzsift8);
 
 	// Register handlers
-	registerHandler("Read", boost::bind(&PCDReader::Read, this));
+	registerHandler("Read", profiler.wrap("Read", boost::bind(&PCDReader::Read, this)));
 
-	registerHandler("onTriggeredLoadNextCloud", boost::bind(&PCDReader::onTriggeredLoadNextCloud, this));
+	registerHandler("onTriggeredLoadNextCloud", profiler.wrap("onTriggeredLoadNextCloud", boost::bind(&PCDReader::onTriggeredLoadNextCloud, this)));
 	addDependency("onTriggeredLoadNextCloud", &in_trigger);
 }
 
 bool PCDReader::onInit() {
+	profiler.setEnabled(profile, profile_period);
 	// If propery set - read point cloud at start.
 	if (read_on_init)
 		Read();
@@ -62,6 +76,7 @@ bool PCDReader::onInit() {
 }
 
 bool PCDReader::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -81,13 +96,20 @@ void PCDReader::onTriggeredLoadNextCloud(){
 
 void PCDReader::Read() {
 	CLOG(LTRACE) << "PCDReader::Read";
-	  
+
+	const uint64_t captured = Types::CaptureTime::now();
+
+	// Binary file is mapped once and shared by all outputs.
+	Types::MappedPCD::Ptr mapped(new Types::MappedPCD);
+	mapped->open(filename);
+
 	if (prop_return_xyz){
 		// Try to read the cloud of XYZ points.
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz (new pcl::PointCloud<pcl::PointXYZ>);
-		if (pcl::io::loadPCDFile<pcl::PointXYZ> (filename, *cloud_xyz) == -1){
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz = Types::CloudPool<pcl::PointXYZ>::acquire();
+		if (!Types::MappedPCD::load(mapped, filename, *cloud_xyz)){
 			CLOG(LWARNING) <<"Cannot read PointXYZ cloud from "<<filename;
 		}else{
+			Types::CaptureTime::stamp(*cloud_xyz, captured);
 			out_cloud_xyz.write(cloud_xyz);
 			CLOG(LINFO) <<"PointXYZ cloud of size "<< cloud_xyz->size() << " loaded properly from "<<filename;
 		}//: else
@@ -95,10 +117,11 @@ void PCDReader::Read() {
 
 	if (prop_return_xyzrgb){
 		// Try to read the cloud of XYZRGB points.
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_xyzrgb (new pcl::PointCloud<pcl::PointXYZRGB>);
-		if (pcl::io::loadPCDFile<pcl::PointXYZRGB> (filename, *cloud_xyzrgb) == -1){
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_xyzrgb = Types::CloudPool<pcl::PointXYZRGB>::acquire();
+		if (!Types::MappedPCD::load(mapped, filename, *cloud_xyzrgb)){
 			CLOG(LWARNING) <<"Cannot read PointXYZRGB cloud from "<<filename;
 		}else{
+			Types::CaptureTime::stamp(*cloud_xyzrgb, captured);
 			out_cloud_xyzrgb.write(cloud_xyzrgb);
 			CLOG(LINFO) <<"PointXYZRGB cloud of size "<< cloud_xyzrgb->size() << " loaded properly from "<<filename;
 		}//: else
@@ -106,15 +129,50 @@ void PCDReader::Read() {
 
 	if (prop_return_xyzsift){
 		// Try to read the cloud of XYZSIFT points.
-		pcl::PointCloud<PointXYZSIFT>::Ptr cloud_xyzsift (new pcl::PointCloud<PointXYZSIFT>);
-		if (pcl::io::loadPCDFile<PointXYZSIFT> (filename, *cloud_xyzsift) == -1){
+		pcl::PointCloud<PointXYZSIFT>::Ptr cloud_xyzsift = Types::CloudPool<PointXYZSIFT>::acquire();
+		if (!loadSIFT<PointXYZSIFT, PointXYZSIFT8>(mapped, *cloud_xyzsift)){
 			CLOG(LWARNING) <<"Cannot read PointXYZSIFT cloud from "<<filename;
 		}else{
+			Types::CaptureTime::stamp(*cloud_xyzsift, captured);
 			out_cloud_xyzsift.write(cloud_xyzsift);
 			CLOG(LINFO) <<"PointXYZSIFT cloud of size "<< cloud_xyzsift->size() << " loaded properly from "<<filename;
 		}//: else
 	}//: else
 
+	if (prop_return_xyzsift8){
+		// Try to read the cloud of XYZSIFT points with quantized descriptors.
+		pcl::PointCloud<PointXYZSIFT8>::Ptr cloud_xyzsift8 = Types::CloudPool<PointXYZSIFT8>::acquire();
+		if (!loadSIFT<PointXYZSIFT8, PointXYZSIFT>(mapped, *cloud_xyzsift8)){
+			CLOG(LWARNING) <<"Cannot read PointXYZSIFT8 cloud from "<<filename;
+		}else{
+			Types::CaptureTime::stamp(*cloud_xyzsift8, captured);
+			out_cloud_xyzsift8.write(cloud_xyzsift8);
+			CLOG(LINFO) <<"PointXYZSIFT8 cloud of size "<< cloud_xyzsift8->size() << " loaded properly from "<<filename;
+		}//: else
+	}//: else
+
+}
+
+/// Conversion between SIFT clouds of both descriptor types.
+inline void convertSIFT(const pcl::PointCloud<PointXYZSIFT> & in, pcl::PointCloud<PointXYZSIFT8> & out) {
+	Types::QuantizedSIFT::quantize(in, out);
+}
+
+inline void convertSIFT(const pcl::PointCloud<PointXYZSIFT8> & in, pcl::PointCloud<PointXYZSIFT> & out) {
+	Types::QuantizedSIFT::dequantize(in, out);
+}
+
+template <typename PointT, typename OtherT>
+bool PCDReader::loadSIFT(const Types::MappedPCD::Ptr & mapped, pcl::PointCloud<PointT> & cloud) {
+	// Descriptors stored with the other type, read them as such and convert.
+	if (mapped->isOpen() && mapped->matchingFields<PointT>() < 0 && mapped->matchingFields<OtherT>() >= 0) {
+		pcl::PointCloud<OtherT> other;
+		if (!Types::MappedPCD::load(mapped, filename, other))
+			return false;
+		convertSIFT(other, cloud);
+		return true;
+	}
+	return Types::MappedPCD::load(mapped, filename, cloud);
 }
 
 
@@ -13,10 +13,14 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl/io/pcd_io.h>
 #include <Types/PointXYZSIFT.hpp>
+#include "Types/PointXYZSIFT8.hpp"
+#include "Types/MappedPCD.hpp"
 
 namespace Processors {
 namespace PCDReader {
@@ -81,6 +85,9 @@ protected:
 	/// Cloud containing points with Cartesian coordinates and SIFT descriptor (XYZ + 128).
 	Base::DataStreamOut<pcl::PointCloud<PointXYZSIFT>::Ptr > out_cloud_xyzsift;
 
+	/// Cloud containing points with Cartesian coordinates and SIFT descriptor quantized to 8 bits.
+	Base::DataStreamOut<pcl::PointCloud<PointXYZSIFT8>::Ptr > out_cloud_xyzsift8;
+
 	/// Cloud containing points with Cartesian coordinates with associated normals (XYZ + normal).
 	//Base::DataStreamIn< pcl::PointCloud<pcl::Normal>::Ptr > in_cloud_normals;
 
@@ -88,6 +95,13 @@ protected:
 	void onTriggeredLoadNextCloud();
 	void Read();
 
+	/*!
+	 * Reads SIFT cloud of either descriptor type, converting (quantizing or
+	 * restoring) descriptors of the other one stored in the file.
+	 */
+	template <typename PointT, typename OtherT>
+	bool loadSIFT(const Types::MappedPCD::Ptr & mapped, pcl::PointCloud<PointT> & cloud);
+
 	/// Property - filename (including directory).
 	Base::Property<std::string> filename;
 
@@ -100,9 +114,20 @@ protected:
 	/// Property - return xyzsift cloud.
 	Base::Property<bool> prop_return_xyzsift;
 
+	/// Property - return xyzsift cloud with quantized descriptors.
+	Base::Property<bool> prop_return_xyzsift8;
+
 	///  Propery - if set, reads point clouds at start.
 	Base::Property<bool> read_on_init;
 
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
@@ -11,6 +11,10 @@
 #include "Common/Logger.hpp"
 
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "Types/CloudPool.hpp"
+#include "Types/CaptureTime.hpp"
 
 namespace Processors {
 namespace PCDSequence {
@@ -19,6 +23,7 @@ PCDSequence::PCDSequence(const std::string & n) :
 	Base::Component(n),
 	prop_directory("sequence.directory", std::string(".")),
 	prop_pattern("sequence.pattern", std::string(".*\\.(pcd)")),
+	prop_container("sequence.container", std::string("")),
 	prop_sort("mode.sort", true),
 	prop_loop("mode.loop", false),
 	prop_auto_publish_cloud("mode.auto_publish_cloud", true),
@@ -26,11 +31,17 @@ PCDSequence::PCDSequence(const std::string & n) :
 	prop_auto_prev_cloud("mode.auto_prev_cloud", false),
 	prop_return_xyz("cloud.xyz", false),
 	prop_return_xyzrgb("cloud.xyzrgb", false),
-	prop_return_xyzsift("cloud.xyzsift", false)
+	prop_return_xyzsift("cloud.xyzsift", false),
+	prop_prefetch_depth("prefetch.depth", 2),
+	prop_prefetch_threads("prefetch.threads", 1),
+	profile("profile", false),
+	profile_period("profile.period", 100),
+	profiler(n)
 //	prop_read_on_init("read_on_init", true) 
 {
 	registerProperty(prop_directory);
 	registerProperty(prop_pattern);
+	registerProperty(prop_container);
 	registerProperty(prop_sort);
 	registerProperty(prop_loop);
 	registerProperty(prop_auto_publish_cloud);
@@ -39,6 +50,10 @@ PCDSequence::PCDSequence(const std::string & n) :
 	registerProperty(prop_return_xyz);
 	registerProperty(prop_return_xyzrgb);
 	registerProperty(prop_return_xyzsift);
+	registerProperty(prop_prefetch_depth);
+	registerProperty(prop_prefetch_threads);
+	registerProperty(profile);
+	registerProperty(profile_period);
 //	registerProperty(prop_read_on_init);
 
 	CLOG(LTRACE) << "Constructed";
@@ -61,41 +76,43 @@ void PCDSequence::prepareInterface() {
 	registerStream("in_next_cloud_trigger", &in_next_cloud_trigger);
 
 	// Register handlers - loads cloud, NULL dependency.
-	registerHandler("onLoadCloud", boost::bind(&PCDSequence::onLoadCloud, this));
+	registerHandler("onLoadCloud", profiler.wrap("onLoadCloud", boost::bind(&PCDSequence::onLoadCloud, this)));
 	addDependency("onLoadCloud", NULL);
 
 	// Register handlers - next cloud, can be triggered manually (from GUI) or by new data present in_load_next_cloud_trigger dataport.
 	// 1st version - manually.
-	registerHandler("Next cloud", boost::bind(&PCDSequence::onLoadNextCloud, this));
+	registerHandler("Next cloud", profiler.wrap("Next cloud", boost::bind(&PCDSequence::onLoadNextCloud, this)));
 
 	// 2nd version - external trigger.
-	registerHandler("onTriggeredLoadNextCloud", boost::bind(&PCDSequence::onTriggeredLoadNextCloud, this));
+	registerHandler("onTriggeredLoadNextCloud", profiler.wrap("onTriggeredLoadNextCloud", boost::bind(&PCDSequence::onTriggeredLoadNextCloud, this)));
 	addDependency("onTriggeredLoadNextCloud", &in_next_cloud_trigger);
 
 	// Register handlers - prev cloud, can be triggered manually (from GUI) or by new data present in_load_next_cloud_trigger dataport.
 	// 1st version - manually.
-	registerHandler("Previous cloud", boost::bind(&PCDSequence::onLoadPrevCloud, this));
+	registerHandler("Previous cloud", profiler.wrap("Previous cloud", boost::bind(&PCDSequence::onLoadPrevCloud, this)));
 
 	// 2nd version - external trigger.
-	registerHandler("onTriggeredLoadPrevCloud", boost::bind(&PCDSequence::onTriggeredLoadPrevCloud, this));
+	registerHandler("onTriggeredLoadPrevCloud", profiler.wrap("onTriggeredLoadPrevCloud", boost::bind(&PCDSequence::onTriggeredLoadPrevCloud, this)));
 	addDependency("onTriggeredLoadPrevCloud", &in_prev_cloud_trigger);
 
 	// Register other handlers - reloads PCDSequence, triggered manually.
-	registerHandler("Reload seguence", boost::bind(&PCDSequence::onSequenceReload, this));
+	registerHandler("Reload seguence", profiler.wrap("Reload seguence", boost::bind(&PCDSequence::onSequenceReload, this)));
 
-	registerHandler("Publish cloud", boost::bind(&PCDSequence::onPublishCloud, this));
+	registerHandler("Publish cloud", profiler.wrap("Publish cloud", boost::bind(&PCDSequence::onPublishCloud, this)));
 
-	registerHandler("onTriggeredPublishCloud", boost::bind(&PCDSequence::onTriggeredPublishCloud, this));
+	registerHandler("onTriggeredPublishCloud", profiler.wrap("onTriggeredPublishCloud", boost::bind(&PCDSequence::onTriggeredPublishCloud, this)));
 	addDependency("onTriggeredPublishCloud", &in_publish_cloud_trigger);
 
 }
 
 bool PCDSequence::onInit() {
+	profiler.setEnabled(profile, profile_period);
 	CLOG(LTRACE) << "initialize\n";
 
 	// Set indices.
 	index = 0;
 	previous_index = -1;
+	direction = 1;
 
 	// Initialize flags.
 	next_cloud_flag = false;
@@ -111,7 +128,9 @@ bool PCDSequence::onInit() {
 }
 
 bool PCDSequence::onFinish() {
+	profiler.report();
 	CLOG(LTRACE) << "onFinish";
+	prefetcher.stop();
 	return true;
 }
 
@@ -137,12 +156,20 @@ void PCDSequence::onLoadCloud() {
 	
 	if(reload_sequence_flag) {
 		// Try to reload PCDSequence.
-		if (!findFiles()) {
+		if (!std::string(prop_container).empty()) {
+			if (!openContainer())
+				CLOG(LERROR) << "There are no frames in container " << prop_container;
+		} else if (!findFiles()) {
 			CLOG(LERROR) << "There are no files matching the regular expression "
 					<< prop_pattern << " in " << prop_directory;
 		}
 		index = 0;
 		reload_sequence_flag = false;
+		previous_index = -1;
+		if (container)
+			prefetcher.start(container, prop_prefetch_depth, prop_prefetch_threads);
+		else
+			prefetcher.start(files, prop_prefetch_depth, prop_prefetch_threads);
 	} else if (previous_index == -1) {
 		// Special case - start!
 			index = 0;
@@ -150,10 +177,12 @@ void PCDSequence::onLoadCloud() {
 		// Check triggering mode.
 		if ((prop_auto_next_cloud) || (next_cloud_flag)) {
 			index++;
+			direction = 1;
 		}//: if
 
 		if ((prop_auto_prev_cloud) || (prev_cloud_flag)) {
 			index--;
+			direction = -1;
 		}//: if
 
 		// Anyway, reset flags.
@@ -205,7 +234,7 @@ void PCDSequence::onLoadCloud() {
 	try {
 		if (index == previous_index) {
 			CLOG(LDEBUG) << "Returning previous cloud";
-			// There is no need to load the cloud - return stored one.
+			// There is no need to load the cloud - return stored one (stamped when loaded).
 			if (prop_return_xyz)
 				out_cloud_xyz.write(cloud_xyz);
 			if (prop_return_xyzrgb)
@@ -217,16 +246,25 @@ void PCDSequence::onLoadCloud() {
 
 		CLOG(LDEBUG) << "Loading cloud from file";
 
+		// File is parsed once (usually ahead of time), then converted to every requested type.
+		const uint64_t captured = Types::CaptureTime::now();
+		Types::PCDPrefetcher::FramePtr frame = prefetcher.get(index, direction, prop_loop);
+		if (!frame) {
+			CLOG(LWARNING) << "Cannot read cloud from " << files[index];
+			return;
+		}
+
 		if (prop_return_xyz){
 			// Initialize pointer to empty cloud.
-			pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz_tmp = pcl::PointCloud<pcl::PointXYZ>::Ptr (new pcl::PointCloud<pcl::PointXYZ>);
-			// Try to read the cloud of XYZ points.
-			if (pcl::io::loadPCDFile<pcl::PointXYZ> (files[index], *cloud_xyz_tmp) == -1){
+			pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz_tmp;
+			// Try to convert the cloud of XYZ points.
+			if (!frame->convert<pcl::PointXYZ>(cloud_xyz_tmp)){
 				CLOG(LWARNING) <<"Cannot read PointXYZ cloud from "<<files[index];
 			}else{
 				previous_index = index;
 				// Override data stored in pointer.
 				cloud_xyz = cloud_xyz_tmp;
+				Types::CaptureTime::stamp(*cloud_xyz, captured);
 				out_cloud_xyz.write(cloud_xyz);
 				CLOG(LINFO) <<"PointXYZ cloud of size "<< cloud_xyz->size() << " loaded properly from "<<files[index];
 			}//: else
@@ -234,14 +272,15 @@ void PCDSequence::onLoadCloud() {
 
 		if (prop_return_xyzrgb){
 			// Initialize pointer to empty cloud.
-			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_xyzrgb_tmp = pcl::PointCloud<pcl::PointXYZRGB>::Ptr (new pcl::PointCloud<pcl::PointXYZRGB>);
-			// Try to read the cloud of XYZRGB points.
-			if (pcl::io::loadPCDFile<pcl::PointXYZRGB> (files[index], *cloud_xyzrgb_tmp) == -1){
+			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_xyzrgb_tmp;
+			// Try to convert the cloud of XYZRGB points.
+			if (!frame->convert<pcl::PointXYZRGB>(cloud_xyzrgb_tmp)){
 				CLOG(LWARNING) <<"Cannot read PointXYZRGB cloud from "<<files[index];
 			}else{
 				previous_index = index;
 				// Override data stored in pointer.
 				cloud_xyzrgb = cloud_xyzrgb_tmp;
+				Types::CaptureTime::stamp(*cloud_xyzrgb, captured);
 				out_cloud_xyzrgb.write(cloud_xyzrgb);
 				CLOG(LINFO) <<"PointXYZRGB cloud of size "<< cloud_xyzrgb->size() << " loaded properly from "<<files[index];
 			}//: else
@@ -249,14 +288,15 @@ void PCDSequence::onLoadCloud() {
 
 		if (prop_return_xyzsift){
 			// Initialize pointer to empty cloud.
-			pcl::PointCloud<PointXYZSIFT>::Ptr cloud_xyzsift_tmp = pcl::PointCloud<PointXYZSIFT>::Ptr (new pcl::PointCloud<PointXYZSIFT>);
-			// Try to read the cloud of XYZSIFT points.
-			if (pcl::io::loadPCDFile<PointXYZSIFT> (files[index], *cloud_xyzsift_tmp) == -1){
+			pcl::PointCloud<PointXYZSIFT>::Ptr cloud_xyzsift_tmp;
+			// Try to convert the cloud of XYZSIFT points.
+			if (!frame->convert<PointXYZSIFT>(cloud_xyzsift_tmp)){
 				CLOG(LWARNING) <<"Cannot read PointXYZSIFT cloud from "<<files[index];
 			}else{
 				previous_index = index;
 				// Override data stored in pointer.
 				cloud_xyzsift = cloud_xyzsift_tmp;
+				Types::CaptureTime::stamp(*cloud_xyzsift, captured);
 				out_cloud_xyzsift.write(cloud_xyzsift);
 				CLOG(LINFO) <<"PointXYZSIFT cloud of size "<< cloud_xyzsift->size() << " loaded properly from "<<files[index];
 			}//: else
@@ -311,6 +351,7 @@ bool PCDSequence::onStop() {
 
 bool PCDSequence::findFiles() {
 	files.clear();
+	container.reset();
 
 	files = Utils::searchFiles(prop_directory, prop_pattern);
 
@@ -324,6 +365,23 @@ bool PCDSequence::findFiles() {
 	return !files.empty();
 }
 
+bool PCDSequence::openContainer() {
+	files.clear();
+	container.reset(new Types::PCDContainerReader);
+	if (!container->open(prop_container)) {
+		container.reset();
+		return false;
+	}
+
+	// Seeking is done by the index, names are used only in messages.
+	const size_t frames = container->groups().size();
+	for (size_t i = 0; i < frames; ++i)
+		files.push_back(std::string(prop_container) + "#" + boost::lexical_cast<std::string>(i));
+
+	CLOG(LINFO) << "PCDSequence loaded from container " << prop_container << ": " << frames << " frames.";
+	return !files.empty();
+}
+
 
 
 } //: namespace PCDSequence
@@ -13,10 +13,13 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl/io/pcd_io.h>
 #include <Types/PointXYZSIFT.hpp>
+#include <Types/PCDPrefetcher.hpp>
 
 
 namespace Processors {
@@ -147,9 +150,19 @@ private:
 	 */
 	bool findFiles();
 
-	/// List of file names in sequence.
+	/**
+	 * Fill list of frames from the container
+	 *
+	 * \return true, if the container holds at least one frame, false otherwise
+	 */
+	bool openContainer();
+
+	/// List of file names in sequence (or names of container frames).
 	std::vector<std::string> files;
 
+	/// Container the sequence is read from, if set.
+	boost::shared_ptr<Types::PCDContainerReader> container;
+
 	// Current clouds.
 
 	/// Cloud containing points with Cartesian coordinates (XYZ).
@@ -168,6 +181,12 @@ private:
 	/// Index of cloud returned in the previous step.
 	int previous_index;
 
+	/// Direction of the last index change (+1 or -1), files are read ahead in it.
+	int direction;
+
+	/// Loads upcoming files in the background.
+	Types::PCDPrefetcher prefetcher;
+
 	/// Flag indicating whether the cloud should be published
 	bool publish_cloud_flag;
 
@@ -187,6 +206,9 @@ private:
 	/// Files pattern (regular expression).
 	Base::Property<std::string> prop_pattern;
 
+	/// Container recorded by PCDWriter, replayed instead of the directory if set.
+	Base::Property<std::string> prop_container;
+
 	/// Publishing mode: auto vs triggered.
 	Base::Property<bool> prop_auto_publish_cloud;
 
@@ -212,10 +234,25 @@ private:
 	/// Property - return xyzsift cloud.
 	Base::Property<bool> prop_return_xyzsift;
 
+	/// Property - number of files read ahead of the current one (0 - only the current file).
+	Base::Property<int> prop_prefetch_depth;
+
+	/// Property - number of threads reading files.
+	Base::Property<int> prop_prefetch_threads;
+
 
 	/// TODO: loads whole sequence at start.
 //	Base::Property<bool> prop_read_on_init;
 
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace PCDSequence
@@ -12,6 +12,9 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/QuantizedSIFT.hpp"
+
 //#include <Types/PointXYZDescriptor.hpp>
 
 #include <pcl/point_cloud.h>
@@ -27,13 +30,28 @@ PCDWriter::PCDWriter(const std::string & name) :
 	base_name("base_name", std::string("cloud")),
 	prop_auto_trigger("auto_trigger", false),
 	binary("binary", false),
-	suffix("suffix", true)
+	suffix("suffix", true),
+	prop_format("format", std::string("ascii")),
+	prop_queue_size("queue.size", 8),
+	prop_queue_block("queue.block", false),
+	prop_container("container", false),
+	prop_sift_quantize("sift.quantize", false),
+	profile("profile", false),
+	profile_period("profile.period", 100),
+	profiler(name)
 {
 	registerProperty(directory);
 	registerProperty(base_name);
 	registerProperty(prop_auto_trigger);
 	registerProperty(binary);
 	registerProperty(suffix);
+	registerProperty(prop_format);
+	registerProperty(prop_queue_size);
+	registerProperty(prop_queue_block);
+	registerProperty(prop_container);
+	registerProperty(prop_sift_quantize);
+	registerProperty(profile);
+	registerProperty(profile_period);
 }
 
 PCDWriter::~PCDWriter() {
@@ -44,36 +62,50 @@ void PCDWriter::prepareInterface() {
 	registerStream("in_cloud_xyz", &in_cloud_xyz);
 	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
 	registerStream("in_cloud_xyzsift", &in_cloud_xyzsift);
+	registerStream("in_cloud_xyzsift8", &in_cloud_xyzsift8);
 	registerStream("in_save_cloud_trigger", &in_save_cloud_trigger);
+	registerStream("out_queue_depth", &out_queue_depth);
+	registerStream("out_dropped", &out_dropped);
 
 	// Register handlers - save cloud, can be triggered manually (from GUI) or by new data present in trigger dataport.
 	// 1st version - manually.
-	registerHandler("onSaveCloudButtonPressed", boost::bind(&PCDWriter::onSaveCloudButtonPressed, this));
+	registerHandler("onSaveCloudButtonPressed", profiler.wrap("onSaveCloudButtonPressed", boost::bind(&PCDWriter::onSaveCloudButtonPressed, this)));
 
 	// 2nd version - external trigger.
-	registerHandler("onSaveCloudTriggered", boost::bind(&PCDWriter::onSaveCloudTriggered, this));
+	registerHandler("onSaveCloudTriggered", profiler.wrap("onSaveCloudTriggered", boost::bind(&PCDWriter::onSaveCloudTriggered, this)));
 	addDependency("onSaveCloudTriggered", &in_save_cloud_trigger);
 
 	// Register "main"/"default" handler.
-	registerHandler("mainHandler", boost::bind(&PCDWriter::mainHandler, this));
+	registerHandler("mainHandler", profiler.wrap("mainHandler", boost::bind(&PCDWriter::mainHandler, this)));
 	addDependency("mainHandler", NULL);
 }
 
 bool PCDWriter::onInit() {
+	profiler.setEnabled(profile, profile_period);
 	// Init flags.
 	save_cloud_flag = false;
 	return true;
 }
 
 bool PCDWriter::onFinish() {
+	profiler.report();
+	queue.stop();
+	container.close();
 	return true;
 }
 
 bool PCDWriter::onStop() {
+	// Save everything that is queued.
+	queue.stop();
+	if (queue.dropped() > 0)
+		CLOG(LWARNING) << "Dropped " << queue.dropped() << " clouds, queue was full";
+	container.close();
 	return true;
 }
 
 bool PCDWriter::onStart() {
+	container_name.clear();
+	queue.start(prop_queue_size);
 	return true;
 }
 
@@ -98,6 +130,9 @@ void PCDWriter::mainHandler () {
 		return;
 	save_cloud_flag = false;
 
+	// Clouds saved together share the stamp, PCDSequence groups them into one frame of a container.
+	stamp = boost::posix_time::to_iso_extended_string(boost::posix_time::microsec_clock::local_time());
+
 	// Try to save the retrieved clouds.
 	if(!in_cloud_xyz.empty())
 		Write_xyz();
@@ -105,6 +140,11 @@ void PCDWriter::mainHandler () {
 		Write_xyzrgb();
 	if(!in_cloud_xyzsift.empty())
 		Write_xyzsift();
+	if(!in_cloud_xyzsift8.empty())
+		Write_xyzsift8();
+
+	out_queue_depth.write(queue.depth());
+	out_dropped.write(queue.dropped());
 }
 
 
@@ -134,12 +174,10 @@ std::string PCDWriter::prepareName(std::string suffix_) {
 void PCDWriter::Write_xyz() {
 	CLOG(LTRACE) << "Write_xyz";
 	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
-	
-	if (cloud->points.size() != 0) {
-		std::string fn = prepareName("_xyz.pcd");
-		pcl::io::savePCDFile (fn, *cloud, binary);
-		CLOG(LNOTICE) << "Saved " << cloud->points.size () << " XYZ points to "<< fn;
-	} else
+
+	if (cloud->points.size() != 0)
+		write<pcl::PointXYZ>(cloud, "_xyz.pcd", "xyz");
+	else
 		CLOG(LWARNING) << "Cloud contains no XYZ points, thus save to file skipped";
 }
 
@@ -148,11 +186,9 @@ void PCDWriter::Write_xyzrgb() {
 	CLOG(LTRACE) << "Write_xyzrgb";
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
 
-	if (cloud->points.size() != 0) {
-		std::string fn = prepareName("_xyzrgb.pcd");
-		pcl::io::savePCDFile (fn, *cloud, binary);
-		CLOG(LNOTICE) << "Saved " << cloud->points.size () << " XYZRGB points to "<< fn;
-	} else
+	if (cloud->points.size() != 0)
+		write<pcl::PointXYZRGB>(cloud, "_xyzrgb.pcd", "xyzrgb");
+	else
 		CLOG(LWARNING) << "Cloud contains no XYZRGB points, thus save to file skipped";
 }
 
@@ -161,14 +197,81 @@ void PCDWriter::Write_xyzsift() {
 	CLOG(LTRACE) << "Write_xyzsift";
 	pcl::PointCloud<PointXYZSIFT>::Ptr cloud = in_cloud_xyzsift.read();
 
-	if (cloud->points.size() != 0) {
-		std::string fn = prepareName("_xyzsift.pcd");
-		pcl::io::savePCDFile (fn, *cloud, binary);
-		CLOG(LNOTICE) << "Saved " << cloud->points.size () << " XYZSIFT points to "<< fn << std::endl;
-	} else
+	if (cloud->points.size() == 0) {
 		CLOG(LWARNING) << "Cloud contains no XYZSIFT points, thus save to file skipped";
+	} else if (prop_sift_quantize) {
+		// Quantized here, so the queue holds the small cloud.
+		pcl::PointCloud<PointXYZSIFT8>::Ptr cloud8 = Types::CloudPool<PointXYZSIFT8>::acquire(cloud->size());
+		Types::QuantizedSIFT::quantize(*cloud, *cloud8);
+		write<PointXYZSIFT8>(cloud8, "_xyzsift8.pcd", "xyzsift8");
+	} else
+		write<PointXYZSIFT>(cloud, "_xyzsift.pcd", "xyzsift");
 }
 
 
+void PCDWriter::Write_xyzsift8() {
+	CLOG(LTRACE) << "Write_xyzsift8";
+	pcl::PointCloud<PointXYZSIFT8>::Ptr cloud = in_cloud_xyzsift8.read();
+
+	if (cloud->points.size() != 0)
+		write<PointXYZSIFT8>(cloud, "_xyzsift8.pcd", "xyzsift8");
+	else
+		CLOG(LWARNING) << "Cloud contains no XYZSIFT8 points, thus save to file skipped";
+}
+
+template <typename PointT>
+void PCDWriter::write(const typename pcl::PointCloud<PointT>::Ptr & cloud, const std::string & suffix_, const std::string & type) {
+	std::string fn;
+	if (prop_container) {
+		// One container per run, named after the first cloud.
+		if (container_name.empty())
+			container_name = std::string(directory) + "/" + stamp + "_" + std::string(base_name) + ".pcds";
+		fn = container_name;
+	} else
+		fn = prepareName(suffix_);
+
+	// Legacy binary flag turns the default ascii into binary.
+	std::string format = prop_format;
+	if (binary && format == "ascii")
+		format = "binary";
+
+	// Writer keeps a reference to the cloud, so it is not reused before it is saved.
+	if (!queue.push(boost::bind(&PCDWriter::save<PointT>, this, cloud, fn, format, (bool) prop_container, type, stamp), prop_queue_block))
+		CLOG(LWARNING) << "Writer queue is full, " << type << " cloud dropped";
+}
+
+template <typename PointT>
+bool PCDWriter::save(const typename pcl::PointCloud<PointT>::Ptr & cloud, const std::string & fn, const std::string & format,
+		bool to_container, const std::string & type, const std::string & stamp_) {
+	if (to_container) {
+		if (container.file() != fn && !container.open(fn)) {
+			CLOG(LERROR) << "Cannot create container " << fn;
+			return false;
+		}
+		if (!container.append(*cloud, type, stamp_)) {
+			CLOG(LERROR) << "Cannot append cloud to container " << fn;
+			return false;
+		}
+		CLOG(LNOTICE) << "Appended " << cloud->points.size() << " " << type << " points to " << fn << " as frame " << container.frames() - 1;
+		return true;
+	}
+
+	pcl::PCDWriter writer;
+	int result;
+	if (format == "binary_compressed")
+		result = writer.writeBinaryCompressed(fn, *cloud);
+	else if (format == "binary")
+		result = writer.writeBinary(fn, *cloud);
+	else
+		result = writer.writeASCII(fn, *cloud);
+
+	if (result < 0) {
+		CLOG(LERROR) << "Cannot save " << type << " cloud to " << fn;
+		return false;
+	}
+	CLOG(LNOTICE) << "Saved " << cloud->points.size() << " " << type << " points to " << fn;
+	return true;
+}
+
 } //: namespace PCDWrite
 } //: namespace Processors
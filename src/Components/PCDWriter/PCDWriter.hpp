@@ -13,9 +13,15 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <Types/PointXYZSIFT.hpp>
+#include "Types/PointXYZSIFT8.hpp"
+
+#include "Types/WriteQueue.hpp"
+#include "Types/PCDContainer.hpp"
 
 namespace Processors {
 namespace PCDWriter {
@@ -24,7 +30,11 @@ namespace PCDWriter {
  * \class PCDWrite
  * \brief PCDWrite processor class.
  *
- * PCDWrite processor.
+ * PCDWrite processor. Clouds are saved by a writer thread, through a queue
+ * of queue.size clouds, so slow disk does not stall the executor. When the
+ * queue is full new clouds are dropped, or the executor waits if queue.block
+ * is set. With container set all clouds are appended to a single file with
+ * an index (see Types::PCDContainer) instead of one file per cloud.
  */
 class PCDWriter: public Base::Component {
 public:
@@ -79,6 +89,14 @@ protected:
 	/// Cloud containing points with Cartesian coordinates and SIFT descriptor (XYZ + 128).
 	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzsift;
 
+	/// Cloud containing points with Cartesian coordinates and SIFT descriptor quantized to 8 bits.
+	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT8>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzsift8;
+
+	/// Number of clouds waiting to be saved.
+	Base::DataStreamOut<int> out_queue_depth;
+
+	/// Number of clouds dropped because the queue was full.
+	Base::DataStreamOut<int> out_dropped;
 
 	/// Flag indicating that the cloud should be saved to file.
 	bool save_cloud_flag;
@@ -89,6 +107,27 @@ protected:
 	Base::Property<bool> suffix;
 	Base::Property<bool> binary;
 
+	/// File format: ascii, binary or binary_compressed (LZF). Setting binary turns ascii into binary.
+	Base::Property<std::string> prop_format;
+
+	/// Number of clouds waiting for the writer thread, 0 saves synchronously.
+	Base::Property<int> prop_queue_size;
+
+	/// Wait for the writer when queue is full instead of dropping the cloud.
+	Base::Property<bool> prop_queue_block;
+
+	/// Append all clouds to a single container file with an index.
+	Base::Property<bool> prop_container;
+
+	/// Save SIFT clouds with descriptors quantized to 8 bits (as xyzsift8).
+	Base::Property<bool> prop_sift_quantize;
+
+	/// Writer thread and its queue.
+	Types::WriteQueue queue;
+
+	/// Container, used only by the writer.
+	Types::PCDContainer container;
+
 	/// Saving mode: continous vs triggered.
 	Base::Property<bool> prop_auto_trigger;
 
@@ -96,10 +135,26 @@ protected:
 	void Write_xyz();
 	void Write_xyzrgb();
 	void Write_xyzsift();
+	void Write_xyzsift8();
 	
 	// Prepares filename.
 	std::string prepareName(std::string suffix_);
 
+	/// Queues the cloud to be saved to file with the given suffix, or to the container.
+	template <typename PointT>
+	void write(const typename pcl::PointCloud<PointT>::Ptr & cloud, const std::string & suffix_, const std::string & type);
+
+	/// Saves the cloud, executed by the writer.
+	template <typename PointT>
+	bool save(const typename pcl::PointCloud<PointT>::Ptr & cloud, const std::string & fn, const std::string & format,
+			bool to_container, const std::string & type, const std::string & stamp_);
+
+	/// Name of the container file of the current run.
+	std::string container_name;
+
+	/// Time of the current save.
+	std::string stamp;
+
 	// Handlers
 
 	/// Main handler, called every time when writer gets processor time.
@@ -111,6 +166,15 @@ protected:
 	/// Event handler function - save cloud, externally triggered version.
 	void onSaveCloudTriggered();
 
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace PCDWrite
@@ -12,6 +12,10 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/CloudBatch.hpp"
+#include "Types/DeviceFilters.hpp"
+
 namespace Processors {
 namespace PassThrough {
 
@@ -26,7 +30,12 @@ PassThrough::PassThrough(const std::string & name) :
         negative_x("negative_x", false),
         negative_y("negative_y", false),
         negative_z("negative_z", false),
-	pass_through("pass_through", false)
+	pass_through("pass_through", false),
+	gpu("gpu", false),
+	gpu_download("gpu.download", true),
+	profile("profile", false),
+	profile_period("profile.period", 100),
+	profiler(name)
 {
 	registerProperty(xa);
 	registerProperty(xb);
@@ -38,6 +47,10 @@ PassThrough::PassThrough(const std::string & name) :
 	registerProperty(negative_y);
 	registerProperty(negative_z);
 	registerProperty(pass_through);
+	registerProperty(gpu);
+	registerProperty(gpu_download);
+	registerProperty(profile);
+	registerProperty(profile_period);
 }
 
 PassThrough::~PassThrough() {
@@ -48,24 +61,49 @@ void PassThrough::prepareInterface() {
     registerStream("in_cloud_xyz", &in_cloud_xyz);
     registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
     registerStream("in_cloud_xyzsift", &in_cloud_xyzsift);
+    registerStream("in_cloud_xyzshot", &in_cloud_xyzshot);
     registerStream("out_cloud_xyz", &out_cloud_xyz);
     registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
     registerStream("out_cloud_xyzsift", &out_cloud_xyzsift);
+    registerStream("out_cloud_xyzshot", &out_cloud_xyzshot);
+    registerStream("in_device_cloud_xyzrgb", &in_device_cloud_xyzrgb);
+    registerStream("out_device_cloud_xyzrgb", &out_device_cloud_xyzrgb);
+    registerStream("in_clouds_xyz", &in_clouds_xyz);
+    registerStream("in_clouds_xyzrgb", &in_clouds_xyzrgb);
+    registerStream("out_clouds_xyz", &out_clouds_xyz);
+    registerStream("out_clouds_xyzrgb", &out_clouds_xyzrgb);
+    registerStream("in_soa_xyzsift", &in_soa_xyzsift);
+    registerStream("out_soa_xyzsift", &out_soa_xyzsift);
+    registerStream("out_box", &out_box);
     // Register handlers
-    registerHandler("filter_xyz", boost::bind(&PassThrough::filter_xyz, this));
+    registerHandler("filter_xyz", profiler.wrap("filter_xyz", boost::bind(&PassThrough::filter_xyz, this)));
     addDependency("filter_xyz", &in_cloud_xyz);
-    registerHandler("filter_xyzrgb", boost::bind(&PassThrough::filter_xyzrgb, this));
+    registerHandler("filter_xyzrgb", profiler.wrap("filter_xyzrgb", boost::bind(&PassThrough::filter_xyzrgb, this)));
     addDependency("filter_xyzrgb", &in_cloud_xyzrgb);
-    registerHandler("filter_xyzsift", boost::bind(&PassThrough::filter_xyzsift, this));
+    registerHandler("filter_xyzsift", profiler.wrap("filter_xyzsift", boost::bind(&PassThrough::filter_xyzsift, this)));
     addDependency("filter_xyzsift", &in_cloud_xyzsift);
+    registerHandler("filter_xyzshot", profiler.wrap("filter_xyzshot", boost::bind(&PassThrough::filter_xyzshot, this)));
+    addDependency("filter_xyzshot", &in_cloud_xyzshot);
+    registerHandler("filter_device_xyzrgb", profiler.wrap("filter_device_xyzrgb", boost::bind(&PassThrough::filter_device_xyzrgb, this)));
+    addDependency("filter_device_xyzrgb", &in_device_cloud_xyzrgb);
+    registerHandler("filter_clouds_xyz", profiler.wrap("filter_clouds_xyz", boost::bind(&PassThrough::filter_clouds_xyz, this)));
+    addDependency("filter_clouds_xyz", &in_clouds_xyz);
+    registerHandler("filter_clouds_xyzrgb", profiler.wrap("filter_clouds_xyzrgb", boost::bind(&PassThrough::filter_clouds_xyzrgb, this)));
+    addDependency("filter_clouds_xyzrgb", &in_clouds_xyzrgb);
+    registerHandler("filter_soa_xyzsift", profiler.wrap("filter_soa_xyzsift", boost::bind(&PassThrough::filter_soa_xyzsift, this)));
+    addDependency("filter_soa_xyzsift", &in_soa_xyzsift);
 }
 
 bool PassThrough::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	if (gpu && !Types::Cuda::available())
+		CLOG(LWARNING) << "PassThrough: no CUDA device (or built without CUDA), filtering on the CPU";
 
 	return true;
 }
 
 bool PassThrough::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -77,169 +115,152 @@ bool PassThrough::onStart() {
 	return true;
 }
 
+Types::BoxCrop PassThrough::box() {
+	Types::BoxCrop crop;
+	crop.setLimits(0, xa, xb, negative_x);
+	crop.setLimits(1, ya, yb, negative_y);
+	crop.setLimits(2, za, zb, negative_z);
+	out_box.write(crop);
+	return crop;
+}
+
+template <typename PointT>
+typename pcl::PointCloud<PointT>::Ptr PassThrough::crop(typename pcl::PointCloud<PointT>::Ptr cloud) {
+	typename pcl::PointCloud<PointT>::Ptr cloud_filtered = Types::CloudPool<PointT>::acquire(cloud->size());
+	const Types::BoxCrop crop = box();
+	// Box open along two axes is a single-axis pass-through, tested on one field only.
+	const int bounded = crop.bounded(0) + crop.bounded(1) + crop.bounded(2);
+	if (bounded == 1 && crop.bounded(0))
+		Types::FieldRange<Types::Fields::X>(xa, xb, negative_x).filter(*cloud, *cloud_filtered);
+	else if (bounded == 1 && crop.bounded(1))
+		Types::FieldRange<Types::Fields::Y>(ya, yb, negative_y).filter(*cloud, *cloud_filtered);
+	else if (bounded == 1 && crop.bounded(2))
+		Types::FieldRange<Types::Fields::Z>(za, zb, negative_z).filter(*cloud, *cloud_filtered);
+	else
+		crop.filter(*cloud, *cloud_filtered);
+	CLOG(LDEBUG) << "Points left: " << cloud_filtered->size() << " of " << cloud->size();
+	profiler.points(cloud->size(), cloud_filtered->size());
+	return cloud_filtered;
+}
+
+/// Crops clouds of a batch to the box.
+struct BatchCrop {
+	explicit BatchCrop(const Types::BoxCrop & box_) : box(box_) {}
+
+	template <typename PointT>
+	void operator()(const typename pcl::PointCloud<PointT>::Ptr & input, pcl::PointCloud<PointT> & output, int) const {
+		box.filter(*input, output);
+	}
+
+	Types::BoxCrop box;
+};
+
+template <typename PointT>
+void PassThrough::cropBatch(Base::DataStreamIn<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & in,
+		Base::DataStreamOut<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & out) {
+	std::vector<typename pcl::PointCloud<PointT>::Ptr> clouds = in.read();
+	if (pass_through) {
+		out.write(clouds);
+		return;
+	}
+
+	std::vector<typename pcl::PointCloud<PointT>::Ptr> clouds_filtered;
+	BatchCrop crop(box());
+	Types::CloudBatch::filter<PointT>(clouds, clouds_filtered, crop);
+	CLOG(LDEBUG) << "Cropped " << clouds.size() << " clouds";
+	profiler.points(Types::CloudBatch::points<PointT>(clouds), Types::CloudBatch::points<PointT>(clouds_filtered));
+	out.write(clouds_filtered);
+}
+
+void PassThrough::cropDevice(Types::DeviceCloud<pcl::PointXYZRGB>::Ptr cloud) {
+	if (!pass_through) {
+		Types::DeviceCloud<pcl::PointXYZRGB>::Ptr cloud_filtered = Types::Cuda::crop(*cloud, box());
+		if (cloud_filtered) {
+			CLOG(LDEBUG) << "Points left: " << cloud_filtered->size() << " of " << cloud->size();
+			profiler.points(cloud->size(), cloud_filtered->size());
+			cloud = cloud_filtered;
+		} else {
+			// No device, the cloud is in host memory.
+			cloud = Types::DeviceCloud<pcl::PointXYZRGB>::upload(crop<pcl::PointXYZRGB>(cloud->host()));
+		}
+	}
+	out_device_cloud_xyzrgb.write(cloud);
+	// Download happens only here, and only once for all CPU consumers.
+	if (gpu_download)
+		out_cloud_xyzrgb.write(cloud->host());
+}
+
 void PassThrough::filter_xyz() {
 	CLOG(LTRACE) <<"filter_xyz()";
 	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
 
-	if (!pass_through) {
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-		pcl::PassThrough<pcl::PointXYZ> pass;
-		pass.setInputCloud (cloud);
-		pass.setFilterFieldName ("x");
-		pass.setFilterLimits (xa, xb);
-		pass.setFilterLimitsNegative (negative_x);
-		pass.filter (*cloud_filtered);
-		// Set resulting cloud as input.
-		pass.setInputCloud (cloud_filtered);
-		pass.setFilterFieldName ("y");
-		pass.setFilterLimits (ya, yb);
-		pass.setFilterLimitsNegative (negative_y);
-		pass.filter (*cloud_filtered);
-		pass.setFilterFieldName ("z");
-		pass.setFilterLimits (za, zb);
-		pass.setFilterLimitsNegative (negative_z);
-		pass.filter (*cloud_filtered);
-		out_cloud_xyz.write(cloud_filtered);
-	} else 
+	if (!pass_through)
+		out_cloud_xyz.write(crop<pcl::PointXYZ>(cloud));
+	else
 		out_cloud_xyz.write(cloud);
 }
 
 void PassThrough::filter_xyzrgb() {
-	LOG(LTRACE) <<"filter_xyzrgb()";
+	CLOG(LTRACE) <<"filter_xyzrgb()";
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
 
-	if (!pass_through) {
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZRGB>);
-		pcl::PassThrough<pcl::PointXYZRGB> pass;
-		pass.setInputCloud (cloud);
-		pass.setFilterFieldName ("x");
-		pass.setFilterLimits (xa, xb);
-		pass.setFilterLimitsNegative (negative_x);
-		pass.filter (*cloud_filtered);
-		// Set resulting cloud as input.
-		pass.setInputCloud (cloud_filtered);
-		pass.setFilterFieldName ("y");
-		pass.setFilterLimits (ya, yb);
-		pass.setFilterLimitsNegative (negative_y);
-		pass.filter (*cloud_filtered);
-		pass.setFilterFieldName ("z");
-		pass.setFilterLimits (za, zb);
-		pass.setFilterLimitsNegative (negative_z);
-		pass.filter (*cloud_filtered);
-		out_cloud_xyzrgb.write(cloud_filtered);
-	} else 
+	if (gpu && Types::Cuda::available() && !pass_through)
+		cropDevice(Types::DeviceCloud<pcl::PointXYZRGB>::upload(cloud));
+	else if (!pass_through)
+		out_cloud_xyzrgb.write(crop<pcl::PointXYZRGB>(cloud));
+	else
 		out_cloud_xyzrgb.write(cloud);
-
 }
 
 void PassThrough::filter_xyzsift() {
-    LOG(LTRACE) <<"filter_xyzsift()";
+	CLOG(LTRACE) <<"filter_xyzsift()";
 	pcl::PointCloud<PointXYZSIFT>::Ptr cloud = in_cloud_xyzsift.read();
 
-	if (!pass_through) {
-		pcl::PointCloud<PointXYZSIFT>::Ptr cloud_filtered (new pcl::PointCloud<PointXYZSIFT>);
-		applyFilter(cloud, *cloud_filtered, "x", xa, xb, negative_x);
-		applyFilter(cloud_filtered, *cloud_filtered, "y", ya, yb, negative_y);
-		applyFilter(cloud_filtered, *cloud_filtered, "z", za, zb, negative_z);
-		out_cloud_xyzsift.write(cloud_filtered);
-	} else 
+	if (!pass_through)
+		out_cloud_xyzsift.write(crop<PointXYZSIFT>(cloud));
+	else
 		out_cloud_xyzsift.write(cloud);
-
 }
 
-void PassThrough::applyFilter (pcl::PointCloud<PointXYZSIFT>::Ptr input, pcl::PointCloud<PointXYZSIFT> &output, std::string filter_field_name, float min, float max, bool negative)
-{
-    CLOG(LTRACE) << "applyFilter() " << filter_field_name;
-    output.header = input->header;
-    output.sensor_origin_ = input->sensor_origin_;
-    output.sensor_orientation_ = input->sensor_orientation_;
+void PassThrough::filter_xyzshot() {
+	CLOG(LTRACE) <<"filter_xyzshot()";
+	pcl::PointCloud<PointXYZSHOT>::Ptr cloud = in_cloud_xyzshot.read();
 
-    std::vector<int> indices;
+	if (!pass_through)
+		out_cloud_xyzshot.write(crop<PointXYZSHOT>(cloud));
+	else
+		out_cloud_xyzshot.write(cloud);
+}
 
-    output.is_dense = true;
-    applyFilterIndices (indices, input, filter_field_name, min, max, negative);
-    CLOG(LTRACE)<< "Number of indices: "<< indices.size() <<endl;
-    copyPointCloud (*input, indices, output);
+void PassThrough::filter_device_xyzrgb() {
+	CLOG(LTRACE) <<"filter_device_xyzrgb()";
+	cropDevice(in_device_cloud_xyzrgb.read());
+}
 
+void PassThrough::filter_clouds_xyz() {
+	CLOG(LTRACE) <<"filter_clouds_xyz()";
+	cropBatch<pcl::PointXYZ>(in_clouds_xyz, out_clouds_xyz);
 }
 
-void PassThrough::applyFilterIndices (std::vector<int> &indices, pcl::PointCloud<PointXYZSIFT>::Ptr input, std::string filter_field_name, float min, float max, bool negative)
-{
-    CLOG(LTRACE) << "applyFilterIndices() " << filter_field_name;
-    pcl::IndicesPtr indices_(new vector<int>);
-    for(int i = 0; i < input->size(); i++){
-        indices_->push_back(i);
-    }
-
-    // The arrays to be used
-    indices.resize (indices_->size ());
-    int oii = 0; // oii = output indices iterator, rii = removed indices iterator
-    // Has a field name been specified?
-
-    if (filter_field_name.empty ())
-    {
-        // Only filter for non-finite entries then
-        for (int iii = 0; iii < static_cast<int> (indices_->size ()); ++iii) // iii = input indices iterator
-        {
-            // Non-finite entries are always passed to removed indices
-            if (!pcl_isfinite (input->points[(*indices_)[iii]].x) ||
-                    !pcl_isfinite (input->points[(*indices_)[iii]].y) ||
-                    !pcl_isfinite (input->points[(*indices_)[iii]].z))
-            {
-                continue;
-            }
-            indices[oii++] = (*indices_)[iii];
-        }
-    }
-    else
-    {
-        // Attempt to get the field name's index
-        std::vector<pcl::PCLPointField> fields;
-        int distance_idx = pcl::getFieldIndex (*input, filter_field_name, fields);
-        if (distance_idx == -1)
-        {
-            CLOG(LWARNING) << "applyFilterIndices Unable to find field name in point type.";
-            indices.clear ();
-            return;
-        }
-        // Filter for non-finite entries and the specified field limits
-        for (int iii = 0; iii < static_cast<int> (indices_->size ()); ++iii) // iii = input indices iterator
-        {
-            // Non-finite entries are always passed to removed indices
-            if (!pcl_isfinite (input->points[(*indices_)[iii]].x) ||
-                    !pcl_isfinite (input->points[(*indices_)[iii]].y) ||
-                    !pcl_isfinite (input->points[(*indices_)[iii]].z))
-            {
-                continue;
-            }
-            // Get the field's value
-            const uint8_t* pt_data = reinterpret_cast<const uint8_t*> (&input->points[(*indices_)[iii]]);
-            float field_value = 0;
-            memcpy (&field_value, pt_data + fields[distance_idx].offset, sizeof (float));
-            // Remove NAN/INF/-INF values. We expect passthrough to output clean valid data.
-            if (!pcl_isfinite (field_value))
-            {
-                continue;
-            }
-            // Outside of the field limits are passed to removed indices
-            if (!negative && (field_value < min || field_value > max))
-            {
-                continue;
-            }
-            // Inside of the field limits are passed to removed indices if negative was set
-            if (negative && field_value >= min && field_value <= max)
-            {
-                continue;
-            }
-            // Otherwise it was a normal point for output (inlier)
-            indices[oii++] = (*indices_)[iii];
-        }
-    }
-    // Resize the output arrays
-    indices.resize (oii);
+void PassThrough::filter_clouds_xyzrgb() {
+	CLOG(LTRACE) <<"filter_clouds_xyzrgb()";
+	cropBatch<pcl::PointXYZRGB>(in_clouds_xyzrgb, out_clouds_xyzrgb);
 }
 
+void PassThrough::filter_soa_xyzsift() {
+	CLOG(LTRACE) <<"filter_soa_xyzsift()";
+	Types::SoACloud<PointXYZSIFT>::Ptr cloud = in_soa_xyzsift.read();
 
+	if (pass_through) {
+		out_soa_xyzsift.write(cloud);
+		return;
+	}
+	Types::SoACloud<PointXYZSIFT>::Ptr cloud_filtered(new Types::SoACloud<PointXYZSIFT>);
+	box().filter(*cloud, *cloud_filtered);
+	CLOG(LDEBUG) << "Points left: " << cloud_filtered->size() << " of " << cloud->size();
+	profiler.points(cloud->size(), cloud_filtered->size());
+	out_soa_xyzsift.write(cloud_filtered);
+}
 
 } //: namespace PassThrough
 } //: namespace Processors
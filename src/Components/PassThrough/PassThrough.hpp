@@ -13,9 +13,16 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <pcl/point_types.h>
-#include <pcl/filters/passthrough.h>
+#include <pcl/point_cloud.h>
 #include <Types/PointXYZSIFT.hpp>
+#include <Types/PointXYZSHOT.hpp>
+
+#include "Types/BoxCrop.hpp"
+#include "Types/SoACloud.hpp"
+#include "Types/DeviceCloud.hpp"
 
 namespace Processors {
 namespace PassThrough {
@@ -72,11 +79,25 @@ protected:
         Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_cloud_xyz;
         Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
         Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT>::Ptr> in_cloud_xyzsift;
+        Base::DataStreamIn<pcl::PointCloud<PointXYZSHOT>::Ptr> in_cloud_xyzshot;
+        Base::DataStreamIn<Types::DeviceCloud<pcl::PointXYZRGB>::Ptr> in_device_cloud_xyzrgb;
+        Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > in_clouds_xyz;
+        Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > in_clouds_xyzrgb;
+        /// XYZSIFT cloud split into coordinate arrays, cropped without reading descriptors.
+        Base::DataStreamIn<Types::SoACloud<PointXYZSIFT>::Ptr> in_soa_xyzsift;
 
     // Output data streams
         Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
         Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
         Base::DataStreamOut<pcl::PointCloud<PointXYZSIFT>::Ptr> out_cloud_xyzsift;
+        Base::DataStreamOut<pcl::PointCloud<PointXYZSHOT>::Ptr> out_cloud_xyzshot;
+        Base::DataStreamOut<Types::DeviceCloud<pcl::PointXYZRGB>::Ptr> out_device_cloud_xyzrgb;
+        Base::DataStreamOut<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > out_clouds_xyz;
+        Base::DataStreamOut<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > out_clouds_xyzrgb;
+        Base::DataStreamOut<Types::SoACloud<PointXYZSIFT>::Ptr> out_soa_xyzsift;
+
+        /// Box of every crop, connect to DepthConverter.in_roi to convert only pixels that can pass it.
+        Base::DataStreamOut<Types::BoxCrop> out_box;
 
         //Properties
         Base::Property<float> xa;
@@ -90,14 +111,47 @@ protected:
         Base::Property<bool> negative_z;
         Base::Property<bool> pass_through;
 
+        /// Property: crop XYZRGB clouds on the GPU (needs build with CUDA), results are also written to device cloud output.
+        Base::Property<bool> gpu;
+
+        /// Property: download results of the GPU to host cloud output - disable when only GPU components consume them.
+        Base::Property<bool> gpu_download;
+
 
         // Handlers
         void filter_xyz();
         void filter_xyzrgb();
         void filter_xyzsift();
+        void filter_xyzshot();
+        void filter_device_xyzrgb();
+        void filter_clouds_xyz();
+        void filter_clouds_xyzrgb();
+        void filter_soa_xyzsift();
+
+        /// Returns box crop configured from properties and publishes it on out_box.
+        Types::BoxCrop box();
+
+        /// Crops cloud to the box in one pass, returns new cloud. If limits of only one axis are set (the others are -inf..inf),
+        /// only that field of the points is tested.
+        template <typename PointT>
+        typename pcl::PointCloud<PointT>::Ptr crop(typename pcl::PointCloud<PointT>::Ptr cloud);
+
+        /// Crops all clouds of the vector (e.g. clusters) in parallel, on the CPU.
+        template <typename PointT>
+        void cropBatch(Base::DataStreamIn<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & in,
+                Base::DataStreamOut<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & out);
+
+        /// Crops device cloud on the GPU (on the CPU in builds without CUDA) and writes the results.
+        void cropDevice(Types::DeviceCloud<pcl::PointXYZRGB>::Ptr cloud);
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
 
-        void applyFilter (pcl::PointCloud<PointXYZSIFT>::Ptr input, pcl::PointCloud<PointXYZSIFT> &output, std::string filter_field_name, float min, float max, bool negative);
-        void applyFilterIndices (std::vector<int> &indices, pcl::PointCloud<PointXYZSIFT>::Ptr input, std::string filter_field_name, float min, float max, bool negative);
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
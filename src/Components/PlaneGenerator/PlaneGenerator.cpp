@@ -12,6 +12,9 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/CaptureTime.hpp"
+
 #include <boost/random.hpp> 
 #include <boost/random/normal_distribution.hpp> 
 
@@ -27,7 +30,11 @@ PlaneGenerator::PlaneGenerator(const std::string & name) :
 		c("equation.c", 0.0),
 		d("equation.d", 0.0),
 		mi("noise.mi", 0.0),
-		sigma("noise.sigma", 0.001)    {
+		sigma("noise.sigma", 0.001),
+		seed("seed", 0),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
 			
 			registerProperty(nr_of_points);
 			registerProperty(nr_of_outliers);
@@ -37,6 +44,9 @@ PlaneGenerator::PlaneGenerator(const std::string & name) :
 			registerProperty(d);
 			registerProperty(mi);
 			registerProperty(sigma);
+			registerProperty(seed);
+			registerProperty(profile);
+			registerProperty(profile_period);
 			nr_of_points.addConstraint("0");
 			nr_of_points.addConstraint("10000");
 			nr_of_outliers.addConstraint("0");
@@ -50,18 +60,29 @@ void PlaneGenerator::prepareInterface() {
 	// Register data streams, events and event handlers HERE!
 registerStream("out_pcl", &out_pcl);
 	// Register handlers
-	h_Generate.setup(boost::bind(&PlaneGenerator::Generate, this));
+	h_Generate.setup(profiler.wrap("Generate", boost::bind(&PlaneGenerator::Generate, this)));
 	registerHandler("Generate", &h_Generate);
 
 }
 
 bool PlaneGenerator::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	if (seed != 0) {
+		// Both the positions (rand) and the noise are reproducible.
+		srand(seed);
+		rng.seed((uint32_t) seed);
+	} else {
+		struct timeval start;
+		gettimeofday (&start, NULL);
+		rng.seed (start.tv_usec);
+	}
 	Generate();
 
 	return true;
 }
 
 bool PlaneGenerator::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -74,10 +95,10 @@ bool PlaneGenerator::onStart() {
 }
 
 void PlaneGenerator::Generate() {
-	
+	const uint64_t captured = Types::CaptureTime::now();
 if (nr_of_outliers > nr_of_points)
 		nr_of_outliers = 0;
-  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>);
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = Types::CloudPool<pcl::PointXYZ>::acquire();
   
   cloud->width  = nr_of_points;
   cloud->height = 1;
@@ -121,10 +142,6 @@ if (nr_of_outliers > nr_of_points)
    }
 	
 //noise
-        struct timeval start; 
-        gettimeofday (&start, NULL); 
-        boost::mt19937 rng; 
-        rng.seed (start.tv_usec); 
         boost::normal_distribution<> nd (mi, sigma); 
         boost::variate_generator<boost::mt19937&, 
 			boost::normal_distribution<> > var_nor (rng, nd); 
@@ -138,6 +155,7 @@ if (nr_of_outliers > nr_of_points)
 
 
 
+	Types::CaptureTime::stamp(*cloud, captured);
 	out_pcl.write(cloud); 
 	
 }
@@ -0,0 +1,244 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#include <memory>
+#include <string>
+
+#include "Preprocessing.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+#include "Types/CloudPool.hpp"
+#include "Types/CaptureTime.hpp"
+
+namespace Processors {
+namespace Preprocessing {
+
+Preprocessing::Preprocessing(const std::string & name) :
+		Base::Component(name) ,
+		undistort("undistort", false),
+		crop("crop", true),
+		crop_x_min("crop.x.min", -10),
+		crop_x_max("crop.x.max", 10),
+		crop_y_min("crop.y.min", -10),
+		crop_y_max("crop.y.max", 10),
+		crop_z_min("crop.z.min", 0),
+		crop_z_max("crop.z.max", 10),
+		x("LeafSize.x", 0.01f),
+		y("LeafSize.y", 0.01f),
+		z("LeafSize.z", 0.01f),
+		policy("policy", std::string("centroid")),
+		MeanK("MeanK", 50),
+		StddevMulThresh("StddevMulThresh", 1.0),
+		negative("negative", false),
+		box_received(false),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(undistort);
+	registerProperty(crop);
+	registerProperty(crop_x_min);
+	registerProperty(crop_x_max);
+	registerProperty(crop_y_min);
+	registerProperty(crop_y_max);
+	registerProperty(crop_z_min);
+	registerProperty(crop_z_max);
+	registerProperty(x);
+	registerProperty(y);
+	registerProperty(z);
+	registerProperty(policy);
+	registerProperty(MeanK);
+	registerProperty(StddevMulThresh);
+	registerProperty(negative);
+	registerProperty(profile);
+	registerProperty(profile_period);
+}
+
+Preprocessing::~Preprocessing() {
+}
+
+void Preprocessing::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_depth", &in_depth);
+	registerStream("in_depth_xyz", &in_depth_xyz);
+	registerStream("in_color", &in_color);
+	registerStream("in_mask", &in_mask);
+	registerStream("in_camera_info", &in_camera_info);
+	registerStream("in_box", &in_box);
+	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
+
+	// Register handlers - depth dependent functions (CAMERA INFO required).
+	registerHandler("process_depth", profiler.wrap("process_depth", boost::bind(&Preprocessing::process_depth, this)));
+	addDependency("process_depth", &in_depth);
+	addDependency("process_depth", &in_camera_info);
+
+	registerHandler("process_depth_mask", profiler.wrap("process_depth_mask", boost::bind(&Preprocessing::process_depth_mask, this)));
+	addDependency("process_depth_mask", &in_depth);
+	addDependency("process_depth_mask", &in_camera_info);
+	addDependency("process_depth_mask", &in_mask);
+
+	registerHandler("process_depth_color", profiler.wrap("process_depth_color", boost::bind(&Preprocessing::process_depth_color, this)));
+	addDependency("process_depth_color", &in_depth);
+	addDependency("process_depth_color", &in_camera_info);
+	addDependency("process_depth_color", &in_color);
+
+	registerHandler("process_depth_mask_color", profiler.wrap("process_depth_mask_color", boost::bind(&Preprocessing::process_depth_mask_color, this)));
+	addDependency("process_depth_mask_color", &in_depth);
+	addDependency("process_depth_mask_color", &in_camera_info);
+	addDependency("process_depth_mask_color", &in_mask);
+	addDependency("process_depth_mask_color", &in_color);
+
+	// Register handlers - XYZ depth dependent functions.
+	registerHandler("process_depth_xyz", profiler.wrap("process_depth_xyz", boost::bind(&Preprocessing::process_depth_xyz, this)));
+	addDependency("process_depth_xyz", &in_depth_xyz);
+
+	registerHandler("process_depth_xyz_mask", profiler.wrap("process_depth_xyz_mask", boost::bind(&Preprocessing::process_depth_xyz_mask, this)));
+	addDependency("process_depth_xyz_mask", &in_depth_xyz);
+	addDependency("process_depth_xyz_mask", &in_mask);
+
+	registerHandler("process_depth_xyz_color", profiler.wrap("process_depth_xyz_color", boost::bind(&Preprocessing::process_depth_xyz_color, this)));
+	addDependency("process_depth_xyz_color", &in_depth_xyz);
+	addDependency("process_depth_xyz_color", &in_color);
+
+	registerHandler("process_depth_xyz_color_mask", profiler.wrap("process_depth_xyz_color_mask", boost::bind(&Preprocessing::process_depth_xyz_color_mask, this)));
+	addDependency("process_depth_xyz_color_mask", &in_depth_xyz);
+	addDependency("process_depth_xyz_color_mask", &in_color);
+	addDependency("process_depth_xyz_color_mask", &in_mask);
+}
+
+bool Preprocessing::onInit() {
+	profiler.setEnabled(profile, profile_period);
+
+	return true;
+}
+
+bool Preprocessing::onFinish() {
+	profiler.report();
+	return true;
+}
+
+bool Preprocessing::onStop() {
+	return true;
+}
+
+bool Preprocessing::onStart() {
+	return true;
+}
+
+const Types::DepthBackProjection::Roi * Preprocessing::box(const Types::DepthBackProjection::RayTable * rays) {
+	if (!in_box.empty()) {
+		received_box = in_box.read();
+		box_received = true;
+	}
+	if (!crop && !box_received)
+		return NULL;
+
+	float min[3], max[3];
+	if (box_received) {
+		// Negative ranges keep points on both sides, such axes are not limited.
+		for (int a = 0; a < 3; ++a) {
+			bool negative_range;
+			received_box.getLimits(a, min[a], max[a], negative_range);
+			if (negative_range) {
+				min[a] = -FLT_MAX;
+				max[a] = FLT_MAX;
+			}
+		}
+	} else {
+		min[0] = crop_x_min;
+		max[0] = crop_x_max;
+		min[1] = crop_y_min;
+		max[1] = crop_y_max;
+		min[2] = crop_z_min;
+		max[2] = crop_z_max;
+	}
+	roi.setBox(min, max);
+	if (rays)
+		roi.project(*rays);
+	return &roi;
+}
+
+template <bool HasColor, typename PointT>
+void Preprocessing::process(bool xyz, bool masked, Types::FusedPreprocessor<PointT> & preprocessor,
+		Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out) {
+	typename Types::FusedPreprocessor<PointT>::Policy p = Types::FusedPreprocessor<PointT>::CENTROID;
+	if (!Types::FusedPreprocessor<PointT>::parsePolicy(policy, p))
+		CLOG(LWARNING) << "Unknown policy " << std::string(policy) << ", using centroid";
+	preprocessor.setLeafSize(x, y, z);
+	preprocessor.setPolicy(p);
+	preprocessor.setOutliers(MeanK, StddevMulThresh, negative);
+
+	cv::Mat image = xyz ? in_depth_xyz.read() : in_depth.read();
+	const uint64_t captured = Types::CaptureTime::now();
+	cv::Mat color = HasColor ? in_color.read() : cv::Mat();
+	if (masked)
+		mask_runs.build(in_mask.read());
+
+	// Final cloud is the only one allocated, it has at most one point per pixel.
+	typename pcl::PointCloud<PointT>::Ptr cloud = Types::CloudPool<PointT>::acquire();
+	if (xyz) {
+		preprocessor.template processXYZ<HasColor>(image, masked ? &mask_runs : NULL, color, box(NULL), *cloud);
+	} else {
+		Types::CameraInfo camera_info = in_camera_info.read();
+		// Depth map in millimeters.
+		Types::DepthBackProjection::Intrinsics K(camera_info.fx(), camera_info.fy(), camera_info.cx(), camera_info.cy(), 0.001f);
+		if (ray_table.update(K, image.cols, image.rows, undistort ? camera_info.distCoeffs() : cv::Mat())) {
+			CLOG(LINFO) << "Ray table rebuilt for " << image.cols << "x" << image.rows << (ray_table.separable() ? "" : " (undistorted)");
+		}
+		preprocessor.template processDepth<HasColor>(image, ray_table, masked ? &mask_runs : NULL, color, box(&ray_table), *cloud);
+	}
+
+	CLOG(LDEBUG) << "Points: " << preprocessor.converted() << " converted, " << preprocessor.cropped() << " in box, "
+			<< preprocessor.voxels() << " voxels, " << cloud->size() << " inliers";
+	profiler.points(image.total(), cloud->size());
+	Types::CaptureTime::stamp(*cloud, captured);
+	out.write(cloud);
+}
+
+void Preprocessing::process_depth() {
+	CLOG(LTRACE) << "Preprocessing::process_depth";
+	process<false, pcl::PointXYZ>(false, false, preprocessor_xyz, out_cloud_xyz);
+}
+
+void Preprocessing::process_depth_mask() {
+	CLOG(LTRACE) << "Preprocessing::process_depth_mask";
+	process<false, pcl::PointXYZ>(false, true, preprocessor_xyz, out_cloud_xyz);
+}
+
+void Preprocessing::process_depth_color() {
+	CLOG(LTRACE) << "Preprocessing::process_depth_color";
+	process<true, pcl::PointXYZRGB>(false, false, preprocessor_xyzrgb, out_cloud_xyzrgb);
+}
+
+void Preprocessing::process_depth_mask_color() {
+	CLOG(LTRACE) << "Preprocessing::process_depth_mask_color";
+	process<true, pcl::PointXYZRGB>(false, true, preprocessor_xyzrgb, out_cloud_xyzrgb);
+}
+
+void Preprocessing::process_depth_xyz() {
+	CLOG(LTRACE) << "Preprocessing::process_depth_xyz";
+	process<false, pcl::PointXYZ>(true, false, preprocessor_xyz, out_cloud_xyz);
+}
+
+void Preprocessing::process_depth_xyz_mask() {
+	CLOG(LTRACE) << "Preprocessing::process_depth_xyz_mask";
+	process<false, pcl::PointXYZ>(true, true, preprocessor_xyz, out_cloud_xyz);
+}
+
+void Preprocessing::process_depth_xyz_color() {
+	CLOG(LTRACE) << "Preprocessing::process_depth_xyz_color";
+	process<true, pcl::PointXYZRGB>(true, false, preprocessor_xyzrgb, out_cloud_xyzrgb);
+}
+
+void Preprocessing::process_depth_xyz_color_mask() {
+	CLOG(LTRACE) << "Preprocessing::process_depth_xyz_color_mask";
+	process<true, pcl::PointXYZRGB>(true, true, preprocessor_xyzrgb, out_cloud_xyzrgb);
+}
+
+} //: namespace Preprocessing
+} //: namespace Processors
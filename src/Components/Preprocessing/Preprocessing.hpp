@@ -0,0 +1,181 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#ifndef PREPROCESSING_HPP_
+#define PREPROCESSING_HPP_
+
+#include "Component_Aux.hpp"
+#include "Component.hpp"
+#include "DataStream.hpp"
+#include "Property.hpp"
+#include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+
+#include <Types/CameraInfo.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "Types/DepthBackProjection.hpp"
+#include "Types/FusedPreprocessing.hpp"
+#include "Types/BoxCrop.hpp"
+
+
+namespace Processors {
+namespace Preprocessing {
+
+/*!
+ * \class Preprocessing
+ * \brief Preprocessing processor class.
+ *
+ * Standard front end - DepthConverter, PassThrough, VoxelGrid and
+ * StatisticalOutlierRemoval - fused into one pass over the depth image (see
+ * Types::FusedPreprocessor): points are cropped and assigned to voxels while
+ * back-projected, outliers are searched among voxels, and only the final
+ * cloud is allocated and published. Stages are disabled by their
+ * properties (crop, zero leaf size, zero MeanK).
+ */
+class Preprocessing: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	Preprocessing(const std::string & name = "Preprocessing");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~Preprocessing();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams, as in DepthConverter
+	Base::DataStreamIn<cv::Mat, Base::DataStreamBuffer::Newest> in_depth;
+	Base::DataStreamIn<cv::Mat, Base::DataStreamBuffer::Newest> in_depth_xyz;
+	Base::DataStreamIn<cv::Mat, Base::DataStreamBuffer::Newest> in_color;
+	Base::DataStreamIn<cv::Mat, Base::DataStreamBuffer::Newest> in_mask;
+	Base::DataStreamIn<Types::CameraInfo, Base::DataStreamBuffer::Newest> in_camera_info;
+
+	/// Optional crop box in the camera frame (e.g. PassThrough.out_box), overrides the crop properties once received.
+	Base::DataStreamIn<Types::BoxCrop, Base::DataStreamBuffer::Newest> in_box;
+
+	// Output data streams
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
+
+	/// Bake undistortion (camera distortion coefficients) into the ray table.
+	Base::Property<bool> undistort;
+
+	/// Property: remove points out of the crop box.
+	Base::Property<bool> crop;
+
+	/// Limits of the crop box, in meters in the camera frame.
+	Base::Property<float> crop_x_min;
+	Base::Property<float> crop_x_max;
+	Base::Property<float> crop_y_min;
+	Base::Property<float> crop_y_max;
+	Base::Property<float> crop_z_min;
+	Base::Property<float> crop_z_max;
+
+	/// Property: leaf size of the voxel grid, 0 - no voxel grid.
+	Base::Property<float> x;
+	Base::Property<float> y;
+	Base::Property<float> z;
+
+	/// Property: point representing a voxel - centroid or first.
+	Base::Property<std::string> policy;
+
+	/// Property: outlier removal, as in StatisticalOutlierRemoval, MeanK 0 - no outlier removal.
+	Base::Property<float> MeanK;
+	Base::Property<float> StddevMulThresh;
+	Base::Property<bool> negative;
+
+	// Handlers
+	void process_depth();
+	void process_depth_mask();
+	void process_depth_color();
+	void process_depth_mask_color();
+	void process_depth_xyz();
+	void process_depth_xyz_mask();
+	void process_depth_xyz_color();
+	void process_depth_xyz_color_mask();
+
+	/// Runs the fused stages on the depth map (or XYZ image, if xyz) and writes the cloud to the port.
+	template <bool HasColor, typename PointT>
+	void process(bool xyz, bool masked, Types::FusedPreprocessor<PointT> & preprocessor,
+			Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out);
+
+	/// Returns crop box of the current frame projected with the rays (NULL for XYZ images), NULL if disabled.
+	const Types::DepthBackProjection::Roi * box(const Types::DepthBackProjection::RayTable * rays);
+
+	/// Preprocessors of all point types.
+	Types::FusedPreprocessor<pcl::PointXYZ> preprocessor_xyz;
+	Types::FusedPreprocessor<pcl::PointXYZRGB> preprocessor_xyzrgb;
+
+	/// Box received on in_box.
+	Types::BoxCrop received_box;
+	bool box_received;
+
+	/// Box of the current frame and its projection.
+	Types::DepthBackProjection::Roi roi;
+
+	/// Cached per-pixel rays of the depth camera.
+	Types::DepthBackProjection::RayTable ray_table;
+
+	/// Runs of the current mask.
+	Types::DepthBackProjection::MaskRuns mask_runs;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+};
+
+} //: namespace Preprocessing
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("Preprocessing", Processors::Preprocessing::Preprocessing)
+
+#endif /* PREPROCESSING_HPP_ */
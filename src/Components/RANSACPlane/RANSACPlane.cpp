@@ -12,16 +12,47 @@
 
 #include <boost/bind.hpp>
 
-#include <pcl/filters/extract_indices.h>
+#include "Types/CloudPool.hpp"
+
+#include <pcl/common/io.h>
 
 namespace Processors {
 namespace RANSACPlane {
 
 RANSACPlane::RANSACPlane(const std::string & name) :
 		Base::Component(name),
-		distance("distance", 0.01) {
+		distance("distance", 0.01),
+		method("method", std::string("RANSAC")),
+		max_iterations("max_iterations", 50),
+		planes("planes", 1),
+		min_inliers("min_inliers", 3),
+		warm_start("warm_start", false),
+		warm_start_ratio("warm_start_ratio", 0.9),
+		warm_start_samples("warm_start_samples", 1000),
+		publish_clouds("publish_clouds", true),
+		input_policy("input.policy", std::string("newest")),
+		input_queue("input.queue", 0),
+		input_deadline("input.deadline", 100),
+		input_pcl(name + ".in_pcl"),
+		input_xyz(name + ".in_xyz"),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
 			
 	registerProperty(distance);
+	registerProperty(method);
+	registerProperty(max_iterations);
+	registerProperty(planes);
+	registerProperty(min_inliers);
+	registerProperty(warm_start);
+	registerProperty(warm_start_ratio);
+	registerProperty(warm_start_samples);
+	registerProperty(publish_clouds);
+	registerProperty(input_policy);
+	registerProperty(input_queue);
+	registerProperty(input_deadline);
+	registerProperty(profile);
+	registerProperty(profile_period);
 
 }
 
@@ -32,30 +63,48 @@ void RANSACPlane::prepareInterface() {
 	// Register data streams, events and event handlers HERE!
 	registerStream("in_pcl", &in_pcl);
 	registerStream("in_xyz", &in_xyz);
+	registerStream("in_changed", &in_changed);
 	registerStream("out_outliers", &out_outliers);
 	registerStream("out_inliers", &out_inliers);
 	registerStream("out_model", &out_model);
+	registerStream("out_models", &out_models);
+	registerStream("out_planes", &out_planes);
+	registerStream("out_inliers_indices", &out_inliers_indices);
+	registerStream("out_outliers_indices", &out_outliers_indices);
 	// Register handlers
-	h_ransac.setup(boost::bind(&RANSACPlane::ransac, this));
+	h_ransac.setup(profiler.wrap("ransac", boost::bind(&RANSACPlane::ransac, this)));
 	registerHandler("ransac", &h_ransac);
 	addDependency("ransac", &in_pcl);
 	
-	h_ransac_xyz.setup(boost::bind(&RANSACPlane::ransacxyz, this));
+	h_ransac_xyz.setup(profiler.wrap("ransacxyz", boost::bind(&RANSACPlane::ransacxyz, this)));
 	registerHandler("ransacxyz", &h_ransac_xyz);
 	addDependency("ransacxyz", &in_xyz);
 
 }
 
 bool RANSACPlane::onInit() {
+	profiler.setEnabled(profile, profile_period);
+
+	if (!input_pcl.configure(input_policy, input_queue, input_deadline))
+		CLOG(LWARNING) << "Unknown input policy " << input_policy << ", using newest";
+	input_xyz.configure(input_policy, input_queue, input_deadline);
+	input_pcl.setReporting(profile, profile_period);
+	input_xyz.setReporting(profile, profile_period);
 
 	return true;
 }
 
 bool RANSACPlane::onFinish() {
+	profiler.report();
+	input_pcl.report();
+	input_xyz.report();
 	return true;
 }
 
 bool RANSACPlane::onStop() {
+	// Frames of a bounded queue are not processed after the task starts over.
+	input_pcl.clear();
+	input_xyz.clear();
 	return true;
 }
 
@@ -63,94 +112,102 @@ bool RANSACPlane::onStart() {
 	return true;
 }
 
-void RANSACPlane::ransac() {
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_pcl.read();
-
-	pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-	pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-	// Create the segmentation object
-	pcl::SACSegmentation<pcl::PointXYZRGB> seg;
-	// Optional
-	seg.setOptimizeCoefficients(true);
-	// Mandatory
-	seg.setModelType(pcl::SACMODEL_PLANE);
-	seg.setMethodType(pcl::SAC_RANSAC);
-	seg.setDistanceThreshold(0.01);
-
-	seg.setInputCloud(cloud);
-	seg.segment(*inliers, *coefficients);
-
-	if (inliers->indices.size() == 0) {
-		CLOG(LERROR) << "Could not estimate a planar model for the given dataset.";
+int RANSACPlane::methodType() {
+	std::string name = method;
+	if (name == "PROSAC")
+		return pcl::SAC_PROSAC;
+	if (name == "LMEDS")
+		return pcl::SAC_LMEDS;
+	if (name == "MSAC")
+		return pcl::SAC_MSAC;
+	if (name == "RRANSAC")
+		return pcl::SAC_RRANSAC;
+	if (name == "RMSAC")
+		return pcl::SAC_RMSAC;
+	if (name == "MLESAC")
+		return pcl::SAC_MLESAC;
+	if (name != "RANSAC")
+		CLOG(LWARNING) << "Unknown method " << name << ", using RANSAC";
+	return pcl::SAC_RANSAC;
+}
+
+template <typename PointT>
+bool RANSACPlane::segment(const typename pcl::PointCloud<PointT>::ConstPtr & cloud, Types::PlaneExtractor<PointT> & extractor,
+		boost::shared_ptr<std::vector<pcl::PointIndices> > & plane_indices, pcl::PointIndices::Ptr & inliers, pcl::PointIndices::Ptr & outliers) {
+	extractor.setDistanceThreshold(distance);
+	extractor.setMethodType(methodType());
+	extractor.setMaxIterations(max_iterations);
+	extractor.setMinInliers(min_inliers);
+	extractor.setWarmStart(warm_start, warm_start_ratio, warm_start_samples);
+	extractor.setSceneUnchanged(!in_changed.empty() && !in_changed.read());
+
+	std::vector<typename Types::PlaneExtractor<PointT>::Plane> found;
+	plane_indices.reset(new std::vector<pcl::PointIndices>);
+	inliers.reset(new pcl::PointIndices);
+	outliers.reset(new pcl::PointIndices);
+	inliers->header = outliers->header = cloud->header;
+
+	extractor.extract(cloud, planes, found, outliers->indices);
+
+	std::vector< std::vector<float> > models;
+	plane_indices->resize(found.size());
+	for (size_t i = 0; i < found.size(); ++i) {
+		const Eigen::VectorXf & c = found[i].coefficients;
+		CLOG(LINFO) << "Model " << i << " coefficients: " << c[0] << " " << c[1] << " " << c[2] << " " << c[3]
+				<< (found[i].warm ? " (previous frame)" : "");
+		CLOG(LINFO) << "Model " << i << " inliers: " << found[i].inliers.size();
+		models.push_back(std::vector<float>(c.data(), c.data() + 4));
+
+		(*plane_indices)[i].header = cloud->header;
+		(*plane_indices)[i].indices.swap(found[i].inliers);
+		inliers->indices.insert(inliers->indices.end(), (*plane_indices)[i].indices.begin(), (*plane_indices)[i].indices.end());
 	}
 
-	CLOG(LINFO) << "Model coefficients: " << coefficients->values[0] << " "
-			<< coefficients->values[1] << " " << coefficients->values[2] << " "
-			<< coefficients->values[3];
+	out_inliers_indices.write(inliers);
+	out_outliers_indices.write(outliers);
 
-	CLOG(LINFO) << "Model inliers: " << inliers->indices.size();
+	if (found.empty()) {
+		CLOG(LERROR) << "Could not estimate a planar model for the given dataset.";
+		return false;
+	}
+
+	out_model.write(models[0]);
+	out_models.write(models);
+	return true;
+}
 
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_inliers(new pcl::PointCloud<pcl::PointXYZRGB>());
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_outliers(new pcl::PointCloud<pcl::PointXYZRGB>());
+void RANSACPlane::ransac() {
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
+	if (!input_pcl.read(in_pcl, cloud))
+		return;
 
-	pcl::ExtractIndices<pcl::PointXYZRGB> extract;
-	extract.setInputCloud(cloud);
-	extract.setIndices(inliers);
-	extract.setNegative(false);
+	boost::shared_ptr<std::vector<pcl::PointIndices> > plane_indices;
+	pcl::PointIndices::Ptr inliers, outliers;
+	segment<pcl::PointXYZRGB>(cloud, extractor_xyzrgb, plane_indices, inliers, outliers);
 
-	extract.filter(*cloud_inliers);
+	out_planes.write(Types::CloudView<pcl::PointXYZRGB>::split(cloud, plane_indices));
 
-	// Remove the planar inliers, extract the rest
-	extract.setNegative(true);
-	extract.filter(*cloud_outliers);
+	if (publish_clouds) {
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_inliers = Types::CloudPool<pcl::PointXYZRGB>::acquire(inliers->indices.size());
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_outliers = Types::CloudPool<pcl::PointXYZRGB>::acquire(outliers->indices.size());
+		pcl::copyPointCloud(*cloud, inliers->indices, *cloud_inliers);
+		pcl::copyPointCloud(*cloud, outliers->indices, *cloud_outliers);
 
-	std::vector<float> model;
-	model.push_back(coefficients->values[0]);
-	model.push_back(coefficients->values[1]);
-	model.push_back(coefficients->values[2]);
-	model.push_back(coefficients->values[3]);
-	out_model.write(model);
-	
-	out_outliers.write(cloud_outliers);
-	out_inliers.write(cloud_inliers);
+		out_outliers.write(cloud_outliers);
+		out_inliers.write(cloud_inliers);
+	}
 }
 
 void RANSACPlane::ransacxyz() {
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_xyz.read();
-
-	CLOG(LINFO) << "Input cloud: " << cloud->size();
-
-	pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-	pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-	// Create the segmentation object
-	pcl::SACSegmentation<pcl::PointXYZ> seg;
-	// Optional
-	seg.setOptimizeCoefficients(true);
-	// Mandatory
-	seg.setModelType(pcl::SACMODEL_PLANE);
-	seg.setMethodType(pcl::SAC_RANSAC);
-	seg.setDistanceThreshold(distance);
-
-	seg.setInputCloud(cloud);
-	seg.segment(*inliers, *coefficients);
-
-	if (inliers->indices.size() == 0) {
-		CLOG(LERROR) << "Could not estimate a planar model for the given dataset.";
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+	if (!input_xyz.read(in_xyz, cloud))
 		return;
-	}
 
-	CLOG(LINFO) << "Model coefficients: " << coefficients->values[0] << " "
-			<< coefficients->values[1] << " " << coefficients->values[2] << " "
-			<< coefficients->values[3];
-
-	CLOG(LINFO) << "Model inliers: " << inliers->indices.size();
+	CLOG(LINFO) << "Input cloud: " << cloud->size();
 
-	std::vector<float> model;
-	model.push_back(coefficients->values[0]);
-	model.push_back(coefficients->values[1]);
-	model.push_back(coefficients->values[2]);
-	model.push_back(coefficients->values[3]);
-	out_model.write(model);
+	boost::shared_ptr<std::vector<pcl::PointIndices> > plane_indices;
+	pcl::PointIndices::Ptr inliers, outliers;
+	segment<pcl::PointXYZ>(cloud, extractor_xyz, plane_indices, inliers, outliers);
 }
 
 } //: namespace RANSACPlane
@@ -13,6 +13,9 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+#include "Types/InputPolicy.hpp"
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl/sample_consensus/method_types.h>
@@ -26,6 +29,8 @@
 #include <pcl/features/normal_3d.h>
 #include <pcl/kdtree/kdtree.h>
 
+#include "Types/PlaneExtractor.hpp"
+#include "Types/CloudView.hpp"
 
 namespace Processors {
 namespace RANSACPlane {
@@ -34,7 +39,9 @@ namespace RANSACPlane {
  * \class RANSACPlane
  * \brief RANSACPlane processor class.
  *
- * RANSACPlane processor.
+ * RANSACPlane processor. Inputs are read through Types::InputPolicy - frames
+ * waiting while segmentation falls behind can be dropped (input.policy
+ * newest by default, deadline or queue bounded by input.queue).
  */
 class RANSACPlane: public Base::Component {
 public:
@@ -79,8 +86,16 @@ protected:
 
 
 	// Input data streams
-	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr > in_pcl;
-	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr > in_xyz;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Queue> in_pcl;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_xyz;
+
+	/*!
+	 * Optional flag of ChangeDetection: with warm start, planes of an
+	 * unchanged scene are reused without verification and refinement.
+	 * Connect clouds through ChangeDetection (refresh 1), so that the flag
+	 * always precedes its cloud.
+	 */
+	Base::DataStreamIn<bool, Base::DataStreamBuffer::Newest> in_changed;
 
 	// Output data streams
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_outliers;
@@ -88,6 +103,16 @@ protected:
 	
 	Base::DataStreamOut< std::vector<float> > out_model;
 
+	/// Coefficients of all found planes, first one is also published on out_model.
+	Base::DataStreamOut< std::vector< std::vector<float> > > out_models;
+
+	/// Inliers of every found plane, as views of the input cloud.
+	Base::DataStreamOut< std::vector< Types::CloudView<pcl::PointXYZRGB> > > out_planes;
+
+	/// Indices of inliers of all planes and of the remaining points, published always.
+	Base::DataStreamOut<pcl::PointIndices::Ptr> out_inliers_indices;
+	Base::DataStreamOut<pcl::PointIndices::Ptr> out_outliers_indices;
+
 	// Handlers
 	Base::EventHandler2 h_ransac;
 	Base::EventHandler2 h_ransac_xyz;
@@ -96,8 +121,67 @@ protected:
 	void ransac();
 	void ransacxyz();
 
+	/*!
+	 * Extracts planes, publishes their models and indices of inliers and outliers.
+	 * \returns false if no plane was found.
+	 */
+	template <typename PointT>
+	bool segment(const typename pcl::PointCloud<PointT>::ConstPtr & cloud, Types::PlaneExtractor<PointT> & extractor,
+			boost::shared_ptr<std::vector<pcl::PointIndices> > & plane_indices, pcl::PointIndices::Ptr & inliers, pcl::PointIndices::Ptr & outliers);
+
+	/// Maps name of the method to pcl::SAC_* constant.
+	int methodType();
+
 	Base::Property<float> distance;
 
+	/// Sample consensus method: RANSAC (parallel), PROSAC, LMEDS, MSAC, RRANSAC, RMSAC or MLESAC.
+	Base::Property<std::string> method;
+
+	Base::Property<int> max_iterations;
+
+	/// Number of planes extracted one after another.
+	Base::Property<int> planes;
+
+	/// Planes smaller than that are not accepted.
+	Base::Property<int> min_inliers;
+
+	/// Verify planes of the previous frame before running full search.
+	Base::Property<bool> warm_start;
+
+	/// Previous plane is kept if its inlier ratio is at least that part of the ratio it had.
+	Base::Property<float> warm_start_ratio;
+
+	/// Number of points the previous plane is verified on.
+	Base::Property<int> warm_start_samples;
+
+	/// Publish inliers and outliers also as clouds (copies of the input points).
+	Base::Property<bool> publish_clouds;
+
+	Types::PlaneExtractor<pcl::PointXYZRGB> extractor_xyzrgb;
+	Types::PlaneExtractor<pcl::PointXYZ> extractor_xyz;
+
+	/// Property: frames taken from inputs - newest (the latest waiting frame), queue or deadline.
+	Base::Property<std::string> input_policy;
+
+	/// Property: frames waiting in a queue, older ones are dropped, 0 - unbounded.
+	Base::Property<int> input_queue;
+
+	/// Property: age since capture (ms) of frames dropped with the deadline policy.
+	Base::Property<float> input_deadline;
+
+	// Policies of inputs.
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> input_pcl;
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZ>::Ptr> input_xyz;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace RANSACPlane
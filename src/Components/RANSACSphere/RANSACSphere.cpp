@@ -12,12 +12,31 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+
+#include <pcl/common/io.h>
+
 namespace Processors {
 namespace RANSACSphere {
 
 RANSACSphere::RANSACSphere(const std::string & name) :
-		Base::Component(name)  {
-
+		Base::Component(name),
+		distance("distance", 0.01),
+		publish_clouds("publish_clouds", true),
+		input_policy("input.policy", std::string("newest")),
+		input_queue("input.queue", 0),
+		input_deadline("input.deadline", 100),
+		input_pcl(name + ".in_pcl"),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(distance);
+	registerProperty(publish_clouds);
+	registerProperty(input_policy);
+	registerProperty(input_queue);
+	registerProperty(input_deadline);
+	registerProperty(profile);
+	registerProperty(profile_period);
 }
 
 RANSACSphere::~RANSACSphere() {
@@ -28,23 +47,35 @@ void RANSACSphere::prepareInterface() {
 	registerStream("in_pcl", &in_pcl);
 	registerStream("out_outliers", &out_outliers);
 	registerStream("out_inliers", &out_inliers);
+	registerStream("out_inliers_indices", &out_inliers_indices);
+	registerStream("out_outliers_indices", &out_outliers_indices);
+	registerStream("out_model", &out_model);
 	// Register handlers
-	h_ransac.setup(boost::bind(&RANSACSphere::ransac, this));
+	h_ransac.setup(profiler.wrap("ransac", boost::bind(&RANSACSphere::ransac, this)));
 	registerHandler("ransac", &h_ransac);
 	addDependency("ransac", &in_pcl);
 
 }
 
 bool RANSACSphere::onInit() {
+	profiler.setEnabled(profile, profile_period);
+
+	if (!input_pcl.configure(input_policy, input_queue, input_deadline))
+		CLOG(LWARNING) << "Unknown input policy " << input_policy << ", using newest";
+	input_pcl.setReporting(profile, profile_period);
 
 	return true;
 }
 
 bool RANSACSphere::onFinish() {
+	profiler.report();
+	input_pcl.report();
 	return true;
 }
 
 bool RANSACSphere::onStop() {
+	// Frames of a bounded queue are not processed after the task starts over.
+	input_pcl.clear();
 	return true;
 }
 
@@ -53,63 +84,59 @@ bool RANSACSphere::onStart() {
 }
 
 void RANSACSphere::ransac() {
-
-	pcl::PointCloud<pcl::PointXYZ> cloud = in_pcl.read();
-	
-  pcl::ModelCoefficients::Ptr coefficients (new pcl::ModelCoefficients);
-  pcl::PointIndices::Ptr inliers (new pcl::PointIndices);
-  // Create the segmentation object
-  pcl::SACSegmentation<pcl::PointXYZ> seg;
-  // Optional
-  seg.setOptimizeCoefficients (true);
-  // Mandatory
-  seg.setModelType (pcl::SACMODEL_SPHERE);
-  seg.setMethodType (pcl::SAC_RANSAC);
-  seg.setDistanceThreshold (0.01);
-
-  seg.setInputCloud (cloud.makeShared ());
-  seg.segment (*inliers, *coefficients);
-
-  if (inliers->indices.size () == 0)
-  {
-    //PCL_ERROR ("Could not estimate a planar model for the given dataset.");
-    cout<<"Could not estimate a planar model for the given dataset."<<endl;
-  }
-//info
-  std::cout << "Model coefficients: " << coefficients->values[0] << " " 
-                                      << coefficients->values[1] << " "
-                                      << coefficients->values[2] << " " 
-                                      << coefficients->values[3] << std::endl;
-
-  std::cout << "Model inliers: " << inliers->indices.size () << std::endl;
-  for (size_t i = 0; i < inliers->indices.size (); ++i)
-    std::cout << inliers->indices[i] << "    " << cloud.points[inliers->indices[i]].x << " "
-                                               << cloud.points[inliers->indices[i]].y << " "
-                                               << cloud.points[inliers->indices[i]].z << std::endl;	
-//////////////////////////
-
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_inliers (new pcl::PointCloud<pcl::PointXYZ> ());
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_outliers (new pcl::PointCloud<pcl::PointXYZ> ());
-
-    pcl::ExtractIndices<pcl::PointXYZ> extract;
-    extract.setInputCloud (cloud.makeShared());
-    extract.setIndices (inliers);
-    extract.setNegative (false);
-
-    extract.filter (*cloud_inliers);
-    //std::cout << "PointCloud representing the planar component: " << cloud_inliers->points.size () << " data points." << std::endl;
-
-    // Remove the planar inliers, extract the rest
-    extract.setNegative (true);
-    extract.filter (*cloud_outliers);
-    //*cloud_filtered = *cloud_f;
-
-
-
-out_outliers.write(cloud_outliers);
-out_inliers.write(cloud_inliers);	
-	
-	
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+	if (!input_pcl.read(in_pcl, cloud))
+		return;
+
+	pcl::ModelCoefficients::Ptr coefficients (new pcl::ModelCoefficients);
+	pcl::PointIndices::Ptr inliers (new pcl::PointIndices);
+	// Create the segmentation object
+	pcl::SACSegmentation<pcl::PointXYZ> seg;
+	// Optional
+	seg.setOptimizeCoefficients (true);
+	// Mandatory
+	seg.setModelType (pcl::SACMODEL_SPHERE);
+	seg.setMethodType (pcl::SAC_RANSAC);
+	seg.setDistanceThreshold (distance);
+
+	seg.setInputCloud (cloud);
+	seg.segment (*inliers, *coefficients);
+
+	if (inliers->indices.size () == 0 || coefficients->values.size () != 4) {
+		CLOG(LERROR) << "Could not estimate a spherical model for the given dataset.";
+		return;
+	}
+
+	CLOG(LINFO) << "Model coefficients: " << coefficients->values[0] << " "
+			<< coefficients->values[1] << " " << coefficients->values[2] << " "
+			<< coefficients->values[3];
+	CLOG(LINFO) << "Model inliers: " << inliers->indices.size ();
+	profiler.points(cloud->size(), inliers->indices.size());
+
+	// Inliers are sorted, outliers are the rest of the input points
+	pcl::PointIndices::Ptr outliers (new pcl::PointIndices);
+	outliers->header = cloud->header;
+	outliers->indices.reserve (cloud->size () - inliers->indices.size ());
+	for (size_t i = 0, k = 0; i < cloud->size (); ++i) {
+		if (k < inliers->indices.size () && inliers->indices[k] == (int) i)
+			++k;
+		else
+			outliers->indices.push_back (i);
+	}
+
+	out_model.write(coefficients->values);
+	out_inliers_indices.write(inliers);
+	out_outliers_indices.write(outliers);
+
+	if (publish_clouds) {
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_inliers = Types::CloudPool<pcl::PointXYZ>::acquire(inliers->indices.size ());
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_outliers = Types::CloudPool<pcl::PointXYZ>::acquire(outliers->indices.size ());
+		pcl::copyPointCloud (*cloud, inliers->indices, *cloud_inliers);
+		pcl::copyPointCloud (*cloud, outliers->indices, *cloud_outliers);
+
+		out_outliers.write(cloud_outliers);
+		out_inliers.write(cloud_inliers);
+	}
 }
 
 
@@ -13,6 +13,9 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+#include "Types/InputPolicy.hpp"
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl/sample_consensus/method_types.h>
@@ -33,7 +36,9 @@ namespace RANSACSphere {
  * \class RANSACSphere
  * \brief RANSACSphere processor class.
  *
- * RANSACSphere processor.
+ * RANSACSphere processor. Inputs are read through Types::InputPolicy - frames
+ * waiting while segmentation falls behind can be dropped (input.policy
+ * newest by default, deadline or queue bounded by input.queue).
  */
 class RANSACSphere: public Base::Component {
 public:
@@ -79,12 +84,19 @@ protected:
 
 // Input data streams
 
-		Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ> > in_pcl;
+		Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_pcl;
 
 // Output data streams
 
 		Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_outliers;
 		Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_inliers;
+
+		/// Indices of inliers and outliers in the input cloud, published always.
+		Base::DataStreamOut<pcl::PointIndices::Ptr> out_inliers_indices;
+		Base::DataStreamOut<pcl::PointIndices::Ptr> out_outliers_indices;
+
+		/// Sphere coefficients: center x, y, z and radius.
+		Base::DataStreamOut<std::vector<float> > out_model;
 	// Handlers
 	Base::EventHandler2 h_ransac;
 
@@ -92,6 +104,32 @@ protected:
 	// Handlers
 	void ransac();
 
+	Base::Property<float> distance;
+
+	/// Publish inliers and outliers also as clouds (copies of the input points).
+	Base::Property<bool> publish_clouds;
+
+	/// Property: frames taken from inputs - newest (the latest waiting frame), queue or deadline.
+	Base::Property<std::string> input_policy;
+
+	/// Property: frames waiting in a queue, older ones are dropped, 0 - unbounded.
+	Base::Property<int> input_queue;
+
+	/// Property: age since capture (ms) of frames dropped with the deadline policy.
+	Base::Property<float> input_deadline;
+
+	// Policies of inputs.
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZ>::Ptr> input_pcl;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace RANSACSphere
@@ -6,15 +6,20 @@
 
 #include <memory>
 #include <string>
+#include <limits>
 
 #include "SHOT.hpp"
 #include "Common/Logger.hpp"
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/ThreadPool.hpp"
+
 
 #include <pcl/correspondence.h>
 #include <pcl/features/normal_3d_omp.h>
+#include <pcl/features/integral_image_normal.h>
 #include <pcl/features/shot_omp.h>
 #include <pcl/features/board.h>
 #include <pcl/keypoints/uniform_sampling.h>
@@ -37,8 +42,34 @@ namespace Processors {
 namespace SHOT {
 
 SHOT::SHOT(const std::string & name) :
-		Base::Component(name)  {
-
+		Base::Component(name),
+		threads("threads", 0),
+		normal_radius("normal_radius", 0.1),
+		keypoint_radius("keypoint_radius", 0.01),
+		descriptor_radius("descriptor_radius", 0.02),
+		integral_normals("integral_normals", false),
+		max_depth_change("max_depth_change", 0.02),
+		normal_smoothing("normal_smoothing", 10.0),
+		input_policy("input.policy", std::string("newest")),
+		input_queue("input.queue", 0),
+		input_deadline("input.deadline", 100),
+		input_pcl(name + ".in_pcl"),
+		input_indexed_xyz(name + ".in_indexed_xyz"),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(threads);
+	registerProperty(normal_radius);
+	registerProperty(keypoint_radius);
+	registerProperty(descriptor_radius);
+	registerProperty(integral_normals);
+	registerProperty(max_depth_change);
+	registerProperty(normal_smoothing);
+	registerProperty(input_policy);
+	registerProperty(input_queue);
+	registerProperty(input_deadline);
+	registerProperty(profile);
+	registerProperty(profile_period);
 }
 
 SHOT::~SHOT() {
@@ -47,24 +78,43 @@ SHOT::~SHOT() {
 void SHOT::prepareInterface() {
 	// Register data streams, events and event handlers HERE!
 registerStream("in_pcl", &in_pcl);
+registerStream("in_indexed_xyz", &in_indexed_xyz);
 registerStream("out_keypoints", &out_keypoints);
+registerStream("out_descriptors", &out_descriptors);
 	// Register handlers
-	h_shot.setup(boost::bind(&SHOT::shot, this));
+	h_shot.setup(profiler.wrap("shot", boost::bind(&SHOT::shot, this)));
 	registerHandler("shot", &h_shot);
 	addDependency("shot", &in_pcl);
 
+	h_shot_indexed.setup(profiler.wrap("shot_indexed", boost::bind(&SHOT::shot_indexed, this)));
+	registerHandler("shot_indexed", &h_shot_indexed);
+	addDependency("shot_indexed", &in_indexed_xyz);
+
 }
 
 bool SHOT::onInit() {
+	profiler.setEnabled(profile, profile_period);
+
+	if (!input_pcl.configure(input_policy, input_queue, input_deadline))
+		CLOG(LWARNING) << "Unknown input policy " << input_policy << ", using newest";
+	input_indexed_xyz.configure(input_policy, input_queue, input_deadline);
+	input_pcl.setReporting(profile, profile_period);
+	input_indexed_xyz.setReporting(profile, profile_period);
 
 	return true;
 }
 
 bool SHOT::onFinish() {
+	profiler.report();
+	input_pcl.report();
+	input_indexed_xyz.report();
 	return true;
 }
 
 bool SHOT::onStop() {
+	// Frames of a bounded queue are not processed after the task starts over.
+	input_pcl.clear();
+	input_indexed_xyz.clear();
 	return true;
 }
 
@@ -73,48 +123,116 @@ bool SHOT::onStart() {
 }
 
 void SHOT::shot() {
-  pcl::PointCloud<PointType>::Ptr cloud = in_pcl.read();
-  pcl::PointCloud<NormalType>::Ptr normals (new pcl::PointCloud<NormalType> ());
-  pcl::PointCloud<PointType>::Ptr keypoints (new pcl::PointCloud<PointType> ());
-  pcl::PointCloud<DescriptorType>::Ptr descriptors (new pcl::PointCloud<DescriptorType> ());
-  cout<<"dupa 1"<<endl;
-  float model_ss_ = 0.01f;
-  float descr_rad_ = 0.02f;
-  cout<<"dupa 2"<<endl;
-  //normals
-  pcl::NormalEstimation<PointType, NormalType> norm_est;
-  cout<<"dupa 2.1"<<endl;
-  norm_est.setKSearch (0);
-  cout<<"dupa 2.2"<<endl;
-  norm_est.setRadiusSearch (0.1);
-  cout<<"dupa 2.3"<<endl;
+  pcl::PointCloud<PointType>::Ptr cloud;
+  if (!input_pcl.read(in_pcl, cloud))
+    return;
+  compute(*Types::IndexedCloud<PointType>::create(cloud));
+}
+
+void SHOT::shot_indexed() {
+  Types::IndexedCloud<PointType>::Ptr input;
+  if (!input_indexed_xyz.read(in_indexed_xyz, input))
+    return;
+  compute(*input);
+}
+
+unsigned int SHOT::teamSize() {
+  return threads > 0 ? threads : Types::ThreadPool::instance().threads();
+}
+
+pcl::PointCloud<NormalType>::Ptr SHOT::computeNormals(const Types::IndexedCloud<PointType> & input, const pcl::PointCloud<PointType> & keypoints) {
+  pcl::PointCloud<PointType>::ConstPtr cloud = input.cloud();
+  pcl::PointCloud<NormalType>::Ptr normals = Types::CloudPool<NormalType>::acquire(cloud->size());
+
+  // Organized input - normals of the whole image at once, from integral images
+  if (integral_normals && cloud->isOrganized()) {
+    pcl::IntegralImageNormalEstimation<PointType, NormalType> ne;
+    ne.setNormalEstimationMethod (ne.AVERAGE_3D_GRADIENT);
+    ne.setMaxDepthChangeFactor (max_depth_change);
+    ne.setNormalSmoothingSize (normal_smoothing);
+    ne.setInputCloud (cloud);
+    ne.compute (*normals);
+    return normals;
+  }
+
+  // Descriptors read normals of the surface points within their radius only
+  Types::IndexedCloud<PointType>::SearchPtr search = input.search();
+  std::vector<char> needed(cloud->size(), 0);
+  std::vector<int> nn_indices;
+  std::vector<float> nn_dists;
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    if (!pcl_isfinite (keypoints.points[i].x))
+      continue;
+    search->radiusSearch (keypoints.points[i], descriptor_radius, nn_indices, nn_dists);
+    for (size_t k = 0; k < nn_indices.size(); ++k)
+      needed[nn_indices[k]] = 1;
+  }
+  pcl::IndicesPtr indices (new std::vector<int>);
+  for (size_t i = 0; i < needed.size(); ++i)
+    if (needed[i])
+      indices->push_back(i);
+
+  pcl::PointCloud<NormalType> sparse;
+  pcl::NormalEstimationOMP<PointType, NormalType> norm_est (teamSize());
+  norm_est.setRadiusSearch (normal_radius);
   norm_est.setInputCloud (cloud);
-  cout<<"dupa 2.4"<<endl;
-  norm_est.compute (*normals);
-cout<<"dupa 3"<<endl;
+  norm_est.setIndices (indices);
+  norm_est.setSearchMethod (search);
+  norm_est.compute (sparse);
+
+  // Scatter to normals aligned with the cloud
+  NormalType invalid;
+  invalid.normal_x = invalid.normal_y = invalid.normal_z = invalid.curvature = std::numeric_limits<float>::quiet_NaN();
+  normals->points.assign(cloud->size(), invalid);
+  for (size_t i = 0; i < indices->size(); ++i)
+    normals->points[(*indices)[i]] = sparse.points[i];
+  normals->header = cloud->header;
+  normals->width = cloud->width;
+  normals->height = cloud->height;
+  normals->is_dense = false;
+
+  CLOG(LDEBUG) << "Normals estimated for " << indices->size() << " of " << cloud->size() << " points";
+  return normals;
+}
 
-  //indeces
+void SHOT::compute(const Types::IndexedCloud<PointType> & input) {
+  pcl::PointCloud<PointType>::ConstPtr cloud = input.cloud();
+  pcl::PointCloud<PointType>::Ptr keypoints = Types::CloudPool<PointType>::acquire();
+  pcl::PointCloud<DescriptorType>::Ptr descriptors = Types::CloudPool<DescriptorType>::acquire();
+
+  // Keypoints
   pcl::PointCloud<int> sampled_indices;
   pcl::UniformSampling<PointType> uniform_sampling;
   uniform_sampling.setInputCloud (cloud);
-  uniform_sampling.setRadiusSearch (model_ss_);
+  uniform_sampling.setRadiusSearch (keypoint_radius);
   uniform_sampling.compute (sampled_indices);
   pcl::copyPointCloud (*cloud, sampled_indices.points, *keypoints);
-  std::cout << "Model total points: " << cloud->size () << "; Selected Keypoints: " << keypoints->size () << std::endl;
-cout<<"dupa 4"<<endl;
+  CLOG(LINFO) << "Model total points: " << cloud->size () << "; Selected Keypoints: " << keypoints->size ();
+
+  if (keypoints->empty ()) {
+    descriptors->header = cloud->header;
+    out_keypoints.write(keypoints);
+    out_descriptors.write(descriptors);
+    return;
+  }
+
+  // Normals
+  pcl::PointCloud<NormalType>::Ptr normals = computeNormals (input, *keypoints);
 
-  //SHOT
-  pcl::SHOTEstimationOMP<PointType, NormalType, DescriptorType> descr_est;
-  descr_est.setRadiusSearch (descr_rad_);
-cout<<"dupa 5"<<endl;
+  // SHOT
+  pcl::SHOTEstimationOMP<PointType, NormalType, DescriptorType> descr_est (teamSize());
+  descr_est.setRadiusSearch (descriptor_radius);
   descr_est.setInputCloud (keypoints);
   descr_est.setInputNormals (normals);
   descr_est.setSearchSurface (cloud);
+  // Index is already built over the search surface, so it is not rebuilt
+  descr_est.setSearchMethod (input.search());
   descr_est.compute (*descriptors);
-  
-  //out_keypoints.write(keypoints);
-cout<<"dupa 6"<<endl;
+  CLOG(LINFO) << "Descriptors: " << descriptors->size ();
+  profiler.points(cloud->size(), descriptors->size());
 
+  out_keypoints.write(keypoints);
+  out_descriptors.write(descriptors);
 }
 
 
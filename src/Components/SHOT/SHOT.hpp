@@ -13,9 +13,14 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+#include "Types/InputPolicy.hpp"
+
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
 
+#include "Types/IndexedCloud.hpp"
+
 namespace Processors {
 namespace SHOT {
 
@@ -23,7 +28,9 @@ namespace SHOT {
  * \class SHOT
  * \brief SHOT processor class.
  *
- * SHOT processor.
+ * SHOT processor. Descriptors are slow to compute, so inputs are read
+ * through Types::InputPolicy - frames waiting while it falls behind can be
+ * dropped (input.policy newest by default, deadline or queue bounded by input.queue).
  */
 class SHOT: public Base::Component {
 public:
@@ -71,19 +78,68 @@ protected:
 
 // Input data streams
 
-		Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_pcl;
+		Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_pcl;
+		Base::DataStreamIn<Types::IndexedCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_indexed_xyz;
 
 // Output data streams
 
 		Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_keypoints;
-		
+		Base::DataStreamOut<pcl::PointCloud<pcl::SHOT352>::Ptr> out_descriptors;
+
+	/// Number of threads of normal and descriptor estimation, 0 - size of the shared pool (DCL_THREADS).
+	Base::Property<int> threads;
+
+	Base::Property<float> normal_radius;
+	Base::Property<float> keypoint_radius;
+	Base::Property<float> descriptor_radius;
+
+	/// Use integral image normals for organized clouds (computed for the whole image).
+	Base::Property<bool> integral_normals;
+	Base::Property<float> max_depth_change;
+	Base::Property<float> normal_smoothing;
+
+	/*!
+	 * Estimates normals of the points within descriptor radius of the keypoints,
+	 * other normals are NaN.
+	 */
+	/// Size of the OpenMP team of PCL estimators.
+	unsigned int teamSize();
+
+	pcl::PointCloud<pcl::Normal>::Ptr computeNormals(const Types::IndexedCloud<pcl::PointXYZ> & input, const pcl::PointCloud<pcl::PointXYZ> & keypoints);
 
 	// Handlers
 	Base::EventHandler2 h_shot;
+	Base::EventHandler2 h_shot_indexed;
 
 	
 	// Handlers
 	void shot();
+	void shot_indexed();
+
+	/// Computes descriptors, normals and descriptors share search index of the cloud.
+	void compute(const Types::IndexedCloud<pcl::PointXYZ> & input);
+
+	/// Property: frames taken from inputs - newest (the latest waiting frame), queue or deadline.
+	Base::Property<std::string> input_policy;
+
+	/// Property: frames waiting in a queue, older ones are dropped, 0 - unbounded.
+	Base::Property<int> input_queue;
+
+	/// Property: age since capture (ms) of frames dropped with the deadline policy.
+	Base::Property<float> input_deadline;
+
+	// Policies of inputs.
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZ>::Ptr> input_pcl;
+	Types::InputPolicy<Types::IndexedCloud<pcl::PointXYZ>::Ptr> input_indexed_xyz;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
@@ -0,0 +1,121 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#include <memory>
+#include <string>
+
+#include "SharedCloudReader.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+#include "Types/CloudPool.hpp"
+
+namespace Processors {
+namespace SharedCloudReader {
+
+SharedCloudReader::SharedCloudReader(const std::string & name) :
+		Base::Component(name),
+		prop_name("name", std::string("/discode_clouds")),
+		retry("retry", 1),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(prop_name);
+	registerProperty(retry);
+	registerProperty(profile);
+	registerProperty(profile_period);
+}
+
+SharedCloudReader::~SharedCloudReader() {
+}
+
+void SharedCloudReader::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
+	registerStream("out_cloud_xyzsift", &out_cloud_xyzsift);
+
+	// Register handlers
+	h_Read.setup(profiler.wrap("Read", boost::bind(&SharedCloudReader::Read, this)));
+	registerHandler("Read", &h_Read);
+}
+
+bool SharedCloudReader::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	return true;
+}
+
+bool SharedCloudReader::onFinish() {
+	profiler.report();
+	onStop();
+	return true;
+}
+
+bool SharedCloudReader::onStop() {
+	ring_xyz.close();
+	ring_xyzrgb.close();
+	ring_xyzsift.close();
+	return true;
+}
+
+bool SharedCloudReader::onStart() {
+	next_attempt = boost::posix_time::ptime();
+	return true;
+}
+
+void SharedCloudReader::Read() {
+	CLOG(LTRACE) << "SharedCloudReader::Read";
+
+	// Rings not created yet are looked for only every retry seconds.
+	const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	const bool attempt = next_attempt.is_not_a_date_time() || now >= next_attempt;
+	if (attempt)
+		next_attempt = now + boost::posix_time::microseconds((int64_t) (retry * 1e6));
+
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_xyz = take(ring_xyz, "xyz", attempt);
+	if (cloud_xyz)
+		out_cloud_xyz.write(cloud_xyz);
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_xyzrgb = take(ring_xyzrgb, "xyzrgb", attempt);
+	if (cloud_xyzrgb)
+		out_cloud_xyzrgb.write(cloud_xyzrgb);
+	pcl::PointCloud<PointXYZSIFT>::Ptr cloud_xyzsift = take(ring_xyzsift, "xyzsift", attempt);
+	if (cloud_xyzsift)
+		out_cloud_xyzsift.write(cloud_xyzsift);
+}
+
+template <typename PointT>
+typename pcl::PointCloud<PointT>::Ptr SharedCloudReader::take(Types::SharedCloudRing<PointT> & ring, const std::string & type, bool attempt) {
+	if (ring.isOpen() && ring.closed()) {
+		CLOG(LINFO) << "Ring " << ring.name() << " was closed by the writer";
+		ring.close();
+	}
+	if (!ring.isOpen()) {
+		if (!attempt)
+			return typename pcl::PointCloud<PointT>::Ptr();
+		std::string name = prop_name;
+		if (name.empty() || name[0] != '/')
+			name = "/" + name;
+		name += "_" + type;
+		if (!ring.open(name))
+			return typename pcl::PointCloud<PointT>::Ptr();
+		CLOG(LINFO) << "Opened ring " << name << " of " << ring.slots() << " x " << ring.capacity() << " " << type << " points";
+	}
+	if (!ring.fresh())
+		return typename pcl::PointCloud<PointT>::Ptr();
+
+	// Slot is held only while copied, the writer may reuse it right after.
+	typename Types::SharedCloudRing<PointT>::View view = ring.latest();
+	if (!view)
+		return typename pcl::PointCloud<PointT>::Ptr();
+	typename pcl::PointCloud<PointT>::Ptr cloud = Types::CloudPool<PointT>::acquire(view.size());
+	view.copyTo(*cloud);
+	profiler.points(view.size(), cloud->size());
+	return cloud;
+}
+
+} //: namespace SharedCloudReader
+} //: namespace Processors
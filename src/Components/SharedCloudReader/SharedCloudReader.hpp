@@ -0,0 +1,130 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#ifndef SHAREDCLOUDREADER_HPP_
+#define SHAREDCLOUDREADER_HPP_
+
+#include "Component_Aux.hpp"
+#include "Component.hpp"
+#include "DataStream.hpp"
+#include "Property.hpp"
+#include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Types/PointXYZSIFT.hpp>
+
+#include "Types/SharedCloudRing.hpp"
+
+namespace Processors {
+namespace SharedCloudReader {
+
+/*!
+ * \class SharedCloudReader
+ * \brief SharedCloudReader processor class.
+ *
+ * Emits clouds published by a SharedCloudWriter of another DisCODe process
+ * of the same host. Rings are mapped when the writer creates them (and
+ * mapped again when it replaces them); the newest cloud of every ring is
+ * taken at each step of the executor, clouds published in between are
+ * skipped. Components take pcl::PointCloud, so the points of the slot are
+ * copied once into a pooled cloud, without any parsing.
+ */
+class SharedCloudReader: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	SharedCloudReader(const std::string & name = "SharedCloudReader");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~SharedCloudReader();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Output data streams
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
+	Base::DataStreamOut<pcl::PointCloud<PointXYZSIFT>::Ptr> out_cloud_xyzsift;
+
+	// Handlers
+	Base::EventHandler2 h_Read;
+
+	/// Emits clouds published since the last step.
+	void Read();
+
+	/// Takes the newest cloud of the ring, opening the ring if needed. Empty pointer if there is none.
+	template <typename PointT>
+	typename pcl::PointCloud<PointT>::Ptr take(Types::SharedCloudRing<PointT> & ring, const std::string & type, bool attempt);
+
+	/// Property: prefix of names of rings, the same as of the writer.
+	Base::Property<std::string> prop_name;
+
+	/// Property: seconds between attempts to open rings not created yet.
+	Base::Property<float> retry;
+
+	// Rings of point types.
+	Types::SharedCloudRing<pcl::PointXYZ> ring_xyz;
+	Types::SharedCloudRing<pcl::PointXYZRGB> ring_xyzrgb;
+	Types::SharedCloudRing<PointXYZSIFT> ring_xyzsift;
+
+	/// Time of the next attempt to open rings.
+	boost::posix_time::ptime next_attempt;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+};
+
+} //: namespace SharedCloudReader
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("SharedCloudReader", Processors::SharedCloudReader::SharedCloudReader)
+
+#endif /* SHAREDCLOUDREADER_HPP_ */
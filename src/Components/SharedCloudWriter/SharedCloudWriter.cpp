@@ -0,0 +1,118 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#include <memory>
+#include <string>
+
+#include "SharedCloudWriter.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+namespace Processors {
+namespace SharedCloudWriter {
+
+SharedCloudWriter::SharedCloudWriter(const std::string & name) :
+		Base::Component(name),
+		prop_name("name", std::string("/discode_clouds")),
+		slots("slots", 4),
+		capacity("capacity", 640 * 480),
+		skipped(0),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(prop_name);
+	registerProperty(slots);
+	registerProperty(capacity);
+	registerProperty(profile);
+	registerProperty(profile_period);
+}
+
+SharedCloudWriter::~SharedCloudWriter() {
+}
+
+void SharedCloudWriter::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_cloud_xyz", &in_cloud_xyz);
+	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
+	registerStream("in_cloud_xyzsift", &in_cloud_xyzsift);
+	registerStream("out_skipped", &out_skipped);
+
+	// Register handlers
+	registerHandler("write_xyz", profiler.wrap("write_xyz", boost::bind(&SharedCloudWriter::write_xyz, this)));
+	addDependency("write_xyz", &in_cloud_xyz);
+	registerHandler("write_xyzrgb", profiler.wrap("write_xyzrgb", boost::bind(&SharedCloudWriter::write_xyzrgb, this)));
+	addDependency("write_xyzrgb", &in_cloud_xyzrgb);
+	registerHandler("write_xyzsift", profiler.wrap("write_xyzsift", boost::bind(&SharedCloudWriter::write_xyzsift, this)));
+	addDependency("write_xyzsift", &in_cloud_xyzsift);
+}
+
+bool SharedCloudWriter::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	return true;
+}
+
+bool SharedCloudWriter::onFinish() {
+	profiler.report();
+	onStop();
+	return true;
+}
+
+bool SharedCloudWriter::onStop() {
+	// Readers keep clouds they hold, and open the rings again when the task starts over.
+	ring_xyz.close();
+	ring_xyzrgb.close();
+	ring_xyzsift.close();
+	if (skipped > 0)
+		CLOG(LWARNING) << "Skipped " << skipped << " clouds, readers held all slots";
+	return true;
+}
+
+bool SharedCloudWriter::onStart() {
+	skipped = 0;
+	return true;
+}
+
+void SharedCloudWriter::write_xyz() {
+	CLOG(LTRACE) << "SharedCloudWriter::write_xyz";
+	write(*in_cloud_xyz.read(), ring_xyz, "xyz");
+}
+
+void SharedCloudWriter::write_xyzrgb() {
+	CLOG(LTRACE) << "SharedCloudWriter::write_xyzrgb";
+	write(*in_cloud_xyzrgb.read(), ring_xyzrgb, "xyzrgb");
+}
+
+void SharedCloudWriter::write_xyzsift() {
+	CLOG(LTRACE) << "SharedCloudWriter::write_xyzsift";
+	write(*in_cloud_xyzsift.read(), ring_xyzsift, "xyzsift");
+}
+
+template <typename PointT>
+void SharedCloudWriter::write(const pcl::PointCloud<PointT> & cloud, Types::SharedCloudRing<PointT> & ring, const std::string & type) {
+	profiler.points(cloud.size(), cloud.size());
+	if (!ring.isOpen() || cloud.size() > ring.capacity()) {
+		std::string name = prop_name;
+		if (name.empty() || name[0] != '/')
+			name = "/" + name;
+		name += "_" + type;
+		// Growing clouds get some room, so that the ring is not created again for every one.
+		const size_t points = std::max<size_t>(std::max(0, (int) capacity), cloud.size() > ring.capacity() && ring.isOpen() ? cloud.size() * 3 / 2 : cloud.size());
+		if (!ring.create(name, slots, points)) {
+			CLOG(LERROR) << "Cannot create shared memory ring " << name << " of " << slots << " x " << points << " points";
+			return;
+		}
+		CLOG(LINFO) << "Created ring " << name << " of " << ring.slots() << " x " << points << " " << type << " points";
+	}
+	if (!ring.write(cloud)) {
+		++skipped;
+		CLOG(LDEBUG) << "Readers hold all slots, " << type << " cloud skipped";
+	}
+	out_skipped.write(skipped);
+}
+
+} //: namespace SharedCloudWriter
+} //: namespace Processors
@@ -0,0 +1,135 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#ifndef SHAREDCLOUDWRITER_HPP_
+#define SHAREDCLOUDWRITER_HPP_
+
+#include "Component_Aux.hpp"
+#include "Component.hpp"
+#include "DataStream.hpp"
+#include "Property.hpp"
+#include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Types/PointXYZSIFT.hpp>
+
+#include "Types/SharedCloudRing.hpp"
+
+namespace Processors {
+namespace SharedCloudWriter {
+
+/*!
+ * \class SharedCloudWriter
+ * \brief SharedCloudWriter processor class.
+ *
+ * Publishes clouds to SharedCloudReaders of other DisCODe processes of the
+ * same host, through rings of shared memory slots (see
+ * Types::SharedCloudRing) named after the name property and the point type,
+ * e.g. /discode_clouds_xyzrgb. A cloud is not serialized - its points are
+ * copied into a slot once and mapped by the readers. A ring is created with
+ * the first cloud of its type, with slots of at least capacity points, and
+ * created again with room to spare (readers follow) for a larger cloud.
+ * Clouds are skipped while readers hold all slots.
+ */
+class SharedCloudWriter: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	SharedCloudWriter(const std::string & name = "SharedCloudWriter");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~SharedCloudWriter();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyz;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzrgb;
+	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT>::Ptr, Base::DataStreamBuffer::Newest> in_cloud_xyzsift;
+
+	/// Number of clouds skipped because readers held all slots.
+	Base::DataStreamOut<int> out_skipped;
+
+	// Handlers
+	void write_xyz();
+	void write_xyzrgb();
+	void write_xyzsift();
+
+	/// Writes the cloud to the ring, creating the ring if needed.
+	template <typename PointT>
+	void write(const pcl::PointCloud<PointT> & cloud, Types::SharedCloudRing<PointT> & ring, const std::string & type);
+
+	/// Property: prefix of names of rings.
+	Base::Property<std::string> prop_name;
+
+	/// Property: slots of a ring, clouds held by readers plus the newest one plus one being written.
+	Base::Property<int> slots;
+
+	/// Property: points of a slot.
+	Base::Property<int> capacity;
+
+	// Rings of point types.
+	Types::SharedCloudRing<pcl::PointXYZ> ring_xyz;
+	Types::SharedCloudRing<pcl::PointXYZRGB> ring_xyzrgb;
+	Types::SharedCloudRing<PointXYZSIFT> ring_xyzsift;
+
+	/// Clouds skipped since start, by all rings.
+	int skipped;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+};
+
+} //: namespace SharedCloudWriter
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("SharedCloudWriter", Processors::SharedCloudWriter::SharedCloudWriter)
+
+#endif /* SHAREDCLOUDWRITER_HPP_ */
@@ -12,6 +12,8 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CaptureTime.hpp"
+
 #include <boost/random.hpp> 
 #include <boost/random/normal_distribution.hpp> 
 
@@ -27,7 +29,11 @@ SphereGenerator::SphereGenerator(const std::string & name) :
 		nr_of_points("nr_of_points", 150),
 		nr_of_outliers("nr_of_outliers", 10),
 		mi("noise.mi", 0),
-		sigma("noise.sigma", 0.001)   {
+		sigma("noise.sigma", 0.001),
+		seed("seed", 0),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
 			registerProperty(r);
 			registerProperty(x);
 			registerProperty(y);
@@ -36,6 +42,9 @@ SphereGenerator::SphereGenerator(const std::string & name) :
 			registerProperty(nr_of_outliers);
 			registerProperty(mi);
 			registerProperty(sigma);
+			registerProperty(seed);
+			registerProperty(profile);
+			registerProperty(profile_period);
 			nr_of_points.addConstraint("0");
 			nr_of_points.addConstraint("10000");
 			nr_of_outliers.addConstraint("0");
@@ -50,12 +59,22 @@ void SphereGenerator::prepareInterface() {
 registerStream("out_pcl_ptr", &out_pcl_ptr);
 registerStream("out_pcl", &out_pcl);
 	// Register handlers
-	h_Generate.setup(boost::bind(&SphereGenerator::Generate, this));
+	h_Generate.setup(profiler.wrap("Generate", boost::bind(&SphereGenerator::Generate, this)));
 	registerHandler("Generate", &h_Generate);
 
 }
 
 bool SphereGenerator::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	if (seed != 0) {
+		// Both the positions (rand) and the noise are reproducible.
+		srand(seed);
+		rng.seed((uint32_t) seed);
+	} else {
+		struct timeval start;
+		gettimeofday (&start, NULL);
+		rng.seed (start.tv_usec);
+	}
 	Generate();
 
 for (size_t i = 0; i < cloud.points.size (); ++i)
@@ -67,6 +86,7 @@ for (size_t i = 0; i < cloud.points.size (); ++i)
 }
 
 bool SphereGenerator::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -80,6 +100,7 @@ bool SphereGenerator::onStart() {
 
 void SphereGenerator::Generate() {
 //generate 
+	const uint64_t captured = Types::CaptureTime::now();
 	if (nr_of_outliers > nr_of_points)
 		nr_of_outliers = 0;
  
@@ -117,10 +138,6 @@ void SphereGenerator::Generate() {
    }
   
 //noise
-        struct timeval start; 
-        gettimeofday (&start, NULL); 
-        boost::mt19937 rng; 
-        rng.seed (start.tv_usec); 
         boost::normal_distribution<> nd (mi, sigma); 
         boost::variate_generator<boost::mt19937&, 
 			boost::normal_distribution<> > var_nor (rng, nd); 
@@ -135,6 +152,8 @@ void SphereGenerator::Generate() {
   
 
 	
+	// Cloud is generated over again, so it is stamped every time.
+	cloud.header.stamp = captured;
 	out_pcl.write(cloud);	
 	cloudPtr = cloud.makeShared();
 	out_pcl_ptr.write(cloudPtr);
@@ -13,6 +13,10 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
+#include <boost/random/mersenne_twister.hpp>
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 
@@ -97,6 +101,21 @@ protected:
 		Base::Property<int> nr_of_points;
 		Base::Property<int> nr_of_outliers;
 
+	/// Property: seed of the noise, 0 - seeded from the clock.
+	Base::Property<int> seed;
+
+	/// Generator of the noise, seeded once.
+	boost::mt19937 rng;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
 };
 
 } //: namespace SphereGenerator
@@ -12,7 +12,10 @@
 
 #include <boost/bind.hpp>
 
-#include <pcl/filters/statistical_outlier_removal.h>
+#include <pcl/common/io.h>
+
+#include "Types/CloudPool.hpp"
+#include "Types/StatisticalOutliers.hpp"
 
 namespace Processors {
 namespace StatisticalOutlierCounter {
@@ -21,10 +24,15 @@ StatisticalOutlierCounter::StatisticalOutlierCounter(const std::string & name) :
 		Base::Component(name) , 
 		negative("negative", false),
 		StddevMulThresh("StddevMulThresh", 1.0),
-		MeanK("MeanK", 50) {
+		MeanK("MeanK", 50),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
 		registerProperty(negative);
 		registerProperty(StddevMulThresh);
 		registerProperty(MeanK);
+		registerProperty(profile);
+		registerProperty(profile_period);
 
 }
 
@@ -37,23 +45,44 @@ void StatisticalOutlierCounter::prepareInterface() {
 	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
 	registerStream("in_cloud_xyz", &in_cloud_xyz);
 	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("in_indexed_xyzrgb", &in_indexed_xyzrgb);
+	registerStream("out_indexed_xyzrgb", &out_indexed_xyzrgb);
+	registerStream("in_indexed_xyz", &in_indexed_xyz);
+	registerStream("out_indexed_xyz", &out_indexed_xyz);
+	registerStream("in_mean_distances", &in_mean_distances);
+	registerStream("out_count", &out_count);
 	// Register handlers
-	h_count_xyzrgb.setup(boost::bind(&StatisticalOutlierCounter::count_xyzrgb, this));
+	h_count_xyzrgb.setup(profiler.wrap("filter_xyzrgb", boost::bind(&StatisticalOutlierCounter::count_xyzrgb, this)));
 	registerHandler("filter_xyzrgb", &h_count_xyzrgb);
 	addDependency("filter_xyzrgb", &in_cloud_xyzrgb);
 	
-	h_count_xyz.setup(boost::bind(&StatisticalOutlierCounter::count_xyz, this));
+	h_count_xyz.setup(profiler.wrap("filter_xyz", boost::bind(&StatisticalOutlierCounter::count_xyz, this)));
 	registerHandler("filter_xyz", &h_count_xyz);
 	addDependency("filter_xyz", &in_cloud_xyz);
 
+	h_count_indexed_xyzrgb.setup(profiler.wrap("filter_indexed_xyzrgb", boost::bind(&StatisticalOutlierCounter::count_indexed_xyzrgb, this)));
+	registerHandler("filter_indexed_xyzrgb", &h_count_indexed_xyzrgb);
+	addDependency("filter_indexed_xyzrgb", &in_indexed_xyzrgb);
+
+	h_count_indexed_xyz.setup(profiler.wrap("filter_indexed_xyz", boost::bind(&StatisticalOutlierCounter::count_indexed_xyz, this)));
+	registerHandler("filter_indexed_xyz", &h_count_indexed_xyz);
+	addDependency("filter_indexed_xyz", &in_indexed_xyz);
+
+	// Counting from distances only, no neighbour search.
+	h_count_distances.setup(profiler.wrap("count_distances", boost::bind(&StatisticalOutlierCounter::count_distances, this)));
+	registerHandler("count_distances", &h_count_distances);
+	addDependency("count_distances", &in_mean_distances);
+
 }
 
 bool StatisticalOutlierCounter::onInit() {
+	profiler.setEnabled(profile, profile_period);
 
 	return true;
 }
 
 bool StatisticalOutlierCounter::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -65,33 +94,49 @@ bool StatisticalOutlierCounter::onStart() {
 	return true;
 }
 
+template <typename PointT>
+typename pcl::PointCloud<PointT>::Ptr StatisticalOutlierCounter::count(const Types::IndexedCloud<PointT> & input) {
+	Types::StatisticalOutliers::Result result;
+	Types::StatisticalOutliers::analyze(input, MeanK, StddevMulThresh, negative, result);
+	CLOG(LINFO) << "outliners: " << result.outliers.size();
+	out_count.write(result.outliers.size());
+
+	typename pcl::PointCloud<PointT>::Ptr output = Types::CloudPool<PointT>::acquire(result.inliers.size());
+	pcl::copyPointCloud(*input.cloud(), result.inliers, *output);
+	return output;
+}
+
+void StatisticalOutlierCounter::count_distances() {
+	CLOG(LINFO) << "StatisticalOutlierCounter::count_distances";
+	Types::StatisticalOutliers::Result result;
+	result.distances = in_mean_distances.read();
+	Types::StatisticalOutliers::classify(result, StddevMulThresh, negative);
+	CLOG(LINFO) << "outliners: " << result.outliers.size();
+	out_count.write(result.outliers.size());
+}
+
 void StatisticalOutlierCounter::count_xyzrgb() {
-		CLOG(LINFO) << "StatisticalOutlierCounter::filter_xyzrgb";
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
-	pcl::StatisticalOutlierRemoval<pcl::PointXYZRGB> sor;
-	sor.setInputCloud (cloud);
-	sor.setMeanK (MeanK);
-	sor.setStddevMulThresh (StddevMulThresh);
-	sor.setNegative (negative);
-	sor.filter (*cloud);
-	pcl::IndicesConstPtr indices = 	sor.getRemovedIndices ();
-	CLOG(LINFO) << "outliners: " << indices->size();
+	CLOG(LINFO) << "StatisticalOutlierCounter::filter_xyzrgb";
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = count(*Types::IndexedCloud<pcl::PointXYZRGB>::create(in_cloud_xyzrgb.read()));
 	out_cloud_xyzrgb.write(cloud);
+	out_indexed_xyzrgb.write(Types::IndexedCloud<pcl::PointXYZRGB>::create(cloud));
 }
 
 void StatisticalOutlierCounter::count_xyz() {
-	CLOG(LINFO) << "StatisticalOutlierCounter::filter_xyzrgb";
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
-	pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor;
-	sor.setInputCloud (cloud);
-	sor.setMeanK (MeanK);
-	sor.setStddevMulThresh (StddevMulThresh);
-	sor.setNegative (negative);
-	
-	sor.filter (*cloud);
-	pcl::IndicesConstPtr indices = 	sor.getRemovedIndices ();
-	CLOG(LINFO) << "outliners: " << indices->size();
+	CLOG(LINFO) << "StatisticalOutlierCounter::filter_xyz";
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = count(*Types::IndexedCloud<pcl::PointXYZ>::create(in_cloud_xyz.read()));
 	out_cloud_xyz.write(cloud);
+	out_indexed_xyz.write(Types::IndexedCloud<pcl::PointXYZ>::create(cloud));
+}
+
+void StatisticalOutlierCounter::count_indexed_xyzrgb() {
+	CLOG(LINFO) << "StatisticalOutlierCounter::filter_indexed_xyzrgb";
+	out_indexed_xyzrgb.write(Types::IndexedCloud<pcl::PointXYZRGB>::create(count(*in_indexed_xyzrgb.read())));
+}
+
+void StatisticalOutlierCounter::count_indexed_xyz() {
+	CLOG(LINFO) << "StatisticalOutlierCounter::filter_indexed_xyz";
+	out_indexed_xyz.write(Types::IndexedCloud<pcl::PointXYZ>::create(count(*in_indexed_xyz.read())));
 }
 
 
@@ -13,9 +13,13 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
 
+#include "Types/IndexedCloud.hpp"
+
 namespace Processors {
 namespace StatisticalOutlierCounter {
 
@@ -71,14 +75,27 @@ protected:
 
 	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
 	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_cloud_xyz;
+	Base::DataStreamIn<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr> in_indexed_xyzrgb;
+	Base::DataStreamIn<Types::IndexedCloud<pcl::PointXYZ>::Ptr> in_indexed_xyz;
+
+	/// Mean neighbour distances computed upstream, e.g. by StatisticalOutlierRemoval.
+	Base::DataStreamIn<std::vector<float> > in_mean_distances;
 
 // Output data streams
 
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr> out_indexed_xyzrgb;
+	Base::DataStreamOut<Types::IndexedCloud<pcl::PointXYZ>::Ptr> out_indexed_xyz;
+
+	/// Number of outliers.
+	Base::DataStreamOut<int> out_count;
 	// Handlers
 	Base::EventHandler2 h_count_xyz;
 	Base::EventHandler2 h_count_xyzrgb;
+	Base::EventHandler2 h_count_indexed_xyz;
+	Base::EventHandler2 h_count_indexed_xyzrgb;
+	Base::EventHandler2 h_count_distances;
 	Base::Property<bool> negative;
 	Base::Property<float> StddevMulThresh;
 	Base::Property<float> MeanK;
@@ -86,6 +103,22 @@ protected:
 	// Handlers
 	void count_xyz();
 	void count_xyzrgb();
+	void count_indexed_xyz();
+	void count_indexed_xyzrgb();
+	void count_distances();
+
+	/// Counts and removes outliers, using search index of the input.
+	template <typename PointT>
+	typename pcl::PointCloud<PointT>::Ptr count(const Types::IndexedCloud<PointT> & input);
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
@@ -12,7 +12,11 @@
 
 #include <boost/bind.hpp>
 
-#include <pcl/filters/statistical_outlier_removal.h>
+#include <pcl/common/io.h>
+
+#include "Types/CloudPool.hpp"
+#include "Types/CloudBatch.hpp"
+#include "Types/StatisticalOutliers.hpp"
 
 namespace Processors {
 namespace StatisticalOutlierRemoval {
@@ -22,11 +26,28 @@ StatisticalOutlierRemoval::StatisticalOutlierRemoval(const std::string & name) :
 		negative("negative", false),
 		StddevMulThresh("StddevMulThresh", 1.0),
 		MeanK("MeanK", 50),
-		pass_through("pass_through", false) {
+		pass_through("pass_through", false),
+		input_policy("input.policy", std::string("newest")),
+		input_queue("input.queue", 0),
+		input_deadline("input.deadline", 100),
+		input_xyzrgb(name + ".in_cloud_xyzrgb"),
+		input_xyz(name + ".in_cloud_xyz"),
+		input_indexed_xyzrgb(name + ".in_indexed_xyzrgb"),
+		input_indexed_xyz(name + ".in_indexed_xyz"),
+		input_clouds_xyzrgb(name + ".in_clouds_xyzrgb"),
+		input_clouds_xyz(name + ".in_clouds_xyz"),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
 	registerProperty(negative);
 	registerProperty(StddevMulThresh);
 	registerProperty(MeanK);
 	registerProperty(pass_through);
+	registerProperty(input_policy);
+	registerProperty(input_queue);
+	registerProperty(input_deadline);
+	registerProperty(profile);
+	registerProperty(profile_period);
 
 }
 
@@ -39,26 +60,76 @@ void StatisticalOutlierRemoval::prepareInterface() {
 	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
 	registerStream("in_cloud_xyz", &in_cloud_xyz);
 	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("in_indexed_xyzrgb", &in_indexed_xyzrgb);
+	registerStream("out_indexed_xyzrgb", &out_indexed_xyzrgb);
+	registerStream("in_indexed_xyz", &in_indexed_xyz);
+	registerStream("out_indexed_xyz", &out_indexed_xyz);
+	registerStream("out_mean_distances", &out_mean_distances);
+	registerStream("in_clouds_xyzrgb", &in_clouds_xyzrgb);
+	registerStream("out_clouds_xyzrgb", &out_clouds_xyzrgb);
+	registerStream("in_clouds_xyz", &in_clouds_xyz);
+	registerStream("out_clouds_xyz", &out_clouds_xyz);
 
 	// Register handlers
-	registerHandler("filter_xyzrgb", boost::bind(&StatisticalOutlierRemoval::filter_xyzrgb, this));
+	registerHandler("filter_xyzrgb", profiler.wrap("filter_xyzrgb", boost::bind(&StatisticalOutlierRemoval::filter_xyzrgb, this)));
 	addDependency("filter_xyzrgb", &in_cloud_xyzrgb);
 	
-	registerHandler("filter_xyz", boost::bind(&StatisticalOutlierRemoval::filter_xyz, this));
+	registerHandler("filter_xyz", profiler.wrap("filter_xyz", boost::bind(&StatisticalOutlierRemoval::filter_xyz, this)));
 	addDependency("filter_xyz", &in_cloud_xyz);
 
+	registerHandler("filter_indexed_xyzrgb", profiler.wrap("filter_indexed_xyzrgb", boost::bind(&StatisticalOutlierRemoval::filter_indexed_xyzrgb, this)));
+	addDependency("filter_indexed_xyzrgb", &in_indexed_xyzrgb);
+
+	registerHandler("filter_indexed_xyz", profiler.wrap("filter_indexed_xyz", boost::bind(&StatisticalOutlierRemoval::filter_indexed_xyz, this)));
+	addDependency("filter_indexed_xyz", &in_indexed_xyz);
+
+	registerHandler("filter_clouds_xyzrgb", profiler.wrap("filter_clouds_xyzrgb", boost::bind(&StatisticalOutlierRemoval::filter_clouds_xyzrgb, this)));
+	addDependency("filter_clouds_xyzrgb", &in_clouds_xyzrgb);
+
+	registerHandler("filter_clouds_xyz", profiler.wrap("filter_clouds_xyz", boost::bind(&StatisticalOutlierRemoval::filter_clouds_xyz, this)));
+	addDependency("filter_clouds_xyz", &in_clouds_xyz);
+
 }
 
 bool StatisticalOutlierRemoval::onInit() {
+	profiler.setEnabled(profile, profile_period);
+
+	if (!input_xyzrgb.configure(input_policy, input_queue, input_deadline))
+		CLOG(LWARNING) << "Unknown input policy " << input_policy << ", using newest";
+	input_xyz.configure(input_policy, input_queue, input_deadline);
+	input_indexed_xyzrgb.configure(input_policy, input_queue, input_deadline);
+	input_indexed_xyz.configure(input_policy, input_queue, input_deadline);
+	input_clouds_xyzrgb.configure(input_policy, input_queue, input_deadline);
+	input_clouds_xyz.configure(input_policy, input_queue, input_deadline);
+	input_xyzrgb.setReporting(profile, profile_period);
+	input_xyz.setReporting(profile, profile_period);
+	input_indexed_xyzrgb.setReporting(profile, profile_period);
+	input_indexed_xyz.setReporting(profile, profile_period);
+	input_clouds_xyzrgb.setReporting(profile, profile_period);
+	input_clouds_xyz.setReporting(profile, profile_period);
 
 	return true;
 }
 
 bool StatisticalOutlierRemoval::onFinish() {
+	profiler.report();
+	input_xyzrgb.report();
+	input_xyz.report();
+	input_indexed_xyzrgb.report();
+	input_indexed_xyz.report();
+	input_clouds_xyzrgb.report();
+	input_clouds_xyz.report();
 	return true;
 }
 
 bool StatisticalOutlierRemoval::onStop() {
+	// Frames of a bounded queue are not processed after the task starts over.
+	input_xyzrgb.clear();
+	input_xyz.clear();
+	input_indexed_xyzrgb.clear();
+	input_indexed_xyz.clear();
+	input_clouds_xyzrgb.clear();
+	input_clouds_xyz.clear();
 	return true;
 }
 
@@ -66,43 +137,121 @@ bool StatisticalOutlierRemoval::onStart() {
 	return true;
 }
 
-void StatisticalOutlierRemoval::filter_xyzrgb() {
-	CLOG(LTRACE) << "StatisticalOutlierRemoval::filter_xyzrgb";
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
+template <typename PointT>
+typename pcl::PointCloud<PointT>::Ptr StatisticalOutlierRemoval::filter(const Types::IndexedCloud<PointT> & input) {
+	CLOG(LINFO) << "Before filtering Point cloud contained " << input.size() << " points";
 
-	if (!pass_through) {
-		CLOG(LINFO) << "Before filtering Point cloud contained " << cloud->size() << " points";
+	Types::StatisticalOutliers::Result result;
+	Types::StatisticalOutliers::analyze(input, MeanK, StddevMulThresh, negative, result);
 
-		pcl::StatisticalOutlierRemoval<pcl::PointXYZRGB> sor;
-		sor.setInputCloud (cloud);
-		sor.setMeanK (MeanK);
-		sor.setStddevMulThresh (StddevMulThresh);
-		sor.setNegative (negative);
-		sor.filter (*cloud);
+	typename pcl::PointCloud<PointT>::Ptr output = Types::CloudPool<PointT>::acquire(result.inliers.size());
+	pcl::copyPointCloud(*input.cloud(), result.inliers, *output);
 
-		CLOG(LINFO) << "After filtering Point cloud contained " << cloud->size() << " points";
+	CLOG(LINFO) << "After filtering Point cloud contained " << output->size() << " points";
+	profiler.points(input.size(), output->size());
+	out_mean_distances.write(result.distances);
+	return output;
+}
+
+/// Removes outliers from clouds of a batch.
+struct BatchOutliers {
+	BatchOutliers(int mean_k_, double std_mul_, bool negative_) : mean_k(mean_k_), std_mul(std_mul_), negative(negative_) {}
+
+	template <typename PointT>
+	void operator()(const typename pcl::PointCloud<PointT>::Ptr & input, pcl::PointCloud<PointT> & output, int) const {
+		Types::IndexedCloud<PointT> indexed(input);
+		Types::StatisticalOutliers::Result result;
+		Types::StatisticalOutliers::analyze(indexed, mean_k, std_mul, negative, result);
+		pcl::copyPointCloud(*input, result.inliers, output);
+	}
+
+	int mean_k;
+	double std_mul;
+	bool negative;
+};
+
+template <typename PointT>
+void StatisticalOutlierRemoval::filterBatch(Base::DataStreamIn<std::vector<typename pcl::PointCloud<PointT>::Ptr>, Base::DataStreamBuffer::Queue> & in,
+		Types::InputPolicy<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & input,
+		Base::DataStreamOut<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & out) {
+	std::vector<typename pcl::PointCloud<PointT>::Ptr> clouds;
+	if (!input.read(in, clouds))
+		return;
+	if (pass_through) {
+		out.write(clouds);
+		return;
 	}
 
+	std::vector<typename pcl::PointCloud<PointT>::Ptr> clouds_filtered;
+	BatchOutliers outliers(MeanK, StddevMulThresh, negative);
+	Types::CloudBatch::filter<PointT>(clouds, clouds_filtered, outliers);
+
+	const size_t before = Types::CloudBatch::points<PointT>(clouds), after = Types::CloudBatch::points<PointT>(clouds_filtered);
+	CLOG(LINFO) << "After filtering " << clouds.size() << " clouds contained " << after << " of " << before << " points";
+	profiler.points(before, after);
+	out.write(clouds_filtered);
+}
+
+void StatisticalOutlierRemoval::filter_xyzrgb() {
+	CLOG(LTRACE) << "StatisticalOutlierRemoval::filter_xyzrgb";
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
+	if (!input_xyzrgb.read(in_cloud_xyzrgb, cloud))
+		return;
+
+	if (!pass_through)
+		cloud = filter(*Types::IndexedCloud<pcl::PointXYZRGB>::create(cloud));
+
 	out_cloud_xyzrgb.write(cloud);
+	out_indexed_xyzrgb.write(Types::IndexedCloud<pcl::PointXYZRGB>::create(cloud));
 }
 
 void StatisticalOutlierRemoval::filter_xyz() {
 	CLOG(LTRACE) << "StatisticalOutlierRemoval::filter_xyz";
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
-
-	if (!pass_through) {
-		pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor;
-		sor.setInputCloud (cloud);
-		sor.setMeanK (MeanK);
-		sor.setStddevMulThresh (StddevMulThresh);
-		sor.setNegative (negative);
-		sor.filter (*cloud);
-	}
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+	if (!input_xyz.read(in_cloud_xyz, cloud))
+		return;
+
+	if (!pass_through)
+		cloud = filter(*Types::IndexedCloud<pcl::PointXYZ>::create(cloud));
 
 	out_cloud_xyz.write(cloud);
+	out_indexed_xyz.write(Types::IndexedCloud<pcl::PointXYZ>::create(cloud));
+}
+
+void StatisticalOutlierRemoval::filter_indexed_xyzrgb() {
+	CLOG(LTRACE) << "StatisticalOutlierRemoval::filter_indexed_xyzrgb";
+	Types::IndexedCloud<pcl::PointXYZRGB>::Ptr input;
+	if (!input_indexed_xyzrgb.read(in_indexed_xyzrgb, input))
+		return;
+
+	// Input index stays valid when not filtering, pass it on as is.
+	if (!pass_through)
+		input = Types::IndexedCloud<pcl::PointXYZRGB>::create(filter(*input));
+
+	out_indexed_xyzrgb.write(input);
+}
+
+void StatisticalOutlierRemoval::filter_indexed_xyz() {
+	CLOG(LTRACE) << "StatisticalOutlierRemoval::filter_indexed_xyz";
+	Types::IndexedCloud<pcl::PointXYZ>::Ptr input;
+	if (!input_indexed_xyz.read(in_indexed_xyz, input))
+		return;
+
+	if (!pass_through)
+		input = Types::IndexedCloud<pcl::PointXYZ>::create(filter(*input));
+
+	out_indexed_xyz.write(input);
 }
 
+void StatisticalOutlierRemoval::filter_clouds_xyzrgb() {
+	CLOG(LTRACE) << "StatisticalOutlierRemoval::filter_clouds_xyzrgb";
+	filterBatch<pcl::PointXYZRGB>(in_clouds_xyzrgb, input_clouds_xyzrgb, out_clouds_xyzrgb);
+}
 
+void StatisticalOutlierRemoval::filter_clouds_xyz() {
+	CLOG(LTRACE) << "StatisticalOutlierRemoval::filter_clouds_xyz";
+	filterBatch<pcl::PointXYZ>(in_clouds_xyz, input_clouds_xyz, out_clouds_xyz);
+}
 
 } //: namespace StatisticalOutlierRemoval
 } //: namespace Processors
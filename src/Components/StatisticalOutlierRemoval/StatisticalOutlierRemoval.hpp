@@ -13,9 +13,14 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+#include "Types/InputPolicy.hpp"
+
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
 
+#include "Types/IndexedCloud.hpp"
+
 namespace Processors {
 namespace StatisticalOutlierRemoval {
 
@@ -23,7 +28,10 @@ namespace StatisticalOutlierRemoval {
  * \class StatisticalOutlierRemoval
  * \brief StatisticalOutlierRemoval processor class.
  *
- * StatisticalOutlierRemoval processor.
+ * StatisticalOutlierRemoval processor. Inputs are read through
+ * Types::InputPolicy - frames waiting while filtering falls behind can be
+ * dropped (input.policy newest by default, deadline or queue bounded by
+ * input.queue).
  */
 class StatisticalOutlierRemoval: public Base::Component {
 public:
@@ -69,13 +77,24 @@ protected:
 
 	// Input data streams
 
-	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
-	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_cloud_xyz;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Queue> in_cloud_xyzrgb;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_cloud_xyz;
+	Base::DataStreamIn<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr, Base::DataStreamBuffer::Queue> in_indexed_xyzrgb;
+	Base::DataStreamIn<Types::IndexedCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_indexed_xyz;
+	Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr>, Base::DataStreamBuffer::Queue> in_clouds_xyzrgb;
+	Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr>, Base::DataStreamBuffer::Queue> in_clouds_xyz;
 
 	// Output data streams
 
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr> out_indexed_xyzrgb;
+	Base::DataStreamOut<Types::IndexedCloud<pcl::PointXYZ>::Ptr> out_indexed_xyz;
+	Base::DataStreamOut<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > out_clouds_xyzrgb;
+	Base::DataStreamOut<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > out_clouds_xyz;
+
+	/// Mean distance of every input point to its MeanK neighbours (NaN if none).
+	Base::DataStreamOut<std::vector<float> > out_mean_distances;
 
 	Base::Property<bool> negative;
 	Base::Property<float> StddevMulThresh;
@@ -86,6 +105,48 @@ protected:
 	// Handlers
 	void filter_xyz();
 	void filter_xyzrgb();
+	void filter_indexed_xyz();
+	void filter_indexed_xyzrgb();
+	void filter_clouds_xyz();
+	void filter_clouds_xyzrgb();
+
+	/*!
+	 * Removes outliers, using search index of the input (built only if not present yet).
+	 */
+	template <typename PointT>
+	typename pcl::PointCloud<PointT>::Ptr filter(const Types::IndexedCloud<PointT> & input);
+
+	/// Removes outliers from all clouds of the vector (e.g. clusters) in parallel, every cloud with its own index.
+	template <typename PointT>
+	void filterBatch(Base::DataStreamIn<std::vector<typename pcl::PointCloud<PointT>::Ptr>, Base::DataStreamBuffer::Queue> & in,
+			Types::InputPolicy<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & input,
+			Base::DataStreamOut<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & out);
+
+	/// Property: frames taken from inputs - newest (the latest waiting frame), queue or deadline.
+	Base::Property<std::string> input_policy;
+
+	/// Property: frames waiting in a queue, older ones are dropped, 0 - unbounded.
+	Base::Property<int> input_queue;
+
+	/// Property: age since capture (ms) of frames dropped with the deadline policy.
+	Base::Property<float> input_deadline;
+
+	// Policies of inputs.
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> input_xyzrgb;
+	Types::InputPolicy<pcl::PointCloud<pcl::PointXYZ>::Ptr> input_xyz;
+	Types::InputPolicy<Types::IndexedCloud<pcl::PointXYZRGB>::Ptr> input_indexed_xyzrgb;
+	Types::InputPolicy<Types::IndexedCloud<pcl::PointXYZ>::Ptr> input_indexed_xyz;
+	Types::InputPolicy<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > input_clouds_xyzrgb;
+	Types::InputPolicy<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > input_clouds_xyz;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
@@ -12,6 +12,10 @@
 
 #include <boost/bind.hpp>
 
+#include "Types/CloudPool.hpp"
+#include "Types/CloudBatch.hpp"
+#include "Types/DeviceFilters.hpp"
+
 #include <pcl/filters/voxel_grid.h>
 
 namespace Processors {
@@ -22,11 +26,24 @@ VoxelGrid::VoxelGrid(const std::string & name) :
 		x("LeafSize.x", 0.01f), 
 		y("LeafSize.y", 0.01f), 
 		z("LeafSize.z", 0.01f),
-		pass_through("pass_through", false){
+		pass_through("pass_through", false),
+		mode("mode", std::string("pcl")),
+		policy("policy", std::string("centroid")),
+		gpu("gpu", false),
+		gpu_download("gpu.download", true),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
 	registerProperty(x);
 	registerProperty(y);
 	registerProperty(z);
 	registerProperty(pass_through);
+	registerProperty(mode);
+	registerProperty(policy);
+	registerProperty(gpu);
+	registerProperty(gpu_download);
+	registerProperty(profile);
+	registerProperty(profile_period);
 }
 
 VoxelGrid::~VoxelGrid() {
@@ -38,20 +55,52 @@ void VoxelGrid::prepareInterface() {
 	registerStream("in_cloud_xyzrgb_normal", &in_cloud_xyzrgb_normal);
 	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
 	registerStream("out_cloud_xyzrgb_normal", &out_cloud_xyzrgb_normal);
+	registerStream("in_cloud_xyz", &in_cloud_xyz);
+	registerStream("in_cloud_xyzsift", &in_cloud_xyzsift);
+	registerStream("in_cloud_xyzshot", &in_cloud_xyzshot);
+	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("out_cloud_xyzsift", &out_cloud_xyzsift);
+	registerStream("out_cloud_xyzshot", &out_cloud_xyzshot);
+	registerStream("in_device_cloud_xyzrgb", &in_device_cloud_xyzrgb);
+	registerStream("in_device_cloud_xyzrgb_normal", &in_device_cloud_xyzrgb_normal);
+	registerStream("out_device_cloud_xyzrgb", &out_device_cloud_xyzrgb);
+	registerStream("out_device_cloud_xyzrgb_normal", &out_device_cloud_xyzrgb_normal);
+	registerStream("in_clouds_xyz", &in_clouds_xyz);
+	registerStream("in_clouds_xyzrgb", &in_clouds_xyzrgb);
+	registerStream("out_clouds_xyz", &out_clouds_xyz);
+	registerStream("out_clouds_xyzrgb", &out_clouds_xyzrgb);
 
 	// Register handlers
-	registerHandler("filter", boost::bind(&VoxelGrid::filter, this));
+	registerHandler("filter", profiler.wrap("filter", boost::bind(&VoxelGrid::filter, this)));
 	addDependency("filter", &in_cloud_xyzrgb);
- 	registerHandler("filter_normal", boost::bind(&VoxelGrid::filter_normal, this));
+ 	registerHandler("filter_normal", profiler.wrap("filter_normal", boost::bind(&VoxelGrid::filter_normal, this)));
  	addDependency("filter_normal", &in_cloud_xyzrgb_normal);
+	registerHandler("filter_xyz", profiler.wrap("filter_xyz", boost::bind(&VoxelGrid::filter_xyz, this)));
+	addDependency("filter_xyz", &in_cloud_xyz);
+	registerHandler("filter_xyzsift", profiler.wrap("filter_xyzsift", boost::bind(&VoxelGrid::filter_xyzsift, this)));
+	addDependency("filter_xyzsift", &in_cloud_xyzsift);
+	registerHandler("filter_xyzshot", profiler.wrap("filter_xyzshot", boost::bind(&VoxelGrid::filter_xyzshot, this)));
+	addDependency("filter_xyzshot", &in_cloud_xyzshot);
+	registerHandler("filter_device", profiler.wrap("filter_device", boost::bind(&VoxelGrid::filter_device, this)));
+	addDependency("filter_device", &in_device_cloud_xyzrgb);
+	registerHandler("filter_device_normal", profiler.wrap("filter_device_normal", boost::bind(&VoxelGrid::filter_device_normal, this)));
+	addDependency("filter_device_normal", &in_device_cloud_xyzrgb_normal);
+	registerHandler("filter_clouds_xyz", profiler.wrap("filter_clouds_xyz", boost::bind(&VoxelGrid::filter_clouds_xyz, this)));
+	addDependency("filter_clouds_xyz", &in_clouds_xyz);
+	registerHandler("filter_clouds_xyzrgb", profiler.wrap("filter_clouds_xyzrgb", boost::bind(&VoxelGrid::filter_clouds_xyzrgb, this)));
+	addDependency("filter_clouds_xyzrgb", &in_clouds_xyzrgb);
 }
 
 bool VoxelGrid::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	if (gpu && !Types::Cuda::available())
+		CLOG(LWARNING) << "VoxelGrid: no CUDA device (or built without CUDA), filtering on the CPU";
 
 	return true;
 }
 
 bool VoxelGrid::onFinish() {
+	profiler.report();
 	return true;
 }
 
@@ -63,47 +112,184 @@ bool VoxelGrid::onStart() {
 	return true;
 }
 
+template <typename PointT>
+typename pcl::PointCloud<PointT>::Ptr VoxelGrid::filterHash(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::HashVoxelGrid<PointT> & grid) {
+	typename Types::HashVoxelGrid<PointT>::Policy p = Types::HashVoxelGrid<PointT>::CENTROID;
+	if (!Types::HashVoxelGrid<PointT>::parsePolicy(policy, p))
+		CLOG(LWARNING) << "Unknown policy " << std::string(policy) << ", using centroid";
+
+	typename pcl::PointCloud<PointT>::Ptr cloud_filtered = Types::CloudPool<PointT>::acquire();
+	grid.setLeafSize(x, y, z);
+	grid.setPolicy(p);
+	grid.filter(*cloud, *cloud_filtered);
+
+	CLOG(LINFO) << "PointCloud after filtering contains " << cloud_filtered->points.size ()  << " of " << cloud->points.size () << " points";
+	profiler.points(cloud->size(), cloud_filtered->size());
+	return cloud_filtered;
+}
+
+template <typename PointT>
+typename pcl::PointCloud<PointT>::Ptr VoxelGrid::filterHost(const typename pcl::PointCloud<PointT>::Ptr & cloud) {
+	if (std::string(mode) == "hash")
+		return filterHash<PointT>(cloud, hash((PointT *) NULL));
+
+	CLOG(LINFO) << "PointCloud before filtering contains " << cloud->points.size ()  << " points";
+
+	pcl::VoxelGrid<PointT> vg;
+	typename pcl::PointCloud<PointT>::Ptr cloud_filtered = Types::CloudPool<PointT>::acquire();
+	vg.setInputCloud (cloud);
+	vg.setLeafSize (x, y, z);
+	vg.filter (*cloud_filtered);
+
+	CLOG(LINFO) << "PointCloud after filtering contains " << cloud_filtered->points.size ()  << " points";
+	profiler.points(cloud->size(), cloud_filtered->size());
+	return cloud_filtered;
+}
+
+/// Filters clouds of a batch, with the hash engine of the thread or with PCL.
+template <typename PointT>
+struct BatchVoxelGrid {
+	BatchVoxelGrid(std::vector<Types::HashVoxelGrid<PointT> > * grids_, float x_, float y_, float z_) :
+		grids(grids_), x(x_), y(y_), z(z_) {
+	}
+
+	void operator()(const typename pcl::PointCloud<PointT>::Ptr & input, pcl::PointCloud<PointT> & output, int thread) {
+		if (grids) {
+			(*grids)[thread].filter(*input, output);
+			return;
+		}
+		pcl::VoxelGrid<PointT> vg;
+		vg.setInputCloud(input);
+		vg.setLeafSize(x, y, z);
+		vg.filter(output);
+	}
+
+	std::vector<Types::HashVoxelGrid<PointT> > * grids;
+	float x, y, z;
+};
+
+template <typename PointT>
+void VoxelGrid::filterBatch(Base::DataStreamIn<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & in,
+		Base::DataStreamOut<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & out,
+		std::vector<Types::HashVoxelGrid<PointT> > * grids) {
+	std::vector<typename pcl::PointCloud<PointT>::Ptr> clouds = in.read();
+	if (pass_through) {
+		out.write(clouds);
+		return;
+	}
+
+	if (grids) {
+		typename Types::HashVoxelGrid<PointT>::Policy p = Types::HashVoxelGrid<PointT>::CENTROID;
+		if (!Types::HashVoxelGrid<PointT>::parsePolicy(policy, p))
+			CLOG(LWARNING) << "Unknown policy " << std::string(policy) << ", using centroid";
+		grids->resize(Types::CloudBatch::threads());
+		for (size_t t = 0; t < grids->size(); ++t) {
+			(*grids)[t].setLeafSize(x, y, z);
+			(*grids)[t].setPolicy(p);
+		}
+	}
+
+	std::vector<typename pcl::PointCloud<PointT>::Ptr> clouds_filtered;
+	BatchVoxelGrid<PointT> filter(grids, x, y, z);
+	Types::CloudBatch::filter<PointT>(clouds, clouds_filtered, filter);
+
+	const size_t before = Types::CloudBatch::points<PointT>(clouds), after = Types::CloudBatch::points<PointT>(clouds_filtered);
+	CLOG(LINFO) << "Clouds after filtering contain " << after << " of " << before << " points in " << clouds.size() << " clouds";
+	profiler.points(before, after);
+	out.write(clouds_filtered);
+}
+
+template <typename PointT>
+typename Types::DeviceCloud<PointT>::Ptr VoxelGrid::filterDevice(const typename Types::DeviceCloud<PointT>::Ptr & cloud) {
+	// No device, the cloud is in host memory.
+	if (!Types::Cuda::available())
+		return Types::DeviceCloud<PointT>::upload(filterHost<PointT>(cloud->host()));
+
+	typename Types::DeviceCloud<PointT>::Ptr cloud_filtered = Types::Cuda::voxelGrid(*cloud, x, y, z);
+	if (!cloud_filtered) {
+		CLOG(LWARNING) << "Leaf size is too small for the input dataset, cloud is not filtered";
+		return cloud;
+	}
+	CLOG(LINFO) << "PointCloud after filtering on GPU contains " << cloud_filtered->size ()  << " of " << cloud->size() << " points";
+	profiler.points(cloud->size(), cloud_filtered->size());
+	return cloud_filtered;
+}
+
+template <typename PointT>
+void VoxelGrid::writeDevice(const typename Types::DeviceCloud<PointT>::Ptr & cloud,
+		Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out,
+		Base::DataStreamOut<typename Types::DeviceCloud<PointT>::Ptr> & out_device) {
+	out_device.write(cloud);
+	// Download happens only here, and only once for all CPU consumers.
+	if (gpu_download)
+		out.write(cloud->host());
+}
+
 void VoxelGrid::filter() {
 	CLOG(LTRACE) << "VoxelGrid::filter" ;
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = in_cloud_xyzrgb.read();
 	
-	if (!pass_through) {
-		CLOG(LINFO) << "PointCloud before filtering contains " << cloud->points.size ()  << " points";
-
-		pcl::VoxelGrid<pcl::PointXYZRGB> vg;
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZRGB>);
-		vg.setInputCloud (cloud);
-		vg.setLeafSize (x, y, z);
-		vg.filter (*cloud_filtered);
-
-		CLOG(LINFO) << "PointCloud after filtering contains " << cloud_filtered->points.size ()  << " points";
-		out_cloud_xyzrgb.write(cloud_filtered);
-	} else {
+	if (pass_through)
 		out_cloud_xyzrgb.write(cloud);
-	}
-
-	
+	else if (gpu && Types::Cuda::available())
+		writeDevice<pcl::PointXYZRGB>(filterDevice<pcl::PointXYZRGB>(Types::DeviceCloud<pcl::PointXYZRGB>::upload(cloud)),
+				out_cloud_xyzrgb, out_device_cloud_xyzrgb);
+	else
+		out_cloud_xyzrgb.write(filterHost<pcl::PointXYZRGB>(cloud));
 }
 
 void VoxelGrid::filter_normal () {
 	CLOG(LTRACE) << "VoxelGrid::filter_normal";
  	pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloud = in_cloud_xyzrgb_normal.read();
 
-	if (!pass_through) {
-		CLOG(LINFO) << "PointCloud before filtering contains " << cloud->points.size ()  << " points";
-
-		pcl::VoxelGrid<pcl::PointXYZRGBNormal> vg;
-		pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZRGBNormal>);
-		vg.setInputCloud (cloud);
-		vg.setLeafSize (x, y, z);
-		vg.filter (*cloud_filtered);
-		CLOG(LINFO) << "PointCloud after filtering has: " << cloud_filtered->points.size ()  << " data points." << std::endl;
-	 	out_cloud_xyzrgb_normal.write(cloud_filtered);
-	} else {
+	if (pass_through)
 		out_cloud_xyzrgb_normal.write(cloud);
-	}
- 
+	else if (gpu && Types::Cuda::available())
+		writeDevice<pcl::PointXYZRGBNormal>(filterDevice<pcl::PointXYZRGBNormal>(Types::DeviceCloud<pcl::PointXYZRGBNormal>::upload(cloud)),
+				out_cloud_xyzrgb_normal, out_device_cloud_xyzrgb_normal);
+	else
+		out_cloud_xyzrgb_normal.write(filterHost<pcl::PointXYZRGBNormal>(cloud));
  }
 
+void VoxelGrid::filter_xyz() {
+	CLOG(LTRACE) << "VoxelGrid::filter_xyz";
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = in_cloud_xyz.read();
+	out_cloud_xyz.write(pass_through ? cloud : filterHash<pcl::PointXYZ>(cloud, hash_xyz));
+}
+
+void VoxelGrid::filter_xyzsift() {
+	CLOG(LTRACE) << "VoxelGrid::filter_xyzsift";
+	pcl::PointCloud<PointXYZSIFT>::Ptr cloud = in_cloud_xyzsift.read();
+	out_cloud_xyzsift.write(pass_through ? cloud : filterHash<PointXYZSIFT>(cloud, hash_xyzsift));
+}
+
+void VoxelGrid::filter_xyzshot() {
+	CLOG(LTRACE) << "VoxelGrid::filter_xyzshot";
+	pcl::PointCloud<PointXYZSHOT>::Ptr cloud = in_cloud_xyzshot.read();
+	out_cloud_xyzshot.write(pass_through ? cloud : filterHash<PointXYZSHOT>(cloud, hash_xyzshot));
+}
+
+void VoxelGrid::filter_device() {
+	CLOG(LTRACE) << "VoxelGrid::filter_device";
+	Types::DeviceCloud<pcl::PointXYZRGB>::Ptr cloud = in_device_cloud_xyzrgb.read();
+	writeDevice<pcl::PointXYZRGB>(pass_through ? cloud : filterDevice<pcl::PointXYZRGB>(cloud), out_cloud_xyzrgb, out_device_cloud_xyzrgb);
+}
+
+void VoxelGrid::filter_device_normal() {
+	CLOG(LTRACE) << "VoxelGrid::filter_device_normal";
+	Types::DeviceCloud<pcl::PointXYZRGBNormal>::Ptr cloud = in_device_cloud_xyzrgb_normal.read();
+	writeDevice<pcl::PointXYZRGBNormal>(pass_through ? cloud : filterDevice<pcl::PointXYZRGBNormal>(cloud), out_cloud_xyzrgb_normal, out_device_cloud_xyzrgb_normal);
+}
+
+void VoxelGrid::filter_clouds_xyz() {
+	CLOG(LTRACE) << "VoxelGrid::filter_clouds_xyz";
+	filterBatch<pcl::PointXYZ>(in_clouds_xyz, out_clouds_xyz, &batch_hash_xyz);
+}
+
+void VoxelGrid::filter_clouds_xyzrgb() {
+	CLOG(LTRACE) << "VoxelGrid::filter_clouds_xyzrgb";
+	filterBatch<pcl::PointXYZRGB>(in_clouds_xyzrgb, out_clouds_xyzrgb, std::string(mode) == "hash" ? &batch_hash_xyzrgb : NULL);
+}
+
 } //: namespace VoxelGrid
 } //: namespace Processors
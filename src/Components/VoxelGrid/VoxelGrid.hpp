@@ -13,10 +13,18 @@
 #include "Property.hpp"
 #include "EventHandler2.hpp"
 
+#include "Types/HandlerProfiler.hpp"
+
 //#include <Types/PointXYZSIFT.hpp>
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 
+#include <Types/PointXYZSIFT.hpp>
+#include <Types/PointXYZSHOT.hpp>
+
+#include "Types/DeviceCloud.hpp"
+#include "Types/HashVoxelGrid.hpp"
+
 
 namespace Processors {
 namespace VoxelGrid {
@@ -73,20 +81,101 @@ protected:
 	// Input data streams
 	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
 	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr> in_cloud_xyzrgb_normal;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_cloud_xyz;
+	Base::DataStreamIn<pcl::PointCloud<PointXYZSIFT>::Ptr> in_cloud_xyzsift;
+	Base::DataStreamIn<pcl::PointCloud<PointXYZSHOT>::Ptr> in_cloud_xyzshot;
+	Base::DataStreamIn<Types::DeviceCloud<pcl::PointXYZRGB>::Ptr> in_device_cloud_xyzrgb;
+	Base::DataStreamIn<Types::DeviceCloud<pcl::PointXYZRGBNormal>::Ptr> in_device_cloud_xyzrgb_normal;
+	Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > in_clouds_xyz;
+	Base::DataStreamIn<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > in_clouds_xyzrgb;
 
 	// Output data streams
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
 	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr> out_cloud_xyzrgb_normal;
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<pcl::PointCloud<PointXYZSIFT>::Ptr> out_cloud_xyzsift;
+	Base::DataStreamOut<pcl::PointCloud<PointXYZSHOT>::Ptr> out_cloud_xyzshot;
+	Base::DataStreamOut<Types::DeviceCloud<pcl::PointXYZRGB>::Ptr> out_device_cloud_xyzrgb;
+	Base::DataStreamOut<Types::DeviceCloud<pcl::PointXYZRGBNormal>::Ptr> out_device_cloud_xyzrgb_normal;
+	Base::DataStreamOut<std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> > out_clouds_xyz;
+	Base::DataStreamOut<std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> > out_clouds_xyzrgb;
 
 	// Handlers
 	Base::Property<float> x;
 	Base::Property<float> y;
 	Base::Property<float> z;
 	Base::Property<bool> pass_through;
+
+	/// Property: voxelization engine - pcl (pcl::VoxelGrid) or hash (Types::HashVoxelGrid, no extent limit). XYZ, XYZSIFT and XYZSHOT clouds are always filtered by hash.
+	Base::Property<std::string> mode;
+
+	/// Property: point representing a voxel in hash mode - centroid, first or nearest (to the centroid).
+	Base::Property<std::string> policy;
+
+	/// Property: filter on the GPU (needs build with CUDA), results are also written to device cloud outputs.
+	Base::Property<bool> gpu;
+
+	/// Property: download results of the GPU to host cloud outputs - disable when only GPU components consume them.
+	Base::Property<bool> gpu_download;
 	
 	// Handlers
 	void filter();
 	void filter_normal();
+	void filter_device();
+	void filter_xyz();
+	void filter_xyzsift();
+	void filter_xyzshot();
+	void filter_device_normal();
+	void filter_clouds_xyz();
+	void filter_clouds_xyzrgb();
+
+	/// Filters the cloud on the CPU.
+	template <typename PointT>
+	typename pcl::PointCloud<PointT>::Ptr filterHost(const typename pcl::PointCloud<PointT>::Ptr & cloud);
+
+	/// Hash engine of the point type.
+	Types::HashVoxelGrid<pcl::PointXYZRGB> & hash(pcl::PointXYZRGB *) { return hash_xyzrgb; }
+	Types::HashVoxelGrid<pcl::PointXYZRGBNormal> & hash(pcl::PointXYZRGBNormal *) { return hash_xyzrgb_normal; }
+
+	/// Filters the cloud with the hash engine.
+	template <typename PointT>
+	typename pcl::PointCloud<PointT>::Ptr filterHash(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::HashVoxelGrid<PointT> & grid);
+
+	/// Hash engines of all point types, buffers are reused between frames.
+	Types::HashVoxelGrid<pcl::PointXYZ> hash_xyz;
+	Types::HashVoxelGrid<pcl::PointXYZRGB> hash_xyzrgb;
+	Types::HashVoxelGrid<pcl::PointXYZRGBNormal> hash_xyzrgb_normal;
+	Types::HashVoxelGrid<PointXYZSIFT> hash_xyzsift;
+	Types::HashVoxelGrid<PointXYZSHOT> hash_xyzshot;
+
+	/// Filters all clouds of the vector (e.g. clusters) in parallel on the CPU, with hash engines of threads if hash is set.
+	template <typename PointT>
+	void filterBatch(Base::DataStreamIn<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & in,
+			Base::DataStreamOut<std::vector<typename pcl::PointCloud<PointT>::Ptr> > & out,
+			std::vector<Types::HashVoxelGrid<PointT> > * grids);
+
+	/// Hash engines of threads filtering vectors of clouds.
+	std::vector<Types::HashVoxelGrid<pcl::PointXYZ> > batch_hash_xyz;
+	std::vector<Types::HashVoxelGrid<pcl::PointXYZRGB> > batch_hash_xyzrgb;
+
+	/// Filters the device cloud on the GPU (on the CPU in builds without CUDA).
+	template <typename PointT>
+	typename Types::DeviceCloud<PointT>::Ptr filterDevice(const typename Types::DeviceCloud<PointT>::Ptr & cloud);
+
+	/// Writes the device cloud and, if enabled, its host copy.
+	template <typename PointT>
+	void writeDevice(const typename Types::DeviceCloud<PointT>::Ptr & cloud,
+			Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out,
+			Base::DataStreamOut<typename Types::DeviceCloud<PointT>::Ptr> & out_device);
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
 
 };
 
@@ -0,0 +1,135 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "VoxelMap.hpp"
+#include "Common/Logger.hpp"
+
+#include <boost/bind.hpp>
+
+#include "Types/CloudPool.hpp"
+
+namespace Processors {
+namespace VoxelMap {
+
+VoxelMap::VoxelMap(const std::string & name) :
+		Base::Component(name) ,
+		x("LeafSize.x", 0.01f),
+		y("LeafSize.y", 0.01f),
+		z("LeafSize.z", 0.01f),
+		inverse("inverse", false),
+		max_weight("max_weight", 0),
+		publish("publish", std::string("map")),
+		profile("profile", false),
+		profile_period("profile.period", 100),
+		profiler(name) {
+	registerProperty(x);
+	registerProperty(y);
+	registerProperty(z);
+	registerProperty(inverse);
+	registerProperty(max_weight);
+	registerProperty(publish);
+	registerProperty(profile);
+	registerProperty(profile_period);
+
+	pose = Eigen::Matrix4f::Identity();
+}
+
+VoxelMap::~VoxelMap() {
+}
+
+void VoxelMap::prepareInterface() {
+	// Register data streams, events and event handlers HERE!
+	registerStream("in_cloud_xyz", &in_cloud_xyz);
+	registerStream("in_cloud_xyzrgb", &in_cloud_xyzrgb);
+	registerStream("in_hm", &in_hm);
+	registerStream("out_cloud_xyz", &out_cloud_xyz);
+	registerStream("out_cloud_xyzrgb", &out_cloud_xyzrgb);
+	registerStream("out_changes_xyz", &out_changes_xyz);
+	registerStream("out_changes_xyzrgb", &out_changes_xyzrgb);
+
+	// Register handlers
+	registerHandler("integrate_xyz", profiler.wrap("integrate_xyz", boost::bind(&VoxelMap::integrate_xyz, this)));
+	addDependency("integrate_xyz", &in_cloud_xyz);
+	registerHandler("integrate_xyzrgb", profiler.wrap("integrate_xyzrgb", boost::bind(&VoxelMap::integrate_xyzrgb, this)));
+	addDependency("integrate_xyzrgb", &in_cloud_xyzrgb);
+}
+
+bool VoxelMap::onInit() {
+	profiler.setEnabled(profile, profile_period);
+	const std::string p = publish;
+	if (p != "map" && p != "changes" && p != "both")
+		CLOG(LWARNING) << "Unknown publish mode " << p << ", publishing map";
+
+	return true;
+}
+
+bool VoxelMap::onFinish() {
+	profiler.report();
+	return true;
+}
+
+bool VoxelMap::onStop() {
+	return true;
+}
+
+bool VoxelMap::onStart() {
+	return true;
+}
+
+template <typename PointT>
+void VoxelMap::integrate(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::VoxelMap<PointT> & map,
+		Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out_map,
+		Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out_changes) {
+	if (!cloud)
+		return;
+
+	// Pose of the cloud, kept until the next one arrives.
+	if (!in_hm.empty()) {
+		Types::HomogMatrix hm = in_hm.read();
+		if (inverse) {
+			Types::HomogMatrix hmi(hm.inverse());
+			hm = hmi;
+		}
+		pose = hm;
+	}
+
+	map.setLeafSize(x, y, z);
+	map.setMaxWeight(std::max(0, (int) max_weight));
+	const size_t touched = map.integrate(*cloud, pose);
+	CLOG(LINFO) << "Cloud of " << cloud->size() << " points touched " << touched << " of " << map.size() << " voxels";
+	profiler.points(cloud->size(), touched);
+
+	const std::string p = publish;
+	if (p != "changes") {
+		typename pcl::PointCloud<PointT>::Ptr output = Types::CloudPool<PointT>::acquire(map.size());
+		map.map(*output);
+		output->header = cloud->header;
+		out_map.write(output);
+	}
+	if (p == "changes" || p == "both") {
+		typename pcl::PointCloud<PointT>::Ptr output = Types::CloudPool<PointT>::acquire(touched);
+		map.changes(*output);
+		output->header = cloud->header;
+		out_changes.write(output);
+	}
+}
+
+void VoxelMap::integrate_xyz() {
+	CLOG(LTRACE) << "VoxelMap::integrate_xyz";
+	integrate<pcl::PointXYZ>(in_cloud_xyz.read(), map_xyz, out_cloud_xyz, out_changes_xyz);
+}
+
+void VoxelMap::integrate_xyzrgb() {
+	CLOG(LTRACE) << "VoxelMap::integrate_xyzrgb";
+	integrate<pcl::PointXYZRGB>(in_cloud_xyzrgb.read(), map_xyzrgb, out_cloud_xyzrgb, out_changes_xyzrgb);
+}
+
+} //: namespace VoxelMap
+} //: namespace Processors
@@ -0,0 +1,145 @@
+/*!
+ * \file
+ * \brief
+ * \author Micha Laszkowski
+ */
+
+#ifndef VOXELMAP_COMPONENT_HPP_
+#define VOXELMAP_COMPONENT_HPP_
+
+#include "Component_Aux.hpp"
+#include "Component.hpp"
+#include "DataStream.hpp"
+#include "Property.hpp"
+#include "EventHandler2.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <Types/HomogMatrix.hpp>
+
+#include "Types/VoxelMap.hpp"
+
+
+namespace Processors {
+namespace VoxelMap {
+
+/*!
+ * \class VoxelMap
+ * \brief VoxelMap processor class.
+ *
+ * Fuses successive clouds into a persistent voxel map of the scene. Every
+ * cloud is transformed by the latest in_hm (identity until one arrives) and
+ * only the voxels it touches are updated. Outputs the whole map and/or the
+ * voxels changed by the last cloud.
+ */
+class VoxelMap: public Base::Component {
+public:
+	/*!
+	 * Constructor.
+	 */
+	VoxelMap(const std::string & name = "VoxelMap");
+
+	/*!
+	 * Destructor
+	 */
+	virtual ~VoxelMap();
+
+	/*!
+	 * Prepare components interface (register streams and handlers).
+	 * At this point, all properties are already initialized and loaded to
+	 * values set in config file.
+	 */
+	void prepareInterface();
+
+protected:
+
+	/*!
+	 * Connects source to given device.
+	 */
+	bool onInit();
+
+	/*!
+	 * Disconnect source from device, closes streams, etc.
+	 */
+	bool onFinish();
+
+	/*!
+	 * Start component
+	 */
+	bool onStart();
+
+	/*!
+	 * Stop component
+	 */
+	bool onStop();
+
+
+	// Input data streams
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr> in_cloud_xyz;
+	Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> in_cloud_xyzrgb;
+	Base::DataStreamIn<Types::HomogMatrix, Base::DataStreamBuffer::Newest> in_hm;
+
+	// Output data streams - whole map
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_cloud_xyz;
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_cloud_xyzrgb;
+
+	// Output data streams - voxels changed by the last cloud
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZ>::Ptr> out_changes_xyz;
+	Base::DataStreamOut<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> out_changes_xyzrgb;
+
+	// Properties
+	Base::Property<float> x;
+	Base::Property<float> y;
+	Base::Property<float> z;
+
+	/// Property: use inverse of in_hm, as in CloudTransformer.
+	Base::Property<bool> inverse;
+
+	/// Property: points after which a voxel starts to forget old ones (follows changes of the scene), 0 - never.
+	Base::Property<int> max_weight;
+
+	/// Property: what is published after every cloud - map, changes or both.
+	Base::Property<std::string> publish;
+
+	// Handlers
+	void integrate_xyz();
+	void integrate_xyzrgb();
+
+	/// Integrates the cloud into the map and writes the outputs.
+	template <typename PointT>
+	void integrate(const typename pcl::PointCloud<PointT>::Ptr & cloud, Types::VoxelMap<PointT> & map,
+			Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out_map,
+			Base::DataStreamOut<typename pcl::PointCloud<PointT>::Ptr> & out_changes);
+
+	/// Maps of all point types.
+	Types::VoxelMap<pcl::PointXYZ> map_xyz;
+	Types::VoxelMap<pcl::PointXYZRGB> map_xyzrgb;
+
+	/// Latest pose of clouds.
+	Eigen::Matrix4f pose;
+
+	/// Property: measure handlers - latency, throughput, points and cloud pool misses.
+	Base::Property<bool> profile;
+
+	/// Property: calls of a handler between logged statistics, 0 - only when the task finishes.
+	Base::Property<int> profile_period;
+
+	/// Statistics of handlers.
+	Types::HandlerProfiler profiler;
+
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} //: namespace VoxelMap
+} //: namespace Processors
+
+/*
+ * Register processor component.
+ */
+REGISTER_COMPONENT("VoxelMap", Processors::VoxelMap::VoxelMap)
+
+#endif /* VOXELMAP_COMPONENT_HPP_ */
@@ -0,0 +1,282 @@
+/*!
+ * \file
+ * \brief Fused, single-pass crop of point clouds to an axis-aligned box.
+ * \author Micha Laszkowski
+ */
+
+#ifndef BOXCROP_HPP_
+#define BOXCROP_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/SoACloud.hpp"
+
+namespace Types {
+
+/*!
+ * Compile-time accessors of point coordinates, resolved without
+ * pcl::getFieldIndex or copying through field offsets. Work for every
+ * point type with x/y/z members (PointXYZ, PointXYZRGB, PointXYZSIFT, PointXYZSHOT...).
+ */
+namespace Fields {
+
+struct X {
+	static const int axis = 0;
+	template <typename PointT> static float get(const PointT & p) { return p.x; }
+};
+
+struct Y {
+	static const int axis = 1;
+	template <typename PointT> static float get(const PointT & p) { return p.y; }
+};
+
+struct Z {
+	static const int axis = 2;
+	template <typename PointT> static float get(const PointT & p) { return p.z; }
+};
+
+/// Branch-free test of a value against [min, max] range, non-finite values fail.
+inline int inRange(float v, float min, float max, int negative) {
+	int finite = std::fabs(v) <= FLT_MAX;
+	int inside = (v >= min) & (v <= max);
+	return finite & (inside ^ negative);
+}
+
+/// As above, for a single field of the point.
+template <typename Field, typename PointT>
+inline int inRange(const PointT & p, float min, float max, int negative) {
+	return inRange(Field::get(p), min, max, negative);
+}
+
+/// Branch-free test that all coordinates are finite.
+template <typename PointT>
+inline int finite(const PointT & p) {
+	return (std::fabs(p.x) <= FLT_MAX) & (std::fabs(p.y) <= FLT_MAX) & (std::fabs(p.z) <= FLT_MAX);
+}
+
+} //: namespace Fields
+
+/*!
+ * \class BoxCrop
+ * \brief Tests all three axes of every point at once and keeps survivors.
+ *
+ * Equivalent to three chained pcl::PassThrough filters (x, then y, then z),
+ * each with its own limits and negative flag, but done in one pass over the
+ * input, with no intermediate clouds. Non-finite points are always removed.
+ * Per-point predicate is branch-free, so the test loop vectorizes;
+ * survivors are then written once.
+ */
+class BoxCrop {
+public:
+	/// Number of points tested in one block.
+	static const int BLOCK = 1024;
+
+	BoxCrop() {
+		for (int a = 0; a < 3; ++a) {
+			min_[a] = -FLT_MAX;
+			max_[a] = FLT_MAX;
+			negative_[a] = 0;
+		}
+	}
+
+	/*!
+	 * Sets limits of the given axis (0 - x, 1 - y, 2 - z).
+	 * Points with min <= value <= max pass, if negative is set - only points outside of the range.
+	 */
+	void setLimits(int axis, float min, float max, bool negative = false) {
+		min_[axis] = min;
+		max_[axis] = max;
+		negative_[axis] = negative;
+	}
+
+	/// Gets limits of the given axis.
+	void getLimits(int axis, float & min, float & max, bool & negative) const {
+		min = min_[axis];
+		max = max_[axis];
+		negative = negative_[axis];
+	}
+
+	/// Checks whether limits of the axis reject any finite value, i.e. the axis has to be tested.
+	bool bounded(int axis) const {
+		return negative_[axis] || min_[axis] > -FLT_MAX || max_[axis] < FLT_MAX;
+	}
+
+	/// Computes indices of points that pass the filter.
+	template <typename PointT>
+	void filter(const pcl::PointCloud<PointT> & input, std::vector<int> & indices) const {
+		indices.resize(input.size() + 1);
+		size_t n = 0;
+		forEachBlock(input, Emitter(&indices[0], n));
+		indices.resize(n);
+	}
+
+	/*!
+	 * Filters the input cloud, output must not be the input.
+	 * Small points are compacted directly, big ones (e.g. with descriptors)
+	 * are gathered through index list to avoid copying rejected points.
+	 */
+	template <typename PointT>
+	void filter(const pcl::PointCloud<PointT> & input, pcl::PointCloud<PointT> & output) const {
+		filterCloud(input, output, *this);
+	}
+
+	/*!
+	 * Filters the SoA cloud, output must not be the input. Only the
+	 * coordinate arrays are read, records of the points stay in the source.
+	 */
+	template <typename PointT>
+	void filter(const SoACloud<PointT> & input, SoACloud<PointT> & output) const {
+		const size_t size = input.size();
+		// One spare element for the branch-free write past the last survivor.
+		output.reset(input, size + 1);
+		const float * x = input.x(), * y = input.y(), * z = input.z();
+		unsigned char flags[BLOCK];
+		size_t n = 0;
+		for (size_t start = 0; start < size; start += BLOCK) {
+			const int count = std::min<size_t>(BLOCK, size - start);
+			for (int j = 0; j < count; ++j)
+				flags[j] = Fields::inRange(x[start + j], min_[0], max_[0], negative_[0]) &
+						Fields::inRange(y[start + j], min_[1], max_[1], negative_[1]) &
+						Fields::inRange(z[start + j], min_[2], max_[2], negative_[2]);
+			for (int j = 0; j < count; ++j) {
+				output.copyPoint(input, start + j, n);
+				n += flags[j];
+			}
+		}
+		output.resize(n);
+		output.setDense(true);
+	}
+
+protected:
+	/// Writes index of every point, advancing only for survivors.
+	struct Emitter {
+		Emitter(int * out_, size_t & n_) : out(out_), n(n_) {}
+		void operator()(size_t i, unsigned char keep) const {
+			out[n] = i;
+			n += keep;
+		}
+		int * out;
+		size_t & n;
+	};
+
+	/// Copies every point, advancing only for survivors.
+	template <typename PointT>
+	struct Compactor {
+		Compactor(const PointT * in_, PointT * out_, size_t & n_) : in(in_), out(out_), n(n_) {}
+		void operator()(size_t i, unsigned char keep) const {
+			out[n] = in[i];
+			n += keep;
+		}
+		const PointT * in;
+		PointT * out;
+		size_t & n;
+	};
+
+	/// Predicate of a single point, evaluated without branches.
+	template <typename PointT>
+	inline unsigned char keep(const PointT & p) const {
+		return Fields::inRange<Fields::X>(p, min_[0], max_[0], negative_[0]) &
+				Fields::inRange<Fields::Y>(p, min_[1], max_[1], negative_[1]) &
+				Fields::inRange<Fields::Z>(p, min_[2], max_[2], negative_[2]);
+	}
+
+	/// Evaluates predicate block by block, then passes flags to the writer.
+	template <typename PointT, typename Writer>
+	void forEachBlock(const pcl::PointCloud<PointT> & input, const Writer & writer) const {
+		forEachBlock(input, writer, *this);
+	}
+
+	/// As above, for any predicate object with keep(point) method.
+	template <typename PointT, typename Writer, typename Predicate>
+	static void forEachBlock(const pcl::PointCloud<PointT> & input, const Writer & writer, const Predicate & predicate) {
+		unsigned char flags[BLOCK];
+		const size_t size = input.size();
+		const PointT * pts = size ? &input.points[0] : NULL;
+		for (size_t start = 0; start < size; start += BLOCK) {
+			const int count = std::min<size_t>(BLOCK, size - start);
+			for (int j = 0; j < count; ++j)
+				flags[j] = predicate.keep(pts[start + j]);
+			for (int j = 0; j < count; ++j)
+				writer(start + j, flags[j]);
+		}
+	}
+
+	/// Copies cloud metadata and survivors (given by writer pass) into output.
+	template <typename PointT, typename Predicate>
+	static void filterCloud(const pcl::PointCloud<PointT> & input, pcl::PointCloud<PointT> & output, const Predicate & predicate) {
+		output.header = input.header;
+		output.sensor_origin_ = input.sensor_origin_;
+		output.sensor_orientation_ = input.sensor_orientation_;
+
+		size_t n = 0;
+		if (sizeof(PointT) <= 32) {
+			// One spare element for the branch-free write past the last survivor.
+			output.points.resize(input.size() + 1);
+			forEachBlock(input, Compactor<PointT>(input.empty() ? NULL : &input.points[0], &output.points[0], n), predicate);
+			output.points.resize(n);
+		} else {
+			std::vector<int> indices(input.size() + 1);
+			forEachBlock(input, Emitter(&indices[0], n), predicate);
+			output.points.resize(n);
+			for (size_t i = 0; i < n; ++i)
+				output.points[i] = input.points[indices[i]];
+		}
+
+		output.width = n;
+		output.height = 1;
+		output.is_dense = true;
+	}
+
+	template <typename Field> friend class FieldRange;
+
+	float min_[3], max_[3];
+	int negative_[3];
+};
+
+/*!
+ * \class FieldRange
+ * \brief Single-field pass-through filter, with the field fixed at compile time.
+ *
+ * Drop-in replacement of pcl::PassThrough for one coordinate, e.g.
+ * Types::FieldRange<Types::Fields::Z>(0.5, 1.5).filter(*input, *output).
+ * Non-finite points are removed, like in pcl::PassThrough.
+ */
+template <typename Field>
+class FieldRange {
+public:
+	FieldRange(float min = -FLT_MAX, float max = FLT_MAX, bool negative = false) :
+		min_(min), max_(max), negative_(negative) {}
+
+	template <typename PointT>
+	inline unsigned char keep(const PointT & p) const {
+		return Fields::finite(p) & Fields::inRange<Field>(p, min_, max_, negative_);
+	}
+
+	/// Computes indices of points that pass the filter.
+	template <typename PointT>
+	void filter(const pcl::PointCloud<PointT> & input, std::vector<int> & indices) const {
+		indices.resize(input.size() + 1);
+		size_t n = 0;
+		BoxCrop::forEachBlock(input, BoxCrop::Emitter(&indices[0], n), *this);
+		indices.resize(n);
+	}
+
+	/// Filters the input cloud, output must not be the input.
+	template <typename PointT>
+	void filter(const pcl::PointCloud<PointT> & input, pcl::PointCloud<PointT> & output) const {
+		BoxCrop::filterCloud(input, output, *this);
+	}
+
+private:
+	float min_, max_;
+	int negative_;
+};
+
+} //: namespace Types
+
+#endif /* BOXCROP_HPP_ */
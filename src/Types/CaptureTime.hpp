@@ -0,0 +1,76 @@
+/*!
+ * \file
+ * \brief Capture time of clouds carried along processing chains.
+ * \author Micha Laszkowski
+ */
+
+#ifndef CAPTURETIME_HPP_
+#define CAPTURETIME_HPP_
+
+#include <vector>
+#include <stdint.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/IndexedCloud.hpp"
+#include "Types/DeviceCloud.hpp"
+
+namespace Types {
+
+/*!
+ * Capture time of clouds, kept in header.stamp (microseconds since the
+ * epoch, as PCL stores it). Sources take the time when they acquire the data
+ * - read the sensor images, start generating or loading a cloud - and stamp
+ * the clouds they make with it, so conversion in the source counts in the
+ * age. Processors copy headers of their inputs, so the stamp travels along
+ * the chain. Images carry no stamps, so for clouds converted from them the
+ * capture time is when the converter read the images.
+ */
+namespace CaptureTime {
+
+/// Current time in units of header.stamp.
+inline uint64_t now() {
+	static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+	return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds();
+}
+
+/// Stamps the cloud with the time its data was acquired, if it has no stamp yet.
+template <typename PointT>
+inline void stamp(pcl::PointCloud<PointT> & cloud, uint64_t captured) {
+	if (cloud.header.stamp == 0)
+		cloud.header.stamp = captured;
+}
+
+/// Capture time of what a stream carries, 0 for data without stamps.
+template <typename T>
+inline uint64_t of(const T &) {
+	return 0;
+}
+
+template <typename PointT>
+inline uint64_t of(const boost::shared_ptr<pcl::PointCloud<PointT> > & cloud) {
+	return cloud ? cloud->header.stamp : 0;
+}
+
+template <typename PointT>
+inline uint64_t of(const boost::shared_ptr<IndexedCloud<PointT> > & input) {
+	return input && input->cloud() ? input->cloud()->header.stamp : 0;
+}
+
+template <typename PointT>
+inline uint64_t of(const boost::shared_ptr<DeviceCloud<PointT> > & cloud) {
+	return cloud ? cloud->header.stamp : 0;
+}
+
+template <typename PointT>
+inline uint64_t of(const std::vector<boost::shared_ptr<pcl::PointCloud<PointT> > > & clouds) {
+	return clouds.empty() ? 0 : of(clouds.front());
+}
+
+} //: namespace CaptureTime
+
+} //: namespace Types
+
+#endif /* CAPTURETIME_HPP_ */
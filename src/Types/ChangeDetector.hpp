@@ -0,0 +1,238 @@
+/*!
+ * \file
+ * \brief Detection of changes between clouds of a static camera.
+ * \author Micha Laszkowski
+ */
+
+#ifndef CHANGEDETECTOR_HPP_
+#define CHANGEDETECTOR_HPP_
+
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/VoxelHash.hpp"
+
+namespace Types {
+
+/*!
+ * \class ChangeDetector
+ * \brief Double-buffered voxel occupancy compared frame to reference frame.
+ *
+ * Works like pcl::octree::OctreePointCloudChangeDetector, with the voxel
+ * hash of HashVoxelGrid and VoxelMap instead of an octree: every cloud fills
+ * the occupancy of its voxels (voxels with at least min points points) in
+ * one buffer, which is compared with the other one, holding the reference
+ * frame. Voxels occupied only in the new frame are new (their points are the
+ * changed points), voxels occupied only in the reference one are vanished.
+ *
+ * The scene is changed if new and vanished voxels make at least the given
+ * fraction of occupied voxels (and at least min voxels of them). Only then
+ * the buffers are swapped and the new frame becomes the reference, so slow
+ * drifts accumulate until they are reported instead of being lost between
+ * consecutive frames. The first frame is always changed.
+ *
+ * Non-finite points are ignored.
+ */
+class ChangeDetector {
+public:
+	ChangeDetector() : min_points_(1), fraction_(0.01), min_voxels_(1), reference_(0), first_(true),
+			last_(1), compared_(0), compared_first_(true), new_(0), vanished_(0), occupied_(0) {
+		inverse_[0] = inverse_[1] = inverse_[2] = 100.0;
+	}
+
+	/// Sets size of voxels, the reference is dropped when it changes.
+	void setLeafSize(float x, float y, float z) {
+		const double inverse[3] = { 1.0 / x, 1.0 / y, 1.0 / z };
+		if (inverse[0] == inverse_[0] && inverse[1] == inverse_[1] && inverse[2] == inverse_[2])
+			return;
+		for (int a = 0; a < 3; ++a)
+			inverse_[a] = inverse[a];
+		reset();
+	}
+
+	/// Sets points making a voxel occupied, more filter out sensor noise.
+	void setMinPoints(int points) {
+		min_points_ = std::max(points, 1);
+	}
+
+	/// Sets fraction and least number of changed voxels making the scene changed.
+	void setThreshold(double fraction, int voxels) {
+		fraction_ = fraction;
+		min_voxels_ = std::max(voxels, 1);
+	}
+
+	/// Drops the reference, the next frame is changed.
+	void reset() {
+		first_ = true;
+	}
+
+	/*!
+	 * Compares the cloud with the reference. Indices of points of new voxels
+	 * are written to changed. Returns true if the scene changed.
+	 */
+	template <typename PointT>
+	bool detect(const pcl::PointCloud<PointT> & cloud, std::vector<int> & changed) {
+		last_ = 1 - reference_;
+		compared_ = reference_;
+		compared_first_ = first_;
+		Buffer & current = buffers_[last_];
+		const Buffer & reference = buffers_[compared_];
+		current.clear(first_ ? cloud.size() / 4 : reference.keys.size());
+
+		// Voxel of every point and points of every voxel.
+		voxel_.resize(cloud.size());
+		for (size_t i = 0; i < cloud.size(); ++i) {
+			const PointT & p = cloud.points[i];
+			if (!finite(p.x) || !finite(p.y) || !finite(p.z)) {
+				voxel_[i] = -1;
+				continue;
+			}
+			Key key;
+			VoxelHash::key(p.x, p.y, p.z, inverse_, key.k);
+			bool inserted;
+			const int v = current.table.insert(key.k, inserted);
+			if (inserted) {
+				current.keys.push_back(key);
+				current.points.push_back(0);
+			}
+			++current.points[v];
+			voxel_[i] = v;
+		}
+
+		// New voxels of the frame.
+		is_new_.assign(current.keys.size(), false);
+		new_ = occupied_ = 0;
+		for (size_t v = 0; v < current.keys.size(); ++v) {
+			if (current.points[v] < min_points_)
+				continue;
+			++occupied_;
+			if (first_ || !reference.occupied(current.keys[v].k, min_points_)) {
+				is_new_[v] = true;
+				++new_;
+			}
+		}
+
+		// Vanished voxels of the reference.
+		vanished_ = 0;
+		size_t reference_occupied = 0;
+		if (!first_) {
+			for (size_t v = 0; v < reference.keys.size(); ++v) {
+				if (reference.points[v] < min_points_)
+					continue;
+				++reference_occupied;
+				if (!current.occupied(reference.keys[v].k, min_points_))
+					++vanished_;
+			}
+		}
+
+		changed.clear();
+		for (size_t i = 0; i < voxel_.size(); ++i)
+			if (voxel_[i] >= 0 && is_new_[voxel_[i]])
+				changed.push_back(i);
+
+		const size_t voxels = new_ + vanished_;
+		const bool scene_changed = first_ || (voxels >= (size_t) min_voxels_
+				&& voxels >= fraction_ * std::max(occupied_, reference_occupied));
+		if (scene_changed) {
+			reference_ = 1 - reference_;
+			first_ = false;
+		}
+		return scene_changed;
+	}
+
+	/// Integer coordinates of the voxel containing the point.
+	void key(float x, float y, float z, int64_t key[3]) const {
+		VoxelHash::key(x, y, z, inverse_, key);
+	}
+
+	/*!
+	 * Appends coordinates (three per voxel) of voxels new or vanished in the
+	 * last frame, all its occupied voxels in the first frame. Every voxel is
+	 * appended once: new ones are taken from the frame, vanished ones from the
+	 * reference, with the occupancy test of detect() (at least min_points
+	 * points) on both sides.
+	 */
+	void changedVoxels(std::vector<int64_t> & keys) const {
+		const Buffer & current = buffers_[last_];
+		const Buffer & reference = buffers_[compared_];
+		for (size_t v = 0; v < current.keys.size(); ++v)
+			if (current.points[v] >= min_points_ && (compared_first_ || !reference.occupied(current.keys[v].k, min_points_)))
+				keys.insert(keys.end(), current.keys[v].k, current.keys[v].k + 3);
+		if (compared_first_)
+			return;
+		for (size_t v = 0; v < reference.keys.size(); ++v)
+			if (reference.points[v] >= min_points_ && !current.occupied(reference.keys[v].k, min_points_))
+				keys.insert(keys.end(), reference.keys[v].k, reference.keys[v].k + 3);
+	}
+
+	/// Voxels occupied in the last frame but not in the reference.
+	size_t newVoxels() const {
+		return new_;
+	}
+
+	/// Voxels occupied in the reference but not in the last frame.
+	size_t vanishedVoxels() const {
+		return vanished_;
+	}
+
+	/// Occupied voxels of the last frame.
+	size_t occupiedVoxels() const {
+		return occupied_;
+	}
+
+private:
+	struct Key {
+		int64_t k[3];
+	};
+
+	/// Occupancy of one frame.
+	struct Buffer {
+		void clear(size_t expected) {
+			table.clear(expected);
+			keys.clear();
+			points.clear();
+		}
+
+		bool occupied(const int64_t key[3], int min_points) const {
+			const int v = table.find(key);
+			return v >= 0 && points[v] >= min_points;
+		}
+
+		VoxelHash table;
+		std::vector<Key> keys;
+		std::vector<int> points;
+	};
+
+	static bool finite(float v) {
+		return std::fabs(v) <= std::numeric_limits<float>::max();
+	}
+
+	double inverse_[3];
+	int min_points_;
+	double fraction_;
+	int min_voxels_;
+
+	/// Buffers of the reference and of the current frame.
+	Buffer buffers_[2];
+	int reference_;
+	bool first_;
+
+	/// Buffers compared by the last detect(), for changedVoxels().
+	int last_, compared_;
+	bool compared_first_;
+
+	/// Per point voxel and per voxel flag of the last frame, kept to avoid allocations.
+	std::vector<int> voxel_;
+	std::vector<bool> is_new_;
+
+	size_t new_, vanished_, occupied_;
+};
+
+} //: namespace Types
+
+#endif /* CHANGEDETECTOR_HPP_ */
@@ -0,0 +1,98 @@
+/*!
+ * \file
+ * \brief Parallel processing of vectors of clouds, e.g. clusters of a scene.
+ * \author Micha Laszkowski
+ */
+
+#ifndef CLOUDBATCH_HPP_
+#define CLOUDBATCH_HPP_
+
+#include <vector>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/CloudPool.hpp"
+#include "Types/ThreadPool.hpp"
+
+namespace Types {
+namespace CloudBatch {
+
+/// Number of threads processing a batch.
+inline int threads() {
+	return ThreadPool::instance().threads();
+}
+
+/// Body of the parallel loop of forEach().
+template <typename F>
+struct Each {
+	explicit Each(F & f) : f(f) {
+	}
+	void operator()(int begin, int end, int slot) const {
+		for (int i = begin; i < end; ++i)
+			f(i, slot);
+	}
+	F & f;
+};
+
+/*!
+ * Calls f(i, thread) for every cloud i of a batch of n, in parallel.
+ *
+ * Clouds are handed out one at a time to threads done with the previous
+ * ones, so a few big clusters do not keep the other threads waiting.
+ * Thread is in [0, threads()), for per-thread state of the functor.
+ * Parallel loops inside the functor (e.g. with parallel set off) run on
+ * the calling thread, clouds of a batch are parallel enough.
+ */
+template <typename F>
+void forEach(int n, F & f) {
+	ThreadPool::parallelFor(0, n, 1, Each<F>(f));
+}
+
+/// Per-cloud body of filter().
+template <typename PointT, typename F>
+struct Filter {
+	Filter(const std::vector<typename pcl::PointCloud<PointT>::Ptr> & input_, std::vector<typename pcl::PointCloud<PointT>::Ptr> & output_, F & f_) :
+		input(input_), output(output_), f(f_) {
+	}
+
+	void operator()(int i, int thread) {
+		if (input[i])
+			f(input[i], *output[i], thread);
+	}
+
+	const std::vector<typename pcl::PointCloud<PointT>::Ptr> & input;
+	std::vector<typename pcl::PointCloud<PointT>::Ptr> & output;
+	F & f;
+};
+
+/*!
+ * Filters every cloud of the batch, f(input, output, thread) with the
+ * output cloud taken from the pool. Missing (NULL) clouds stay missing.
+ * Output clouds are allocated up front, so the parallel part only computes.
+ */
+template <typename PointT, typename F>
+void filter(const std::vector<typename pcl::PointCloud<PointT>::Ptr> & input,
+		std::vector<typename pcl::PointCloud<PointT>::Ptr> & output, F & f) {
+	const int n = input.size();
+	output.resize(n);
+	for (int i = 0; i < n; ++i)
+		output[i] = input[i] ? CloudPool<PointT>::acquire(input[i]->size()) : typename pcl::PointCloud<PointT>::Ptr();
+
+	Filter<PointT, F> body(input, output, f);
+	forEach(n, body);
+}
+
+/// Total number of points of the batch.
+template <typename PointT>
+size_t points(const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds) {
+	size_t n = 0;
+	for (size_t i = 0; i < clouds.size(); ++i)
+		if (clouds[i])
+			n += clouds[i]->size();
+	return n;
+}
+
+} //: namespace CloudBatch
+} //: namespace Types
+
+#endif /* CLOUDBATCH_HPP_ */
@@ -0,0 +1,620 @@
+/*!
+ * \file
+ * \brief Quantized, delta-coded serialization of clouds streamed between nodes.
+ * \author Micha Laszkowski
+ */
+
+#ifndef CLOUDCODEC_HPP_
+#define CLOUDCODEC_HPP_
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <Types/PointXYZSIFT.hpp>
+#include "Types/QuantizedSIFT.hpp"
+
+namespace Types {
+namespace CloudCodec {
+
+/// Encoded frame.
+typedef std::vector<uint8_t> Buffer;
+
+/// "PCLZ", first bytes of every frame.
+const uint32_t MAGIC = 0x5a4c4350;
+const uint8_t VERSION = 1;
+
+/// Largest cloud of a frame, frames claiming more points are rejected before allocating them.
+const size_t MAX_POINTS = 1 << 27;
+
+/// Flags of a frame.
+enum {
+	KEY = 1,       ///< coded without the previous frame
+	LOSSLESS = 2,  ///< coordinates are raw floats
+	DENSE = 4      ///< all points are valid, no mask
+};
+
+/// Properties of an encoded frame, read from its header.
+struct FrameInfo {
+	FrameInfo() : type(0), flags(0), frame(0), timestamp(0), stamp(0), width(0), height(0), valid(0), resolution(0), size(0) {}
+
+	uint8_t type, flags;
+	uint32_t frame;
+
+	/// Time of encoding (microseconds since the epoch, clock of the sender).
+	uint64_t timestamp;
+
+	/// Header of the cloud.
+	uint64_t stamp;
+	std::string frame_id;
+
+	uint32_t width, height, valid;
+	float resolution;
+
+	/// Bytes of the frame.
+	size_t size;
+
+	bool key() const { return (flags & KEY) != 0; }
+	size_t points() const { return (size_t) width * height; }
+};
+
+/*!
+ * Fixed-size attributes of points besides coordinates, with the type
+ * number of the point written to the header. Colors are stored exactly,
+ * SIFT descriptors quantized to 8 bits (see QuantizedSIFT), as stored by
+ * PCDWriter in the sift8 mode.
+ */
+template <typename PointT>
+struct Attributes;
+
+template <>
+struct Attributes<pcl::PointXYZ> {
+	static const uint8_t TYPE = 1;
+	static const int SIZE = 0;
+	static void get(const pcl::PointXYZ &, uint8_t *) {}
+	static void set(pcl::PointXYZ &, const uint8_t *) {}
+};
+
+template <>
+struct Attributes<pcl::PointXYZRGB> {
+	static const uint8_t TYPE = 2;
+	static const int SIZE = 4;
+	static void get(const pcl::PointXYZRGB & p, uint8_t * a) {
+		memcpy(a, &p.rgba, SIZE);
+	}
+	static void set(pcl::PointXYZRGB & p, const uint8_t * a) {
+		memcpy(&p.rgba, a, SIZE);
+	}
+};
+
+template <>
+struct Attributes<PointXYZSIFT> {
+	static const uint8_t TYPE = 3;
+	static const int SIZE = 12 + QuantizedSIFT::LENGTH;
+	static void get(const PointXYZSIFT & p, uint8_t * a) {
+		PointXYZSIFT8 q;
+		QuantizedSIFT::quantize(p, q);
+		memcpy(a, &q.multiplicity, 4);
+		memcpy(a + 4, &q.pointId, 4);
+		memcpy(a + 8, &q.scale, 4);
+		memcpy(a + 12, q.descriptor, QuantizedSIFT::LENGTH);
+	}
+	static void set(PointXYZSIFT & p, const uint8_t * a) {
+		PointXYZSIFT8 q;
+		q.x = p.x;
+		q.y = p.y;
+		q.z = p.z;
+		q.data[3] = 1;
+		memcpy(&q.multiplicity, a, 4);
+		memcpy(&q.pointId, a + 4, 4);
+		memcpy(&q.scale, a + 8, 4);
+		memcpy(q.descriptor, a + 12, QuantizedSIFT::LENGTH);
+		QuantizedSIFT::dequantize(q, p);
+	}
+};
+
+namespace detail {
+
+inline void putVarint(Buffer & b, uint64_t v) {
+	while (v >= 0x80) {
+		b.push_back((uint8_t) (v | 0x80));
+		v >>= 7;
+	}
+	b.push_back((uint8_t) v);
+}
+
+inline bool getVarint(const uint8_t * & p, const uint8_t * end, uint64_t & v) {
+	v = 0;
+	for (int shift = 0; shift < 64 && p < end; shift += 7) {
+		const uint8_t byte = *p++;
+		v |= (uint64_t) (byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+inline uint64_t zigzag(int64_t v) {
+	return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v) {
+	return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+/// Little-endian fixed-size values (hosts are assumed little-endian, as x86 and ARM Linux).
+template <typename T>
+inline void put(Buffer & b, const T & v) {
+	const size_t s = b.size();
+	b.resize(s + sizeof(T));
+	memcpy(&b[s], &v, sizeof(T));
+}
+
+template <typename T>
+inline bool get(const uint8_t * & p, const uint8_t * end, T & v) {
+	if (end - p < (ptrdiff_t) sizeof(T))
+		return false;
+	memcpy(&v, p, sizeof(T));
+	p += sizeof(T);
+	return true;
+}
+
+/*!
+ * Zero runs of bytes: pairs of varints (zeros, literals) followed by the
+ * literal bytes. Delta frames of static scenes are mostly zeros.
+ */
+inline void putBytes(Buffer & b, const uint8_t * data, size_t n) {
+	size_t i = 0;
+	while (i < n) {
+		size_t zeros = 0;
+		while (i + zeros < n && data[i + zeros] == 0)
+			++zeros;
+		i += zeros;
+		// Literals end at the first run of at least 4 zeros, shorter ones cost less inline.
+		size_t literals = 0;
+		while (i + literals < n) {
+			if (data[i + literals] == 0) {
+				size_t z = 0;
+				while (i + literals + z < n && z < 4 && data[i + literals + z] == 0)
+					++z;
+				if (z == 4 || i + literals + z == n)
+					break;
+				literals += z;
+			} else {
+				++literals;
+			}
+		}
+		putVarint(b, zeros);
+		putVarint(b, literals);
+		b.insert(b.end(), data + i, data + i + literals);
+		i += literals;
+	}
+}
+
+inline bool getBytes(const uint8_t * & p, const uint8_t * end, uint8_t * data, size_t n) {
+	size_t i = 0;
+	while (i < n) {
+		uint64_t zeros, literals;
+		if (!getVarint(p, end, zeros) || !getVarint(p, end, literals) || zeros > n - i || literals > n - i - zeros
+				|| (uint64_t) (end - p) < literals)
+			return false;
+		memset(data + i, 0, zeros);
+		i += zeros;
+		memcpy(data + i, p, literals);
+		p += literals;
+		i += literals;
+	}
+	return true;
+}
+
+inline bool finite(float x, float y, float z) {
+	return std::fabs(x) <= std::numeric_limits<float>::max() && std::fabs(y) <= std::numeric_limits<float>::max()
+			&& std::fabs(z) <= std::numeric_limits<float>::max();
+}
+
+/// Quantized coordinates of the points of the frame (three per valid point), its mask and attribute records.
+struct State {
+	State() : width(0), height(0), valid(0), resolution(0), lossless(false), dense(true) {}
+
+	/// Frames of the same layout, the second one can be coded as delta to the first.
+	bool compatible(const State & other) const {
+		return width == other.width && height == other.height && valid == other.valid && resolution == other.resolution
+				&& lossless == other.lossless && dense == other.dense && mask == other.mask;
+	}
+
+	uint32_t width, height, valid;
+	float resolution;
+	bool lossless, dense;
+
+	/// Runs of valid and invalid points alternately, starting with valid ones.
+	std::vector<uint32_t> mask;
+	std::vector<int32_t> q;
+	std::vector<uint8_t> records;
+};
+
+} //: namespace detail
+
+/*!
+ * Reads the header of the frame.
+ * \returns false if it is not a frame of this version
+ */
+inline bool readHeader(const uint8_t * data, size_t size, FrameInfo & info, const uint8_t * * body = NULL) {
+	const uint8_t * p = data, * end = data + size;
+	uint32_t magic;
+	uint8_t version, reserved;
+	uint16_t id_length;
+	if (!detail::get(p, end, magic) || magic != MAGIC || !detail::get(p, end, version) || version != VERSION
+			|| !detail::get(p, end, info.type) || !detail::get(p, end, info.flags) || !detail::get(p, end, reserved)
+			|| !detail::get(p, end, info.frame) || !detail::get(p, end, info.timestamp) || !detail::get(p, end, info.stamp)
+			|| !detail::get(p, end, info.width) || !detail::get(p, end, info.height) || !detail::get(p, end, info.valid)
+			|| !detail::get(p, end, info.resolution) || !detail::get(p, end, id_length) || end - p < id_length)
+		return false;
+	info.frame_id.assign((const char *) p, id_length);
+	p += id_length;
+	info.size = size;
+	if (body)
+		*body = p;
+	return info.points() <= MAX_POINTS && info.valid <= info.points();
+}
+
+/*!
+ * \class Encoder
+ * \brief Encodes clouds of one stream, every frame relative to the previous one.
+ *
+ * Coordinates are quantized to a grid of the given resolution (fixed
+ * origin, so identical points of consecutive frames have identical
+ * values), or kept exact with resolution 0. Key frames code every point as
+ * difference to the previous point (neighbours of organized clouds are
+ * close), as zigzag varints. Delta frames, used when size, mask of valid
+ * points and resolution did not change, code differences to the same point
+ * of the previous frame, with runs of unchanged points skipped; attributes
+ * (and exact coordinates) are XORed with the previous frame and their zero
+ * bytes run-length coded. A key frame is sent every key interval frames,
+ * when forced (e.g. for a new receiver) and whenever the delta frame would
+ * be larger than the last key frame.
+ */
+template <typename PointT>
+class Encoder {
+public:
+	Encoder() : resolution_(0.001f), key_interval_(30), since_key_(0), force_key_(true), frame_(0), key_size_(0) {}
+
+	/// Sets size of the quantization grid in meters, 0 or less for exact coordinates.
+	void setResolution(float resolution) {
+		resolution_ = resolution > 0 ? resolution : 0;
+	}
+
+	/// Sets frames between key frames, 1 - only key frames.
+	void setKeyInterval(int frames) {
+		key_interval_ = std::max(frames, 1);
+	}
+
+	/// Makes the next frame a key frame.
+	void forceKeyFrame() {
+		force_key_ = true;
+	}
+
+	/*!
+	 * Encodes the cloud into out.
+	 * \param timestamp time of encoding, written to the header
+	 * \returns true if a key frame was written
+	 */
+	bool encode(const pcl::PointCloud<PointT> & cloud, uint64_t timestamp, Buffer & out) {
+		quantize(cloud, current_);
+		bool key = force_key_ || since_key_ + 1 >= key_interval_ || !current_.compatible(previous_);
+		if (!key) {
+			write(cloud, timestamp, false, out);
+			key = out.size() > key_size_;
+		}
+		if (key) {
+			write(cloud, timestamp, true, out);
+			key_size_ = out.size();
+			since_key_ = 0;
+			force_key_ = false;
+		} else {
+			++since_key_;
+		}
+		++frame_;
+		std::swap(previous_, current_);
+		return key;
+	}
+
+private:
+	/// Quantized coordinates, mask and attribute records of the cloud.
+	void quantize(const pcl::PointCloud<PointT> & cloud, detail::State & s) const {
+		const int record = (resolution_ > 0 ? 0 : 12) + Attributes<PointT>::SIZE;
+		s.width = cloud.width;
+		s.height = cloud.height;
+		if ((size_t) s.width * s.height != cloud.size()) {
+			s.width = cloud.size();
+			s.height = 1;
+		}
+		s.resolution = resolution_;
+		s.lossless = resolution_ <= 0;
+		s.valid = 0;
+		s.mask.clear();
+		s.q.clear();
+		s.records.clear();
+
+		const double inverse = resolution_ > 0 ? 1.0 / resolution_ : 0;
+		const double limit = std::numeric_limits<int32_t>::max();
+		bool valid_run = true;
+		uint32_t run = 0;
+		for (size_t i = 0; i < cloud.size(); ++i) {
+			const PointT & p = cloud.points[i];
+			const bool valid = detail::finite(p.x, p.y, p.z);
+			if (valid != valid_run) {
+				s.mask.push_back(run);
+				run = 0;
+				valid_run = valid;
+			}
+			++run;
+			if (!valid)
+				continue;
+			++s.valid;
+			if (resolution_ > 0) {
+				const float c[3] = { p.x, p.y, p.z };
+				for (int a = 0; a < 3; ++a)
+					s.q.push_back((int32_t) std::max(-limit, std::min(limit, std::floor(c[a] * inverse + 0.5))));
+			}
+			if (record == 0)
+				continue;
+			const size_t r = s.records.size();
+			s.records.resize(r + record);
+			if (resolution_ <= 0) {
+				memcpy(&s.records[r], &p.x, 4);
+				memcpy(&s.records[r + 4], &p.y, 4);
+				memcpy(&s.records[r + 8], &p.z, 4);
+			}
+			Attributes<PointT>::get(p, &s.records[r + record - Attributes<PointT>::SIZE]);
+		}
+		s.mask.push_back(run);
+		s.dense = s.mask.size() == 1;
+	}
+
+	void write(const pcl::PointCloud<PointT> & cloud, uint64_t timestamp, bool key, Buffer & out) {
+		const detail::State & s = current_;
+		out.clear();
+		detail::put(out, MAGIC);
+		detail::put(out, VERSION);
+		detail::put(out, (uint8_t) Attributes<PointT>::TYPE);
+		detail::put(out, (uint8_t) ((key ? KEY : 0) | (s.lossless ? LOSSLESS : 0) | (s.dense ? DENSE : 0)));
+		detail::put(out, (uint8_t) 0);
+		detail::put(out, frame_);
+		detail::put(out, timestamp);
+		detail::put(out, (uint64_t) cloud.header.stamp);
+		detail::put(out, s.width);
+		detail::put(out, s.height);
+		detail::put(out, s.valid);
+		detail::put(out, s.resolution);
+		const std::string & id = cloud.header.frame_id;
+		const uint16_t id_length = std::min<size_t>(id.size(), 0xffff);
+		detail::put(out, id_length);
+		out.insert(out.end(), id.begin(), id.begin() + id_length);
+
+		// Mask, only in key frames (delta frames have the mask of the previous one).
+		if (key && !s.dense) {
+			detail::putVarint(out, s.mask.size());
+			for (size_t r = 0; r < s.mask.size(); ++r)
+				detail::putVarint(out, s.mask[r]);
+		}
+
+		// Coordinates.
+		if (!s.lossless) {
+			int32_t last[3] = { 0, 0, 0 };
+			uint64_t run = 0;
+			for (size_t i = 0; i < s.q.size(); i += 3) {
+				const int32_t * base = key ? last : &previous_.q[i];
+				const int64_t d[3] = { (int64_t) s.q[i] - base[0], (int64_t) s.q[i + 1] - base[1], (int64_t) s.q[i + 2] - base[2] };
+				if (key) {
+					for (int a = 0; a < 3; ++a) {
+						detail::putVarint(out, detail::zigzag(d[a]));
+						last[a] = s.q[i + a];
+					}
+				} else if (d[0] == 0 && d[1] == 0 && d[2] == 0) {
+					++run;
+				} else {
+					detail::putVarint(out, run);
+					run = 0;
+					for (int a = 0; a < 3; ++a)
+						detail::putVarint(out, detail::zigzag(d[a]));
+				}
+			}
+			if (!key && run > 0)
+				detail::putVarint(out, run);
+		}
+
+		// Attribute records, XORed with the previous frame in delta frames.
+		if (!s.records.empty()) {
+			if (key) {
+				detail::putBytes(out, &s.records[0], s.records.size());
+			} else {
+				xor_.resize(s.records.size());
+				for (size_t i = 0; i < s.records.size(); ++i)
+					xor_[i] = s.records[i] ^ previous_.records[i];
+				detail::putBytes(out, &xor_[0], xor_.size());
+			}
+		}
+	}
+
+	float resolution_;
+	int key_interval_, since_key_;
+	bool force_key_;
+	uint32_t frame_;
+	size_t key_size_;
+
+	detail::State previous_, current_;
+	std::vector<uint8_t> xor_;
+};
+
+/*!
+ * \class Decoder
+ * \brief Decodes frames of one stream written by Encoder.
+ *
+ * Delta frames need the previous frame of the stream, so frames must be
+ * decoded in order; after a lost or malformed frame delta frames are
+ * rejected until the next key frame.
+ */
+template <typename PointT>
+class Decoder {
+public:
+	Decoder() : synced_(false), frame_(0), width_(0), height_(0), valid_(0) {}
+
+	/// Drops the previous frame, only a key frame is decoded next.
+	void reset() {
+		synced_ = false;
+	}
+
+	/*!
+	 * Decodes the frame into the cloud (organized as the encoded one, invalid points NaN).
+	 * \returns false if the frame is malformed, of another point type or a delta frame without its previous frame
+	 */
+	bool decode(const uint8_t * data, size_t size, pcl::PointCloud<PointT> & cloud, FrameInfo & info) {
+		const uint8_t * p, * end = data + size;
+		if (!readHeader(data, size, info, &p) || info.type != Attributes<PointT>::TYPE) {
+			synced_ = false;
+			return false;
+		}
+		const bool key = info.key(), lossless = (info.flags & LOSSLESS) != 0, dense = (info.flags & DENSE) != 0;
+		if (!key && (!synced_ || info.frame != frame_ + 1)) {
+			synced_ = false;
+			return false;
+		}
+		synced_ = false;
+		frame_ = info.frame;
+
+		const size_t n = info.points(), valid = info.valid;
+		const int record = (lossless ? 12 : 0) + Attributes<PointT>::SIZE;
+
+		// Mask.
+		if (key) {
+			mask_.clear();
+			if (dense) {
+				mask_.push_back(n);
+			} else {
+				uint64_t runs, run, total = 0;
+				if (!detail::getVarint(p, end, runs) || runs > n + 1)
+					return false;
+				for (uint64_t r = 0; r < runs; ++r) {
+					if (!detail::getVarint(p, end, run) || run > n - total)
+						return false;
+					mask_.push_back(run);
+					total += run;
+				}
+				if (total != n)
+					return false;
+			}
+			size_t counted = 0;
+			for (size_t r = 0; r < mask_.size(); r += 2)
+				counted += mask_[r];
+			if (counted != valid)
+				return false;
+		} else if (info.width != width_ || info.height != height_ || valid != valid_) {
+			return false;
+		}
+		width_ = info.width;
+		height_ = info.height;
+		valid_ = info.valid;
+
+		// Coordinates.
+		if (!lossless) {
+			q_.resize(3 * valid);
+			int64_t last[3] = { 0, 0, 0 };
+			size_t i = 0;
+			while (i < valid) {
+				uint64_t v;
+				if (key) {
+					for (int a = 0; a < 3; ++a) {
+						if (!detail::getVarint(p, end, v))
+							return false;
+						last[a] += detail::unzigzag(v);
+						q_[3 * i + a] = (int32_t) last[a];
+					}
+					++i;
+					continue;
+				}
+				uint64_t run;
+				if (!detail::getVarint(p, end, run) || run > valid - i)
+					return false;
+				i += run;
+				if (i == valid)
+					break;
+				for (int a = 0; a < 3; ++a) {
+					if (!detail::getVarint(p, end, v))
+						return false;
+					q_[3 * i + a] = (int32_t) (q_[3 * i + a] + detail::unzigzag(v));
+				}
+				++i;
+			}
+		} else {
+			q_.clear();
+		}
+
+		// Attribute records.
+		if (record > 0) {
+			xor_.resize(valid * record);
+			if (valid > 0 && !detail::getBytes(p, end, &xor_[0], xor_.size()))
+				return false;
+			if (key) {
+				records_.swap(xor_);
+			} else {
+				if (records_.size() != xor_.size())
+					return false;
+				for (size_t i = 0; i < records_.size(); ++i)
+					records_[i] ^= xor_[i];
+			}
+		}
+
+		// Points.
+		cloud.points.resize(n);
+		cloud.width = info.width;
+		cloud.height = info.height;
+		cloud.is_dense = dense;
+		cloud.header.stamp = info.stamp;
+		cloud.header.frame_id = info.frame_id;
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		size_t point = 0, v = 0;
+		for (size_t r = 0; r < mask_.size(); ++r) {
+			for (uint32_t k = 0; k < mask_[r]; ++k, ++point) {
+				PointT & pt = cloud.points[point];
+				if (r % 2) {
+					pt.x = pt.y = pt.z = nan;
+					continue;
+				}
+				if (lossless) {
+					memcpy(&pt.x, &records_[v * record], 4);
+					memcpy(&pt.y, &records_[v * record + 4], 4);
+					memcpy(&pt.z, &records_[v * record + 8], 4);
+				} else {
+					pt.x = q_[3 * v] * info.resolution;
+					pt.y = q_[3 * v + 1] * info.resolution;
+					pt.z = q_[3 * v + 2] * info.resolution;
+				}
+				if (Attributes<PointT>::SIZE > 0)
+					Attributes<PointT>::set(pt, &records_[v * record + record - Attributes<PointT>::SIZE]);
+				++v;
+			}
+		}
+		synced_ = true;
+		return true;
+	}
+
+private:
+	bool synced_;
+	uint32_t frame_;
+	uint32_t width_, height_, valid_;
+	std::vector<uint32_t> mask_;
+	std::vector<int32_t> q_;
+	std::vector<uint8_t> records_, xor_;
+};
+
+} //: namespace CloudCodec
+} //: namespace Types
+
+#endif /* CLOUDCODEC_HPP_ */
@@ -0,0 +1,122 @@
+/*!
+ * \file
+ * \brief Geometry-only conversion of point clouds to XYZ clouds.
+ * \author Michal Laszkowski
+ */
+
+#ifndef CLOUDCONVERSION_HPP_
+#define CLOUDCONVERSION_HPP_
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/common/io.h>
+
+#include <Types/PointXYZSIFT.hpp>
+#include <Types/PointXYZSHOT.hpp>
+
+#include "Types/ThreadPool.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLOUD_CONVERSION_SSE
+#endif
+
+namespace Types {
+namespace CloudConversion {
+
+/*!
+ * True for point types starting with the aligned 4-float xyz block
+ * (PCL_ADD_POINT4D), copied as one vector by toXYZ(). Other types go
+ * through pcl::copyPointCloud.
+ */
+template <typename PointT>
+struct HasPoint4D {
+	static const bool value = false;
+};
+
+template <> struct HasPoint4D<pcl::PointXYZ> { static const bool value = true; };
+template <> struct HasPoint4D<pcl::PointXYZRGB> { static const bool value = true; };
+template <> struct HasPoint4D<pcl::PointXYZRGBA> { static const bool value = true; };
+template <> struct HasPoint4D<pcl::PointXYZRGBNormal> { static const bool value = true; };
+template <> struct HasPoint4D<pcl::PointNormal> { static const bool value = true; };
+template <> struct HasPoint4D<PointXYZSIFT> { static const bool value = true; };
+template <> struct HasPoint4D<PointXYZSHOT> { static const bool value = true; };
+
+/// Clouds with fewer points are converted by a single thread.
+static const size_t PARALLEL_POINTS = 65536;
+
+/// Copies xyz blocks of a range of points, records are read with their own stride.
+template <typename PointT>
+inline void copyPoints(const PointT * in, pcl::PointXYZ * out, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+#if defined(CLOUD_CONVERSION_SSE)
+		_mm_store_ps(out[i].data, _mm_load_ps(in[i].data));
+#else
+		out[i].x = in[i].x;
+		out[i].y = in[i].y;
+		out[i].z = in[i].z;
+#endif
+		out[i].data[3] = 1.0f;
+	}
+}
+
+/// Body of the parallel loop of toXYZ().
+template <typename PointT>
+struct CopyBody {
+	CopyBody(const PointT * in, pcl::PointXYZ * out) : in(in), out(out) {
+	}
+	void operator()(int begin, int end, int) const {
+		copyPoints(in + begin, out + begin, end - begin);
+	}
+	const PointT * in;
+	pcl::PointXYZ * out;
+};
+
+template <bool Point4D>
+struct Convert {
+	template <typename PointT>
+	static void run(const pcl::PointCloud<PointT> & input, pcl::PointCloud<pcl::PointXYZ> & output, bool) {
+		pcl::copyPointCloud(input, output);
+	}
+};
+
+template <>
+struct Convert<true> {
+	template <typename PointT>
+	static void run(const pcl::PointCloud<PointT> & input, pcl::PointCloud<pcl::PointXYZ> & output, bool parallel) {
+		const int n = input.points.size();
+		output.header = input.header;
+		output.width = input.width;
+		output.height = input.height;
+		output.is_dense = input.is_dense;
+		output.sensor_origin_ = input.sensor_origin_;
+		output.sensor_orientation_ = input.sensor_orientation_;
+		output.points.resize(n);
+		if (n == 0)
+			return;
+
+		const PointT * in = &input.points[0];
+		pcl::PointXYZ * out = &output.points[0];
+		if (!parallel || (size_t) n < PARALLEL_POINTS) {
+			copyPoints(in, out, n);
+			return;
+		}
+		ThreadPool::parallelFor(0, n, 16384, CopyBody<PointT>(in, out));
+	}
+};
+
+/*!
+ * Copies coordinates of the cloud into the XYZ cloud, with its header and
+ * layout. For the types of HasPoint4D only the xyz block of every record
+ * is read, without field mapping of pcl::copyPointCloud. Large clouds are
+ * split between threads unless parallel is false.
+ */
+template <typename PointT>
+void toXYZ(const pcl::PointCloud<PointT> & input, pcl::PointCloud<pcl::PointXYZ> & output, bool parallel = true) {
+	Convert<HasPoint4D<PointT>::value>::run(input, output, parallel);
+}
+
+} //: namespace CloudConversion
+} //: namespace Types
+
+#endif /* CLOUDCONVERSION_HPP_ */
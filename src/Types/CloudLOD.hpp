@@ -0,0 +1,251 @@
+/*!
+ * \file
+ * \brief Level of detail hierarchy of a point cloud, for rendering of large clouds.
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef CLOUDLOD_HPP_
+#define CLOUDLOD_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <Eigen/Core>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/CloudPool.hpp"
+
+namespace Types {
+
+/*!
+ * \class CloudLOD
+ * \brief Points of a cloud ordered from coarse to fine.
+ *
+ * The bounding cube of the cloud is divided into an octree of DEPTH levels.
+ * Points are sorted along the Morton (Z-order) curve of the finest level,
+ * so points of every octree cell are consecutive; the first point of a cell
+ * represents it. A point belongs to level L if it is the first point of its
+ * cell at level L but not at L - 1. Points are ordered by their level, so
+ * the first count(L) points contain one point of every non-empty cell of
+ * level L - every level is a prefix of the order and the hierarchy is just
+ * one index array, built with a single sort.
+ *
+ * select() chooses the finest level whose cells, seen from the camera, are
+ * still larger than the given number of pixels, limited by the point budget.
+ */
+template <typename PointT>
+class CloudLOD {
+public:
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::Ptr CloudPtr;
+	typedef typename Cloud::ConstPtr CloudConstPtr;
+
+	/// Depth of the octree (bits per axis of Morton codes).
+	enum { DEPTH = 10 };
+
+	CloudLOD() : size_(0), level_(-1) {}
+
+	/// Builds the hierarchy of the cloud.
+	void build(const CloudConstPtr & cloud) {
+		cloud_ = cloud;
+		order_.clear();
+		counts_.assign(levels(), 0);
+		level_ = -1;
+		level_cloud_.reset();
+		if (!cloud_)
+			return;
+
+		// Bounding cube of finite points.
+		const int n = cloud_->points.size();
+		Eigen::Vector3f mn = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+		Eigen::Vector3f mx = -mn;
+		for (int i = 0; i < n; ++i) {
+			const PointT & p = cloud_->points[i];
+			if (!pcl_isfinite(p.x) || !pcl_isfinite(p.y) || !pcl_isfinite(p.z))
+				continue;
+			const Eigen::Vector3f v(p.x, p.y, p.z);
+			mn = mn.cwiseMin(v);
+			mx = mx.cwiseMax(v);
+		}
+		if (mn.x() > mx.x())
+			return;
+		min_ = mn;
+		size_ = std::max((mx - mn).maxCoeff(), std::numeric_limits<float>::epsilon());
+		center_ = 0.5f * (mn + mx);
+
+		// Morton codes of the finest cells.
+		std::vector<std::pair<uint32_t, int> > codes;
+		codes.reserve(n);
+		const float scale = ((1 << DEPTH) - 1) / size_;
+		for (int i = 0; i < n; ++i) {
+			const PointT & p = cloud_->points[i];
+			if (!pcl_isfinite(p.x) || !pcl_isfinite(p.y) || !pcl_isfinite(p.z))
+				continue;
+			codes.push_back(std::make_pair(morton(
+					(uint32_t) ((p.x - mn.x()) * scale),
+					(uint32_t) ((p.y - mn.y()) * scale),
+					(uint32_t) ((p.z - mn.z()) * scale)), i));
+		}
+		std::sort(codes.begin(), codes.end());
+
+		// Level of a point - the coarsest level at which its cell differs from the previous point's.
+		std::vector<unsigned char> level(codes.size());
+		for (size_t i = 0; i < codes.size(); ++i) {
+			if (i == 0) {
+				level[i] = 0;
+				continue;
+			}
+			const uint32_t diff = codes[i].first ^ codes[i - 1].first;
+			level[i] = diff ? DEPTH - highestBit(diff) / 3 : DEPTH + 1;
+			++counts_[level[i]];
+		}
+		if (!codes.empty())
+			++counts_[0];
+
+		// Order by level, counting sort keeps Z-order within levels.
+		std::vector<size_t> start(levels(), 0);
+		for (int l = 1; l < levels(); ++l)
+			start[l] = start[l - 1] + counts_[l - 1];
+		order_.resize(codes.size());
+		for (size_t i = 0; i < codes.size(); ++i)
+			order_[start[level[i]]++] = codes[i].second;
+
+		// Counts of prefixes.
+		for (int l = 1; l < levels(); ++l)
+			counts_[l] += counts_[l - 1];
+	}
+
+	/// Number of levels, the last one contains all finite points.
+	int levels() const {
+		return DEPTH + 2;
+	}
+
+	/// Number of points of the given level.
+	size_t count(int level) const {
+		return counts_.empty() ? 0 : counts_[std::max(0, std::min(level, levels() - 1))];
+	}
+
+	/// Center of the bounding box.
+	const Eigen::Vector3f & center() const {
+		return center_;
+	}
+
+	/*!
+	 * Finest level with at most budget points, whose cells seen from eye
+	 * with vertical field of view fovy (radians) in a window height pixels
+	 * high are not smaller than pixels.
+	 */
+	int select(const Eigen::Vector3f & eye, float fovy, int height, size_t budget, float pixels) const {
+		if (counts_.empty() || counts_.back() == 0)
+			return 0;
+
+		// Distance to the bounding cube, points inside it are seen with the finest detail.
+		const Eigen::Vector3f outside = ((eye - min_).cwiseMax(Eigen::Vector3f::Zero()) - Eigen::Vector3f::Constant(size_))
+				.cwiseMax(Eigen::Vector3f::Zero()) + (min_ - eye).cwiseMax(Eigen::Vector3f::Zero());
+		const float distance = outside.norm();
+		const float pixel = 2 * distance * std::tan(0.5f * fovy) / std::max(1, height);
+
+		int level = 0;
+		while (level + 1 < levels() && counts_[level + 1] <= budget) {
+			// Cells of the next level would be smaller than required.
+			if (pixel > 0 && size_ / (1 << std::min(level + 1, (int) DEPTH)) < pixels * pixel)
+				break;
+			++level;
+		}
+		return level;
+	}
+
+	/*!
+	 * Level for the camera of a visualizer (pcl::visualization::Camera: pos,
+	 * fovy in radians, window_size), cloud being placed with the given pose.
+	 */
+	template <typename Camera>
+	int select(const Camera & camera, const Eigen::Matrix4f & pose, size_t budget, float pixels) const {
+		const Eigen::Vector3f eye(camera.pos[0], camera.pos[1], camera.pos[2]);
+		// Camera position in cloud coordinates.
+		const Eigen::Matrix3f r = pose.topLeftCorner<3, 3>();
+		const Eigen::Vector3f local = r.transpose() * (eye - pose.topRightCorner<3, 1>());
+		return select(local, camera.fovy, camera.window_size[1], budget, pixels);
+	}
+
+	/// Cloud of points of the given level, the last one is cached.
+	CloudConstPtr cloud(int level) {
+		level = std::max(0, std::min(level, levels() - 1));
+		if (!cloud_ || counts_.empty())
+			return cloud_;
+		if (counts_[level] == cloud_->size())
+			return cloud_;
+		if (level != level_ || !level_cloud_) {
+			const size_t n = counts_[level];
+			CloudPtr output = CloudPool<PointT>::acquire(n);
+			output->points.resize(n);
+			for (size_t i = 0; i < n; ++i)
+				output->points[i] = cloud_->points[order_[i]];
+			output->width = n;
+			output->height = 1;
+			output->is_dense = true;
+			output->header = cloud_->header;
+			output->sensor_origin_ = cloud_->sensor_origin_;
+			output->sensor_orientation_ = cloud_->sensor_orientation_;
+			level_cloud_ = output;
+			level_ = level;
+		}
+		return level_cloud_;
+	}
+
+	/// Source cloud.
+	const CloudConstPtr & source() const {
+		return cloud_;
+	}
+
+private:
+	/// Spreads 10 bits so that there are two zero bits between each of them.
+	static uint32_t spread(uint32_t v) {
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	static uint32_t morton(uint32_t x, uint32_t y, uint32_t z) {
+		return (spread(z) << 2) | (spread(y) << 1) | spread(x);
+	}
+
+	static int highestBit(uint32_t v) {
+		int b = 0;
+		while (v >>= 1)
+			++b;
+		return b;
+	}
+
+	CloudConstPtr cloud_;
+
+	/// Indices of finite points ordered by level.
+	std::vector<int> order_;
+
+	/// Number of points of levels up to the given one.
+	std::vector<size_t> counts_;
+
+	Eigen::Vector3f min_;
+	Eigen::Vector3f center_;
+	float size_;
+
+	/// Cached cloud of a level.
+	int level_;
+	CloudConstPtr level_cloud_;
+
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} //: namespace Types
+
+#endif /* CLOUDLOD_HPP_ */
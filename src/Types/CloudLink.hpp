@@ -0,0 +1,297 @@
+/*!
+ * \file
+ * \brief TCP link carrying encoded clouds between nodes of a distributed task.
+ * \author Micha Laszkowski
+ */
+
+#ifndef CLOUDLINK_HPP_
+#define CLOUDLINK_HPP_
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <sstream>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <boost/asio.hpp>
+#include <boost/array.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "Types/CloudCodec.hpp"
+
+namespace Types {
+
+/// Microseconds since the epoch, time base of timestamps of frames.
+inline uint64_t linkTime() {
+	static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+	return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds();
+}
+
+/*!
+ * \class LinkCounters
+ * \brief Traffic of a link between two reports.
+ *
+ * Latency is measured from the timestamp written by the sender to the
+ * decoding by the receiver, so between hosts it is only as accurate as
+ * synchronization of their clocks (NTP/PTP).
+ */
+class LinkCounters {
+public:
+	LinkCounters() {
+		reset();
+	}
+
+	void reset() {
+		frames = keys = 0;
+		raw = encoded = 0;
+		coding = latency = max_latency = 0;
+		since = boost::posix_time::microsec_clock::universal_time();
+	}
+
+	/// Counts frame of raw bytes of points, encoded bytes, seconds of encoding (decoding) and latency.
+	void add(size_t raw_bytes, size_t encoded_bytes, bool key, double coding_seconds, double latency_seconds = 0) {
+		++frames;
+		if (key)
+			++keys;
+		raw += raw_bytes;
+		encoded += encoded_bytes;
+		coding += coding_seconds;
+		latency += latency_seconds;
+		max_latency = std::max(max_latency, latency_seconds);
+	}
+
+	/// Seconds since reset.
+	double elapsed() const {
+		return (boost::posix_time::microsec_clock::universal_time() - since).total_microseconds() * 1e-6;
+	}
+
+	/// Summary for the log, latency only if it was measured.
+	std::string report(bool with_latency) const {
+		const double seconds = std::max(elapsed(), 1e-6);
+		std::ostringstream out;
+		out << frames << " frames (" << keys << " key) in " << seconds << " s, " << frames / seconds << " fps, "
+				<< encoded / seconds / 1e6 << " MB/s (" << raw / seconds / 1e6 << " MB/s raw, ratio "
+				<< (encoded > 0 ? (double) raw / encoded : 0) << "), coding " << (frames > 0 ? 1e3 * coding / frames : 0) << " ms/frame";
+		if (with_latency)
+			out << ", latency " << (frames > 0 ? 1e3 * latency / frames : 0) << " ms (max " << 1e3 * max_latency << " ms)";
+		return out.str();
+	}
+
+	uint64_t frames, keys;
+	uint64_t raw, encoded;
+	double coding, latency, max_latency;
+	boost::posix_time::ptime since;
+};
+
+namespace detail {
+
+/// Unblocks accept() or read() of the socket waiting in another thread (asio sockets cannot be closed concurrently).
+template <typename Socket>
+inline void interrupt(Socket & socket) {
+	if (socket.is_open())
+		::shutdown(socket.native_handle(), SHUT_RDWR);
+}
+
+} //: namespace detail
+
+/*!
+ * \class CloudServer
+ * \brief Listening end of the link, sends every frame to all connected clients.
+ *
+ * Frames are prefixed with their length (4 bytes, little-endian). Clients
+ * are accepted by a thread of the server; a client that fails is dropped.
+ * send() blocks until the frame is written to all clients, so it should be
+ * called off the executor thread (e.g. by Types::WriteQueue).
+ */
+class CloudServer {
+public:
+	CloudServer() : running_(false), joined_(false) {}
+
+	~CloudServer() {
+		stop();
+	}
+
+	/// Starts listening on the port of all interfaces. Returns false (with the reason in error) if it fails.
+	bool start(int port, std::string & error) {
+		stop();
+		try {
+			acceptor_.reset(new boost::asio::ip::tcp::acceptor(io_));
+			const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v4(), port);
+			acceptor_->open(endpoint.protocol());
+			acceptor_->set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+			acceptor_->bind(endpoint);
+			acceptor_->listen();
+		} catch (const boost::system::system_error & e) {
+			error = e.what();
+			acceptor_.reset();
+			return false;
+		}
+		running_ = true;
+		thread_.reset(new boost::thread(boost::bind(&CloudServer::accept, this)));
+		return true;
+	}
+
+	/// Stops accepting and disconnects all clients.
+	void stop() {
+		if (!thread_)
+			return;
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			running_ = false;
+		}
+		detail::interrupt(*acceptor_);
+		thread_->join();
+		thread_.reset();
+		boost::system::error_code ec;
+		acceptor_->close(ec);
+		acceptor_.reset();
+		boost::mutex::scoped_lock lock(mutex_);
+		for (size_t i = 0; i < sockets_.size(); ++i)
+			sockets_[i]->close(ec);
+		sockets_.clear();
+	}
+
+	/// Checks (and clears) whether a client connected since the last call - its first frame must be a key frame.
+	bool joined() {
+		boost::mutex::scoped_lock lock(mutex_);
+		const bool joined = joined_;
+		joined_ = false;
+		return joined;
+	}
+
+	int clients() const {
+		boost::mutex::scoped_lock lock(mutex_);
+		return sockets_.size();
+	}
+
+	/*!
+	 * Sends the frame to all clients.
+	 * \returns number of clients that got it
+	 */
+	int send(const CloudCodec::Buffer & frame) {
+		std::vector<SocketPtr> sockets;
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			sockets = sockets_;
+		}
+		const uint32_t length = frame.size();
+		const boost::array<boost::asio::const_buffer, 2> buffers = { { boost::asio::buffer(&length, sizeof(length)),
+				boost::asio::buffer(frame) } };
+		int sent = 0;
+		for (size_t i = 0; i < sockets.size(); ++i) {
+			boost::system::error_code ec;
+			boost::asio::write(*sockets[i], buffers, ec);
+			if (!ec) {
+				++sent;
+				continue;
+			}
+			// Client disconnected.
+			boost::mutex::scoped_lock lock(mutex_);
+			sockets_.erase(std::remove(sockets_.begin(), sockets_.end(), sockets[i]), sockets_.end());
+			sockets[i]->close(ec);
+		}
+		return sent;
+	}
+
+private:
+	typedef boost::shared_ptr<boost::asio::ip::tcp::socket> SocketPtr;
+
+	/// Accepting thread.
+	void accept() {
+		for (;;) {
+			SocketPtr socket(new boost::asio::ip::tcp::socket(io_));
+			boost::system::error_code ec;
+			acceptor_->accept(*socket, ec);
+			boost::mutex::scoped_lock lock(mutex_);
+			if (!running_)
+				return;
+			if (ec) {
+				lock.unlock();
+				boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+				continue;
+			}
+			// Frames are large, but the latency of the last segment matters.
+			socket->set_option(boost::asio::ip::tcp::no_delay(true), ec);
+			sockets_.push_back(socket);
+			joined_ = true;
+		}
+	}
+
+	boost::asio::io_service io_;
+	boost::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
+	boost::shared_ptr<boost::thread> thread_;
+
+	mutable boost::mutex mutex_;
+	bool running_, joined_;
+	std::vector<SocketPtr> sockets_;
+};
+
+/*!
+ * \class CloudClient
+ * \brief Receiving end of the link.
+ */
+class CloudClient {
+public:
+	/// Frames larger than that are treated as a broken stream.
+	static const uint32_t MAX_FRAME = 1u << 30;
+
+	CloudClient() : socket_(io_) {}
+
+	/// Connects to the server. Returns false (with the reason in error) if it fails.
+	bool connect(const std::string & host, int port, std::string & error) {
+		close();
+		try {
+			boost::asio::ip::tcp::resolver resolver(io_);
+			boost::asio::ip::tcp::resolver::query query(host, boost::lexical_cast<std::string>(port));
+			boost::asio::connect(socket_, resolver.resolve(query));
+		} catch (const boost::system::system_error & e) {
+			error = e.what();
+			close();
+			return false;
+		}
+		boost::system::error_code ec;
+		socket_.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+		return true;
+	}
+
+	bool connected() const {
+		return socket_.is_open();
+	}
+
+	/// Waits for the next frame. Returns false if the connection was closed, broken or interrupted.
+	bool receive(CloudCodec::Buffer & frame) {
+		uint32_t length;
+		boost::system::error_code ec;
+		boost::asio::read(socket_, boost::asio::buffer(&length, sizeof(length)), ec);
+		if (ec || length > MAX_FRAME)
+			return false;
+		frame.resize(length);
+		if (length > 0)
+			boost::asio::read(socket_, boost::asio::buffer(frame), ec);
+		return !ec;
+	}
+
+	/// Unblocks receive() waiting in another thread.
+	void interrupt() {
+		detail::interrupt(socket_);
+	}
+
+	void close() {
+		boost::system::error_code ec;
+		socket_.close(ec);
+	}
+
+private:
+	boost::asio::io_service io_;
+	boost::asio::ip::tcp::socket socket_;
+};
+
+} //: namespace Types
+
+#endif /* CLOUDLINK_HPP_ */
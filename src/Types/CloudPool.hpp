@@ -0,0 +1,177 @@
+/*!
+ * \file
+ * \brief Pool of recycled point clouds.
+ * \author Maciej Stefańczyk [maciek.slon@gmail.com]
+ */
+
+#ifndef CLOUDPOOL_HPP_
+#define CLOUDPOOL_HPP_
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/PoolMissCounter.hpp"
+
+namespace Types {
+
+/*!
+ * \class CloudPool
+ * \brief Pool of point clouds of given point type.
+ *
+ * acquire() hands out an empty cloud whose point storage can hold at least
+ * the requested number of points. When the last shared_ptr to it (held by
+ * any downstream component) is dropped, the storage returns to the pool
+ * instead of being freed. Clouds are bucketed by power-of-two capacity.
+ *
+ * The pool is a static of this header template, so each component library
+ * instantiating it has its own pool (and its own hits()/misses()). A cloud
+ * always returns to the pool that handed it out, also when it is released
+ * by another component.
+ *
+ * Usage:
+ * \code
+ * pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = Types::CloudPool<pcl::PointXYZ>::acquire(input->size());
+ * \endcode
+ */
+template <typename PointT>
+class CloudPool {
+public:
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::Ptr Ptr;
+
+	/// Number of buckets, bucket k holds clouds of capacity in [2^k, 2^(k+1)).
+	static const int BUCKETS = 32;
+
+	/// Maximal number of idle clouds kept in one bucket.
+	static const size_t MAX_PER_BUCKET = 8;
+
+	/// Returns empty cloud with capacity of at least the given number of points.
+	static Ptr acquire(size_t capacity = 0) {
+		return instance()->get(capacity);
+	}
+
+	/// Number of requests served from the pool.
+	static size_t hits() { return instance()->hits(); }
+
+	/// Number of requests that needed new allocation.
+	static size_t misses() { return instance()->misses(); }
+
+private:
+	/// Shared state, kept alive by deleters of clouds still in use.
+	struct Storage {
+		Storage() : hits_(0), misses_(0) {}
+
+		~Storage() {
+			for (int b = 0; b < BUCKETS; ++b)
+				for (size_t i = 0; i < buckets_[b].size(); ++i)
+					delete buckets_[b][i];
+		}
+
+		Ptr get(size_t capacity) {
+			Cloud * cloud = NULL;
+			{
+				boost::mutex::scoped_lock lock(mutex_);
+				// Bucket of the requested size may hold clouds big enough...
+				int first = std::min(capacity ? floorLog2(capacity) : 0, BUCKETS - 1);
+				std::vector<Cloud *> & bucket = buckets_[first];
+				for (size_t i = 0; i < bucket.size() && !cloud; ++i) {
+					if (bucket[i]->points.capacity() >= capacity) {
+						cloud = bucket[i];
+						bucket.erase(bucket.begin() + i);
+					}
+				}
+				// ...all clouds in the following ones are.
+				for (int b = first + 1; b < BUCKETS && !cloud; ++b) {
+					if (!buckets_[b].empty()) {
+						cloud = buckets_[b].back();
+						buckets_[b].pop_back();
+					}
+				}
+				cloud ? ++hits_ : ++misses_;
+			}
+
+			if (!cloud) {
+				cloud = new Cloud;
+				cloud->points.reserve(capacity);
+				PoolMissCounter::add(capacity * sizeof(PointT));
+			}
+			return Ptr(cloud, Deleter(self_.lock()));
+		}
+
+		void release(Cloud * cloud) {
+			// Reset everything but the point storage.
+			cloud->points.clear();
+			cloud->width = 0;
+			cloud->height = 0;
+			cloud->is_dense = true;
+			cloud->header = pcl::PCLHeader();
+			cloud->sensor_origin_ = Eigen::Vector4f::Zero();
+			cloud->sensor_orientation_ = Eigen::Quaternionf::Identity();
+
+			size_t capacity = cloud->points.capacity();
+			int b = capacity ? floorLog2(capacity) : 0;
+			{
+				boost::mutex::scoped_lock lock(mutex_);
+				if (capacity && b < BUCKETS && buckets_[b].size() < MAX_PER_BUCKET) {
+					buckets_[b].push_back(cloud);
+					return;
+				}
+			}
+			delete cloud;
+		}
+
+		size_t hits() {
+			boost::mutex::scoped_lock lock(mutex_);
+			return hits_;
+		}
+
+		size_t misses() {
+			boost::mutex::scoped_lock lock(mutex_);
+			return misses_;
+		}
+
+		static int floorLog2(size_t n) {
+			int k = 0;
+			while (n >>= 1)
+				++k;
+			return k;
+		}
+
+		boost::mutex mutex_;
+		std::vector<Cloud *> buckets_[BUCKETS];
+		size_t hits_, misses_;
+		boost::weak_ptr<Storage> self_;
+	};
+
+	/// Returns cloud to the pool it was taken from.
+	struct Deleter {
+		Deleter(const boost::shared_ptr<Storage> & storage_) : storage(storage_) {}
+
+		void operator()(Cloud * cloud) {
+			storage->release(cloud);
+		}
+
+		boost::shared_ptr<Storage> storage;
+	};
+
+	static boost::shared_ptr<Storage> instance() {
+		static boost::shared_ptr<Storage> storage = create();
+		return storage;
+	}
+
+	static boost::shared_ptr<Storage> create() {
+		boost::shared_ptr<Storage> storage(new Storage);
+		storage->self_ = storage;
+		return storage;
+	}
+};
+
+} //: namespace Types
+
+#endif /* CLOUDPOOL_HPP_ */
@@ -0,0 +1,334 @@
+/*!
+ * \file
+ * \brief Centroid, bounds and covariance of a cloud computed in a single pass.
+ * \author Michal Laszkowski
+ */
+
+#ifndef CLOUD_STATISTICS_HPP_
+#define CLOUD_STATISTICS_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/SoACloud.hpp"
+#include "Types/ThreadPool.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLOUD_STATISTICS_SSE
+#endif
+
+namespace Types {
+namespace CloudStatistics {
+
+/// Clouds with fewer points are reduced by a single thread.
+static const size_t PARALLEL_POINTS = 65536;
+
+/*!
+ * Statistics of the finite points of a cloud. With no finite points count
+ * is 0 and the other fields are left undefined.
+ */
+struct Result {
+	/// Number of finite points.
+	size_t count;
+
+	/// Centroid (x, y, z, 1).
+	Eigen::Vector4f centroid;
+
+	/// Axis aligned bounding box.
+	Eigen::Vector3f min, max;
+
+	/// Covariance normalized by the number of points.
+	Eigen::Matrix3f covariance;
+
+	/// Oriented bounding box: axes (columns, right handed, by increasing variance)
+	/// and bounds of points in the frame of the axes, centered at the centroid.
+	/// Filled only if requested.
+	Eigen::Matrix3f axes;
+	Eigen::Vector3f obb_min, obb_max;
+
+	/// Pose of the center of the oriented box.
+	Eigen::Matrix4f obbPose() const {
+		Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+		pose.topLeftCorner<3, 3>() = axes;
+		pose.topRightCorner<3, 1>() = centroid.head<3>() + axes * (0.5f * (obb_min + obb_max));
+		return pose;
+	}
+
+	/// Edge lengths of the oriented box.
+	Eigen::Vector3f obbSize() const {
+		return obb_max - obb_min;
+	}
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/// Partial sums of one thread. Coordinates are shifted by a point of the
+/// cloud, which keeps the second moments accurate far from the origin.
+struct Accumulator {
+	Accumulator() : n(0) {
+		for (int i = 0; i < 3; ++i)
+			s[i] = 0;
+		for (int i = 0; i < 6; ++i)
+			ss[i] = 0;
+		for (int i = 0; i < 4; ++i) {
+			mn[i] = std::numeric_limits<float>::max();
+			mx[i] = -std::numeric_limits<float>::max();
+		}
+	}
+
+	template <typename PointT>
+	void add(const PointT & p, const float * shift) {
+#if defined(CLOUD_STATISTICS_SSE)
+		const __m128 v = _mm_loadu_ps(p.data);
+		_mm_storeu_ps(mn, _mm_min_ps(_mm_loadu_ps(mn), v));
+		_mm_storeu_ps(mx, _mm_max_ps(_mm_loadu_ps(mx), v));
+#else
+		for (int i = 0; i < 3; ++i) {
+			mn[i] = std::min(mn[i], p.data[i]);
+			mx[i] = std::max(mx[i], p.data[i]);
+		}
+#endif
+		const double x = p.x - shift[0], y = p.y - shift[1], z = p.z - shift[2];
+		s[0] += x;
+		s[1] += y;
+		s[2] += z;
+		ss[0] += x * x;
+		ss[1] += x * y;
+		ss[2] += x * z;
+		ss[3] += y * y;
+		ss[4] += y * z;
+		ss[5] += z * z;
+		++n;
+	}
+
+	/// As add(point), for coordinates of SoA clouds.
+	void add(float px, float py, float pz, const float * shift) {
+		mn[0] = std::min(mn[0], px);
+		mn[1] = std::min(mn[1], py);
+		mn[2] = std::min(mn[2], pz);
+		mx[0] = std::max(mx[0], px);
+		mx[1] = std::max(mx[1], py);
+		mx[2] = std::max(mx[2], pz);
+		const double x = px - shift[0], y = py - shift[1], z = pz - shift[2];
+		s[0] += x;
+		s[1] += y;
+		s[2] += z;
+		ss[0] += x * x;
+		ss[1] += x * y;
+		ss[2] += x * z;
+		ss[3] += y * y;
+		ss[4] += y * z;
+		ss[5] += z * z;
+		++n;
+	}
+
+	void merge(const Accumulator & o) {
+		n += o.n;
+		for (int i = 0; i < 3; ++i)
+			s[i] += o.s[i];
+		for (int i = 0; i < 6; ++i)
+			ss[i] += o.ss[i];
+		for (int i = 0; i < 3; ++i) {
+			mn[i] = std::min(mn[i], o.mn[i]);
+			mx[i] = std::max(mx[i], o.mx[i]);
+		}
+	}
+
+	size_t n;
+	double s[3];
+	double ss[6];
+	float mn[4], mx[4];
+};
+
+template <typename PointT>
+inline bool finite(const PointT & p) {
+	return pcl_isfinite(p.x) && pcl_isfinite(p.y) && pcl_isfinite(p.z);
+}
+
+/// Chunk of the parallel loops, the whole cloud if it is small or not parallel.
+inline int grainOf(int n, bool parallel) {
+	return parallel && (size_t) n >= PARALLEL_POINTS ? PARALLEL_POINTS / 4 : std::max(n, 1);
+}
+
+/// Merges partial sums of chunks into count, centroid, bounds and covariance.
+inline void finish(const std::vector<Accumulator> & partial, const float * shift, Result & result) {
+	// Partial results are merged in order of chunks, so the sums do not depend on the number of threads.
+	Accumulator total;
+	for (size_t k = 0; k < partial.size(); ++k)
+		total.merge(partial[k]);
+
+	const double inv = 1.0 / total.n;
+	const double mx = total.s[0] * inv, my = total.s[1] * inv, mz = total.s[2] * inv;
+
+	result.count = total.n;
+	result.centroid = Eigen::Vector4f(shift[0] + mx, shift[1] + my, shift[2] + mz, 1);
+	result.min = Eigen::Vector3f(total.mn[0], total.mn[1], total.mn[2]);
+	result.max = Eigen::Vector3f(total.mx[0], total.mx[1], total.mx[2]);
+
+	result.covariance(0, 0) = total.ss[0] * inv - mx * mx;
+	result.covariance(0, 1) = result.covariance(1, 0) = total.ss[1] * inv - mx * my;
+	result.covariance(0, 2) = result.covariance(2, 0) = total.ss[2] * inv - mx * mz;
+	result.covariance(1, 1) = total.ss[3] * inv - my * my;
+	result.covariance(1, 2) = result.covariance(2, 1) = total.ss[4] * inv - my * mz;
+	result.covariance(2, 2) = total.ss[5] * inv - mz * mz;
+}
+
+/// Body of the parallel loop of compute(), one accumulator per chunk.
+template <typename PointT>
+struct AccumulateBody {
+	AccumulateBody(const pcl::PointCloud<PointT> & cloud, const float * shift, int first, int grain, std::vector<Accumulator> & partial) :
+		cloud(cloud), shift(shift), first(first), grain(grain), partial(partial) {
+	}
+	void operator()(int begin, int end, int) const {
+		const bool dense = cloud.is_dense;
+		Accumulator acc;
+		for (int i = begin; i < end; ++i) {
+			const PointT & p = cloud.points[i];
+			if (dense || finite(p))
+				acc.add(p, shift);
+		}
+		partial[(begin - first) / grain] = acc;
+	}
+	const pcl::PointCloud<PointT> & cloud;
+	const float * shift;
+	int first, grain;
+	std::vector<Accumulator> & partial;
+};
+
+/// Body of the parallel loop of computeOBB(), bounds per chunk.
+template <typename PointT>
+struct ObbBody {
+	ObbBody(const pcl::PointCloud<PointT> & cloud, const Eigen::Matrix3f & rt, const Eigen::Vector3f & c, int grain, int chunks) :
+		cloud(cloud), rt(rt), c(c), grain(grain),
+		mins(chunks, Eigen::Vector3f::Constant(std::numeric_limits<float>::max())),
+		maxs(chunks, Eigen::Vector3f::Constant(-std::numeric_limits<float>::max())) {
+	}
+	void operator()(int begin, int end, int) const {
+		const bool dense = cloud.is_dense;
+		Eigen::Vector3f mn = mins[begin / grain], mx = maxs[begin / grain];
+		for (int i = begin; i < end; ++i) {
+			const PointT & p = cloud.points[i];
+			if (!dense && !finite(p))
+				continue;
+			const Eigen::Vector3f q = rt * (Eigen::Vector3f(p.x, p.y, p.z) - c);
+			mn = mn.cwiseMin(q);
+			mx = mx.cwiseMax(q);
+		}
+		mins[begin / grain] = mn;
+		maxs[begin / grain] = mx;
+	}
+	const pcl::PointCloud<PointT> & cloud;
+	const Eigen::Matrix3f & rt;
+	const Eigen::Vector3f & c;
+	int grain;
+	mutable std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > mins, maxs;
+};
+
+/// Oriented bounding box: axes from the covariance, bounds from a pass over the points.
+template <typename PointT>
+void computeOBB(const pcl::PointCloud<PointT> & cloud, Result & result, bool parallel) {
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(result.covariance);
+	result.axes = solver.eigenvectors();
+	if (result.axes.determinant() < 0)
+		result.axes.col(2) = -result.axes.col(2);
+
+	const Eigen::Matrix3f rt = result.axes.transpose();
+	const Eigen::Vector3f c = result.centroid.head<3>();
+	const int n = cloud.points.size();
+	const int grain = grainOf(n, parallel);
+
+	ObbBody<PointT> body(cloud, rt, c, grain, ThreadPool::chunks(0, n, grain));
+	ThreadPool::parallelFor(0, n, grain, body);
+
+	result.obb_min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+	result.obb_max = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+	for (size_t k = 0; k < body.mins.size(); ++k) {
+		result.obb_min = result.obb_min.cwiseMin(body.mins[k]);
+		result.obb_max = result.obb_max.cwiseMax(body.maxs[k]);
+	}
+}
+
+/*!
+ * Computes count, centroid, bounds and covariance in one pass over the cloud,
+ * split between threads for large clouds when parallel is set. Oriented
+ * bounding box needs the axes first, so it costs a second pass and is
+ * computed only if obb is set.
+ */
+template <typename PointT>
+void compute(const pcl::PointCloud<PointT> & cloud, Result & result, bool obb = false, bool parallel = true) {
+	result.count = 0;
+	const int n = cloud.points.size();
+
+	// Shift by the first finite point.
+	int first = 0;
+	while (first < n && !finite(cloud.points[first]))
+		++first;
+	if (first == n)
+		return;
+	const float shift[3] = { cloud.points[first].x, cloud.points[first].y, cloud.points[first].z };
+
+	const int grain = grainOf(n - first, parallel);
+
+	std::vector<Accumulator> partial(ThreadPool::chunks(first, n, grain));
+	ThreadPool::parallelFor(first, n, grain, AccumulateBody<PointT>(cloud, shift, first, grain, partial));
+
+	finish(partial, shift, result);
+	if (obb)
+		computeOBB(cloud, result, parallel);
+}
+
+/// Body of the parallel loop of compute() of SoA clouds.
+template <typename PointT>
+struct AccumulateSoABody {
+	AccumulateSoABody(const SoACloud<PointT> & cloud, const float * shift, int first, int grain, std::vector<Accumulator> & partial) :
+		cloud(cloud), shift(shift), first(first), grain(grain), partial(partial) {
+	}
+	void operator()(int begin, int end, int) const {
+		const bool dense = cloud.isDense();
+		const float * x = cloud.x(), * y = cloud.y(), * z = cloud.z();
+		Accumulator acc;
+		for (int i = begin; i < end; ++i)
+			if (dense || (pcl_isfinite(x[i]) && pcl_isfinite(y[i]) && pcl_isfinite(z[i])))
+				acc.add(x[i], y[i], z[i], shift);
+		partial[(begin - first) / grain] = acc;
+	}
+	const SoACloud<PointT> & cloud;
+	const float * shift;
+	int first, grain;
+	std::vector<Accumulator> & partial;
+};
+
+/*!
+ * As compute() of pcl::PointCloud, reading only the coordinate arrays of
+ * the SoA cloud. Oriented bounding box is not computed.
+ */
+template <typename PointT>
+void compute(const SoACloud<PointT> & cloud, Result & result, bool parallel = true) {
+	result.count = 0;
+	const int n = cloud.size();
+	const float * x = cloud.x(), * y = cloud.y(), * z = cloud.z();
+
+	int first = 0;
+	while (first < n && !(pcl_isfinite(x[first]) && pcl_isfinite(y[first]) && pcl_isfinite(z[first])))
+		++first;
+	if (first == n)
+		return;
+	const float shift[3] = { x[first], y[first], z[first] };
+
+	const int grain = grainOf(n - first, parallel);
+	std::vector<Accumulator> partial(ThreadPool::chunks(first, n, grain));
+	ThreadPool::parallelFor(first, n, grain, AccumulateSoABody<PointT>(cloud, shift, first, grain, partial));
+	finish(partial, shift, result);
+}
+
+} //: namespace CloudStatistics
+} //: namespace Types
+
+#endif /* CLOUD_STATISTICS_HPP_ */
@@ -0,0 +1,264 @@
+/*!
+ * \file
+ * \brief Rigid transformation of point clouds and batches of clouds.
+ * \author Michal Laszkowski
+ */
+
+#ifndef CLOUDTRANSFORM_HPP_
+#define CLOUDTRANSFORM_HPP_
+
+#include <vector>
+#include <algorithm>
+
+#include <Eigen/Core>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+#include "Types/CloudPool.hpp"
+#include "Types/SoACloud.hpp"
+#include "Types/ThreadPool.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLOUD_TRANSFORM_SSE
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CLOUD_TRANSFORM_NEON
+#endif
+
+namespace Types {
+namespace CloudTransform {
+
+/// True for point types carrying a normal, which is rotated together with the point.
+template <typename PointT>
+struct HasNormal {
+	static const bool value = false;
+};
+
+template <> struct HasNormal<pcl::PointNormal> { static const bool value = true; };
+template <> struct HasNormal<pcl::PointXYZRGBNormal> { static const bool value = true; };
+template <> struct HasNormal<pcl::PointXYZINormal> { static const bool value = true; };
+
+/// Clouds with fewer points are transformed by a single thread.
+static const size_t PARALLEL_POINTS = 16384;
+
+/*!
+ * \class Kernel
+ * \brief 4x4 transformation applied to the 4-float xyz (or normal) block of a point.
+ *
+ * Only that block is read and written, other fields (color, descriptors...)
+ * are never touched. The homogeneous coordinate is always set to 1 for
+ * points and 0 for normals, as in PCL.
+ */
+class Kernel {
+public:
+	explicit Kernel(const Eigen::Matrix4f & m) {
+		for (int c = 0; c < 4; ++c) {
+			for (int r = 0; r < 3; ++r)
+				col_[c][r] = m(r, c);
+			col_[c][3] = c == 3 ? 1.0f : 0.0f;
+		}
+#if defined(CLOUD_TRANSFORM_SSE)
+		for (int c = 0; c < 4; ++c)
+			vcol_[c] = _mm_loadu_ps(col_[c]);
+#elif defined(CLOUD_TRANSFORM_NEON)
+		for (int c = 0; c < 4; ++c)
+			vcol_[c] = vld1q_f32(col_[c]);
+#endif
+	}
+
+	/// Transforms point (x, y, z, w) in place.
+	void point(float * p) const {
+#if defined(CLOUD_TRANSFORM_SSE)
+		const __m128 v = _mm_loadu_ps(p);
+		__m128 r = _mm_add_ps(_mm_mul_ps(vcol_[0], _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0))), vcol_[3]);
+		r = _mm_add_ps(r, _mm_mul_ps(vcol_[1], _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm_add_ps(r, _mm_mul_ps(vcol_[2], _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+		_mm_storeu_ps(p, r);
+#elif defined(CLOUD_TRANSFORM_NEON)
+		float32x4_t r = vmlaq_n_f32(vcol_[3], vcol_[0], p[0]);
+		r = vmlaq_n_f32(r, vcol_[1], p[1]);
+		r = vmlaq_n_f32(r, vcol_[2], p[2]);
+		vst1q_f32(p, r);
+#else
+		const float x = p[0], y = p[1], z = p[2];
+		for (int r = 0; r < 4; ++r)
+			p[r] = col_[0][r] * x + col_[1][r] * y + col_[2][r] * z + col_[3][r];
+#endif
+	}
+
+	/// Rotates normal (nx, ny, nz, 0) in place.
+	void normal(float * n) const {
+#if defined(CLOUD_TRANSFORM_SSE)
+		const __m128 v = _mm_loadu_ps(n);
+		__m128 r = _mm_mul_ps(vcol_[0], _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+		r = _mm_add_ps(r, _mm_mul_ps(vcol_[1], _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm_add_ps(r, _mm_mul_ps(vcol_[2], _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+		_mm_storeu_ps(n, r);
+#elif defined(CLOUD_TRANSFORM_NEON)
+		float32x4_t r = vmulq_n_f32(vcol_[0], n[0]);
+		r = vmlaq_n_f32(r, vcol_[1], n[1]);
+		r = vmlaq_n_f32(r, vcol_[2], n[2]);
+		vst1q_f32(n, r);
+#else
+		const float x = n[0], y = n[1], z = n[2];
+		for (int r = 0; r < 4; ++r)
+			n[r] = col_[0][r] * x + col_[1][r] * y + col_[2][r] * z;
+#endif
+	}
+
+private:
+	/// Columns of the matrix, the last one is translation.
+	float col_[4][4];
+
+#if defined(CLOUD_TRANSFORM_SSE)
+	__m128 vcol_[4];
+#elif defined(CLOUD_TRANSFORM_NEON)
+	float32x4_t vcol_[4];
+#endif
+
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+template <bool Normal>
+struct Apply {
+	template <typename PointT>
+	static void run(const Kernel & k, PointT & p) {
+		k.point(p.data);
+	}
+};
+
+template <>
+struct Apply<true> {
+	template <typename PointT>
+	static void run(const Kernel & k, PointT & p) {
+		k.point(p.data);
+		k.normal(p.data_n);
+	}
+};
+
+/// Transforms range of points in place.
+template <typename PointT>
+inline void transformPoints(const Kernel & k, PointT * points, size_t n) {
+	for (size_t i = 0; i < n; ++i)
+		Apply<HasNormal<PointT>::value>::run(k, points[i]);
+}
+
+/// Body of the parallel loop of transformInPlace().
+template <typename PointT>
+struct PointsBody {
+	PointsBody(const Kernel & k, PointT * points) : k(k), points(points) {
+	}
+	void operator()(int begin, int end, int) const {
+		transformPoints(k, points + begin, end - begin);
+	}
+	const Kernel & k;
+	PointT * points;
+};
+
+/*!
+ * Transforms the cloud in place. Large clouds are split between threads
+ * unless parallel is false (e.g. when called from a parallel batch).
+ */
+template <typename PointT>
+void transformInPlace(pcl::PointCloud<PointT> & cloud, const Eigen::Matrix4f & m, bool parallel = true) {
+	const Kernel k(m);
+	const int n = cloud.points.size();
+	if (n == 0)
+		return;
+	PointT * points = &cloud.points[0];
+
+	if (!parallel || (size_t) n < PARALLEL_POINTS) {
+		transformPoints(k, points, n);
+		return;
+	}
+
+	ThreadPool::parallelFor(0, n, 4096, PointsBody<PointT>(k, points));
+}
+
+/// Body of the parallel loop of transformInPlace() of SoA clouds.
+struct ArraysBody {
+	ArraysBody(const Eigen::Matrix4f & m, float * x, float * y, float * z) : m(m), x(x), y(y), z(z) {
+	}
+	void operator()(int begin, int end, int) const {
+		const float m00 = m(0, 0), m01 = m(0, 1), m02 = m(0, 2), m03 = m(0, 3);
+		const float m10 = m(1, 0), m11 = m(1, 1), m12 = m(1, 2), m13 = m(1, 3);
+		const float m20 = m(2, 0), m21 = m(2, 1), m22 = m(2, 2), m23 = m(2, 3);
+		// Separate arrays, so the compiler vectorizes the loop over points.
+		for (int i = begin; i < end; ++i) {
+			const float px = x[i], py = y[i], pz = z[i];
+			x[i] = m00 * px + m01 * py + m02 * pz + m03;
+			y[i] = m10 * px + m11 * py + m12 * pz + m13;
+			z[i] = m20 * px + m21 * py + m22 * pz + m23;
+		}
+	}
+	const Eigen::Matrix4f & m;
+	float * x, * y, * z;
+};
+
+/*!
+ * Transforms coordinates of the SoA cloud in place. Records in the source
+ * cloud (descriptors...) are not touched; types with normals are not
+ * supported, SoACloud does not keep them.
+ */
+template <typename PointT>
+void transformInPlace(SoACloud<PointT> & cloud, const Eigen::Matrix4f & m, bool parallel = true) {
+	const int n = cloud.size();
+	const int grain = parallel && (size_t) n >= PARALLEL_POINTS ? 4096 : std::max(n, 1);
+	ThreadPool::parallelFor(0, n, grain, ArraysBody(m, cloud.x(), cloud.y(), cloud.z()));
+}
+
+/// Transforms the cloud into output, which may be the same cloud.
+template <typename PointT>
+void transform(const pcl::PointCloud<PointT> & input, pcl::PointCloud<PointT> & output, const Eigen::Matrix4f & m, bool parallel = true) {
+	if (&input != &output)
+		output = input;
+	transformInPlace(output, m, parallel);
+}
+
+/// Body of the parallel loop of transformBatch().
+template <typename PointT>
+struct BatchBody {
+	BatchBody(const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds, const Eigen::Matrix4f * transforms, size_t count,
+			std::vector<typename pcl::PointCloud<PointT>::Ptr> & output) :
+		clouds(clouds), transforms(transforms), count(count), output(output) {
+	}
+	void operator()(int begin, int end, int) const {
+		for (int i = begin; i < end; ++i)
+			if (clouds[i])
+				transform(*clouds[i], *output[i], transforms[(size_t) i < count ? i : 0], false);
+	}
+	const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds;
+	const Eigen::Matrix4f * transforms;
+	size_t count;
+	std::vector<typename pcl::PointCloud<PointT>::Ptr> & output;
+};
+
+/*!
+ * Transforms a batch of clouds in parallel, cloud i by transforms[i],
+ * or by transforms[0] when fewer than clouds.size() transforms are given.
+ * With in_place the input clouds are modified and returned as output,
+ * otherwise new clouds are taken from the pool.
+ */
+template <typename PointT>
+void transformBatch(const std::vector<typename pcl::PointCloud<PointT>::Ptr> & clouds,
+		const Eigen::Matrix4f * transforms, size_t count, bool in_place,
+		std::vector<typename pcl::PointCloud<PointT>::Ptr> & output) {
+	const int n = clouds.size();
+	output.resize(n);
+	if (count == 0)
+		return;
+
+	// Output clouds are allocated up front, so the parallel part only computes.
+	for (int i = 0; i < n; ++i)
+		output[i] = in_place || !clouds[i] ? clouds[i] : CloudPool<PointT>::acquire(clouds[i]->size());
+
+	ThreadPool::parallelFor(0, n, 1, BatchBody<PointT>(clouds, transforms, count, output));
+}
+
+} //: namespace CloudTransform
+} //: namespace Types
+
+#endif /* CLOUDTRANSFORM_HPP_ */
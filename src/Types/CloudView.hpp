@@ -0,0 +1,104 @@
+/*!
+ * \file
+ * \brief View of a subset of points of a shared cloud.
+ * \author Micha Laszkowski
+ */
+
+#ifndef CLOUDVIEW_HPP_
+#define CLOUDVIEW_HPP_
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+
+#include "Types/CloudPool.hpp"
+
+namespace Types {
+
+/*!
+ * \class CloudView
+ * \brief Parent cloud plus indices of the points that belong to the view.
+ *
+ * Points are not copied: the view keeps the parent cloud and the index list
+ * alive and reads through them. Views produced by split() share a single
+ * allocation of all cluster indices. A standalone cloud is made only on
+ * demand, with copy().
+ */
+template <typename PointT>
+class CloudView {
+public:
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::Ptr CloudPtr;
+	typedef typename Cloud::ConstPtr CloudConstPtr;
+	typedef boost::shared_ptr<const pcl::PointIndices> IndicesConstPtr;
+
+	CloudView() {}
+
+	CloudView(const CloudConstPtr & cloud, const IndicesConstPtr & indices) :
+		cloud_(cloud), indices_(indices) {}
+
+	/// Creates views of all clusters of the cloud, sharing the cluster list.
+	static std::vector<CloudView<PointT> > split(const CloudConstPtr & cloud, const boost::shared_ptr<const std::vector<pcl::PointIndices> > & clusters) {
+		std::vector<CloudView<PointT> > views;
+		views.reserve(clusters->size());
+		for (size_t i = 0; i < clusters->size(); ++i)
+			// Aliasing constructor - view owns the whole list, points to its element.
+			views.push_back(CloudView<PointT>(cloud, IndicesConstPtr(clusters, &(*clusters)[i])));
+		return views;
+	}
+
+	/// Parent cloud.
+	const CloudConstPtr & cloud() const {
+		return cloud_;
+	}
+
+	/// Indices of points of the view in the parent cloud.
+	const std::vector<int> & indices() const {
+		return indices_->indices;
+	}
+
+	size_t size() const {
+		return indices_ ? indices_->indices.size() : 0;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	/// i-th point of the view.
+	const PointT & operator[](size_t i) const {
+		return cloud_->points[indices_->indices[i]];
+	}
+
+	/// Copies points of the view into the given cloud.
+	void copyTo(Cloud & output) const {
+		output.header = cloud_->header;
+		output.sensor_origin_ = cloud_->sensor_origin_;
+		output.sensor_orientation_ = cloud_->sensor_orientation_;
+		output.points.resize(size());
+		for (size_t i = 0; i < output.points.size(); ++i)
+			output.points[i] = (*this)[i];
+		output.width = output.points.size();
+		output.height = 1;
+		output.is_dense = cloud_->is_dense;
+	}
+
+	/// Makes standalone cloud of the view.
+	CloudPtr copy() const {
+		CloudPtr output = CloudPool<PointT>::acquire(size());
+		if (cloud_)
+			copyTo(*output);
+		return output;
+	}
+
+private:
+	CloudConstPtr cloud_;
+	IndicesConstPtr indices_;
+};
+
+} //: namespace Types
+
+#endif /* CLOUDVIEW_HPP_ */
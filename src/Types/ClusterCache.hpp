@@ -0,0 +1,239 @@
+/*!
+ * \file
+ * \brief Clusters of a static scene carried over between clouds.
+ * \author Micha Laszkowski
+ */
+
+#ifndef CLUSTERCACHE_HPP_
+#define CLUSTERCACHE_HPP_
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+
+#include "Types/ChangeDetector.hpp"
+#include "Types/VoxelHash.hpp"
+
+namespace Types {
+
+/*!
+ * \class ClusterCache
+ * \brief Keeps euclidean clusters of the last cloud and reuses those of unchanged regions.
+ *
+ * Voxels of the cache are cubes of diagonal equal to the cluster tolerance,
+ * so all points of a voxel always belong to the same cluster, and points
+ * within the tolerance of a voxel lie at most two voxels away from it.
+ * Every cloud is compared with the last one by a ChangeDetector, changed
+ * voxels are dilated by those two voxels into a dirty region; clusters
+ * with no voxel in the dirty region are carried over, their
+ * points of the new cloud found through voxels (so indices are remapped to
+ * the new cloud). Only the remaining points are clustered again:
+ *
+ * \code
+ * cache.setTolerance(tolerance);
+ * cache.carry(cloud, min_size, max_size, clusters, rest);
+ * // Euclidean clustering of points rest of cloud into fresh.
+ * cache.merge(cloud, clusters, fresh);
+ * \endcode
+ *
+ * Clusters are sorted by size, largest first, like those of
+ * pcl::EuclideanClusterExtraction.
+ */
+class ClusterCache {
+public:
+	ClusterCache() : tolerance_(0), carried_(0) {
+		detector_.setMinPoints(1);
+		detector_.setThreshold(0, 1);
+	}
+
+	/// Sets the cluster tolerance, cached clusters are dropped when it changes.
+	void setTolerance(float tolerance) {
+		if (tolerance == tolerance_)
+			return;
+		tolerance_ = tolerance;
+		const float leaf = tolerance / std::sqrt(3.0f);
+		detector_.setLeafSize(leaf, leaf, leaf);
+		reset();
+	}
+
+	/// Drops cached clusters, the next cloud is clustered entirely.
+	void reset() {
+		detector_.reset();
+		voxels_.clear();
+	}
+
+	/*!
+	 * Compares the cloud with the last one. Cached clusters of unchanged
+	 * regions (and of min to max size points in the new cloud) are written
+	 * to clusters, indices of other finite points of the cloud to rest.
+	 */
+	template <typename PointT>
+	void carry(const pcl::PointCloud<PointT> & cloud, int min_size, int max_size,
+			std::vector<pcl::PointIndices> & clusters, std::vector<int> & rest) {
+		detector_.detect(cloud, changed_);
+
+		// Dirty region, nothing is kept when most of the scene changed.
+		if (!voxels_.empty())
+			detector_.changedVoxels(changed_keys_);
+		const size_t changed = changed_keys_.size() / 3;
+		if (changed > detector_.occupiedVoxels() / 2)
+			voxels_.clear();
+		dirty_.clear(voxels_.empty() ? 0 : changed * 8);
+		for (size_t v = 0; !voxels_.empty() && v < changed_keys_.size(); v += 3) {
+			int64_t key[3];
+			for (int dx = -REACH; dx <= REACH; ++dx)
+				for (int dy = -REACH; dy <= REACH; ++dy)
+					for (int dz = -REACH; dz <= REACH; ++dz) {
+						key[0] = changed_keys_[v] + dx;
+						key[1] = changed_keys_[v + 1] + dy;
+						key[2] = changed_keys_[v + 2] + dz;
+						bool inserted;
+						dirty_.insert(key, inserted);
+					}
+		}
+		changed_keys_.clear();
+
+		// Voxels of kept clusters.
+		owner_table_.clear(voxels_.size() * 8);
+		owner_.clear();
+		int kept = 0;
+		for (size_t c = 0; c < voxels_.size(); ++c) {
+			if (!clean(voxels_[c]))
+				continue;
+			for (size_t v = 0; v < voxels_[c].size(); v += 3) {
+				bool inserted;
+				owner_table_.insert(&voxels_[c][v], inserted);
+				if (inserted)
+					owner_.push_back(kept);
+			}
+			++kept;
+		}
+
+		// Points of kept clusters, remaining ones are clustered again.
+		clusters.assign(kept, pcl::PointIndices());
+		rest.clear();
+		for (size_t i = 0; i < cloud.size(); ++i) {
+			const PointT & p = cloud.points[i];
+			if (!finite(p.x) || !finite(p.y) || !finite(p.z))
+				continue;
+			int64_t key[3];
+			detector_.key(p.x, p.y, p.z, key);
+			const int v = owner_table_.find(key);
+			if (v >= 0)
+				clusters[owner_[v]].indices.push_back(i);
+			else
+				rest.push_back(i);
+		}
+
+		// Kept clusters may have grown or shrunk out of the size limits.
+		size_t out = 0;
+		for (size_t c = 0; c < clusters.size(); ++c) {
+			const int size = clusters[c].indices.size();
+			if (size >= min_size && size <= max_size) {
+				if (out != c)
+					clusters[out].indices.swap(clusters[c].indices);
+				++out;
+			} else {
+				rest.insert(rest.end(), clusters[c].indices.begin(), clusters[c].indices.end());
+			}
+		}
+		clusters.resize(out);
+		if (out < (size_t) kept)
+			std::sort(rest.begin(), rest.end());
+		carried_ = out;
+	}
+
+	/*!
+	 * Appends clusters of the rest of the cloud to carried clusters, sorts
+	 * them and remembers their voxels for the next cloud.
+	 */
+	template <typename PointT>
+	void merge(const pcl::PointCloud<PointT> & cloud, std::vector<pcl::PointIndices> & clusters,
+			const std::vector<pcl::PointIndices> & fresh) {
+		clusters.insert(clusters.end(), fresh.begin(), fresh.end());
+		std::stable_sort(clusters.begin(), clusters.end(), larger);
+
+		voxels_.resize(clusters.size());
+		for (size_t c = 0; c < clusters.size(); ++c) {
+			clusters[c].header = cloud.header;
+			keys_.clear();
+			for (size_t i = 0; i < clusters[c].indices.size(); ++i) {
+				const PointT & p = cloud.points[clusters[c].indices[i]];
+				Key key;
+				detector_.key(p.x, p.y, p.z, key.k);
+				keys_.push_back(key);
+			}
+			std::sort(keys_.begin(), keys_.end());
+			keys_.erase(std::unique(keys_.begin(), keys_.end()), keys_.end());
+			voxels_[c].resize(3 * keys_.size());
+			for (size_t k = 0; k < keys_.size(); ++k)
+				for (int a = 0; a < 3; ++a)
+					voxels_[c][3 * k + a] = keys_[k].k[a];
+		}
+	}
+
+	/// Clusters carried over by the last carry().
+	size_t carriedClusters() const {
+		return carried_;
+	}
+
+private:
+	struct Key {
+		int64_t k[3];
+
+		bool operator<(const Key & other) const {
+			return k[0] != other.k[0] ? k[0] < other.k[0] : k[1] != other.k[1] ? k[1] < other.k[1] : k[2] < other.k[2];
+		}
+		bool operator==(const Key & other) const {
+			return k[0] == other.k[0] && k[1] == other.k[1] && k[2] == other.k[2];
+		}
+	};
+
+	/// Voxels around a changed voxel which may hold points within the tolerance of its points.
+	static const int REACH = 2;
+
+	/// True if no voxel of the cluster is in the dirty region.
+	bool clean(const std::vector<int64_t> & voxels) const {
+		for (size_t v = 0; v < voxels.size(); v += 3)
+			if (dirty_.find(&voxels[v]) >= 0)
+				return false;
+		return true;
+	}
+
+	static bool larger(const pcl::PointIndices & a, const pcl::PointIndices & b) {
+		return a.indices.size() > b.indices.size();
+	}
+
+	static bool finite(float v) {
+		return std::fabs(v) <= std::numeric_limits<float>::max();
+	}
+
+	float tolerance_;
+	ChangeDetector detector_;
+
+	/// Voxel coordinates (three per voxel) of every cached cluster.
+	std::vector<std::vector<int64_t> > voxels_;
+
+	/// Kept cluster of every voxel of kept clusters, numbered by owner_table_.
+	VoxelHash owner_table_;
+	std::vector<int> owner_;
+
+	/// Changed voxels dilated by REACH.
+	VoxelHash dirty_;
+
+	/// Buffers kept to avoid allocations.
+	std::vector<int> changed_;
+	std::vector<int64_t> changed_keys_;
+	std::vector<Key> keys_;
+
+	size_t carried_;
+};
+
+} //: namespace Types
+
+#endif /* CLUSTERCACHE_HPP_ */
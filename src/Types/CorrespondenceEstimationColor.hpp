@@ -10,6 +10,14 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#include <boost/bind.hpp>
+
+#include <flann/flann.hpp>
 
 #include <pcl/pcl_base.h>
 #include <pcl/common/transforms.h>
@@ -22,6 +30,9 @@
 #include <pcl/common/concatenate.h>
 #include <pcl/common/io.h>
 
+#include "Types/ThreadPool.hpp"
+#include "Types/DeviceSearch.hpp"
+
 namespace pcl {
 namespace registration {
 template<typename PointSource, typename PointTarget, typename Scalar = float>
@@ -40,12 +51,14 @@ public:
 	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::target_;
 	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::corr_name_;
 	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::target_indices_;
+	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::target_cloud_updated_;
 	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::getClassName;
 	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::initCompute;
 	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::initComputeReciprocal;
 	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::input_;
 	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::indices_;
 	using CorrespondenceEstimationBase<PointSource, PointTarget, Scalar>::input_fields_;
+	using PCLBase<PointSource>::fake_indices_;
 	using PCLBase<PointSource>::deinitCompute;
 
 	typedef pcl::search::KdTree<PointTarget> KdTree;
@@ -62,7 +75,9 @@ public:
 	typedef typename KdTree::PointRepresentationConstPtr PointRepresentationConstPtr;
 
 	/** \brief Empty constructor. */
-	CorrespondenceEstimationColor() {
+	CorrespondenceEstimationColor() :
+		k_(25), threads_(0), epsilon_(0), joint_(false), color_weight_(0.0005f), checks_(0), trees_(4),
+		joint_stale_(true), device_(false) {
 		corr_name_ = "CorrespondenceEstimationColor";
 	}
 
@@ -70,6 +85,47 @@ public:
 	virtual ~CorrespondenceEstimationColor() {
 	}
 
+	/** \brief Set the number of geometric neighbours among which the closest color is chosen. */
+	void setColorNeighbours(int k) {
+		k_ = std::max(1, k);
+	}
+
+	/** \brief Set the number of threads used for searching (0 - all threads of the pool). */
+	void setNumberOfThreads(int threads) {
+		threads_ = std::max(0, threads);
+	}
+
+	/** \brief Set the error bound of the approximate kd-tree search (0 - exact search).
+	 * Found neighbours are at most (1 + eps) times farther than the true ones.
+	 */
+	void setEpsilon(float eps) {
+		epsilon_ = std::max(0.0f, eps);
+	}
+
+	/** \brief Use a single XYZRGB index instead of k-NN search followed by color filtering.
+	 * \param[in] enabled true to search in the joint space
+	 * \param[in] color_weight meters per unit of color difference (0-255 scale)
+	 * \param[in] checks number of leaves visited by the approximate search (0 - exact search)
+	 * \param[in] trees number of randomized trees of the approximate index
+	 */
+	void setJointSearch(bool enabled, float color_weight = 0.0005f, int checks = 0, int trees = 4) {
+		joint_ = enabled;
+		color_weight_ = color_weight;
+		checks_ = std::max(0, checks);
+		trees_ = std::max(1, trees);
+		joint_stale_ = true;
+	}
+
+	/** \brief Search neighbours on the GPU (needs build with CUDA).
+	 * The target is uploaded once and kept on the device while it is unchanged,
+	 * queries are uploaded with every call. The joint search, neighbourhoods
+	 * larger than Types::Cuda::MAX_K and other builds search on the CPU.
+	 */
+	void setDeviceSearch(bool enabled) {
+		device_ = enabled;
+		device_target_.reset();
+	}
+
 	/** \brief Determine the correspondences between input and target cloud.
 	 * \param[out] correspondences the found correspondences (index of query point, index of target point, distance)
 	 * \param[in] max_distance maximum allowed distance between correspondences
@@ -77,83 +133,37 @@ public:
 	virtual void determineCorrespondences(pcl::Correspondences &correspondences,
 			double max_distance = std::numeric_limits<double>::max()) {
 
+		checkTarget();
 		if (!initCompute())
 			return;
 
-		double max_dist_sqr = max_distance * max_distance;
-
-		correspondences.resize(indices_->size());
-
-		std::vector<int> index(1);
-		std::vector<float> distance(1);
-		std::vector<float> distanceRGB(1);
-
-		//narazie na pale
-		float minRGB = 2000;
-		int minIndex = -2;
-		float distance_ = 1000;
-
-		pcl::Correspondence corr;
-		unsigned int nr_valid_correspondences = 0;
-
-		// Check if the template types are the same. If true, avoid a copy.
-		// Both point types MUST be registered using the POINT_CLOUD_REGISTER_POINT_STRUCT macro!
-		if (isSamePointType<PointSource, PointTarget>()) {
-			// Iterate over the input set of source indices
-			for (std::vector<int>::const_iterator idx = indices_->begin(); idx != indices_->end(); ++idx) {
-
-				int r = input_->points[*idx].r;
-				int g = input_->points[*idx].g;
-				int b = input_->points[*idx].b;
-
-				tree_->nearestKSearch (input_->points[*idx], 25, index, distance);
-				float mindist = distance[24];
-				float minrgbdist = 999999;
-				int minind = 24;
-				for (int i = 0; i < index.size(); i++) {
-
-					int rr = target_->points[index[i]].r;
-					int gg = target_->points[index[i]].g;
-					int bb = target_->points[index[i]].b;
-
-					float rd = r - rr;
-					float gd = g - gg;
-					float bd = b - bb;
-
-					float distancergb = sqrt(rd*rd + gd*gd + bd*bd);
-
-					if (distancergb < minrgbdist) {
-						minrgbdist = distancergb;
-						minind = i;
-						mindist = distance[i];
-					}
-				}
-				if (mindist > max_dist_sqr)
-					continue;
-
-				corr.index_query = *idx;
-				corr.index_match = index[minind];
-				corr.distance = mindist;
-				correspondences[nr_valid_correspondences++] = corr;
-			}
+		const float max_dist_sqr = max_distance < std::sqrt(std::numeric_limits<float>::max()) ?
+				max_distance * max_distance : std::numeric_limits<float>::max();
+		const int n = indices_->size();
+		const int threads = numberOfThreads();
+
+		// Every query writes its own slot, compacted afterwards to keep the order of indices.
+		correspondences.resize(n);
+		valid_.assign(n, 0);
+
+		if (isSamePointType<PointSource, PointTarget>() && joint_) {
+			buildJointIndex();
+			searchJoint(correspondences, max_dist_sqr, threads);
+		} else if (useDevice(isSamePointType<PointSource, PointTarget>() ? k_ : 1)) {
+			searchDevice(correspondences, max_dist_sqr, isSamePointType<PointSource, PointTarget>() ? k_ : 1, threads);
+		} else if (isSamePointType<PointSource, PointTarget>()) {
+			// Set every time, so that exact search is restored when epsilon is back at 0.
+			tree_->setEpsilon(epsilon_);
+			searchColor(correspondences, max_dist_sqr, threads);
 		} else {
-			PointTarget pt;
-			// Iterate over the input set of source indices
-			for (std::vector<int>::const_iterator idx = indices_->begin();
-					idx != indices_->end(); ++idx) {
-				// Copy the source data to a target PointTarget format so we can search in the tree
-				pt = input_->points[*idx];
-
-				tree_->nearestKSearch(pt, 1, index, distance);
-				if (distance[0] > max_dist_sqr)
-					continue;
-
-				corr.index_query = *idx;
-				corr.index_match = index[0];
-				corr.distance = distance[0];
-				correspondences[nr_valid_correspondences++] = corr;
-			}
+			tree_->setEpsilon(epsilon_);
+			searchNearest(correspondences, max_dist_sqr, threads);
 		}
+
+		unsigned int nr_valid_correspondences = 0;
+		for (int i = 0; i < n; ++i)
+			if (valid_[i])
+				correspondences[nr_valid_correspondences++] = correspondences[i];
 		correspondences.resize(nr_valid_correspondences);
 		deinitCompute();
 	}
@@ -162,6 +172,11 @@ public:
 	 * A correspondence is considered reciprocal if both Src_i has Tgt_i as a
 	 * correspondence, and Tgt_i has Src_i as one.
 	 *
+	 * Runs in three phases, each parallel: forward queries of all source points,
+	 * reverse queries of every distinct matched target point (once, no matter
+	 * how many sources hit it), and filtering into per-chunk results that are
+	 * concatenated in order.
+	 *
 	 * \param[out] correspondences the found correspondences (index of query and target point, distance)
 	 * \param[in] max_distance maximum allowed distance between correspondences
 	 */
@@ -169,6 +184,7 @@ public:
 			pcl::Correspondences &correspondences, double max_distance =
 					std::numeric_limits<double>::max()) {
 
+		checkTarget();
 		if (!initCompute())
 			return;
 
@@ -176,86 +192,525 @@ public:
 		// Set the internal point representation of choice
 		if (!initComputeReciprocal())
 			return;
-		double max_dist_sqr = max_distance * max_distance;
-
-		correspondences.resize(indices_->size());
-		std::vector<int> index(1);
-		std::vector<float> distance(1);
-		std::vector<int> index_reciprocal(1);
-		std::vector<float> distance_reciprocal(1);
-		pcl::Correspondence corr;
-		unsigned int nr_valid_correspondences = 0;
-		int target_idx = 0;
 
-		// Check if the template types are the same. If true, avoid a copy.
-		// Both point types MUST be registered using the POINT_CLOUD_REGISTER_POINT_STRUCT macro!
-		if (isSamePointType<PointSource, PointTarget>()) {
-			// Iterate over the input set of source indices
-			for (std::vector<int>::const_iterator idx = indices_->begin();
-					idx != indices_->end(); ++idx) {
-				tree_->nearestKSearch(input_->points[*idx], 1, index, distance);
+		const float max_dist_sqr = max_distance < std::sqrt(std::numeric_limits<float>::max()) ?
+				max_distance * max_distance : std::numeric_limits<float>::max();
+		const int n = indices_->size();
+		const int threads = numberOfThreads();
+		tree_->setEpsilon(epsilon_);
+		tree_reciprocal_->setEpsilon(epsilon_);
+		prepareBuffers(threads, 1);
+
+		// Forward queries.
+		const bool device = useDevice(1);
+		forward_match_.resize(n);
+		forward_distance_.resize(n);
+		if (device)
+			forwardDevice(max_dist_sqr);
+		else
+			Types::ThreadPool::parallelFor(0, n, GRAIN,
+					boost::bind(&CorrespondenceEstimationColor::searchForward, this, _1, _2, _3, max_dist_sqr), threads);
+
+		// Distinct matched targets, each queried once. Every reverse query owns
+		// its slot of the cache, so no locking is needed.
+		reverse_match_.assign(target_->points.size(), (int) UNKNOWN);
+		reverse_targets_.clear();
+		for (int i = 0; i < n; ++i) {
+			const int m = forward_match_[i];
+			if (m >= 0 && reverse_match_[m] == UNKNOWN) {
+				reverse_match_[m] = PENDING;
+				reverse_targets_.push_back(m);
+			}
+		}
 
-				if (distance[0] > max_dist_sqr)
-					continue;
+		const int targets = reverse_targets_.size();
+		if (device)
+			reverseDevice(max_dist_sqr);
+		else
+			Types::ThreadPool::parallelFor(0, targets, GRAIN,
+					boost::bind(&CorrespondenceEstimationColor::searchReverse, this, _1, _2, _3, max_dist_sqr), threads);
+
+		// Filtering, chunk c of the loop is the c-th contiguous range, so
+		// concatenating the chunks in order keeps the source order.
+		const int chunks = Types::ThreadPool::chunks(0, n, GRAIN);
+		chunks_.resize(chunks);
+		Types::ThreadPool::parallelFor(0, n, GRAIN,
+				boost::bind(&CorrespondenceEstimationColor::filterReciprocal, this, _1, _2), threads);
+
+		size_t total = 0;
+		for (int c = 0; c < chunks; ++c)
+			total += chunks_[c].size();
+		correspondences.resize(total);
+		pcl::Correspondences::iterator out = correspondences.begin();
+		for (int c = 0; c < chunks; ++c)
+			out = std::copy(chunks_[c].begin(), chunks_[c].end(), out);
+		deinitCompute();
+	}
 
-				target_idx = index[0];
+	/** \brief Clone and cast to CorrespondenceEstimationBase */
+	virtual boost::shared_ptr<
+			CorrespondenceEstimationBase<PointSource, PointTarget, Scalar> > clone() const {
+		Ptr copy(
+				new CorrespondenceEstimationColor<PointSource, PointTarget, Scalar>(
+						*this));
+		return (copy);
+	}
 
-				tree_reciprocal_->nearestKSearch(target_->points[target_idx], 1,
-						index_reciprocal, distance_reciprocal);
-				if (distance_reciprocal[0] > max_dist_sqr
-						|| *idx != index_reciprocal[0])
-					continue;
+private:
+	typedef flann::Index<flann::L2_Simple<float> > JointIndex;
 
-				corr.index_query = *idx;
-				corr.index_match = index[0];
-				corr.distance = distance[0];
-				correspondences[nr_valid_correspondences++] = corr;
-			}
-		} else {
-			PointTarget pt_src;
-			PointSource pt_tgt;
+	/** \brief Queries searched together in the joint index. */
+	static const int BLOCK = 256;
 
-			// Iterate over the input set of source indices
-			for (std::vector<int>::const_iterator idx = indices_->begin();
-					idx != indices_->end(); ++idx) {
-				// Copy the source data to a target PointTarget format so we can search in the tree
-				pt_src = input_->points[*idx];
+	/** \brief Queries handed out at once to a thread of the pool. */
+	static const int GRAIN = 256;
 
-				tree_->nearestKSearch(pt_src, 1, index, distance);
-				//
+	/** \brief States of the reverse query cache. */
+	enum { UNKNOWN = -2, PENDING = -3 };
 
-				if (distance[0] > max_dist_sqr)
-					continue;
+	/** \brief Marks the joint index and the device target stale if a target or target indices were set.
+	 * Checked before initCompute(), which clears the flag. Buffers of recycled
+	 * clouds may have the same address and size, so the flag is the only way to
+	 * tell a new target.
+	 */
+	void checkTarget() {
+		if (!target_cloud_updated_)
+			return;
+		joint_stale_ = true;
+		device_target_.reset();
+	}
+
+	/** \brief Threads running the search loops, slots of the per-thread buffers. */
+	int numberOfThreads() const {
+		const int pool = Types::ThreadPool::instance().threads();
+		return threads_ > 0 ? std::min(threads_, pool) : pool;
+	}
 
-				target_idx = index[0];
+	template<typename PointT>
+	static bool finite(const PointT & p) {
+		return pcl_isfinite(p.x) && pcl_isfinite(p.y) && pcl_isfinite(p.z);
+	}
+
+	/** \brief Point as the other type, without a copy when types are the same. */
+	template<typename PointIn, typename PointOut>
+	static const PointOut & convert(const PointIn & p, PointOut & tmp) {
+		pcl::copyPoint(p, tmp);
+		return tmp;
+	}
+
+	template<typename PointT>
+	static const PointT & convert(const PointT & p, PointT &) {
+		return p;
+	}
 
-				// Copy the target data to a target PointSource format so we can search in the tree_reciprocal
-				pt_tgt = target_->points[target_idx];
+	/** \brief Squared distance in RGB space, the order is the same as of the distance itself. */
+	static float colorDistance(const PointSource & a, const PointTarget & b) {
+		const float rd = (float) a.r - b.r;
+		const float gd = (float) a.g - b.g;
+		const float bd = (float) a.b - b.b;
+		return rd * rd + gd * gd + bd * bd;
+	}
+
+	static float squaredDistance(const PointSource & a, const PointTarget & b) {
+		const float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	/** \brief Prepares search result buffers for every thread, kept between calls. */
+	void prepareBuffers(int threads, int k) {
+		thread_indices_.resize(threads);
+		thread_distances_.resize(threads);
+		for (int t = 0; t < threads; ++t) {
+			thread_indices_[t].reserve(k);
+			thread_distances_[t].reserve(k);
+		}
+	}
+
+	/** \brief Forward queries [begin, end) of the reciprocal search. */
+	void searchForward(int begin, int end, int slot, float max_dist_sqr) {
+		std::vector<int> & index = thread_indices_[slot];
+		std::vector<float> & distance = thread_distances_[slot];
+		for (int i = begin; i < end; ++i) {
+			forward_match_[i] = -1;
+			const PointSource & p = input_->points[(*indices_)[i]];
+			if (!finite(p))
+				continue;
+
+			PointTarget pt;
+			if (tree_->nearestKSearch(convert(p, pt), 1, index, distance) < 1 || distance[0] > max_dist_sqr)
+				continue;
+			forward_match_[i] = index[0];
+			forward_distance_[i] = distance[0];
+		}
+	}
+
+	/** \brief Reverse queries of matched targets [begin, end). */
+	void searchReverse(int begin, int end, int slot, float max_dist_sqr) {
+		std::vector<int> & index = thread_indices_[slot];
+		std::vector<float> & distance = thread_distances_[slot];
+		for (int j = begin; j < end; ++j) {
+			const int m = reverse_targets_[j];
+			PointSource ps;
+			if (tree_reciprocal_->nearestKSearch(convert(target_->points[m], ps), 1, index, distance) < 1
+					|| distance[0] > max_dist_sqr)
+				reverse_match_[m] = -1;
+			else
+				reverse_match_[m] = index[0];
+		}
+	}
+
+	/** \brief Reciprocal correspondences of sources [begin, end), into the chunk of the range. */
+	void filterReciprocal(int begin, int end) {
+		pcl::Correspondences & chunk = chunks_[begin / GRAIN];
+		chunk.clear();
+		for (int i = begin; i < end; ++i) {
+			const int m = forward_match_[i];
+			if (m < 0 || reverse_match_[m] != (*indices_)[i])
+				continue;
+			pcl::Correspondence corr;
+			corr.index_query = (*indices_)[i];
+			corr.index_match = m;
+			corr.distance = forward_distance_[i];
+			chunk.push_back(corr);
+		}
+	}
+
+	/** \brief k geometric neighbours, the one of the closest color is chosen. */
+	void searchColor(pcl::Correspondences & correspondences, float max_dist_sqr, int threads) {
+		prepareBuffers(threads, k_);
+		Types::ThreadPool::parallelFor(0, indices_->size(), GRAIN, boost::bind(&CorrespondenceEstimationColor::searchColorRange,
+				this, _1, _2, _3, boost::ref(correspondences), max_dist_sqr), threads);
+	}
 
-				tree_reciprocal_->nearestKSearch(pt_tgt, 1, index_reciprocal,
-						distance_reciprocal);
-				if (distance_reciprocal[0] > max_dist_sqr
-						|| *idx != index_reciprocal[0])
+	void searchColorRange(int begin, int end, int slot, pcl::Correspondences & correspondences, float max_dist_sqr) {
+		std::vector<int> & index = thread_indices_[slot];
+		std::vector<float> & distance = thread_distances_[slot];
+		for (int i = begin; i < end; ++i) {
+			const int query = (*indices_)[i];
+			const PointSource & p = input_->points[query];
+			if (!finite(p))
+				continue;
+
+			const int found = tree_->nearestKSearch(p, k_, index, distance);
+
+			int best = -1;
+			float best_rgb = std::numeric_limits<float>::max();
+			for (int j = 0; j < found; ++j) {
+				if (distance[j] > max_dist_sqr)
 					continue;
+				const float d = colorDistance(p, target_->points[index[j]]);
+				if (d < best_rgb) {
+					best_rgb = d;
+					best = j;
+				}
+			}
+			if (best < 0)
+				continue;
+
+			correspondences[i].index_query = query;
+			correspondences[i].index_match = index[best];
+			correspondences[i].distance = distance[best];
+			valid_[i] = 1;
+		}
+	}
+
+	/** \brief Plain nearest neighbour, used when point types differ. */
+	void searchNearest(pcl::Correspondences & correspondences, float max_dist_sqr, int threads) {
+		prepareBuffers(threads, 1);
+		Types::ThreadPool::parallelFor(0, indices_->size(), GRAIN, boost::bind(&CorrespondenceEstimationColor::searchNearestRange,
+				this, _1, _2, _3, boost::ref(correspondences), max_dist_sqr), threads);
+	}
+
+	void searchNearestRange(int begin, int end, int slot, pcl::Correspondences & correspondences, float max_dist_sqr) {
+		std::vector<int> & index = thread_indices_[slot];
+		std::vector<float> & distance = thread_distances_[slot];
+		for (int i = begin; i < end; ++i) {
+			const int query = (*indices_)[i];
+			if (!finite(input_->points[query]))
+				continue;
+
+			// Copy the source data to a target PointTarget format so we can search in the tree
+			PointTarget pt;
+			if (tree_->nearestKSearch(convert(input_->points[query], pt), 1, index, distance) < 1 || distance[0] > max_dist_sqr)
+				continue;
 
-				corr.index_query = *idx;
-				corr.index_match = index[0];
-				corr.distance = distance[0];
-				correspondences[nr_valid_correspondences++] = corr;
+			correspondences[i].index_query = query;
+			correspondences[i].index_match = index[0];
+			correspondences[i].distance = distance[0];
+			valid_[i] = 1;
+		}
+	}
+
+	/** \brief True if queries of k neighbours run on the GPU. */
+	bool useDevice(int k) const {
+		return device_ && Types::Cuda::available() && k <= Types::Cuda::MAX_K && Types::Cuda::searchable<PointSource>()
+				&& Types::Cuda::searchable<PointTarget>();
+	}
+
+	/** \brief Search radius of the device, 0 - unbounded. */
+	static float deviceRadius(float max_dist_sqr) {
+		return max_dist_sqr < std::numeric_limits<float>::max() ? std::sqrt(max_dist_sqr) : 0.0f;
+	}
+
+	/** \brief Index of the target point of the device target. */
+	int targetIndex(int j) const {
+		return device_map_.empty() ? j : device_map_[j];
+	}
+
+	/** \brief Uploads the target (finite points of target indices only), unless it was uploaded since it was set. */
+	void uploadTarget() {
+		if (device_target_)
+			return;
+
+		device_map_.clear();
+		if (!target_indices_ || target_indices_->empty()) {
+			device_target_ = Types::DeviceCloud<PointTarget>::upload(target_);
+			return;
+		}
+		PointCloudTargetPtr subset(new PointCloudTarget);
+		subset->points.reserve(target_indices_->size());
+		for (size_t i = 0; i < target_indices_->size(); ++i) {
+			const int idx = (*target_indices_)[i];
+			if (!finite(target_->points[idx]))
+				continue;
+			subset->points.push_back(target_->points[idx]);
+			device_map_.push_back(idx);
+		}
+		subset->width = subset->points.size();
+		subset->height = 1;
+		device_target_ = Types::DeviceCloud<PointTarget>::upload(subset);
+	}
+
+	/** \brief Uploads source points of indices, in their order. */
+	void uploadQueries() {
+		if (fake_indices_) {
+			device_queries_ = Types::DeviceCloud<PointSource>::upload(input_);
+			return;
+		}
+		PointCloudSourcePtr queries(new PointCloudSource);
+		queries->points.resize(indices_->size());
+		for (size_t i = 0; i < indices_->size(); ++i)
+			queries->points[i] = input_->points[(*indices_)[i]];
+		queries->width = queries->points.size();
+		queries->height = 1;
+		device_queries_ = Types::DeviceCloud<PointSource>::upload(queries);
+	}
+
+	/** \brief k geometric neighbours found on the GPU, the one of the closest color is chosen on the CPU. */
+	void searchDevice(pcl::Correspondences & correspondences, float max_dist_sqr, int k, int threads) {
+		uploadTarget();
+		uploadQueries();
+		Types::Cuda::nearestK(*device_queries_, *device_target_, k, deviceRadius(max_dist_sqr), device_indices_, device_distances_);
+		Types::ThreadPool::parallelFor(0, indices_->size(), GRAIN, boost::bind(&CorrespondenceEstimationColor::selectDeviceRange,
+				this, _1, _2, boost::ref(correspondences), max_dist_sqr, k), threads);
+	}
+
+	void selectDeviceRange(int begin, int end, pcl::Correspondences & correspondences, float max_dist_sqr, int k) {
+		for (int i = begin; i < end; ++i) {
+			const int query = (*indices_)[i];
+			const PointSource & p = input_->points[query];
+			const int * index = &device_indices_[i * k];
+			const float * distance = &device_distances_[i * k];
+
+			// Neighbours are sorted and padded with -1, a single one needs no colors.
+			int best = -1;
+			float best_rgb = std::numeric_limits<float>::max();
+			for (int j = 0; j < k && index[j] >= 0 && distance[j] <= max_dist_sqr; ++j) {
+				const float d = k > 1 ? colorDistance(p, target_->points[targetIndex(index[j])]) : 0.0f;
+				if (d < best_rgb) {
+					best_rgb = d;
+					best = j;
+				}
 			}
+			if (best < 0)
+				continue;
+
+			correspondences[i].index_query = query;
+			correspondences[i].index_match = targetIndex(index[best]);
+			correspondences[i].distance = distance[best];
+			valid_[i] = 1;
 		}
-		correspondences.resize(nr_valid_correspondences);
-		deinitCompute();
 	}
 
-	/** \brief Clone and cast to CorrespondenceEstimationBase */
-	virtual boost::shared_ptr<
-			CorrespondenceEstimationBase<PointSource, PointTarget, Scalar> > clone() const {
-		Ptr copy(
-				new CorrespondenceEstimation<PointSource, PointTarget, Scalar>(
-						*this));
-		return (copy);
+	/** \brief Forward queries of the reciprocal search on the GPU, the queries stay on the device for the reverse ones. */
+	void forwardDevice(float max_dist_sqr) {
+		uploadTarget();
+		uploadQueries();
+		Types::Cuda::nearestK(*device_queries_, *device_target_, 1, deviceRadius(max_dist_sqr), device_indices_, device_distances_);
+		for (size_t i = 0; i < forward_match_.size(); ++i) {
+			const bool found = device_indices_[i] >= 0 && device_distances_[i] <= max_dist_sqr;
+			forward_match_[i] = found ? targetIndex(device_indices_[i]) : -1;
+			forward_distance_[i] = device_distances_[i];
+		}
+	}
+
+	/** \brief Reverse queries of matched targets on the GPU, among the source points of indices. */
+	void reverseDevice(float max_dist_sqr) {
+		if (reverse_targets_.empty())
+			return;
+		PointCloudTargetPtr queries(new PointCloudTarget);
+		queries->points.resize(reverse_targets_.size());
+		for (size_t j = 0; j < reverse_targets_.size(); ++j)
+			queries->points[j] = target_->points[reverse_targets_[j]];
+		queries->width = queries->points.size();
+		queries->height = 1;
+		Types::Cuda::nearestK(*Types::DeviceCloud<PointTarget>::upload(queries), *device_queries_, 1, deviceRadius(max_dist_sqr),
+				device_indices_, device_distances_);
+		for (size_t j = 0; j < reverse_targets_.size(); ++j) {
+			const bool found = device_indices_[j] >= 0 && device_distances_[j] <= max_dist_sqr;
+			reverse_match_[reverse_targets_[j]] = found ? (*indices_)[device_indices_[j]] : -1;
+		}
+	}
+
+	/** \brief Writes point coordinates in the joint space. */
+	template<typename PointT>
+	void jointPoint(const PointT & p, float * out) const {
+		out[0] = p.x;
+		out[1] = p.y;
+		out[2] = p.z;
+		out[3] = color_weight_ * p.r;
+		out[4] = color_weight_ * p.g;
+		out[5] = color_weight_ * p.b;
 	}
+
+	/** \brief Builds XYZRGB index over the target, unless it was built since the target was set. */
+	void buildJointIndex() {
+		if (!joint_stale_)
+			return;
+		joint_stale_ = false;
+
+		const bool subset = target_indices_ && !target_indices_->empty();
+		const size_t count = subset ? target_indices_->size() : target_->points.size();
+		joint_map_.clear();
+		joint_map_.reserve(count);
+		joint_data_.resize(6 * count);
+		for (size_t i = 0; i < count; ++i) {
+			const int idx = subset ? (*target_indices_)[i] : (int) i;
+			if (!finite(target_->points[idx]))
+				continue;
+			jointPoint(target_->points[idx], &joint_data_[6 * joint_map_.size()]);
+			joint_map_.push_back(idx);
+		}
+
+		joint_index_.reset();
+		if (joint_map_.empty())
+			return;
+
+		flann::Matrix<float> points(&joint_data_[0], joint_map_.size(), 6);
+		if (checks_ > 0)
+			joint_index_.reset(new JointIndex(points, flann::KDTreeIndexParams(trees_)));
+		else
+			joint_index_.reset(new JointIndex(points, flann::KDTreeSingleIndexParams(15)));
+		joint_index_->buildIndex();
+	}
+
+	/** \brief Single nearest neighbour in the joint space, queried in blocks. */
+	void searchJoint(pcl::Correspondences & correspondences, float max_dist_sqr, int threads) {
+		if (!joint_index_)
+			return;
+
+		thread_queries_.resize(threads);
+		prepareBuffers(threads, BLOCK);
+		Types::ThreadPool::parallelFor(0, indices_->size(), BLOCK, boost::bind(&CorrespondenceEstimationColor::searchJointBlock,
+				this, _1, _2, _3, boost::ref(correspondences), max_dist_sqr), threads);
+	}
+
+	/** \brief Queries [first, end) of one block, at most BLOCK. */
+	void searchJointBlock(int first, int end, int slot, pcl::Correspondences & correspondences, float max_dist_sqr) {
+		// -1 stands for unlimited number of checks, i.e. exact search.
+		const flann::SearchParams params(checks_ > 0 ? checks_ : -1, epsilon_);
+		const int rows = end - first;
+		std::vector<float> & queries = thread_queries_[slot];
+		std::vector<int> & index = thread_indices_[slot];
+		std::vector<float> & distance = thread_distances_[slot];
+		queries.resize(6 * rows);
+		index.resize(rows);
+		distance.resize(rows);
+
+		// Non-finite queries are replaced by a finite point and dropped afterwards.
+		for (int r = 0; r < rows; ++r) {
+			const PointSource & p = input_->points[(*indices_)[first + r]];
+			if (finite(p))
+				jointPoint(p, &queries[6 * r]);
+			else
+				std::fill(&queries[6 * r], &queries[6 * r] + 6, 0.0f);
+		}
+
+		flann::Matrix<float> q(&queries[0], rows, 6);
+		flann::Matrix<int> ind(&index[0], rows, 1);
+		flann::Matrix<float> dist(&distance[0], rows, 1);
+		joint_index_->knnSearch(q, ind, dist, 1, params);
+
+		for (int r = 0; r < rows; ++r) {
+			const int i = first + r;
+			const int query = (*indices_)[i];
+			const PointSource & p = input_->points[query];
+			if (!finite(p) || ind[r][0] < 0)
+				continue;
+
+			const int match = joint_map_[ind[r][0]];
+			const float d = squaredDistance(p, target_->points[match]);
+			if (d > max_dist_sqr)
+				continue;
+
+			correspondences[i].index_query = query;
+			correspondences[i].index_match = match;
+			correspondences[i].distance = d;
+			valid_[i] = 1;
+		}
+	}
+
+	/** \brief Number of geometric neighbours compared by color. */
+	int k_;
+
+	/** \brief Number of search threads, 0 - all threads of the pool. */
+	int threads_;
+
+	/** \brief Error bound of the approximate search. */
+	float epsilon_;
+
+	/** \brief True if the joint XYZRGB index is used. */
+	bool joint_;
+
+	/** \brief Scale of color coordinates in the joint space. */
+	float color_weight_;
+
+	/** \brief Leaves checked by the approximate joint search, 0 - exact. */
+	int checks_;
+
+	/** \brief Randomized trees of the approximate joint index. */
+	int trees_;
+
+	/** \brief Joint index with its data, stale when a target was set after it was built. */
+	boost::shared_ptr<JointIndex> joint_index_;
+	std::vector<float> joint_data_;
+	std::vector<int> joint_map_;
+	bool joint_stale_;
+
+	/** \brief True if neighbours are searched on the GPU. */
+	bool device_;
+
+	/** \brief Target on the device (empty when stale), indices of its points in the target. */
+	typename Types::DeviceCloud<PointTarget>::Ptr device_target_;
+	std::vector<int> device_map_;
+
+	/** \brief Queries of the last search on the device, and its results. */
+	typename Types::DeviceCloud<PointSource>::Ptr device_queries_;
+	std::vector<int> device_indices_;
+	std::vector<float> device_distances_;
+
+	/** \brief Work buffers, kept between calls. */
+	std::vector<char> valid_;
+	std::vector<std::vector<int> > thread_indices_;
+	std::vector<std::vector<float> > thread_distances_;
+	std::vector<std::vector<float> > thread_queries_;
+	std::vector<pcl::Correspondences> chunks_;
+
+	/** \brief Forward matches and the reverse query cache of the reciprocal search. */
+	std::vector<int> forward_match_;
+	std::vector<float> forward_distance_;
+	std::vector<int> reverse_match_;
+	std::vector<int> reverse_targets_;
 };
 }
 }
@@ -0,0 +1,820 @@
+/*!
+ * \file
+ * \brief Templated back-projection of depth images to point clouds.
+ * \author Maciej Stefańczyk [maciek.slon@gmail.com]
+ */
+
+#ifndef DEPTHBACKPROJECTION_HPP_
+#define DEPTHBACKPROJECTION_HPP_
+
+#include <limits>
+#include <climits>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+#include "Types/ThreadPool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DEPTH_BACKPROJECTION_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DEPTH_BACKPROJECTION_NEON
+#endif
+
+namespace Types {
+namespace DepthBackProjection {
+
+/*!
+ * Pinhole camera parameters used for back-projection.
+ * depth_scale converts raw depth units to meters (0.001 for millimeter maps).
+ */
+struct Intrinsics {
+	Intrinsics(float fx_ = 1, float fy_ = 1, float cx_ = 0, float cy_ = 0, float depth_scale_ = 0.001f) :
+		fx(fx_), fy(fy_), cx(cx_), cy(cy_), depth_scale(depth_scale_) {}
+
+	float fx, fy, cx, cy;
+	float depth_scale;
+};
+
+/*!
+ * \class RayTable
+ * \brief Per-pixel unit rays (x/z and y/z factors) of the depth camera.
+ *
+ * Back-projection of pixel (u, v) with depth d is then (rx * z, ry * z, z),
+ * where z = d * depth_scale. Without distortion the table is separable and
+ * keeps only one factor per column and per row, otherwise undistortion is
+ * baked into a full per-pixel table.
+ */
+class RayTable {
+public:
+	RayTable() : width_(0), height_(0), separable_(true), generation_(0) {}
+
+	/*!
+	 * Rebuilds the table if intrinsics, distortion or resolution changed.
+	 * \param dist distortion coefficients, empty for none
+	 * \returns true when the table was rebuilt
+	 */
+	bool update(const Intrinsics & K, int width, int height, const cv::Mat & dist = cv::Mat()) {
+		std::vector<double> d;
+		for (int i = 0; i < (int) dist.total(); ++i)
+			d.push_back(dist.depth() == CV_32F ? dist.ptr<float>()[i] : dist.ptr<double>()[i]);
+		bool distorted = false;
+		for (size_t i = 0; i < d.size(); ++i)
+			distorted |= (d[i] != 0);
+		if (!distorted)
+			d.clear();
+
+		if (width == width_ && height == height_ && K.fx == K_.fx && K.fy == K_.fy && K.cx == K_.cx && K.cy == K_.cy && d == dist_) {
+			K_.depth_scale = K.depth_scale;
+			return false;
+		}
+
+		K_ = K;
+		width_ = width;
+		height_ = height;
+		dist_ = d;
+		separable_ = !distorted;
+		++generation_;
+
+		if (separable_) {
+			rx_.resize(width);
+			ry_.resize(height);
+			for (int u = 0; u < width; ++u)
+				rx_[u] = (u - K.cx) / K.fx;
+			for (int v = 0; v < height; ++v)
+				ry_[v] = (v - K.cy) / K.fy;
+		} else {
+			cv::Mat pixels(width * height, 1, CV_32FC2), rays;
+			for (int v = 0; v < height; ++v) {
+				for (int u = 0; u < width; ++u) {
+					pixels.at<cv::Vec2f>(v * width + u) = cv::Vec2f(u, v);
+				}
+			}
+			cv::Mat camera_matrix = (cv::Mat_<double>(3, 3) << K.fx, 0, K.cx, 0, K.fy, K.cy, 0, 0, 1);
+			cv::undistortPoints(pixels, rays, camera_matrix, cv::Mat(dist_));
+
+			rx_.resize(width * height);
+			ry_.resize(width * height);
+			for (int i = 0; i < width * height; ++i) {
+				cv::Vec2f r = rays.at<cv::Vec2f>(i);
+				rx_[i] = r[0];
+				ry_[i] = r[1];
+			}
+		}
+		return true;
+	}
+
+	/// X factors for the given row.
+	const float * rx(int v) const {
+		return separable_ ? &rx_[0] : &rx_[v * width_];
+	}
+
+	/// Y factors for the given row (single value if the table is separable).
+	const float * ry(int v) const {
+		return separable_ ? &ry_[v] : &ry_[v * width_];
+	}
+
+	/*!
+	 * Ray factors at sub-pixel position (u, v) of the image (pixel centers at
+	 * integer coordinates), interpolated bilinearly and clamped to the image.
+	 */
+	void ray(float u, float v, float & rx, float & ry) const {
+		const float uc = std::min(std::max(u, 0.0f), (float) (width_ - 1));
+		const float vc = std::min(std::max(v, 0.0f), (float) (height_ - 1));
+		const int u0 = std::max(0, std::min((int) uc, width_ - 2)), v0 = std::max(0, std::min((int) vc, height_ - 2));
+		const int u1 = std::min(u0 + 1, width_ - 1), v1 = std::min(v0 + 1, height_ - 1);
+		const float a = uc - u0, b = vc - v0;
+		if (separable_) {
+			rx = rx_[u0] + a * (rx_[u1] - rx_[u0]);
+			ry = ry_[v0] + b * (ry_[v1] - ry_[v0]);
+		} else {
+			const int i00 = v0 * width_ + u0, i01 = v0 * width_ + u1, i10 = v1 * width_ + u0, i11 = v1 * width_ + u1;
+			rx = (1 - b) * (rx_[i00] + a * (rx_[i01] - rx_[i00])) + b * (rx_[i10] + a * (rx_[i11] - rx_[i10]));
+			ry = (1 - b) * (ry_[i00] + a * (ry_[i01] - ry_[i00])) + b * (ry_[i10] + a * (ry_[i11] - ry_[i10]));
+		}
+	}
+
+	/*!
+	 * Bounding rectangle [u0, u1) x [v0, v1) of pixels with ray factors
+	 * within the given ranges, empty (u0 >= u1) if there is none.
+	 */
+	void bounds(float rx_min, float rx_max, float ry_min, float ry_max, int & u0, int & u1, int & v0, int & v1) const {
+		u0 = v0 = INT_MAX;
+		u1 = v1 = 0;
+		if (separable_) {
+			for (int u = 0; u < width_; ++u)
+				if (rx_[u] >= rx_min && rx_[u] <= rx_max) {
+					u0 = std::min(u0, u);
+					u1 = u + 1;
+				}
+			for (int v = 0; v < height_; ++v)
+				if (ry_[v] >= ry_min && ry_[v] <= ry_max) {
+					v0 = std::min(v0, v);
+					v1 = v + 1;
+				}
+		} else {
+			for (int v = 0; v < height_; ++v)
+				for (int u = 0, i = v * width_; u < width_; ++u, ++i)
+					if (rx_[i] >= rx_min && rx_[i] <= rx_max && ry_[i] >= ry_min && ry_[i] <= ry_max) {
+						u0 = std::min(u0, u);
+						u1 = std::max(u1, u + 1);
+						v0 = std::min(v0, v);
+						v1 = v + 1;
+					}
+		}
+		if (u0 >= u1 || v0 >= v1)
+			u0 = u1 = v0 = v1 = 0;
+	}
+
+	bool separable() const { return separable_; }
+	int width() const { return width_; }
+	int height() const { return height_; }
+	float depthScale() const { return K_.depth_scale; }
+
+	/// Incremented with every rebuild of the table.
+	int generation() const { return generation_; }
+
+private:
+	Intrinsics K_;
+	int width_, height_;
+	std::vector<double> dist_;
+	bool separable_;
+	int generation_;
+	std::vector<float> rx_, ry_;
+};
+
+/*!
+ * \class MaskRuns
+ * \brief Run-length representation of a binary mask.
+ *
+ * Every row keeps a list of [begin, end) runs of non-zero pixels, so that
+ * masked conversion touches only foreground and skips empty rows at once.
+ */
+class MaskRuns {
+public:
+	struct Run {
+		int begin, end;
+	};
+
+	MaskRuns() : width_(0), height_(0), count_(0) {}
+
+	/// Builds runs from a single-channel mask, 8-bit masks are read directly.
+	void build(const cv::Mat & mask) {
+		cv::Mat mask8 = mask;
+		if (mask.depth() != CV_8U)
+			cv::compare(mask, 0, mask8, cv::CMP_NE);
+
+		width_ = mask8.cols;
+		height_ = mask8.rows;
+		count_ = 0;
+		runs_.clear();
+		row_start_.resize(height_ + 1);
+
+		for (int v = 0; v < height_; ++v) {
+			row_start_[v] = runs_.size();
+			const uchar * m = mask8.ptr<uchar>(v);
+			int u = 0;
+			while (u < width_) {
+				u = skip(m, u, width_, false);
+				if (u == width_)
+					break;
+				Run r;
+				r.begin = u;
+				r.end = u = skip(m, u, width_, true);
+				count_ += r.end - r.begin;
+				runs_.push_back(r);
+			}
+		}
+		row_start_[height_] = runs_.size();
+	}
+
+	/// First run of the row.
+	const Run * begin(int v) const { return runs_.empty() ? NULL : &runs_[0] + row_start_[v]; }
+
+	/// One past the last run of the row.
+	const Run * end(int v) const { return runs_.empty() ? NULL : &runs_[0] + row_start_[v + 1]; }
+
+	bool emptyRow(int v) const { return row_start_[v] == row_start_[v + 1]; }
+
+	/// Number of foreground pixels.
+	size_t count() const { return count_; }
+
+	/// Number of foreground pixels of rows [v0, v1).
+	size_t count(int v0, int v1) const {
+		size_t n = 0;
+		for (const Run * r = begin(v0), * e = end(v1 - 1); r != e; ++r)
+			n += r->end - r->begin;
+		return n;
+	}
+
+	int width() const { return width_; }
+	int height() const { return height_; }
+
+private:
+	/// Returns first position from u on at which (m[u] != 0) differs from set.
+	static int skip(const uchar * m, int u, int width, bool set) {
+#if defined(DEPTH_BACKPROJECTION_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const int all = set ? 0 : 0xFFFF;
+		while (u + 16 <= width && _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(m + u)), zero)) == all)
+			u += 16;
+#endif
+		while (u < width && (m[u] != 0) == set)
+			++u;
+		return u;
+	}
+
+	int width_, height_;
+	size_t count_;
+	std::vector<Run> runs_;
+	std::vector<size_t> row_start_;
+};
+
+/// Pixels of XYZ images with |z| above this value (or equal to it) are treated as missing.
+const float XYZ_MAX_Z = 1.0e4f;
+
+/// Pixels of a tile of rows converted by one task of the thread pool.
+const int TILE_PIXELS = 16384;
+
+/*!
+ * \class Roi
+ * \brief Pixels and raw depths that may hold points of a 3D box.
+ *
+ * The box (in camera frame, meters) is projected through the ray table
+ * into a rectangle of the image and a range of raw depth values. Pixels
+ * outside of the rectangle are not visited, depths out of the range are
+ * rejected as integers, before any float math. The test is conservative
+ * (the corners of the rectangle may lie outside of the box), so an exact
+ * crop (PassThrough) still follows. XYZ images have no rays, their points
+ * are tested against the box itself.
+ */
+class Roi {
+public:
+	Roi() : u0(0), u1(INT_MAX), v0(0), v1(INT_MAX), dmin(1), dmax(USHRT_MAX), generation_(-1), scale_(0) {
+		for (int a = 0; a < 3; ++a) {
+			min_[a] = -FLT_MAX;
+			max_[a] = FLT_MAX;
+		}
+	}
+
+	/// Sets the box, unbounded axes have limits -FLT_MAX, FLT_MAX.
+	void setBox(const float min[3], const float max[3]) {
+		for (int a = 0; a < 3; ++a) {
+			if (min[a] != min_[a] || max[a] != max_[a])
+				generation_ = -1;
+			min_[a] = min[a];
+			max_[a] = max[a];
+		}
+	}
+
+	/*!
+	 * Projects the box with the table, only when the box, the table or its
+	 * depth scale changed. The scale is not part of the table generation
+	 * (rays do not depend on it), but the range of raw depths does.
+	 */
+	void project(const RayTable & rays) {
+		const float scale = rays.depthScale();
+		if (generation_ == rays.generation() && scale_ == scale)
+			return;
+		generation_ = rays.generation();
+		scale_ = scale;
+
+		// Depths in the box, nearest one at least one raw unit.
+		const float z0 = std::max(min_[2], scale), z1 = max_[2];
+		dmin = (uint16_t) std::max(1.0f, std::min<float>(USHRT_MAX, std::floor(z0 / scale)));
+		dmax = (uint16_t) std::max(0.0f, std::min<float>(USHRT_MAX, std::ceil(z1 / scale)));
+		if (z1 < z0) {
+			u0 = u1 = v0 = v1 = 0;
+			return;
+		}
+
+		// Ray factors x / z and y / z of points in the box, extreme at its corners.
+		const float rx_min = min_[0] >= 0 ? min_[0] / z1 : min_[0] / z0;
+		const float rx_max = max_[0] >= 0 ? max_[0] / z0 : max_[0] / z1;
+		const float ry_min = min_[1] >= 0 ? min_[1] / z1 : min_[1] / z0;
+		const float ry_max = max_[1] >= 0 ? max_[1] / z0 : max_[1] / z1;
+		rays.bounds(rx_min, rx_max, ry_min, ry_max, u0, u1, v0, v1);
+	}
+
+	/// True if the point lies in the box.
+	template <typename PointT>
+	bool contains(const PointT & p) const {
+		return p.x >= min_[0] && p.x <= max_[0] && p.y >= min_[1] && p.y <= max_[1] && p.z >= min_[2] && p.z <= max_[2];
+	}
+
+	/// Rectangle [u0, u1) x [v0, v1) of the image.
+	int u0, u1, v0, v1;
+
+	/// Range [dmin, dmax] of raw depths.
+	uint16_t dmin, dmax;
+
+private:
+	float min_[3], max_[3];
+
+	/// Generation of the ray table the box was projected with, -1 if not yet (or the box changed since).
+	int generation_;
+
+	/// Depth scale the range of raw depths was computed with.
+	float scale_;
+};
+
+namespace detail {
+
+/// Sets XYZ of the point to NaN.
+template <typename PointT>
+inline void setBad(PointT & pt) {
+	pt.x = pt.y = pt.z = std::numeric_limits<float>::quiet_NaN();
+}
+
+/// Copies BGR pixel into the color fields of the point.
+inline void setColor(pcl::PointXYZRGB & pt, const uchar * bgr) {
+	pt.b = bgr[0];
+	pt.g = bgr[1];
+	pt.r = bgr[2];
+}
+
+/// Point types without color channels silently ignore it.
+template <typename PointT>
+inline void setColor(PointT &, const uchar *) {}
+
+/*!
+ * Writes XYZ of one row of a depth image into consecutive points,
+ * using precomputed ray factors. Pixels with depth out of [dmin, dmax]
+ * (zero depth always, dmin is at least 1) become NaN.
+ * When PerPixelY is false ry points to a single factor shared by the row.
+ */
+template <bool PerPixelY, typename PointT>
+inline void depthRow(const uint16_t * depth, int width, const float * rx, const float * ry, float scale, PointT * out,
+		uint16_t dmin = 1, uint16_t dmax = USHRT_MAX) {
+	int u = 0;
+
+#if defined(DEPTH_BACKPROJECTION_SSE2)
+	const __m128 vscale = _mm_set1_ps(scale);
+	const __m128 vry = _mm_set1_ps(ry[0]);
+	const __m128 vnan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+	const __m128 vone = _mm_set1_ps(1.0f);
+	const __m128i vzero = _mm_setzero_si128();
+	const __m128i vmin = _mm_set1_epi32(dmin), vmax = _mm_set1_epi32(dmax);
+
+	for (; u + 4 <= width; u += 4) {
+		// Widen four 16-bit depths, test their range as integers, then convert to floats.
+		__m128i d16 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(depth + u));
+		__m128i d32 = _mm_unpacklo_epi16(d16, vzero);
+		__m128 bad = _mm_castsi128_ps(_mm_or_si128(_mm_cmplt_epi32(d32, vmin), _mm_cmpgt_epi32(d32, vmax)));
+		__m128 d = _mm_cvtepi32_ps(d32);
+
+		__m128 z = _mm_mul_ps(d, vscale);
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(rx + u), z);
+		__m128 y = _mm_mul_ps(PerPixelY ? _mm_loadu_ps(ry + u) : vry, z);
+
+		// Branch-free NaN for missing depth.
+		x = _mm_or_ps(_mm_and_ps(bad, vnan), _mm_andnot_ps(bad, x));
+		y = _mm_or_ps(_mm_and_ps(bad, vnan), _mm_andnot_ps(bad, y));
+		z = _mm_or_ps(_mm_and_ps(bad, vnan), _mm_andnot_ps(bad, z));
+		__m128 w = vone;
+
+		// SoA -> AoS, each register holds (x, y, z, 1) of one point.
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_store_ps(out[u + 0].data, x);
+		_mm_store_ps(out[u + 1].data, y);
+		_mm_store_ps(out[u + 2].data, z);
+		_mm_store_ps(out[u + 3].data, w);
+	}
+#elif defined(DEPTH_BACKPROJECTION_NEON)
+	const float32x4_t vscale = vdupq_n_f32(scale);
+	const float32x4_t vry = vdupq_n_f32(ry[0]);
+	const float32x4_t vnan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+	const float32x4_t vone = vdupq_n_f32(1.0f);
+	const uint32x4_t vmin = vdupq_n_u32(dmin), vmax = vdupq_n_u32(dmax);
+
+	for (; u + 4 <= width; u += 4) {
+		uint32x4_t d32 = vmovl_u16(vld1_u16(depth + u));
+		uint32x4_t bad = vorrq_u32(vcltq_u32(d32, vmin), vcgtq_u32(d32, vmax));
+		float32x4_t d = vcvtq_f32_u32(d32);
+
+		float32x4_t z = vmulq_f32(d, vscale);
+		float32x4_t x = vmulq_f32(vld1q_f32(rx + u), z);
+		float32x4_t y = vmulq_f32(PerPixelY ? vld1q_f32(ry + u) : vry, z);
+
+		x = vbslq_f32(bad, vnan, x);
+		y = vbslq_f32(bad, vnan, y);
+		z = vbslq_f32(bad, vnan, z);
+
+		float32x4x2_t xy = vzipq_f32(x, y);
+		float32x4x2_t zw = vzipq_f32(z, vone);
+		vst1q_f32(out[u + 0].data, vcombine_f32(vget_low_f32(xy.val[0]), vget_low_f32(zw.val[0])));
+		vst1q_f32(out[u + 1].data, vcombine_f32(vget_high_f32(xy.val[0]), vget_high_f32(zw.val[0])));
+		vst1q_f32(out[u + 2].data, vcombine_f32(vget_low_f32(xy.val[1]), vget_low_f32(zw.val[1])));
+		vst1q_f32(out[u + 3].data, vcombine_f32(vget_high_f32(xy.val[1]), vget_high_f32(zw.val[1])));
+	}
+#endif
+
+	// Scalar tail (and whole row on targets without SIMD).
+	for (; u < width; ++u) {
+		PointT & pt = out[u];
+		if (depth[u] < dmin || depth[u] > dmax) {
+			setBad(pt);
+			continue;
+		}
+		const float z = depth[u] * scale;
+		pt.x = rx[u] * z;
+		pt.y = (PerPixelY ? ry[u] : ry[0]) * z;
+		pt.z = z;
+	}
+}
+
+/*!
+ * Writes XYZ of one row of a CV_32FC3 image into consecutive points.
+ * Pixels with z close to or beyond XYZ_MAX_Z (or outside of the box of
+ * the ROI, if any) become NaN.
+ */
+template <typename PointT>
+inline void xyzRow(const float * xyz, int width, PointT * out, const Roi * roi = NULL) {
+	for (int u = 0; u < width; ++u, xyz += 3) {
+		PointT & pt = out[u];
+		const float z = xyz[2];
+		if (std::fabs(z - XYZ_MAX_Z) < FLT_EPSILON || std::fabs(z) > XYZ_MAX_Z) {
+			setBad(pt);
+			continue;
+		}
+		pt.x = xyz[0];
+		pt.y = xyz[1];
+		pt.z = z;
+		if (roi && !roi->contains(pt))
+			setBad(pt);
+	}
+}
+
+/// Source reading 16-bit depth map, rays taken from the table.
+struct DepthSource {
+	DepthSource(const cv::Mat & depth_, const RayTable & rays_, const Roi * roi) :
+		depth(depth_), rays(rays_), dmin(roi ? roi->dmin : 1), dmax(roi ? roi->dmax : USHRT_MAX) {}
+
+	/// Converts pixels [u0, u1) of row v, out points to the first point of the row.
+	template <typename PointT>
+	void span(int v, int u0, int u1, PointT * out) const {
+		if (rays.separable())
+			depthRow<false>(depth.ptr<uint16_t>(v) + u0, u1 - u0, rays.rx(v) + u0, rays.ry(v), rays.depthScale(), out + u0, dmin, dmax);
+		else
+			depthRow<true>(depth.ptr<uint16_t>(v) + u0, u1 - u0, rays.rx(v) + u0, rays.ry(v) + u0, rays.depthScale(), out + u0, dmin, dmax);
+	}
+
+	/// Upper bound of valid points of rows [v0, v1) and columns [u0, u1).
+	size_t bound(int v0, int v1, int u0, int u1) const {
+		return cv::countNonZero(depth(cv::Range(v0, v1), cv::Range(u0, u1)));
+	}
+
+	const cv::Mat & depth;
+	const RayTable & rays;
+	uint16_t dmin, dmax;
+};
+
+/// Source reading image with XYZ coordinates.
+struct XYZSource {
+	XYZSource(const cv::Mat & xyz_, const Roi * roi_) : xyz(xyz_), roi(roi_) {}
+
+	/// Converts pixels [u0, u1) of row v, out points to the first point of the row.
+	template <typename PointT>
+	void span(int v, int u0, int u1, PointT * out) const {
+		xyzRow(xyz.ptr<float>(v) + 3 * u0, u1 - u0, out + u0, roi);
+	}
+
+	/// Upper bound of valid points of rows [v0, v1) and columns [u0, u1).
+	size_t bound(int v0, int v1, int u0, int u1) const {
+		return (size_t) (v1 - v0) * (u1 - u0);
+	}
+
+	const cv::Mat & xyz;
+	const Roi * roi;
+};
+
+/// Converts span of the row and copies color when requested at compile time.
+template <bool HasColor, typename Source, typename PointT>
+inline void fillSpan(const Source & src, int v, int u0, int u1, const cv::Mat & color, PointT * out) {
+	src.span(v, u0, u1, out);
+
+	if (HasColor) {
+		const uchar * c = color.ptr<uchar>(v) + 3 * u0;
+		for (int u = u0; u < u1; ++u, c += 3)
+			setColor(out[u], c);
+	}
+}
+
+/// Runs of the row, whole row when there is no mask.
+inline void rowRuns(const MaskRuns * mask, int v, int width, MaskRuns::Run & full, const MaskRuns::Run * & rb, const MaskRuns::Run * & re) {
+	if (mask) {
+		rb = mask->begin(v);
+		re = mask->end(v);
+	} else {
+		full.begin = 0;
+		full.end = width;
+		rb = &full;
+		re = &full + 1;
+	}
+}
+
+/// Rectangle [u0, u1) x [v0, v1) of pixels visited by the engines, the whole image without ROI.
+struct Rect {
+	Rect(int width, int height, const Roi * roi) :
+		u0(roi ? std::min(roi->u0, width) : 0), u1(roi ? std::min(roi->u1, width) : width),
+		v0(roi ? std::min(roi->v0, height) : 0), v1(roi ? std::min(roi->v1, height) : height) {
+	}
+
+	/// Clips the run to the columns, returns false if nothing is left.
+	bool clip(const MaskRuns::Run & run, int & begin, int & end) const {
+		begin = std::max(run.begin, u0);
+		end = std::min(run.end, u1);
+		return begin < end;
+	}
+
+	int u0, u1, v0, v1;
+};
+
+/// Rows of a tile of the image.
+inline int tileRows(int width) {
+	return std::max(1, TILE_PIXELS / std::max(width, 1));
+}
+
+/// Body of the parallel loop of backProject(), converts rows [begin, end).
+template <bool HasColor, typename Source, typename PointT>
+struct OrganizedBody {
+	OrganizedBody(const Source & src, int width, const Rect & rect, const MaskRuns * mask, const cv::Mat & color, PointT * points) :
+		src(src), width(width), rect(rect), mask(mask), color(color), points(points) {
+	}
+	void operator()(int begin, int end, int) const {
+		MaskRuns::Run full;
+		const MaskRuns::Run * rb, * re;
+		for (int v = begin; v < end; ++v) {
+			PointT * out = points + (size_t) v * width;
+			int u = 0;
+			if (v >= rect.v0 && v < rect.v1) {
+				rowRuns(mask, v, width, full, rb, re);
+				for (const MaskRuns::Run * r = rb; r != re; ++r) {
+					int b, e;
+					if (!rect.clip(*r, b, e))
+						continue;
+					for (; u < b; ++u)
+						setBad(out[u]);
+					fillSpan<HasColor>(src, v, b, e, color, out);
+					u = e;
+				}
+			}
+			for (; u < width; ++u)
+				setBad(out[u]);
+		}
+	}
+	const Source & src;
+	int width;
+	Rect rect;
+	const MaskRuns * mask;
+	const cv::Mat & color;
+	PointT * points;
+};
+
+/*!
+ * Common engine: fills organized cloud, tiles of rows in parallel (each row
+ * writes its own part of the cloud). Pixels outside of the mask or of the
+ * rectangle are NaN.
+ */
+template <bool HasColor, typename Source, typename PointT>
+void backProject(const Source & src, int width, int height, const Rect & rect, const MaskRuns * mask, const cv::Mat & color,
+		pcl::PointCloud<PointT> & cloud) {
+	cloud.points.resize(width * height);
+	cloud.width = width;
+	cloud.height = height;
+	cloud.is_dense = false;
+	if (cloud.points.empty())
+		return;
+
+	ThreadPool::parallelFor(0, height, tileRows(width), OrganizedBody<HasColor, Source, PointT>(src, width, rect, mask, color, &cloud.points[0]));
+}
+
+/// Body of the parallel loop counting upper bounds of valid points of tiles.
+template <typename Source>
+struct BoundBody {
+	BoundBody(const Source & src, const Rect & rect, int rows, const MaskRuns * mask, std::vector<size_t> & bounds) :
+		src(src), rect(rect), rows(rows), mask(mask), bounds(bounds) {
+	}
+	void operator()(int begin, int end, int) const {
+		for (int t = begin; t < end; ++t) {
+			const int v0 = rect.v0 + t * rows, v1 = std::min(rect.v1, v0 + rows);
+			bounds[t] = mask ? mask->count(v0, v1) : src.bound(v0, v1, rect.u0, rect.u1);
+		}
+	}
+	const Source & src;
+	Rect rect;
+	int rows;
+	const MaskRuns * mask;
+	std::vector<size_t> & bounds;
+};
+
+/*!
+ * Body of the parallel loop of backProjectCompact(). Every tile of rows
+ * writes valid points into its own slice of the output (starting at
+ * offsets[t]), each row converted into a scratch buffer of the slot first.
+ * Writes are branch-free, the output index advances only for valid points,
+ * rows without foreground are skipped entirely.
+ */
+template <bool HasColor, typename Source, typename PointT>
+struct CompactBody {
+	typedef typename pcl::PointCloud<PointT>::VectorType Row;
+
+	CompactBody(const Source & src, int width, const Rect & rect, int rows, const MaskRuns * mask, const cv::Mat & color,
+			const std::vector<size_t> & offsets, PointT * points, int * indices, std::vector<Row> & scratch, std::vector<size_t> & valid) :
+		src(src), width(width), rect(rect), rows(rows), mask(mask), color(color), offsets(offsets),
+		points(points), indices(indices), scratch(scratch), valid(valid) {
+	}
+	void operator()(int begin, int end, int slot) const {
+		Row & row = scratch[slot];
+		row.resize(width);
+		for (int t = begin; t < end; ++t) {
+			PointT * out = points + offsets[t];
+			int * idx = indices ? indices + offsets[t] : NULL;
+			size_t n = 0;
+
+			MaskRuns::Run full;
+			const MaskRuns::Run * rb, * re;
+			for (int v = rect.v0 + t * rows; v < std::min(rect.v1, rect.v0 + (t + 1) * rows); ++v) {
+				rowRuns(mask, v, width, full, rb, re);
+
+				for (const MaskRuns::Run * r = rb; r != re; ++r) {
+					int b, e;
+					if (!rect.clip(*r, b, e))
+						continue;
+					fillSpan<HasColor>(src, v, b, e, color, &row[0]);
+
+					if (idx) {
+						for (int u = b; u < e; ++u) {
+							out[n] = row[u];
+							idx[n] = v * width + u;
+							n += (row[u].z == row[u].z);
+						}
+					} else {
+						for (int u = b; u < e; ++u) {
+							out[n] = row[u];
+							n += (row[u].z == row[u].z);
+						}
+					}
+				}
+			}
+			valid[t] = n;
+		}
+	}
+	const Source & src;
+	int width;
+	Rect rect;
+	int rows;
+	const MaskRuns * mask;
+	const cv::Mat & color;
+	const std::vector<size_t> & offsets;
+	PointT * points;
+	int * indices;
+	std::vector<Row> & scratch;
+	std::vector<size_t> & valid;
+};
+
+/*!
+ * Compacting engine: tiles of rows of the rectangle are converted in parallel, each one into
+ * a slice of the output sized by the upper bound of its valid points (plus
+ * one spare element for the branch-free write past its last valid point).
+ * Slices are then stitched together in order by prefix sum of their valid
+ * counts, moving points only when some tile had invalid ones.
+ * \param pixel_indices if not NULL, filled with image index (v * width + u) of every point
+ */
+template <bool HasColor, typename Source, typename PointT>
+void backProjectCompact(const Source & src, int width, const Rect & rect, const MaskRuns * mask, const cv::Mat & color,
+		pcl::PointCloud<PointT> & cloud, std::vector<int> * pixel_indices) {
+	const int rows = tileRows(rect.u1 - rect.u0);
+	const int tiles = ThreadPool::chunks(rect.v0, rect.v1, rows);
+
+	std::vector<size_t> offsets(tiles + 1, 0), valid(tiles, 0);
+	ThreadPool::parallelFor(0, tiles, 1, BoundBody<Source>(src, rect, rows, mask, offsets));
+	size_t total = 0;
+	for (int t = 0; t <= tiles; ++t) {
+		const size_t bound = t < tiles ? offsets[t] : 0;
+		offsets[t] = total;
+		total += bound + 1;
+	}
+
+	cloud.points.resize(offsets[tiles]);
+	if (pixel_indices)
+		pixel_indices->resize(offsets[tiles]);
+	PointT * out = cloud.points.empty() ? NULL : &cloud.points[0];
+	int * idx = pixel_indices && !pixel_indices->empty() ? &(*pixel_indices)[0] : NULL;
+
+	std::vector<typename CompactBody<HasColor, Source, PointT>::Row> scratch(ThreadPool::instance().threads());
+	ThreadPool::parallelFor(0, tiles, 1, CompactBody<HasColor, Source, PointT>(src, width, rect, rows, mask, color,
+			offsets, out, idx, scratch, valid));
+
+	// Stitch slices, every one moves towards the beginning, so in order.
+	size_t n = 0;
+	for (int t = 0; t < tiles; ++t) {
+		if (n != offsets[t]) {
+			std::copy(out + offsets[t], out + offsets[t] + valid[t], out + n);
+			if (idx)
+				std::copy(idx + offsets[t], idx + offsets[t] + valid[t], idx + n);
+		}
+		n += valid[t];
+	}
+
+	cloud.points.resize(n);
+	cloud.width = n;
+	cloud.height = 1;
+	cloud.is_dense = true;
+	if (pixel_indices)
+		pixel_indices->resize(n);
+}
+
+} //: namespace detail
+
+/*!
+ * Back-projects 16-bit depth map (CV_16U) into a point cloud.
+ * \param rays ray table matching resolution of the depth map (see RayTable::update)
+ * \param mask optional mask runs, pixels outside of the mask are missing (NULL for none)
+ * \param color optional CV_8UC3 BGR image of the same size (used when HasColor)
+ * \param compact if true only valid points are emitted (unorganized, dense cloud),
+ * otherwise the cloud is organized and missing points are NaN
+ * \param pixel_indices in compact mode, optional output of image index of every point
+ * \param roi optional ROI projected with the same ray table (see Roi::project), pixels out of it are missing
+ */
+template <bool HasColor, typename PointT>
+void backProjectDepth(const cv::Mat & depth, const RayTable & rays, const MaskRuns * mask, const cv::Mat & color, pcl::PointCloud<PointT> & cloud,
+		bool compact = false, std::vector<int> * pixel_indices = NULL, const Roi * roi = NULL) {
+	detail::DepthSource src(depth, rays, roi);
+	detail::Rect rect(depth.cols, depth.rows, roi);
+	if (compact)
+		detail::backProjectCompact<HasColor>(src, depth.cols, rect, mask, color, cloud, pixel_indices);
+	else
+		detail::backProject<HasColor>(src, depth.cols, depth.rows, rect, mask, color, cloud);
+}
+
+/*!
+ * Converts CV_32FC3 image of Cartesian coordinates into a point cloud,
+ * parameters as in backProjectDepth. Points outside of the box of the ROI
+ * (which needs no projection) are missing.
+ */
+template <bool HasColor, typename PointT>
+void backProjectXYZ(const cv::Mat & xyz, const MaskRuns * mask, const cv::Mat & color, pcl::PointCloud<PointT> & cloud,
+		bool compact = false, std::vector<int> * pixel_indices = NULL, const Roi * roi = NULL) {
+	detail::XYZSource src(xyz, roi);
+	detail::Rect rect(xyz.cols, xyz.rows, NULL);
+	if (compact)
+		detail::backProjectCompact<HasColor>(src, xyz.cols, rect, mask, color, cloud, pixel_indices);
+	else
+		detail::backProject<HasColor>(src, xyz.cols, xyz.rows, rect, mask, color, cloud);
+}
+
+} //: namespace DepthBackProjection
+} //: namespace Types
+
+#endif /* DEPTHBACKPROJECTION_HPP_ */
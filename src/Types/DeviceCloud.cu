@@ -0,0 +1,300 @@
+/*!
+ * \file
+ * \brief CUDA implementation of device memory and filters of device clouds.
+ * \author Micha Laszkowski
+ *
+ * Built only with the DCL_WITH_CUDA option. Kept free of PCL and Eigen
+ * headers, points are handled as raw records of step bytes. Without a CUDA
+ * device the memory functions use the host and the filters are not called.
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <limits>
+#include <stdint.h>
+
+#include <cuda_runtime.h>
+
+#include <thrust/device_vector.h>
+#include <thrust/device_ptr.h>
+#include <thrust/copy.h>
+#include <thrust/sort.h>
+#include <thrust/reduce.h>
+#include <thrust/scan.h>
+#include <thrust/binary_search.h>
+#include <thrust/transform_reduce.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/iterator/constant_iterator.h>
+
+namespace Types {
+namespace Cuda {
+
+const size_t GRID_TOO_LARGE = (size_t) -1;
+
+namespace {
+
+const int THREADS = 256;
+
+/// Key of non-finite points, sorted after all voxels.
+const uint64_t INVALID = (uint64_t) -1;
+
+void check(cudaError_t error) {
+	if (error != cudaSuccess)
+		throw std::runtime_error(cudaGetErrorString(error));
+}
+
+unsigned int blocks(size_t n) {
+	return (n + THREADS - 1) / THREADS;
+}
+
+__host__ __device__ inline const float * record(const char * in, size_t step, size_t i) {
+	return reinterpret_cast<const float *>(in + i * step);
+}
+
+__host__ __device__ inline bool finite(const float * p) {
+	return fabsf(p[0]) <= FLT_MAX && fabsf(p[1]) <= FLT_MAX && fabsf(p[2]) <= FLT_MAX;
+}
+
+/// Box test of BoxCrop.
+struct InBox {
+	const char * in;
+	size_t step;
+	float min[3], max[3];
+	int negative[3];
+
+	__host__ __device__ bool operator()(unsigned int i) const {
+		const float * p = record(in, step, i);
+		bool keep = true;
+		for (int a = 0; a < 3; ++a) {
+			const bool inside = p[a] >= min[a] && p[a] <= max[a];
+			keep = keep && fabsf(p[a]) <= FLT_MAX && (inside != (negative[a] != 0));
+		}
+		return keep;
+	}
+};
+
+/// Copies records of the given indices, one thread per 16 bytes.
+__global__ void gather(const float4 * in, size_t words, const unsigned int * indices, size_t n, float4 * out) {
+	const size_t t = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	if (t >= n * words)
+		return;
+	const size_t i = t / words;
+	out[t] = in[indices[i] * words + t % words];
+}
+
+/// Bounding box of finite points.
+struct Bounds {
+	float min[3], max[3];
+};
+
+struct ToBounds {
+	const char * in;
+	size_t step;
+
+	__host__ __device__ Bounds operator()(unsigned int i) const {
+		const float * p = record(in, step, i);
+		Bounds b;
+		const bool ok = finite(p);
+		for (int a = 0; a < 3; ++a) {
+			b.min[a] = ok ? p[a] : FLT_MAX;
+			b.max[a] = ok ? p[a] : -FLT_MAX;
+		}
+		return b;
+	}
+};
+
+struct MergeBounds {
+	__host__ __device__ Bounds operator()(const Bounds & x, const Bounds & y) const {
+		Bounds b;
+		for (int a = 0; a < 3; ++a) {
+			b.min[a] = fminf(x.min[a], y.min[a]);
+			b.max[a] = fmaxf(x.max[a], y.max[a]);
+		}
+		return b;
+	}
+};
+
+/// Voxel index of every point, as in pcl::VoxelGrid.
+__global__ void voxelKeys(const char * in, size_t step, size_t n, float3 inverse, int3 min_b, int3 div_b,
+		uint64_t * keys, unsigned int * indices) {
+	const size_t i = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	if (i >= n)
+		return;
+	const float * p = record(in, step, i);
+	indices[i] = i;
+	if (!finite(p)) {
+		keys[i] = INVALID;
+		return;
+	}
+	const int64_t x = (int64_t) floorf(p[0] * inverse.x) - min_b.x;
+	const int64_t y = (int64_t) floorf(p[1] * inverse.y) - min_b.y;
+	const int64_t z = (int64_t) floorf(p[2] * inverse.z) - min_b.z;
+	keys[i] = x + y * div_b.x + z * (int64_t) div_b.x * div_b.y;
+}
+
+/// Averages one float field of one voxel, colour channels are averaged separately.
+__global__ void voxelAverage(const char * in, size_t step, const unsigned int * indices, const unsigned int * starts,
+		const unsigned int * counts, size_t voxels, int rgb_field, char * out) {
+	const size_t floats = step / sizeof(float);
+	const size_t t = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	if (t >= voxels * floats)
+		return;
+	const size_t v = t / floats;
+	const int f = t % floats;
+	const unsigned int start = starts[v];
+	const unsigned int count = counts[v];
+
+	if (f == rgb_field) {
+		float c[4] = { 0, 0, 0, 0 };
+		for (unsigned int k = 0; k < count; ++k) {
+			const uint32_t rgba = reinterpret_cast<const uint32_t *>(record(in, step, indices[start + k]))[f];
+			for (int ch = 0; ch < 4; ++ch)
+				c[ch] += (rgba >> (8 * ch)) & 0xff;
+		}
+		uint32_t rgba = 0;
+		for (int ch = 0; ch < 4; ++ch)
+			rgba |= ((uint32_t) (c[ch] / count)) << (8 * ch);
+		reinterpret_cast<uint32_t *>(out + v * step)[f] = rgba;
+		return;
+	}
+
+	float sum = 0;
+	for (unsigned int k = 0; k < count; ++k)
+		sum += record(in, step, indices[start + k])[f];
+	reinterpret_cast<float *>(out + v * step)[f] = sum / count;
+}
+
+bool probe() {
+	int devices = 0;
+	return cudaGetDeviceCount(&devices) == cudaSuccess && devices > 0;
+}
+
+} //: namespace
+
+bool available() {
+	static const bool present = probe();
+	return present;
+}
+
+void * allocate(size_t bytes) {
+	void * ptr = NULL;
+	if (!available())
+		ptr = std::malloc(bytes ? bytes : 1);
+	else if (cudaMalloc(&ptr, bytes ? bytes : 1) != cudaSuccess)
+		ptr = NULL;
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void release(void * ptr) {
+	if (!available())
+		std::free(ptr);
+	else
+		cudaFree(ptr);
+}
+
+void upload(void * device, const void * host, size_t bytes) {
+	if (!available())
+		std::memcpy(device, host, bytes);
+	else
+		check(cudaMemcpy(device, host, bytes, cudaMemcpyHostToDevice));
+}
+
+void download(void * host, const void * device, size_t bytes) {
+	if (!available())
+		std::memcpy(host, device, bytes);
+	else
+		check(cudaMemcpy(host, device, bytes, cudaMemcpyDeviceToHost));
+}
+
+size_t boxCrop(const void * in, size_t n, size_t step, const float min[3], const float max[3], const int negative[3], void * out) {
+	if (n == 0)
+		return 0;
+	InBox box;
+	box.in = static_cast<const char *>(in);
+	box.step = step;
+	for (int a = 0; a < 3; ++a) {
+		box.min[a] = min[a];
+		box.max[a] = max[a];
+		box.negative[a] = negative[a];
+	}
+
+	thrust::device_vector<unsigned int> indices(n);
+	const size_t m = thrust::copy_if(thrust::counting_iterator<unsigned int>(0), thrust::counting_iterator<unsigned int>(n),
+			indices.begin(), box) - indices.begin();
+
+	const size_t words = step / sizeof(float4);
+	if (m)
+		gather<<<blocks(m * words), THREADS>>>(static_cast<const float4 *>(in), words,
+				thrust::raw_pointer_cast(indices.data()), m, static_cast<float4 *>(out));
+	check(cudaGetLastError());
+	check(cudaDeviceSynchronize());
+	return m;
+}
+
+size_t voxelGrid(const void * in, size_t n, size_t step, const float leaf[3], int rgb_offset, void * out) {
+	if (n == 0)
+		return 0;
+	const char * points = static_cast<const char *>(in);
+
+	// Grid covering finite points.
+	ToBounds to_bounds = { points, step };
+	Bounds init;
+	for (int a = 0; a < 3; ++a) {
+		init.min[a] = FLT_MAX;
+		init.max[a] = -FLT_MAX;
+	}
+	const Bounds b = thrust::transform_reduce(thrust::counting_iterator<unsigned int>(0),
+			thrust::counting_iterator<unsigned int>(n), to_bounds, init, MergeBounds());
+	if (b.min[0] > b.max[0])
+		return 0;
+	const float3 inverse = make_float3(1.0f / leaf[0], 1.0f / leaf[1], 1.0f / leaf[2]);
+	const float inv[3] = { inverse.x, inverse.y, inverse.z };
+	// Same limit as pcl::VoxelGrid, checked before the voxel indices are converted to int.
+	float lo[3], hi[3];
+	double cells = 1;
+	for (int a = 0; a < 3; ++a) {
+		lo[a] = floorf(b.min[a] * inv[a]);
+		hi[a] = floorf(b.max[a] * inv[a]);
+		cells *= (double) hi[a] - lo[a] + 1;
+	}
+	const double limit = std::numeric_limits<int32_t>::max();
+	if (cells > limit || lo[0] < -limit || lo[1] < -limit || lo[2] < -limit || hi[0] > limit || hi[1] > limit || hi[2] > limit)
+		return GRID_TOO_LARGE;
+	const int3 min_b = make_int3((int) lo[0], (int) lo[1], (int) lo[2]);
+	const int3 div_b = make_int3((int) (hi[0] - lo[0]) + 1, (int) (hi[1] - lo[1]) + 1, (int) (hi[2] - lo[2]) + 1);
+
+	// Points sorted by voxel, non-finite last.
+	thrust::device_vector<uint64_t> keys(n);
+	thrust::device_vector<unsigned int> indices(n);
+	voxelKeys<<<blocks(n), THREADS>>>(points, step, n, inverse, min_b, div_b,
+			thrust::raw_pointer_cast(keys.data()), thrust::raw_pointer_cast(indices.data()));
+	check(cudaGetLastError());
+	thrust::sort_by_key(keys.begin(), keys.end(), indices.begin());
+	const size_t valid = thrust::lower_bound(keys.begin(), keys.end(), INVALID) - keys.begin();
+
+	// Segments of voxels.
+	thrust::device_vector<uint64_t> voxel_keys(valid);
+	thrust::device_vector<unsigned int> counts(valid);
+	const size_t voxels = thrust::reduce_by_key(keys.begin(), keys.begin() + valid, thrust::constant_iterator<unsigned int>(1),
+			voxel_keys.begin(), counts.begin()).first - voxel_keys.begin();
+	thrust::device_vector<unsigned int> starts(voxels);
+	thrust::exclusive_scan(counts.begin(), counts.begin() + voxels, starts.begin());
+
+	const size_t floats = step / sizeof(float);
+	if (voxels)
+		voxelAverage<<<blocks(voxels * floats), THREADS>>>(points, step, thrust::raw_pointer_cast(indices.data()),
+				thrust::raw_pointer_cast(starts.data()), thrust::raw_pointer_cast(counts.data()), voxels,
+				rgb_offset < 0 ? -1 : rgb_offset / (int) sizeof(float), static_cast<char *>(out));
+	check(cudaGetLastError());
+	check(cudaDeviceSynchronize());
+	return voxels;
+}
+
+} //: namespace Cuda
+} //: namespace Types
@@ -0,0 +1,167 @@
+/*!
+ * \file
+ * \brief Point cloud kept in the memory of the GPU between components.
+ * \author Micha Laszkowski
+ */
+
+#ifndef DEVICECLOUD_HPP_
+#define DEVICECLOUD_HPP_
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/CloudPool.hpp"
+
+namespace Types {
+
+/*!
+ * Memory of the device. Implemented in DeviceCloud.cu, which is built only
+ * with the DCL_WITH_CUDA option; without it, or when the machine has no CUDA
+ * device, the "device" is the host, so device clouds (and streams carrying
+ * them) work in every build and the filters fall back to the CPU.
+ */
+namespace Cuda {
+
+#ifdef DCL_WITH_CUDA
+/// Returns true if a CUDA device is present (probed once per process).
+bool available();
+/// Allocates device memory (host memory without a device), throws std::bad_alloc when it fails.
+void * allocate(size_t bytes);
+void release(void * ptr);
+void upload(void * device, const void * host, size_t bytes);
+void download(void * host, const void * device, size_t bytes);
+#else
+/// Returns false: this build has no GPU filters.
+inline bool available() { return false; }
+
+inline void * allocate(size_t bytes) {
+	void * ptr = std::malloc(bytes ? bytes : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+inline void release(void * ptr) { std::free(ptr); }
+inline void upload(void * device, const void * host, size_t bytes) { std::memcpy(device, host, bytes); }
+inline void download(void * host, const void * device, size_t bytes) { std::memcpy(host, device, bytes); }
+#endif
+
+} //: namespace Cuda
+
+/*!
+ * \class DeviceCloud
+ * \brief Points of a cloud in device memory, with the host copy made on demand.
+ *
+ * Points are stored as an array of PointT, with the layout of the host cloud,
+ * so transfers are single copies. GPU components pass device clouds to each
+ * other without touching the host; host() downloads the points only for the
+ * first CPU consumer and the copy is shared by all later ones.
+ */
+template <typename PointT>
+class DeviceCloud {
+public:
+	typedef boost::shared_ptr<DeviceCloud<PointT> > Ptr;
+	typedef boost::shared_ptr<const DeviceCloud<PointT> > ConstPtr;
+
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::Ptr CloudPtr;
+	typedef typename Cloud::ConstPtr CloudConstPtr;
+
+	/// Allocates a cloud for capacity points, its size is 0.
+	explicit DeviceCloud(size_t capacity) : size_(0), capacity_(capacity) {
+		memory_ = boost::shared_ptr<void>(Cuda::allocate(capacity * sizeof(PointT)), &Cuda::release);
+		sensor_origin_ = Eigen::Vector4f::Zero();
+		sensor_orientation_ = Eigen::Quaternionf::Identity();
+	}
+
+	/// Copies the cloud to the device, the cloud is remembered as the host copy (it is never modified, see host()).
+	static Ptr upload(const CloudConstPtr & cloud) {
+		Ptr device(new DeviceCloud(cloud->size()));
+		if (!cloud->empty())
+			Cuda::upload(device->data(), &cloud->points[0], cloud->size() * sizeof(PointT));
+		device->size_ = cloud->size();
+		device->copyMetadata(*cloud);
+		device->host_ = boost::const_pointer_cast<Cloud>(cloud);
+		return device;
+	}
+
+	/// Host copy of the points, downloaded on the first call. It is shared, so it must not be modified.
+	CloudPtr host() const {
+		boost::mutex::scoped_lock lock(mutex_);
+		if (!host_) {
+			CloudPtr cloud = CloudPool<PointT>::acquire(size_);
+			cloud->points.resize(size_);
+			if (size_)
+				Cuda::download(&cloud->points[0], data(), size_ * sizeof(PointT));
+			cloud->width = size_;
+			cloud->height = 1;
+			cloud->is_dense = true;
+			cloud->header = header;
+			cloud->sensor_origin_ = sensor_origin_;
+			cloud->sensor_orientation_ = sensor_orientation_;
+			host_ = cloud;
+		}
+		return host_;
+	}
+
+	/// Points in device memory.
+	PointT * data() {
+		return static_cast<PointT *>(memory_.get());
+	}
+
+	const PointT * data() const {
+		return static_cast<const PointT *>(memory_.get());
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	size_t capacity() const {
+		return capacity_;
+	}
+
+	bool empty() const {
+		return size_ == 0;
+	}
+
+	/// Sets number of valid points (at most capacity), after points were written to data().
+	void resize(size_t size) {
+		size_ = std::min(size, capacity_);
+		boost::mutex::scoped_lock lock(mutex_);
+		host_.reset();
+	}
+
+	/// Copies header and sensor pose of the cloud.
+	template <typename CloudT>
+	void copyMetadata(const CloudT & cloud) {
+		header = cloud.header;
+		sensor_origin_ = cloud.sensor_origin_;
+		sensor_orientation_ = cloud.sensor_orientation_;
+	}
+
+	pcl::PCLHeader header;
+	Eigen::Vector4f sensor_origin_;
+	Eigen::Quaternionf sensor_orientation_;
+
+private:
+	boost::shared_ptr<void> memory_;
+	size_t size_;
+	size_t capacity_;
+
+	mutable CloudPtr host_;
+	mutable boost::mutex mutex_;
+
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} //: namespace Types
+
+#endif /* DEVICECLOUD_HPP_ */
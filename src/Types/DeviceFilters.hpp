@@ -0,0 +1,104 @@
+/*!
+ * \file
+ * \brief Box crop and voxel grid downsampling of device clouds.
+ * \author Micha Laszkowski
+ */
+
+#ifndef DEVICEFILTERS_HPP_
+#define DEVICEFILTERS_HPP_
+
+#include <string>
+#include <vector>
+
+#include <pcl/PCLPointField.h>
+#include <pcl/common/io.h>
+
+#include "Types/DeviceCloud.hpp"
+#include "Types/BoxCrop.hpp"
+
+namespace Types {
+namespace Cuda {
+
+#ifdef DCL_WITH_CUDA
+
+/// Value returned by voxelGrid() when voxel indices would overflow.
+const size_t GRID_TOO_LARGE = (size_t) -1;
+
+/*!
+ * Copies points (step bytes each, multiple of 16, x/y/z floats at offsets
+ * 0, 4, 8) that pass the box test of BoxCrop to out, keeping their order.
+ * Non-finite points are removed. Returns the number of copied points.
+ */
+size_t boxCrop(const void * in, size_t n, size_t step, const float min[3], const float max[3], const int negative[3], void * out);
+
+/*!
+ * Replaces points of every occupied voxel by their average, the same way
+ * as pcl::VoxelGrid does: all float fields are averaged, the colour packed
+ * at rgb_offset (-1 if there is none) is averaged per channel, voxels are
+ * output in order of their index. Non-finite points are ignored.
+ * Returns the number of voxels or GRID_TOO_LARGE.
+ */
+size_t voxelGrid(const void * in, size_t n, size_t step, const float leaf[3], int rgb_offset, void * out);
+
+#endif /* DCL_WITH_CUDA */
+
+/// Offset of the packed colour field of PointT, -1 if there is none.
+template <typename PointT>
+int colorOffset() {
+	std::vector<pcl::PCLPointField> fields;
+	pcl::getFields<PointT>(fields);
+	for (size_t i = 0; i < fields.size(); ++i)
+		if (fields[i].name == "rgb" || fields[i].name == "rgba")
+			return fields[i].offset;
+	return -1;
+}
+
+/// Crops the device cloud to the box, on the device. Returns empty pointer when there is no device.
+template <typename PointT>
+typename DeviceCloud<PointT>::Ptr crop(const DeviceCloud<PointT> & input, const BoxCrop & box) {
+#ifdef DCL_WITH_CUDA
+	if (!available())
+		return typename DeviceCloud<PointT>::Ptr();
+	float min[3], max[3];
+	int negative[3];
+	for (int a = 0; a < 3; ++a) {
+		bool neg;
+		box.getLimits(a, min[a], max[a], neg);
+		negative[a] = neg;
+	}
+	typename DeviceCloud<PointT>::Ptr output(new DeviceCloud<PointT>(input.size()));
+	output->resize(boxCrop(input.data(), input.size(), sizeof(PointT), min, max, negative, output->data()));
+	output->copyMetadata(input);
+	return output;
+#else
+	return typename DeviceCloud<PointT>::Ptr();
+#endif
+}
+
+/*!
+ * Downsamples the device cloud with voxels of the given size, on the device.
+ * Returns empty pointer when there is no device or the grid is too large;
+ * callers then filter the host copy on the CPU.
+ */
+template <typename PointT>
+typename DeviceCloud<PointT>::Ptr voxelGrid(const DeviceCloud<PointT> & input, float x, float y, float z) {
+#ifdef DCL_WITH_CUDA
+	if (!available())
+		return typename DeviceCloud<PointT>::Ptr();
+	const float leaf[3] = { x, y, z };
+	typename DeviceCloud<PointT>::Ptr output(new DeviceCloud<PointT>(input.size()));
+	const size_t n = voxelGrid(input.data(), input.size(), sizeof(PointT), leaf, colorOffset<PointT>(), output->data());
+	if (n == GRID_TOO_LARGE)
+		return typename DeviceCloud<PointT>::Ptr();
+	output->resize(n);
+	output->copyMetadata(input);
+	return output;
+#else
+	return typename DeviceCloud<PointT>::Ptr();
+#endif
+}
+
+} //: namespace Cuda
+} //: namespace Types
+
+#endif /* DEVICEFILTERS_HPP_ */
@@ -0,0 +1,419 @@
+/*!
+ * \file
+ * \brief CUDA implementation of Euclidean clustering and k nearest neighbour search of device clouds.
+ * \author Micha Laszkowski
+ *
+ * Built only with the DCL_WITH_CUDA option. Kept free of PCL and Eigen
+ * headers, points are handled as raw records of step bytes with x, y, z
+ * floats at offsets 0, 4, 8.
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+#include <stdint.h>
+
+#include <cuda_runtime.h>
+
+#include <thrust/device_vector.h>
+#include <thrust/sort.h>
+#include <thrust/binary_search.h>
+#include <thrust/transform_reduce.h>
+#include <thrust/iterator/counting_iterator.h>
+
+namespace Types {
+namespace Cuda {
+
+const int MAX_K = 32;
+
+namespace {
+
+const int THREADS = 256;
+
+/// Key of non-finite points, sorted after all cells.
+const uint64_t INVALID = (uint64_t) -1;
+
+/// Bits of one cell coordinate in a key.
+const int BITS = 21;
+const int CELLS = 1 << BITS;
+
+void check(cudaError_t error) {
+	if (error != cudaSuccess)
+		throw std::runtime_error(cudaGetErrorString(error));
+}
+
+unsigned int blocks(size_t n) {
+	return (n + THREADS - 1) / THREADS;
+}
+
+__host__ __device__ inline const float * record(const char * in, size_t step, size_t i) {
+	return reinterpret_cast<const float *>(in + i * step);
+}
+
+__host__ __device__ inline bool finite(const float * p) {
+	return fabsf(p[0]) <= FLT_MAX && fabsf(p[1]) <= FLT_MAX && fabsf(p[2]) <= FLT_MAX;
+}
+
+__device__ inline float dist2(const float * a, const float * b) {
+	const float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+	return dx * dx + dy * dy + dz * dz;
+}
+
+/// Bounding box of finite points.
+struct Bounds {
+	float min[3], max[3];
+};
+
+struct ToBounds {
+	const char * in;
+	size_t step;
+
+	__host__ __device__ Bounds operator()(unsigned int i) const {
+		const float * p = record(in, step, i);
+		Bounds b;
+		const bool ok = finite(p);
+		for (int a = 0; a < 3; ++a) {
+			b.min[a] = ok ? p[a] : FLT_MAX;
+			b.max[a] = ok ? p[a] : -FLT_MAX;
+		}
+		return b;
+	}
+};
+
+struct MergeBounds {
+	__host__ __device__ Bounds operator()(const Bounds & x, const Bounds & y) const {
+		Bounds b;
+		for (int a = 0; a < 3; ++a) {
+			b.min[a] = fminf(x.min[a], y.min[a]);
+			b.max[a] = fmaxf(x.max[a], y.max[a]);
+		}
+		return b;
+	}
+};
+
+/// Uniform grid of cells of the search radius over sorted points, read by kernels.
+struct GridView {
+	const char * points;
+	size_t step;
+	/// Cell keys of points in ascending order, and indices of the points.
+	const uint64_t * keys;
+	const unsigned int * order;
+	/// Points of finite coordinates, the first ones of keys.
+	size_t valid;
+	float3 origin;
+	float inverse;
+	int3 cells;
+};
+
+__host__ __device__ inline uint64_t cellKey(int x, int y, int z) {
+	return (uint64_t) x | ((uint64_t) y << BITS) | ((uint64_t) z << (2 * BITS));
+}
+
+/// Cell key of every point, INVALID for non-finite ones.
+__global__ void gridKeys(const char * in, size_t step, size_t n, float3 origin, float inverse, uint64_t * keys, unsigned int * order) {
+	const size_t i = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	if (i >= n)
+		return;
+	const float * p = record(in, step, i);
+	order[i] = i;
+	keys[i] = finite(p) ? cellKey((int) floorf((p[0] - origin.x) * inverse), (int) floorf((p[1] - origin.y) * inverse),
+			(int) floorf((p[2] - origin.z) * inverse)) : INVALID;
+}
+
+/// First position of the key in sorted keys, or n.
+__device__ inline size_t lowerBound(const uint64_t * keys, size_t n, uint64_t key) {
+	size_t lo = 0, hi = n;
+	while (lo < hi) {
+		const size_t mid = (lo + hi) / 2;
+		if (keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/// Calls visit(j) for every point j of the 27 cells around p, so for all points within the cell size.
+template <typename Visitor>
+__device__ void forNeighbours(const GridView & grid, const float * p, Visitor & visit) {
+	// Queries far outside the grid have no neighbours, the check keeps the int conversion in range.
+	const float fx = floorf((p[0] - grid.origin.x) * grid.inverse);
+	const float fy = floorf((p[1] - grid.origin.y) * grid.inverse);
+	const float fz = floorf((p[2] - grid.origin.z) * grid.inverse);
+	if (fx < -1 || fy < -1 || fz < -1 || fx > grid.cells.x || fy > grid.cells.y || fz > grid.cells.z)
+		return;
+	const int cx = fx, cy = fy, cz = fz;
+	for (int z = max(cz - 1, 0); z <= min(cz + 1, grid.cells.z - 1); ++z)
+		for (int y = max(cy - 1, 0); y <= min(cy + 1, grid.cells.y - 1); ++y)
+			for (int x = max(cx - 1, 0); x <= min(cx + 1, grid.cells.x - 1); ++x) {
+				const uint64_t key = cellKey(x, y, z);
+				for (size_t k = lowerBound(grid.keys, grid.valid, key); k < grid.valid && grid.keys[k] == key; ++k)
+					visit(grid.order[k]);
+			}
+}
+
+/// Points sorted by cells of the given size, kept while kernels use the view.
+class Grid {
+public:
+	/// Builds the grid, returns false if there are too many cells for the keys.
+	bool build(const char * points, size_t n, size_t step, float cell) {
+		ToBounds to_bounds = { points, step };
+		Bounds init;
+		for (int a = 0; a < 3; ++a) {
+			init.min[a] = FLT_MAX;
+			init.max[a] = -FLT_MAX;
+		}
+		const Bounds b = thrust::transform_reduce(thrust::counting_iterator<unsigned int>(0),
+				thrust::counting_iterator<unsigned int>(n), to_bounds, init, MergeBounds());
+
+		view.points = points;
+		view.step = step;
+		view.inverse = 1.0f / cell;
+		view.origin = make_float3(b.min[0], b.min[1], b.min[2]);
+		view.cells = make_int3(1, 1, 1);
+		if (b.min[0] <= b.max[0]) {
+			const double extent[3] = { ((double) b.max[0] - b.min[0]) * view.inverse, ((double) b.max[1] - b.min[1]) * view.inverse,
+					((double) b.max[2] - b.min[2]) * view.inverse };
+			if (extent[0] >= CELLS - 1 || extent[1] >= CELLS - 1 || extent[2] >= CELLS - 1)
+				return false;
+			// One more cell in every axis, keys are computed in float and may round up to it.
+			view.cells = make_int3((int) extent[0] + 2, (int) extent[1] + 2, (int) extent[2] + 2);
+		}
+
+		keys.resize(n);
+		order.resize(n);
+		gridKeys<<<blocks(n), THREADS>>>(points, step, n, view.origin, view.inverse,
+				thrust::raw_pointer_cast(keys.data()), thrust::raw_pointer_cast(order.data()));
+		check(cudaGetLastError());
+		thrust::sort_by_key(keys.begin(), keys.end(), order.begin());
+		view.valid = thrust::lower_bound(keys.begin(), keys.end(), INVALID) - keys.begin();
+		view.keys = thrust::raw_pointer_cast(keys.data());
+		view.order = thrust::raw_pointer_cast(order.data());
+		return true;
+	}
+
+	GridView view;
+
+private:
+	thrust::device_vector<uint64_t> keys;
+	thrust::device_vector<unsigned int> order;
+};
+
+/// Root of the point, halving the path. Only non-roots are rewritten, roots change by atomicCAS only.
+__device__ inline int findRoot(volatile int * parent, int i) {
+	int p = parent[i];
+	while (p != i) {
+		const int gp = parent[p];
+		if (p != gp)
+			parent[i] = gp;
+		i = p;
+		p = gp;
+	}
+	return i;
+}
+
+/// Joins components, the root of the larger index is hooked under the smaller one.
+__device__ inline void unite(int * parent, int a, int b) {
+	for (;;) {
+		a = findRoot(parent, a);
+		b = findRoot(parent, b);
+		if (a == b)
+			return;
+		if (a > b) {
+			const int t = a;
+			a = b;
+			b = t;
+		}
+		if (atomicCAS(&parent[b], b, a) == b)
+			return;
+	}
+}
+
+__global__ void clusterInit(const char * in, size_t step, size_t n, int * parent) {
+	const size_t i = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	if (i < n)
+		parent[i] = finite(record(in, step, i)) ? (int) i : -1;
+}
+
+/// Unites the point with its neighbours of smaller index, so every pair is tested once.
+struct Link {
+	__device__ void operator()(unsigned int j) {
+		if ((int) j < i && dist2(p, record(grid.points, grid.step, j)) <= tol2)
+			unite(parent, i, j);
+	}
+	GridView grid;
+	const float * p;
+	int i;
+	float tol2;
+	int * parent;
+};
+
+__global__ void clusterLinks(GridView grid, size_t n, float tol2, int * parent) {
+	const size_t i = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	if (i >= n || parent[i] < 0)
+		return;
+	Link link = { grid, record(grid.points, grid.step, i), (int) i, tol2, parent };
+	forNeighbours(grid, link.p, link);
+}
+
+__global__ void clusterFlatten(size_t n, int * parent) {
+	const size_t i = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	if (i < n && parent[i] >= 0)
+		parent[i] = findRoot(parent, i);
+}
+
+/// k nearest points found so far, sorted by distance.
+struct Nearest {
+	__device__ void init(int k_) {
+		k = k_;
+		count = 0;
+	}
+
+	__device__ void insert(float d, int j) {
+		if (count == k && d >= dist[k - 1])
+			return;
+		int s = count < k ? count++ : k - 1;
+		while (s > 0 && dist[s - 1] > d) {
+			dist[s] = dist[s - 1];
+			index[s] = index[s - 1];
+			--s;
+		}
+		dist[s] = d;
+		index[s] = j;
+	}
+
+	__device__ void write(int * indices, float * distances) const {
+		for (int s = 0; s < k; ++s) {
+			indices[s] = s < count ? index[s] : -1;
+			distances[s] = s < count ? dist[s] : FLT_MAX;
+		}
+	}
+
+	int k, count;
+	int index[MAX_K];
+	float dist[MAX_K];
+};
+
+/// Visitor of the grid search, points within the radius only.
+struct GridNearest {
+	__device__ void operator()(unsigned int j) {
+		const float d = dist2(p, record(points, step, j));
+		if (d <= r2)
+			nearest.insert(d, j);
+	}
+	const char * points;
+	size_t step;
+	const float * p;
+	float r2;
+	Nearest nearest;
+};
+
+__global__ void nearestGrid(const char * queries, size_t qstep, size_t nq, GridView grid, int k, float r2,
+		int * indices, float * distances) {
+	const size_t i = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	if (i >= nq)
+		return;
+	GridNearest search;
+	search.points = grid.points;
+	search.step = grid.step;
+	search.p = record(queries, qstep, i);
+	search.r2 = r2;
+	search.nearest.init(k);
+	if (finite(search.p))
+		forNeighbours(grid, search.p, search);
+	search.nearest.write(indices + i * k, distances + i * k);
+}
+
+/// Every query compared with all points, read through tiles of shared memory.
+__global__ void nearestTiled(const char * queries, size_t qstep, size_t nq, const char * points, size_t step, size_t n,
+		int k, float r2, int * indices, float * distances) {
+	__shared__ float4 tile[THREADS];
+	const size_t i = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	const bool active = i < nq;
+	float q[3] = { 0, 0, 0 };
+	bool valid = false;
+	if (active) {
+		const float * p = record(queries, qstep, i);
+		valid = finite(p);
+		q[0] = p[0];
+		q[1] = p[1];
+		q[2] = p[2];
+	}
+
+	Nearest nearest;
+	nearest.init(k);
+	for (size_t base = 0; base < n; base += THREADS) {
+		const size_t j = base + threadIdx.x;
+		if (j < n) {
+			const float * p = record(points, step, j);
+			tile[threadIdx.x] = finite(p) ? make_float4(p[0], p[1], p[2], 1) : make_float4(0, 0, 0, 0);
+		}
+		__syncthreads();
+		if (valid) {
+			const int count = min((size_t) THREADS, n - base);
+			for (int t = 0; t < count; ++t) {
+				const float4 p = tile[t];
+				if (p.w == 0)
+					continue;
+				const float dx = q[0] - p.x, dy = q[1] - p.y, dz = q[2] - p.z;
+				const float d = dx * dx + dy * dy + dz * dz;
+				if (d <= r2)
+					nearest.insert(d, base + t);
+			}
+		}
+		__syncthreads();
+	}
+	if (active)
+		nearest.write(indices + i * k, distances + i * k);
+}
+
+} //: namespace
+
+bool euclideanLabels(const void * in, size_t n, size_t step, float tolerance, int * labels) {
+	if (n == 0)
+		return true;
+	if (!(tolerance > 0))
+		return false;
+	const char * points = static_cast<const char *>(in);
+
+	// Neighbours within the tolerance are in the 27 cells around the point.
+	Grid grid;
+	if (!grid.build(points, n, step, tolerance))
+		return false;
+
+	thrust::device_vector<int> parent(n);
+	int * p = thrust::raw_pointer_cast(parent.data());
+	clusterInit<<<blocks(n), THREADS>>>(points, step, n, p);
+	clusterLinks<<<blocks(n), THREADS>>>(grid.view, n, tolerance * tolerance, p);
+	clusterFlatten<<<blocks(n), THREADS>>>(n, p);
+	check(cudaGetLastError());
+	check(cudaMemcpy(labels, p, n * sizeof(int), cudaMemcpyDeviceToHost));
+	return true;
+}
+
+void nearestK(const void * queries, size_t nq, size_t qstep, const void * points, size_t n, size_t step, int k, float radius,
+		int * indices, float * sqr_distances) {
+	if (nq == 0 || k <= 0)
+		return;
+	if (k > MAX_K)
+		throw std::invalid_argument("nearestK: k is larger than MAX_K");
+
+	thrust::device_vector<int> d_indices(nq * k);
+	thrust::device_vector<float> d_distances(nq * k);
+	const float r2 = radius > 0 && radius < sqrtf(FLT_MAX) ? radius * radius : FLT_MAX;
+
+	// Bounded searches visit only cells around the query, unbounded or too fine grids compare all pairs.
+	Grid grid;
+	if (n > 0 && r2 < FLT_MAX && grid.build(static_cast<const char *>(points), n, step, radius))
+		nearestGrid<<<blocks(nq), THREADS>>>(static_cast<const char *>(queries), qstep, nq, grid.view, k, r2,
+				thrust::raw_pointer_cast(d_indices.data()), thrust::raw_pointer_cast(d_distances.data()));
+	else
+		nearestTiled<<<blocks(nq), THREADS>>>(static_cast<const char *>(queries), qstep, nq, static_cast<const char *>(points),
+				step, n, k, r2, thrust::raw_pointer_cast(d_indices.data()), thrust::raw_pointer_cast(d_distances.data()));
+	check(cudaGetLastError());
+	check(cudaMemcpy(indices, thrust::raw_pointer_cast(d_indices.data()), nq * k * sizeof(int), cudaMemcpyDeviceToHost));
+	check(cudaMemcpy(sqr_distances, thrust::raw_pointer_cast(d_distances.data()), nq * k * sizeof(float), cudaMemcpyDeviceToHost));
+}
+
+} //: namespace Cuda
+} //: namespace Types
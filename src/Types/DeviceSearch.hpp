@@ -0,0 +1,139 @@
+/*!
+ * \file
+ * \brief Euclidean clustering and k nearest neighbour search of device clouds.
+ * \author Micha Laszkowski
+ */
+
+#ifndef DEVICESEARCH_HPP_
+#define DEVICESEARCH_HPP_
+
+#include <vector>
+#include <algorithm>
+
+#include <pcl/PCLPointField.h>
+#include <pcl/PointIndices.h>
+#include <pcl/common/io.h>
+
+#include "Types/DeviceCloud.hpp"
+
+namespace Types {
+namespace Cuda {
+
+/// Most neighbours nearestK() returns for a query.
+const int MAX_K = 32;
+
+/// True if x, y, z of PointT are floats at offsets 0, 4, 8, so that kernels can read its points.
+template <typename PointT>
+bool searchable() {
+	std::vector<pcl::PCLPointField> fields;
+	pcl::getFields<PointT>(fields);
+	int found = 0;
+	for (size_t i = 0; i < fields.size(); ++i) {
+		const int axis = fields[i].name == "x" ? 0 : fields[i].name == "y" ? 1 : fields[i].name == "z" ? 2 : -1;
+		if (axis >= 0 && fields[i].datatype == pcl::PCLPointField::FLOAT32 && fields[i].offset == 4 * (unsigned) axis)
+			++found;
+	}
+	return found == 3;
+}
+
+/*!
+ * Clusters of labels (the smallest point index of the cluster, -1 for
+ * skipped points), in the form of pcl::EuclideanClusterExtraction: clusters
+ * of accepted size, sorted by decreasing size, indices sorted within cluster.
+ */
+inline void labelsToClusters(const std::vector<int> & labels, const pcl::PCLHeader & header, int min_size, int max_size,
+		std::vector<pcl::PointIndices> & clusters) {
+	std::vector<int> sizes(labels.size(), 0);
+	for (size_t i = 0; i < labels.size(); ++i)
+		if (labels[i] >= 0)
+			++sizes[labels[i]];
+
+	// Roots in ascending order, so clusters of equal size keep the order of their first point.
+	std::vector<std::pair<int, int> > order;
+	for (size_t i = 0; i < sizes.size(); ++i)
+		if (sizes[i] > 0 && sizes[i] >= min_size && sizes[i] <= max_size)
+			order.push_back(std::make_pair(-sizes[i], (int) i));
+	std::stable_sort(order.begin(), order.end());
+
+	std::vector<int> slot(labels.size(), -1);
+	clusters.clear();
+	clusters.resize(order.size());
+	for (size_t c = 0; c < order.size(); ++c) {
+		slot[order[c].second] = c;
+		clusters[c].header = header;
+		clusters[c].indices.reserve(-order[c].first);
+	}
+	for (size_t i = 0; i < labels.size(); ++i)
+		if (labels[i] >= 0 && slot[labels[i]] >= 0)
+			clusters[slot[labels[i]]].indices.push_back(i);
+}
+
+#ifdef DCL_WITH_CUDA
+
+/*!
+ * Labels points (step bytes each, x/y/z floats at offsets 0, 4, 8) by
+ * connected components of pairs closer than the tolerance, found on a
+ * uniform grid of cells of the tolerance with union-find. The label of a
+ * point is the smallest index of its component, -1 for non-finite points.
+ * labels is a host array of n ints. Returns false when the grid is too large.
+ */
+bool euclideanLabels(const void * in, size_t n, size_t step, float tolerance, int * labels);
+
+/*!
+ * Finds k (at most MAX_K) nearest points within the radius (unbounded if
+ * radius <= 0) for every query, closest first. indices and sqr_distances
+ * are host arrays of nq * k, padded with -1 and FLT_MAX when fewer points
+ * were found. Bounded searches use a grid of cells of the radius, the rest
+ * compare all pairs.
+ */
+void nearestK(const void * queries, size_t nq, size_t qstep, const void * points, size_t n, size_t step, int k, float radius,
+		int * indices, float * sqr_distances);
+
+#endif /* DCL_WITH_CUDA */
+
+/*!
+ * Euclidean clusters of the device cloud. Returns false when there is no
+ * device or the grid is too large, clusters are not touched then.
+ */
+template <typename PointT>
+bool euclideanClusters(const DeviceCloud<PointT> & cloud, float tolerance, int min_size, int max_size,
+		std::vector<pcl::PointIndices> & clusters) {
+#ifdef DCL_WITH_CUDA
+	if (!available())
+		return false;
+	std::vector<int> labels(cloud.size());
+	if (!euclideanLabels(cloud.data(), cloud.size(), sizeof(PointT), tolerance, labels.empty() ? NULL : &labels[0]))
+		return false;
+	labelsToClusters(labels, cloud.header, min_size, max_size, clusters);
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*!
+ * k nearest points of the device cloud for every query, k indices and
+ * squared distances per query (see nearestK()). Returns false when there is
+ * no device, the results are not touched then.
+ */
+template <typename QueryT, typename PointT>
+bool nearestK(const DeviceCloud<QueryT> & queries, const DeviceCloud<PointT> & points, int k, float radius,
+		std::vector<int> & indices, std::vector<float> & sqr_distances) {
+#ifdef DCL_WITH_CUDA
+	if (!available())
+		return false;
+	indices.resize(queries.size() * k);
+	sqr_distances.resize(queries.size() * k);
+	if (!indices.empty())
+		nearestK(queries.data(), queries.size(), sizeof(QueryT), points.data(), points.size(), sizeof(PointT), k, radius,
+				&indices[0], &sqr_distances[0]);
+	return true;
+#else
+	return false;
+#endif
+}
+
+} //: namespace Cuda
+} //: namespace Types
+
+#endif /* DEVICESEARCH_HPP_ */
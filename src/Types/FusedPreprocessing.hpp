@@ -0,0 +1,340 @@
+/*!
+ * \file
+ * \brief Crop, voxel grid and outlier removal fused with back-projection of depth images.
+ * \author Micha Laszkowski
+ */
+
+#ifndef FUSEDPREPROCESSING_HPP_
+#define FUSEDPREPROCESSING_HPP_
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/common/io.h>
+
+#include "Types/DepthBackProjection.hpp"
+#include "Types/VoxelHash.hpp"
+#include "Types/IndexedCloud.hpp"
+#include "Types/StatisticalOutliers.hpp"
+#include "Types/ThreadPool.hpp"
+
+namespace Types {
+
+/*!
+ * \class FusedPreprocessor
+ * \brief Standard front end (DepthConverter, PassThrough, VoxelGrid, StatisticalOutlierRemoval) in one pass.
+ *
+ * Tiles of rows of the image are back-projected in parallel, like in the
+ * compacting engine of DepthBackProjection: pixels outside of the rectangle
+ * of the ROI or its range of depths are skipped, the remaining points are
+ * tested against the box exactly and go straight to the voxel table of the
+ * tile (or to its list of points, when voxels are disabled), so no point of
+ * the full cloud is ever stored. Voxel tables of tiles are then merged in
+ * order of tiles, which numbers voxels in order of their first point, as in
+ * HashVoxelGrid. Statistical outliers are finally searched among voxels.
+ *
+ * Results equal those of the chain of components with HashVoxelGrid (mode
+ * hash of VoxelGrid) with policies centroid or first.
+ */
+template <typename PointT>
+class FusedPreprocessor {
+public:
+	typedef pcl::PointCloud<PointT> Cloud;
+
+	enum Policy { CENTROID, FIRST };
+
+	/// Parses policy name (centroid, first), returns false if unknown.
+	static bool parsePolicy(const std::string & name, Policy & policy) {
+		if (name == "centroid")
+			policy = CENTROID;
+		else if (name == "first")
+			policy = FIRST;
+		else
+			return false;
+		return true;
+	}
+
+	FusedPreprocessor() : policy_(CENTROID), voxelize_(true), mean_k_(0), std_mul_(1.0), negative_(false),
+			converted_(0), cropped_(0), voxels_(0), reduced_(new Cloud) {
+		setLeafSize(0.01f, 0.01f, 0.01f);
+	}
+
+	/// Sets size of voxels, non-positive size disables the voxel grid.
+	void setLeafSize(float x, float y, float z) {
+		voxelize_ = x > 0 && y > 0 && z > 0;
+		inverse_[0] = 1.0 / x;
+		inverse_[1] = 1.0 / y;
+		inverse_[2] = 1.0 / z;
+	}
+
+	void setPolicy(Policy policy) {
+		policy_ = policy;
+	}
+
+	/// Sets parameters of outlier removal (as in StatisticalOutlierRemoval), mean_k below 1 disables it.
+	void setOutliers(int mean_k, double std_mul, bool negative = false) {
+		mean_k_ = mean_k;
+		std_mul_ = std_mul;
+		negative_ = negative;
+	}
+
+	/*!
+	 * Processes 16-bit depth map, parameters as in DepthBackProjection::backProjectDepth.
+	 * \param roi projected ROI (see DepthBackProjection::Roi::project), points out of its box are removed, NULL for none
+	 */
+	template <bool HasColor>
+	void processDepth(const cv::Mat & depth, const DepthBackProjection::RayTable & rays, const DepthBackProjection::MaskRuns * mask,
+			const cv::Mat & color, const DepthBackProjection::Roi * roi, Cloud & output) {
+		DepthBackProjection::detail::DepthSource src(depth, rays, roi);
+		process<HasColor>(src, depth.cols, DepthBackProjection::detail::Rect(depth.cols, depth.rows, roi), mask, color, roi, output);
+	}
+
+	/// Processes CV_32FC3 image of Cartesian coordinates, parameters as in DepthBackProjection::backProjectXYZ.
+	template <bool HasColor>
+	void processXYZ(const cv::Mat & xyz, const DepthBackProjection::MaskRuns * mask, const cv::Mat & color,
+			const DepthBackProjection::Roi * roi, Cloud & output) {
+		DepthBackProjection::detail::XYZSource src(xyz, roi);
+		process<HasColor>(src, xyz.cols, DepthBackProjection::detail::Rect(xyz.cols, xyz.rows, NULL), mask, color, NULL, output);
+	}
+
+	/// Valid points of the last image.
+	size_t converted() const { return converted_; }
+
+	/// Points of the last image in the box.
+	size_t cropped() const { return cropped_; }
+
+	/// Points left by the voxel grid (cropped points when disabled).
+	size_t voxels() const { return voxels_; }
+
+	/// Mean distances of voxels to their neighbours, empty when outlier removal is disabled.
+	const std::vector<float> & meanDistances() const { return outliers_.distances; }
+
+private:
+	typedef typename Cloud::VectorType Points;
+
+	/// Points or voxels of a tile of rows, kept between frames to avoid allocations.
+	struct Tile {
+		void clear() {
+			table.clear(table.size());
+			keys.clear();
+			first.clear();
+			counts.clear();
+			sums.clear();
+			points.clear();
+			converted = 0;
+		}
+
+		VoxelHash table;
+
+		/// Coordinates (three per voxel), first point, number of points and sums (SUMS per voxel) of voxels.
+		std::vector<int64_t> keys;
+		Points first;
+		std::vector<int> counts;
+		std::vector<double> sums;
+
+		/// Cropped points, when voxels are disabled.
+		Points points;
+
+		size_t converted;
+	};
+
+	/// Sums of x, y, z and of four channels of colour per voxel.
+	static const int SUMS = 7;
+
+	/// Body of the parallel loop over tiles.
+	template <bool HasColor, typename Source>
+	struct TileBody {
+		TileBody(FusedPreprocessor & owner, const Source & src, int width, const DepthBackProjection::detail::Rect & rect, int rows,
+				const DepthBackProjection::MaskRuns * mask, const cv::Mat & color, const DepthBackProjection::Roi * roi) :
+			owner(owner), src(src), width(width), rect(rect), rows(rows), mask(mask), color(color), roi(roi) {
+		}
+
+		void operator()(int begin, int end, int slot) const {
+			Points & row = owner.scratch_[slot];
+			row.resize(width);
+			for (int t = begin; t < end; ++t) {
+				Tile & tile = owner.tiles_[t];
+				tile.clear();
+
+				DepthBackProjection::MaskRuns::Run full;
+				const DepthBackProjection::MaskRuns::Run * rb, * re;
+				for (int v = rect.v0 + t * rows; v < std::min(rect.v1, rect.v0 + (t + 1) * rows); ++v) {
+					DepthBackProjection::detail::rowRuns(mask, v, width, full, rb, re);
+					for (const DepthBackProjection::MaskRuns::Run * r = rb; r != re; ++r) {
+						int b, e;
+						if (!rect.clip(*r, b, e))
+							continue;
+						DepthBackProjection::detail::fillSpan<HasColor>(src, v, b, e, color, &row[0]);
+						for (int u = b; u < e; ++u) {
+							const PointT & p = row[u];
+							if (p.z != p.z)
+								continue;
+							++tile.converted;
+							if (roi && !roi->contains(p))
+								continue;
+							if (owner.voxelize_)
+								owner.add(tile, p);
+							else
+								tile.points.push_back(p);
+						}
+					}
+				}
+			}
+		}
+
+		FusedPreprocessor & owner;
+		const Source & src;
+		int width;
+		DepthBackProjection::detail::Rect rect;
+		int rows;
+		const DepthBackProjection::MaskRuns * mask;
+		const cv::Mat & color;
+		const DepthBackProjection::Roi * roi;
+	};
+
+	template <bool HasColor, typename Source>
+	void process(const Source & src, int width, const DepthBackProjection::detail::Rect & rect, const DepthBackProjection::MaskRuns * mask,
+			const cv::Mat & color, const DepthBackProjection::Roi * roi, Cloud & output) {
+		const int rows = DepthBackProjection::detail::tileRows(rect.u1 - rect.u0);
+		const int tiles = ThreadPool::chunks(rect.v0, rect.v1, rows);
+		if ((int) tiles_.size() < tiles)
+			tiles_.resize(tiles);
+		scratch_.resize(ThreadPool::instance().threads());
+		ThreadPool::parallelFor(0, tiles, 1, TileBody<HasColor, Source>(*this, src, width, rect, rows, mask, color, roi));
+
+		// Voxels (or points) of tiles in order.
+		Cloud & reduced = *reduced_;
+		reduced.points.clear();
+		converted_ = cropped_ = 0;
+		size_t expected = 0;
+		for (int t = 0; t < tiles; ++t)
+			expected += tiles_[t].first.size();
+		table_.clear(expected);
+		counts_.clear();
+		sums_.clear();
+		for (int t = 0; t < tiles; ++t) {
+			const Tile & tile = tiles_[t];
+			converted_ += tile.converted;
+			if (!voxelize_) {
+				cropped_ += tile.points.size();
+				reduced.points.insert(reduced.points.end(), tile.points.begin(), tile.points.end());
+				continue;
+			}
+			for (size_t v = 0; v < tile.first.size(); ++v) {
+				bool inserted;
+				const int g = table_.insert(&tile.keys[3 * v], inserted);
+				if (inserted) {
+					reduced.points.push_back(tile.first[v]);
+					counts_.push_back(0);
+					sums_.resize(sums_.size() + SUMS, 0.0);
+				}
+				counts_[g] += tile.counts[v];
+				cropped_ += tile.counts[v];
+				for (int k = 0; k < SUMS; ++k)
+					sums_[SUMS * g + k] += tile.sums[SUMS * v + k];
+			}
+		}
+		if (voxelize_ && policy_ == CENTROID)
+			for (size_t v = 0; v < reduced.points.size(); ++v)
+				setCentroid(reduced.points[v], &sums_[SUMS * v], counts_[v]);
+		voxels_ = reduced.points.size();
+		reduced.width = reduced.points.size();
+		reduced.height = 1;
+		reduced.is_dense = true;
+
+		if (mean_k_ > 0) {
+			IndexedCloud<PointT> indexed(reduced_);
+			StatisticalOutliers::analyze(indexed, mean_k_, std_mul_, negative_, outliers_);
+			pcl::copyPointCloud(reduced, outliers_.inliers, output);
+		} else {
+			outliers_.distances.clear();
+			// Metadata as copied by pcl::copyPointCloud on the filtering path.
+			output.header = reduced.header;
+			output.sensor_origin_ = reduced.sensor_origin_;
+			output.sensor_orientation_ = reduced.sensor_orientation_;
+			output.points.swap(reduced.points);
+			output.width = output.points.size();
+			output.height = 1;
+			output.is_dense = reduced.is_dense;
+		}
+	}
+
+	/// Adds the point to its voxel of the tile.
+	void add(Tile & tile, const PointT & p) const {
+		int64_t key[3];
+		VoxelHash::key(p.x, p.y, p.z, inverse_, key);
+		bool inserted;
+		const int v = tile.table.insert(key, inserted);
+		if (inserted) {
+			tile.keys.insert(tile.keys.end(), key, key + 3);
+			tile.first.push_back(p);
+			tile.counts.push_back(0);
+			tile.sums.resize(tile.sums.size() + SUMS, 0.0);
+		}
+		++tile.counts[v];
+		if (policy_ != CENTROID)
+			return;
+		double * sum = &tile.sums[SUMS * v];
+		sum[0] += p.x;
+		sum[1] += p.y;
+		sum[2] += p.z;
+		addColor(sum + 3, p);
+	}
+
+	/// Channels of the packed colour, averaged like in HashVoxelGrid.
+	static void addColor(double * sum, const pcl::PointXYZRGB & p) {
+		for (int c = 0; c < 4; ++c)
+			sum[c] += (p.rgba >> (8 * c)) & 0xff;
+	}
+
+	template <typename P>
+	static void addColor(double *, const P &) {}
+
+	static void setColor(pcl::PointXYZRGB & p, const double * sum, int count) {
+		uint32_t rgba = 0;
+		for (int c = 0; c < 4; ++c)
+			rgba |= ((uint32_t) (sum[c] / count)) << (8 * c);
+		p.rgba = rgba;
+	}
+
+	template <typename P>
+	static void setColor(P &, const double *, int) {}
+
+	static void setCentroid(PointT & p, const double * sum, int count) {
+		p.x = sum[0] / count;
+		p.y = sum[1] / count;
+		p.z = sum[2] / count;
+		setColor(p, sum + 3, count);
+	}
+
+	Policy policy_;
+	bool voxelize_;
+	double inverse_[3];
+	int mean_k_;
+	double std_mul_;
+	bool negative_;
+
+	size_t converted_, cropped_, voxels_;
+
+	/// Tiles of the last image and scratch rows of threads.
+	std::vector<Tile> tiles_;
+	std::vector<Points> scratch_;
+
+	/// Voxels of the whole image.
+	VoxelHash table_;
+	std::vector<int> counts_;
+	std::vector<double> sums_;
+
+	/// Points left by the voxel grid, shared with the search index of outlier removal.
+	typename Cloud::Ptr reduced_;
+	StatisticalOutliers::Result outliers_;
+};
+
+} //: namespace Types
+
+#endif /* FUSEDPREPROCESSING_HPP_ */
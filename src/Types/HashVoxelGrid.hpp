@@ -0,0 +1,235 @@
+/*!
+ * \file
+ * \brief Single-pass voxel grid downsampling with hashed voxel indices.
+ * \author Micha Laszkowski
+ */
+
+#ifndef HASHVOXELGRID_HPP_
+#define HASHVOXELGRID_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#include <pcl/point_cloud.h>
+#include <pcl/PCLPointField.h>
+#include <pcl/common/io.h>
+
+#include "Types/VoxelHash.hpp"
+
+namespace Types {
+
+/*!
+ * \class HashVoxelGrid
+ * \brief Voxel grid filter for any point type, without limits of extent.
+ *
+ * Integer coordinates of the voxel of every point (64-bit, so any leaf size
+ * fits any cloud) are looked up in an open-addressing hash table, which maps
+ * them to consecutive voxel numbers. Sums needed by the policy are gathered
+ * in the same pass, so no index array is sorted, unlike in pcl::VoxelGrid.
+ * Voxels are output in order of their first point.
+ *
+ * Policies:
+ * - CENTROID - average of the points of a voxel: float fields are averaged
+ *   (as in pcl::VoxelGrid), the packed colour per channel, other fields are
+ *   taken from the first point,
+ * - FIRST - first point of a voxel,
+ * - NEAREST - point of a voxel nearest to its centroid (needs a second pass
+ *   over the points); descriptors (e.g. of XYZSIFT, XYZSHOT) stay intact.
+ *
+ * Non-finite points are removed.
+ */
+template <typename PointT>
+class HashVoxelGrid {
+public:
+	typedef pcl::PointCloud<PointT> Cloud;
+
+	enum Policy { CENTROID, FIRST, NEAREST };
+
+	/// Parses policy name (centroid, first, nearest), returns false if unknown.
+	static bool parsePolicy(const std::string & name, Policy & policy) {
+		if (name == "centroid")
+			policy = CENTROID;
+		else if (name == "first")
+			policy = FIRST;
+		else if (name == "nearest")
+			policy = NEAREST;
+		else
+			return false;
+		return true;
+	}
+
+	HashVoxelGrid() : policy_(CENTROID), rgb_(-1) {
+		setLeafSize(0.01f, 0.01f, 0.01f);
+
+		// Float fields, averaged by CENTROID policy.
+		std::vector<pcl::PCLPointField> fields;
+		pcl::getFields<PointT>(fields);
+		for (size_t i = 0; i < fields.size(); ++i) {
+			if (fields[i].name == "rgb" || fields[i].name == "rgba") {
+				rgb_ = fields[i].offset;
+				continue;
+			}
+			if (fields[i].datatype != pcl::PCLPointField::FLOAT32)
+				continue;
+			for (size_t c = 0; c < fields[i].count; ++c)
+				floats_.push_back(fields[i].offset + c * sizeof(float));
+		}
+	}
+
+	void setLeafSize(float x, float y, float z) {
+		inverse_[0] = 1.0 / x;
+		inverse_[1] = 1.0 / y;
+		inverse_[2] = 1.0 / z;
+	}
+
+	void setPolicy(Policy policy) {
+		policy_ = policy;
+	}
+
+	/// Filters the input cloud, output must not be the input.
+	void filter(const Cloud & input, Cloud & output) {
+		const size_t n = input.size();
+		const size_t f = policy_ == CENTROID ? floats_.size() : 0;
+		const size_t stride = this->stride();
+
+		// Sized for the voxels of the last frame, the number of points would overestimate it many times.
+		table_.clear(table_.size());
+		voxel_of_.resize(n);
+		first_.clear();
+		count_.clear();
+		sums_.clear();
+		colors_.clear();
+
+		for (size_t i = 0; i < n; ++i) {
+			const PointT & p = input.points[i];
+			if (!finite(p)) {
+				voxel_of_[i] = -1;
+				continue;
+			}
+			const int v = voxel(p, i);
+			voxel_of_[i] = v;
+			++count_[v];
+			if (policy_ == FIRST)
+				continue;
+
+			// Centroid of xyz for NEAREST, all float fields for CENTROID.
+			double * sum = &sums_[v * stride];
+			if (policy_ == NEAREST) {
+				sum[0] += p.x;
+				sum[1] += p.y;
+				sum[2] += p.z;
+				continue;
+			}
+			const char * base = reinterpret_cast<const char *>(&p);
+			for (size_t k = 0; k < f; ++k) {
+				float value;
+				memcpy(&value, base + floats_[k], sizeof(float));
+				sum[k] += value;
+			}
+			if (rgb_ >= 0) {
+				uint32_t rgba;
+				memcpy(&rgba, base + rgb_, sizeof(rgba));
+				for (int c = 0; c < 4; ++c)
+					colors_[4 * v + c] += (rgba >> (8 * c)) & 0xff;
+			}
+		}
+
+		const size_t voxels = first_.size();
+		output.points.resize(voxels);
+		for (size_t v = 0; v < voxels; ++v)
+			output.points[v] = input.points[first_[v]];
+
+		if (policy_ == CENTROID) {
+			for (size_t v = 0; v < voxels; ++v) {
+				char * base = reinterpret_cast<char *>(&output.points[v]);
+				const double * sum = &sums_[v * stride];
+				for (size_t k = 0; k < f; ++k) {
+					const float value = sum[k] / count_[v];
+					memcpy(base + floats_[k], &value, sizeof(float));
+				}
+				if (rgb_ >= 0) {
+					uint32_t rgba = 0;
+					for (int c = 0; c < 4; ++c)
+						rgba |= ((uint32_t) (colors_[4 * v + c] / count_[v])) << (8 * c);
+					memcpy(base + rgb_, &rgba, sizeof(rgba));
+				}
+			}
+		} else if (policy_ == NEAREST) {
+			std::vector<double> best(voxels, std::numeric_limits<double>::max());
+			for (size_t i = 0; i < n; ++i) {
+				const int v = voxel_of_[i];
+				if (v < 0)
+					continue;
+				const PointT & p = input.points[i];
+				const double * sum = &sums_[v * stride];
+				const double dx = p.x - sum[0] / count_[v];
+				const double dy = p.y - sum[1] / count_[v];
+				const double dz = p.z - sum[2] / count_[v];
+				const double d = dx * dx + dy * dy + dz * dz;
+				if (d < best[v]) {
+					best[v] = d;
+					output.points[v] = p;
+				}
+			}
+		}
+
+		output.header = input.header;
+		output.sensor_origin_ = input.sensor_origin_;
+		output.sensor_orientation_ = input.sensor_orientation_;
+		output.width = voxels;
+		output.height = 1;
+		output.is_dense = true;
+	}
+
+private:
+	static bool finite(const PointT & p) {
+		return std::fabs(p.x) <= std::numeric_limits<float>::max() && std::fabs(p.y) <= std::numeric_limits<float>::max()
+				&& std::fabs(p.z) <= std::numeric_limits<float>::max();
+	}
+
+	/// Number of sums per voxel (x, y, z are the first float fields).
+	size_t stride() const {
+		return policy_ == CENTROID ? std::max<size_t>(floats_.size(), 3) : 3;
+	}
+
+	/// Number of the voxel of the point, new voxels are numbered in order of appearance.
+	int voxel(const PointT & p, size_t i) {
+		int64_t key[3];
+		VoxelHash::key(p.x, p.y, p.z, inverse_, key);
+		bool inserted;
+		const int v = table_.insert(key, inserted);
+		if (inserted) {
+			first_.push_back(i);
+			count_.push_back(0);
+			if (policy_ != FIRST)
+				sums_.resize(sums_.size() + stride(), 0.0);
+			if (policy_ == CENTROID && rgb_ >= 0)
+				colors_.resize(colors_.size() + 4, 0.0);
+		}
+		return v;
+	}
+
+	Policy policy_;
+	double inverse_[3];
+
+	/// Offsets of float fields and of the packed colour (-1 if none).
+	std::vector<size_t> floats_;
+	int rgb_;
+
+	/// Buffers reused between frames.
+	VoxelHash table_;
+	std::vector<int> voxel_of_;
+	std::vector<size_t> first_;
+	std::vector<size_t> count_;
+	std::vector<double> sums_;
+	std::vector<double> colors_;
+};
+
+} //: namespace Types
+
+#endif /* HASHVOXELGRID_HPP_ */
@@ -0,0 +1,148 @@
+/*!
+ * \file
+ * \brief Point cloud carrying lazily built search structure.
+ * \author Micha Laszkowski
+ */
+
+#ifndef INDEXEDCLOUD_HPP_
+#define INDEXEDCLOUD_HPP_
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/search/search.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/search/organized.h>
+
+namespace Types {
+
+/*!
+ * \class IndexedCloud
+ * \brief Cloud together with search index, shared between components.
+ *
+ * Index is built on first request (kd-tree, or OrganizedNeighbor for
+ * organized clouds) and then reused by every component that gets the same
+ * IndexedCloud within the frame, so it is built at most once. Getting the
+ * cloud for modification through mutableCloud() drops the index; changes
+ * of cloud size or storage made behind its back are detected as well.
+ */
+template <typename PointT>
+class IndexedCloud {
+public:
+	typedef boost::shared_ptr<IndexedCloud<PointT> > Ptr;
+	typedef boost::shared_ptr<const IndexedCloud<PointT> > ConstPtr;
+
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::Ptr CloudPtr;
+	typedef typename Cloud::ConstPtr CloudConstPtr;
+
+	typedef pcl::search::Search<PointT> Search;
+	typedef typename Search::Ptr SearchPtr;
+
+	explicit IndexedCloud(const CloudPtr & cloud = CloudPtr(), bool use_organized = true) :
+		cloud_(cloud), use_organized_(use_organized), builds_(0) {
+	}
+
+	/// Wraps cloud into new indexed cloud.
+	static Ptr create(const CloudPtr & cloud, bool use_organized = true) {
+		return Ptr(new IndexedCloud<PointT>(cloud, use_organized));
+	}
+
+	/// Read-only access to the cloud, keeps the index.
+	CloudConstPtr cloud() const {
+		return cloud_;
+	}
+
+	/// Access to the cloud for modification, drops the index.
+	CloudPtr mutableCloud() {
+		invalidate();
+		return cloud_;
+	}
+
+	/// Replaces the cloud, drops the index.
+	void setCloud(const CloudPtr & cloud) {
+		boost::mutex::scoped_lock lock(mutex_);
+		cloud_ = cloud;
+		search_.reset();
+	}
+
+	/// Drops the index, it will be rebuilt on next request.
+	void invalidate() {
+		boost::mutex::scoped_lock lock(mutex_);
+		search_.reset();
+	}
+
+	/// Returns search structure over the cloud, building it if needed.
+	SearchPtr search() const {
+		boost::mutex::scoped_lock lock(mutex_);
+		if (search_ && (!cloud_ || fingerprint_ != Fingerprint(*cloud_)))
+			search_.reset();
+
+		if (!search_ && cloud_) {
+			if (use_organized_ && cloud_->isOrganized())
+				search_.reset(new pcl::search::OrganizedNeighbor<PointT>);
+			else
+				search_.reset(new pcl::search::KdTree<PointT>);
+			search_->setInputCloud(cloud_);
+			fingerprint_ = Fingerprint(*cloud_);
+			++builds_;
+		}
+		return search_;
+	}
+
+	/// True if index is already built and up to date.
+	bool indexed() const {
+		boost::mutex::scoped_lock lock(mutex_);
+		return search_ && cloud_ && fingerprint_ == Fingerprint(*cloud_);
+	}
+
+	/// Number of times the index was built.
+	size_t builds() const {
+		return builds_;
+	}
+
+	size_t size() const {
+		return cloud_ ? cloud_->size() : 0;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+private:
+	/// Cheap identity of the cloud contents used to detect mutations.
+	struct Fingerprint {
+		Fingerprint() : data(NULL), size(0), width(0), height(0) {}
+
+		explicit Fingerprint(const Cloud & cloud) :
+			data(cloud.points.empty() ? NULL : &cloud.points[0]), size(cloud.points.size()), width(cloud.width), height(cloud.height) {}
+
+		bool operator==(const Fingerprint & o) const {
+			return data == o.data && size == o.size && width == o.width && height == o.height;
+		}
+
+		bool operator!=(const Fingerprint & o) const {
+			return !(*this == o);
+		}
+
+		const PointT * data;
+		size_t size;
+		uint32_t width, height;
+	};
+
+	IndexedCloud(const IndexedCloud &);
+	IndexedCloud & operator=(const IndexedCloud &);
+
+	CloudPtr cloud_;
+	bool use_organized_;
+
+	mutable boost::mutex mutex_;
+	mutable SearchPtr search_;
+	mutable Fingerprint fingerprint_;
+	mutable size_t builds_;
+};
+
+} //: namespace Types
+
+#endif /* INDEXEDCLOUD_HPP_ */
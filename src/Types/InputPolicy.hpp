@@ -0,0 +1,216 @@
+/*!
+ * \file
+ * \brief Dropping of stale frames of component inputs, with statistics of frames lost on the way.
+ * \author Micha Laszkowski
+ */
+
+#ifndef INPUTPOLICY_HPP_
+#define INPUTPOLICY_HPP_
+
+#include <deque>
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <stdint.h>
+
+#include "Common/Logger.hpp"
+
+#include "Types/HandlerProfiler.hpp"
+#include "Types/CaptureTime.hpp"
+
+namespace Types {
+
+/*!
+ * \class InputPolicy
+ * \brief Chooses frames of an input stream a handler processes.
+ *
+ * Handler reads its input through read(), which applies one of the policies:
+ * - newest (the default): all waiting frames but the newest are dropped, so
+ *   the handler gets the frames a Newest buffer would keep;
+ * - queue: frames are processed in order of arrival; with a bound, frames
+ *   waiting in the stream are taken at once and the oldest beyond the
+ *   bound are dropped (the rest wait in the policy, taken with the next
+ *   frames), without one (bound 0) every frame is processed and a slow
+ *   handler builds an unlimited backlog;
+ * - deadline: frames captured more than deadline ms ago are dropped, the
+ *   first fresh one is processed (frames without stamps never expire).
+ *
+ * Streams read through a policy must be declared with
+ * Base::DataStreamBuffer::Queue: a Newest buffer keeps only the latest frame,
+ * so there would be no backlog for the policy to trim (nor dropped frames to
+ * count).
+ *
+ * Every input counts processed and dropped frames and the age of processed
+ * frames since capture (header.stamp) - the time spent in queues and
+ * upstream stages, so ages of consecutive stages show where frames wait.
+ * Statistics are logged every period processed frames when enabled, like
+ * those of HandlerProfiler.
+ *
+ * Usage:
+ * \code
+ * Base::DataStreamIn<pcl::PointCloud<pcl::PointXYZ>::Ptr, Base::DataStreamBuffer::Queue> in_cloud_xyz; // member
+ * input_xyz.configure(input_policy, input_queue, input_deadline); // in onInit()
+ * ...
+ * pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+ * if (!input_xyz.read(in_cloud_xyz, cloud))
+ *     return;
+ * \endcode
+ */
+template <typename T>
+class InputPolicy {
+public:
+	enum Mode { QUEUE, NEWEST, DEADLINE };
+
+	explicit InputPolicy(const std::string & name) :
+		name_(name), mode_(NEWEST), bound_(0), deadline_(0), enabled_(false), period_(0), processed_(0), dropped_(0), stale_(0), age_(name) {
+	}
+
+	/// Mode of the name (queue, newest or deadline). Returns false for an unknown one.
+	static bool parse(const std::string & name, Mode & mode) {
+		if (name == "queue")
+			mode = QUEUE;
+		else if (name == "newest")
+			mode = NEWEST;
+		else if (name == "deadline")
+			mode = DEADLINE;
+		else
+			return false;
+		return true;
+	}
+
+	/*!
+	 * Sets the policy, bound of the queue (0 - unbounded) and deadline in ms.
+	 * \returns false if the mode is unknown, newest is used then
+	 */
+	bool configure(const std::string & mode, int bound, float deadline) {
+		bound_ = std::max(bound, 0);
+		deadline_ = (uint64_t) std::max(deadline * 1e3f, 0.0f);
+		if (parse(mode, mode_))
+			return true;
+		mode_ = NEWEST;
+		return false;
+	}
+
+	/// Enables logging of statistics every period processed frames (never if period <= 0).
+	void setReporting(bool enabled, int period) {
+		enabled_ = enabled;
+		period_ = std::max(period, 0);
+	}
+
+	/*!
+	 * Takes the next frame to process from the stream.
+	 * \returns false if all waiting frames were dropped
+	 */
+	template <typename Stream>
+	bool read(Stream & in, T & value) {
+		const uint64_t now = CaptureTime::now();
+		switch (mode_) {
+		case NEWEST:
+			pending_.clear();
+			if (in.empty())
+				return false;
+			value = in.read();
+			while (!in.empty()) {
+				value = in.read();
+				++dropped_;
+			}
+			break;
+		case DEADLINE:
+			for (;;) {
+				if (in.empty())
+					return false;
+				value = in.read();
+				if (!expired(value, now))
+					break;
+				++dropped_;
+				++stale_;
+			}
+			break;
+		default:
+			if (bound_ == 0) {
+				if (in.empty())
+					return false;
+				value = in.read();
+				break;
+			}
+			while (!in.empty())
+				pending_.push_back(in.read());
+			while (pending_.size() > (size_t) bound_) {
+				pending_.pop_front();
+				++dropped_;
+			}
+			if (pending_.empty())
+				return false;
+			value = pending_.front();
+			pending_.pop_front();
+			break;
+		}
+		processed(value, now);
+		return true;
+	}
+
+	/// Drops frames waiting in the policy (e.g. when the component stops).
+	void clear() {
+		dropped_ += pending_.size();
+		pending_.clear();
+	}
+
+	size_t processed() const { return processed_; }
+	size_t dropped() const { return dropped_; }
+
+	/// Frames waiting in the policy, only with a bounded queue.
+	size_t pending() const { return pending_.size(); }
+
+	/// One line summary of the input.
+	std::string summary() const {
+		std::ostringstream os;
+		os.precision(3);
+		os << name_ << ": " << processed_ << " processed, " << dropped_ << " dropped";
+		if (stale_)
+			os << " (" << stale_ << " past deadline)";
+		if (age_.calls)
+			os << ", age since capture mean " << 1e3 * age_.seconds / age_.calls << " ms, p99 " << 1e3 * age_.percentile(0.99)
+					<< " ms, max " << 1e3 * age_.max << " ms";
+		return os.str();
+	}
+
+	/// Logs statistics if enabled and the input got any frames.
+	void report() const {
+		if (enabled_ && processed_ + dropped_ > 0)
+			LOG(LINFO) << summary();
+	}
+
+private:
+	bool expired(const T & value, uint64_t now) const {
+		const uint64_t stamp = CaptureTime::of(value);
+		return stamp != 0 && now > stamp && now - stamp > deadline_;
+	}
+
+	void processed(const T & value, uint64_t now) {
+		++processed_;
+		const uint64_t stamp = CaptureTime::of(value);
+		if (stamp != 0)
+			age_.add(now > stamp ? (now - stamp) * 1e-6 : 0);
+		if (enabled_ && period_ && processed_ % period_ == 0)
+			LOG(LINFO) << summary();
+	}
+
+	std::string name_;
+	Mode mode_;
+	int bound_;
+	uint64_t deadline_;
+
+	bool enabled_;
+	size_t period_;
+
+	size_t processed_, dropped_, stale_;
+
+	/// Ages of processed frames, in seconds.
+	HandlerStats age_;
+
+	std::deque<T> pending_;
+};
+
+} //: namespace Types
+
+#endif /* INPUTPOLICY_HPP_ */
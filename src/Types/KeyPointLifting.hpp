@@ -0,0 +1,171 @@
+/*!
+ * \file
+ * \brief Lifting of image keypoints to 3D points in batches.
+ * \author Michal Laszkowski
+ */
+
+#ifndef KEYPOINTLIFTING_HPP_
+#define KEYPOINTLIFTING_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <stdint.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/DepthBackProjection.hpp"
+
+namespace Types {
+namespace KeyPointLifting {
+
+/// Largest radius of the median window, (2 * MAX_RADIUS + 1)^2 depths are sorted at most.
+const int MAX_RADIUS = 3;
+
+namespace detail {
+
+/// True for valid raw depths (zero is missing).
+template <typename T>
+inline bool validDepth(T d) {
+	return d > 0 && d <= FLT_MAX;
+}
+
+/*!
+ * Depth at pixel (u, v) or, with radius > 0, median of valid depths of the
+ * window around it. Returns 0 if there is none.
+ */
+template <typename T>
+inline float sampleDepth(const cv::Mat & depth, int u, int v, int radius) {
+	if (radius <= 0)
+		return depth.ptr<T>(v)[u];
+
+	T window[(2 * MAX_RADIUS + 1) * (2 * MAX_RADIUS + 1)];
+	int n = 0;
+	const int u0 = std::max(0, u - radius), u1 = std::min(depth.cols - 1, u + radius);
+	const int v0 = std::max(0, v - radius), v1 = std::min(depth.rows - 1, v + radius);
+	for (int y = v0; y <= v1; ++y) {
+		const T * row = depth.ptr<T>(y);
+		for (int x = u0; x <= u1; ++x)
+			if (validDepth(row[x]))
+				window[n++] = row[x];
+	}
+	if (n == 0)
+		return 0;
+	std::nth_element(window, window + n / 2, window + n);
+	return window[n / 2];
+}
+
+/// Pixel of the keypoint, false if it lies outside of the image.
+inline bool pixel(const cv::KeyPoint & keypoint, int width, int height, int & u, int & v) {
+	u = (int) std::floor(keypoint.pt.x + 0.5f);
+	v = (int) std::floor(keypoint.pt.y + 0.5f);
+	return u >= 0 && v >= 0 && u < width && v < height;
+}
+
+template <typename T, typename PointT>
+size_t liftDepth(const cv::Mat & depth, const DepthBackProjection::RayTable & rays, const std::vector<cv::KeyPoint> & keypoints,
+		int radius, PointT * out, int * indices) {
+	const float scale = rays.depthScale();
+	size_t n = 0;
+	for (size_t i = 0; i < keypoints.size(); ++i) {
+		int u, v;
+		if (!pixel(keypoints[i], depth.cols, depth.rows, u, v))
+			continue;
+		const float d = sampleDepth<T>(depth, u, v, radius);
+		if (!validDepth(d))
+			continue;
+
+		float rx, ry;
+		rays.ray(keypoints[i].pt.x, keypoints[i].pt.y, rx, ry);
+		PointT & p = out[n];
+		p.z = d * scale;
+		p.x = rx * p.z;
+		p.y = ry * p.z;
+		indices[n++] = i;
+	}
+	return n;
+}
+
+} //: namespace detail
+
+/*!
+ * Lifts keypoints of the image with the depth map (CV_16U or CV_32F, raw
+ * units of the ray table) into points of the cloud, in one pass over a
+ * preallocated cloud. Rays come from the ray table of the depth camera,
+ * interpolated at sub-pixel positions of keypoints. With radius > 0 depth is
+ * the median of valid depths of the (2 * radius + 1)^2 window around the
+ * keypoint, which keeps keypoints on depth edges and holes. Keypoints
+ * without depth are dropped, keypoint_indices gets the keypoint of every point.
+ */
+template <typename PointT>
+void liftDepth(const cv::Mat & depth, const DepthBackProjection::RayTable & rays, const std::vector<cv::KeyPoint> & keypoints,
+		int radius, pcl::PointCloud<PointT> & cloud, std::vector<int> & keypoint_indices) {
+	radius = std::min(radius, MAX_RADIUS);
+	cloud.points.resize(keypoints.size());
+	keypoint_indices.resize(keypoints.size());
+	size_t n = 0;
+	if (!keypoints.empty()) {
+		if (depth.depth() == CV_16U)
+			n = detail::liftDepth<uint16_t>(depth, rays, keypoints, radius, &cloud.points[0], &keypoint_indices[0]);
+		else
+			n = detail::liftDepth<float>(depth, rays, keypoints, radius, &cloud.points[0], &keypoint_indices[0]);
+	}
+	cloud.points.resize(n);
+	cloud.width = n;
+	cloud.height = 1;
+	cloud.is_dense = true;
+	keypoint_indices.resize(n);
+}
+
+/*!
+ * Lifts keypoints with the CV_32FC3 image of Cartesian coordinates, as
+ * liftDepth. With radius > 0 the point of the window with median z is taken.
+ */
+template <typename PointT>
+void liftXYZ(const cv::Mat & xyz, const std::vector<cv::KeyPoint> & keypoints, int radius, pcl::PointCloud<PointT> & cloud,
+		std::vector<int> & keypoint_indices) {
+	radius = std::min(radius, MAX_RADIUS);
+	cloud.points.resize(keypoints.size());
+	keypoint_indices.resize(keypoints.size());
+	const float max_z = DepthBackProjection::XYZ_MAX_Z;
+	size_t n = 0;
+	for (size_t k = 0; k < keypoints.size(); ++k) {
+		int u, v;
+		if (!detail::pixel(keypoints[k], xyz.cols, xyz.rows, u, v))
+			continue;
+
+		// Valid points of the window, ordered by z.
+		std::pair<float, const float *> window[(2 * MAX_RADIUS + 1) * (2 * MAX_RADIUS + 1)];
+		int count = 0;
+		for (int y = std::max(0, v - radius); y <= std::min(xyz.rows - 1, v + radius); ++y)
+			for (int x = std::max(0, u - radius); x <= std::min(xyz.cols - 1, u + radius); ++x) {
+				const float * p = xyz.ptr<float>(y) + 3 * x;
+				if (!(std::fabs(p[2] - max_z) < FLT_EPSILON || std::fabs(p[2]) > max_z))
+					window[count++] = std::make_pair(p[2], p);
+			}
+		if (count == 0)
+			continue;
+		std::nth_element(window, window + count / 2, window + count);
+
+		const float * p = window[count / 2].second;
+		PointT & point = cloud.points[n];
+		point.x = p[0];
+		point.y = p[1];
+		point.z = p[2];
+		keypoint_indices[n++] = k;
+	}
+	cloud.points.resize(n);
+	cloud.width = n;
+	cloud.height = 1;
+	cloud.is_dense = true;
+	keypoint_indices.resize(n);
+}
+
+} //: namespace KeyPointLifting
+} //: namespace Types
+
+#endif /* KEYPOINTLIFTING_HPP_ */
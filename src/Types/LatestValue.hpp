@@ -0,0 +1,84 @@
+/*!
+ * \file
+ * \brief Lock-free mailbox holding the newest value passed between two threads.
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef LATESTVALUE_HPP_
+#define LATESTVALUE_HPP_
+
+#include <boost/atomic.hpp>
+
+namespace Types {
+
+/*!
+ * \class LatestValue
+ * \brief Triple buffer for one writer thread and one reader thread.
+ *
+ * The writer fills its own slot and swaps it with the middle one, the reader
+ * swaps its own slot with the middle one when the middle holds a value it
+ * has not taken yet. Only the index of the middle slot is shared, so neither
+ * side ever waits for the other; values written faster than they are taken
+ * are overwritten, the reader always gets the newest one.
+ *
+ * Usage:
+ * \code
+ * // Processing thread.
+ * mailbox.write(cloud);
+ * // Rendering thread.
+ * if (mailbox.fresh())
+ *     display(mailbox.take());
+ * \endcode
+ */
+template <typename T>
+class LatestValue {
+public:
+	LatestValue() : back_(0), front_(1), middle_(2) {}
+
+	/// Publishes the value, called by the writer thread only.
+	void write(const T & value) {
+		slots_[back_] = value;
+		back_ = middle_.exchange(back_ | FRESH, boost::memory_order_acq_rel) & INDEX;
+	}
+
+	/// Checks whether there is a value not taken yet.
+	bool fresh() const {
+		return (middle_.load(boost::memory_order_acquire) & FRESH) != 0;
+	}
+
+	/// Takes the newest value, called by the reader thread only. Returns false if nothing new was written.
+	bool take(T & value) {
+		if (!fresh())
+			return false;
+		front_ = middle_.exchange(front_, boost::memory_order_acq_rel) & INDEX;
+		value = slots_[front_];
+		// Do not keep the data (e.g. pooled clouds) alive in the mailbox.
+		slots_[front_] = T();
+		return true;
+	}
+
+	/// Takes the newest value, default constructed one if nothing new was written.
+	T take() {
+		T value = T();
+		take(value);
+		return value;
+	}
+
+private:
+	enum { INDEX = 3, FRESH = 4 };
+
+	T slots_[3];
+
+	/// Slot of the writer.
+	int back_;
+
+	/// Slot of the reader.
+	int front_;
+
+	/// Slot being exchanged, with flag set if it holds a value not taken yet.
+	boost::atomic<int> middle_;
+};
+
+} //: namespace Types
+
+#endif /* LATESTVALUE_HPP_ */
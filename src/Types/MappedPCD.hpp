@@ -0,0 +1,409 @@
+/*!
+ * \file
+ * \brief Memory-mapped reading of binary PCD files.
+ * \author Micha Laszkowski
+ */
+
+#ifndef MAPPEDPCD_HPP_
+#define MAPPEDPCD_HPP_
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <pcl/point_cloud.h>
+#include <pcl/PCLPointField.h>
+#include <pcl/common/io.h>
+#include <pcl/io/pcd_io.h>
+
+#include "Types/ThreadPool.hpp"
+
+namespace Types {
+
+/*!
+ * \class MappedPCD
+ * \brief PCD file mapped into memory, read without intermediate buffers.
+ *
+ * Only the header is parsed on open(); the point records of binary files
+ * stay in the page cache and are accessed in place. When the records are
+ * bit-identical to a point type (same size, field offsets and types, and
+ * suitably aligned data) view() exposes them directly as points, without
+ * any copy. Otherwise read() gathers the fields with one memcpy per run of
+ * adjacent fields per point, instead of PCL's field-by-field conversion
+ * through PCLPointCloud2. ASCII and compressed files, or files whose fields
+ * do not convert bit-exactly, are read with pcl::io::loadPCDFile by load().
+ */
+class MappedPCD {
+public:
+	typedef boost::shared_ptr<MappedPCD> Ptr;
+
+	/// Mapped file, unmapped when the last reference is gone.
+	typedef boost::shared_ptr<const uint8_t> Mapping;
+
+	/// Field of the file record.
+	struct Field {
+		std::string name;
+		int datatype;
+		int count;
+		size_t offset;
+	};
+
+	MappedPCD() : base_(NULL), length_(0), data_offset_(0), width_(0), height_(0), points_(0), point_step_(0), binary_(false) {}
+
+	/// Maps the file and parses its header. False if it is not a readable PCD file.
+	bool open(const std::string & file) {
+		close();
+		size_t length;
+		Mapping mapping = map(file, length);
+		return mapping && open(mapping, 0, length, file);
+	}
+
+	/*!
+	 * Parses PCD stored at offset of an existing mapping (e.g. a frame of
+	 * a container), which is kept alive by this object.
+	 */
+	bool open(const Mapping & mapping, size_t offset, size_t length, const std::string & name) {
+		close();
+		mapping_ = mapping;
+		base_ = mapping.get() + offset;
+		length_ = length;
+		file_ = name;
+		if (!parseHeader()) {
+			close();
+			return false;
+		}
+		if (binary_)
+			madvise(const_cast<uint8_t *>(pageStart(base_)), length_ + (base_ - pageStart(base_)), MADV_SEQUENTIAL);
+		return true;
+	}
+
+	void close() {
+		mapping_.reset();
+		base_ = NULL;
+		length_ = 0;
+		fields_.clear();
+		binary_ = false;
+	}
+
+	/// Maps whole file read-only, empty pointer if it cannot be mapped.
+	static Mapping map(const std::string & file, size_t & length) {
+		length = 0;
+		int fd = ::open(file.c_str(), O_RDONLY);
+		if (fd < 0)
+			return Mapping();
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			return Mapping();
+		}
+		void * base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (base == MAP_FAILED)
+			return Mapping();
+		length = st.st_size;
+		return Mapping(static_cast<const uint8_t *>(base), Unmap(length));
+	}
+
+	bool isOpen() const { return base_ != NULL; }
+
+	/// True for uncompressed binary data, the only one accessed in place.
+	bool binary() const { return binary_; }
+
+	const std::string & file() const { return file_; }
+	const std::vector<Field> & fields() const { return fields_; }
+	uint32_t width() const { return width_; }
+	uint32_t height() const { return height_; }
+	size_t size() const { return points_; }
+	size_t pointStep() const { return point_step_; }
+
+	/// First point record of binary data.
+	const uint8_t * data() const { return base_ + data_offset_; }
+
+	/*!
+	 * Number of PointT fields stored in the file with the same type,
+	 * -1 if any of them has a different type. Used to choose between frames.
+	 */
+	template <typename PointT>
+	int matchingFields() const {
+		std::vector<pcl::PCLPointField> target;
+		pcl::getFields<PointT>(target);
+		int n = 0;
+		for (size_t i = 0; i < target.size(); ++i) {
+			const Field * f = find(target[i].name);
+			if (!f)
+				continue;
+			if (f->datatype != target[i].datatype || f->count != (int) target[i].count)
+				return -1;
+			++n;
+		}
+		return n;
+	}
+
+	/// True if records are bit-identical to PointT and can be used in place.
+	template <typename PointT>
+	bool exactLayout() const {
+		if (!binary_ || point_step_ != sizeof(PointT) || reinterpret_cast<uintptr_t>(data()) % 16 != 0)
+			return false;
+		std::vector<pcl::PCLPointField> target;
+		pcl::getFields<PointT>(target);
+		for (size_t i = 0; i < target.size(); ++i) {
+			const Field * f = find(target[i].name);
+			if (!f || f->offset != target[i].offset || f->datatype != target[i].datatype || f->count != (int) target[i].count)
+				return false;
+		}
+		return true;
+	}
+
+	/// Points of the file in place, NULL if layout differs. Valid while the file is mapped.
+	template <typename PointT>
+	const PointT * view() const {
+		return exactLayout<PointT>() ? reinterpret_cast<const PointT *>(data()) : NULL;
+	}
+
+	/*!
+	 * Reads binary data into the cloud, copying runs of fields present both in
+	 * the file and in PointT. False if data is not binary or a field has
+	 * a different type than in PointT (then the conversion path is needed).
+	 */
+	template <typename PointT>
+	bool read(pcl::PointCloud<PointT> & cloud) const {
+		if (!binary_)
+			return false;
+
+		std::vector<pcl::PCLPointField> target;
+		pcl::getFields<PointT>(target);
+
+		// Runs of bytes copied from each record.
+		std::vector<Run> runs;
+		for (size_t i = 0; i < target.size(); ++i) {
+			const Field * f = find(target[i].name);
+			if (!f)
+				continue;
+			if (f->datatype != target[i].datatype || f->count != (int) target[i].count)
+				return false;
+			Run r;
+			r.src = f->offset;
+			r.dst = target[i].offset;
+			r.bytes = f->count * pcl::getFieldSize(f->datatype);
+			if (!runs.empty() && runs.back().src + runs.back().bytes == r.src && runs.back().dst + runs.back().bytes == r.dst)
+				runs.back().bytes += r.bytes;
+			else
+				runs.push_back(r);
+		}
+		if (runs.empty())
+			return false;
+
+		cloud.points.resize(points_);
+		cloud.width = width_;
+		cloud.height = height_;
+		cloud.sensor_origin_ = origin_;
+		cloud.sensor_orientation_ = orientation_;
+
+		const int n = points_;
+		const uint8_t * src = data();
+		uint8_t * dst = n ? reinterpret_cast<uint8_t *>(&cloud.points[0]) : NULL;
+		bool dense = true;
+		if (runs.size() == 1 && runs[0].bytes == point_step_ && point_step_ == sizeof(PointT)) {
+			// Same record, one copy of everything.
+			memcpy(dst, src, n * sizeof(PointT));
+		} else {
+			ThreadPool::parallelFor(0, n, 65536, Copy(runs, src, point_step_, dst, sizeof(PointT)));
+		}
+		for (int i = 0; i < n && dense; ++i)
+			dense = pcl_isfinite(cloud.points[i].x) && pcl_isfinite(cloud.points[i].y) && pcl_isfinite(cloud.points[i].z);
+		cloud.is_dense = dense;
+		return true;
+	}
+
+	/*!
+	 * Reads cloud from the file, mapped if possible, otherwise with PCL.
+	 * Given mapping may be reused for several point types of the same file.
+	 * \returns false if the file cannot be read.
+	 */
+	template <typename PointT>
+	static bool load(const Ptr & mapped, const std::string & file, pcl::PointCloud<PointT> & cloud) {
+		if (mapped && (mapped->isOpen() || mapped->open(file)) && mapped->file() == file && mapped->read(cloud))
+			return true;
+		return pcl::io::loadPCDFile<PointT>(file, cloud) != -1;
+	}
+
+private:
+	struct Run {
+		size_t src, dst, bytes;
+	};
+
+	/// Copies runs of records [begin, end) into points.
+	struct Copy {
+		Copy(const std::vector<Run> & runs, const uint8_t * src, size_t src_step, uint8_t * dst, size_t dst_step) :
+			runs(runs), src(src), src_step(src_step), dst(dst), dst_step(dst_step) {
+		}
+		void operator()(int begin, int end, int) const {
+			for (int i = begin; i < end; ++i)
+				for (size_t r = 0; r < runs.size(); ++r)
+					memcpy(dst + i * dst_step + runs[r].dst, src + i * src_step + runs[r].src, runs[r].bytes);
+		}
+		const std::vector<Run> & runs;
+		const uint8_t * src;
+		size_t src_step;
+		uint8_t * dst;
+		size_t dst_step;
+	};
+
+	struct Unmap {
+		explicit Unmap(size_t length) : length(length) {}
+		void operator()(const uint8_t * p) const {
+			munmap(const_cast<uint8_t *>(p), length);
+		}
+		size_t length;
+	};
+
+	static const uint8_t * pageStart(const uint8_t * p) {
+		const uintptr_t page = sysconf(_SC_PAGESIZE);
+		return reinterpret_cast<const uint8_t *>(reinterpret_cast<uintptr_t>(p) / page * page);
+	}
+
+	const Field * find(const std::string & name) const {
+		for (size_t i = 0; i < fields_.size(); ++i)
+			if (fields_[i].name == name)
+				return &fields_[i];
+		// PCL stores colour as rgb or rgba interchangeably.
+		if (name == "rgba")
+			return find("rgb");
+		if (name == "rgb")
+			for (size_t i = 0; i < fields_.size(); ++i)
+				if (fields_[i].name == "rgba")
+					return &fields_[i];
+		return NULL;
+	}
+
+	static int datatype(char type, int size) {
+		switch (type) {
+		case 'I': return size == 1 ? pcl::PCLPointField::INT8 : size == 2 ? pcl::PCLPointField::INT16 : size == 4 ? pcl::PCLPointField::INT32 : -1;
+		case 'U': return size == 1 ? pcl::PCLPointField::UINT8 : size == 2 ? pcl::PCLPointField::UINT16 : size == 4 ? pcl::PCLPointField::UINT32 : -1;
+		case 'F': return size == 4 ? pcl::PCLPointField::FLOAT32 : size == 8 ? pcl::PCLPointField::FLOAT64 : -1;
+		default: return -1;
+		}
+	}
+
+	/// Parses header lines up to and including DATA.
+	bool parseHeader() {
+		std::vector<std::string> names;
+		std::vector<int> sizes, counts;
+		std::vector<char> types;
+		origin_ = Eigen::Vector4f::Zero();
+		orientation_ = Eigen::Quaternionf::Identity();
+		points_ = 0;
+		width_ = height_ = 0;
+		bool has_points = false;
+
+		size_t pos = 0;
+		while (pos < length_) {
+			const uint8_t * nl = static_cast<const uint8_t *>(memchr(base_ + pos, '\n', length_ - pos));
+			const size_t end = nl ? nl - base_ : length_;
+			std::istringstream line(std::string(reinterpret_cast<const char *>(base_ + pos), end - pos));
+			pos = end + 1;
+
+			std::string key;
+			if (!(line >> key) || key[0] == '#')
+				continue;
+
+			if (key == "FIELDS") {
+				std::string s;
+				while (line >> s) names.push_back(s);
+			} else if (key == "SIZE") {
+				int s;
+				while (line >> s) sizes.push_back(s);
+			} else if (key == "TYPE") {
+				char t;
+				while (line >> t) types.push_back(t);
+			} else if (key == "COUNT") {
+				int c;
+				while (line >> c) counts.push_back(c);
+			} else if (key == "WIDTH") {
+				line >> width_;
+			} else if (key == "HEIGHT") {
+				line >> height_;
+			} else if (key == "POINTS") {
+				line >> points_;
+				has_points = true;
+			} else if (key == "VIEWPOINT") {
+				float v[7];
+				for (int i = 0; i < 7 && line >> v[i]; ++i) {}
+				origin_ = Eigen::Vector4f(v[0], v[1], v[2], 0);
+				orientation_ = Eigen::Quaternionf(v[3], v[4], v[5], v[6]);
+			} else if (key == "DATA") {
+				std::string format;
+				line >> format;
+				binary_ = format == "binary";
+				data_offset_ = pos;
+				break;
+			}
+		}
+
+		if (names.empty() || sizes.size() != names.size() || types.size() != names.size())
+			return false;
+		if (counts.empty())
+			counts.assign(names.size(), 1);
+		if (counts.size() != names.size())
+			return false;
+		if (!has_points)
+			points_ = (size_t) width_ * height_;
+		// Records that do not fill width x height are read as an unorganized cloud.
+		if ((size_t) width_ * height_ != points_) {
+			width_ = points_;
+			height_ = 1;
+		}
+
+		point_step_ = 0;
+		for (size_t i = 0; i < names.size(); ++i) {
+			Field f;
+			f.name = names[i];
+			f.datatype = datatype(types[i], sizes[i]);
+			f.count = counts[i];
+			f.offset = point_step_;
+			point_step_ += sizes[i] * counts[i];
+			// Padding fields of PCL are written as "_".
+			if (f.name != "_")
+				fields_.push_back(f);
+		}
+
+		// Binary data must be complete to be read in place.
+		if (binary_ && data_offset_ + points_ * point_step_ > length_)
+			binary_ = false;
+		return true;
+	}
+
+	Mapping mapping_;
+	const uint8_t * base_;
+	size_t length_;
+	size_t data_offset_;
+	std::string file_;
+
+	std::vector<Field> fields_;
+	uint32_t width_, height_;
+	size_t points_;
+	size_t point_step_;
+	bool binary_;
+
+	Eigen::Vector4f origin_;
+	Eigen::Quaternionf orientation_;
+
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} //: namespace Types
+
+#endif /* MAPPEDPCD_HPP_ */
@@ -0,0 +1,154 @@
+/*!
+ * \file
+ * \brief Euclidean clustering of organized clouds in image space.
+ * \author Micha Laszkowski
+ */
+
+#ifndef ORGANIZEDCLUSTERING_HPP_
+#define ORGANIZEDCLUSTERING_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <climits>
+
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+
+namespace Types {
+
+/*!
+ * \class OrganizedClustering
+ * \brief Connected components of an organized cloud, found with union-find.
+ *
+ * Two points belong to the same cluster if they are connected by a chain of
+ * 4-neighbouring pixels, each pair closer than the tolerance. Non-finite
+ * points are skipped. Only neighbouring pixels are compared, so no search
+ * structure is needed and the whole pass is linear in the number of pixels.
+ * Output has the same form as pcl::EuclideanClusterExtraction: clusters of
+ * accepted size, sorted by decreasing size, indices sorted within cluster.
+ */
+class OrganizedClustering {
+public:
+	OrganizedClustering(float tolerance = 0.02, int min_size = 1, int max_size = INT_MAX) :
+		tolerance_(tolerance), min_size_(min_size), max_size_(max_size) {}
+
+	void setClusterTolerance(float tolerance) { tolerance_ = tolerance; }
+	void setMinClusterSize(int size) { min_size_ = size; }
+	void setMaxClusterSize(int size) { max_size_ = size; }
+
+	/// True if the cloud can be clustered in image space.
+	template <typename PointT>
+	static bool applicable(const pcl::PointCloud<PointT> & cloud) {
+		return cloud.isOrganized();
+	}
+
+	/// Extracts clusters of organized cloud.
+	template <typename PointT>
+	void extract(const pcl::PointCloud<PointT> & cloud, std::vector<pcl::PointIndices> & clusters) const {
+		const int width = cloud.width, height = cloud.height;
+		const float tol2 = tolerance_ * tolerance_;
+		const PointT * pts = cloud.points.empty() ? NULL : &cloud.points[0];
+
+		// Parent of each pixel, -1 for invalid ones.
+		parent_.resize(cloud.points.size());
+		for (size_t i = 0; i < cloud.points.size(); ++i)
+			parent_[i] = finite(pts[i]) ? (int) i : -1;
+
+		for (int v = 0; v < height; ++v) {
+			const int row = v * width;
+			for (int u = 0; u < width; ++u) {
+				const int i = row + u;
+				if (parent_[i] < 0)
+					continue;
+				if (u > 0 && parent_[i - 1] >= 0 && dist2(pts[i], pts[i - 1]) <= tol2)
+					merge(i, i - 1);
+				if (v > 0 && parent_[i - width] >= 0 && dist2(pts[i], pts[i - width]) <= tol2)
+					merge(i, i - width);
+			}
+		}
+
+		// Roots are the smallest index of their component, so a single
+		// ascending pass labels every component in order of first pixel.
+		label_.assign(cloud.points.size(), -1);
+		sizes_.clear();
+		for (size_t i = 0; i < parent_.size(); ++i) {
+			if (parent_[i] < 0)
+				continue;
+			int root = find(i);
+			if (label_[root] < 0) {
+				label_[root] = sizes_.size();
+				sizes_.push_back(0);
+			}
+			label_[i] = label_[root];
+			++sizes_[label_[i]];
+		}
+
+		// Map accepted labels to output clusters.
+		std::vector<int> order;
+		for (size_t l = 0; l < sizes_.size(); ++l)
+			if (sizes_[l] >= min_size_ && sizes_[l] <= max_size_)
+				order.push_back(l);
+		std::stable_sort(order.begin(), order.end(), BySize(sizes_));
+
+		std::vector<int> slot(sizes_.size(), -1);
+		clusters.clear();
+		clusters.resize(order.size());
+		for (size_t c = 0; c < order.size(); ++c) {
+			slot[order[c]] = c;
+			clusters[c].header = cloud.header;
+			clusters[c].indices.reserve(sizes_[order[c]]);
+		}
+		for (size_t i = 0; i < label_.size(); ++i)
+			if (label_[i] >= 0 && slot[label_[i]] >= 0)
+				clusters[slot[label_[i]]].indices.push_back(i);
+	}
+
+private:
+	struct BySize {
+		BySize(const std::vector<int> & sizes_) : sizes(sizes_) {}
+		bool operator()(int a, int b) const { return sizes[a] > sizes[b]; }
+		const std::vector<int> & sizes;
+	};
+
+	template <typename PointT>
+	static bool finite(const PointT & p) {
+		return std::fabs(p.x) <= FLT_MAX && std::fabs(p.y) <= FLT_MAX && std::fabs(p.z) <= FLT_MAX;
+	}
+
+	template <typename PointT>
+	static float dist2(const PointT & a, const PointT & b) {
+		const float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	/// Root of the pixel, with path halving.
+	int find(int i) const {
+		while (parent_[i] != i) {
+			parent_[i] = parent_[parent_[i]];
+			i = parent_[i];
+		}
+		return i;
+	}
+
+	/// Joins components, smaller index becomes the root.
+	void merge(int a, int b) const {
+		a = find(a);
+		b = find(b);
+		if (a < b)
+			parent_[b] = a;
+		else if (b < a)
+			parent_[a] = b;
+	}
+
+	float tolerance_;
+	int min_size_, max_size_;
+
+	/// Work buffers, kept between frames.
+	mutable std::vector<int> parent_, label_, sizes_;
+};
+
+} //: namespace Types
+
+#endif /* ORGANIZEDCLUSTERING_HPP_ */
@@ -0,0 +1,346 @@
+/*!
+ * \file
+ * \brief Many PCD frames appended to a single file, with an index.
+ * \author Michal Laszkowski
+ */
+
+#ifndef PCDCONTAINER_HPP_
+#define PCDCONTAINER_HPP_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/PCLPointField.h>
+#include <pcl/common/io.h>
+#include <pcl/io/pcd_io.h>
+
+#include "Types/MappedPCD.hpp"
+
+namespace Types {
+
+/*!
+ * \class PCDContainer
+ * \brief Writes frames one after another into one file.
+ *
+ * Every frame is a complete binary PCD (header and packed records), so any
+ * frame can be read in place by MappedPCD at its offset. Frames are listed
+ * in the text index <file>.idx, one line per frame:
+ *
+ *     frame offset bytes type points stamp
+ *
+ * The index is flushed after every frame, so a recording interrupted at any
+ * point is readable up to the last indexed frame. On close() the same index
+ * is appended to the file as a binary footer, so a finished container is
+ * self-contained:
+ *
+ *     entries   count x (offset u64, bytes u64, points u32, type char[16], stamp char[32])
+ *     trailer   magic "PCDSIDX1", entries offset u64, count u64
+ *
+ * Integers are stored in the byte order of the machine.
+ */
+class PCDContainer {
+public:
+	/// Frame of the container.
+	struct Entry {
+		uint64_t offset;
+		uint64_t bytes;
+		uint32_t points;
+		std::string type;
+		std::string stamp;
+	};
+
+	static const size_t TYPE_SIZE = 16;
+	static const size_t STAMP_SIZE = 32;
+	static const size_t ENTRY_SIZE = 8 + 8 + 4 + TYPE_SIZE + STAMP_SIZE;
+	static const size_t TRAILER_SIZE = 8 + 8 + 8;
+
+	static const char * magic() {
+		return "PCDSIDX1";
+	}
+
+	PCDContainer() : frames_(0) {}
+
+	~PCDContainer() {
+		close();
+	}
+
+	/// Creates (truncates) the container and its index.
+	bool open(const std::string & file) {
+		close();
+		data_.open(file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		index_.open((file + ".idx").c_str(), std::ios::out | std::ios::trunc);
+		if (!data_ || !index_) {
+			close();
+			return false;
+		}
+		file_ = file;
+		frames_ = 0;
+		entries_.clear();
+		index_ << "# frame offset bytes type points stamp\n";
+		index_.flush();
+		return true;
+	}
+
+	/// Writes the footer and closes the container.
+	void close() {
+		if (data_.is_open()) {
+			writeFooter();
+			data_.close();
+		}
+		if (index_.is_open())
+			index_.close();
+		file_.clear();
+	}
+
+	bool isOpen() const {
+		return data_.is_open();
+	}
+
+	const std::string & file() const {
+		return file_;
+	}
+
+	int frames() const {
+		return frames_;
+	}
+
+	/// Appends the cloud as frame of the given type (e.g. xyzrgb), stamp is any text without spaces.
+	template <typename PointT>
+	bool append(const pcl::PointCloud<PointT> & cloud, const std::string & type, const std::string & stamp) {
+		if (!isOpen())
+			return false;
+
+		std::vector<pcl::PCLPointField> fields;
+		pcl::getFields<PointT>(fields);
+		std::vector<pcl::PCLPointField> used;
+		size_t step = 0;
+		for (size_t i = 0; i < fields.size(); ++i) {
+			if (fields[i].name == "_")
+				continue;
+			used.push_back(fields[i]);
+			step += fields[i].count * pcl::getFieldSize(fields[i].datatype);
+		}
+
+		// Width and height of organized clouds are kept, a cloud of inconsistent size is written as unorganized.
+		const size_t n = cloud.points.size();
+		const bool sized = (size_t) cloud.width * cloud.height == n;
+		const std::string header = (sized ? pcl::PCDWriter::generateHeader<PointT>(cloud)
+				: pcl::PCDWriter::generateHeader<PointT>(cloud, n)) + "DATA binary\n";
+
+		// Records packed field by field, as in binary PCD.
+		std::vector<char> records(n * step);
+		for (size_t i = 0; i < n; ++i) {
+			const char * src = reinterpret_cast<const char *>(&cloud.points[i]);
+			char * dst = &records[0] + i * step;
+			for (size_t f = 0; f < used.size(); ++f) {
+				const size_t bytes = used[f].count * pcl::getFieldSize(used[f].datatype);
+				memcpy(dst, src + used[f].offset, bytes);
+				dst += bytes;
+			}
+		}
+
+		const std::streamoff offset = data_.tellp();
+		data_.write(header.data(), header.size());
+		if (!records.empty())
+			data_.write(&records[0], records.size());
+		data_.flush();
+		if (!data_)
+			return false;
+
+		Entry e;
+		e.offset = offset;
+		e.bytes = header.size() + records.size();
+		e.points = n;
+		e.type = type.substr(0, TYPE_SIZE - 1);
+		e.stamp = (stamp.empty() ? std::string("-") : stamp).substr(0, STAMP_SIZE - 1);
+		entries_.push_back(e);
+
+		index_ << frames_ << " " << e.offset << " " << e.bytes << " " << e.type << " " << e.points << " " << e.stamp << "\n";
+		index_.flush();
+		++frames_;
+		return true;
+	}
+
+private:
+	template <typename T>
+	void put(const T & value) {
+		data_.write(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	void putString(const std::string & value, size_t size) {
+		std::vector<char> buffer(size, 0);
+		memcpy(&buffer[0], value.data(), std::min(value.size(), size - 1));
+		data_.write(&buffer[0], size);
+	}
+
+	void writeFooter() {
+		const uint64_t offset = data_.tellp();
+		for (size_t i = 0; i < entries_.size(); ++i) {
+			put(entries_[i].offset);
+			put(entries_[i].bytes);
+			put(entries_[i].points);
+			putString(entries_[i].type, TYPE_SIZE);
+			putString(entries_[i].stamp, STAMP_SIZE);
+		}
+		data_.write(magic(), 8);
+		put(offset);
+		put((uint64_t) entries_.size());
+		data_.flush();
+	}
+
+	std::vector<Entry> entries_;
+
+	std::string file_;
+	std::ofstream data_;
+	std::ofstream index_;
+	int frames_;
+};
+
+/*!
+ * \class PCDContainerReader
+ * \brief Random access to frames of a container.
+ *
+ * The container is mapped once; frames are MappedPCD views of its parts,
+ * so seeking to any frame costs only the parsing of its header. The index
+ * is taken from the footer, or from <file>.idx when the recording was not
+ * closed properly.
+ */
+class PCDContainerReader {
+public:
+	typedef PCDContainer::Entry Entry;
+
+	PCDContainerReader() : length_(0) {}
+
+	bool open(const std::string & file) {
+		close();
+		mapping_ = MappedPCD::map(file, length_);
+		if (!mapping_)
+			return false;
+		file_ = file;
+		if (!readFooter() && !readIndex()) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		mapping_.reset();
+		length_ = 0;
+		entries_.clear();
+	}
+
+	bool isOpen() const {
+		return mapping_.get() != NULL;
+	}
+
+	size_t size() const {
+		return entries_.size();
+	}
+
+	const Entry & entry(size_t i) const {
+		return entries_[i];
+	}
+
+	/// Frame i of the container, empty pointer if it cannot be parsed.
+	MappedPCD::Ptr frame(size_t i) const {
+		MappedPCD::Ptr mapped(new MappedPCD);
+		std::ostringstream name;
+		name << file_ << "#" << i;
+		if (i >= entries_.size() || !mapped->open(mapping_, entries_[i].offset, entries_[i].bytes, name.str()))
+			return MappedPCD::Ptr();
+		return mapped;
+	}
+
+	/*!
+	 * Consecutive frames with the same stamp, i.e. clouds of different types
+	 * saved by one trigger of the writer.
+	 */
+	std::vector<std::vector<size_t> > groups() const {
+		std::vector<std::vector<size_t> > result;
+		for (size_t i = 0; i < entries_.size(); ++i) {
+			if (result.empty() || entries_[i].stamp == "-" || entries_[i].stamp != entries_[i - 1].stamp)
+				result.push_back(std::vector<size_t>());
+			result.back().push_back(i);
+		}
+		return result;
+	}
+
+private:
+	template <typename T>
+	T get(size_t offset) const {
+		T value;
+		memcpy(&value, mapping_.get() + offset, sizeof(T));
+		return value;
+	}
+
+	std::string getString(size_t offset, size_t size) const {
+		const char * p = reinterpret_cast<const char *>(mapping_.get() + offset);
+		return std::string(p, strnlen(p, size));
+	}
+
+	bool valid(const Entry & e) const {
+		return e.offset < length_ && e.bytes <= length_ - e.offset;
+	}
+
+	bool readFooter() {
+		if (length_ < PCDContainer::TRAILER_SIZE)
+			return false;
+		const size_t trailer = length_ - PCDContainer::TRAILER_SIZE;
+		if (memcmp(mapping_.get() + trailer, PCDContainer::magic(), 8) != 0)
+			return false;
+		const uint64_t offset = get<uint64_t>(trailer + 8);
+		const uint64_t count = get<uint64_t>(trailer + 16);
+		if (offset > trailer || count > (trailer - offset) / PCDContainer::ENTRY_SIZE)
+			return false;
+
+		entries_.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			size_t p = offset + i * PCDContainer::ENTRY_SIZE;
+			Entry & e = entries_[i];
+			e.offset = get<uint64_t>(p);
+			e.bytes = get<uint64_t>(p + 8);
+			e.points = get<uint32_t>(p + 16);
+			e.type = getString(p + 20, PCDContainer::TYPE_SIZE);
+			e.stamp = getString(p + 20 + PCDContainer::TYPE_SIZE, PCDContainer::STAMP_SIZE);
+			if (!valid(e))
+				return false;
+		}
+		return true;
+	}
+
+	bool readIndex() {
+		std::ifstream index((file_ + ".idx").c_str());
+		if (!index)
+			return false;
+		entries_.clear();
+		std::string line;
+		while (std::getline(index, line)) {
+			if (line.empty() || line[0] == '#')
+				continue;
+			std::istringstream fields(line);
+			size_t frame;
+			Entry e;
+			if (!(fields >> frame >> e.offset >> e.bytes >> e.type >> e.points >> e.stamp) || !valid(e))
+				break;
+			entries_.push_back(e);
+		}
+		return !entries_.empty();
+	}
+
+	std::string file_;
+	MappedPCD::Mapping mapping_;
+	size_t length_;
+	std::vector<Entry> entries_;
+};
+
+} //: namespace Types
+
+#endif /* PCDCONTAINER_HPP_ */
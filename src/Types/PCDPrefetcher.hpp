@@ -0,0 +1,301 @@
+/*!
+ * \file
+ * \brief Background read-ahead of PCD files of a sequence.
+ * \author Tomek Kornuta, tkornuta@gmail.com
+ */
+
+#ifndef PCDPREFETCHER_HPP_
+#define PCDPREFETCHER_HPP_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/PCLPointCloud2.h>
+#include <pcl/conversions.h>
+#include <pcl/io/pcd_io.h>
+
+#include "Types/CloudPool.hpp"
+#include "Types/MappedPCD.hpp"
+#include "Types/PCDContainer.hpp"
+
+namespace Types {
+
+/*!
+ * \class PCDPrefetcher
+ * \brief Loads files of a sequence on worker threads, ahead of the reader.
+ *
+ * Binary files are mapped into memory and their records are copied straight
+ * into clouds of any number of point types (see MappedPCD); the other files
+ * are parsed once into a pcl::PCLPointCloud2 blob, which is then converted.
+ * Either way enabling several outputs does not read the file several times.
+ * Frames of a container (see PCDContainer) are read the same way, one
+ * frame of the sequence being the group of clouds saved by one trigger. After every get() the files that
+ * follow the requested one in the given direction (wrapping around in loop
+ * mode) are queued, up to depth of them, and frames outside of that window
+ * are dropped.
+ */
+class PCDPrefetcher {
+public:
+	/// Parsed file.
+	struct Frame {
+		Frame() : ok(false) {}
+
+		/// Converts the file to the given point type, false if the file could not be read.
+		template <typename PointT>
+		bool convert(typename pcl::PointCloud<PointT>::Ptr & cloud) const {
+			if (!ok)
+				return false;
+			if (!mapped.empty()) {
+				// Cloud that stores most of the fields of PointT.
+				int best = -1, score = 0;
+				for (size_t i = 0; i < mapped.size(); ++i) {
+					const int m = mapped[i]->matchingFields<PointT>();
+					if (m > score) {
+						score = m;
+						best = i;
+					}
+				}
+				if (best >= 0) {
+					cloud = CloudPool<PointT>::acquire(mapped[best]->size());
+					if (mapped[best]->read(*cloud))
+						return true;
+				}
+				// Fields need conversion, parse the file the usual way (impossible for container frames).
+				cloud = CloudPool<PointT>::acquire();
+				return pcl::io::loadPCDFile<PointT>(file, *cloud) != -1;
+			}
+			cloud = CloudPool<PointT>::acquire(blob.width * blob.height);
+			pcl::fromPCLPointCloud2(blob, *cloud);
+			cloud->sensor_origin_ = origin;
+			cloud->sensor_orientation_ = orientation;
+			return true;
+		}
+
+		std::string file;
+
+		/// Mapped binary file (or clouds of a container frame), blob is not parsed then.
+		std::vector<MappedPCD::Ptr> mapped;
+
+		pcl::PCLPointCloud2 blob;
+		Eigen::Vector4f origin;
+		Eigen::Quaternionf orientation;
+		bool ok;
+
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	};
+
+	typedef boost::shared_ptr<const Frame> FramePtr;
+
+	/// Loads frame of the given index.
+	typedef boost::function<boost::shared_ptr<Frame>(int)> Loader;
+
+	PCDPrefetcher() : size_(0), depth_(0), running_(false) {}
+
+	~PCDPrefetcher() {
+		stop();
+	}
+
+	/// Starts workers for the given list of files, forgets previously loaded ones.
+	void start(const std::vector<std::string> & files, int depth, int threads) {
+		start(files.size(), boost::bind(&PCDPrefetcher::loadFile, files, _1), depth, threads);
+	}
+
+	/// Starts workers for the frames of the container, as grouped by PCDContainerReader::groups().
+	void start(const boost::shared_ptr<const PCDContainerReader> & container, int depth, int threads) {
+		boost::shared_ptr<const Groups> groups(new Groups(container->groups()));
+		start(groups->size(), boost::bind(&PCDPrefetcher::loadGroup, container, groups, _1), depth, threads);
+	}
+
+	/// Starts workers for size frames read by the loader.
+	void start(int size, const Loader & loader, int depth, int threads) {
+		stop();
+		boost::mutex::scoped_lock lock(mutex_);
+		size_ = size;
+		loader_ = loader;
+		depth_ = std::max(0, depth);
+		running_ = true;
+		for (int i = 0; i < std::max(1, threads); ++i)
+			workers_.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&PCDPrefetcher::work, this))));
+	}
+
+	/// Stops workers, waits for the files being read.
+	void stop() {
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			if (!running_)
+				return;
+			running_ = false;
+			queue_.clear();
+		}
+		wanted_.notify_all();
+		loaded_.notify_all();
+		for (size_t i = 0; i < workers_.size(); ++i)
+			workers_[i]->join();
+		workers_.clear();
+
+		boost::mutex::scoped_lock lock(mutex_);
+		frames_.clear();
+	}
+
+	/*!
+	 * Returns frame of the given file, waiting for it if it is not loaded yet,
+	 * and queues depth following files in direction (+1 or -1).
+	 */
+	FramePtr get(int index, int direction, bool loop) {
+		boost::mutex::scoped_lock lock(mutex_);
+		const int n = size_;
+		if (!running_ || index < 0 || index >= n)
+			return FramePtr();
+
+		// Window of files needed now and soon, in order of need.
+		std::vector<int> window;
+		window.push_back(index);
+		for (int k = 1; k <= depth_; ++k) {
+			int i = index + k * (direction < 0 ? -1 : 1);
+			if (loop)
+				i = ((i % n) + n) % n;
+			else if (i < 0 || i >= n)
+				break;
+			if (i == index)
+				break;
+			window.push_back(i);
+		}
+
+		// Drop frames and queued loads outside of the window.
+		for (std::map<int, Slot>::iterator it = frames_.begin(); it != frames_.end();) {
+			if (std::find(window.begin(), window.end(), it->first) == window.end() && !it->second.loading)
+				frames_.erase(it++);
+			else
+				++it;
+		}
+		queue_.clear();
+		for (size_t k = 0; k < window.size(); ++k) {
+			Slot & slot = frames_[window[k]];
+			if (!slot.frame && !slot.loading)
+				queue_.push_back(window[k]);
+		}
+		wanted_.notify_all();
+
+		while (running_ && !frames_[index].frame)
+			loaded_.wait(lock);
+		return frames_[index].frame;
+	}
+
+private:
+	struct Slot {
+		Slot() : loading(false) {}
+		FramePtr frame;
+		bool loading;
+	};
+
+	/// Worker loop - takes the most needed file from the queue and parses it.
+	void work() {
+		boost::mutex::scoped_lock lock(mutex_);
+		while (true) {
+			while (running_ && queue_.empty())
+				wanted_.wait(lock);
+			if (!running_)
+				return;
+
+			const int index = queue_.front();
+			queue_.pop_front();
+			frames_[index].loading = true;
+
+			lock.unlock();
+			boost::shared_ptr<Frame> frame;
+			try {
+				frame = loader_(index);
+			} catch (...) {
+				frame.reset(new Frame);
+			}
+			lock.lock();
+
+			Slot & slot = frames_[index];
+			slot.loading = false;
+			slot.frame = frame;
+			loaded_.notify_all();
+		}
+	}
+
+	typedef std::vector<std::vector<size_t> > Groups;
+
+	/// Touches the pages of mapped data now, on the worker thread, not when converting.
+	static void touch(const MappedPCD & mapped) {
+		const uint8_t * data = mapped.data();
+		volatile uint8_t sum = 0;
+		for (size_t i = 0; i < mapped.size() * mapped.pointStep(); i += 4096)
+			sum += data[i];
+	}
+
+	static boost::shared_ptr<Frame> loadFile(const std::vector<std::string> & files, int index) {
+		return load(files[index]);
+	}
+
+	static boost::shared_ptr<Frame> loadGroup(const boost::shared_ptr<const PCDContainerReader> & container,
+			const boost::shared_ptr<const Groups> & groups, int index) {
+		boost::shared_ptr<Frame> frame(new Frame);
+		const std::vector<size_t> & group = (*groups)[index];
+		for (size_t i = 0; i < group.size(); ++i) {
+			MappedPCD::Ptr mapped = container->frame(group[i]);
+			if (!mapped || !mapped->binary())
+				continue;
+			touch(*mapped);
+			if (frame->mapped.empty())
+				frame->file = mapped->file();
+			frame->mapped.push_back(mapped);
+		}
+		frame->ok = !frame->mapped.empty();
+		return frame;
+	}
+
+	static boost::shared_ptr<Frame> load(const std::string & file) {
+		boost::shared_ptr<Frame> frame(new Frame);
+		frame->file = file;
+		try {
+			MappedPCD::Ptr mapped(new MappedPCD);
+			if (mapped->open(file) && mapped->binary()) {
+				touch(*mapped);
+				frame->mapped.push_back(mapped);
+				frame->ok = true;
+				return frame;
+			}
+			pcl::PCDReader reader;
+			int version;
+			frame->ok = reader.read(file, frame->blob, frame->origin, frame->orientation, version) >= 0;
+		} catch (...) {
+			frame->ok = false;
+		}
+		return frame;
+	}
+
+	int size_;
+	Loader loader_;
+	int depth_;
+	bool running_;
+
+	/// Loaded and loading frames, by index.
+	std::map<int, Slot> frames_;
+
+	/// Indices waiting for a worker, most needed first.
+	std::deque<int> queue_;
+
+	boost::mutex mutex_;
+	boost::condition_variable wanted_;
+	boost::condition_variable loaded_;
+	std::vector<boost::shared_ptr<boost::thread> > workers_;
+};
+
+} //: namespace Types
+
+#endif /* PCDPREFETCHER_HPP_ */
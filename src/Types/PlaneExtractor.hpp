@@ -0,0 +1,297 @@
+/*!
+ * \file
+ * \brief Iterative extraction of planes with warm start from the previous frame.
+ * \author Micha Laszkowski
+ */
+
+#ifndef PLANEEXTRACTOR_HPP_
+#define PLANEEXTRACTOR_HPP_
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <limits>
+
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <pcl/sample_consensus/method_types.h>
+#include <pcl/sample_consensus/model_types.h>
+#include <pcl/sample_consensus/sac_model_plane.h>
+#include <pcl/segmentation/sac_segmentation.h>
+
+#include "Types/ThreadPool.hpp"
+
+namespace Types {
+
+/*!
+ * \class PlaneExtractor
+ * \brief Finds up to N planes, each one among points left by the previous ones.
+ *
+ * Points are never copied: the remaining points are kept as an index list,
+ * shrunk in place after every plane, and all models work on that list.
+ *
+ * With warm start, plane k of the previous frame is first verified on a
+ * subsample of the remaining points. If its inlier ratio is at least
+ * warm_ratio times the ratio it had when found, its inliers are selected
+ * and the model is refined; otherwise a full search is run. When the scene
+ * is known to be unchanged (setSceneUnchanged, e.g. from ChangeDetection),
+ * previous planes are taken without verification and refinement, only their
+ * inliers are selected.
+ *
+ * Full search with SAC_RANSAC evaluates hypotheses in batches, scoring every
+ * batch in parallel (Types::ThreadPool), with the same adaptive stop rule as
+ * pcl::RandomSampleConsensus. Other methods (SAC_PROSAC, SAC_LMEDS,
+ * SAC_MSAC...) are delegated to pcl::SACSegmentation.
+ */
+template <typename PointT>
+class PlaneExtractor {
+public:
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::ConstPtr CloudConstPtr;
+	typedef pcl::SampleConsensusModelPlane<PointT> Model;
+
+	/// Hypotheses generated and scored together.
+	static const int BATCH = 32;
+
+	struct Plane {
+		/// ax + by + cz + d = 0
+		Eigen::VectorXf coefficients;
+
+		/// Indices of inliers in the input cloud.
+		std::vector<int> inliers;
+
+		/// True if taken from the previous frame without full search.
+		bool warm;
+	};
+
+	PlaneExtractor() :
+		threshold_(0.01), method_(pcl::SAC_RANSAC), max_iterations_(50), probability_(0.99),
+		warm_start_(false), warm_ratio_(0.9), warm_samples_(1000), unchanged_(false), min_inliers_(3) {}
+
+	void setDistanceThreshold(double threshold) { threshold_ = threshold; }
+	void setMethodType(int method) { method_ = method; }
+	void setMaxIterations(int iterations) { max_iterations_ = iterations; }
+	void setMinInliers(int inliers) { min_inliers_ = std::max(3, inliers); }
+
+	/// Enables verification of the previous frame's planes before full search.
+	void setWarmStart(bool enabled, double ratio = 0.9, int samples = 1000) {
+		warm_start_ = enabled;
+		warm_ratio_ = ratio;
+		warm_samples_ = std::max(1, samples);
+	}
+
+	/// Marks the next clouds as showing the same scene as the previous one, used with warm start.
+	void setSceneUnchanged(bool unchanged) {
+		unchanged_ = unchanged;
+	}
+
+	/// Forgets planes of the previous frame.
+	void reset() {
+		previous_.clear();
+	}
+
+	/*!
+	 * Extracts up to count planes from the finite points of the cloud.
+	 * \param remaining indices of points that do not belong to any plane.
+	 * \returns number of found planes.
+	 */
+	size_t extract(const CloudConstPtr & cloud, int count, std::vector<Plane> & planes, std::vector<int> & remaining) {
+		planes.clear();
+		boost::shared_ptr<std::vector<int> > indices(new std::vector<int>);
+		indices->reserve(cloud->size());
+		for (size_t i = 0; i < cloud->size(); ++i)
+			if (finite(cloud->points[i]))
+				indices->push_back(i);
+
+		std::vector<Previous> found;
+		for (int k = 0; k < count && (int) indices->size() >= min_inliers_; ++k) {
+			planes.push_back(Plane());
+			Plane & plane = planes.back();
+			if (!fit(cloud, indices, k < (int) previous_.size() ? &previous_[k] : NULL, plane)) {
+				planes.pop_back();
+				break;
+			}
+
+			Previous p;
+			p.coefficients = plane.coefficients;
+			p.ratio = (double) plane.inliers.size() / indices->size();
+			found.push_back(p);
+
+			subtract(*indices, plane.inliers);
+		}
+
+		previous_.swap(found);
+		remaining.swap(*indices);
+		return planes.size();
+	}
+
+private:
+	struct Previous {
+		Eigen::VectorXf coefficients;
+		double ratio;
+	};
+
+	template <typename P>
+	static bool finite(const P & p) {
+		return std::fabs(p.x) <= FLT_MAX && std::fabs(p.y) <= FLT_MAX && std::fabs(p.z) <= FLT_MAX;
+	}
+
+	static float distance(const Eigen::VectorXf & c, const PointT & p) {
+		return std::fabs(c[0] * p.x + c[1] * p.y + c[2] * p.z + c[3]);
+	}
+
+	/// Fits single plane to the indexed points.
+	bool fit(const CloudConstPtr & cloud, const boost::shared_ptr<std::vector<int> > & indices, const Previous * previous, Plane & plane) {
+		typename Model::Ptr model(new Model(cloud, *indices));
+		Eigen::VectorXf coefficients;
+
+		plane.warm = warm_start_ && previous && (unchanged_ || verify(*cloud, *indices, *previous));
+		if (plane.warm) {
+			coefficients = previous->coefficients;
+		} else if (method_ == pcl::SAC_RANSAC) {
+			if (!ransac(model, coefficients))
+				return false;
+		} else {
+			pcl::SACSegmentation<PointT> seg;
+			seg.setOptimizeCoefficients(false);
+			seg.setModelType(pcl::SACMODEL_PLANE);
+			seg.setMethodType(method_);
+			seg.setDistanceThreshold(threshold_);
+			seg.setMaxIterations(max_iterations_);
+			seg.setProbability(probability_);
+			seg.setInputCloud(cloud);
+			seg.setIndices(indices);
+
+			pcl::PointIndices inliers;
+			pcl::ModelCoefficients result;
+			seg.segment(inliers, result);
+			if (result.values.size() != 4)
+				return false;
+			coefficients = Eigen::Map<Eigen::VectorXf>(&result.values[0], 4);
+		}
+
+		// Refine on the inliers and select them again with the refined model.
+		model->selectWithinDistance(coefficients, threshold_, plane.inliers);
+		if ((int) plane.inliers.size() < min_inliers_)
+			return false;
+		if (plane.warm && unchanged_) {
+			plane.coefficients = coefficients;
+			return true;
+		}
+		Eigen::VectorXf refined;
+		model->optimizeModelCoefficients(plane.inliers, coefficients, refined);
+		model->selectWithinDistance(refined, threshold_, plane.inliers);
+		if ((int) plane.inliers.size() < min_inliers_)
+			return false;
+
+		plane.coefficients = refined;
+		return true;
+	}
+
+	/// Checks inlier ratio of the previous model on a subsample of the points.
+	bool verify(const Cloud & cloud, const std::vector<int> & indices, const Previous & previous) const {
+		const size_t step = std::max<size_t>(1, indices.size() / warm_samples_);
+		size_t tested = 0, inliers = 0;
+		for (size_t i = 0; i < indices.size(); i += step, ++tested)
+			inliers += distance(previous.coefficients, cloud.points[indices[i]]) <= threshold_;
+		return tested > 0 && (double) inliers / tested >= warm_ratio_ * previous.ratio;
+	}
+
+	/// Body of the parallel loop scoring hypotheses.
+	struct Score {
+		Score(Model & model, const std::vector<Eigen::VectorXf> & hypotheses, double threshold, std::vector<int> & counts) :
+			model(model), hypotheses(hypotheses), threshold(threshold), counts(counts) {
+		}
+		void operator()(int begin, int end, int) const {
+			for (int h = begin; h < end; ++h)
+				counts[h] = model.countWithinDistance(hypotheses[h], threshold);
+		}
+		Model & model;
+		const std::vector<Eigen::VectorXf> & hypotheses;
+		double threshold;
+		std::vector<int> & counts;
+	};
+
+	/// RANSAC with hypotheses scored in parallel.
+	bool ransac(const typename Model::Ptr & model, Eigen::VectorXf & best) const {
+		const double log_probability = std::log(1.0 - probability_);
+		const double one_over_indices = 1.0 / model->getIndices()->size();
+
+		int best_count = -1, iterations = 0, skipped = 0;
+		double k = 1.0;
+		std::vector<int> samples;
+		std::vector<Eigen::VectorXf> hypotheses;
+		std::vector<int> counts;
+
+		while (iterations < k && iterations < max_iterations_ && skipped < 10 * max_iterations_) {
+			// Sampling uses the model's random generator, so it stays sequential.
+			hypotheses.clear();
+			const int batch = std::min<int>((int) BATCH, max_iterations_ - iterations);
+			while ((int) hypotheses.size() < batch && skipped < 10 * max_iterations_) {
+				int dummy = 0;
+				model->getSamples(dummy, samples);
+				Eigen::VectorXf c;
+				if (samples.empty() || !model->computeModelCoefficients(samples, c)) {
+					++skipped;
+					continue;
+				}
+				hypotheses.push_back(c);
+			}
+
+			counts.resize(hypotheses.size());
+			ThreadPool::parallelFor(0, hypotheses.size(), 1, Score(*model, hypotheses, threshold_, counts));
+
+			for (size_t h = 0; h < hypotheses.size(); ++h) {
+				++iterations;
+				if (counts[h] > best_count) {
+					best_count = counts[h];
+					best = hypotheses[h];
+
+					// Number of iterations needed for the given probability of success.
+					double w = best_count * one_over_indices;
+					double p_no_outliers = 1.0 - w * w * w;
+					p_no_outliers = std::max(std::numeric_limits<double>::epsilon(), p_no_outliers);
+					p_no_outliers = std::min(1.0 - std::numeric_limits<double>::epsilon(), p_no_outliers);
+					k = log_probability / std::log(p_no_outliers);
+				}
+			}
+		}
+		return best_count > 0;
+	}
+
+	/// Removes sorted subsequence from sorted index list, in place.
+	static void subtract(std::vector<int> & indices, const std::vector<int> & removed) {
+		size_t out = 0, r = 0;
+		for (size_t i = 0; i < indices.size(); ++i) {
+			while (r < removed.size() && removed[r] < indices[i])
+				++r;
+			if (r < removed.size() && removed[r] == indices[i])
+				continue;
+			indices[out++] = indices[i];
+		}
+		indices.resize(out);
+	}
+
+	double threshold_;
+	int method_;
+	int max_iterations_;
+	double probability_;
+
+	bool warm_start_;
+	double warm_ratio_;
+	int warm_samples_;
+	bool unchanged_;
+
+	int min_inliers_;
+
+	/// Planes found in the previous frame.
+	std::vector<Previous> previous_;
+};
+
+} //: namespace Types
+
+#endif /* PLANEEXTRACTOR_HPP_ */
@@ -0,0 +1,43 @@
+/*!
+ * \file
+ * \brief Point with SIFT descriptor quantized to 8 bits.
+ * \author Micha Laszkowski
+ */
+
+#ifndef POINTXYZSIFT8_HPP_
+#define POINTXYZSIFT8_HPP_
+
+#include <stdint.h>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/register_point_struct.h>
+
+/*!
+ * \struct PointXYZSIFT8
+ * \brief Counterpart of PointXYZSIFT with uint8 descriptor values.
+ *
+ * Value i of the descriptor is descriptor[i] * scale. SIFT values are
+ * effectively 8-bit, so the record takes 160 instead of 544 bytes.
+ * Conversions and descriptor distances are in Types/QuantizedSIFT.hpp.
+ */
+struct EIGEN_ALIGN16 PointXYZSIFT8 {
+	PCL_ADD_POINT4D;
+	float multiplicity;
+	int pointId;
+	float scale;
+	uint8_t descriptor[128];
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+POINT_CLOUD_REGISTER_POINT_STRUCT(PointXYZSIFT8,
+	(float, x, x)
+	(float, y, y)
+	(float, z, z)
+	(float, multiplicity, multiplicity)
+	(int, pointId, pointId)
+	(float, scale, scale)
+	(uint8_t[128], descriptor, descriptor)
+)
+
+#endif /* POINTXYZSIFT8_HPP_ */
@@ -0,0 +1,55 @@
+/*!
+ * \file
+ * \brief Per-thread counter of cloud pool misses.
+ * \author Micha Laszkowski
+ */
+
+#ifndef POOLMISSCOUNTER_HPP_
+#define POOLMISSCOUNTER_HPP_
+
+#include <cstddef>
+
+#include <boost/thread/tss.hpp>
+
+namespace Types {
+
+/*!
+ * \class PoolMissCounter
+ * \brief Requests of the calling thread that CloudPool could not serve, and bytes of point storage reserved for them.
+ *
+ * Only clouds taken from a CloudPool are counted - allocations made
+ * anywhere else (PCL internals, clouds created directly) are not seen.
+ * Counted per thread, so the difference of two readings around a handler
+ * belongs to that handler only, whatever other executors do meanwhile.
+ */
+class PoolMissCounter {
+public:
+	struct Count {
+		Count() : misses(0), bytes(0) {}
+		size_t misses;
+		size_t bytes;
+	};
+
+	static void add(size_t bytes) {
+		Count & c = *counter();
+		++c.misses;
+		c.bytes += bytes;
+	}
+
+	/// Pool misses of the calling thread so far.
+	static Count get() {
+		return *counter();
+	}
+
+private:
+	static Count * counter() {
+		static boost::thread_specific_ptr<Count> tls;
+		if (!tls.get())
+			tls.reset(new Count);
+		return tls.get();
+	}
+};
+
+} //: namespace Types
+
+#endif /* POOLMISSCOUNTER_HPP_ */
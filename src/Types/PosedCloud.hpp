@@ -0,0 +1,119 @@
+/*!
+ * \file
+ * \brief Point cloud with pending pose, applied only when coordinates are needed.
+ * \author Michal Laszkowski
+ */
+
+#ifndef POSEDCLOUD_HPP_
+#define POSEDCLOUD_HPP_
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <pcl/point_cloud.h>
+
+#include "Types/CloudPool.hpp"
+#include "Types/CloudTransform.hpp"
+
+namespace Types {
+
+/*!
+ * \class PosedCloud
+ * \brief Shared cloud in its own coordinates plus the pose that maps them to the output frame.
+ *
+ * Transformations are composed into the pose instead of being applied to
+ * points, so a chain of components moving the cloud costs one matrix
+ * product each. Consumers that can use the pose directly (e.g. VTK actors
+ * of the viewer) never touch the points; the others call points(), which
+ * transforms the cloud once and caches the result.
+ */
+template <typename PointT>
+class PosedCloud {
+public:
+	typedef boost::shared_ptr<PosedCloud<PointT> > Ptr;
+	typedef boost::shared_ptr<const PosedCloud<PointT> > ConstPtr;
+
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::Ptr CloudPtr;
+	typedef typename Cloud::ConstPtr CloudConstPtr;
+
+	explicit PosedCloud(const CloudConstPtr & cloud = CloudConstPtr(), const Eigen::Matrix4f & pose = Eigen::Matrix4f::Identity()) :
+		cloud_(cloud), pose_(pose) {}
+
+	/// Wraps cloud into new posed cloud.
+	static Ptr create(const CloudConstPtr & cloud, const Eigen::Matrix4f & pose = Eigen::Matrix4f::Identity()) {
+		return Ptr(new PosedCloud<PointT>(cloud, pose));
+	}
+
+	/// New posed cloud sharing the points, with transform applied after the current pose.
+	Ptr transformed(const Eigen::Matrix4f & transform) const {
+		return create(cloud_, transform * pose_);
+	}
+
+	/// Cloud in its own coordinates, pose not applied.
+	const CloudConstPtr & cloud() const {
+		return cloud_;
+	}
+
+	/// Pose mapping cloud coordinates to the output frame.
+	const Eigen::Matrix4f & pose() const {
+		return pose_;
+	}
+
+	Eigen::Affine3f affine() const {
+		return Eigen::Affine3f(pose_);
+	}
+
+	bool identity() const {
+		return pose_.isIdentity();
+	}
+
+	size_t size() const {
+		return cloud_ ? cloud_->size() : 0;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	/// Point in the output frame.
+	PointT point(size_t i) const {
+		PointT p = cloud_->points[i];
+		p.getVector3fMap() = pose_.topLeftCorner<3, 3>() * p.getVector3fMap() + pose_.topRightCorner<3, 1>();
+		return p;
+	}
+
+	/// Cloud with the pose applied, computed on first request.
+	CloudConstPtr points() const {
+		if (!cloud_ || identity())
+			return cloud_;
+
+		boost::mutex::scoped_lock lock(mutex_);
+		if (!points_) {
+			CloudPtr output = CloudPool<PointT>::acquire(cloud_->size());
+			CloudTransform::transform(*cloud_, *output, pose_);
+			points_ = output;
+		}
+		return points_;
+	}
+
+private:
+	PosedCloud(const PosedCloud &);
+	PosedCloud & operator=(const PosedCloud &);
+
+	CloudConstPtr cloud_;
+	Eigen::Matrix4f pose_;
+
+	mutable boost::mutex mutex_;
+	mutable CloudConstPtr points_;
+
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} //: namespace Types
+
+#endif /* POSEDCLOUD_HPP_ */
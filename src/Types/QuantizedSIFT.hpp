@@ -0,0 +1,210 @@
+/*!
+ * \file
+ * \brief Quantization of SIFT clouds and matching of quantized descriptors.
+ * \author Micha Laszkowski
+ */
+
+#ifndef QUANTIZEDSIFT_HPP_
+#define QUANTIZEDSIFT_HPP_
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include <pcl/point_cloud.h>
+#include <pcl/correspondence.h>
+
+#include <Types/PointXYZSIFT.hpp>
+#include "Types/PointXYZSIFT8.hpp"
+#include "Types/ThreadPool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QUANTIZED_SIFT_SSE2
+#endif
+
+namespace Types {
+namespace QuantizedSIFT {
+
+/// Values of a descriptor.
+static const int LENGTH = 128;
+
+/*!
+ * Quantizes the descriptor of the point. Descriptors of integer values
+ * up to 255 (as computed by OpenCV) are stored exactly with scale 1,
+ * others are scaled so that the largest value is 255.
+ */
+inline void quantize(const PointXYZSIFT & in, PointXYZSIFT8 & out) {
+	for (int k = 0; k < 4; ++k)
+		out.data[k] = in.data[k];
+	out.multiplicity = in.multiplicity;
+	out.pointId = in.pointId;
+
+	float max = 0;
+	bool integral = true;
+	for (int i = 0; i < LENGTH; ++i) {
+		max = std::max(max, in.descriptor[i]);
+		integral = integral && in.descriptor[i] == std::floor(in.descriptor[i]);
+	}
+	out.scale = (integral && max <= 255) || max <= 0 ? 1.0f : max / 255;
+	const float inv = 1.0f / out.scale;
+	for (int i = 0; i < LENGTH; ++i) {
+		const float q = in.descriptor[i] * inv + 0.5f;
+		out.descriptor[i] = q <= 0 ? 0 : q >= 255 ? 255 : (uint8_t) q;
+	}
+}
+
+/// Descriptor values of the point restored from the quantized ones.
+inline void dequantize(const PointXYZSIFT8 & in, PointXYZSIFT & out) {
+	for (int k = 0; k < 4; ++k)
+		out.data[k] = in.data[k];
+	out.multiplicity = in.multiplicity;
+	out.pointId = in.pointId;
+	for (int i = 0; i < LENGTH; ++i)
+		out.descriptor[i] = in.descriptor[i] * in.scale;
+}
+
+/// Quantizes all points of the cloud, with its header and layout.
+inline void quantize(const pcl::PointCloud<PointXYZSIFT> & input, pcl::PointCloud<PointXYZSIFT8> & output) {
+	output.points.resize(input.points.size());
+	for (size_t i = 0; i < input.points.size(); ++i)
+		quantize(input.points[i], output.points[i]);
+	output.header = input.header;
+	output.width = input.width;
+	output.height = input.height;
+	output.is_dense = input.is_dense;
+	output.sensor_origin_ = input.sensor_origin_;
+	output.sensor_orientation_ = input.sensor_orientation_;
+}
+
+inline void dequantize(const pcl::PointCloud<PointXYZSIFT8> & input, pcl::PointCloud<PointXYZSIFT> & output) {
+	output.points.resize(input.points.size());
+	for (size_t i = 0; i < input.points.size(); ++i)
+		dequantize(input.points[i], output.points[i]);
+	output.header = input.header;
+	output.width = input.width;
+	output.height = input.height;
+	output.is_dense = input.is_dense;
+	output.sensor_origin_ = input.sensor_origin_;
+	output.sensor_orientation_ = input.sensor_orientation_;
+}
+
+/*!
+ * Sums of products of quantized values: aa = |a|^2, bb = |b|^2, ab = a.b.
+ * Integer arithmetic, all sums fit in 32 bits.
+ */
+inline void products(const uint8_t * a, const uint8_t * b, int32_t & aa, int32_t & bb, int32_t & ab) {
+#if defined(QUANTIZED_SIFT_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i saa = zero, sbb = zero, sab = zero;
+	for (int i = 0; i < LENGTH; i += 16) {
+		const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		const __m128i al = _mm_unpacklo_epi8(va, zero), ah = _mm_unpackhi_epi8(va, zero);
+		const __m128i bl = _mm_unpacklo_epi8(vb, zero), bh = _mm_unpackhi_epi8(vb, zero);
+		saa = _mm_add_epi32(saa, _mm_add_epi32(_mm_madd_epi16(al, al), _mm_madd_epi16(ah, ah)));
+		sbb = _mm_add_epi32(sbb, _mm_add_epi32(_mm_madd_epi16(bl, bl), _mm_madd_epi16(bh, bh)));
+		sab = _mm_add_epi32(sab, _mm_add_epi32(_mm_madd_epi16(al, bl), _mm_madd_epi16(ah, bh)));
+	}
+	int32_t s[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(s), saa);
+	aa = s[0] + s[1] + s[2] + s[3];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(s), sbb);
+	bb = s[0] + s[1] + s[2] + s[3];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(s), sab);
+	ab = s[0] + s[1] + s[2] + s[3];
+#else
+	aa = bb = ab = 0;
+	for (int i = 0; i < LENGTH; ++i) {
+		aa += a[i] * a[i];
+		bb += b[i] * b[i];
+		ab += a[i] * b[i];
+	}
+#endif
+}
+
+/// Squared distance of quantized descriptors, integer if both share the scale.
+inline int32_t squaredDistance(const uint8_t * a, const uint8_t * b) {
+#if defined(QUANTIZED_SIFT_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum = zero;
+	for (int i = 0; i < LENGTH; i += 16) {
+		const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		const __m128i dl = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+		const __m128i dh = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+		sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_madd_epi16(dl, dl), _mm_madd_epi16(dh, dh)));
+	}
+	int32_t s[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(s), sum);
+	return s[0] + s[1] + s[2] + s[3];
+#else
+	int32_t sum = 0;
+	for (int i = 0; i < LENGTH; ++i) {
+		const int32_t d = a[i] - b[i];
+		sum += d * d;
+	}
+	return sum;
+#endif
+}
+
+/// Squared distance of descriptors of the points, in units of the float descriptors.
+inline float squaredDistance(const PointXYZSIFT8 & a, const PointXYZSIFT8 & b) {
+	if (a.scale == b.scale)
+		return a.scale * a.scale * squaredDistance(a.descriptor, b.descriptor);
+	int32_t aa, bb, ab;
+	products(a.descriptor, b.descriptor, aa, bb, ab);
+	const double sa = a.scale, sb = b.scale;
+	return std::max(0.0, sa * sa * aa + sb * sb * bb - 2 * sa * sb * ab);
+}
+
+/// Body of the parallel loop of match(), nearest target of every source point.
+struct MatchBody {
+	MatchBody(const pcl::PointCloud<PointXYZSIFT8> & source, const pcl::PointCloud<PointXYZSIFT8> & target,
+			pcl::Correspondences & nearest) :
+		source(source), target(target), nearest(nearest) {
+	}
+	void operator()(int begin, int end, int) const {
+		for (int i = begin; i < end; ++i) {
+			pcl::Correspondence & c = nearest[i];
+			c.index_query = i;
+			c.index_match = -1;
+			c.distance = std::numeric_limits<float>::max();
+			for (size_t j = 0; j < target.points.size(); ++j) {
+				const float d = squaredDistance(source.points[i], target.points[j]);
+				if (d < c.distance) {
+					c.distance = d;
+					c.index_match = j;
+				}
+			}
+		}
+	}
+	const pcl::PointCloud<PointXYZSIFT8> & source;
+	const pcl::PointCloud<PointXYZSIFT8> & target;
+	pcl::Correspondences & nearest;
+};
+
+/*!
+ * Matches every source point with the target point of the nearest
+ * descriptor (brute force, in parallel). Correspondences of squared
+ * distance above max_distance are dropped; they keep the order of source
+ * points and distance is the squared distance.
+ */
+inline void match(const pcl::PointCloud<PointXYZSIFT8> & source, const pcl::PointCloud<PointXYZSIFT8> & target,
+		pcl::Correspondences & correspondences, float max_distance = std::numeric_limits<float>::max()) {
+	correspondences.clear();
+	if (source.points.empty() || target.points.empty())
+		return;
+	pcl::Correspondences nearest(source.points.size());
+	ThreadPool::parallelFor(0, source.points.size(), 64, MatchBody(source, target, nearest));
+	for (size_t i = 0; i < nearest.size(); ++i)
+		if (nearest[i].index_match >= 0 && nearest[i].distance <= max_distance)
+			correspondences.push_back(nearest[i]);
+}
+
+} //: namespace QuantizedSIFT
+} //: namespace Types
+
+#endif /* QUANTIZEDSIFT_HPP_ */
@@ -0,0 +1,106 @@
+/*!
+ * \file
+ * \brief Dedicated thread running the rendering loop of a viewer.
+ * \author Maciej Stefańczyk
+ */
+
+#ifndef RENDERTHREAD_HPP_
+#define RENDERTHREAD_HPP_
+
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <exception>
+
+#include "Common/Logger.hpp"
+
+namespace Types {
+
+/*!
+ * \class RenderThread
+ * \brief Runs the rendering of a viewer away from the executor of its component.
+ *
+ * VTK windows must be used by the thread that created them, so the whole
+ * life of the visualizer happens on this thread: init() creates it, frame()
+ * is called repeatedly (displaying data taken from LatestValue mailboxes and
+ * spinning the visualizer) until stop(), finish() destroys it. Handlers of
+ * the component only post data to the mailboxes and return at once.
+ * Exception thrown by init() or frame() ends the loop, it is logged and
+ * reported to the component by failed().
+ */
+class RenderThread {
+public:
+	typedef boost::function<void()> Job;
+
+	RenderThread() : running_(false), failed_(false) {}
+
+	~RenderThread() {
+		stop();
+	}
+
+	/// Starts the thread.
+	void start(const Job & init, const Job & frame, const Job & finish) {
+		stop();
+		failed_ = false;
+		running_ = true;
+		thread_.reset(new boost::thread(boost::bind(&RenderThread::run, this, init, frame, finish)));
+	}
+
+	/// Stops the loop after the current frame and waits for finish().
+	void stop() {
+		running_ = false;
+		if (thread_) {
+			thread_->join();
+			thread_.reset();
+		}
+	}
+
+	bool running() const {
+		return running_;
+	}
+
+	/// Checks whether init() or frame() threw since the thread was started.
+	bool failed() const {
+		return failed_;
+	}
+
+private:
+	void run(Job init, Job frame, Job finish) {
+		try {
+			init();
+			while (running_)
+				frame();
+		} catch (std::exception & ex) {
+			LOG(LERROR) << "Rendering thread failed: " << ex.what();
+			fail();
+		} catch (...) {
+			LOG(LERROR) << "Rendering thread failed: unknown exception";
+			fail();
+		}
+		try {
+			finish();
+		} catch (std::exception & ex) {
+			LOG(LERROR) << "Rendering thread failed to finish: " << ex.what();
+			failed_ = true;
+		} catch (...) {
+			LOG(LERROR) << "Rendering thread failed to finish: unknown exception";
+			failed_ = true;
+		}
+	}
+
+	void fail() {
+		failed_ = true;
+		running_ = false;
+	}
+
+	boost::atomic<bool> running_;
+	boost::atomic<bool> failed_;
+	boost::shared_ptr<boost::thread> thread_;
+};
+
+} //: namespace Types
+
+#endif /* RENDERTHREAD_HPP_ */
@@ -0,0 +1,474 @@
+/*!
+ * \file
+ * \brief Ring of cloud slots in shared memory, passing clouds between processes of one host.
+ * \author Micha Laszkowski
+ */
+
+#ifndef SHAREDCLOUDRING_HPP_
+#define SHAREDCLOUDRING_HPP_
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/PCLPointField.h>
+#include <pcl/common/io.h>
+
+namespace Types {
+
+/*!
+ * \class SharedCloudRing
+ * \brief Fixed slots of clouds of one point type in a POSIX shared memory segment.
+ *
+ * One producer process creates the ring; any number of consumer processes
+ * open it by name and map the same slots. The producer fills a free slot
+ * in place (begin() gives the point storage, publish() makes it the newest
+ * cloud), consumers take views of the newest cloud without copying it.
+ * Every slot has a reference count shared by all processes: a slot held
+ * by views is never rewritten, and when all slots are held the producer
+ * skips clouds instead of waiting, so slow consumers never stall it.
+ *
+ * Points are stored with the layout of PointT, so both sides must use the
+ * same point type - the ring records a signature of its fields and open()
+ * rejects a ring of another type. A consumer killed while holding a view
+ * keeps its slot until the producer creates the ring again.
+ *
+ * Usage:
+ * \code
+ * // Producer.
+ * ring.create("/discode_kinect", 4, 640 * 480);
+ * ring.write(*cloud);
+ * // Consumer, other process.
+ * ring.open("/discode_kinect");
+ * SharedCloudRing<pcl::PointXYZ>::View view = ring.latest();
+ * if (view) process(view.points(), view.size());
+ * \endcode
+ */
+template <typename PointT>
+class SharedCloudRing {
+public:
+	static const uint32_t MAGIC = 0x52435350;
+	static const uint32_t VERSION = 1;
+
+	/// Offset of points in a slot, keeping them aligned for SSE.
+	static const size_t SLOT_HEADER = 256;
+
+	/// Reference count of a slot being written.
+	static const int32_t WRITING = -1;
+
+	/// Header of the segment.
+	struct Segment {
+		uint32_t magic, version;
+		uint32_t signature, point_size;
+		uint32_t slots;
+		uint64_t capacity, slot_size;
+		/// Number of the newest cloud, starting with 1.
+		boost::atomic<uint64_t> sequence;
+		/// Slot of the newest cloud, -1 before the first one.
+		boost::atomic<int32_t> latest;
+		/// Set when the producer removes the ring, consumers open the new one.
+		boost::atomic<uint32_t> closed;
+	};
+
+	/// Header of a slot, followed by the points.
+	struct Slot {
+		boost::atomic<int32_t> refs;
+		uint64_t sequence;
+		uint64_t size;
+		uint32_t width, height;
+		uint8_t dense;
+		uint32_t seq;
+		uint64_t stamp;
+		char frame_id[64];
+		float origin[4];
+		float orientation[4];
+	};
+
+	/*!
+	 * \class View
+	 * \brief Cloud of a slot, holding the slot (and the mapping) while it exists.
+	 */
+	class View {
+	public:
+		View() : slot_(NULL), points_(NULL) {}
+
+		operator bool() const {
+			return slot_ != NULL;
+		}
+
+		size_t size() const { return slot_ ? slot_->size : 0; }
+		uint32_t width() const { return slot_ ? slot_->width : 0; }
+		uint32_t height() const { return slot_ ? slot_->height : 0; }
+
+		/// Number of the cloud in the ring.
+		uint64_t sequence() const { return slot_ ? slot_->sequence : 0; }
+
+		/// Points in place, valid while the view (or its copies) exists.
+		const PointT * points() const { return points_; }
+
+		const PointT & operator[](size_t i) const {
+			return points_[i];
+		}
+
+		/// Copies the cloud into the given one, with one copy of all points.
+		void copyTo(pcl::PointCloud<PointT> & output) const {
+			output.points.resize(size());
+			if (!slot_) {
+				output.width = output.height = 0;
+				return;
+			}
+			if (size() > 0)
+				memcpy(&output.points[0], points_, size() * sizeof(PointT));
+			output.width = slot_->width;
+			output.height = slot_->height;
+			output.is_dense = slot_->dense != 0;
+			output.header.seq = slot_->seq;
+			output.header.stamp = slot_->stamp;
+			output.header.frame_id.assign(slot_->frame_id, strnlen(slot_->frame_id, sizeof(slot_->frame_id)));
+			output.sensor_origin_ = Eigen::Vector4f(slot_->origin[0], slot_->origin[1], slot_->origin[2], slot_->origin[3]);
+			output.sensor_orientation_ = Eigen::Quaternionf(slot_->orientation[3], slot_->orientation[0], slot_->orientation[1], slot_->orientation[2]);
+		}
+
+	private:
+		friend class SharedCloudRing;
+
+		/// Drops the reference of the slot, keeps the mapping alive while needed.
+		struct Release {
+			Release(const boost::shared_ptr<uint8_t> & mapping) : mapping(mapping) {}
+			void operator()(Slot * slot) const {
+				slot->refs.fetch_sub(1, boost::memory_order_release);
+			}
+			boost::shared_ptr<uint8_t> mapping;
+		};
+
+		View(Slot * slot, const boost::shared_ptr<uint8_t> & mapping) :
+			hold_(slot, Release(mapping)), slot_(slot), points_(reinterpret_cast<const PointT *>(reinterpret_cast<uint8_t *>(slot) + SLOT_HEADER)) {
+		}
+
+		boost::shared_ptr<Slot> hold_;
+		const Slot * slot_;
+		const PointT * points_;
+	};
+
+	SharedCloudRing() : segment_(NULL), length_(0), owner_(false), writing_(-1), last_(-1), seen_(0), skipped_(0) {}
+
+	~SharedCloudRing() {
+		close();
+	}
+
+	/*!
+	 * Creates the ring (replacing one of the same name) with the given number
+	 * of slots of capacity points each. Name is a shared memory name, "/name".
+	 * \returns false if the segment cannot be created
+	 */
+	bool create(const std::string & name, int slots, size_t capacity) {
+		close();
+		if (!lockFree())
+			return false;
+		slots = std::max(slots, 2);
+		const size_t slot_size = (SLOT_HEADER + capacity * sizeof(PointT) + 63) / 64 * 64;
+		const size_t length = SLOT_HEADER + slots * slot_size;
+
+		// Consumers of the previous ring keep their mapping until they notice it was closed.
+		markClosed(name);
+		shm_unlink(name.c_str());
+		const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0)
+			return false;
+		if (ftruncate(fd, length) != 0) {
+			::close(fd);
+			shm_unlink(name.c_str());
+			return false;
+		}
+		if (!map(fd, length)) {
+			shm_unlink(name.c_str());
+			return false;
+		}
+
+		// Fresh segment is zeroed, only non-zero fields are set.
+		Segment * s = new (segment_) Segment;
+		s->signature = signature();
+		s->point_size = sizeof(PointT);
+		s->slots = slots;
+		s->capacity = capacity;
+		s->slot_size = slot_size;
+		s->sequence.store(0);
+		s->closed.store(0);
+		for (int i = 0; i < slots; ++i)
+			new (slot(i)) Slot;
+		s->latest.store(-1);
+		s->version = VERSION;
+		// Written last, consumers opening the segment check it.
+		boost::atomic_thread_fence(boost::memory_order_release);
+		s->magic = MAGIC;
+		name_ = name;
+		owner_ = true;
+		return true;
+	}
+
+	/*!
+	 * Opens ring created by a producer.
+	 * \returns false if there is no ring of that name or it holds other points
+	 */
+	bool open(const std::string & name) {
+		close();
+		if (!lockFree())
+			return false;
+		const int fd = shm_open(name.c_str(), O_RDWR, 0);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (size_t) st.st_size < SLOT_HEADER) {
+			::close(fd);
+			return false;
+		}
+		if (!map(fd, st.st_size))
+			return false;
+		const Segment * s = segment_;
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		if (s->magic != MAGIC || s->version != VERSION || s->signature != signature() || s->point_size != sizeof(PointT)
+				|| SLOT_HEADER + s->slots * s->slot_size > length_ || s->closed.load()) {
+			close();
+			return false;
+		}
+		name_ = name;
+		seen_ = 0;
+		return true;
+	}
+
+	/// Unmaps the ring, producer also removes it. Views taken from it stay valid.
+	void close() {
+		if (!segment_)
+			return;
+		if (owner_) {
+			segment_->closed.store(1);
+			shm_unlink(name_.c_str());
+		}
+		mapping_.reset();
+		segment_ = NULL;
+		length_ = 0;
+		owner_ = false;
+		writing_ = last_ = -1;
+		name_.clear();
+	}
+
+	bool isOpen() const {
+		return segment_ != NULL;
+	}
+
+	/// True if the producer removed (or replaced) the ring, it should be opened again.
+	bool closed() const {
+		return !segment_ || segment_->closed.load(boost::memory_order_relaxed) != 0;
+	}
+
+	const std::string & name() const { return name_; }
+	size_t capacity() const { return segment_ ? segment_->capacity : 0; }
+	int slots() const { return segment_ ? segment_->slots : 0; }
+
+	/// Clouds the producer skipped because all slots were held by consumers.
+	size_t skipped() const { return skipped_; }
+
+	/*!
+	 * Takes a free slot for n points, producer only.
+	 * \returns storage of points to fill, NULL if the cloud does not fit or all slots are held
+	 */
+	PointT * begin(size_t n) {
+		if (!owner_ || n > segment_->capacity)
+			return NULL;
+		abort();
+		const int slots = segment_->slots, latest = segment_->latest.load(boost::memory_order_acquire);
+		for (int k = 1; k <= slots; ++k) {
+			const int i = (last_ + k + slots) % slots;
+			if (i == latest)
+				continue;
+			int32_t expected = 0;
+			if (slot(i)->refs.compare_exchange_strong(expected, WRITING, boost::memory_order_acquire)) {
+				writing_ = i;
+				slot(i)->size = n;
+				return points(i);
+			}
+		}
+		++skipped_;
+		return NULL;
+	}
+
+	/// Makes the slot filled after begin() the newest cloud, with properties of the given cloud.
+	void publish(const pcl::PointCloud<PointT> & properties, size_t n) {
+		if (writing_ < 0)
+			return;
+		Slot * s = slot(writing_);
+		s->size = n;
+		s->width = properties.width;
+		s->height = properties.height;
+		if ((size_t) s->width * s->height != n) {
+			s->width = n;
+			s->height = 1;
+		}
+		s->dense = properties.is_dense;
+		s->seq = properties.header.seq;
+		s->stamp = properties.header.stamp;
+		memset(s->frame_id, 0, sizeof(s->frame_id));
+		strncpy(s->frame_id, properties.header.frame_id.c_str(), sizeof(s->frame_id) - 1);
+		for (int k = 0; k < 4; ++k)
+			s->origin[k] = properties.sensor_origin_[k];
+		s->orientation[0] = properties.sensor_orientation_.x();
+		s->orientation[1] = properties.sensor_orientation_.y();
+		s->orientation[2] = properties.sensor_orientation_.z();
+		s->orientation[3] = properties.sensor_orientation_.w();
+		s->sequence = segment_->sequence.load(boost::memory_order_relaxed) + 1;
+
+		s->refs.store(0, boost::memory_order_release);
+		segment_->latest.store(writing_, boost::memory_order_release);
+		segment_->sequence.store(s->sequence, boost::memory_order_release);
+		last_ = writing_;
+		writing_ = -1;
+	}
+
+	/// Returns the slot taken by begin() without publishing it.
+	void abort() {
+		if (writing_ < 0)
+			return;
+		slot(writing_)->refs.store(0, boost::memory_order_release);
+		writing_ = -1;
+	}
+
+	/*!
+	 * Writes the cloud into a free slot, with one copy of all points.
+	 * \returns false if it was skipped (too large or all slots held)
+	 */
+	bool write(const pcl::PointCloud<PointT> & cloud) {
+		PointT * p = begin(cloud.size());
+		if (!p)
+			return false;
+		if (!cloud.empty())
+			memcpy(p, &cloud.points[0], cloud.size() * sizeof(PointT));
+		publish(cloud, cloud.size());
+		return true;
+	}
+
+	/// True if a cloud newer than the last one taken by latest() was published.
+	bool fresh() const {
+		return segment_ && segment_->sequence.load(boost::memory_order_acquire) > seen_;
+	}
+
+	/// View of the newest cloud, empty if nothing was published yet.
+	View latest() {
+		if (!segment_)
+			return View();
+		for (int attempt = 0; attempt < 16; ++attempt) {
+			const int i = segment_->latest.load(boost::memory_order_acquire);
+			if (i < 0 || i >= (int) segment_->slots)
+				return View();
+			Slot * s = slot(i);
+			int32_t refs = s->refs.load(boost::memory_order_relaxed);
+			// A held slot is complete - it is not rewritten until released, even if a newer cloud is published meanwhile.
+			while (refs >= 0 && !s->refs.compare_exchange_weak(refs, refs + 1, boost::memory_order_acquire))
+				;
+			if (refs < 0)
+				continue;
+			View view(s, mapping_);
+			seen_ = std::max(seen_, s->sequence);
+			return view;
+		}
+		return View();
+	}
+
+private:
+	/// Hash of names, offsets and types of fields of PointT.
+	static uint32_t signature() {
+		std::vector<pcl::PCLPointField> fields;
+		pcl::getFields<PointT>(fields);
+		uint32_t h = 2166136261u;
+		for (size_t i = 0; i < fields.size(); ++i) {
+			std::string f = fields[i].name;
+			f.push_back((char) fields[i].datatype);
+			f.append((const char *) &fields[i].offset, sizeof(fields[i].offset));
+			f.append((const char *) &fields[i].count, sizeof(fields[i].count));
+			for (size_t k = 0; k < f.size(); ++k)
+				h = (h ^ (uint8_t) f[k]) * 16777619u;
+		}
+		return h;
+	}
+
+	/// Counters in shared memory are used by several processes only if they need no locks.
+	static bool lockFree() {
+		boost::atomic<int32_t> a(0);
+		boost::atomic<uint64_t> b(0);
+		return a.is_lock_free() && b.is_lock_free();
+	}
+
+	/// Tells consumers of a ring of that name that it is being replaced.
+	static void markClosed(const std::string & name) {
+		const int fd = shm_open(name.c_str(), O_RDWR, 0);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(Segment)) {
+			void * base = mmap(NULL, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (base != MAP_FAILED) {
+				Segment * s = static_cast<Segment *>(base);
+				if (s->magic == MAGIC)
+					s->closed.store(1);
+				munmap(base, sizeof(Segment));
+			}
+		}
+		::close(fd);
+	}
+
+	bool map(int fd, size_t length) {
+		void * base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (base == MAP_FAILED)
+			return false;
+		mapping_.reset(static_cast<uint8_t *>(base), Unmap(length));
+		segment_ = static_cast<Segment *>(base);
+		length_ = length;
+		return true;
+	}
+
+	struct Unmap {
+		explicit Unmap(size_t length) : length(length) {}
+		void operator()(uint8_t * p) const {
+			munmap(p, length);
+		}
+		size_t length;
+	};
+
+	Slot * slot(int i) const {
+		return reinterpret_cast<Slot *>(mapping_.get() + SLOT_HEADER + i * segment_->slot_size);
+	}
+
+	PointT * points(int i) const {
+		return reinterpret_cast<PointT *>(reinterpret_cast<uint8_t *>(slot(i)) + SLOT_HEADER);
+	}
+
+	std::string name_;
+	boost::shared_ptr<uint8_t> mapping_;
+	Segment * segment_;
+	size_t length_;
+	bool owner_;
+
+	/// Slot taken by begin() and the last published one, producer only.
+	int writing_, last_;
+
+	/// Sequence of the newest cloud taken, consumer only.
+	uint64_t seen_;
+
+	size_t skipped_;
+};
+
+} //: namespace Types
+
+#endif /* SHAREDCLOUDRING_HPP_ */
@@ -0,0 +1,227 @@
+/*!
+ * \file
+ * \brief Structure-of-arrays storage of point clouds for geometry-only passes.
+ * \author Micha Laszkowski
+ */
+
+#ifndef SOACLOUD_HPP_
+#define SOACLOUD_HPP_
+
+#include <vector>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+namespace Types {
+
+/// True for point types with packed rgb, kept in an array of its own.
+template <typename PointT>
+struct HasColor {
+	static const bool value = false;
+};
+
+template <> struct HasColor<pcl::PointXYZRGB> { static const bool value = true; };
+template <> struct HasColor<pcl::PointXYZRGBA> { static const bool value = true; };
+template <> struct HasColor<pcl::PointXYZRGBNormal> { static const bool value = true; };
+
+/// Packed rgb of points, zero and no-op for types without color.
+template <bool Enabled>
+struct Color {
+	template <typename PointT>
+	static uint32_t get(const PointT &) {
+		return 0;
+	}
+	template <typename PointT>
+	static void set(PointT &, uint32_t) {
+	}
+};
+
+template <>
+struct Color<true> {
+	template <typename PointT>
+	static uint32_t get(const PointT & p) {
+		return p.rgba;
+	}
+	template <typename PointT>
+	static void set(PointT & p, uint32_t rgb) {
+		p.rgba = rgb;
+	}
+};
+
+/*!
+ * \class SoACloud
+ * \brief Coordinates (and color) of a cloud in separate aligned arrays.
+ *
+ * pcl::PointCloud keeps whole records together, so a pass reading only
+ * x/y/z of PointXYZSIFT streams the 128-float descriptor of every point
+ * through the cache as well. Here x, y, z and rgb are contiguous arrays of
+ * their own. Other fields (descriptors...) are not copied: the SoA cloud
+ * keeps the source cloud alive and, for every point, the index of its
+ * record there, like CloudView. Crops, bounds, centroids and transforms
+ * (BoxCrop, CloudStatistics, CloudTransform) work on the arrays directly
+ * and only toCloud() gathers the records, of surviving points only.
+ *
+ * Normals are not kept, so point types with normals must not be
+ * transformed in this form.
+ */
+template <typename PointT>
+class SoACloud {
+public:
+	typedef boost::shared_ptr<SoACloud<PointT> > Ptr;
+	typedef boost::shared_ptr<const SoACloud<PointT> > ConstPtr;
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::ConstPtr CloudConstPtr;
+
+	/// Array of a coordinate, aligned for SIMD loads.
+	typedef std::vector<float, Eigen::aligned_allocator<float> > Floats;
+
+	SoACloud() : dense_(true) {}
+
+	explicit SoACloud(const CloudConstPtr & cloud) {
+		assign(cloud);
+	}
+
+	/// Splits coordinates of the cloud into the arrays, the cloud is kept for the other fields.
+	void assign(const CloudConstPtr & cloud) {
+		source_ = cloud;
+		header_ = cloud->header;
+		sensor_origin_ = cloud->sensor_origin_;
+		sensor_orientation_ = cloud->sensor_orientation_;
+		dense_ = cloud->is_dense;
+
+		const size_t n = cloud->points.size();
+		resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			const PointT & p = cloud->points[i];
+			x_[i] = p.x;
+			y_[i] = p.y;
+			z_[i] = p.z;
+			if (HasColor<PointT>::value)
+				rgb_[i] = Color<HasColor<PointT>::value>::get(p);
+			index_[i] = i;
+		}
+	}
+
+	/*!
+	 * Writes the points into the cloud: records of the source cloud with
+	 * coordinates (and color) of the arrays. Output must not be the source.
+	 */
+	void toCloud(Cloud & output) const {
+		const size_t n = size();
+		output.header = header_;
+		output.sensor_origin_ = sensor_origin_;
+		output.sensor_orientation_ = sensor_orientation_;
+		output.points.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			PointT & p = output.points[i];
+			p = source_->points[index_[i]];
+			p.x = x_[i];
+			p.y = y_[i];
+			p.z = z_[i];
+			if (HasColor<PointT>::value)
+				Color<HasColor<PointT>::value>::set(p, rgb_[i]);
+		}
+		output.width = n;
+		output.height = 1;
+		output.is_dense = dense_;
+	}
+
+	/// Same metadata and source as the other cloud, with no points. Used by filters.
+	void reset(const SoACloud<PointT> & other, size_t reserve) {
+		source_ = other.source_;
+		header_ = other.header_;
+		sensor_origin_ = other.sensor_origin_;
+		sensor_orientation_ = other.sensor_orientation_;
+		dense_ = other.dense_;
+		resize(reserve);
+	}
+
+	/// Resizes all arrays.
+	void resize(size_t n) {
+		x_.resize(n);
+		y_.resize(n);
+		z_.resize(n);
+		index_.resize(n);
+		if (HasColor<PointT>::value)
+			rgb_.resize(n);
+	}
+
+	size_t size() const {
+		return index_.size();
+	}
+
+	bool empty() const {
+		return index_.empty();
+	}
+
+	/// Coordinate arrays, axis 0 - x, 1 - y, 2 - z. NULL if the cloud is empty.
+	float * axis(int a) {
+		return data(a == 0 ? x_ : a == 1 ? y_ : z_);
+	}
+
+	const float * axis(int a) const {
+		return const_cast<SoACloud<PointT> *>(this)->axis(a);
+	}
+
+	float * x() { return axis(0); }
+	float * y() { return axis(1); }
+	float * z() { return axis(2); }
+	const float * x() const { return axis(0); }
+	const float * y() const { return axis(1); }
+	const float * z() const { return axis(2); }
+
+	/// Packed colors, empty for types without color.
+	std::vector<uint32_t> & rgb() { return rgb_; }
+	const std::vector<uint32_t> & rgb() const { return rgb_; }
+
+	/// Index of the record of every point in the source cloud.
+	std::vector<int> & index() { return index_; }
+	const std::vector<int> & index() const { return index_; }
+
+	/// Cloud holding the records of the points.
+	const CloudConstPtr & source() const { return source_; }
+
+	const pcl::PCLHeader & header() const { return header_; }
+
+	/// True if all coordinates are finite.
+	bool isDense() const { return dense_; }
+	void setDense(bool dense) { dense_ = dense; }
+
+	/// Copies point i of the other cloud (with the same source) to position n of this one.
+	void copyPoint(const SoACloud<PointT> & other, size_t i, size_t n) {
+		x_[n] = other.x_[i];
+		y_[n] = other.y_[i];
+		z_[n] = other.z_[i];
+		index_[n] = other.index_[i];
+		if (HasColor<PointT>::value)
+			rgb_[n] = other.rgb_[i];
+	}
+
+private:
+	static float * data(Floats & v) {
+		return v.empty() ? NULL : &v[0];
+	}
+
+	CloudConstPtr source_;
+	pcl::PCLHeader header_;
+	Eigen::Vector4f sensor_origin_;
+	Eigen::Quaternionf sensor_orientation_;
+	bool dense_;
+
+	Floats x_, y_, z_;
+	std::vector<uint32_t> rgb_;
+	std::vector<int> index_;
+
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} //: namespace Types
+
+#endif /* SOACLOUD_HPP_ */
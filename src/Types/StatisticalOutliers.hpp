@@ -0,0 +1,143 @@
+/*!
+ * \file
+ * \brief Statistical outlier analysis sharing search index of the cloud.
+ * \author Micha Laszkowski
+ */
+
+#ifndef STATISTICALOUTLIERS_HPP_
+#define STATISTICALOUTLIERS_HPP_
+
+#include <vector>
+#include <cmath>
+#include <limits>
+
+#include "Types/IndexedCloud.hpp"
+#include "Types/ThreadPool.hpp"
+
+namespace Types {
+namespace StatisticalOutliers {
+
+/*!
+ * Result of the analysis, same statistics as pcl::StatisticalOutlierRemoval.
+ */
+struct Result {
+	Result() : valid(0), mean(0), stddev(0), threshold(0) {}
+
+	/// Mean distance of every point to its k nearest neighbours, NaN for points without one.
+	std::vector<float> distances;
+
+	/// Number of points with valid distance.
+	size_t valid;
+
+	double mean, stddev, threshold;
+
+	/// Indices of points kept by the filter.
+	std::vector<int> inliers;
+
+	/// Indices of removed points.
+	std::vector<int> outliers;
+};
+
+/// Body of the parallel loop of meanDistances(), with neighbour buffers per slot and valid count per chunk.
+template <typename PointT>
+struct MeanDistances {
+	static const int GRAIN = 256;
+
+	MeanDistances(const pcl::PointCloud<PointT> & input, const typename IndexedCloud<PointT>::SearchPtr & search, int mean_k,
+			std::vector<float> & distances) :
+		input(input), search(search), mean_k(mean_k), distances(distances),
+		nn_indices(ThreadPool::instance().threads(), std::vector<int>(mean_k + 1)),
+		nn_dists(ThreadPool::instance().threads(), std::vector<float>(mean_k + 1)),
+		valid(ThreadPool::chunks(0, input.size(), GRAIN), 0) {
+	}
+
+	void operator()(int begin, int end, int slot) const {
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		long & chunk_valid = valid[begin / GRAIN];
+		for (int i = begin; i < end; ++i) {
+			const PointT & p = input.points[i];
+			distances[i] = nan;
+			if (!pcl_isfinite(p.x) || !pcl_isfinite(p.y) || !pcl_isfinite(p.z))
+				continue;
+			// Query point itself is among the neighbours, with zero distance.
+			int found = search->nearestKSearch(i, mean_k + 1, nn_indices[slot], nn_dists[slot]);
+			if (found <= 1)
+				continue;
+			double sum = 0;
+			for (int k = 0; k < found; ++k)
+				sum += std::sqrt(nn_dists[slot][k]);
+			distances[i] = sum / mean_k;
+			++chunk_valid;
+		}
+	}
+
+	const pcl::PointCloud<PointT> & input;
+	typename IndexedCloud<PointT>::SearchPtr search;
+	int mean_k;
+	std::vector<float> & distances;
+	mutable std::vector<std::vector<int> > nn_indices;
+	mutable std::vector<std::vector<float> > nn_dists;
+	mutable std::vector<long> valid;
+};
+
+/*!
+ * Computes mean distances to k nearest neighbours, using (and building if
+ * needed) the search index of the cloud. Points are processed in parallel,
+ * the index is only read.
+ * \returns number of valid distances
+ */
+template <typename PointT>
+size_t meanDistances(const IndexedCloud<PointT> & cloud, int mean_k, std::vector<float> & distances) {
+	const pcl::PointCloud<PointT> & input = *cloud.cloud();
+	distances.resize(input.size());
+
+	const MeanDistances<PointT> body(input, cloud.search(), mean_k, distances);
+	ThreadPool::parallelFor(0, input.size(), MeanDistances<PointT>::GRAIN, body);
+
+	long valid = 0;
+	for (size_t c = 0; c < body.valid.size(); ++c)
+		valid += body.valid[c];
+	return valid;
+}
+
+/*!
+ * Computes mean, standard deviation and threshold from the distances and
+ * splits points. Points without distance are kept, like in PCL.
+ */
+inline void classify(Result & r, double std_mul, bool negative) {
+	double sum = 0, sq_sum = 0;
+	size_t valid = 0;
+	for (size_t i = 0; i < r.distances.size(); ++i) {
+		const float d = r.distances[i];
+		if (d == d) {
+			sum += d;
+			sq_sum += d * d;
+			++valid;
+		}
+	}
+	const double n = r.valid = valid;
+	r.mean = n > 0 ? sum / n : 0;
+	r.stddev = n > 1 ? std::sqrt((sq_sum - sum * sum / n) / (n - 1)) : 0;
+	r.threshold = r.mean + std_mul * r.stddev;
+
+	r.inliers.clear();
+	r.outliers.clear();
+	r.inliers.reserve(r.distances.size());
+	for (size_t i = 0; i < r.distances.size(); ++i) {
+		const float d = r.distances[i] == r.distances[i] ? r.distances[i] : 0;
+		bool outlier = negative ? (d <= r.threshold) : (d > r.threshold);
+		(outlier ? r.outliers : r.inliers).push_back(i);
+	}
+}
+
+/// Full analysis of the cloud.
+template <typename PointT>
+void analyze(const IndexedCloud<PointT> & cloud, int mean_k, double std_mul, bool negative, Result & r) {
+	meanDistances(cloud, mean_k, r.distances);
+	classify(r, std_mul, negative);
+}
+
+} //: namespace StatisticalOutliers
+} //: namespace Types
+
+#endif /* STATISTICALOUTLIERS_HPP_ */
@@ -0,0 +1,275 @@
+/*!
+ * \file
+ * \brief Seeded parallel generation of clouds of planes and spheres.
+ * \author Micha Laszkowski
+ */
+
+#ifndef SYNTHETICSCENE_HPP_
+#define SYNTHETICSCENE_HPP_
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "Types/ThreadPool.hpp"
+
+namespace Types {
+
+/*!
+ * \class SyntheticScene
+ * \brief Mix of planes and spheres with Gaussian noise and uniform outliers.
+ *
+ * Points of a frame are split between primitives by their weights (the
+ * outliers, spread uniformly over a cube around the origin, come last) and
+ * generated in parallel, in chunks of GRAIN points. Every chunk has its own
+ * random stream seeded by the seed, number of the frame and number of the
+ * chunk, so a frame is the same for any number of threads and any frame
+ * can be reproduced on its own.
+ *
+ * Primitives are given as a list separated by semicolons:
+ * \code
+ * plane a b c d size [weight]   // square of the given size on ax + by + cz + d = 0, around its point nearest to the origin
+ * sphere x y z r [weight]       // sphere of radius r centered at (x, y, z)
+ * \endcode
+ */
+class SyntheticScene {
+public:
+	/// Points of a chunk generated by one task of the thread pool.
+	static const int GRAIN = 65536;
+
+	SyntheticScene() : mi_(0), sigma_(0), outliers_(0), extent_(1) {}
+
+	/// Adds square of the given size on plane ax + by + cz + d = 0.
+	void addPlane(float a, float b, float c, float d, float size, float weight = 1) {
+		Primitive p;
+		p.type = PLANE;
+		p.weight = weight;
+		const float norm = std::sqrt(a * a + b * b + c * c);
+		p.n[0] = a / norm;
+		p.n[1] = b / norm;
+		p.n[2] = c / norm;
+		p.size = size;
+		for (int k = 0; k < 3; ++k)
+			p.c[k] = -d / norm * p.n[k];
+
+		// Orthonormal basis of the plane, first vector across the largest component of the normal.
+		const int m = std::fabs(p.n[0]) > std::fabs(p.n[1]) ? (std::fabs(p.n[0]) > std::fabs(p.n[2]) ? 0 : 2) : (std::fabs(p.n[1]) > std::fabs(p.n[2]) ? 1 : 2);
+		float t[3] = { 0, 0, 0 };
+		t[(m + 1) % 3] = 1;
+		const float dot = t[0] * p.n[0] + t[1] * p.n[1] + t[2] * p.n[2];
+		float l = 0;
+		for (int k = 0; k < 3; ++k) {
+			p.u[k] = t[k] - dot * p.n[k];
+			l += p.u[k] * p.u[k];
+		}
+		l = std::sqrt(l);
+		for (int k = 0; k < 3; ++k)
+			p.u[k] /= l;
+		p.v[0] = p.n[1] * p.u[2] - p.n[2] * p.u[1];
+		p.v[1] = p.n[2] * p.u[0] - p.n[0] * p.u[2];
+		p.v[2] = p.n[0] * p.u[1] - p.n[1] * p.u[0];
+		primitives_.push_back(p);
+	}
+
+	/// Adds sphere of radius r centered at (x, y, z).
+	void addSphere(float x, float y, float z, float r, float weight = 1) {
+		Primitive p;
+		p.type = SPHERE;
+		p.weight = weight;
+		p.c[0] = x;
+		p.c[1] = y;
+		p.c[2] = z;
+		p.size = r;
+		primitives_.push_back(p);
+	}
+
+	/*!
+	 * Replaces primitives with the ones of the description (see the class).
+	 * \returns false (and keeps primitives parsed so far) at the first malformed entry
+	 */
+	bool parse(const std::string & description) {
+		primitives_.clear();
+		std::istringstream entries(description);
+		std::string entry;
+		while (std::getline(entries, entry, ';')) {
+			std::istringstream in(entry);
+			std::string type;
+			if (!(in >> type))
+				continue;
+			float v[6];
+			int n = 0;
+			while (n < 6 && in >> v[n])
+				++n;
+			if (type == "plane" && (n == 5 || n == 6))
+				addPlane(v[0], v[1], v[2], v[3], v[4], n == 6 ? v[5] : 1);
+			else if (type == "sphere" && (n == 4 || n == 5))
+				addSphere(v[0], v[1], v[2], v[3], n == 5 ? v[4] : 1);
+			else
+				return false;
+		}
+		return true;
+	}
+
+	size_t primitives() const {
+		return primitives_.size();
+	}
+
+	/// Sets Gaussian noise added to every coordinate of points of primitives.
+	void setNoise(float mi, float sigma) {
+		mi_ = mi;
+		sigma_ = sigma;
+	}
+
+	/// Sets fraction of outliers and half of the side of their cube.
+	void setOutliers(float fraction, float extent) {
+		outliers_ = std::min(std::max(fraction, 0.0f), 1.0f);
+		extent_ = extent;
+	}
+
+	/// Generates frame of n points, colored by primitive (outliers gray) if the points have colors.
+	template <typename PointT>
+	void generate(size_t n, uint32_t seed, uint32_t frame, pcl::PointCloud<PointT> & cloud) const {
+		cloud.points.resize(n);
+		cloud.width = n;
+		cloud.height = 1;
+		cloud.is_dense = true;
+
+		// First point of every primitive and of the outliers, largest remainders get the rounded points.
+		std::vector<size_t> begin(primitives_.size() + 2, 0);
+		const size_t outliers = primitives_.empty() ? n : (size_t) (outliers_ * n + 0.5);
+		double total = 0;
+		for (size_t k = 0; k < primitives_.size(); ++k)
+			total += std::max(primitives_[k].weight, 0.0f);
+		double share = 0;
+		for (size_t k = 0; k < primitives_.size(); ++k) {
+			share += std::max(primitives_[k].weight, 0.0f);
+			begin[k + 1] = total > 0 ? (size_t) ((n - outliers) * (share / total) + 0.5) : 0;
+		}
+		begin[primitives_.size()] = n - outliers;
+		begin[primitives_.size() + 1] = n;
+
+		if (n > 0)
+			ThreadPool::parallelFor(0, ThreadPool::chunks(0, n, GRAIN), 1, Body<PointT>(*this, seed, frame, begin, &cloud.points[0], n));
+	}
+
+private:
+	enum Type { PLANE, SPHERE };
+
+	struct Primitive {
+		Type type;
+		float weight;
+		/// Point of the plane nearest to the origin or center of the sphere.
+		float c[3];
+		/// Normal and basis of the plane.
+		float n[3], u[3], v[3];
+		/// Side of the square or radius.
+		float size;
+	};
+
+	typedef boost::variate_generator<boost::mt19937 &, boost::uniform_real<float> > Uniform;
+	typedef boost::variate_generator<boost::mt19937 &, boost::normal_distribution<float> > Normal;
+
+	/// Seed of the stream of a chunk, mixed so that near seeds give unrelated streams.
+	static uint32_t mix(uint32_t seed, uint32_t frame, uint32_t chunk) {
+		uint64_t h = ((uint64_t) seed << 32) ^ ((uint64_t) frame << 16) ^ chunk;
+		h += 0x9e3779b97f4a7c15ULL;
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+		return (uint32_t) (h ^ (h >> 31));
+	}
+
+	static void setColor(pcl::PointXYZRGB & p, size_t k, size_t primitives) {
+		static const uint8_t palette[6][3] = { { 230, 80, 60 }, { 60, 180, 90 }, { 70, 110, 230 }, { 230, 200, 50 }, { 180, 70, 200 }, { 60, 200, 210 } };
+		if (k >= primitives) {
+			p.r = p.g = p.b = 128;
+			return;
+		}
+		p.r = palette[k % 6][0];
+		p.g = palette[k % 6][1];
+		p.b = palette[k % 6][2];
+	}
+
+	template <typename P>
+	static void setColor(P &, size_t, size_t) {}
+
+	/// Body of the parallel loop over chunks.
+	template <typename PointT>
+	struct Body {
+		Body(const SyntheticScene & scene, uint32_t seed, uint32_t frame, const std::vector<size_t> & begin, PointT * points, size_t n) :
+			scene(scene), seed(seed), frame(frame), begin(begin), points(points), n(n) {
+		}
+
+		void operator()(int first, int last, int) const {
+			for (int chunk = first; chunk < last; ++chunk) {
+				boost::mt19937 rng(mix(seed, frame, chunk));
+				Uniform uniform(rng, boost::uniform_real<float>(-1, 1));
+				Normal normal(rng, boost::normal_distribution<float>(scene.mi_, scene.sigma_ > 0 ? scene.sigma_ : 1));
+				const bool noise = scene.sigma_ > 0 || scene.mi_ != 0;
+
+				const size_t i0 = (size_t) chunk * GRAIN, i1 = std::min(n, i0 + GRAIN);
+				size_t k = std::upper_bound(begin.begin(), begin.end(), i0) - begin.begin() - 1;
+				for (size_t i = i0; i < i1; ++i) {
+					while (i >= begin[k + 1])
+						++k;
+					PointT & p = points[i];
+					if (k < scene.primitives_.size()) {
+						scene.sample(scene.primitives_[k], uniform, p);
+						if (noise) {
+							p.x += scene.sigma_ > 0 ? normal() : scene.mi_;
+							p.y += scene.sigma_ > 0 ? normal() : scene.mi_;
+							p.z += scene.sigma_ > 0 ? normal() : scene.mi_;
+						}
+					} else {
+						p.x = scene.extent_ * uniform();
+						p.y = scene.extent_ * uniform();
+						p.z = scene.extent_ * uniform();
+					}
+					setColor(p, k, scene.primitives_.size());
+				}
+			}
+		}
+
+		const SyntheticScene & scene;
+		uint32_t seed, frame;
+		const std::vector<size_t> & begin;
+		PointT * points;
+		size_t n;
+	};
+
+	/// Uniform point of the primitive.
+	template <typename PointT>
+	void sample(const Primitive & p, Uniform & uniform, PointT & out) const {
+		if (p.type == PLANE) {
+			const float s = 0.5f * p.size * uniform(), t = 0.5f * p.size * uniform();
+			out.x = p.c[0] + s * p.u[0] + t * p.v[0];
+			out.y = p.c[1] + s * p.u[1] + t * p.v[1];
+			out.z = p.c[2] + s * p.u[2] + t * p.v[2];
+			return;
+		}
+		// Uniform on the sphere: uniform height and angle (Archimedes).
+		const float z = uniform(), phi = 3.14159265f * uniform();
+		const float rho = std::sqrt(std::max(0.0f, 1 - z * z));
+		out.x = p.c[0] + p.size * rho * std::cos(phi);
+		out.y = p.c[1] + p.size * rho * std::sin(phi);
+		out.z = p.c[2] + p.size * z;
+	}
+
+	std::vector<Primitive> primitives_;
+	float mi_, sigma_;
+	float outliers_, extent_;
+};
+
+} //: namespace Types
+
+#endif /* SYNTHETICSCENE_HPP_ */
@@ -0,0 +1,176 @@
+/*!
+ * \file
+ * \brief Process-wide pool of threads running parallel loops of all components.
+ * \author Micha Laszkowski
+ *
+ * Built as a shared library of its own, so components loaded from different
+ * libraries use the same pool.
+ */
+
+#include "ThreadPool.hpp"
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/thread/once.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Types {
+
+namespace {
+
+/// Size and pinning set by configure(), environment is read if size is 0.
+int configured_threads = 0;
+bool configured_pin = false;
+
+ThreadPool * pool = NULL;
+boost::once_flag pool_once = BOOST_ONCE_INIT;
+boost::mutex configure_mutex;
+
+} //: namespace
+
+void ThreadPool::create() {
+	boost::mutex::scoped_lock lock(configure_mutex);
+	int threads = configured_threads;
+	bool pin = configured_pin;
+	if (threads <= 0) {
+		const char * env = std::getenv("DCL_THREADS");
+		threads = env ? std::atoi(env) : 0;
+		if (threads <= 0)
+			threads = boost::thread::hardware_concurrency();
+		env = std::getenv("DCL_PIN_THREADS");
+		pin = env && std::atoi(env) != 0;
+	}
+	static ThreadPool instance(std::max(threads, 1), pin);
+	pool = &instance;
+}
+
+ThreadPool & ThreadPool::instance() {
+	boost::call_once(pool_once, &ThreadPool::create);
+	return *pool;
+}
+
+bool ThreadPool::configure(int threads, bool pin) {
+	boost::mutex::scoped_lock lock(configure_mutex);
+	if (pool)
+		return false;
+	configured_threads = threads;
+	configured_pin = pin;
+	return true;
+}
+
+ThreadPool::ThreadPool(int threads, bool pin) :
+	pin_(pin), stop_(false), queues_(threads) {
+	boost::mutex::scoped_lock lock(mutex_);
+	for (int i = 0; i + 1 < threads; ++i)
+		workers_.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&ThreadPool::work, this, i))));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (size_t i = 0; i < workers_.size(); ++i)
+		workers_[i]->join();
+}
+
+void ThreadPool::run(Loop & loop) {
+	bool failed = false;
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		// Loops started inside chunks go to the deque of the worker running them.
+		size_t queue = workers_.size();
+		const boost::thread::id self = boost::this_thread::get_id();
+		for (size_t i = 0; i < workers_.size(); ++i)
+			if (workers_[i]->get_id() == self)
+				queue = i;
+		queues_[queue].push_back(&loop);
+	}
+	wake_.notify_all();
+
+	loop.work(0, failed);
+
+	boost::mutex::scoped_lock lock(mutex_);
+	remove(&loop);
+	while (loop.users_ > 0)
+		finished_.wait(lock);
+	if (failed || loop.failed_)
+		throw std::runtime_error("ThreadPool: exception in body of a parallel loop");
+}
+
+void ThreadPool::work(int i) {
+#ifdef __linux__
+	if (pin_) {
+		const int cores = boost::thread::hardware_concurrency();
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET((i + 1) % std::max(cores, 1), &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+#endif
+
+	boost::mutex::scoped_lock lock(mutex_);
+	while (!stop_) {
+		Loop * loop = take(i);
+		if (!loop) {
+			wake_.wait(lock);
+			continue;
+		}
+		const int slot = loop->slots_++;
+		++loop->users_;
+		lock.unlock();
+
+		bool failed = false;
+		loop->work(slot, failed);
+
+		lock.lock();
+		loop->failed_ = loop->failed_ || failed;
+		if (--loop->users_ == 0)
+			finished_.notify_all();
+	}
+}
+
+ThreadPool::Loop * ThreadPool::take(int i) {
+	// Own deque from the newest loop.
+	std::deque<Loop *> & own = queues_[i];
+	for (std::deque<Loop *>::iterator it = own.end(); it != own.begin();) {
+		--it;
+		if ((*it)->exhausted())
+			it = own.erase(it);
+		else if ((*it)->slots_ < (*it)->limit_)
+			return *it;
+	}
+
+	// Deques of other workers from the oldest loop, the shared one last.
+	const int workers = workers_.size();
+	for (int k = 1; k <= workers; ++k) {
+		std::deque<Loop *> & queue = queues_[k < workers ? (i + k) % workers : workers];
+		for (std::deque<Loop *>::iterator it = queue.begin(); it != queue.end();) {
+			if ((*it)->exhausted())
+				it = queue.erase(it);
+			else if ((*it)->slots_ < (*it)->limit_)
+				return *it;
+			else
+				++it;
+		}
+	}
+	return NULL;
+}
+
+void ThreadPool::remove(Loop * loop) {
+	for (size_t q = 0; q < queues_.size(); ++q)
+		for (std::deque<Loop *>::iterator it = queues_[q].begin(); it != queues_[q].end(); ++it)
+			if (*it == loop) {
+				queues_[q].erase(it);
+				return;
+			}
+}
+
+} //: namespace Types
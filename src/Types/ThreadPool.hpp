@@ -0,0 +1,198 @@
+/*!
+ * \file
+ * \brief Process-wide pool of threads running parallel loops of all components.
+ * \author Micha Laszkowski
+ */
+
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/detail/atomic_count.hpp>
+
+namespace Types {
+
+/*!
+ * \class ThreadPool
+ * \brief Work-stealing scheduler shared by all parallel loops of the library.
+ *
+ * Every executor of a task is a thread of its own, so loops that opened
+ * their own teams of threads oversubscribed the cores as soon as two
+ * executors ran them at once. Now all loops go through one pool per
+ * process: a loop is split into chunks of grain indices and queued to the
+ * deque of the worker that started it (or to the shared deque, for
+ * executor threads). The caller runs chunks of its loop and idle workers
+ * join it, taking the newest loop of their own deque, then stealing the
+ * oldest ones of the others. Concurrent and nested loops (started inside a
+ * chunk of another one) thus share the same workers.
+ *
+ * The caller of a loop runs only chunks of that loop and waits for the
+ * ones taken by workers, so per-slot state of the loop is never reentered.
+ *
+ * Size (workers and the caller) is set by DCL_THREADS, the number of cores
+ * by default. With DCL_PIN_THREADS=1 worker i is pinned to core i + 1
+ * (Linux only), core 0 is left to executors. configure() sets both in code,
+ * before the first loop.
+ *
+ * Usage:
+ * \code
+ * // body(begin, end, slot), slot is unique among threads running the loop, < threads()
+ * Types::ThreadPool::parallelFor(0, n, 4096, boost::bind(&Filter::range, this, _1, _2, _3));
+ * \endcode
+ */
+class ThreadPool {
+public:
+	/// Loop run by the pool, chunk c covers [begin + c * grain, begin + (c + 1) * grain).
+	class Loop {
+	public:
+		Loop(int begin, int end, int grain, int limit) :
+			begin_(begin), end_(end), grain_(grain), chunks_((end - begin + grain - 1) / grain), limit_(limit),
+			next_(0), slots_(1), users_(0), failed_(false) {
+		}
+
+		virtual ~Loop() {
+		}
+
+		virtual void run(int begin, int end, int slot) = 0;
+
+	private:
+		friend class ThreadPool;
+
+		/// True if all chunks are taken.
+		bool exhausted() const {
+			return next_ >= chunks_;
+		}
+
+		/// Runs chunks in the slot until none is left.
+		void work(int slot, bool & failed) {
+			for (;;) {
+				const long c = ++next_ - 1;
+				if (c >= chunks_)
+					return;
+				const int begin = begin_ + c * grain_;
+				try {
+					run(begin, std::min(end_, begin + grain_), slot);
+				} catch (...) {
+					failed = true;
+				}
+			}
+		}
+
+		int begin_, end_, grain_;
+		long chunks_;
+
+		/// Maximal number of threads running the loop.
+		int limit_;
+
+		boost::detail::atomic_count next_;
+
+		/// Guarded by the mutex of the pool.
+		int slots_;
+		int users_;
+		bool failed_;
+	};
+
+	/// Loop calling the body.
+	template <typename Body>
+	class LoopOf : public Loop {
+	public:
+		LoopOf(int begin, int end, int grain, int limit, const Body & body) :
+			Loop(begin, end, grain, limit), body_(body) {
+		}
+
+		void run(int begin, int end, int slot) {
+			body_(begin, end, slot);
+		}
+
+	private:
+		const Body & body_;
+	};
+
+	/*!
+	 * Runs body(begin, end, slot) for all chunks of [begin, end), in
+	 * parallel. At most threads (all of the pool if 0) threads run the loop,
+	 * small loops (one chunk) run directly in the caller.
+	 * \throws std::runtime_error if the body threw, after all chunks are done
+	 */
+	template <typename Body>
+	static void parallelFor(int begin, int end, int grain, const Body & body, int threads = 0) {
+		if (end <= begin)
+			return;
+		grain = std::max(grain, 1);
+		ThreadPool & pool = instance();
+		if (threads <= 0 || threads > pool.threads())
+			threads = pool.threads();
+		if (threads == 1 || end - begin <= grain) {
+			for (int b = begin; b < end; b += grain)
+				body(b, std::min(end, b + grain), 0);
+			return;
+		}
+		LoopOf<Body> loop(begin, end, grain, threads, body);
+		pool.run(loop);
+	}
+
+	/// Number of chunks of the loop, for results kept per chunk.
+	static int chunks(int begin, int end, int grain) {
+		grain = std::max(grain, 1);
+		return end > begin ? (end - begin + grain - 1) / grain : 0;
+	}
+
+	/// The pool, started with the configured size on the first call.
+	static ThreadPool & instance();
+
+	/*!
+	 * Sets the size of the pool and pinning of workers, overriding the
+	 * environment. Returns false if the pool is already running.
+	 */
+	static bool configure(int threads, bool pin);
+
+	/// Threads running a loop - workers and the caller, upper bound of slots.
+	int threads() const {
+		return workers_.size() + 1;
+	}
+
+	~ThreadPool();
+
+private:
+	ThreadPool(int threads, bool pin);
+	ThreadPool(const ThreadPool &);
+	ThreadPool & operator=(const ThreadPool &);
+
+	/// Creates the pool of instance(), sized by configure() or the environment.
+	static void create();
+
+	/// Queues the loop, runs it with the workers and waits for all chunks.
+	void run(Loop & loop);
+
+	/// Main loop of worker i.
+	void work(int i);
+
+	/// Next loop for worker i to join, NULL if none. Called with the mutex held.
+	Loop * take(int i);
+
+	/// Drops the loop from its deque. Called with the mutex held.
+	void remove(Loop * loop);
+
+	bool pin_;
+	bool stop_;
+
+	std::vector<boost::shared_ptr<boost::thread> > workers_;
+
+	/// Deques of loops started by workers, the last one for other threads.
+	std::vector<std::deque<Loop *> > queues_;
+
+	boost::mutex mutex_;
+	boost::condition_variable wake_;
+	boost::condition_variable finished_;
+};
+
+} //: namespace Types
+
+#endif /* THREADPOOL_HPP_ */
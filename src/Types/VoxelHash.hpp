@@ -0,0 +1,131 @@
+/*!
+ * \file
+ * \brief Open-addressing hash table numbering voxels of unbounded grids.
+ * \author Micha Laszkowski
+ */
+
+#ifndef VOXELHASH_HPP_
+#define VOXELHASH_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+namespace Types {
+
+/*!
+ * \class VoxelHash
+ * \brief Maps 64-bit integer coordinates of voxels to consecutive voxel numbers.
+ *
+ * Voxels are numbered in order of insertion, so callers keep per-voxel data
+ * in plain vectors indexed by the number. The table is kept at most half
+ * full and doubles when needed, numbers of voxels never change.
+ */
+class VoxelHash {
+public:
+	VoxelHash() : size_(0), mask_(0) {
+		clear();
+	}
+
+	/*!
+	 * Removes all voxels, the table is sized for the expected number of
+	 * voxels and grows when more are inserted. The slots are reused when
+	 * they fit, unless they are over 4 times too many, so that clearing
+	 * stays proportional to the expected number.
+	 */
+	void clear(size_t expected = 0) {
+		size_t capacity = 16;
+		while (capacity < 2 * expected)
+			capacity *= 2;
+		if (slots_.size() >= capacity && slots_.size() <= 4 * capacity) {
+			if (size_)
+				std::fill(slots_.begin(), slots_.end(), Slot());
+		} else {
+			slots_.assign(capacity, Slot());
+			mask_ = capacity - 1;
+		}
+		size_ = 0;
+	}
+
+	/// Number of voxels.
+	size_t size() const {
+		return size_;
+	}
+
+	/// Integer coordinates of the voxel containing the point, inverse holds inverses of leaf sizes.
+	static void key(float x, float y, float z, const double inverse[3], int64_t key[3]) {
+		key[0] = (int64_t) std::floor(x * inverse[0]);
+		key[1] = (int64_t) std::floor(y * inverse[1]);
+		key[2] = (int64_t) std::floor(z * inverse[2]);
+	}
+
+	/// Number of the voxel, inserted is set when the voxel is new (its number is then size() - 1).
+	int insert(const int64_t key[3], bool & inserted) {
+		if (2 * (size_ + 1) > slots_.size())
+			grow();
+		for (size_t s = hash(key) & mask_;; s = (s + 1) & mask_) {
+			Slot & slot = slots_[s];
+			if (slot.voxel < 0) {
+				slot.key[0] = key[0];
+				slot.key[1] = key[1];
+				slot.key[2] = key[2];
+				slot.voxel = size_++;
+				inserted = true;
+				return slot.voxel;
+			}
+			if (slot.key[0] == key[0] && slot.key[1] == key[1] && slot.key[2] == key[2]) {
+				inserted = false;
+				return slot.voxel;
+			}
+		}
+	}
+
+	/// Number of the voxel, -1 if it is not in the table.
+	int find(const int64_t key[3]) const {
+		for (size_t s = hash(key) & mask_;; s = (s + 1) & mask_) {
+			const Slot & slot = slots_[s];
+			if (slot.voxel < 0)
+				return -1;
+			if (slot.key[0] == key[0] && slot.key[1] == key[1] && slot.key[2] == key[2])
+				return slot.voxel;
+		}
+	}
+
+private:
+	struct Slot {
+		Slot() : voxel(-1) {}
+		int64_t key[3];
+		int voxel;
+	};
+
+	static uint64_t hash(const int64_t key[3]) {
+		uint64_t h = (uint64_t) key[0] * 0x9E3779B97F4A7C15ULL ^ (uint64_t) key[1] * 0xC2B2AE3D27D4EB4FULL
+				^ (uint64_t) key[2] * 0x165667B19E3779F9ULL;
+		return h ^ (h >> 29);
+	}
+
+	/// Doubles the table, voxels keep their numbers.
+	void grow() {
+		std::vector<Slot> old;
+		old.swap(slots_);
+		slots_.assign(2 * old.size(), Slot());
+		mask_ = slots_.size() - 1;
+		for (size_t i = 0; i < old.size(); ++i) {
+			if (old[i].voxel < 0)
+				continue;
+			size_t s = hash(old[i].key) & mask_;
+			while (slots_[s].voxel >= 0)
+				s = (s + 1) & mask_;
+			slots_[s] = old[i];
+		}
+	}
+
+	std::vector<Slot> slots_;
+	size_t size_;
+	size_t mask_;
+};
+
+} //: namespace Types
+
+#endif /* VOXELHASH_HPP_ */
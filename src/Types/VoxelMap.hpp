@@ -0,0 +1,224 @@
+/*!
+ * \file
+ * \brief Persistent voxel map fusing successive clouds.
+ * \author Micha Laszkowski
+ */
+
+#ifndef VOXELMAP_HPP_
+#define VOXELMAP_HPP_
+
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#include <Eigen/Core>
+
+#include <pcl/point_cloud.h>
+#include <pcl/PCLPointField.h>
+#include <pcl/common/io.h>
+
+#include "Types/VoxelHash.hpp"
+#include "Types/CloudTransform.hpp"
+
+namespace Types {
+
+/*!
+ * \class VoxelMap
+ * \brief Voxel grid of the whole scene, updated incrementally frame by frame.
+ *
+ * Unlike HashVoxelGrid, voxels survive between frames: every integrated
+ * cloud is transformed to the map frame point by point and its points are
+ * added to the sums of their voxels, so the cost of a frame depends on the
+ * frame only, never on the size of the map. Voxels are represented by the
+ * centroid of their points (float fields averaged, packed colour averaged
+ * per channel, other fields of the first point), recomputed only for the
+ * voxels touched by the frame.
+ *
+ * With a maximal weight set, sums of a voxel are scaled down once it holds
+ * that many points, so the voxel follows changes of the scene (running
+ * average of about max weight latest points) instead of freezing.
+ *
+ * Non-finite points are ignored.
+ */
+template <typename PointT>
+class VoxelMap {
+public:
+	typedef pcl::PointCloud<PointT> Cloud;
+
+	VoxelMap() : rgb_(-1), max_weight_(0), frame_(0) {
+		inverse_[0] = inverse_[1] = inverse_[2] = 100.0;
+
+		std::vector<pcl::PCLPointField> fields;
+		pcl::getFields<PointT>(fields);
+		for (size_t i = 0; i < fields.size(); ++i) {
+			if (fields[i].name == "rgb" || fields[i].name == "rgba") {
+				rgb_ = fields[i].offset;
+				continue;
+			}
+			if (fields[i].datatype != pcl::PCLPointField::FLOAT32)
+				continue;
+			for (size_t c = 0; c < fields[i].count; ++c)
+				floats_.push_back(fields[i].offset + c * sizeof(float));
+		}
+	}
+
+	/// Sets size of voxels, the map is cleared when it changes.
+	void setLeafSize(float x, float y, float z) {
+		const double inverse[3] = { 1.0 / x, 1.0 / y, 1.0 / z };
+		if (inverse[0] == inverse_[0] && inverse[1] == inverse_[1] && inverse[2] == inverse_[2])
+			return;
+		for (int a = 0; a < 3; ++a)
+			inverse_[a] = inverse[a];
+		clear();
+	}
+
+	/// Sets number of points after which voxels start to forget old points, 0 - never.
+	void setMaxWeight(unsigned int weight) {
+		max_weight_ = weight;
+	}
+
+	/// Removes all voxels.
+	void clear() {
+		table_.clear();
+		points_.clear();
+		sums_.clear();
+		colors_.clear();
+		weights_.clear();
+		stamps_.clear();
+		changed_.clear();
+	}
+
+	/// Number of voxels of the map.
+	size_t size() const {
+		return points_.size();
+	}
+
+	/// Adds points of the cloud, transformed by m, to the map. Returns the number of voxels touched.
+	size_t integrate(const Cloud & cloud, const Eigen::Matrix4f & m) {
+		const CloudTransform::Kernel kernel(m);
+		const size_t f = floats_.size();
+		++frame_;
+		changed_.clear();
+
+		for (size_t i = 0; i < cloud.size(); ++i) {
+			if (!finite(cloud.points[i]))
+				continue;
+			PointT p = cloud.points[i];
+			CloudTransform::Apply<CloudTransform::HasNormal<PointT>::value>::run(kernel, p);
+
+			int64_t key[3];
+			VoxelHash::key(p.x, p.y, p.z, inverse_, key);
+			bool inserted;
+			const size_t v = table_.insert(key, inserted);
+			if (inserted) {
+				points_.push_back(p);
+				sums_.resize(sums_.size() + f, 0.0);
+				colors_.resize(colors_.size() + 4, 0.0);
+				weights_.push_back(0.0);
+				stamps_.push_back(0);
+			}
+			if (stamps_[v] != frame_) {
+				stamps_[v] = frame_;
+				changed_.push_back(v);
+			}
+
+			double * sum = &sums_[v * f];
+			double * color = &colors_[4 * v];
+			if (max_weight_ && weights_[v] >= max_weight_) {
+				const double scale = (max_weight_ - 1.0) / weights_[v];
+				for (size_t k = 0; k < f; ++k)
+					sum[k] *= scale;
+				for (int c = 0; c < 4; ++c)
+					color[c] *= scale;
+				weights_[v] *= scale;
+			}
+
+			const char * base = reinterpret_cast<const char *>(&p);
+			for (size_t k = 0; k < f; ++k) {
+				float value;
+				memcpy(&value, base + floats_[k], sizeof(float));
+				sum[k] += value;
+			}
+			if (rgb_ >= 0) {
+				uint32_t rgba;
+				memcpy(&rgba, base + rgb_, sizeof(rgba));
+				for (int c = 0; c < 4; ++c)
+					color[c] += (rgba >> (8 * c)) & 0xff;
+			}
+			weights_[v] += 1.0;
+		}
+
+		// Centroids of touched voxels only.
+		for (size_t j = 0; j < changed_.size(); ++j) {
+			const size_t v = changed_[j];
+			char * base = reinterpret_cast<char *>(&points_[v]);
+			const double * sum = &sums_[v * f];
+			for (size_t k = 0; k < f; ++k) {
+				const float value = sum[k] / weights_[v];
+				memcpy(base + floats_[k], &value, sizeof(float));
+			}
+			if (rgb_ >= 0) {
+				uint32_t rgba = 0;
+				for (int c = 0; c < 4; ++c)
+					rgba |= ((uint32_t) (colors_[4 * v + c] / weights_[v])) << (8 * c);
+				memcpy(base + rgb_, &rgba, sizeof(rgba));
+			}
+		}
+		return changed_.size();
+	}
+
+	/// Copies all voxels of the map to the output.
+	void map(Cloud & output) const {
+		output.points.assign(points_.begin(), points_.end());
+		finish(output);
+	}
+
+	/// Copies voxels touched by the last integrated cloud to the output.
+	void changes(Cloud & output) const {
+		output.points.resize(changed_.size());
+		for (size_t j = 0; j < changed_.size(); ++j)
+			output.points[j] = points_[changed_[j]];
+		finish(output);
+	}
+
+private:
+	static bool finite(const PointT & p) {
+		return std::fabs(p.x) <= std::numeric_limits<float>::max() && std::fabs(p.y) <= std::numeric_limits<float>::max()
+				&& std::fabs(p.z) <= std::numeric_limits<float>::max();
+	}
+
+	static void finish(Cloud & output) {
+		output.width = output.points.size();
+		output.height = 1;
+		output.is_dense = true;
+	}
+
+	double inverse_[3];
+
+	/// Offsets of float fields and of the packed colour (-1 if none).
+	std::vector<size_t> floats_;
+	int rgb_;
+
+	unsigned int max_weight_;
+
+	/// Number of the last integrated frame.
+	unsigned int frame_;
+
+	VoxelHash table_;
+
+	/// Per voxel: centroid, sums of float fields and colour channels, weight, last frame touching it.
+	typename Cloud::VectorType points_;
+	std::vector<double> sums_;
+	std::vector<double> colors_;
+	std::vector<double> weights_;
+	std::vector<unsigned int> stamps_;
+
+	/// Voxels touched by the last frame.
+	std::vector<size_t> changed_;
+};
+
+} //: namespace Types
+
+#endif /* VOXELMAP_HPP_ */
@@ -0,0 +1,176 @@
+/*!
+ * \file
+ * \brief Bounded queue of jobs executed by a background writer thread.
+ * \author Michal Laszkowski
+ */
+
+#ifndef WRITEQUEUE_HPP_
+#define WRITEQUEUE_HPP_
+
+#include <deque>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Types {
+
+/*!
+ * \class WriteQueue
+ * \brief Moves slow output (disk, network) off the executor thread.
+ *
+ * Jobs are executed one at a time, in order of push(), by a single writer
+ * thread, so jobs appending to the same file need no locking. When the
+ * queue already holds capacity jobs, push() either waits for a free slot
+ * (block) or drops the new job and counts it. With capacity 0 jobs are
+ * executed synchronously by push().
+ */
+class WriteQueue {
+public:
+	/// Job returns false if it failed.
+	typedef boost::function<bool()> Job;
+
+	WriteQueue() : capacity_(0), running_(false), busy_(false), dropped_(0), failed_(0), written_(0) {}
+
+	~WriteQueue() {
+		stop();
+	}
+
+	/// Starts writer thread, counters are reset.
+	void start(int capacity) {
+		stop();
+		boost::mutex::scoped_lock lock(mutex_);
+		capacity_ = capacity > 0 ? capacity : 0;
+		dropped_ = failed_ = written_ = 0;
+		if (capacity_ == 0)
+			return;
+		running_ = true;
+		thread_.reset(new boost::thread(boost::bind(&WriteQueue::work, this)));
+	}
+
+	/// Executes all queued jobs and stops the writer thread.
+	void stop() {
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			if (!running_)
+				return;
+			running_ = false;
+		}
+		queued_.notify_all();
+		freed_.notify_all();
+		thread_->join();
+		thread_.reset();
+	}
+
+	/*!
+	 * Queues the job. If the queue is full waits for a free slot when block
+	 * is set, otherwise drops the job.
+	 * \returns false if the job was dropped.
+	 */
+	bool push(const Job & job, bool block) {
+		boost::mutex::scoped_lock lock(mutex_);
+		if (!running_) {
+			lock.unlock();
+			execute(job);
+			return true;
+		}
+		if (queue_.size() >= (size_t) capacity_) {
+			if (!block) {
+				++dropped_;
+				return false;
+			}
+			while (running_ && queue_.size() >= (size_t) capacity_)
+				freed_.wait(lock);
+			if (!running_) {
+				lock.unlock();
+				execute(job);
+				return true;
+			}
+		}
+		queue_.push_back(job);
+		queued_.notify_one();
+		return true;
+	}
+
+	/// Waits until all queued jobs are executed.
+	void flush() {
+		boost::mutex::scoped_lock lock(mutex_);
+		while (running_ && (!queue_.empty() || busy_))
+			freed_.wait(lock);
+	}
+
+	/// Jobs waiting for the writer, including the one being executed.
+	int depth() const {
+		boost::mutex::scoped_lock lock(mutex_);
+		return queue_.size() + (busy_ ? 1 : 0);
+	}
+
+	int dropped() const {
+		boost::mutex::scoped_lock lock(mutex_);
+		return dropped_;
+	}
+
+	int failed() const {
+		boost::mutex::scoped_lock lock(mutex_);
+		return failed_;
+	}
+
+	int written() const {
+		boost::mutex::scoped_lock lock(mutex_);
+		return written_;
+	}
+
+private:
+	void execute(const Job & job) {
+		bool ok = false;
+		try {
+			ok = job();
+		} catch (...) {
+			ok = false;
+		}
+		boost::mutex::scoped_lock lock(mutex_);
+		++(ok ? written_ : failed_);
+	}
+
+	/// Writer loop, stops when stopped and the queue is empty.
+	void work() {
+		boost::mutex::scoped_lock lock(mutex_);
+		while (true) {
+			while (running_ && queue_.empty())
+				queued_.wait(lock);
+			if (queue_.empty())
+				return;
+
+			Job job = queue_.front();
+			queue_.pop_front();
+			busy_ = true;
+			lock.unlock();
+			execute(job);
+			lock.lock();
+			busy_ = false;
+			freed_.notify_all();
+		}
+	}
+
+	int capacity_;
+	bool running_;
+	bool busy_;
+
+	int dropped_;
+	int failed_;
+	int written_;
+
+	std::deque<Job> queue_;
+
+	mutable boost::mutex mutex_;
+	boost::condition_variable queued_;
+	boost::condition_variable freed_;
+	boost::shared_ptr<boost::thread> thread_;
+};
+
+} //: namespace Types
+
+#endif /* WRITEQUEUE_HPP_ */